@@ -120,7 +120,8 @@
 /*================================= public ==================================*/
 
 Adxl346::Adxl346(I2c& i2c, GpioIn& gpio):
-    i2c_(i2c), gpio_(gpio)
+    i2c_(i2c), gpio_(gpio), transactionCallback_(this, &Adxl346::requestDone), callback_(nullptr), \
+    acceleration_{0, 0, 0}
 {
 }
 
@@ -359,6 +360,28 @@ error:
     return false;
 }
 
+bool Adxl346::requestSample(Callback* callback)
+{
+    // Only one sample can be requested at a time
+    if (transaction_.completed == false) return false;
+
+    callback_ = callback;
+    address_ = ADXL346_DATAX0_ADDR;
+
+    // The six data registers are read in a single multiple-byte read, which
+    // also keeps them from changing in between
+    transaction_ = I2cTransaction(ADXL346_ADDRESS, &address_, 1, data_, sizeof(data_), &transactionCallback_);
+
+    return i2c_.transfer(&transaction_);
+}
+
+void Adxl346::getSample(uint16_t* x, uint16_t* y, uint16_t* z)
+{
+    *x = acceleration_[0];
+    *y = acceleration_[1];
+    *z = acceleration_[2];
+}
+
 float Adxl346::convertAcceleration(int16_t acceleration)
 {
     float result = 4.0;
@@ -369,3 +392,17 @@ float Adxl346::convertAcceleration(int16_t acceleration)
 /*=============================== protected =================================*/
 
 /*================================ private ==================================*/
+
+void Adxl346::requestDone(void)
+{
+    // Called from the I2C interrupt, update the sample before telling the caller
+    if (transaction_.succeeded)
+    {
+        for (uint8_t i = 0; i < sizeof(data_); i += 2)
+        {
+            acceleration_[i>>1] = (data_[i + 1] << 8) | data_[i + 0];
+        }
+    }
+
+    if (callback_ != nullptr) callback_->execute();
+}
@@ -36,10 +36,22 @@ public:
     void setCallback(Callback* callback);
     void clearCallback(void);
     bool readSample(uint16_t* x, uint16_t* y, uint16_t* z);
+    bool requestSample(Callback* callback);
+    bool isRequestSucceeded(void) {return transaction_.succeeded;}
+    void getSample(uint16_t* x, uint16_t* y, uint16_t* z);
     float convertAcceleration(int16_t acceleration);
+private:
+    void requestDone(void);
 private:
     I2c& i2c_;
     GpioIn& gpio_;
+
+    I2cTransaction transaction_;
+    GenericCallback<Adxl346> transactionCallback_;
+    Callback* callback_;
+    uint8_t address_;
+    uint8_t data_[6];
+    uint16_t acceleration_[3];
 };
 
 #endif /* ADXL346_H_ */
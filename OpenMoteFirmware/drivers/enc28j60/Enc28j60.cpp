@@ -11,6 +11,8 @@
 
 /*================================ include ==================================*/
 
+#include <string.h>
+
 #include "Enc28j60.h"
 
 /*================================ define ===================================*/
@@ -246,12 +248,19 @@
 #define RXSTART_INIT                ( 0x0000 )  // Start of RX buffer
 #define RXSTOP_INIT                 ( 0x0BFF )  // End of RX buffer
 
-#define TXSTART_INIT                ( 0x0C00 )  // Start of TX buffer
-#define TXSTOP_INIT                 ( 0x11FF )  // End of TX buffer
+// Two TX buffers, a frame is loaded in one while the other one is being transmitted.
+// Each one holds the control byte, the largest frame and the 7 byte status vector.
+#define TXSTART_INIT                ( 0x0C00 )  // Start of first TX buffer
+#define TXSTOP_INIT                 ( 0x11FF )  // End of first TX buffer
+#define TXSTART_SECOND              ( 0x1200 )  // Start of second TX buffer
+#define TXSTOP_SECOND               ( 0x17FF )  // End of second TX buffer
 
 // Maximum frame length which the controller will accept
 #define MAX_FRAMELEN                ( 1518 )
 
+// Destination, source and EtherType
+#define ETHERNET_HEADER_LENGTH      ( 14 )
+
 /*================================ typedef ==================================*/
 
 /*=============================== variables =================================*/
@@ -264,7 +273,10 @@ Enc28j60::Enc28j60(Spi& spi, GpioIn& gpio):
     spi_(spi), gpio_(gpio), \
     interrupt_(this, &Enc28j60::interruptHandler), \
     callback_(nullptr), \
-    nextPacketPtr(0)
+    receiveFilter_(0), \
+    nextPacketPtr(0), \
+    txStart(TXSTART_INIT), \
+    txLength(0)
 {
 }
 
@@ -296,6 +308,9 @@ void Enc28j60::reset(void)
     // Store a pointer to the next packet
     nextPacketPtr = RXSTART_INIT;
 
+    // The first frame is loaded in the first TX buffer
+    txStart = TXSTART_INIT;
+
     // Set the packet transmit and receive buffers
     writeRegister(ERXST, RXSTART_INIT);
     writeRegister(ERXRDPT, RXSTART_INIT);
@@ -354,47 +369,96 @@ void Enc28j60::clearCallback(void)
 
 OperationResult Enc28j60::transmitFrame(uint8_t* data, uint32_t length)
 {
-    // Errata #12: In half-duplex, transmit logic may stall
-    while (readOperation(ENC28J60_READ_CTRL_REG, ECON1) & ECON1_TXRTS)
+    BufferSegment segment = {data, length};
+
+    return transmitFrame(&segment, 1);
+}
+
+OperationResult Enc28j60::transmitFrame(const BufferSegment* segments, uint32_t count)
+{
+    beginFrame();
+
+    // Write the segments one after the other, the write pointer increments by itself
+    for (uint32_t i = 0; i < count; i++)
     {
-        if (readRegisterByte(EIR) & EIR_TXERIF)
-        {
-            writeOperation(ENC28J60_BIT_FIELD_SET, ECON1, ECON1_TXRST);
-            writeOperation(ENC28J60_BIT_FIELD_CLR, ECON1, ECON1_TXRST);
-        }
+        appendFrame(segments[i].data, segments[i].length);
     }
 
-    // Set transmit buffer start and end
-    writeRegister(EWRPT, TXSTART_INIT);
-    writeRegister(ETXND, TXSTART_INIT + length);
+    return endFrame();
+}
+
+void Enc28j60::beginFrame(void)
+{
+    // Load the frame in the TX buffer that is not being transmitted
+    writeRegister(EWRPT, txStart);
 
     // Use default per packet control bytes
     writeOperation(ENC28J60_WRITE_BUF_MEM, 0, 0x00);
 
-    // Write data to buffer
+    txLength = 0;
+}
+
+void Enc28j60::appendFrame(const uint8_t* data, uint32_t length)
+{
+    // Written straight from the buffer of the caller, the frame is only kept in the TX buffer of the ENC28J60
+    writeBuffer(data, length);
+    txLength += length;
+}
+
+void Enc28j60::updateFrame(uint32_t offset, const uint8_t* data, uint32_t length)
+{
+    // Overwrite bytes that were already appended (e.g. a length field), behind the control byte
+    writeRegister(EWRPT, txStart + 1 + offset);
     writeBuffer(data, length);
 
+    // Continue appending at the end of the frame
+    writeRegister(EWRPT, txStart + 1 + txLength);
+}
+
+OperationResult Enc28j60::endFrame(void)
+{
+    // Wait until the frame in the other TX buffer has been transmitted
+    waitTransmitDone();
+
+    // Set transmit buffer start and end
+    writeRegister(ETXST, txStart);
+    writeRegister(ETXND, txStart + txLength);
+
     // Enable transmission
     writeOperation(ENC28J60_BIT_FIELD_SET, ECON1, ECON1_TXRTS);
 
+    // The next frame goes to the other TX buffer while this one is being transmitted
+    txStart = (txStart == TXSTART_INIT) ? TXSTART_SECOND : TXSTART_INIT;
+
     return ResultSuccess;
 }
 
+bool Enc28j60::isTransmitting(void)
+{
+    return (readOperation(ENC28J60_READ_CTRL_REG, ECON1) & ECON1_TXRTS) != 0;
+}
+
 OperationResult Enc28j60::receiveFrame(uint8_t* buffer, uint32_t* length)
 {
+    OperationResult result = ResultSuccess;
     uint32_t payloadLength = 0;
-
-    if (readRegisterByte(EPKTCNT) > 0)
+    uint32_t headerLength;
+    uint16_t etherType;
+
+    struct {
+        uint16_t nextPacket;
+        uint16_t byteCount;
+        uint16_t status;
+        uint8_t  header[ETHERNET_HEADER_LENGTH];
+    } receiveHeader;
+
+    // Frames that the filter doesn't want are dropped until one is left for the caller
+    while ((payloadLength == 0) && (readRegisterByte(EPKTCNT) > 0))
     {
         writeRegister(ERDPT, nextPacketPtr);
 
-        struct {
-            uint16_t nextPacket;
-            uint16_t byteCount;
-            uint16_t status;
-        } receiveHeader;
-
-        // Read the header
+        // Read the receive status vector and the Ethernet header in one go, the
+        // read pointer wraps around the end of the RX buffer by itself
         readBuffer((uint8_t*) &receiveHeader, sizeof(receiveHeader));
 
         // Update the pointer to the next packet
@@ -409,20 +473,29 @@ OperationResult Enc28j60::receiveFrame(uint8_t* buffer, uint32_t* length)
             payloadLength = *length - 1;
         }
 
-        // Check for CRC errors
+        etherType = (receiveHeader.header[12] << 8) | receiveHeader.header[13];
+
+        // Check for CRC errors, the frame still has to be freed below
         if ((receiveHeader.status & 0x0080) == 0)
         {
-            return ResultError;
+            result = ResultError;
+        }
+        else if ((receiveFilter_ != 0) && (etherType != receiveFilter_))
+        {
+            // Not read any further, the frame only took the header of SPI time
+            payloadLength = 0;
         }
         else
         {
-            // Copy the packet to the buffer
-            readBuffer(buffer, payloadLength);
+            // The header was already read, copy the rest of the packet to the buffer behind it
+            headerLength = (payloadLength < ETHERNET_HEADER_LENGTH) ? payloadLength : ETHERNET_HEADER_LENGTH;
+            memcpy(buffer, receiveHeader.header, headerLength);
+            if (payloadLength > headerLength)
+            {
+                readBuffer(&buffer[headerLength], payloadLength - headerLength);
+            }
         }
 
-        // Clear last buffer position
-        buffer[payloadLength] = 0;
-
         // Errata #14: Receive hardware may corrupt receive buffer
         if (nextPacketPtr - 1 > RXSTOP_INIT)
         {
@@ -437,7 +510,18 @@ OperationResult Enc28j60::receiveFrame(uint8_t* buffer, uint32_t* length)
         writeOperation(ENC28J60_BIT_FIELD_SET, ECON2, ECON2_PKTDEC);
     }
 
-    return ResultSuccess;
+    // Clear last buffer position
+    buffer[payloadLength] = 0;
+
+    // Return the length of the frame, or 0 when no frame was received
+    *length = payloadLength;
+
+    return result;
+}
+
+void Enc28j60::setReceiveFilter(uint16_t etherType)
+{
+    receiveFilter_ = etherType;
 }
 
 /*=============================== protected =================================*/
@@ -540,10 +624,9 @@ void Enc28j60::writeBuffer(const uint8_t* data, uint16_t length)
     spi_.select();
 
     spi_.writeByte(ENC28J60_WRITE_BUF_MEM);
-    while (length--)
-    {
-        spi_.writeByte(*data++);
-    }
+
+    // Bulk transfer, which the uDMA handles when enabled
+    spi_.writeByte(data, length);
 
     spi_.deselect();
 }
@@ -553,14 +636,26 @@ void Enc28j60::readBuffer(uint8_t* data, uint16_t length)
     spi_.select();
 
     spi_.writeByte(ENC28J60_READ_BUF_MEM);
-    while (length--)
-    {
-        *data++ = spi_.readByte();
-    }
+
+    // Bulk transfer, which the uDMA handles when enabled
+    spi_.readByte(data, length);
 
     spi_.deselect();
 }
 
+void Enc28j60::waitTransmitDone(void)
+{
+    // Errata #12: In half-duplex, transmit logic may stall
+    while (readOperation(ENC28J60_READ_CTRL_REG, ECON1) & ECON1_TXRTS)
+    {
+        if (readRegisterByte(EIR) & EIR_TXERIF)
+        {
+            writeOperation(ENC28J60_BIT_FIELD_SET, ECON1, ECON1_TXRST);
+            writeOperation(ENC28J60_BIT_FIELD_CLR, ECON1, ECON1_TXRST);
+        }
+    }
+}
+
 bool Enc28j60::isLinkUp(void)
 {
     return (readPhyByte(PHSTAT2) >> 2) & 0x01;
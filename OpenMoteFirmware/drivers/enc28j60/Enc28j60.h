@@ -32,7 +32,14 @@ public:
     void setCallback(Callback* callback);
     void clearCallback(void);
     OperationResult transmitFrame(uint8_t* data, uint32_t length);
+    OperationResult transmitFrame(const BufferSegment* segments, uint32_t count);
+    void beginFrame(void);
+    void appendFrame(const uint8_t* data, uint32_t length);
+    void updateFrame(uint32_t offset, const uint8_t* data, uint32_t length);
+    OperationResult endFrame(void);
+    bool isTransmitting(void);
     OperationResult receiveFrame(uint8_t* buffer, uint32_t* length);
+    void setReceiveFilter(uint16_t etherType);
 protected:
     void interruptHandler(void);
 private:
@@ -47,6 +54,7 @@ private:
     void writePhy(uint8_t address, uint16_t data);
     void writeBuffer(const uint8_t* data, uint16_t length);
     void readBuffer(uint8_t* data, uint16_t length);
+    void waitTransmitDone(void);
     bool isLinkUp(void);
 private:
     Spi& spi_;
@@ -55,8 +63,13 @@ private:
     Enc28j60Callback interrupt_;
     Callback* callback_;
 
+    // EtherType of the frames that receiveFrame returns, 0 for all of them
+    uint16_t receiveFilter_;
+
     uint8_t  currentBank;
     uint32_t nextPacketPtr;
+    uint16_t txStart;
+    uint16_t txLength;
 };
 
 #endif /* ENC268J60_H_ */
@@ -71,7 +71,7 @@
 /*================================= public ==================================*/
 
 Max44009::Max44009(I2c& i2c, GpioIn& gpio):
-    i2c_(i2c), gpio_(gpio)
+    i2c_(i2c), gpio_(gpio), transactionCallback_(this, &Max44009::requestDone), callback_(nullptr)
 {
 }
 
@@ -229,6 +229,24 @@ error:
     return false;
 }
 
+bool Max44009::requestLux(Callback* callback)
+{
+    // Only one measurement can be requested at a time
+    if (highTransaction_.completed == false || lowTransaction_.completed == false) return false;
+
+    callback_ = callback;
+    registers_[0] = MAX44009_LUX_HIGH_ADDR;
+    registers_[1] = MAX44009_LUX_LOW_ADDR;
+
+    // Each register is read in its own transaction like readLux does, the
+    // transactions follow each other on the bus and the second one finishes
+    highTransaction_ = I2cTransaction(MAX44009_ADDRESS, &registers_[0], 1, &data_[0], 1);
+    lowTransaction_ = I2cTransaction(MAX44009_ADDRESS, &registers_[1], 1, &data_[1], 1, &transactionCallback_);
+
+    if (!i2c_.transfer(&highTransaction_)) return false;
+    return i2c_.transfer(&lowTransaction_);
+}
+
 float Max44009::getLux(void)
 {
     float lux = 0.045;
@@ -246,3 +264,19 @@ uint16_t Max44009::getLuxRaw(void)
 /*=============================== protected =================================*/
 
 /*================================ private ==================================*/
+
+void Max44009::requestDone(void)
+{
+    // Called from the I2C interrupt, update the value before telling the caller
+    if (highTransaction_.succeeded && lowTransaction_.succeeded)
+    {
+        // Convert MAX44009 exponent
+        exponent = ((data_[0] >> 4) & 0x0F);
+        exponent = (exponent == 0x0F ? exponent & 0x0E : exponent);
+
+        // Convert MAX44009 mantissa
+        mantissa = ((data_[0] & 0x0F) << 4) | (data_[1] & 0x0F);
+    }
+
+    if (callback_ != nullptr) callback_->execute();
+}
@@ -35,12 +35,23 @@ public:
     void setCallback(Callback* callback);
     void clearCallback(void);
     bool readLux(void);
+    bool requestLux(Callback* callback);
+    bool isRequestSucceeded(void) {return (highTransaction_.succeeded && lowTransaction_.succeeded);}
     float getLux(void);
     uint16_t getLuxRaw(void);
+private:
+    void requestDone(void);
 private:
     I2c& i2c_;
     GpioIn& gpio_;
 
+    I2cTransaction highTransaction_;
+    I2cTransaction lowTransaction_;
+    GenericCallback<Max44009> transactionCallback_;
+    Callback* callback_;
+    uint8_t registers_[2];
+    uint8_t data_[2];
+
     uint8_t exponent;
     uint8_t mantissa;
 };
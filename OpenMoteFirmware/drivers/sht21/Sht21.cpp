@@ -60,7 +60,7 @@
 /*================================= public ==================================*/
 
 Sht21::Sht21(I2c& i2c):
-    i2c_(i2c)
+    i2c_(i2c), transactionCallback_(this, &Sht21::requestDone), callback_(nullptr)
 {
 }
 
@@ -226,6 +226,16 @@ error:
     return false;
 }
 
+bool Sht21::requestTemperature(Callback* callback)
+{
+    return request(SHT21_TEMPERATURE_HM_CMD, callback);
+}
+
+bool Sht21::requestHumidity(Callback* callback)
+{
+    return request(SHT21_HUMIDITY_HM_CMD, callback);
+}
+
 float Sht21::getTemperature(void)
 {
     float result;
@@ -270,3 +280,33 @@ void Sht21::isInitialized(void)
         isInitialized = true;
     }
 }
+
+bool Sht21::request(uint8_t command, Callback* callback)
+{
+    // Only one measurement can be requested at a time
+    if (transaction_.completed == false) return false;
+
+    command_ = command;
+    callback_ = callback;
+
+    // Write the measurement command and read the result (see datasheet pag. 8,
+    // fig. 15), the sensor holds the clock until the measurement is done so
+    // the I2C interrupt simply waits for it
+    transaction_ = I2cTransaction(SHT21_ADDRESS, &command_, 1, data_, sizeof(data_), &transactionCallback_);
+
+    return i2c_.transfer(&transaction_);
+}
+
+void Sht21::requestDone(void)
+{
+    // Called from the I2C interrupt, update the value before telling the caller
+    if (transaction_.succeeded)
+    {
+        uint16_t value = (data_[0] << 8) | (data_[1] & SHT21_STATUS_MASK);
+
+        if (command_ == SHT21_TEMPERATURE_HM_CMD) temperature = value;
+        else                                      humidity = value;
+    }
+
+    if (callback_ != nullptr) callback_->execute();
+}
@@ -16,6 +16,7 @@
 
 #include "I2c.h"
 
+#include "Callback.h"
 #include "Sensor.h"
 
 class I2c;
@@ -31,15 +32,26 @@ public:
     bool isPresent(void);
     bool readTemperature(void);
     bool readHumidity(void);
+    bool requestTemperature(Callback* callback);
+    bool requestHumidity(Callback* callback);
+    bool isRequestSucceeded(void) {return transaction_.succeeded;}
     float getTemperature(void);
     uint16_t getTemperatureRaw(void);
     float getHumidity(void);
     uint16_t getHumidityRaw(void);
 private:
     void isInitialized(void);
+    bool request(uint8_t command, Callback* callback);
+    void requestDone(void);
 private:
     I2c& i2c_;
 
+    I2cTransaction transaction_;
+    GenericCallback<Sht21> transactionCallback_;
+    Callback* callback_;
+    uint8_t command_;
+    uint8_t data_[2];
+
     uint16_t temperature;
     uint16_t humidity;
 };
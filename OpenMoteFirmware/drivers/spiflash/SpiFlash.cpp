@@ -0,0 +1,203 @@
+/**
+ * @file       SpiFlash.cpp
+ * @author     Bruno Van de Velde (bruno@texus.me)
+ * @version    v0.1
+ * @date       October, 2026
+ * @brief
+ *
+ * @copyright  This file is licensed under the GNU General Public License v2.
+ */
+
+/*================================ include ==================================*/
+
+#include "SpiFlash.h"
+
+/*================================ define ===================================*/
+
+#define SPI_FLASH_WRITE_ENABLE      ( 0x06 )
+#define SPI_FLASH_READ_STATUS       ( 0x05 )
+#define SPI_FLASH_PAGE_PROGRAM      ( 0x02 )
+#define SPI_FLASH_FAST_READ         ( 0x0B )
+#define SPI_FLASH_SECTOR_ERASE      ( 0x20 )
+#define SPI_FLASH_CHIP_ERASE        ( 0xC7 )
+#define SPI_FLASH_READ_ID           ( 0x9F )
+
+#define SPI_FLASH_STATUS_BUSY       ( 0x01 )
+
+// The capacity byte of the JEDEC id is the log2 of the size in bytes
+#define SPI_FLASH_MIN_CAPACITY      ( 16 )
+#define SPI_FLASH_MAX_CAPACITY      ( 24 )
+
+/*================================ typedef ==================================*/
+
+/*=============================== variables =================================*/
+
+/*=============================== prototypes ================================*/
+
+/*================================= public ==================================*/
+
+SpiFlash::SpiFlash(Spi& spi):
+    spi_(spi), size_(0), writing_(false), statusRead_(false), \
+    writeEnable_(SPI_FLASH_WRITE_ENABLE), \
+    statusCommand_(SPI_FLASH_READ_STATUS), status_(0), \
+    writeEnableTransaction_(&writeEnable_, 1), \
+    commandTransaction_(command_, 0), \
+    statusTransaction_(&statusCommand_, 1, &status_, 1)
+{
+}
+
+bool SpiFlash::init(void)
+{
+    uint8_t id[3];
+
+    // Wait for the commands that might still be on the bus
+    while (!commandTransaction_.completed || !dataTransaction_.completed);
+
+    command_[0] = SPI_FLASH_READ_ID;
+    commandTransaction_.txSize = 1;
+    commandTransaction_.rxBuffer = id;
+    commandTransaction_.rxSize = sizeof(id);
+    commandTransaction_.keepSelected = false;
+    spi_.transfer(&commandTransaction_);
+    while (!commandTransaction_.completed);
+    commandTransaction_.rxBuffer = nullptr;
+    commandTransaction_.rxSize = 0;
+
+    // Without a flash the MISO line reads as all zeros or all ones
+    if ((id[0] == 0x00) || (id[0] == 0xFF) ||
+        (id[2] < SPI_FLASH_MIN_CAPACITY) || (id[2] > SPI_FLASH_MAX_CAPACITY))
+    {
+        size_ = 0;
+        return false;
+    }
+
+    size_ = ((uint32_t)1 << id[2]);
+
+    // An erase that was started before a reset of the processor continues
+    writing_ = true;
+    statusRead_ = false;
+    while (!isReady());
+
+    return true;
+}
+
+uint32_t SpiFlash::getSize(void)
+{
+    return size_;
+}
+
+bool SpiFlash::isReady(void)
+{
+    if (!writeEnableTransaction_.completed || !commandTransaction_.completed ||
+        !dataTransaction_.completed || !statusTransaction_.completed)
+    {
+        return false;
+    }
+
+    if (!writing_)
+    {
+        return true;
+    }
+
+    // The status that was read last tells whether the flash is still busy,
+    // the first poll after a write starts by reading it
+    if (statusRead_ && ((status_ & SPI_FLASH_STATUS_BUSY) == 0))
+    {
+        writing_ = false;
+        return true;
+    }
+
+    statusRead_ = true;
+    spi_.transfer(&statusTransaction_);
+    return false;
+}
+
+bool SpiFlash::read(uint32_t address, uint8_t* buffer, uint32_t length)
+{
+    if (!isReady() || (length == 0))
+    {
+        return false;
+    }
+
+    // The fast read is followed by a dummy byte before the data comes
+    setAddress(SPI_FLASH_FAST_READ, address);
+    command_[4] = 0x00;
+    commandTransaction_.txSize = 5;
+    commandTransaction_.keepSelected = true;
+
+    dataTransaction_.txBuffer = nullptr;
+    dataTransaction_.txSize = 0;
+    dataTransaction_.rxBuffer = buffer;
+    dataTransaction_.rxSize = length;
+
+    spi_.transfer(&commandTransaction_);
+    spi_.transfer(&dataTransaction_);
+    return true;
+}
+
+bool SpiFlash::program(uint32_t address, const uint8_t* data, uint32_t length)
+{
+    // The address wraps around within the page when the data doesn't fit
+    if ((length == 0) ||
+        ((address % SPI_FLASH_PAGE_SIZE) + length > SPI_FLASH_PAGE_SIZE))
+    {
+        return false;
+    }
+
+    return startWrite(SPI_FLASH_PAGE_PROGRAM, address, true, data, length);
+}
+
+bool SpiFlash::eraseSector(uint32_t address)
+{
+    return startWrite(SPI_FLASH_SECTOR_ERASE, address, true, nullptr, 0);
+}
+
+bool SpiFlash::eraseChip(void)
+{
+    return startWrite(SPI_FLASH_CHIP_ERASE, 0, false, nullptr, 0);
+}
+
+/*=============================== protected =================================*/
+
+/*================================ private ==================================*/
+
+bool SpiFlash::startWrite(uint8_t command, uint32_t address, bool addressed, \
+                          const uint8_t* data, uint32_t length)
+{
+    if (!isReady() || (address >= size_))
+    {
+        return false;
+    }
+
+    // Every program or erase needs its own write enable, which is a separate
+    // command with the chip select released in between
+    spi_.transfer(&writeEnableTransaction_);
+
+    setAddress(command, address);
+    commandTransaction_.txSize = (addressed ? 4 : 1);
+    commandTransaction_.keepSelected = (length > 0);
+    spi_.transfer(&commandTransaction_);
+
+    if (length > 0)
+    {
+        dataTransaction_.txBuffer = data;
+        dataTransaction_.txSize = length;
+        dataTransaction_.rxBuffer = nullptr;
+        dataTransaction_.rxSize = 0;
+        spi_.transfer(&dataTransaction_);
+    }
+
+    // The status is read on the next poll, as the flash only becomes busy
+    // after the command was completed
+    writing_ = true;
+    statusRead_ = false;
+    return true;
+}
+
+void SpiFlash::setAddress(uint8_t command, uint32_t address)
+{
+    command_[0] = command;
+    command_[1] = (uint8_t)(address >> 16);
+    command_[2] = (uint8_t)(address >> 8);
+    command_[3] = (uint8_t)(address);
+}
@@ -0,0 +1,60 @@
+/**
+ * @file       SpiFlash.h
+ * @author     Bruno Van de Velde (bruno@texus.me)
+ * @version    v0.1
+ * @date       October, 2026
+ * @brief
+ *
+ * @copyright  This file is licensed under the GNU General Public License v2.
+ */
+
+#ifndef SPI_FLASH_H_
+#define SPI_FLASH_H_
+
+#include <stdint.h>
+
+#include "Spi.h"
+
+#define SPI_FLASH_PAGE_SIZE         ( 256 )
+#define SPI_FLASH_SECTOR_SIZE       ( 4096 )
+
+// A SPI NOR flash with the common JEDEC commands and 3-byte addresses, which
+// covers parts of 64 KB up to 16 MB. The operations are queued on the SPI
+// bus and return right away, they return false while the previous operation
+// is still busy. isReady() has to be polled to find out when a program or
+// erase is finished, it reads the status register in the background. The
+// buffers of an operation must stay valid until the flash is ready again.
+class SpiFlash
+{
+public:
+    SpiFlash(Spi& spi);
+    bool init(void);
+    uint32_t getSize(void);
+    bool isReady(void);
+    bool read(uint32_t address, uint8_t* buffer, uint32_t length);
+    bool program(uint32_t address, const uint8_t* data, uint32_t length);
+    bool eraseSector(uint32_t address);
+    bool eraseChip(void);
+private:
+    bool startWrite(uint8_t command, uint32_t address, bool addressed, \
+                    const uint8_t* data, uint32_t length);
+    void setAddress(uint8_t command, uint32_t address);
+private:
+    Spi& spi_;
+
+    uint32_t size_;
+    bool writing_;
+    bool statusRead_;
+
+    uint8_t command_[5];
+    uint8_t writeEnable_;
+    uint8_t statusCommand_;
+    uint8_t status_;
+
+    SpiTransaction writeEnableTransaction_;
+    SpiTransaction commandTransaction_;
+    SpiTransaction dataTransaction_;
+    SpiTransaction statusTransaction_;
+};
+
+#endif /* SPI_FLASH_H_ */
@@ -48,10 +48,17 @@ void Ethernet::clearCallback(void)
 }
 
 void Ethernet::transmitFrame(uint8_t* frame, uint32_t length)
+{
+    BufferSegment segment = {frame, length};
+
+    transmitFrame(&segment, 1);
+}
+
+void Ethernet::transmitFrame(const BufferSegment* segments, uint32_t count)
 {
     OperationResult result;
 
-    result = ethernetDevice.transmitFrame(frame, length);
+    result = ethernetDevice.transmitFrame(segments, count);
 
     if (result == ResultSuccess)
     {
@@ -63,7 +70,39 @@ void Ethernet::transmitFrame(uint8_t* frame, uint32_t length)
     }
 }
 
-void Ethernet::receiveFrame(uint8_t *buffer, uint32_t* length)
+void Ethernet::beginFrame(void)
+{
+    // The frame is built in the memory of the device, without a copy in RAM
+    ethernetDevice.beginFrame();
+}
+
+void Ethernet::appendFrame(const uint8_t* data, uint32_t length)
+{
+    ethernetDevice.appendFrame(data, length);
+}
+
+void Ethernet::updateFrame(uint32_t offset, const uint8_t* data, uint32_t length)
+{
+    ethernetDevice.updateFrame(offset, data, length);
+}
+
+void Ethernet::endFrame(void)
+{
+    OperationResult result;
+
+    result = ethernetDevice.endFrame();
+
+    if (result == ResultSuccess)
+    {
+        sentFrames++;
+    }
+    else if (result == ResultError)
+    {
+        sentFramesError++;
+    }
+}
+
+OperationResult Ethernet::receiveFrame(uint8_t *buffer, uint32_t* length)
 {
     OperationResult result;
 
@@ -77,6 +116,14 @@ void Ethernet::receiveFrame(uint8_t *buffer, uint32_t* length)
     {
         receivedFramesError++;
     }
+
+    return result;
+}
+
+void Ethernet::setReceiveFilter(uint16_t etherType)
+{
+    // Frames of other EtherTypes are dropped in the device without reading them
+    ethernetDevice.setReceiveFilter(etherType);
 }
 
 /*=============================== protected =================================*/
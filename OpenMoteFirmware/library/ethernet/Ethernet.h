@@ -31,7 +31,13 @@ public:
     void setCallback(Callback* callback_);
     void clearCallback(void);
     void transmitFrame(uint8_t* frame, uint32_t length);
-    void receiveFrame(uint8_t* buffer, uint32_t* length);
+    void transmitFrame(const BufferSegment* segments, uint32_t count);
+    void beginFrame(void);
+    void appendFrame(const uint8_t* data, uint32_t length);
+    void updateFrame(uint32_t offset, const uint8_t* data, uint32_t length);
+    void endFrame(void);
+    OperationResult receiveFrame(uint8_t* buffer, uint32_t* length);
+    void setReceiveFilter(uint16_t etherType);
 private:
     void interruptHandler(void);
 private:
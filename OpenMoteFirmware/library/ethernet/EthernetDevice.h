@@ -15,6 +15,7 @@
 #include <stdint.h>
 
 #include "Callback.h"
+#include "BufferSegment.h"
 
 enum OperationResult : int8_t
 {
@@ -30,7 +31,13 @@ public:
     virtual void setCallback(Callback* callback_) = 0;
     virtual void clearCallback(void) = 0;
     virtual OperationResult transmitFrame(uint8_t* data, uint32_t length) = 0;
+    virtual OperationResult transmitFrame(const BufferSegment* segments, uint32_t count) = 0;
+    virtual void beginFrame(void) = 0;
+    virtual void appendFrame(const uint8_t* data, uint32_t length) = 0;
+    virtual void updateFrame(uint32_t offset, const uint8_t* data, uint32_t length) = 0;
+    virtual OperationResult endFrame(void) = 0;
     virtual OperationResult receiveFrame(uint8_t* buffer, uint32_t* length) = 0;
+    virtual void setReceiveFilter(uint16_t etherType) = 0;
 protected:
     void setMacAddress(uint8_t* mac_address);
 protected:
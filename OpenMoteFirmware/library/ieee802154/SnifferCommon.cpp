@@ -29,6 +29,7 @@ extern GpioOut led_orange;
 
 const uint8_t SnifferCommon::broadcastAddress[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
 const uint8_t SnifferCommon::ethernetType[2]     = {0x80, 0x9A};
+const uint8_t SnifferCommon::frameZeros[60]      = {0};
 
 /*================================= public ==================================*/
 
@@ -36,8 +37,7 @@ SnifferCommon::SnifferCommon(Board& board, Radio& radio):
     board_(board), radio_(radio), \
     snifferRadioRxInitCallback_(this, &SnifferCommon::radioRxInitCallback), \
     snifferRadioRxDoneCallback_(this, &SnifferCommon::radioRxDoneCallback), \
-    radioBuffer_ptr(radioBuffer), radioBuffer_len(sizeof(radioBuffer)), \
-    outputBuffer_ptr(outputBuffer), outputBuffer_len(sizeof(outputBuffer))
+    nextPacket_(nullptr), droppedPackets_(0)
 {
 }
 
@@ -46,6 +46,11 @@ void SnifferCommon::init(void)
     // Get the EUI48
     board_.getEUI48(macAddress);
 
+    // Set MAC destination address, MAC source address and MAC type
+    memcpy(&frameHeader[0], SnifferCommon::broadcastAddress, 6);
+    memcpy(&frameHeader[6], macAddress, 6);
+    memcpy(&frameHeader[12], SnifferCommon::ethernetType, 2);
+
     // Set Radio receive callbacks
     radio_.setRxCallbacks(&snifferRadioRxInitCallback_, \
                           &snifferRadioRxDoneCallback_);
@@ -76,61 +81,52 @@ void SnifferCommon::setChannel(uint8_t channel)
     radio_.setChannel(channel);
 }
 
-void SnifferCommon::initFrame(uint8_t* buffer, uint8_t length, int8_t rssi, uint8_t lqi, uint8_t crc)
+void SnifferCommon::setDestination(const uint8_t* address)
 {
-    // Pre-calculate the frame length
-    uint32_t frameLength = 6 + 2 + 6 + length + 2;
-
-    // Check that we do not overflow the Ethernet buffer
-    if (frameLength > outputBuffer_len)
-    {
-        return;
-    }
-
-    // Reset the Ethernet buffer length
-    outputBuffer_len = 0;
-
-    // Set MAC destination address
-    memcpy(&outputBuffer[0], SnifferCommon::broadcastAddress, 6);
-    outputBuffer_len += 6;
-
-    // Set MAC source address
-    memcpy(&outputBuffer[6], &macAddress, 6);
-    outputBuffer_len += 6;
+    // Following frames go to the collector or multicast group instead of the broadcast address
+    memcpy(&frameHeader[0], address, 6);
+}
 
-    // Set MAC type
-    memcpy(&outputBuffer[12], SnifferCommon::ethernetType, 2);
-    outputBuffer_len += 2;
+uint32_t SnifferCommon::initFrame(SnifferPacket* packet, BufferSegment* segments)
+{
+    // Pre-calculate the frame length
+    uint32_t frameLength = sizeof(frameHeader) + packet->length + sizeof(packet->status);
+    uint32_t count = 0;
 
-    // Need to set the PHR field?
-    // memset(&ethernetBuffer[14], length, 1);
-    // ethernetBuffer_len += 1;
+    // The header was prepared in init
+    segments[count].data   = frameHeader;
+    segments[count].length = sizeof(frameHeader);
+    count++;
 
-    // Copy the IEEE 802.15.4 payload
-    memcpy(&outputBuffer[14], buffer, length);
-    outputBuffer_len += length;
+    // The IEEE 802.15.4 payload is sent from where the radio stored it
+    segments[count].data   = packet->buffer;
+    segments[count].length = packet->length;
+    count++;
 
     // Ensure that we meet the minimum Ethernet frame size
     if (frameLength < 60)
     {
-        // Calculate the remaining space
-        uint32_t bytes = 60 - frameLength;
-
-        // Fill the remaining space with zeros
-        memset(&outputBuffer[outputBuffer_len], 0x00, bytes);
-        outputBuffer_len += bytes;
+        segments[count].data   = frameZeros;
+        segments[count].length = 60 - frameLength;
+        count++;
     }
 
-    // Copy the IEEE 802.15.4 RSSI
-    outputBuffer[outputBuffer_len] = rssi;
-    outputBuffer_len += 1;
+    // Copy the IEEE 802.15.4 RSSI, CRC and LQI
+    packet->status[0] = packet->rssi;
+    packet->status[1] = packet->crc | packet->lqi;
+    segments[count].data   = packet->status;
+    segments[count].length = sizeof(packet->status);
+    count++;
 
-    // Copy the IEEE 802.15.4 CRC and LQI
-    outputBuffer[outputBuffer_len] = crc | lqi;
-    outputBuffer_len += 1;
+    return count;
 }
 
-/*================================ private ==================================*/
+uint32_t SnifferCommon::getDroppedPackets(void)
+{
+    return droppedPackets_;
+}
+
+/*=============================== protected =================================*/
 
 void SnifferCommon::radioRxInitCallback(void)
 {
@@ -139,6 +135,59 @@ void SnifferCommon::radioRxInitCallback(void)
 
 void SnifferCommon::radioRxDoneCallback(void)
 {
+    SnifferPacket* packet;
+    RadioResult result;
+
     led_red.off();
-    mutex.giveFromInterrupt();
+
+    // Store the frame in a free packet, or read it anyway to empty the RX buffer.
+    // Only the task gives packets back to the pool, so a packet of a frame that
+    // couldn't be read is kept for the next frame.
+    packet = (nextPacket_ != nullptr) ? nextPacket_ : packetPool_.allocate();
+    nextPacket_ = nullptr;
+    if (packet == nullptr)
+    {
+        packet = &droppedPacket_;
+    }
+
+    // Get packet from the radio
+    packet->length = sizeof(packet->buffer);
+    result = radio_.getPacket(packet->buffer, &packet->length, &packet->rssi, &packet->lqi, &packet->crc);
+
+    // Listen for the next frame right away, the task sends this one later
+    radio_.receiveNext();
+
+    if (result == RadioResult_Success)
+    {
+        if (packet == &droppedPacket_)
+        {
+            droppedPackets_ = droppedPackets_ + 1;
+        }
+        else
+        {
+            // The queue holds as many packets as the pool, so there is room
+            packetQueue_.push(packet);
+
+            // Wake up the task, unless it is still going to handle the previous frames
+            notification.notifyFromInterrupt();
+        }
+    }
+    else if (packet != &droppedPacket_)
+    {
+        nextPacket_ = packet;
+    }
 }
+
+SnifferPacket* SnifferCommon::takePacket(void)
+{
+    // Returns nullptr when the queue is empty
+    return packetQueue_.pop();
+}
+
+void SnifferCommon::releasePacket(SnifferPacket* packet)
+{
+    // Hand the packet back to the radio interrupt
+    packetPool_.release(packet);
+}
+
+/*================================ private ==================================*/
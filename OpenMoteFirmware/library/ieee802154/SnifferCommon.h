@@ -13,14 +13,34 @@
 #define SNIFFER_COMMON_H_
 
 #include "Board.h"
+#include "BufferPool.h"
+#include "BufferSegment.h"
 #include "Callback.h"
-#include "Mutex.h"
+#include "Notification.h"
+#include "PointerQueue.h"
 #include "Radio.h"
 
 class SnifferCommon;
 
 typedef GenericCallback<SnifferCommon> SnifferCallback;
 
+// Frames that the radio interrupt can store while the task is still sending,
+// has to be a power of two
+#define SNIFFER_QUEUE_LENGTH    ( 8 )
+
+// Segments of an output frame: header, radio payload, padding and status
+#define SNIFFER_FRAME_SEGMENTS  ( 4 )
+
+struct SnifferPacket
+{
+    uint8_t buffer[128];
+    uint8_t length;
+    int8_t  rssi;
+    uint8_t lqi;
+    uint8_t crc;
+    uint8_t status[2];
+};
+
 class SnifferCommon
 {
 public:
@@ -29,11 +49,15 @@ public:
     void start(void);
     void stop(void);
     void setChannel(uint8_t channel);
+    void setDestination(const uint8_t* address);
     virtual void processRadioFrame(void) = 0;
-    void initFrame(uint8_t* buffer, uint8_t length, int8_t rssi, uint8_t lqi, uint8_t crc);
+    uint32_t initFrame(SnifferPacket* packet, BufferSegment* segments);
+    uint32_t getDroppedPackets(void);
 protected:
     void radioRxInitCallback(void);
     void radioRxDoneCallback(void);
+    SnifferPacket* takePacket(void);
+    void releasePacket(SnifferPacket* packet);
 protected:
     Board board_;
     Radio radio_;
@@ -41,23 +65,26 @@ protected:
     SnifferCallback snifferRadioRxInitCallback_;
     SnifferCallback snifferRadioRxDoneCallback_;
 
-    Mutex mutex;
+    // Wakes up the task for new frames, without a kernel call for every frame
+    Notification notification;
 
     uint8_t macAddress[6];
     static const uint8_t broadcastAddress[6];
     static const uint8_t ethernetType[2];
+    static const uint8_t frameZeros[60];
 
-    uint8_t  radioBuffer[128];
-    uint8_t* radioBuffer_ptr;
-    uint8_t  radioBuffer_len;
+    // The radio interrupt takes the packets from the pool and queues them for
+    // the task, which gives them back once they were sent, without copies
+    BufferPool<SnifferPacket, SNIFFER_QUEUE_LENGTH> packetPool_;
+    PointerQueue<SnifferPacket, SNIFFER_QUEUE_LENGTH> packetQueue_;
+    SnifferPacket* nextPacket_;
+    volatile uint32_t droppedPackets_;
 
-    uint8_t  outputBuffer[255];
-    uint8_t* outputBuffer_ptr;
-    uint32_t outputBuffer_len;
+    // Frames that don't fit in the queue are read here and thrown away
+    SnifferPacket droppedPacket_;
 
-    int8_t  rssi;
-    uint8_t lqi;
-    uint8_t crc;
+    // Ethernet header in front of every frame
+    uint8_t frameHeader[14];
 };
 
 #endif /* SNIFFER_COMMON_H_ */
@@ -15,53 +15,159 @@
 
 #include "SnifferEthernet.h"
 
+#include "FreeRTOS.h"
+#include "task.h"
+
 /*================================ define ===================================*/
 
+// Offsets in a control frame, behind the Ethernet header
+#define CONTROL_ETHERTYPE_OFFSET    ( 12 )
+#define CONTROL_MAGIC_OFFSET        ( 14 )
+#define CONTROL_COMMAND_OFFSET      ( 18 )
+#define CONTROL_ADDRESS_OFFSET      ( 19 )
+#define CONTROL_FRAME_LENGTH        ( 60 )
+
 /*================================ typedef ==================================*/
 
 /*=============================== prototypes ================================*/
 
 /*=============================== variables =================================*/
 
+// Tells the control frames of the sniffer apart from other experimental protocols
+static const uint8_t controlMagic[4] = {'O', 'M', 'S', 'N'};
+
+static const uint8_t zeroAddress[6] = {0};
+
 /*================================= public ==================================*/
 
 SnifferEthernet::SnifferEthernet(Board& board, Radio& radio, Ethernet& ethernet):
-    SnifferCommon(board, radio), ethernet_(ethernet)
+    SnifferCommon(board, radio), ethernet_(ethernet), \
+    snifferEthernetRxCallback_(this, &SnifferEthernet::ethernetRxCallback), \
+    registered_(false), registeredTicks_(0), discoverTicks_(0)
 {
 }
 
 void SnifferEthernet::init(void)
 {
+    // Get the EUI48 and enable the radio
+    SnifferCommon::init();
+
     // Initialize the Ethernet with EUI48
     ethernet_.init(macAddress);
+
+    // Wake up the task when a frame is received, the ENC28J60 drops the
+    // captured frames of other sniffers after reading their header
+    ethernet_.setReceiveFilter(SNIFFER_CONTROL_ETHERTYPE);
+    ethernet_.setCallback(&snifferEthernetRxCallback_);
+
+    // Look for a collector right away
+    transmitControlFrame(broadcastAddress, SNIFFER_CONTROL_DISCOVER, zeroAddress);
+    discoverTicks_ = xTaskGetTickCount();
 }
 
 void SnifferEthernet::processRadioFrame(void)
 {
-    RadioResult result;
-
-    // This call blocks until a radio frame is received
-    if (mutex.take())
+    BufferSegment segments[SNIFFER_FRAME_SEGMENTS];
+    SnifferPacket* packet;
+    uint32_t count;
+    uint32_t now;
+
+    // This call blocks until a radio or Ethernet frame is received, or until
+    // it is time for the next discover
+    if (notification.wait(SNIFFER_DISCOVER_INTERVAL_MS))
     {
-        // Get packet from the radio
-        radioBuffer_ptr = radioBuffer;
-        radioBuffer_len = sizeof(radioBuffer);
-        result = radio_.getPacket(radioBuffer_ptr, &radioBuffer_len, &rssi, &lqi, &crc);
+        // A registration changes the destination of the frames below
+        processControlFrames();
 
-        if (result == RadioResult_Success)
+        // Send all frames that the radio interrupt stored in the meantime
+        while ((packet = takePacket()) != nullptr)
         {
-            // Turn off the radio
-            radio_.off();
+            // Put the header and trailer around the radio payload
+            count = initFrame(packet, segments);
 
-            // Initialize Ethernet frame
-            outputBuffer_ptr = outputBuffer;
-            outputBuffer_len = sizeof(outputBuffer);
-            initFrame(radioBuffer_ptr, radioBuffer_len, rssi, lqi, crc);
+            // Transmit the radio frame over Ethernet, straight from the queue
+            ethernet_.transmitFrame(segments, count);
 
-            // Transmit the radio frame over Ethernet
-            ethernet_.transmitFrame(outputBuffer_ptr, outputBuffer_len);
+            // The radio interrupt may now reuse the packet
+            releasePacket(packet);
         }
     }
+
+    now = xTaskGetTickCount();
+
+    // Fall back to the broadcast address when the collector went away
+    if (registered_ && (now - registeredTicks_ >= SNIFFER_REGISTRATION_TIMEOUT_MS / portTICK_RATE_MS))
+    {
+        registered_ = false;
+        setDestination(broadcastAddress);
+    }
+
+    // Keep asking for a collector until one registers
+    if (!registered_ && (now - discoverTicks_ >= SNIFFER_DISCOVER_INTERVAL_MS / portTICK_RATE_MS))
+    {
+        transmitControlFrame(broadcastAddress, SNIFFER_CONTROL_DISCOVER, zeroAddress);
+        discoverTicks_ = now;
+    }
 }
 
 /*================================ private ==================================*/
+
+void SnifferEthernet::ethernetRxCallback(void)
+{
+    // Wake up the task, the frame is read over SPI from there
+    notification.notifyFromInterrupt();
+}
+
+void SnifferEthernet::processControlFrames(void)
+{
+    OperationResult result;
+    uint32_t length;
+
+    // Read every frame that the ENC28J60 holds, not only the one that interrupted
+    while (true)
+    {
+        length = sizeof(controlFrame_);
+        result = ethernet_.receiveFrame(controlFrame_, &length);
+        if (length == 0)
+        {
+            break;
+        }
+
+        // Only registrations from a collector are of interest
+        if ((result != ResultSuccess) || \
+            (length < CONTROL_ADDRESS_OFFSET + 6) || \
+            (memcmp(&controlFrame_[CONTROL_MAGIC_OFFSET], controlMagic, sizeof(controlMagic)) != 0) || \
+            (controlFrame_[CONTROL_COMMAND_OFFSET] != SNIFFER_CONTROL_REGISTER))
+        {
+            continue;
+        }
+
+        // All zeros asks for the collector itself, otherwise it names a multicast group or another host
+        if (memcmp(&controlFrame_[CONTROL_ADDRESS_OFFSET], zeroAddress, 6) == 0)
+        {
+            memcpy(&controlFrame_[CONTROL_ADDRESS_OFFSET], &controlFrame_[6], 6);
+        }
+
+        setDestination(&controlFrame_[CONTROL_ADDRESS_OFFSET]);
+        registered_ = true;
+        registeredTicks_ = xTaskGetTickCount();
+
+        // Confirm to the collector where the frames go from now on
+        transmitControlFrame(&controlFrame_[6], SNIFFER_CONTROL_REGISTERED, &controlFrame_[CONTROL_ADDRESS_OFFSET]);
+    }
+}
+
+void SnifferEthernet::transmitControlFrame(const uint8_t* destination, uint8_t command, const uint8_t* address)
+{
+    uint8_t frame[CONTROL_FRAME_LENGTH] = {0};
+
+    memcpy(&frame[0], destination, 6);
+    memcpy(&frame[6], macAddress, 6);
+    frame[CONTROL_ETHERTYPE_OFFSET]     = SNIFFER_CONTROL_ETHERTYPE >> 8;
+    frame[CONTROL_ETHERTYPE_OFFSET + 1] = SNIFFER_CONTROL_ETHERTYPE & 0xFF;
+    memcpy(&frame[CONTROL_MAGIC_OFFSET], controlMagic, sizeof(controlMagic));
+    frame[CONTROL_COMMAND_OFFSET] = command;
+    memcpy(&frame[CONTROL_ADDRESS_OFFSET], address, 6);
+
+    ethernet_.transmitFrame(frame, sizeof(frame));
+}
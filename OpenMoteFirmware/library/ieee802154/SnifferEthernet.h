@@ -15,6 +15,28 @@
 #include "SnifferCommon.h"
 #include "Ethernet.h"
 
+class SnifferEthernet;
+
+typedef GenericCallback<SnifferEthernet> SnifferEthernetCallback;
+
+// Control frames between the sniffer and the collector use the IEEE 802
+// local experimental EtherType, the captured frames keep their own
+#define SNIFFER_CONTROL_ETHERTYPE           ( 0x88B5 )
+
+// Control commands: the sniffer broadcasts a discover while it has no
+// collector, the collector registers the address to send to (all zeros for
+// its own) and the sniffer confirms in a registered frame
+#define SNIFFER_CONTROL_DISCOVER            ( 0x01 )
+#define SNIFFER_CONTROL_REGISTER            ( 0x02 )
+#define SNIFFER_CONTROL_REGISTERED          ( 0x03 )
+
+// The sniffer broadcasts a discover this often without a collector
+#define SNIFFER_DISCOVER_INTERVAL_MS        ( 1000 )
+
+// A collector has to register again within this time, otherwise the frames
+// go to the broadcast address again and the sniffer looks for a new one
+#define SNIFFER_REGISTRATION_TIMEOUT_MS     ( 30000 )
+
 class SnifferEthernet : public SnifferCommon
 {
 public:
@@ -22,7 +44,21 @@ public:
     void init(void);
     void processRadioFrame(void);
 private:
-    Ethernet ethernet_;
+    void ethernetRxCallback(void);
+    void processControlFrames(void);
+    void transmitControlFrame(const uint8_t* destination, uint8_t command, const uint8_t* address);
+private:
+    Ethernet& ethernet_;
+
+    SnifferEthernetCallback snifferEthernetRxCallback_;
+
+    // Whether a collector registered, and when it last did
+    bool registered_;
+    uint32_t registeredTicks_;
+    uint32_t discoverTicks_;
+
+    // Control frames are read here, other frames never leave the ENC28J60
+    uint8_t controlFrame_[64];
 };
 
 #endif /* SNIFFER_ETHERNET_H_ */
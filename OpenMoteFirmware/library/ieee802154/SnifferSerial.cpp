@@ -32,28 +32,24 @@ SnifferSerial::SnifferSerial(Board& board, Radio& radio, Serial& serial):
 
 void SnifferSerial::processRadioFrame(void)
 {
-    RadioResult result;
+    BufferSegment segments[SNIFFER_FRAME_SEGMENTS];
+    SnifferPacket* packet;
+    uint32_t count;
 
     // This call blocks until a radio frame is received
-    if (mutex.take())
+    if (notification.wait())
     {
-        // Get packet from the radio
-        radioBuffer_ptr = radioBuffer;
-        radioBuffer_len = sizeof(radioBuffer);
-        result = radio_.getPacket(radioBuffer_ptr, &radioBuffer_len, &rssi, &lqi, &crc);
-
-        if (result == RadioResult_Success)
+        // Send all frames that the radio interrupt stored in the meantime
+        while ((packet = takePacket()) != nullptr)
         {
-            // Turn off the radio
-            radio_.off();
+            // Put the header and trailer around the radio payload
+            count = initFrame(packet, segments);
 
-            // Initialize Serial frame
-            outputBuffer_ptr = outputBuffer;
-            outputBuffer_len = sizeof(outputBuffer);
-            initFrame(radioBuffer_ptr, radioBuffer_len, rssi, lqi, crc);
+            // Transmit the radio frame over Serial, straight from the queue
+            serial_.write(segments, count);
 
-            // Transmit the radio frame over Serial
-            serial_.write(outputBuffer_ptr, outputBuffer_len);
+            // The radio interrupt may now reuse the packet
+            releasePacket(packet);
         }
     }
 }
@@ -0,0 +1,58 @@
+/**
+ * @file       BufferPool.h
+ * @author     Bruno Van de Velde (bruno@texus.me)
+ * @version    v0.1
+ * @date       October, 2026
+ * @brief
+ *
+ * @copyright  This file is licensed under the GNU General Public License v2.
+ */
+
+#ifndef BUFFER_POOL_H_
+#define BUFFER_POOL_H_
+
+#include <stdint.h>
+
+#include "PointerQueue.h"
+
+/*****************************************************************************/
+
+// Fixed set of buffers that move between the stages of a pipeline by
+// reference. The free buffers are kept in a PointerQueue, so one side (e.g.
+// an interrupt) takes them and one side (e.g. the last task) gives them back,
+// in any order.
+template<typename T, uint32_t N>
+class BufferPool
+{
+public:
+    BufferPool()
+    {
+        for (uint32_t i = 0; i < N; i++)
+        {
+            free_.push(&buffers_[i]);
+        }
+    }
+
+    uint32_t getFree(void)
+    {
+        return free_.getSize();
+    }
+
+    T* allocate(void)
+    {
+        // Returns nullptr when all buffers are in use
+        return free_.pop();
+    }
+
+    void release(T* buffer)
+    {
+        // The queue has room for every buffer, so this can't fail
+        free_.push(buffer);
+    }
+
+private:
+    T buffers_[N];
+    PointerQueue<T, N> free_;
+};
+
+#endif /* BUFFER_POOL_H_ */
@@ -0,0 +1,23 @@
+/**
+ * @file       BufferSegment.h
+ * @author     Bruno Van de Velde (bruno@texus.me)
+ * @version    v0.1
+ * @date       October, 2026
+ * @brief      Part of a frame that is sent together with the other segments,
+ *             without copying them into one buffer first.
+ *
+ * @copyright  This file is licensed under the GNU General Public License v2.
+ */
+
+#ifndef BUFFER_SEGMENT_H_
+#define BUFFER_SEGMENT_H_
+
+#include <stdint.h>
+
+struct BufferSegment
+{
+    const uint8_t* data;
+    uint32_t length;
+};
+
+#endif /* BUFFER_SEGMENT_H_ */
@@ -53,4 +53,23 @@ private:
 
 /*****************************************************************************/
 
+// Binds T::method at compile time, so execute is a plain function that can be
+// put in the vector table and calls the method directly instead of going
+// through the virtual execute and the pointer-to-member of GenericCallback.
+// There is one object per instantiation, set before the interrupt is enabled.
+template<typename T, void(T:: *method)(void)>
+class StaticCallback
+{
+public:
+    static void setObject(T* object_){object = object_;}
+    static void execute(void){(object->*method)();}
+private:
+    static T* object;
+};
+
+template<typename T, void(T:: *method)(void)>
+T* StaticCallback<T, method>::object = nullptr;
+
+/*****************************************************************************/
+
 #endif /* CALLBACK_H_ */
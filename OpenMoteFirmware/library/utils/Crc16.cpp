@@ -80,6 +80,20 @@ void Crc16::set(uint8_t byte)
     crc = lut[byte ^ (uint8_t)(crc >> 8)] ^ (crc << 8);
 }
 
+void Crc16::update(const uint8_t* data, uint32_t length)
+{
+    // Keep the CRC in a register for the whole span, instead of storing it
+    // after every byte. The CC2538 has no CRC engine for arbitrary data.
+    uint16_t value = crc;
+
+    for (uint32_t i = 0; i < length; i++)
+    {
+        value = lut[data[i] ^ (uint8_t)(value >> 8)] ^ (value << 8);
+    }
+
+    crc = value;
+}
+
 bool Crc16::check(void)
 {
     return (crc == crc_ok);
@@ -21,6 +21,7 @@ public:
     void init(void);
     uint16_t get(void);
     void set(uint8_t byte);
+    void update(const uint8_t* data, uint32_t length);
     bool check(void);
 private:
     uint16_t crc;
@@ -27,8 +27,8 @@ static const uint8_t HDLC_ESCAPE_MASK = 0x20;
 
 /*================================= public ==================================*/
 
-Hdlc::Hdlc(CircularBuffer& rxCircularBuffer, CircularBuffer& txCircularBuffer):
-    rxCircularBuffer_(rxCircularBuffer), txCircularBuffer_(txCircularBuffer)
+Hdlc::Hdlc(RingBuffer& rxRingBuffer, RingBuffer& txRingBuffer):
+    rxRingBuffer_(rxRingBuffer), txRingBuffer_(txRingBuffer)
 {
 }
 
@@ -76,6 +76,72 @@ HdlcResult Hdlc::rxPut(uint8_t byte)
     return result;
 }
 
+HdlcResult Hdlc::rxPut(const uint8_t* buffer, uint32_t size)
+{
+    uint8_t* output;
+    uint32_t space;
+    uint32_t written = 0;
+    uint8_t byte;
+
+    // The bytes are decoded straight into the contiguous free space of the
+    // receive buffer, the CRC is updated over them at once
+    space = rxRingBuffer_.peekWrite(&output);
+
+    for (uint32_t i = 0; i < size; i++)
+    {
+        byte = buffer[i];
+
+        // Same states as the single byte rxPut, bytes after the end of the
+        // frame are ignored until the next rxOpen
+        if (rxStatus == HdlcStatus_Idle && rxLastByte == HDLC_FLAG && byte != HDLC_FLAG)
+        {
+            rxStatus = HdlcStatus_Busy;
+        }
+        else if (rxStatus == HdlcStatus_Busy && byte == HDLC_FLAG)
+        {
+            rxStatus = HdlcStatus_Done;
+            rxLastByte = byte;
+            continue;
+        }
+
+        rxLastByte = byte;
+        if (rxStatus != HdlcStatus_Busy)
+        {
+            continue;
+        }
+
+        if (byte == HDLC_ESCAPE)
+        {
+            rxIsEscaping = true;
+            continue;
+        }
+
+        if (rxIsEscaping == true)
+        {
+            byte = byte ^ HDLC_ESCAPE_MASK;
+            rxIsEscaping = false;
+        }
+
+        // Continue at the start of the receive buffer once the end is reached
+        if (written == space)
+        {
+            rxCrc.update(output, written);
+            rxRingBuffer_.commitWrite(written);
+            written = 0;
+
+            space = rxRingBuffer_.peekWrite(&output);
+            if (space == 0) return HdlcResult_Error;
+        }
+
+        output[written++] = byte;
+    }
+
+    rxCrc.update(output, written);
+    rxRingBuffer_.commitWrite(written);
+
+    return HdlcResult_Ok;
+}
+
 HdlcStatus Hdlc::getRxStatus(void){
     return rxStatus;
 }
@@ -98,7 +164,7 @@ HdlcResult Hdlc::txOpen(void)
     txCrc.init();
 
     // Write the opening HDLC flag to the transmit buffer
-    status = txCircularBuffer_.write(HDLC_FLAG);
+    status = txRingBuffer_.write(HDLC_FLAG);
     if (!status) return HdlcResult_Error;
 
     return HdlcResult_Ok;
@@ -115,7 +181,7 @@ HdlcResult Hdlc::txPut(uint8_t byte)
     if (byte == HDLC_FLAG || byte == HDLC_ESCAPE)
     {
         // If so, write an HDLC escape symbol to the transmit buffer
-        status = txCircularBuffer_.write(HDLC_ESCAPE);
+        status = txRingBuffer_.write(HDLC_ESCAPE);
         if (!status) return HdlcResult_Error;
 
         // Transform the current byte
@@ -123,22 +189,65 @@ HdlcResult Hdlc::txPut(uint8_t byte)
     }
 
     // Write the current byte to the transmit buffer
-    status = txCircularBuffer_.write(byte);
+    status = txRingBuffer_.write(byte);
     if (!status) return HdlcResult_Error;
 
     return HdlcResult_Ok;
 }
 
-HdlcResult Hdlc::txPut(uint8_t* buffer, int32_t size)
+HdlcResult Hdlc::txPut(const uint8_t* buffer, int32_t size)
 {
-    HdlcResult status = HdlcResult_Ok;
+    uint8_t* output;
+    uint32_t space;
+    uint32_t written;
+    uint8_t byte;
+    bool status;
+
+    // The CRC covers the bytes before they are escaped
+    txCrc.update(buffer, size);
 
-    while (size-- && status == HdlcResult_Ok)
+    while (size > 0)
     {
-        status = txPut(*buffer++);
+        // Escape the bytes straight into the contiguous free space of the
+        // transmit buffer, the rest goes to the start of the buffer after it
+        space = txRingBuffer_.peekWrite(&output);
+        if (space == 0) return HdlcResult_Error;
+
+        written = 0;
+        while (size > 0 && written < space)
+        {
+            byte = *buffer;
+            if (byte == HDLC_FLAG || byte == HDLC_ESCAPE)
+            {
+                // Only one byte is left before the end of the buffer
+                if (space - written < 2) break;
+
+                output[written++] = HDLC_ESCAPE;
+                byte ^= HDLC_ESCAPE_MASK;
+            }
+
+            output[written++] = byte;
+            buffer++;
+            size--;
+        }
+
+        txRingBuffer_.commitWrite(written);
+
+        // An escaped byte continues at the start of the buffer
+        if (size > 0 && written < space)
+        {
+            status = txRingBuffer_.write(HDLC_ESCAPE);
+            if (!status) return HdlcResult_Error;
+
+            status = txRingBuffer_.write(*buffer ^ HDLC_ESCAPE_MASK);
+            if (!status) return HdlcResult_Error;
+
+            buffer++;
+            size--;
+        }
     }
 
-    return status;
+    return HdlcResult_Ok;
 }
 
 HdlcResult Hdlc::txClose(void)
@@ -146,22 +255,19 @@ HdlcResult Hdlc::txClose(void)
     HdlcResult result;
     uint32_t status;
     uint16_t crc;
-    uint8_t byte;
+    uint8_t bytes[2];
 
     // Get the CRC value
     crc = txCrc.get();
 
-    // Write the CRC value to the transmit buffer
-    byte = (crc >> 8) & 0xFF;
-    result = txPut(byte);
-    if (result != HdlcResult_Ok) return HdlcResult_Error;
-
-    byte = (crc >> 0) & 0xFF;
-    result = txPut(byte);
+    // Write the CRC value to the transmit buffer, escaped like the data
+    bytes[0] = (crc >> 8) & 0xFF;
+    bytes[1] = (crc >> 0) & 0xFF;
+    result = txPut(bytes, sizeof(bytes));
     if (result != HdlcResult_Ok) return HdlcResult_Error;
 
     // Write the closing HDLC flag to the transmit buffer
-    status = txCircularBuffer_.write(HDLC_FLAG);
+    status = txRingBuffer_.write(HDLC_FLAG);
     if (!status) return HdlcResult_Error;
 
     return HdlcResult_Ok;
@@ -173,7 +279,7 @@ HdlcResult Hdlc::txClose(void)
 
 HdlcResult Hdlc::rxParse(uint8_t byte)
 {
-    int32_t status;
+    bool status;
 
     // Check the received byte
     if (byte == HDLC_ESCAPE)
@@ -193,8 +299,8 @@ HdlcResult Hdlc::rxParse(uint8_t byte)
         }
 
         // Write a byte to the receive buffer
-        status = rxCircularBuffer_.write(byte);
-        if (status == -1) return HdlcResult_Error;
+        status = rxRingBuffer_.write(byte);
+        if (!status) return HdlcResult_Error;
 
         // Push the byte to the CRC module
         rxCrc.set(byte);
@@ -14,7 +14,7 @@
 
 #include <stdint.h>
 
-#include "CircularBuffer.h"
+#include "RingBuffer.h"
 #include "Crc16.h"
 
 enum HdlcResult : int32_t
@@ -33,24 +33,25 @@ enum HdlcStatus : int32_t
 class Hdlc
 {
 public:
-    Hdlc(CircularBuffer& rxCircularBuffer, CircularBuffer& txCircularBuffer);
+    Hdlc(RingBuffer& rxRingBuffer, RingBuffer& txRingBuffer);
 
     HdlcResult rxOpen(void);
     HdlcResult rxPut(uint8_t byte);
+    HdlcResult rxPut(const uint8_t* buffer, uint32_t size);
     HdlcResult rxClose(void);
     HdlcStatus getRxStatus(void);
 
     HdlcResult txOpen(void);
     HdlcResult txPut(uint8_t byte);
-    HdlcResult txPut(uint8_t* buffer, int32_t size);
+    HdlcResult txPut(const uint8_t* buffer, int32_t size);
     HdlcResult txClose(void);
 
 private:
     HdlcResult rxParse(uint8_t byte);
 
 private:
-    CircularBuffer& rxCircularBuffer_;
-    CircularBuffer& txCircularBuffer_;
+    RingBuffer& rxRingBuffer_;
+    RingBuffer& txRingBuffer_;
 
     HdlcStatus rxStatus;
     uint8_t rxLastByte;
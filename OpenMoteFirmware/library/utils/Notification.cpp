@@ -0,0 +1,81 @@
+/**
+ * @file       Notification.cpp
+ * @author     Bruno Van de Velde (bruno@texus.me)
+ * @version    v0.1
+ * @date       October, 2026
+ * @brief
+ *
+ * @copyright  This file is licensed under the GNU General Public License v2.
+ */
+
+/*================================ include ==================================*/
+
+#include "Notification.h"
+
+/*================================ define ===================================*/
+
+/*================================ typedef ==================================*/
+
+/*=============================== variables =================================*/
+
+/*=============================== prototypes ================================*/
+
+/*================================= public ==================================*/
+
+Notification::Notification():
+    pending_(false)
+{
+    // A binary semaphore starts empty, unlike a mutex
+    semaphore_ = xSemaphoreCreateBinary();
+}
+
+Notification::~Notification()
+{
+    vSemaphoreDelete(semaphore_);
+}
+
+bool Notification::wait(void)
+{
+    bool status = (xSemaphoreTake(semaphore_, portMAX_DELAY) == pdTRUE);
+
+    // Notifications from now on wake up the task again
+    pending_ = false;
+    return status;
+}
+
+bool Notification::wait(uint32_t milliseconds)
+{
+    TickType_t timeout = milliseconds / portTICK_RATE_MS;
+    bool status = (xSemaphoreTake(semaphore_, timeout) == pdTRUE);
+
+    // Notifications from now on wake up the task again
+    pending_ = false;
+    return status;
+}
+
+void Notification::notify(void)
+{
+    if (!pending_)
+    {
+        pending_ = true;
+        xSemaphoreGive(semaphore_);
+    }
+}
+
+void Notification::notifyFromInterrupt(void)
+{
+    // The task still has to wake up from an earlier notification
+    if (pending_)
+    {
+        return;
+    }
+
+    pending_ = true;
+    priorityTaskWoken_ = pdFALSE;
+    xSemaphoreGiveFromISR(semaphore_, &priorityTaskWoken_);
+    portYIELD_FROM_ISR(priorityTaskWoken_);
+}
+
+/*=============================== protected =================================*/
+
+/*================================ private ==================================*/
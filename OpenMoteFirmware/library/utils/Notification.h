@@ -0,0 +1,37 @@
+/**
+ * @file       Notification.h
+ * @author     Bruno Van de Velde (bruno@texus.me)
+ * @version    v0.1
+ * @date       October, 2026
+ * @brief
+ *
+ * @copyright  This file is licensed under the GNU General Public License v2.
+ */
+
+#ifndef NOTIFICATION_H_
+#define NOTIFICATION_H_
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+// Wakes up a single task from interrupts or other tasks. Notifications that
+// arrive while the task hasn't woken up yet are merged into one, only the
+// first of them reaches the kernel. The task has to handle all work that was
+// queued before the notification after wait returns.
+class Notification
+{
+public:
+    Notification();
+    ~Notification();
+    bool wait(void);
+    bool wait(uint32_t milliseconds);
+    void notify(void);
+    void notifyFromInterrupt(void);
+protected:
+    SemaphoreHandle_t semaphore_;
+    volatile bool pending_;
+    BaseType_t priorityTaskWoken_;
+};
+
+#endif /* NOTIFICATION_H_ */
@@ -0,0 +1,110 @@
+/**
+ * @file       PointerQueue.h
+ * @author     Bruno Van de Velde (bruno@texus.me)
+ * @version    v0.1
+ * @date       October, 2026
+ * @brief
+ *
+ * @copyright  This file is licensed under the GNU General Public License v2.
+ */
+
+#ifndef POINTER_QUEUE_H_
+#define POINTER_QUEUE_H_
+
+#include <stdint.h>
+
+/*****************************************************************************/
+
+// Keeps the compiler from publishing an index before the item itself, which
+// is enough on the single core of the Cortex-M3
+#define POINTER_QUEUE_BARRIER() __asm volatile ("" ::: "memory")
+
+/*****************************************************************************/
+
+// Passes items by reference from one producer to one consumer, either of which
+// may be an interrupt, without locking. Like the RingBuffer, the producer only
+// writes head_ and the consumer only writes tail_, both run freely and are
+// masked on access.
+template<typename T, uint32_t N>
+class PointerQueue
+{
+    static_assert(N != 0 && (N & (N - 1)) == 0, "The length of a PointerQueue has to be a power of two");
+
+public:
+    PointerQueue():
+        head_(0), tail_(0)
+    {
+    }
+
+    uint32_t getSize(void)
+    {
+        return head_ - tail_;
+    }
+
+    bool isEmpty(void)
+    {
+        return (head_ == tail_);
+    }
+
+    bool isFull(void)
+    {
+        return (head_ - tail_ == N);
+    }
+
+    bool push(T* item)
+    {
+        uint32_t head = head_;
+
+        // Check if the queue is full
+        if (head - tail_ == N)
+        {
+            return false;
+        }
+
+        // Store the pointer before handing it to the consumer
+        items_[head & (N - 1)] = item;
+        POINTER_QUEUE_BARRIER();
+        head_ = head + 1;
+
+        return true;
+    }
+
+    T* peek(void)
+    {
+        uint32_t tail = tail_;
+
+        // Check if the queue is empty
+        if (head_ == tail)
+        {
+            return nullptr;
+        }
+
+        return items_[tail & (N - 1)];
+    }
+
+    T* pop(void)
+    {
+        uint32_t tail = tail_;
+        T* item;
+
+        // Check if the queue is empty
+        if (head_ == tail)
+        {
+            return nullptr;
+        }
+
+        // Read the pointer before handing its place back to the producer
+        item = items_[tail & (N - 1)];
+        POINTER_QUEUE_BARRIER();
+        tail_ = tail + 1;
+
+        return item;
+    }
+
+private:
+    T* items_[N];
+    volatile uint32_t head_;
+    volatile uint32_t tail_;
+};
+
+#endif /* POINTER_QUEUE_H_ */
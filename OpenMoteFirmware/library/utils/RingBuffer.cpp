@@ -0,0 +1,198 @@
+/**
+ * @file       RingBuffer.cpp
+ * @author     Bruno Van de Velde (bruno@texus.me)
+ * @version    v0.1
+ * @date       October, 2026
+ * @brief
+ *
+ * @copyright  This file is licensed under the GNU General Public License v2.
+ */
+
+/*================================ include ==================================*/
+
+#include "RingBuffer.h"
+
+#include <string.h>
+
+/*================================ define ===================================*/
+
+// The producer only writes head_ and the consumer only writes tail_. Both
+// indices run freely and are masked on access, so head_ - tail_ is the number
+// of bytes in the buffer even after they wrap around. The barrier keeps the
+// compiler from moving the copy of the data past the update of the index,
+// which is enough on the single core of the Cortex-M3.
+#define RING_BUFFER_BARRIER()   __asm volatile ("" ::: "memory")
+
+/*================================ typedef ==================================*/
+
+/*=============================== variables =================================*/
+
+/*=============================== prototypes ================================*/
+
+/*================================= public ==================================*/
+
+RingBuffer::RingBuffer(uint8_t* buffer, uint32_t length):
+    buffer_(buffer), length_(length), mask_(length - 1), head_(0), tail_(0)
+{
+    // The indices are masked, so the length has to be a power of two
+    if (length == 0 || (length & (length - 1)) != 0) {
+        while (true);
+    }
+}
+
+void RingBuffer::reset(void)
+{
+    // Only safe while neither the producer nor the consumer is using the buffer
+    head_ = 0;
+    tail_ = 0;
+}
+
+uint32_t RingBuffer::getSize(void)
+{
+    return head_ - tail_;
+}
+
+uint32_t RingBuffer::getFree(void)
+{
+    return length_ - (head_ - tail_);
+}
+
+bool RingBuffer::isEmpty(void)
+{
+    return (head_ == tail_);
+}
+
+bool RingBuffer::isFull(void)
+{
+    return (head_ - tail_ == length_);
+}
+
+bool RingBuffer::read(uint8_t* data)
+{
+    uint32_t tail = tail_;
+
+    // Check if buffer is empty
+    if (head_ == tail)
+    {
+        return false;
+    }
+
+    // Read the byte before handing its place back to the producer
+    *data = buffer_[tail & mask_];
+    RING_BUFFER_BARRIER();
+    tail_ = tail + 1;
+
+    return true;
+}
+
+bool RingBuffer::read(uint8_t* buffer, uint32_t length)
+{
+    uint32_t tail = tail_;
+    uint32_t offset;
+    uint32_t first;
+
+    // Only read when all bytes are available
+    if (head_ - tail < length)
+    {
+        return false;
+    }
+
+    // Copy the bytes up to the end of the buffer and the rest from the start
+    offset = tail & mask_;
+    first = length_ - offset;
+    if (first > length) first = length;
+    memcpy(buffer, &buffer_[offset], first);
+    memcpy(buffer + first, buffer_, length - first);
+
+    RING_BUFFER_BARRIER();
+    tail_ = tail + length;
+
+    return true;
+}
+
+bool RingBuffer::write(uint8_t data)
+{
+    uint32_t head = head_;
+
+    // Check if buffer is full
+    if (head - tail_ == length_)
+    {
+        return false;
+    }
+
+    // Store the byte before making it visible to the consumer
+    buffer_[head & mask_] = data;
+    RING_BUFFER_BARRIER();
+    head_ = head + 1;
+
+    return true;
+}
+
+bool RingBuffer::write(const uint8_t* data, uint32_t length)
+{
+    uint32_t head = head_;
+    uint32_t offset;
+    uint32_t first;
+
+    // Only write when all bytes fit
+    if (length_ - (head - tail_) < length)
+    {
+        return false;
+    }
+
+    // Copy the bytes up to the end of the buffer and the rest to the start
+    offset = head & mask_;
+    first = length_ - offset;
+    if (first > length) first = length;
+    memcpy(&buffer_[offset], data, first);
+    memcpy(buffer_, data + first, length - first);
+
+    RING_BUFFER_BARRIER();
+    head_ = head + length;
+
+    return true;
+}
+
+uint32_t RingBuffer::peekRead(const uint8_t** data)
+{
+    uint32_t tail = tail_;
+    uint32_t offset = tail & mask_;
+    uint32_t size = head_ - tail;
+
+    // Only the bytes up to the end of the buffer are contiguous
+    *data = &buffer_[offset];
+    if (size > length_ - offset) size = length_ - offset;
+
+    return size;
+}
+
+void RingBuffer::commitRead(uint32_t length)
+{
+    // Hand the bytes that were processed in place back to the producer
+    RING_BUFFER_BARRIER();
+    tail_ = tail_ + length;
+}
+
+uint32_t RingBuffer::peekWrite(uint8_t** data)
+{
+    uint32_t head = head_;
+    uint32_t offset = head & mask_;
+    uint32_t size = length_ - (head - tail_);
+
+    // Only the space up to the end of the buffer is contiguous
+    *data = &buffer_[offset];
+    if (size > length_ - offset) size = length_ - offset;
+
+    return size;
+}
+
+void RingBuffer::commitWrite(uint32_t length)
+{
+    // Make the bytes that were written in place visible to the consumer
+    RING_BUFFER_BARRIER();
+    head_ = head_ + length;
+}
+
+/*=============================== protected =================================*/
+
+/*================================ private ==================================*/
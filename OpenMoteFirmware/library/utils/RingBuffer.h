@@ -0,0 +1,43 @@
+/**
+ * @file       RingBuffer.h
+ * @author     Bruno Van de Velde (bruno@texus.me)
+ * @version    v0.1
+ * @date       October, 2026
+ * @brief      Lock-free circular buffer for a single producer and a single
+ *             consumer, e.g. an interrupt handler and a task. The length has
+ *             to be a power of two.
+ *
+ * @copyright  This file is licensed under the GNU General Public License v2.
+ */
+
+#ifndef RING_BUFFER_H_
+#define RING_BUFFER_H_
+
+#include <stdint.h>
+
+class RingBuffer
+{
+public:
+    RingBuffer(uint8_t* buffer, uint32_t length);
+    void reset(void);
+    uint32_t getSize(void);
+    uint32_t getFree(void);
+    bool isEmpty(void);
+    bool isFull(void);
+    bool read(uint8_t* data);
+    bool read(uint8_t* buffer, uint32_t length);
+    bool write(uint8_t data);
+    bool write(const uint8_t* data, uint32_t length);
+    uint32_t peekRead(const uint8_t** data);
+    void commitRead(uint32_t length);
+    uint32_t peekWrite(uint8_t** data);
+    void commitWrite(uint32_t length);
+private:
+    uint8_t* buffer_;
+    uint32_t length_;
+    uint32_t mask_;
+    volatile uint32_t head_;
+    volatile uint32_t tail_;
+};
+
+#endif /* RING_BUFFER_H_ */
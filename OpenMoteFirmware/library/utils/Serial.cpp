@@ -20,6 +20,7 @@
 /*=============================== variables =================================*/
 
 static const uint8_t CRC_LENGTH = 2;    // Length of the CRC
+static const uint8_t UART_FIFO_LENGTH = 16; // Bytes that the RX FIFO of the UART holds
 
 /*=============================== prototypes ================================*/
 
@@ -28,7 +29,7 @@ static const uint8_t CRC_LENGTH = 2;    // Length of the CRC
 Serial::Serial(Uart& uart):
     uart_(uart), \
     rxBuffer_(receive_buffer_, sizeof(receive_buffer_)), \
-    txBuffer_(transmit_buffer_, sizeof(transmit_buffer_)), \
+    txBuffer_(transmit_buffer_, sizeof(transmit_buffer_)), txDmaLength_(0), \
     hdlc_(rxBuffer_, txBuffer_), \
     rxCallback_(this, &Serial::rxCallback), txCallback_(this, &Serial::txCallback)
 {
@@ -40,20 +41,23 @@ void Serial::init(void)
     uart_.setRxCallback(&rxCallback_);
     uart_.setTxCallback(&txCallback_);
 
-    // Enable UART interrupts
+    // Enable UART interrupts, a read waits until the RX interrupt received a frame
     uart_.enableInterrupts();
 
-    // Lock the UART receive
-    uart_.rxLock();
-
     // Open the HDLC receive buffer
     hdlc_.rxOpen();
 }
 
 void Serial::write(uint8_t* data, uint32_t size)
+{
+    BufferSegment segment = {data, size};
+
+    write(&segment, 1);
+}
+
+void Serial::write(const BufferSegment* segments, uint32_t count)
 {
     HdlcResult result = HdlcResult_Ok;
-    uint8_t byte;
     bool status;
 
     // Take the UART lock
@@ -66,21 +70,23 @@ void Serial::write(uint8_t* data, uint32_t size)
     result = hdlc_.txOpen();
     if (result != HdlcResult_Ok) goto error;
 
-    // For each byte in the buffer
-    result = hdlc_.txPut(data, size);
-    if (result != HdlcResult_Ok) goto error;
+    // Encode the segments as a single frame
+    for (uint32_t i = 0; i < count; i++)
+    {
+        result = hdlc_.txPut(segments[i].data, segments[i].length);
+        if (result != HdlcResult_Ok) goto error;
+    }
 
     // Close the HDLC buffer
     result = hdlc_.txClose();
     if (result != HdlcResult_Ok) goto error;
 
-    // Read first byte from the UART transmit buffer
-    status = txBuffer_.read(&byte);
+    // Fill the UART FIFO, the TX interrupt can't take bytes at the same time
+    uart_.disableTxInterrupt();
+    status = txStart();
+    if (!uart_.isDmaEnabled()) uart_.enableTxInterrupt();
     if (status != true) goto error;
 
-    // Write first byte to the UART
-    uart_.writeByte(byte);
-
     return;
 
 error:
@@ -95,7 +101,6 @@ error:
 
 uint32_t Serial::read(uint8_t* buffer, uint32_t size)
 {
-    uint8_t data;
     uint32_t length;
 
     // Lock the UART receive
@@ -108,14 +113,7 @@ uint32_t Serial::read(uint8_t* buffer, uint32_t size)
     if (length <= size)
     {
         // Copy all bytes to the buffer except the CRC bytes
-        while (size--) {
-            rxBuffer_.read(&data);
-            *buffer++ = data;
-        }
-
-        // Read the CRC bytes from the buffer
-        rxBuffer_.read(&data);
-        rxBuffer_.read(&data);
+        rxBuffer_.read(buffer, length);
     }
     else
     {
@@ -139,27 +137,40 @@ void Serial::rxCallback(void)
 {
     HdlcStatus status;
     HdlcResult result;
-    uint8_t byte;
-
-    // Read byte from the UART
-    byte = uart_.readByte();
+    uint8_t bytes[UART_FIFO_LENGTH];
+    uint32_t length;
+    bool done;
 
-    // Put the byte in the HDLC receive buffer
-    result = hdlc_.rxPut(byte);
-    if (result == HdlcResult_Error) goto error;
+    // Empty the UART FIFO
+    while (uart_.canReadByte())
+    {
+        // Read the bytes that are in the FIFO, and decode them at once
+        length = 0;
+        while (length < sizeof(bytes) && uart_.canReadByte())
+        {
+            bytes[length++] = uart_.readByte();
+        }
 
-    // Get the HDLC status
-    status = hdlc_.getRxStatus();
+        // A frame that was already done waits for the task to read it
+        done = (hdlc_.getRxStatus() == HdlcStatus_Done);
 
-     // If HDLC frame is completed
-    if (status == HdlcStatus_Done)
-    {
-        // Close the HDLC frame
-        result = hdlc_.rxClose();
+        // Put the bytes in the HDLC receive buffer
+        result = hdlc_.rxPut(bytes, length);
         if (result == HdlcResult_Error) goto error;
 
-        // Once done, free the UART lock
-        uart_.rxUnlockFromInterrupt();
+        // Get the HDLC status
+        status = hdlc_.getRxStatus();
+
+        // If HDLC frame is completed
+        if (!done && status == HdlcStatus_Done)
+        {
+            // Close the HDLC frame
+            result = hdlc_.rxClose();
+            if (result == HdlcResult_Error) goto error;
+
+            // Once done, free the UART lock
+            uart_.rxUnlockFromInterrupt();
+        }
     }
 
     return;
@@ -176,17 +187,43 @@ error:
 
 void Serial::txCallback(void)
 {
+    // The bytes of the finished uDMA transfer can be overwritten
+    txBuffer_.commitRead(txDmaLength_);
+    txDmaLength_ = 0;
+
+    // Send the next bytes from the UART transmit buffer
+    if (txStart() != true)
+    {
+        // Once done, free the UART lock
+        uart_.txUnlockFromInterrupt();
+    }
+}
+
+bool Serial::txStart(void)
+{
+    const uint8_t* data;
     uint8_t byte;
 
-    // Read byte from the UART transmit buffer
-    if (txBuffer_.read(&byte) == true)
+    // Check if there is anything left to send
+    if (txBuffer_.isEmpty())
+    {
+        return false;
+    }
+
+    if (uart_.isDmaEnabled())
     {
-        // Write byte to the UART
-        uart_.writeByte(byte);
+        // Let the uDMA send the contiguous bytes, they are released in txCallback
+        txDmaLength_ = txBuffer_.peekRead(&data);
+        txDmaLength_ = uart_.writeDma(data, txDmaLength_);
     }
     else
     {
-        // Once done, free the UART lock
-        uart_.txUnlockFromInterrupt();
+        // Fill the UART FIFO up to its depth
+        while (uart_.canWriteByte() && txBuffer_.read(&byte))
+        {
+            uart_.writeByte(byte);
+        }
     }
+
+    return true;
 }
@@ -16,7 +16,8 @@
 
 #include "Uart.h"
 
-#include "CircularBuffer.h"
+#include "RingBuffer.h"
+#include "BufferSegment.h"
 #include "Hdlc.h"
 
 class Serial;
@@ -29,18 +30,21 @@ public:
     Serial(Uart& uart);
     void init(void);
     void write(uint8_t* data, uint32_t size);
+    void write(const BufferSegment* segments, uint32_t count);
     uint32_t read(uint8_t* buffer, uint32_t size);
 private:
     void rxCallback(void);
     void txCallback(void);
+    bool txStart(void);
 private:
     Uart& uart_;
 
     uint8_t receive_buffer_[256];
-    CircularBuffer rxBuffer_;
+    RingBuffer rxBuffer_;
 
     uint8_t transmit_buffer_[256];
-    CircularBuffer txBuffer_;
+    RingBuffer txBuffer_;
+    uint32_t txDmaLength_;
 
     Hdlc hdlc_;
 
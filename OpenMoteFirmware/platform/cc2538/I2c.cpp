@@ -13,6 +13,7 @@
 
 #include "Board.h"
 #include "I2c.h"
+#include "InterruptHandler.h"
 
 #include "cc2538_include.h"
 
@@ -32,7 +33,8 @@ const uint32_t I2C_MAX_DELAY_TICKS = I2C_MAX_DELAY_US / Board::BOARD_TICKS_PER_U
 /*================================= public ==================================*/
 
 I2c::I2c(uint32_t peripheral, GpioI2c& scl, GpioI2c& sda):
-    peripheral_(peripheral), scl_(scl), sda_(sda)
+    peripheral_(peripheral), head_(nullptr), tail_(nullptr), txIndex_(0), rxIndex_(0), \
+    receiving_(false), stopping_(false), scl_(scl), sda_(sda)
 {
 }
 
@@ -221,10 +223,229 @@ bool I2c::writeByte(uint8_t address, uint8_t* buffer, uint8_t size)
     return true;
 }
 
+void I2c::enableInterrupts(void)
+{
+    // Register the interrupt handler
+    InterruptHandler::getInstance().setInterruptHandler(this);
+
+    // Enable the I2C master interrupt
+    I2CMasterIntClear();
+    I2CMasterIntEnable();
+
+    // Set the I2C interrupt priority
+    IntPrioritySet(INT_I2C0, (7 << 5));
+
+    // Enable the I2C interrupt
+    IntEnable(INT_I2C0);
+}
+
+void I2c::disableInterrupts(void)
+{
+    // Disable the I2C master interrupt
+    I2CMasterIntDisable();
+
+    // Disable the I2C interrupt
+    IntDisable(INT_I2C0);
+}
+
+bool I2c::transfer(I2cTransaction* transaction)
+{
+    bool interruptsDisabled;
+
+    // The transaction has to move data and can't be queued twice
+    if ((transaction->txSize == 0 && transaction->rxSize == 0) ||
+        (transaction->completed == false))
+    {
+        return false;
+    }
+
+    transaction->completed = false;
+    transaction->succeeded = false;
+    transaction->next_ = nullptr;
+
+    // The queue is shared with the interrupt and with other tasks, so it is
+    // only changed with the interrupts disabled (this also works from the
+    // callback of another transaction)
+    interruptsDisabled = IntMasterDisable();
+
+    if (head_ == nullptr)
+    {
+        // The bus is idle, start right away
+        head_ = transaction;
+        tail_ = transaction;
+        startTransaction();
+    }
+    else
+    {
+        // Start after the transactions that are already waiting
+        tail_->next_ = transaction;
+        tail_ = transaction;
+    }
+
+    if (!interruptsDisabled) IntMasterEnable();
+
+    return true;
+}
+
 /*=============================== protected =================================*/
 
 void I2c::interruptHandler(void)
 {
+    I2cTransaction* transaction = head_;
+    uint32_t error;
+
+    // Clear the I2C master interrupt
+    I2CMasterIntClear();
+
+    // Without queued transactions the interrupt belongs to the blocking functions
+    if (transaction == nullptr) return;
+
+    // The bus was released after an error
+    if (stopping_)
+    {
+        stopping_ = false;
+        finishTransaction(false);
+        return;
+    }
+
+    // Check for a missing acknowledge or lost arbitration
+    error = I2CMasterErr();
+    if (error != I2C_MASTER_ERR_NONE)
+    {
+        if (error & I2C_MASTER_ERR_ARB_LOST)
+        {
+            // Another master has the bus, there is nothing to release
+            finishTransaction(false);
+        }
+        else
+        {
+            // Send a stop condition and finish when it is done
+            stopping_ = true;
+            I2CMasterControl(receiving_ ? I2C_MASTER_CMD_BURST_RECEIVE_ERROR_STOP :
+                                          I2C_MASTER_CMD_BURST_SEND_ERROR_STOP);
+        }
+        return;
+    }
+
+    if (!receiving_)
+    {
+        // Write the next byte, the stop condition follows the last one
+        // unless bytes have to be read afterwards
+        if (txIndex_ < transaction->txSize)
+        {
+            I2CMasterDataPut(transaction->txBuffer[txIndex_++]);
+
+            if (txIndex_ == transaction->txSize && transaction->rxSize == 0)
+            {
+                I2CMasterControl(I2C_MASTER_CMD_BURST_SEND_FINISH);
+            }
+            else
+            {
+                I2CMasterControl(I2C_MASTER_CMD_BURST_SEND_CONT);
+            }
+        }
+        else if (transaction->rxSize == 0)
+        {
+            finishTransaction(true);
+        }
+        else
+        {
+            startReceive();
+        }
+        return;
+    }
+
+    // Read data from I2C
+    transaction->rxBuffer[rxIndex_++] = I2CMasterDataGet();
+
+    if (rxIndex_ == transaction->rxSize)
+    {
+        finishTransaction(true);
+    }
+    else if (rxIndex_ + 1 == transaction->rxSize)
+    {
+        // The last byte is not acknowledged and followed by a stop condition
+        I2CMasterControl(I2C_MASTER_CMD_BURST_RECEIVE_FINISH);
+    }
+    else
+    {
+        I2CMasterControl(I2C_MASTER_CMD_BURST_RECEIVE_CONT);
+    }
 }
 
 /*================================ private ==================================*/
+
+void I2c::startTransaction(void)
+{
+    I2cTransaction* transaction = head_;
+
+    txIndex_ = 0;
+    rxIndex_ = 0;
+
+    if (transaction->txSize == 0)
+    {
+        startReceive();
+        return;
+    }
+
+    receiving_ = false;
+
+    // Write operation
+    I2CMasterSlaveAddrSet(transaction->address, false);
+
+    // Write the first byte, the interrupt takes care of the others
+    I2CMasterDataPut(transaction->txBuffer[txIndex_++]);
+
+    if (transaction->txSize == 1 && transaction->rxSize == 0)
+    {
+        I2CMasterControl(I2C_MASTER_CMD_SINGLE_SEND);
+    }
+    else
+    {
+        I2CMasterControl(I2C_MASTER_CMD_BURST_SEND_START);
+    }
+}
+
+void I2c::startReceive(void)
+{
+    I2cTransaction* transaction = head_;
+
+    receiving_ = true;
+
+    // Read operation, after the bytes that were written this is a repeated start
+    I2CMasterSlaveAddrSet(transaction->address, true);
+
+    if (transaction->rxSize == 1)
+    {
+        I2CMasterControl(I2C_MASTER_CMD_SINGLE_RECEIVE);
+    }
+    else
+    {
+        I2CMasterControl(I2C_MASTER_CMD_BURST_RECEIVE_START);
+    }
+}
+
+void I2c::finishTransaction(bool succeeded)
+{
+    I2cTransaction* transaction = head_;
+
+    // Remove the transaction from the queue and start the next one before the
+    // callback runs, so that the bus doesn't wait for it
+    head_ = transaction->next_;
+    if (head_ == nullptr)
+    {
+        tail_ = nullptr;
+    }
+    else
+    {
+        startTransaction();
+    }
+
+    transaction->succeeded = succeeded;
+    transaction->completed = true;
+
+    if (transaction->callback != nullptr)
+    {
+        transaction->callback->execute();
+    }
+}
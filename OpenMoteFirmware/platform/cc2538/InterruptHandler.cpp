@@ -31,6 +31,13 @@
 
 /*=============================== variables =================================*/
 
+#if INTERRUPT_DIRECT_RADIO
+extern Radio INTERRUPT_DIRECT_RADIO_OBJECT;
+#endif
+#if INTERRUPT_DIRECT_UART0
+extern Uart INTERRUPT_DIRECT_UART0_OBJECT;
+#endif
+
 InterruptHandler InterruptHandler::instance_;
 
 GpioIn* InterruptHandler::GPIOA_interruptVector_[8];
@@ -311,6 +318,14 @@ void InterruptHandler::setInterruptHandler(Uart * uart_)
     if (base == UART0_BASE)
     {
         UART0_interruptVector_ = uart_;
+
+#if INTERRUPT_DIRECT_UART0
+        // The board uart is bound at build time, another object keeps the wrapper
+        if (uart_ == &INTERRUPT_DIRECT_UART0_OBJECT)
+        {
+            UARTIntRegister(UART0_BASE, UART0_DirectHandler);
+        }
+#endif
     }
     else if (base == UART1_BASE)
     {
@@ -327,6 +342,11 @@ void InterruptHandler::clearInterruptHandler(Uart * uart_)
     if (base == UART0_BASE)
     {
         UART0_interruptVector_ = nullptr;
+
+#if INTERRUPT_DIRECT_UART0
+        // Restore the wrapper in the vector table
+        UARTIntRegister(UART0_BASE, UART0_InterruptHandler);
+#endif
     }
     else if (base == UART1_BASE)
     {
@@ -382,12 +402,29 @@ void InterruptHandler::setInterruptHandler(Radio * radio_)
 {
     // Store a pointer to the RADIO object in the interrupt vector
     Radio_interruptVector_ = radio_;
+
+#if INTERRUPT_DIRECT_RADIO
+    // The board radio is bound at build time, another object keeps the wrappers
+    if (radio_ == &INTERRUPT_DIRECT_RADIO_OBJECT)
+    {
+        IntRegister(INT_RFCORERTX, RFCore_DirectHandler);
+        IntRegister(INT_RFCOREERR, RFError_DirectHandler);
+        IntRegister(INT_UDMA, UDMA_DirectHandler);
+    }
+#endif
 }
 
 void InterruptHandler::clearInterruptHandler(Radio * radio_)
 {
     // Remove the pointer to the RADIO object in the interrupt vector
     Radio_interruptVector_ = nullptr;
+
+#if INTERRUPT_DIRECT_RADIO
+    // Restore the wrappers in the vector table
+    IntRegister(INT_RFCORERTX, RFCore_InterruptHandler);
+    IntRegister(INT_RFCOREERR, RFError_InterruptHandler);
+    IntRegister(INT_UDMA, UDMA_InterruptHandler);
+#endif
 }
 
 void InterruptHandler::setInterruptHandler(SleepTimer * sleepTimer_)
@@ -410,6 +447,81 @@ void InterruptHandler::clearInterruptHandler(RadioTimer * radioimer_)
     RadioTimer_interruptVector_ = nullptr;
 }
 
+void InterruptHandler::setStaticInterruptHandler(uint32_t interrupt, callback_t handler)
+{
+    // Replace the entry in the vector table
+    IntRegister(interrupt, handler);
+}
+
+void InterruptHandler::clearStaticInterruptHandler(uint32_t interrupt)
+{
+    // Restore the dispatch through the peripheral objects
+    switch (interrupt)
+    {
+    case INT_GPIOA:
+        GPIOPortIntRegister(GPIO_A_BASE, GPIOA_InterruptHandler);
+        break;
+    case INT_GPIOB:
+        GPIOPortIntRegister(GPIO_B_BASE, GPIOB_InterruptHandler);
+        break;
+    case INT_GPIOC:
+        GPIOPortIntRegister(GPIO_C_BASE, GPIOC_InterruptHandler);
+        break;
+    case INT_GPIOD:
+        GPIOPortIntRegister(GPIO_D_BASE, GPIOD_InterruptHandler);
+        break;
+    case INT_TIMER0A:
+    case INT_TIMER0B:
+        IntRegister(interrupt, TIMER0_InterruptHandler);
+        break;
+    case INT_TIMER1A:
+    case INT_TIMER1B:
+        IntRegister(interrupt, TIMER1_InterruptHandler);
+        break;
+    case INT_TIMER2A:
+    case INT_TIMER2B:
+        IntRegister(interrupt, TIMER2_InterruptHandler);
+        break;
+    case INT_TIMER3A:
+    case INT_TIMER3B:
+        IntRegister(interrupt, TIMER3_InterruptHandler);
+        break;
+    case INT_UART0:
+        UARTIntRegister(UART0_BASE, UART0_InterruptHandler);
+        break;
+    case INT_UART1:
+        UARTIntRegister(UART1_BASE, UART1_InterruptHandler);
+        break;
+    case INT_I2C0:
+        I2CIntRegister(I2C_InterruptHandler);
+        break;
+    case INT_SSI0:
+        SSIIntRegister(SSI0_BASE, SPI0_InterruptHandler);
+        break;
+    case INT_SSI1:
+        SSIIntRegister(SSI1_BASE, SPI1_InterruptHandler);
+        break;
+    case INT_RFCORERTX:
+        IntRegister(INT_RFCORERTX, RFCore_InterruptHandler);
+        break;
+    case INT_RFCOREERR:
+        IntRegister(INT_RFCOREERR, RFError_InterruptHandler);
+        break;
+    case INT_UDMA:
+        IntRegister(INT_UDMA, UDMA_InterruptHandler);
+        break;
+    case INT_SMTIM:
+        SleepModeIntRegister(SleepTimer_InterruptHandler);
+        break;
+    case INT_MACTIMR:
+        IntRegister(INT_MACTIMR, RadioTimer_InterruptHandler);
+        break;
+    default:
+        IntUnregister(interrupt);
+        break;
+    }
+}
+
 /*=============================== protected =================================*/
 
 /*================================ private ==================================*/
@@ -454,6 +566,9 @@ InterruptHandler::InterruptHandler()
     IntRegister(INT_RFCORERTX, RFCore_InterruptHandler);
     IntRegister(INT_RFCOREERR, RFError_InterruptHandler);
 
+    // Register the uDMA software interrupt handler, used by the RADIO
+    IntRegister(INT_UDMA, UDMA_InterruptHandler);
+
     // Register the SleepTimer interrupt handler
     SleepModeIntRegister(SleepTimer_InterruptHandler);
 
@@ -837,6 +952,44 @@ inline void InterruptHandler::RFError_InterruptHandler(void)
     Radio_interruptVector_->errorHandler();
 }
 
+inline void InterruptHandler::UDMA_InterruptHandler(void)
+{
+    // Call the RADIO uDMA interrupt handler
+    if (Radio_interruptVector_ != nullptr)
+    {
+        Radio_interruptVector_->dmaHandler();
+    }
+}
+
+#if INTERRUPT_DIRECT_RADIO
+void InterruptHandler::RFCore_DirectHandler(void)
+{
+    // Call the RF CORE interrupt handler of the board radio
+    INTERRUPT_DIRECT_RADIO_OBJECT.interruptHandler();
+}
+
+void InterruptHandler::RFError_DirectHandler(void)
+{
+    // Call the RF ERROR interrupt handler of the board radio
+    INTERRUPT_DIRECT_RADIO_OBJECT.errorHandler();
+}
+
+void InterruptHandler::UDMA_DirectHandler(void)
+{
+    // Call the uDMA interrupt handler of the board radio, it is only in the
+    // vector table while the radio is registered
+    INTERRUPT_DIRECT_RADIO_OBJECT.dmaHandler();
+}
+#endif
+
+#if INTERRUPT_DIRECT_UART0
+void InterruptHandler::UART0_DirectHandler(void)
+{
+    // Call the interrupt handler of the board uart
+    INTERRUPT_DIRECT_UART0_OBJECT.interruptHandler();
+}
+#endif
+
 inline void InterruptHandler::SleepTimer_InterruptHandler(void)
 {
     // Call the SleepTimer interrupt handler
@@ -38,6 +38,12 @@
 #define CC2538_RF_MAX_PACKET_LEN                ( 127 )
 #define CC2538_RF_MIN_PACKET_LEN                ( 3 )
 
+// Shorter packets are faster to copy on the CPU than setting up the uDMA
+#define CC2538_RF_DMA_MIN_LENGTH                ( 16 )
+
+// Software uDMA channel that copies the packets out of the RX FIFO
+#define CC2538_RF_DMA_CHANNEL                   ( UDMA_CH30_SW )
+
 // Defines for the CCA (Clear Channel Assessment)
 #define CC2538_RF_CCA_CLEAR                     ( 0x01 )
 #define CC2538_RF_CCA_BUSY                      ( 0x00 )
@@ -86,7 +92,9 @@
 Radio::Radio():
     radioState_(RadioState_Off), \
     rxInit_(nullptr), rxDone_(nullptr), \
-    txInit_(nullptr), txDone_(nullptr)
+    txInit_(nullptr), txDone_(nullptr), \
+    dma_(false), dmaDone_(nullptr), \
+    dmaRssi_(nullptr), dmaLqi_(nullptr), dmaCrc_(nullptr)
 {
 }
 
@@ -154,6 +162,37 @@ void Radio::enable(void)
     HWREG(RFCORE_XREG_FREQCTRL)    = CC2538_RF_CHANNEL_MIN;
 }
 
+void Radio::enableDma(void)
+{
+    uint32_t channel = CC2538_RF_DMA_CHANNEL & 0xFF;
+
+    /* The uDMA itself must already be enabled with a channel control table */
+    uDMAChannelAssign(CC2538_RF_DMA_CHANNEL);
+
+    /* Only software requests start the channel, it copies the whole packet in one go */
+    uDMAChannelAttributeDisable(channel, UDMA_ATTR_ALL);
+    uDMAChannelAttributeEnable(channel, UDMA_ATTR_REQMASK | UDMA_ATTR_HIGH_PRIORITY);
+    uDMAChannelControlSet(channel | UDMA_PRI_SELECT, \
+                          UDMA_SIZE_8 | UDMA_SRC_INC_NONE | UDMA_DST_INC_8 | UDMA_ARB_128);
+
+    /* The end of a software transfer raises the uDMA interrupt */
+    IntPrioritySet(INT_UDMA, (7 << 5));
+    IntEnable(INT_UDMA);
+
+    dma_ = true;
+}
+
+void Radio::disableDma(void)
+{
+    /* Wait for an ongoing copy to finish */
+    while (uDMAChannelIsEnabled(CC2538_RF_DMA_CHANNEL & 0xFF))
+        ;
+
+    IntDisable(INT_UDMA);
+
+    dma_ = false;
+}
+
 void Radio::sleep(void)
 {
     off();
@@ -313,6 +352,12 @@ void Radio::receive(void)
         ;
 }
 
+void Radio::receiveNext(void)
+{
+    /* Keep listening after getPacket, the receiver is still on */
+    radioState_ = RadioState_ReceiveInit;
+}
+
 /**
  * When loading a packet to the RX buffer, the following is expected:
  * - *[1B]      Length (not required)
@@ -372,61 +417,60 @@ RadioResult Radio::loadPacket(uint8_t* data, uint8_t length)
  */
 RadioResult Radio::getPacket(uint8_t* buffer, uint8_t* length, int8_t* rssi, uint8_t* lqi, uint8_t* crc)
 {
-    uint8_t packetLength;
-    uint8_t scratch;
-
-    /* Check if the radio state is correct */
-    if (radioState_ != RadioState_ReceiveDone)
+    /* Check the packet that is waiting in the RX buffer */
+    if (checkPacket(length) != RadioResult_Success)
     {
         /* Return error */
         return RadioResult_Error;
     }
 
-    /* Check the packet length (first byte) */
-    packetLength = HWREG(RFCORE_SFR_RFDATA);
-
-    /* Check if packet is too long or too short */
-    if ((packetLength > CC2538_RF_MAX_PACKET_LEN) ||
-        (packetLength <= CC2538_RF_MIN_PACKET_LEN))
-    {
-        /* Flush the RX buffer */
-        CC2538_RF_CSP_ISFLUSHRX();
+    /* Copy the RX buffer to the buffer (except for the CRC) */
+    copyPacket(buffer, *length);
 
-        /* Return error */
-        return RadioResult_Error;
-    }
+    /* Read the RSSI and CRC and release the RX buffer */
+    finishPacket(rssi, lqi, crc);
 
-    /* Account for the CRC bytes */
-    packetLength -= 2;
+    return RadioResult_Success;
+}
 
-    /* Check if the packet fits in the buffer */
-    if (packetLength > *length)
+/**
+ * Starts copying the packet and executes the callback once the buffer, RSSI,
+ * LQI and CRC are filled in. With the uDMA enabled, the callback is executed
+ * from the uDMA interrupt and the radio state stays ReceiveDone until then.
+ * Short packets and packets without the uDMA are copied before returning.
+ */
+RadioResult Radio::getPacket(uint8_t* buffer, uint8_t* length, int8_t* rssi, uint8_t* lqi, uint8_t* crc, Callback* done)
+{
+    /* Check the packet that is waiting in the RX buffer */
+    if (checkPacket(length) != RadioResult_Success)
     {
-        /* Flush the RX buffer */
-        CC2538_RF_CSP_ISFLUSHRX();
-
         /* Return error */
         return RadioResult_Error;
     }
 
-    /* Copy the RX buffer to the buffer (except for the CRC) */
-    for (uint8_t i = 0; i < packetLength; i++)
+    /* Let the uDMA copy the packet while the caller continues */
+    if (dma_ && *length >= CC2538_RF_DMA_MIN_LENGTH)
     {
-        buffer[i] = HWREG(RFCORE_SFR_RFDATA);
+        dmaRssi_ = rssi;
+        dmaLqi_  = lqi;
+        dmaCrc_  = crc;
+        dmaDone_ = done;
+
+        startDma(buffer, *length);
+
+        return RadioResult_Success;
     }
 
-    /* Update the packet length, RSSI and CRC */
-    *length    = packetLength;
-    *rssi      = ((int8_t) (HWREG(RFCORE_SFR_RFDATA)) - CC2538_RF_RSSI_OFFSET);
-    scratch    = HWREG(RFCORE_SFR_RFDATA);
-    *crc       = scratch & CC2538_RF_CRC_BITMASK;
-    *lqi       = scratch & CC2538_RF_LQI_BITMASK;
+    /* Copy the RX buffer to the buffer (except for the CRC) */
+    copyPacket(buffer, *length);
 
-    /* Flush the RX buffer */
-    CC2538_RF_CSP_ISFLUSHRX();
+    /* Read the RSSI and CRC and release the RX buffer */
+    finishPacket(rssi, lqi, crc);
 
-    /* Set the radio state to receive */
-    radioState_ = RadioState_Idle;
+    if (done != nullptr)
+    {
+        done->execute();
+    }
 
     return RadioResult_Success;
 }
@@ -506,6 +550,35 @@ void Radio::interruptHandler(void)
     }
 }
 
+void Radio::dmaHandler(void)
+{
+    uint32_t channel = CC2538_RF_DMA_CHANNEL & 0xFF;
+    Callback* done;
+
+    /* The interrupt is shared with the other software channels */
+    if ((HWREG(UDMA_CHIS) & (1 << channel)) == 0)
+    {
+        return;
+    }
+
+    /* Clear the completion status of the channel */
+    HWREG(UDMA_CHIS) = (1 << channel);
+
+    /* Finish the packet that getPacket started copying */
+    done = dmaDone_;
+    if (radioState_ == RadioState_ReceiveDone && dmaRssi_ != nullptr)
+    {
+        finishPacket(dmaRssi_, dmaLqi_, dmaCrc_);
+        dmaRssi_ = nullptr;
+        dmaDone_ = nullptr;
+
+        if (done != nullptr)
+        {
+            done->execute();
+        }
+    }
+}
+
 void Radio::errorHandler(void)
 {
     uint32_t irq_error;
@@ -531,3 +604,99 @@ void Radio::errorHandler(void)
 }
 
 /*================================ private ==================================*/
+
+RadioResult Radio::checkPacket(uint8_t* length)
+{
+    uint8_t packetLength;
+
+    /* Check if the radio state is correct */
+    if (radioState_ != RadioState_ReceiveDone)
+    {
+        /* Return error */
+        return RadioResult_Error;
+    }
+
+    /* Check the packet length (first byte) */
+    packetLength = HWREG(RFCORE_SFR_RFDATA);
+
+    /* Check if packet is too long or too short */
+    if ((packetLength > CC2538_RF_MAX_PACKET_LEN) ||
+        (packetLength <= CC2538_RF_MIN_PACKET_LEN))
+    {
+        /* Flush the RX buffer */
+        CC2538_RF_CSP_ISFLUSHRX();
+
+        /* Return error */
+        return RadioResult_Error;
+    }
+
+    /* Account for the CRC bytes */
+    packetLength -= 2;
+
+    /* Check if the packet fits in the buffer */
+    if (packetLength > *length)
+    {
+        /* Flush the RX buffer */
+        CC2538_RF_CSP_ISFLUSHRX();
+
+        /* Return error */
+        return RadioResult_Error;
+    }
+
+    /* Update the packet length */
+    *length = packetLength;
+
+    return RadioResult_Success;
+}
+
+void Radio::copyPacket(uint8_t* buffer, uint8_t length)
+{
+    uint32_t channel = CC2538_RF_DMA_CHANNEL & 0xFF;
+
+    /* Let the uDMA copy long packets and wait until it is done */
+    if (dma_ && length >= CC2538_RF_DMA_MIN_LENGTH)
+    {
+        dmaRssi_ = nullptr;
+        startDma(buffer, length);
+
+        while (uDMAChannelIsEnabled(channel))
+            ;
+
+        /* Nothing is left for the uDMA interrupt to do */
+        HWREG(UDMA_CHIS) = (1 << channel);
+        return;
+    }
+
+    for (uint8_t i = 0; i < length; i++)
+    {
+        buffer[i] = HWREG(RFCORE_SFR_RFDATA);
+    }
+}
+
+void Radio::startDma(uint8_t* buffer, uint8_t length)
+{
+    uint32_t channel = CC2538_RF_DMA_CHANNEL & 0xFF;
+
+    /* Copy from the RX FIFO register into the buffer */
+    uDMAChannelTransferSet(channel | UDMA_PRI_SELECT, UDMA_MODE_AUTO, \
+                           (void*) RFCORE_SFR_RFDATA, (void*) buffer, length);
+    uDMAChannelEnable(channel);
+    uDMAChannelRequest(channel);
+}
+
+void Radio::finishPacket(int8_t* rssi, uint8_t* lqi, uint8_t* crc)
+{
+    uint8_t scratch;
+
+    /* Update the RSSI and CRC */
+    *rssi      = ((int8_t) (HWREG(RFCORE_SFR_RFDATA)) - CC2538_RF_RSSI_OFFSET);
+    scratch    = HWREG(RFCORE_SFR_RFDATA);
+    *crc       = scratch & CC2538_RF_CRC_BITMASK;
+    *lqi       = scratch & CC2538_RF_LQI_BITMASK;
+
+    /* Flush the RX buffer */
+    CC2538_RF_CSP_ISFLUSHRX();
+
+    /* Set the radio state to receive */
+    radioState_ = RadioState_Idle;
+}
@@ -18,6 +18,15 @@
 
 /*================================ define ===================================*/
 
+// Shorter transfers are faster on the CPU than setting up the uDMA
+#define SPI_DMA_MIN_LENGTH          ( 16 )
+
+// Maximum number of bytes in a single uDMA transfer
+#define SPI_DMA_MAX_TRANSFER        ( 1024 )
+
+// Depth of the receive FIFO, the transactions never have more bytes underway
+#define SPI_FIFO_LENGTH             ( 8 )
+
 /*================================ typedef ==================================*/
 
 /*=============================== variables =================================*/
@@ -29,7 +38,12 @@
 Spi::Spi(uint32_t peripheral, uint32_t base, uint32_t clock, \
          GpioSpi& miso, GpioSpi& mosi, GpioSpi& clk, GpioSpi& ncs):
         peripheral_(peripheral), base_(base), clock_(clock), \
-        miso_(miso), mosi_(mosi), clk_(clk), ncs_(ncs)
+        interrupt_((base == SSI0_BASE) ? INT_SSI0 : INT_SSI1), \
+        miso_(miso), mosi_(mosi), clk_(clk), ncs_(ncs), \
+        dma_(false), dmaRxChannel_(0), dmaTxChannel_(0), \
+        rx_callback_(nullptr), tx_callback_(nullptr), \
+        head_(nullptr), tail_(nullptr), receiving_(false), partDma_(false), \
+        txIndex_(0), rxIndex_(0), dmaLength_(0)
 {
 }
 
@@ -77,6 +91,47 @@ void Spi::enable(uint32_t mode, uint32_t protocol, uint32_t datawidth, uint32_t
     SSIEnable(base_);
 }
 
+void Spi::enableDma(void)
+{
+    uint32_t rxChannel, txChannel;
+
+    // The uDMA itself must already be enabled with a channel control table
+    if (base_ == SSI0_BASE)
+    {
+        rxChannel = UDMA_CH10_SSI0RX;
+        txChannel = UDMA_CH11_SSI0TX;
+    }
+    else
+    {
+        rxChannel = UDMA_CH24_SSI1RX;
+        txChannel = UDMA_CH25_SSI1TX;
+    }
+
+    // Assign the SSI to the channels
+    uDMAChannelAssign(rxChannel);
+    uDMAChannelAssign(txChannel);
+
+    dmaRxChannel_ = rxChannel & 0xFF;
+    dmaTxChannel_ = txChannel & 0xFF;
+
+    // The RX FIFO is only 8 bytes deep, so it goes before other channels
+    uDMAChannelAttributeDisable(dmaRxChannel_, UDMA_ATTR_ALL);
+    uDMAChannelAttributeDisable(dmaTxChannel_, UDMA_ATTR_ALL);
+    uDMAChannelAttributeEnable(dmaRxChannel_, UDMA_ATTR_HIGH_PRIORITY);
+
+    // Let the SSI request the uDMA
+    SSIDMAEnable(base_, SSI_DMA_TX | SSI_DMA_RX);
+
+    dma_ = true;
+}
+
+void Spi::disableDma(void)
+{
+    SSIDMADisable(base_, SSI_DMA_TX | SSI_DMA_RX);
+
+    dma_ = false;
+}
+
 void Spi::sleep(void)
 {
     SSIDisable(base_);
@@ -115,8 +170,15 @@ void Spi::enableInterrupts(void)
     // Register the interrupt handler
     InterruptHandler::getInstance().setInterruptHandler(this);
 
-    // Enable the SPI interrupt
-    SSIIntEnable(base_, (SSI_TXFF | SSI_RXFF | SSI_RXTO | SSI_RXOR));
+    // The FIFO interrupts are only enabled for the callbacks, the transactions
+    // enable the receive interrupts themselves while they use the FIFO
+    if (rx_callback_ != nullptr || tx_callback_ != nullptr)
+    {
+        SSIIntEnable(base_, (SSI_TXFF | SSI_RXFF | SSI_RXTO | SSI_RXOR));
+    }
+
+    // Set the SPI interrupt priority
+    IntPrioritySet(interrupt_, (7 << 5));
 
     // Enable the SPI interrupt
     IntEnable(interrupt_);
@@ -133,28 +195,12 @@ void Spi::disableInterrupts(void)
 
 void Spi::select(void)
 {
-    if (protocol_ == SSI_FRF_MOTO_MODE_0 ||
-        protocol_ == SSI_FRF_MOTO_MODE_1)
-    {
-        ncs_.low();
-    }
-    else
-    {
-        ncs_.high();
-    }
+    setChipSelect(ncs_, true);
 }
 
 void Spi::deselect(void)
 {
-    if (protocol_ == SSI_FRF_MOTO_MODE_0 ||
-        protocol_ == SSI_FRF_MOTO_MODE_1)
-    {
-        ncs_.high();
-    }
-    else
-    {
-        ncs_.low();
-    }
+    setChipSelect(ncs_, false);
 }
 
 uint8_t Spi::readByte(void)
@@ -178,6 +224,13 @@ uint32_t Spi::readByte(uint8_t* buffer, uint32_t length)
 {
     uint32_t data;
 
+    // Let the uDMA clock out zeros and store the received bytes
+    if (dma_ && length >= SPI_DMA_MIN_LENGTH)
+    {
+        transferDma(nullptr, buffer, length);
+        return 0;
+    }
+
     for (uint32_t i =  0; i < length; i++)
     {
         // Push a byte
@@ -210,10 +263,17 @@ void Spi::writeByte(uint8_t byte)
     SSIDataGet(base_, &data);
 }
 
-uint32_t Spi::writeByte(uint8_t* buffer, uint32_t length)
+uint32_t Spi::writeByte(const uint8_t* buffer, uint32_t length)
 {
     uint32_t data;
 
+    // Let the uDMA send the bytes and throw away what is received
+    if (dma_ && length >= SPI_DMA_MIN_LENGTH)
+    {
+        transferDma(buffer, nullptr, length);
+        return 0;
+    }
+
     for (uint32_t i = 0; i < length; i++)
     {
         // Push a byte
@@ -230,6 +290,44 @@ uint32_t Spi::writeByte(uint8_t* buffer, uint32_t length)
     return 0;
 }
 
+bool Spi::transfer(SpiTransaction* transaction)
+{
+    bool interruptsDisabled;
+
+    // The transaction has to move data and can't be queued twice
+    if ((transaction->txSize == 0 && transaction->rxSize == 0) ||
+        (transaction->completed == false))
+    {
+        return false;
+    }
+
+    transaction->completed = false;
+    transaction->next_ = nullptr;
+
+    // The queue is shared with the interrupt and with other tasks, so it is
+    // only changed with the interrupts disabled (this also works from the
+    // callback of another transaction)
+    interruptsDisabled = IntMasterDisable();
+
+    if (head_ == nullptr)
+    {
+        // The bus is idle, start right away
+        head_ = transaction;
+        tail_ = transaction;
+        startTransaction();
+    }
+    else
+    {
+        // Start after the transactions that are already waiting
+        tail_->next_ = transaction;
+        tail_ = transaction;
+    }
+
+    if (!interruptsDisabled) IntMasterEnable();
+
+    return true;
+}
+
 /*=============================== protected =================================*/
 
 void Spi::interruptHandler(void)
@@ -242,6 +340,21 @@ void Spi::interruptHandler(void)
     // Clear SPI interrupt in the NVIC
     IntPendClear(interrupt_);
 
+    // The transactions use the receive interrupts or the completion of the
+    // receive channel of the uDMA, which is signaled on the SPI interrupt
+    if (head_ != nullptr)
+    {
+        SSIIntClear(base_, SSI_RXTO | SSI_RXOR);
+        continuePart();
+        return;
+    }
+
+    // The blocking uDMA transfers wait for the channels themselves
+    if (dma_)
+    {
+        HWREG(UDMA_CHIS) = (1 << dmaRxChannel_) | (1 << dmaTxChannel_);
+    }
+
     // Process TX interrupt
     if (status & SSI_TXFF) {
         interruptHandlerTx();
@@ -270,3 +383,198 @@ void Spi::interruptHandlerTx(void)
         rx_callback_->execute();
     }
 }
+
+void Spi::transferDma(const uint8_t* txBuffer, uint8_t* rxBuffer, uint32_t length)
+{
+    while (length > 0)
+    {
+        uint32_t transferLength = startDma(txBuffer, rxBuffer, length);
+
+        // The RX channel finishes last, once the last byte has been clocked in
+        while (uDMAChannelIsEnabled(dmaRxChannel_))
+            ;
+
+        // Clear the completion flags, the SSI interrupt is not used for the transfers
+        HWREG(UDMA_CHIS) = (1 << dmaRxChannel_) | (1 << dmaTxChannel_);
+
+        if (txBuffer) txBuffer += transferLength;
+        if (rxBuffer) rxBuffer += transferLength;
+        length -= transferLength;
+    }
+}
+
+uint32_t Spi::startDma(const uint8_t* txBuffer, uint8_t* rxBuffer, uint32_t length)
+{
+    static const uint8_t txDummy = 0x00;
+    static uint8_t rxDummy;
+
+    void* data = (void*)(base_ + SSI_O_DR);
+
+    uint32_t transferLength = (length > SPI_DMA_MAX_TRANSFER) ? SPI_DMA_MAX_TRANSFER : length;
+
+    // Without a buffer, the same dummy byte is send or overwritten every time
+    uDMAChannelControlSet(dmaRxChannel_ | UDMA_PRI_SELECT, UDMA_SIZE_8 | UDMA_SRC_INC_NONE | \
+                          (rxBuffer ? UDMA_DST_INC_8 : UDMA_DST_INC_NONE) | UDMA_ARB_4);
+    uDMAChannelTransferSet(dmaRxChannel_ | UDMA_PRI_SELECT, UDMA_MODE_BASIC, data, \
+                           rxBuffer ? (void*)rxBuffer : (void*)&rxDummy, transferLength);
+
+    uDMAChannelControlSet(dmaTxChannel_ | UDMA_PRI_SELECT, UDMA_SIZE_8 | UDMA_DST_INC_NONE | \
+                          (txBuffer ? UDMA_SRC_INC_8 : UDMA_SRC_INC_NONE) | UDMA_ARB_4);
+    uDMAChannelTransferSet(dmaTxChannel_ | UDMA_PRI_SELECT, UDMA_MODE_BASIC, \
+                           txBuffer ? (void*)txBuffer : (void*)&txDummy, data, transferLength);
+
+    // Start receiving before sending, so that no byte is missed
+    uDMAChannelEnable(dmaRxChannel_);
+    uDMAChannelEnable(dmaTxChannel_);
+
+    return transferLength;
+}
+
+void Spi::setChipSelect(GpioSpi& ncs, bool selected)
+{
+    // The chip select is active low, except in the modes where the clock
+    // idles high
+    if (protocol_ == SSI_FRF_MOTO_MODE_0 ||
+        protocol_ == SSI_FRF_MOTO_MODE_1)
+    {
+        if (selected) ncs.low();
+        else          ncs.high();
+    }
+    else
+    {
+        if (selected) ncs.high();
+        else          ncs.low();
+    }
+}
+
+void Spi::startTransaction(void)
+{
+    SpiTransaction* transaction = head_;
+
+    // The chip select may still be asserted by the previous transaction
+    setChipSelect(transaction->chipSelect ? *transaction->chipSelect : ncs_, true);
+
+    receiving_ = (transaction->txSize == 0);
+    startPart();
+}
+
+void Spi::startPart(void)
+{
+    SpiTransaction* transaction = head_;
+    uint32_t length = receiving_ ? transaction->rxSize : transaction->txSize;
+
+    txIndex_ = 0;
+    rxIndex_ = 0;
+
+    // Long parts are moved by the uDMA, the interrupt only occurs at the end
+    partDma_ = (dma_ && length >= SPI_DMA_MIN_LENGTH);
+    if (partDma_)
+    {
+        SSIIntDisable(base_, SSI_RXFF | SSI_RXTO);
+        dmaLength_ = startDma(receiving_ ? nullptr : transaction->txBuffer, \
+                              receiving_ ? transaction->rxBuffer : nullptr, length);
+        return;
+    }
+
+    // Fill the FIFO, the receive interrupts take out the bytes and refill it.
+    // The timeout interrupt takes care of the last bytes, when the FIFO isn't
+    // half full anymore.
+    SSIIntClear(base_, SSI_RXTO | SSI_RXOR);
+    SSIIntEnable(base_, SSI_RXFF | SSI_RXTO);
+    continuePart();
+}
+
+void Spi::continuePart(void)
+{
+    SpiTransaction* transaction = head_;
+    uint32_t length = receiving_ ? transaction->rxSize : transaction->txSize;
+    uint32_t data;
+
+    if (partDma_)
+    {
+        // Wait for the receive channel, which finishes last
+        if (uDMAChannelIsEnabled(dmaRxChannel_)) return;
+
+        HWREG(UDMA_CHIS) = (1 << dmaRxChannel_) | (1 << dmaTxChannel_);
+
+        // Parts that are too long for a single transfer continue where it ended
+        txIndex_ += dmaLength_;
+        if (txIndex_ < length)
+        {
+            dmaLength_ = startDma(receiving_ ? nullptr : transaction->txBuffer + txIndex_, \
+                                  receiving_ ? transaction->rxBuffer + txIndex_ : nullptr, \
+                                  length - txIndex_);
+        }
+        else
+        {
+            finishPart();
+        }
+        return;
+    }
+
+    // Take out the bytes that were received, they are only kept while reading
+    while (rxIndex_ < txIndex_ && SSIDataGetNonBlocking(base_, &data))
+    {
+        if (receiving_) transaction->rxBuffer[rxIndex_] = (uint8_t)data;
+        rxIndex_++;
+    }
+
+    if (rxIndex_ == length)
+    {
+        finishPart();
+        return;
+    }
+
+    // Never have more bytes underway than the receive FIFO can hold
+    while (txIndex_ < length && txIndex_ - rxIndex_ < SPI_FIFO_LENGTH)
+    {
+        SSIDataPut(base_, receiving_ ? 0x00 : transaction->txBuffer[txIndex_]);
+        txIndex_++;
+    }
+}
+
+void Spi::finishPart(void)
+{
+    SpiTransaction* transaction = head_;
+
+    // The bytes are read after the ones that are written
+    if (!receiving_ && transaction->rxSize > 0)
+    {
+        receiving_ = true;
+        startPart();
+        return;
+    }
+
+    finishTransaction();
+}
+
+void Spi::finishTransaction(void)
+{
+    SpiTransaction* transaction = head_;
+
+    SSIIntDisable(base_, SSI_RXFF | SSI_RXTO);
+
+    if (!transaction->keepSelected)
+    {
+        setChipSelect(transaction->chipSelect ? *transaction->chipSelect : ncs_, false);
+    }
+
+    // Remove the transaction from the queue and start the next one before the
+    // callback runs, so that the bus doesn't wait for it
+    head_ = transaction->next_;
+    if (head_ == nullptr)
+    {
+        tail_ = nullptr;
+    }
+    else
+    {
+        startTransaction();
+    }
+
+    transaction->completed = true;
+
+    if (transaction->callback != nullptr)
+    {
+        transaction->callback->execute();
+    }
+}
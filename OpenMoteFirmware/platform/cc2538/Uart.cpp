@@ -18,6 +18,9 @@
 
 /*================================ define ===================================*/
 
+// Maximum number of bytes in a single uDMA transfer
+#define UART_DMA_MAX_TRANSFER       ( 1024 )
+
 /*================================ typedef ==================================*/
 
 /*=============================== variables =================================*/
@@ -27,7 +30,8 @@
 /*================================= public ==================================*/
 
 Uart::Uart(uint32_t peripheral, uint32_t base, uint32_t clock, uint32_t interrupt, GpioUart& rx, GpioUart& tx):
-    peripheral_(peripheral), base_(base), clock_(clock), interrupt_(interrupt), rx_(rx), tx_(tx)
+    peripheral_(peripheral), base_(base), clock_(clock), interrupt_(interrupt), rx_(rx), tx_(tx), \
+    dma_(false), dmaTxChannel_(0)
 {
 }
 
@@ -65,16 +69,58 @@ void Uart::enable(uint32_t baudrate, uint32_t config, uint32_t mode)
     // Configure the UART
     UARTConfigSetExpClk(base_, SysCtrlIOClockGet(), baudrate_, config_);
 
-    // Disable FIFO as we only use a one-byte buffer
-    UARTFIFODisable(base_);
+    // Use the 16-byte FIFOs, so that an interrupt can move several bytes at once.
+    // The receive interrupt waits for 8 bytes, the receive timeout takes the
+    // last bytes of a message when the line becomes idle.
+    UARTFIFOEnable(base_);
+    UARTFIFOLevelSet(base_, UART_FIFO_TX2_8, UART_FIFO_RX4_8);
 
-    // Raise an interrupt at the end of transmission
+    // Raise a transmit interrupt at the end of transmission or at the FIFO level
     UARTTxIntModeSet(base_, mode_);
 
     // Enable UART hardware
     UARTEnable(base_);
 }
 
+void Uart::enableDma(void)
+{
+    uint32_t txChannel;
+
+    // The uDMA itself must already be enabled with a channel control table
+    if (base_ == UART0_BASE)
+    {
+        txChannel = UDMA_CH9_UART0TX;
+    }
+    else
+    {
+        txChannel = UDMA_CH23_UART1TX;
+    }
+
+    // Assign the UART to the channel
+    uDMAChannelAssign(txChannel);
+    dmaTxChannel_ = txChannel & 0xFF;
+
+    uDMAChannelAttributeDisable(dmaTxChannel_, UDMA_ATTR_ALL);
+    uDMAChannelControlSet(dmaTxChannel_ | UDMA_PRI_SELECT, \
+                          UDMA_SIZE_8 | UDMA_SRC_INC_8 | UDMA_DST_INC_NONE | UDMA_ARB_4);
+
+    // The end of a transfer raises the UART interrupt instead of the TX interrupt
+    UARTIntDisable(base_, UART_INT_TX);
+
+    // Let the UART request the uDMA
+    UARTDMAEnable(base_, UART_DMA_TX);
+
+    dma_ = true;
+}
+
+void Uart::disableDma(void)
+{
+    UARTDMADisable(base_, UART_DMA_TX);
+    uDMAChannelDisable(dmaTxChannel_);
+
+    dma_ = false;
+}
+
 void Uart::sleep(void)
 {
     // Wait until UART is not busy
@@ -115,7 +161,14 @@ void Uart::enableInterrupts(void)
     InterruptHandler::getInstance().setInterruptHandler(this);
 
     // Enable the UART RX, TX and RX timeout interrupts
-    UARTIntEnable(base_, UART_INT_RX | UART_INT_TX | UART_INT_RT);
+    if (dma_)
+    {
+        UARTIntEnable(base_, UART_INT_RX | UART_INT_RT);
+    }
+    else
+    {
+        UARTIntEnable(base_, UART_INT_RX | UART_INT_TX | UART_INT_RT);
+    }
 
     // Set the UART interrupt priority
     IntPrioritySet(interrupt_, (7 << 5));
@@ -133,6 +186,26 @@ void Uart::disableInterrupts(void)
     IntDisable(interrupt_);
 }
 
+void Uart::enableTxInterrupt(void)
+{
+    UARTIntEnable(base_, UART_INT_TX);
+}
+
+void Uart::disableTxInterrupt(void)
+{
+    UARTIntDisable(base_, UART_INT_TX);
+}
+
+bool Uart::canReadByte(void)
+{
+    return UARTCharsAvail(base_);
+}
+
+bool Uart::canWriteByte(void)
+{
+    return UARTSpaceAvail(base_);
+}
+
 uint8_t Uart::readByte(void)
 {
     int32_t byte;
@@ -175,6 +248,22 @@ uint32_t Uart::writeByte(uint8_t * buffer, uint32_t length)
     return 0;
 }
 
+uint32_t Uart::writeDma(const uint8_t* buffer, uint32_t length)
+{
+    // The rest is send after the interrupt of this transfer
+    if (length > UART_DMA_MAX_TRANSFER)
+    {
+        length = UART_DMA_MAX_TRANSFER;
+    }
+
+    // Let the uDMA copy the bytes into the FIFO
+    uDMAChannelTransferSet(dmaTxChannel_ | UDMA_PRI_SELECT, UDMA_MODE_BASIC, \
+                           (void*) buffer, (void*) (base_ + UART_O_DR), length);
+    uDMAChannelEnable(dmaTxChannel_);
+
+    return length;
+}
+
 /*=============================== protected =================================*/
 
 void Uart::interruptHandler(void)
@@ -194,6 +283,14 @@ void Uart::interruptHandler(void)
         interruptHandlerTx();
     }
 
+    // Process the end of a uDMA transfer, which keeps raising the interrupt
+    // until its completion status is cleared
+    if (dma_ && (HWREG(UDMA_CHIS) & (1 << dmaTxChannel_)))
+    {
+        HWREG(UDMA_CHIS) = (1 << dmaTxChannel_);
+        interruptHandlerTx();
+    }
+
     // Process RX interrupt
     if (status & UART_INT_RX ||
         status & UART_INT_RT)
@@ -20,6 +20,36 @@
 
 class Gpio;
 
+// A transfer that the I2C interrupt carries out in the background: the bytes
+// of txBuffer are written first and then rxSize bytes are read into rxBuffer
+// after a repeated start, either of them can be empty. The object and its
+// buffers must stay valid until completed is true, the callback is executed
+// from the interrupt right after that.
+class I2cTransaction
+{
+
+friend class I2c;
+
+public:
+    I2cTransaction(uint8_t address_ = 0, \
+                   const uint8_t* txBuffer_ = nullptr, uint8_t txSize_ = 0, \
+                   uint8_t* rxBuffer_ = nullptr, uint8_t rxSize_ = 0, \
+                   Callback* callback_ = nullptr):
+                   address(address_), txBuffer(txBuffer_), txSize(txSize_), \
+                   rxBuffer(rxBuffer_), rxSize(rxSize_), callback(callback_), \
+                   completed(true), succeeded(false), next_(nullptr){}
+    uint8_t address;
+    const uint8_t* txBuffer;
+    uint8_t txSize;
+    uint8_t* rxBuffer;
+    uint8_t rxSize;
+    Callback* callback;
+    volatile bool completed;
+    volatile bool succeeded;
+private:
+    I2cTransaction* next_;
+};
+
 class I2c
 {
 
@@ -37,12 +67,27 @@ public:
     bool readByte(uint8_t address, uint8_t* buffer, uint8_t size);
     bool writeByte(uint8_t address, uint8_t byte);
     bool writeByte(uint8_t address, uint8_t* buffer, uint8_t size);
+    void enableInterrupts(void);
+    void disableInterrupts(void);
+    bool transfer(I2cTransaction* transaction);
+    bool isIdle(void) {return (head_ == nullptr);}
 protected:
     void interruptHandler(void);
+private:
+    void startTransaction(void);
+    void startReceive(void);
+    void finishTransaction(bool succeeded);
 private:
     uint32_t peripheral_;
     uint32_t clock_;
 
+    I2cTransaction* volatile head_;
+    I2cTransaction* tail_;
+    uint8_t txIndex_;
+    uint8_t rxIndex_;
+    bool receiving_;
+    bool stopping_;
+
     Mutex mutex_;
 
     GpioI2c& scl_;
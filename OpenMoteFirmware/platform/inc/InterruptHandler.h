@@ -12,6 +12,27 @@
 #ifndef INTERRUPT_HANDLER_H_
 #define INTERRUPT_HANDLER_H_
 
+#include <stdint.h>
+
+#include "Callback.h"
+
+// Build with INTERRUPT_DIRECT_RADIO=1 or INTERRUPT_DIRECT_UART0=1 to put the
+// handlers of the board radio or uart straight into the vector table. The
+// object is then known at build time, so the interrupt doesn't go through a
+// wrapper that first loads the object from the interrupt vector.
+#ifndef INTERRUPT_DIRECT_RADIO
+#define INTERRUPT_DIRECT_RADIO          ( 0 )
+#endif
+#ifndef INTERRUPT_DIRECT_RADIO_OBJECT
+#define INTERRUPT_DIRECT_RADIO_OBJECT   radio
+#endif
+#ifndef INTERRUPT_DIRECT_UART0
+#define INTERRUPT_DIRECT_UART0          ( 0 )
+#endif
+#ifndef INTERRUPT_DIRECT_UART0_OBJECT
+#define INTERRUPT_DIRECT_UART0_OBJECT   uart
+#endif
+
 class GpioIn;
 class GpioInPow;
 class Timer;
@@ -45,6 +66,18 @@ public:
     static void clearInterruptHandler(SleepTimer* sleepTimer);
     static void setInterruptHandler(RadioTimer* radioTimer);
     static void clearInterruptHandler(RadioTimer* radioTimer);
+
+    // Let the interrupt call object->method directly, bypassing the dispatch
+    // of the peripheral and its callbacks. The method has to read and clear
+    // the interrupt status itself.
+    template<typename T, void(T:: *method)(void)>
+    static void setStaticInterruptHandler(uint32_t interrupt, T* object)
+    {
+        StaticCallback<T, method>::setObject(object);
+        setStaticInterruptHandler(interrupt, StaticCallback<T, method>::execute);
+    }
+    static void setStaticInterruptHandler(uint32_t interrupt, callback_t handler);
+    static void clearStaticInterruptHandler(uint32_t interrupt);
 private:
     InterruptHandler();
     static inline void GPIOA_InterruptHandler(void);
@@ -63,8 +96,17 @@ private:
     static inline void SysTick_InterruptHandler(void);
     static inline void RFCore_InterruptHandler(void);
     static inline void RFError_InterruptHandler(void);
+    static inline void UDMA_InterruptHandler(void);
     static inline void SleepTimer_InterruptHandler(void);
     static inline void RadioTimer_InterruptHandler(void);
+#if INTERRUPT_DIRECT_RADIO
+    static void RFCore_DirectHandler(void);
+    static void RFError_DirectHandler(void);
+    static void UDMA_DirectHandler(void);
+#endif
+#if INTERRUPT_DIRECT_UART0
+    static void UART0_DirectHandler(void);
+#endif
 private:
     static InterruptHandler instance_;
     static GpioIn* GPIOA_interruptVector_[8];
@@ -42,6 +42,8 @@ friend class InterruptHandler;
 public:
     Radio();
     void enable(void);
+    void enableDma(void);
+    void disableDma(void);
     void sleep(void);
     void wakeup(void);
     void on(void);
@@ -55,11 +57,19 @@ public:
     void setPower(uint8_t power);
     void transmit(void);
     void receive(void);
+    void receiveNext(void);
     RadioResult loadPacket(uint8_t* data, uint8_t length);
     RadioResult getPacket(uint8_t* buffer, uint8_t* length, int8_t* rssi, uint8_t* lqi, uint8_t* crc);
+    RadioResult getPacket(uint8_t* buffer, uint8_t* length, int8_t* rssi, uint8_t* lqi, uint8_t* crc, Callback* done);
 protected:
     void interruptHandler(void);
     void errorHandler(void);
+    void dmaHandler(void);
+private:
+    RadioResult checkPacket(uint8_t* length);
+    void copyPacket(uint8_t* buffer, uint8_t length);
+    void startDma(uint8_t* buffer, uint8_t length);
+    void finishPacket(int8_t* rssi, uint8_t* lqi, uint8_t* crc);
 private:
     volatile RadioState radioState_;
 
@@ -67,6 +77,12 @@ private:
     Callback* rxDone_;
     Callback* txInit_;
     Callback* txDone_;
+
+    bool dma_;
+    Callback* volatile dmaDone_;
+    int8_t* dmaRssi_;
+    uint8_t* dmaLqi_;
+    uint8_t* dmaCrc_;
 };
 
 #endif /* RADIO_H_ */
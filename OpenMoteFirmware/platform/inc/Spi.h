@@ -20,6 +20,41 @@
 
 class Gpio;
 
+// A transfer that the SPI interrupt carries out in the background with the
+// chip select asserted: the bytes of txBuffer are written first and then
+// rxSize bytes are read into rxBuffer while zeros are clocked out, either of
+// them can be empty. Without a chipSelect the nCS pin of the Spi is used. With
+// keepSelected the chip select stays asserted for the next transaction in the
+// queue, e.g. for a command that is followed by a payload in another buffer.
+// Parts of at least SPI_DMA_MIN_LENGTH bytes use the uDMA when it is enabled.
+// The object and its buffers must stay valid until completed is true, the
+// callback is executed from the interrupt right after that.
+class SpiTransaction
+{
+
+friend class Spi;
+
+public:
+    SpiTransaction(const uint8_t* txBuffer_ = nullptr, uint32_t txSize_ = 0, \
+                   uint8_t* rxBuffer_ = nullptr, uint32_t rxSize_ = 0, \
+                   Callback* callback_ = nullptr, GpioSpi* chipSelect_ = nullptr, \
+                   bool keepSelected_ = false):
+                   txBuffer(txBuffer_), txSize(txSize_), \
+                   rxBuffer(rxBuffer_), rxSize(rxSize_), callback(callback_), \
+                   chipSelect(chipSelect_), keepSelected(keepSelected_), \
+                   completed(true), next_(nullptr){}
+    const uint8_t* txBuffer;
+    uint32_t txSize;
+    uint8_t* rxBuffer;
+    uint32_t rxSize;
+    Callback* callback;
+    GpioSpi* chipSelect;
+    bool keepSelected;
+    volatile bool completed;
+private:
+    SpiTransaction* next_;
+};
+
 class Spi
 {
 
@@ -30,6 +65,8 @@ public:
         GpioSpi& miso, GpioSpi& mosi, GpioSpi& clk, GpioSpi& ncs);
     uint32_t getBase(void);
     void enable(uint32_t mode, uint32_t protocol, uint32_t datawidth, uint32_t baudrate);
+    void enableDma(void);
+    void disableDma(void);
     void sleep(void);
     void wakeup(void);
     void setRxCallback(Callback* callback);
@@ -41,12 +78,22 @@ public:
     uint8_t readByte(void);
     uint32_t readByte(uint8_t * buffer, uint32_t length);
     void writeByte(uint8_t byte);
-    uint32_t writeByte(uint8_t * buffer, uint32_t length);
+    uint32_t writeByte(const uint8_t * buffer, uint32_t length);
+    bool transfer(SpiTransaction* transaction);
+    bool isIdle(void) {return (head_ == nullptr);}
 protected:
     void interruptHandler(void);
 private:
     void interruptHandlerRx();
     void interruptHandlerTx();
+    void transferDma(const uint8_t* txBuffer, uint8_t* rxBuffer, uint32_t length);
+    uint32_t startDma(const uint8_t* txBuffer, uint8_t* rxBuffer, uint32_t length);
+    void setChipSelect(GpioSpi& ncs, bool selected);
+    void startTransaction(void);
+    void startPart(void);
+    void continuePart(void);
+    void finishPart(void);
+    void finishTransaction(void);
 private:
     uint32_t peripheral_;
     uint32_t base_;
@@ -62,8 +109,20 @@ private:
     GpioSpi& clk_;
     GpioSpi& ncs_;
 
+    bool dma_;
+    uint32_t dmaRxChannel_;
+    uint32_t dmaTxChannel_;
+
     Callback* rx_callback_;
     Callback* tx_callback_;
+
+    SpiTransaction* volatile head_;
+    SpiTransaction* tail_;
+    bool receiving_;
+    bool partDma_;
+    uint32_t txIndex_;
+    uint32_t rxIndex_;
+    uint32_t dmaLength_;
 };
 
 #endif /* SPI_H_ */
@@ -17,6 +17,7 @@
 #include "Gpio.h"
 #include "Callback.h"
 #include "Mutex.h"
+#include "Notification.h"
 
 class Gpio;
 
@@ -28,23 +29,31 @@ friend class InterruptHandler;
 public:
     Uart(uint32_t peripheral, uint32_t base, uint32_t clock, uint32_t interrupt, GpioUart& rx, GpioUart& tx);
     uint32_t getBase(void);
-    void rxUnlockFromInterrupt(void) {rxMutex_.giveFromInterrupt();}
+    void rxUnlockFromInterrupt(void) {rxNotification_.notifyFromInterrupt();}
     void txUnlockFromInterrupt(void) {txMutex_.giveFromInterrupt();}
     void enable(uint32_t baudrate, uint32_t config, uint32_t mode);
+    void enableDma(void);
+    void disableDma(void);
+    bool isDmaEnabled(void) {return dma_;}
     void sleep(void);
     void wakeup(void);
     void setRxCallback(Callback* callback);
     void setTxCallback(Callback* callback);
     void enableInterrupts(void);
     void disableInterrupts(void);
-    void rxLock(void) {rxMutex_.take();}
+    void enableTxInterrupt(void);
+    void disableTxInterrupt(void);
+    void rxLock(void) {rxNotification_.wait();}
     void txLock(void) {txMutex_.take();}
-    void rxUnlock(void) {rxMutex_.give();}
+    void rxUnlock(void) {rxNotification_.notify();}
     void txUnlock(void) {txMutex_.give();}
+    bool canReadByte(void);
+    bool canWriteByte(void);
     uint8_t readByte(void);
     uint32_t readByte(uint8_t* buffer, uint32_t length);
     void writeByte(uint8_t byte);
     uint32_t writeByte(uint8_t* buffer, uint32_t length);
+    uint32_t writeDma(const uint8_t* buffer, uint32_t length);
 protected:
     void interruptHandler(void);
 private:
@@ -59,12 +68,16 @@ private:
     uint32_t config_;
     uint32_t baudrate_;
 
-    Mutex rxMutex_;
+    // Wakes up the task that waits for a received frame
+    Notification rxNotification_;
     Mutex txMutex_;
 
     GpioUart& rx_;
     GpioUart& tx_;
 
+    bool dma_;
+    uint32_t dmaTxChannel_;
+
     Callback* rx_callback_;
     Callback* tx_callback_;
 };
@@ -26,6 +26,7 @@ sys.path.append(library_path)
 # Import OpenMote libraries
 import Serial as Serial
 import TunInterface as TunInterface
+import EthernetCollector as EthernetCollector
 
 # Define logging configuration
 logging.config.fileConfig("ieee802154-sniffer.cfg", disable_existing_loggers = False)
@@ -44,7 +45,12 @@ class Sniffer():
     tun_name         = None
     tun_interface    = None
     
-    def __init__(self, sniffer_mode = None, serial_name = None, baud_rate = None, bsl_mode = None, tun_name = None):
+    ethernet_name      = None
+    ethernet_group     = None
+    ethernet_collector = None
+    
+    def __init__(self, sniffer_mode = None, serial_name = None, baud_rate = None, bsl_mode = None, tun_name = None,
+                 ethernet_name = None, ethernet_group = None):
         assert sniffer_mode != None, logger.error("Sniffer mode not defined.")
         assert serial_name  != None, logger.error("Serial port not defined.")
         assert bsl_mode     != None, logger.error("Bootloader mode not defined.")
@@ -58,6 +64,10 @@ class Sniffer():
         if (self.sniffer_mode == "serial"):
             assert tun_name != None, logger.error("TUN interface not defined.")
             self.tun_name = tun_name    
+        else:
+            assert ethernet_name != None, logger.error("Ethernet interface not defined.")
+            self.ethernet_name  = ethernet_name
+            self.ethernet_group = ethernet_group
            
     def run(self):
         stop = False
@@ -81,14 +91,30 @@ class Sniffer():
                 # Stop the serial port 
                 self.serial_port.stop()
                 return
+        else:
+            # Register as the collector of the sniffers on the Ethernet interface
+            logging.info("run: Creating the Ethernet collector.")
+            try:
+                self.ethernet_collector = EthernetCollector.EthernetCollector(interface_name = self.ethernet_name,
+                                                                              group_address = self.ethernet_group)
+            except:
+                # Stop the serial port
+                self.serial_port.stop()
+                return
             
         # Start the Serial port
         print("- Serial: Listening to port %s at %s bps." % (self.serial_name, self.baud_rate))
         self.serial_port.start()
         
-        # Start the TUN interface
-        print("- Tun:    Injecting packets to interface %s." % self.tun_name)
-        self.tun_interface.start()
+        if (self.sniffer_mode == "serial"):
+            # Start the TUN interface
+            print("- Tun:    Injecting packets to interface %s." % self.tun_name)
+            self.tun_interface.start()
+        else:
+            # Start answering the sniffers
+            print("- Ethernet: Collecting the frames of the sniffers on interface %s%s." %
+                  (self.ethernet_name, " in group " + self.ethernet_group if self.ethernet_group else ""))
+            self.ethernet_collector.start()
         
         # Define the IEEE 802.15.4 channel
         stop = self.set_radio_channel()
@@ -119,6 +145,12 @@ class Sniffer():
         if (self.sniffer_mode == "serial"):
             # Stop the TUN interface
             self.tun_interface.stop()
+            print("- Tun:    Injected %d packets, dropped %d packets that the interface couldn't keep up with." %
+                  (self.tun_interface.injected, self.tun_interface.dropped + self.tun_interface.write_errors))
+        else:
+            # Stop the Ethernet collector
+            self.ethernet_collector.stop()
+            print("- Ethernet: %d sniffers were registered." % len(self.ethernet_collector.registered()))
                     
     def set_radio_channel(self):
         channel = -1
@@ -143,7 +175,7 @@ def parse_config(config = None, arguments = None):
     assert arguments != None, logger.error("Arguments not defined.")
 
     try:
-        opts, args = getopt.getopt(arguments, "s:p:b:q:t:")
+        opts, args = getopt.getopt(arguments, "s:p:b:q:t:e:g:")
     except getopt.GetoptError as error:
         print(str(error))
         sys.exit(1)
@@ -160,6 +192,10 @@ def parse_config(config = None, arguments = None):
             config['bsl_mode'] = value
         elif option == '-t':
             config['tun_name'] = value
+        elif option == '-e':
+            config['ethernet_name'] = value
+        elif option == '-g':
+            config['ethernet_group'] = value
         else:
             assert False, logger.error("Unhandled options while parsing the command line arguments.")
        
@@ -171,7 +207,9 @@ def main():
         'serial_name' : '/dev/ttyUSB0',
         'baud_rate'   : '115200',
         'bsl_mode'    : 'true',
-        'tun_name'    : 'tun0'
+        'tun_name'    : 'tun0',
+        'ethernet_name' : 'eth0',
+        'ethernet_group': None
     }
     
     # Parse the command line arguments
@@ -183,7 +221,9 @@ def main():
                       serial_name  = config['serial_name'],
                       baud_rate    = config['baud_rate'],
                       bsl_mode     = config['bsl_mode'],
-                      tun_name     = config['tun_name'])
+                      tun_name     = config['tun_name'],
+                      ethernet_name  = config['ethernet_name'],
+                      ethernet_group = config['ethernet_group'])
     
     # Execute the sniffer
     sniffer.run()
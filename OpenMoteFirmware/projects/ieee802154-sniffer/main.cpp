@@ -160,12 +160,12 @@ static void prvSnifferTask(void *pvParameters)
     // Set the default sniffer channel
     sniffer.setChannel(SNIFFER_DEFAULT_CHANNEL);
 
+    // Start the sniffer, the radio keeps receiving while frames are sent
+    sniffer.start();
+
     while (true)
     {
-        // Start the sniffer
-        sniffer.start();
-
-        // Process a frame
+        // Process the received frames
         sniffer.processRadioFrame();
     }
 }
@@ -9,6 +9,34 @@
             This file is licensed under the GNU General Public License v2.
 '''
 
+# Import Python libraries
+import os
+import ctypes
+
+# The native library of the sniffer host (src/host of the OpenMoteSniffer) calculates the same CRC 8 bytes at a time
+HOST_LIBRARY_DIR   = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', '..', 'src', 'host')
+HOST_LIBRARY_NAMES = ['libsniffer_host.so', 'libsniffer_host.dylib', 'sniffer_host.dll']
+
+# Loads the native library when it was built, otherwise the CRC is calculated with the table
+def load_host_library():
+    for name in HOST_LIBRARY_NAMES:
+        path = os.path.join(HOST_LIBRARY_DIR, name)
+        if (not os.path.exists(path)):
+            continue
+
+        try:
+            library = ctypes.CDLL(path)
+        except OSError:
+            continue
+
+        library.snifferHostCalculateCrc.argtypes = [ctypes.c_int, ctypes.c_char_p, ctypes.c_size_t, ctypes.c_uint16]
+        library.snifferHostCalculateCrc.restype = ctypes.c_uint16
+        return library
+
+    return None
+
+host_library = load_host_library()
+
 class Crc16(object):
     __crc16_table = [
     0x0000, 0x1189, 0x2312, 0x329B, 0x4624, 0x57AD, 0x6536, 0x74BF,
@@ -53,6 +81,20 @@ class Crc16(object):
     def push(self, byte):    
         tbl_idx = ((self.crc >> 8) ^ ord(byte)) & 0xFF;
         self.crc = (self.__crc16_table[tbl_idx] ^ (self.crc << 8)) & 0xFFFF;
+
+    # Pushes all the bytes of a buffer at once
+    def update(self, data):
+        data = bytes(data)
+        if (host_library != None):
+            self.crc = host_library.snifferHostCalculateCrc(0, data, len(data), self.crc)
+            return
+
+        # Same as push, with the table and the CRC kept in local variables
+        table = self.__crc16_table
+        crc = self.crc
+        for byte in bytearray(data):
+            crc = table[(crc >> 8) ^ byte] ^ ((crc << 8) & 0xFFFF)
+        self.crc = crc
     
     def check(self):
         return (self.crc == 0)
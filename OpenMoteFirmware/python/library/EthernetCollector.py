@@ -0,0 +1,125 @@
+'''
+@file       EthernetCollector.py
+@author     Bruno Van de Velde (bruno@texus.me)
+@version    v0.1
+@date       October, 2026
+@brief      Registers this host as the collector of the Ethernet sniffers
+
+@copyright  This file is licensed under the GNU General Public License v2.
+'''
+
+# Import Python libraries
+import time
+import socket
+import struct
+import binascii
+import threading
+import logging
+
+# Import logging configuration
+logger = logging.getLogger(__name__)
+
+class EthernetCollector():
+    # Has to match SnifferEthernet.h
+    CONTROL_ETHERTYPE  = 0x88B5
+    CONTROL_MAGIC      = b'OMSN'
+    CONTROL_DISCOVER   = 0x01
+    CONTROL_REGISTER   = 0x02
+    CONTROL_REGISTERED = 0x03
+    
+    # Well within SNIFFER_REGISTRATION_TIMEOUT_MS of the sniffers, so a lost registration doesn't matter
+    REGISTER_INTERVAL = 10
+    
+    def __init__(self, interface_name = None, group_address = None):
+        logger.info("init: Creating the EthernetCollector object.")
+        
+        # Without a group the sniffers send their frames to this host
+        self.interface_name = interface_name
+        self.group_address  = self.parse_address(group_address) if group_address else b'\x00' * 6
+        
+        # Sniffers that asked for a collector, by MAC address
+        self.sniffers       = {}
+        self.lock           = threading.Lock()
+        self.thread         = None
+        self.running        = False
+        
+        try:
+            # Only the control frames are received, the captured frames are left to e.g. Wireshark
+            self.socket = socket.socket(socket.AF_PACKET, socket.SOCK_RAW, socket.htons(self.CONTROL_ETHERTYPE))
+            self.socket.bind((self.interface_name, self.CONTROL_ETHERTYPE))
+            self.socket.settimeout(1)
+            self.address = self.socket.getsockname()[4]
+        except (socket.error, AttributeError):
+            logger.error('init: Error while opening a raw socket on %s.', self.interface_name)
+            raise Exception
+        
+        logger.info("init: EthernetCollector object created.")
+    
+    @staticmethod
+    def parse_address(address):
+        octets = address.replace('-', ':').split(':')
+        if (len(octets) != 6):
+            raise ValueError('Invalid MAC address ' + address)
+        return binascii.unhexlify(''.join(octet.zfill(2) for octet in octets))
+    
+    @staticmethod
+    def format_address(address):
+        return ':'.join('%02x' % octet for octet in bytearray(address))
+    
+    def start(self):
+        logger.info("start: Starting the EthernetCollector.")
+        
+        self.running = True
+        self.thread = threading.Thread(target = self.run)
+        self.thread.setDaemon(True)
+        self.thread.start()
+    
+    def stop(self):
+        logger.info("stop: Stopping the EthernetCollector.")
+        
+        self.running = False
+        if (self.thread != None):
+            self.thread.join()
+            self.thread = None
+        self.socket.close()
+    
+    def registered(self):
+        with self.lock:
+            return [address for address, sniffer in self.sniffers.items() if sniffer['destination'] != None]
+    
+    def transmit(self, destination, command):
+        frame = destination + self.address + struct.pack('>H', self.CONTROL_ETHERTYPE) + \
+                self.CONTROL_MAGIC + struct.pack('B', command) + self.group_address
+        self.socket.send(frame.ljust(60, b'\x00'))
+    
+    # Runs the thread that answers the discovers and renews the registrations
+    def run(self):
+        while (self.running):
+            try:
+                frame = self.socket.recv(1518)
+            except socket.timeout:
+                frame = b''
+            
+            if (len(frame) >= 25 and frame[14:18] == self.CONTROL_MAGIC):
+                source  = frame[6:12]
+                command = bytearray(frame)[18]
+                if (command == self.CONTROL_DISCOVER):
+                    # A new sniffer, or one that forgot about us after a reboot, is registered below
+                    logger.info("run: Sniffer %s is looking for a collector.", self.format_address(source))
+                    with self.lock:
+                        self.sniffers[source] = {'destination': None, 'registered': 0}
+                elif (command == self.CONTROL_REGISTERED and source in self.sniffers):
+                    logger.info("run: Sniffer %s sends its frames to %s.", self.format_address(source),
+                                self.format_address(frame[19:25]))
+                    with self.lock:
+                        self.sniffers[source]['destination'] = frame[19:25]
+            
+            # Register again before the sniffers fall back to the broadcast address
+            now = time.time()
+            with self.lock:
+                renew = [address for address, sniffer in self.sniffers.items()
+                         if now - sniffer['registered'] >= self.REGISTER_INTERVAL]
+                for address in renew:
+                    self.sniffers[address]['registered'] = now
+            for address in renew:
+                self.transmit(address, self.CONTROL_REGISTER)
@@ -32,10 +32,9 @@ class Hdlc(object):
         # Make a copy of the original input
         output = ''.join(input[:])
         
-        # Check the CRC checksum
+        # Compute the CRC checksum over the whole buffer at once
         crc_engine = Crc16.Crc16()
-        for o in output:
-            crc_engine.push(o)
+        crc_engine.update(output)
         crc_result = crc_engine.get()
         
         # Append the CRC checksum
@@ -61,21 +60,21 @@ class Hdlc(object):
         # Make a copy of the original input
         output = input[1:-1]
         
-        # Replace the HDLC flags
-        output = output.replace(self.HDLC_ESCAPE + self.HDLC_FLAG_ESCAPED, self.HDLC_FLAG)
-        output = output.replace(self.HDLC_ESCAPE + self.HDLC_ESCAPE_ESCAPED, self.HDLC_ESCAPE)
+        # Replace the HDLC flags, every part after an escape byte starts with the escaped byte
+        if (self.HDLC_ESCAPE in output):
+            parts = output.split(self.HDLC_ESCAPE)
+            output = parts[0] + ''.join([chr(ord(part[0]) ^ 0x20) + part[1:] for part in parts[1:] if part])
         
         # Check output input size
         if (len(output) < 2):
             logging.error("dehldicfy: Invalid frame length!")
         
         # Get the CRC checksum
-        crc_value = int(output[-2:].encode('hex'), 16)
+        crc_value = (ord(output[-2]) << 8) | ord(output[-1])
         
         # Compute the CRC checksum
         crc_engine = Crc16.Crc16()
-        for o in output[:-2]:
-            crc_engine.push(o)
+        crc_engine.update(output[:-2])
         crc_result = crc_engine.get()
         
         # Check CRC checksum
@@ -86,4 +85,37 @@ class Hdlc(object):
         output = output[:-2]
         
         return output
+
+# Splits the bytes read from the serial port into HDLC frames
+class HdlcDeframer(object):
+    def __init__(self):
+        self.buffer = ''
+        self.synced = False
     
+    # Returns whether a frame was started but not yet completed
+    def is_receiving(self):
+        return (self.synced and self.buffer != '')
+    
+    # Adds the bytes that were read and returns the completed frames, including their HDLC flags
+    def push(self, data):
+        frames = []
+        
+        # Every part between two flags is a frame, the last part is still incomplete
+        parts = (self.buffer + data).split(Hdlc.HDLC_FLAG)
+        if (not self.synced):
+            # The bytes before the first flag don't belong to a frame
+            parts = parts[1:]
+            if (not parts):
+                self.buffer = ''
+                return frames
+        
+        for part in parts[:-1]:
+            # Consecutive flags mark the idle line, not an empty frame
+            if (part):
+                frames.append(Hdlc.HDLC_FLAG + part + Hdlc.HDLC_FLAG)
+        
+        # Keep the start of the next frame
+        self.buffer = parts[-1]
+        self.synced = True
+        
+        return frames
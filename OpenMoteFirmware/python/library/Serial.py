@@ -14,9 +14,10 @@ import serial
 import threading
 import time
 import logging
+import collections
 
 # Import OpenMote libraries
-from Hdlc import Hdlc
+from Hdlc import Hdlc, HdlcDeframer
 
 # Import logging configuration
 logger = logging.getLogger(__name__)
@@ -50,14 +51,12 @@ class Serial(threading.Thread):
         self.bsl_mode    = bsl_mode
                 
         # HDLC driver
-        self.hdlc = Hdlc()
+        self.hdlc     = Hdlc()
+        self.deframer = HdlcDeframer()
         
-        # Receive variables
-        self.receive_buffer    = ''
-        self.receive_message   = ''
+        # Receive variables, messages are queued so that none is lost when several arrive in a single read
+        self.receive_messages  = collections.deque()
         self.receive_condition = threading.Condition()
-        self.is_receiving      = False
-        self.last_rx_byte      = 0
         
         # Transmit variables 
         self.transmit_buffer    = ''
@@ -92,8 +91,11 @@ class Serial(threading.Thread):
         # Execute while thread is alive
         while (not self.stop_event.isSet()): 
             try:
-                # Try to receive a byte from the serial port (blocking)
-                self.rx_byte = self.serial_port.read(size = 1)
+                # Wait for a byte from the serial port (blocking) and then take everything that already arrived
+                self.rx_bytes = self.serial_port.read(size = 1)
+                waiting = self.serial_port.inWaiting()
+                if (waiting > 0):
+                    self.rx_bytes += self.serial_port.read(size = waiting)
             except:
                 logger.error('run: Error while receiving from the serial port on %s.', self.serial_port)
                 # Terminate the thread
@@ -101,58 +103,31 @@ class Serial(threading.Thread):
                 # Break the loop
                 break
             
-            # Start of frame
-            if ((not self.is_receiving) and 
-                (self.last_rx_byte == self.hdlc.HDLC_FLAG) and
-                (self.rx_byte != self.hdlc.HDLC_FLAG)):
-                
-                self.is_receiving = True
-                self.receive_buffer = self.hdlc.HDLC_FLAG
-                self.receive_buffer += self.rx_byte
-                
-            # Middle of HDLC frame
-            elif ((self.is_receiving) and
-                  (self.rx_byte != self.hdlc.HDLC_FLAG)):
-                self.receive_buffer += self.rx_byte
-                
-            # End of HDLC frame 
-            elif ((self.is_receiving) and
-                  (self.rx_byte == self.hdlc.HDLC_FLAG)):
-                
-                # Receive the last byte
-                self.receive_buffer += self.rx_byte
-                
-                # Reset the variables
-                self.is_receiving = False
-                self.last_rx_byte = ''
-                self.rx_byte = ''
-                
+            # Split the received bytes into HDLC frames
+            for frame in self.deframer.push(self.rx_bytes):
                 try:
                     logger.debug('run: Received an HDLC frame from the Serial port, now de-HDLCifying it.')
-                    self.receive_message = self.hdlc.dehdlcify(self.receive_buffer)
+                    message = self.hdlc.dehdlcify(frame)
                 except:
                     logger.error('run: Error while de-HDLCifying the frame received from the Serial port.')
-                    self.receive_buffer  = ''
-                    self.receive_message = ''
                 else:
-                     # Acquire the transmit condition
-                    self.receive_condition.acquire()                   
+                    # Acquire the receive condition
+                    self.receive_condition.acquire()
                     
-                     # Notify the transmit condition
+                    # Queue the message and notify the receive condition
+                    self.receive_messages.append(message)
                     self.receive_condition.notify()
                     
-                     # Release the transmit condition
+                    # Release the receive condition
                     self.receive_condition.release()
-                    
-                    # Reset the receive buffer
-                    self.receive_buffer = ''
             
-            else:
+            # Only transmit in between the frames
+            if (not self.deframer.is_receiving()):
                 # Acquire the transmit condition
                 self.transmit_condition.acquire()
                 
                 # Check if there is something to transmit
-                if (not self.is_receiving and self.transmit_message):
+                if (self.transmit_message):
                     logger.debug('run: HDLCifying the transmit buffer.')
                     
                     # HDLCify the message
@@ -168,9 +143,6 @@ class Serial(threading.Thread):
                 
                 # Release the transmit condition
                 self.transmit_condition.release()
-                
-            # Always save the last received byte
-            self.last_rx_byte = self.rx_byte
     
     # Stops the thread
     def stop(self):
@@ -191,19 +163,17 @@ class Serial(threading.Thread):
         # Acquire the receive condition
         self.receive_condition.acquire()
         
-        # Try to receive a message with timeout
-        self.receive_condition.wait(0.5)
+        # Try to receive a message with timeout, unless one is already queued
+        if (not self.receive_messages):
+            self.receive_condition.wait(0.5)
 
         # If we really got a message, copy it!
-        if (not self.is_receiving and self.receive_message):
-            message = self.receive_message
-            length  = len(self.receive_message)
+        if (self.receive_messages):
+            message = self.receive_messages.popleft()
+            length  = len(message)
         
             logger.info('receive: Received a message with %d bytes.', length)
         
-        # Reset the receive message
-        self.receive_message = ''
-        
         # Release the receive condition
         self.receive_condition.release()
         
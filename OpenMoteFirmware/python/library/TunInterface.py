@@ -14,6 +14,8 @@ import os
 import fcntl
 import struct
 import subprocess
+import threading
+import collections
 import logging
 
 # Import logging configuration
@@ -26,12 +28,24 @@ class TunInterface():
     IFF_TAP     = 0x0002
     IFF_NO_PI   = 0x1000
     
+    # Packets that may wait for the writer thread, newer packets are dropped when the kernel doesn't keep up
+    INJECT_QUEUE_SIZE = 4096
+    
     def __init__(self, tun_name = None):
         logger.info("init: Creating the TunInterface object.")
         
         # Save the TUN name
         self.tun_name = tun_name
         
+        # Inject variables, the packets are written to the TUN interface by a separate thread
+        self.inject_queue     = collections.deque()
+        self.inject_condition = threading.Condition()
+        self.inject_thread    = None
+        self.inject_running   = False
+        self.injected         = 0
+        self.dropped          = 0
+        self.write_errors     = 0
+        
         try:
             logger.info("init: Opening the TUN device file on /dev/net/tun.")
             
@@ -57,15 +71,67 @@ class TunInterface():
         
         # Bring TUN interface up
         subprocess.check_call(['ifconfig', self.tun_name, 'up'])
+        
+        # Start the thread that writes the packets
+        self.inject_running = True
+        self.inject_thread = threading.Thread(target = self.write_packets)
+        self.inject_thread.setDaemon(True)
+        self.inject_thread.start()
     
     def stop(self):
         logger.info("stop: Stopping the TUN interface.")
         
+        # Let the writer thread finish the packets that are still queued
+        if (self.inject_thread != None):
+            self.inject_condition.acquire()
+            self.inject_running = False
+            self.inject_condition.notify()
+            self.inject_condition.release()
+            self.inject_thread.join()
+            self.inject_thread = None
+        
+        logger.info("stop: Injected %d packets, dropped %d packets and failed to write %d packets.",
+                    self.injected, self.dropped, self.write_errors)
+        
         # Bring TUN interface down
         subprocess.check_call(['ifconfig', self.tun_name, 'down'])
     
     def inject(self, packet):
-        logger.info("inject: Injecting a packet to the TUN interface.")
+        logger.debug("inject: Queueing a packet for the TUN interface.")
+        
+        # Acquire the inject condition
+        self.inject_condition.acquire()
         
-        # Write a packet to the TUN interface
-        os.write(self.tun_if.fileno(), ''.join(packet))
+        # Queue the packet, unless the writer thread is too far behind
+        if (len(self.inject_queue) < self.INJECT_QUEUE_SIZE):
+            self.inject_queue.append(packet)
+            self.inject_condition.notify()
+        else:
+            self.dropped += 1
+        
+        # Release the inject condition
+        self.inject_condition.release()
+    
+    # Runs the thread that writes the queued packets to the TUN interface
+    def write_packets(self):
+        fileno = self.tun_if.fileno()
+        
+        while (True):
+            # Take all the packets that were queued since the last time
+            self.inject_condition.acquire()
+            while (self.inject_running and not self.inject_queue):
+                self.inject_condition.wait()
+            packets = self.inject_queue
+            self.inject_queue = collections.deque()
+            self.inject_condition.release()
+            
+            if (not packets):
+                break
+            
+            # Every write is a single frame on a TAP interface, the lock isn't held while writing
+            for packet in packets:
+                try:
+                    os.write(fileno, ''.join(packet))
+                    self.injected += 1
+                except OSError:
+                    self.write_errors += 1
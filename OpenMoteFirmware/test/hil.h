@@ -0,0 +1,92 @@
+/**
+ * @file       hil.h
+ * @author     Bruno Van de Velde (bruno@texus.me)
+ * @version    v0.1
+ * @date       October, 2026
+ * @brief      Measurements that the test projects report to test-hil.py
+ *
+ * @copyright  This file is licensed under the GNU General Public License v2.
+ */
+
+#ifndef HIL_H_
+#define HIL_H_
+
+/*================================ include ==================================*/
+
+#include <stdint.h>
+
+#include "openmote-cc2538.h"
+
+/*================================ define ===================================*/
+
+// Build with "make HIL_TEST=1" to let the test measure its driver and report
+// the results over the UART instead of only exercising it
+#ifndef HIL_TEST
+#define HIL_TEST                            ( 0 )
+#endif
+
+// The DWT cycle counter of the Cortex-M3, it stops while the core sleeps
+#define HIL_DWT_CTRL                        ( 0xE0001000 )
+#define HIL_DWT_CTRL_CYCCNTENA              ( 1 << 0 )
+#define HIL_DWT_CYCCNT                      ( 0xE0001004 )
+#define HIL_DEMCR                           ( 0xE000EDFC )
+#define HIL_DEMCR_TRCENA                    ( 1 << 24 )
+
+#define HIL_REPORT_LENGTH                   ( 64 )
+
+/*================================= public ==================================*/
+
+static inline void hilInit(void)
+{
+    HWREG(HIL_DEMCR) |= HIL_DEMCR_TRCENA;
+    HWREG(HIL_DWT_CYCCNT) = 0;
+    HWREG(HIL_DWT_CTRL) |= HIL_DWT_CTRL_CYCCNTENA;
+}
+
+static inline uint32_t hilCycles(void)
+{
+    return HWREG(HIL_DWT_CYCCNT);
+}
+
+// Amount of events per second when they took the given amount of cycles
+static inline uint32_t hilRate(uint32_t count, uint32_t cycles)
+{
+    return (uint32_t)(((uint64_t)count * SysCtrlClockGet()) / (cycles > 0 ? cycles : 1));
+}
+
+// Write a line "HIL <metric> <value>" over the UART, which must be enabled
+static inline void hilReport(const char* metric, uint32_t value)
+{
+    uint8_t line[HIL_REPORT_LENGTH];
+    uint8_t digits[10];
+    uint32_t length = 0;
+    uint32_t count = 0;
+
+    line[length++] = 'H';
+    line[length++] = 'I';
+    line[length++] = 'L';
+    line[length++] = ' ';
+    while ((*metric != '\0') && (length < HIL_REPORT_LENGTH - sizeof(digits) - 3))
+    {
+        line[length++] = *metric++;
+    }
+    line[length++] = ' ';
+
+    do
+    {
+        digits[count++] = '0' + (value % 10);
+        value /= 10;
+    } while (value > 0);
+
+    while (count > 0)
+    {
+        line[length++] = digits[--count];
+    }
+
+    line[length++] = '\r';
+    line[length++] = '\n';
+
+    uart.writeByte(line, length);
+}
+
+#endif /* HIL_H_ */
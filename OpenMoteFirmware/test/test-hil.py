@@ -0,0 +1,258 @@
+#!/usr/bin/env python
+
+'''
+@file       test-hil.py
+@author     Bruno Van de Velde (bruno@texus.me)
+@version    v0.1
+@date       October, 2026
+@brief      Hardware-in-the-loop throughput test of the test projects
+
+@copyright  This file is licensed under the GNU General Public License v2.
+'''
+
+import os
+import sys
+import json
+import time
+import argparse
+import subprocess
+import collections
+
+import serial
+
+TEST_PATH = os.path.dirname(os.path.abspath(__file__))
+FLASH_SCRIPT = os.path.join(TEST_PATH, '..', '..', 'flash-bsl.py')
+
+MAKE_COMMAND = ['make', 'TARGET=cc2538', 'BOARD=openmote-cc2538']
+BAUDRATE = 115200      # UART_BAUDRATE of the board
+BOOT_TIME = 2          # Seconds after flashing before the measurements are trusted
+UART_LINE = b'OpenMote-CC2538\r\n'  # What test-uart writes back to back
+
+# Lowest acceptable value of every metric, or the highest one for the jitter. These are sanity floors for a single
+# OpenMote on an OpenBase, regressions between builds are found by comparing against a baseline.
+TARGETS = collections.OrderedDict([
+    ('uart_bytes_per_second', 11000),          # 115200 baud with 10 bits per byte gives at most 11520
+    ('serial_bytes_per_second', 5000),         # Payload bytes in HDLC frames, the framing and CRC take the rest
+    ('spi_write_bytes_per_second', 500000),    # SPI_BAUDRATE of 8 MHz gives at most 1000000
+    ('spi_transfer_bytes_per_second', 500000),
+    ('spi_dma_bytes_per_second', 800000),
+    ('radio_frames_per_second', 200),
+    ('timer_jitter_ns', 10000),
+])
+LOWER_IS_BETTER = ['timer_jitter_ns']
+
+# The projects that report their metrics when built with HIL_TEST=1, test-uart is measured by counting its bytes
+PROJECTS = collections.OrderedDict([
+    ('test-uart', ['uart_bytes_per_second']),
+    ('test-serial', ['serial_bytes_per_second']),
+    ('test-spi', ['spi_write_bytes_per_second', 'spi_transfer_bytes_per_second', 'spi_dma_bytes_per_second']),
+    ('test-radio', ['radio_frames_per_second']),
+    ('test-timer', ['timer_jitter_ns']),
+])
+
+
+def firmwareVersion():
+    # The images are build from this checkout
+    try:
+        output = subprocess.check_output(['git', 'describe', '--always', '--dirty'], stderr=subprocess.STDOUT, cwd=TEST_PATH)
+        return output.decode().strip()
+    except (OSError, subprocess.CalledProcessError):
+        return 'unknown'
+
+
+def buildProject(project):
+    # Objects of a normal build would be reused without the HIL_TEST define, so the project is cleaned first
+    directory = os.path.join(TEST_PATH, project)
+    subprocess.call(MAKE_COMMAND + ['clean'], cwd=directory, stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+    process = subprocess.Popen(MAKE_COMMAND + ['HIL_TEST=1'], cwd=directory, stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+    output = process.communicate()[0].decode(errors='replace')
+    if process.returncode != 0 or 'rror' in output:
+        with open(os.path.join(TEST_PATH, project + '.log'), 'w') as logFile:
+            logFile.write(output)
+        return None
+    return os.path.join(directory, project + '.hex')
+
+
+def flashProject(image, port, useBslLines):
+    command = [sys.executable, FLASH_SCRIPT, '--image', image, '-p', port]
+    if useBslLines:
+        command.append('--bsl')
+    return subprocess.call(command) == 0
+
+
+def openPort(port):
+    ser = serial.Serial(port=port, baudrate=BAUDRATE, timeout=0.1)
+    ser.setRTS(False)  # Disable bootloader
+    ser.setDTR(False)  # Disable reboot
+    return ser
+
+
+def measureUart(ser, duration):
+    # The bytes are counted from the first complete line, every line must be the same
+    ser.flushInput()
+    data = bytearray()
+    begin = time.time()
+    while time.time() - begin < duration:
+        data.extend(ser.read(4096))
+    elapsed = time.time() - begin
+
+    start = data.find(b'\n') + 1
+    end = data.rfind(b'\n') + 1
+    lines = bytes(data[start:end]).split(b'\n')[:-1]
+    corrupted = sum(1 for line in lines if line + b'\n' != UART_LINE)
+    if corrupted > 0:
+        print('  ' + str(corrupted) + ' of ' + str(len(lines)) + ' lines were corrupted')
+        return None
+
+    # The partial lines at the start and the end were also received within the measurement
+    return {'uart_bytes_per_second': len(data) / elapsed}
+
+
+def measureReports(ser, duration, metrics):
+    # The projects report a line "HIL <metric> <value>" about once per second, the median of the reports is kept
+    # (the largest for the jitter)
+    ser.flushInput()
+    values = dict((metric, []) for metric in metrics)
+    pending = bytearray()
+    begin = time.time()
+    while time.time() - begin < duration:
+        pending.extend(ser.read(256))
+        while b'\n' in pending:
+            line, _, rest = bytes(pending).partition(b'\n')
+            pending = bytearray(rest)
+            fields = line.strip().split(b' ')
+            if len(fields) != 3 or fields[0] != b'HIL':
+                continue  # e.g. the HDLC frames of test-serial
+            metric = fields[1].decode(errors='replace')
+            if metric in values and fields[2].isdigit():
+                values[metric].append(int(fields[2]))
+
+    results = {}
+    for metric, samples in values.items():
+        if len(samples) == 0:
+            print('  No report of ' + metric + ' was received')
+            continue
+        samples.sort()
+        results[metric] = samples[-1] if metric in LOWER_IS_BETTER else samples[len(samples) // 2]
+    return results
+
+
+def loadBaseline(fileName):
+    # Only the last run in the file is compared, like compare-results.py does for the benchmark
+    runs = collections.OrderedDict()
+    with open(fileName, 'r') as resultsFile:
+        for line in resultsFile:
+            line = line.strip()
+            if line != '':
+                record = json.loads(line)
+                runs.setdefault(record['run'], {})[record['metric']] = record['value']
+    return list(runs.values())[-1] if len(runs) > 0 else {}
+
+
+def checkMetric(metric, value, target, baseline, threshold):
+    # Returns the reasons why the value isn't good enough
+    problems = []
+    if metric in LOWER_IS_BETTER:
+        if value > target:
+            problems.append('above target ' + str(target))
+        if baseline != None and value > baseline * (1 + threshold / 100.0):
+            problems.append('rose from ' + str(baseline))
+    else:
+        if value < target:
+            problems.append('below target ' + str(target))
+        if baseline != None and value < baseline * (1 - threshold / 100.0):
+            problems.append('dropped from ' + str(baseline))
+    return problems
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Build the test projects with HIL_TEST=1, flash each of them to a connected '
+                                                 'OpenMote and check the throughput that their drivers reach')
+    parser.add_argument('-p', '--port', required=True, help='Serial port of the OpenMote')
+    parser.add_argument('--bsl', action='store_true', help='Use the DTR/RTS lines to start the boot loader (OpenUSB)')
+    parser.add_argument('--project', action='append', choices=list(PROJECTS.keys()),
+                        help='Only run this project, can be given several times (default: all of them)')
+    parser.add_argument('-d', '--duration', type=float, default=10, help='Seconds to measure every project (default: 10)')
+    parser.add_argument('--target', action='append', default=[], metavar='METRIC=VALUE',
+                        help='Change the lowest acceptable value of a metric (the highest for timer_jitter_ns)')
+    parser.add_argument('--results', help='Append the results to this file as JSON lines')
+    parser.add_argument('--baseline', help='Also fail when a metric got worse than in the last run of this results file')
+    parser.add_argument('-t', '--threshold', type=float, default=5,
+                        help='Percentage by which a metric may be worse than in the baseline (default: 5)')
+    args = parser.parse_args()
+
+    targets = dict(TARGETS)
+    for target in args.target:
+        metric, _, value = target.partition('=')
+        if metric not in targets:
+            print('ERROR: Unknown metric ' + metric + ', choose from ' + ', '.join(targets.keys()))
+            return 2
+        try:
+            targets[metric] = float(value)
+        except ValueError:
+            print('ERROR: The target of ' + metric + ' has to be a number')
+            return 2
+
+    baseline = {}
+    if args.baseline != None:
+        try:
+            baseline = loadBaseline(args.baseline)
+        except (IOError, OSError, ValueError, KeyError) as e:
+            print('ERROR: Could not read the baseline. Exception: ' + str(e))
+            return 2
+
+    run = time.strftime('%Y-%m-%dT%H:%M:%S')
+    firmware = firmwareVersion()
+    results = collections.OrderedDict()
+    failures = 0
+    for project in (args.project if args.project else PROJECTS.keys()):
+        print(project + ':')
+        image = buildProject(project)
+        if image == None:
+            print('  Build failed, see ' + project + '.log')
+            failures += 1
+            continue
+
+        if not flashProject(image, args.port, args.bsl):
+            print('  Flashing failed')
+            failures += 1
+            continue
+
+        ser = openPort(args.port)
+        time.sleep(BOOT_TIME)
+        if project == 'test-uart':
+            measured = measureUart(ser, args.duration)
+        else:
+            measured = measureReports(ser, args.duration, PROJECTS[project])
+        ser.close()
+
+        for metric in PROJECTS[project]:
+            if measured == None or metric not in measured:
+                print('  %-32s %14s  FAILED' % (metric, '-'))
+                failures += 1
+                continue
+
+            value = round(measured[metric], 1)
+            results[metric] = value
+            problems = checkMetric(metric, value, targets[metric], baseline.get(metric), args.threshold)
+            print('  %-32s %14.1f  %s' % (metric, value, ', '.join(problems) if problems else 'ok'))
+            if problems:
+                failures += 1
+
+    if args.results != None:
+        with open(args.results, 'a') as resultsFile:
+            for metric, value in results.items():
+                resultsFile.write(json.dumps({'run': run, 'firmware': firmware, 'metric': metric, 'value': value},
+                                             sort_keys=True) + '\n')
+
+    print('')
+    if failures > 0:
+        print('HIL test finished with ' + str(failures) + ' failure' + ('s' if failures > 1 else ''))
+        return 1
+
+    print('HIL test finished successfully')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -22,6 +22,8 @@
 #include "Callback.h"
 #include "Serial.h"
 
+#include "../hil.h"
+
 /*================================ define ===================================*/
 
 #define RADIO_MODE_RX                       ( 0 )
@@ -75,6 +77,10 @@ static uint8_t  uart_len = sizeof(radio_buffer);
 
 static Serial serial(uart);
 
+#if HIL_TEST
+static volatile uint32_t hil_frames = 0;
+#endif
+
 /*================================= public ==================================*/
 
 int main (void)
@@ -103,6 +109,11 @@ int main (void)
     // Create the radio receive task
     xTaskCreate(prvRadioRxTask, (const char *) "RadioRx", 128, NULL, RADIO_RX_TASK_PRIORITY, NULL);
 #elif (RADIO_MODE == RADIO_MODE_TX)
+#if HIL_TEST
+    // The transmitted frames per second are reported over the UART
+    uart.enable(UART_BAUDRATE, UART_CONFIG, UART_INT_MODE);
+#endif
+
     // Create the radio transmit task
     xTaskCreate(prvRadioTxTask, (const char *) "RadioTx", 128, NULL, RADIO_TX_TASK_PRIORITY, NULL);
 #endif
@@ -192,6 +203,12 @@ static void prvRadioRxTask(void *pvParameters)
 static void prvRadioTxTask(void *pvParameters)
 {
     static RadioResult result;
+#if HIL_TEST
+    uint32_t start;
+
+    hilInit();
+    start = hilCycles();
+#endif
 
     // Create the transmit semaphore
     txSemaphore = xSemaphoreCreateMutex();
@@ -225,8 +242,18 @@ static void prvRadioTxTask(void *pvParameters)
                 led_yellow.off();
             }
 
+#if HIL_TEST
+            // Send the frames back to back and report how many left per second
+            if (hilCycles() - start >= SysCtrlClockGet())
+            {
+                hilReport("radio_frames_per_second", hilRate(hil_frames, hilCycles() - start));
+                hil_frames = 0;
+                start = hilCycles();
+            }
+#else
             // Delay the transmission of the next packet 250 ms
             vTaskDelay(250 / portTICK_RATE_MS);
+#endif
         }
     }
 }
@@ -271,6 +298,10 @@ static void txDone(void)
     // Turn off the radio until the next packet
     radio.off();
 
+#if HIL_TEST
+    hil_frames++;
+#endif
+
     // Give the transmit semaphore as the packet has been transmitted
     xSemaphoreGiveFromISR(txSemaphore, &xHigherPriorityTaskWoken);
 
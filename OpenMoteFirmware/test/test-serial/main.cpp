@@ -19,6 +19,8 @@
 
 #include "Serial.h"
 
+#include "../hil.h"
+
 /*================================ define ===================================*/
 
 #define GREEN_LED_TASK_PRIORITY             ( tskIDLE_PRIORITY + 1 )
@@ -71,6 +73,27 @@ int main (void)
 
 static void prvSerialTask(void *pvParameters)
 {
+#if HIL_TEST
+    uint32_t start, frames;
+
+    hilInit();
+
+    // Write the buffer as HDLC frames back to back and report the payload
+    // bytes per second, measured over one second at a time
+    while (true)
+    {
+        start = hilCycles();
+        frames = 0;
+        while (hilCycles() - start < SysCtrlClockGet())
+        {
+            serial.write(serial_tx_ptr, serial_tx_len);
+            frames++;
+        }
+
+        hilReport("serial_bytes_per_second", hilRate(frames * serial_tx_len, hilCycles() - start));
+    }
+#endif
+
     // Turn on red LED
     led_red.on();
 
@@ -17,11 +17,17 @@
 
 #include "openmote-cc2538.h"
 
+#include "../hil.h"
+
 /*================================ define ===================================*/
 
 #define GREEN_LED_TASK_PRIORITY             ( tskIDLE_PRIORITY + 1 )
 #define SPI_TASK_PRIORITY                   ( tskIDLE_PRIORITY + 0 )
 
+#define HIL_SPI_BLOCK_LENGTH                ( 1024 )
+#define HIL_SPI_BLOCK_COUNT                 ( 64 )
+#define HIL_DMA_CHANNEL_COUNT               ( 12 ) // SSI0 uses channel 10 and 11
+
 /*================================ typedef ==================================*/
 
 /*=============================== prototypes ================================*/
@@ -29,12 +35,23 @@
 static void prvGreenLedTask(void *pvParameters);
 static void prvSpiTask(void *pvParameters);
 
+#if HIL_TEST
+static uint32_t hilMeasureWrite(void);
+static uint32_t hilMeasureTransfer(void);
+#endif
+
 /*=============================== variables =================================*/
 
 uint8_t spi_buffer[] = {'O','p','e','n','M','o','t','e','-','C','C','2','5','3','8','\n'};
 uint8_t* spi_ptr = spi_buffer;
 uint8_t  spi_len = sizeof(spi_buffer);
 
+#if HIL_TEST
+static uint8_t hil_buffer[HIL_SPI_BLOCK_LENGTH];
+static SpiTransaction hil_transaction(hil_buffer, sizeof(hil_buffer));
+static volatile tDMAControlTable hil_dma_table[HIL_DMA_CHANNEL_COUNT] __attribute__((section(".udma_channel_control_table")));
+#endif
+
 /*================================= public ==================================*/
 
 int main (void)
@@ -48,6 +65,15 @@ int main (void)
     // Enable the SPI peripheral
     spi.enable(SPI_MODE, SPI_PROTOCOL, SPI_DATAWIDTH, SPI_BAUDRATE);
 
+#if HIL_TEST
+    // The results go over the UART, the transfers with the uDMA need its
+    // channel control table
+    uart.enable(UART_BAUDRATE, UART_CONFIG, UART_INT_MODE);
+    uDMAEnable();
+    uDMAControlBaseSet((void*)hil_dma_table);
+    spi.enableInterrupts();
+#endif
+
     // Create two FreeRTOS tasks
     xTaskCreate(prvGreenLedTask, (const char *) "Green", 128, NULL, GREEN_LED_TASK_PRIORITY, NULL);
     xTaskCreate(prvSpiTask, (const char *) "Spi", 128, NULL, SPI_TASK_PRIORITY, NULL);
@@ -58,6 +84,24 @@ int main (void)
 
 static void prvSpiTask(void *pvParameters)
 {
+#if HIL_TEST
+    hilInit();
+
+    // Measure the blocking writes, the transactions that the interrupt feeds
+    // to the FIFO and the transactions that use the uDMA, once per second
+    while (true)
+    {
+        hilReport("spi_write_bytes_per_second", hilMeasureWrite());
+        hilReport("spi_transfer_bytes_per_second", hilMeasureTransfer());
+
+        spi.enableDma();
+        hilReport("spi_dma_bytes_per_second", hilMeasureTransfer());
+        spi.disableDma();
+
+        vTaskDelay(1000 / portTICK_RATE_MS);
+    }
+#endif
+
     // Forever
     while (true)
     {
@@ -92,3 +136,32 @@ static void prvGreenLedTask(void *pvParameters)
 
 /*================================ private ==================================*/
 
+#if HIL_TEST
+static uint32_t hilMeasureWrite(void)
+{
+    uint32_t start = hilCycles();
+
+    for (uint32_t i = 0; i < HIL_SPI_BLOCK_COUNT; i++)
+    {
+        spi.writeByte(hil_buffer, sizeof(hil_buffer));
+    }
+
+    return hilRate(HIL_SPI_BLOCK_COUNT * sizeof(hil_buffer), hilCycles() - start);
+}
+
+static uint32_t hilMeasureTransfer(void)
+{
+    uint32_t start = hilCycles();
+
+    // Each transaction is queued when the previous one completed, so the
+    // time between them is included in the measurement
+    for (uint32_t i = 0; i < HIL_SPI_BLOCK_COUNT; i++)
+    {
+        spi.transfer(&hil_transaction);
+        while (!hil_transaction.completed)
+            ;
+    }
+
+    return hilRate(HIL_SPI_BLOCK_COUNT * sizeof(hil_buffer), hilCycles() - start);
+}
+#endif
@@ -15,8 +15,12 @@
 
 #include "Callback.h"
 
+#include "../hil.h"
+
 /*================================ define ===================================*/
 
+#define HIL_TIMER_INTERVALS                 ( 40 ) // About a second of Timer0
+
 /*================================ typedef ==================================*/
 
 /*=============================== prototypes ================================*/
@@ -33,6 +37,16 @@ static PlainCallback timerCallback3(timer3_callback);
 
 /*=============================== variables =================================*/
 
+#if HIL_TEST
+// Shortest and longest time between two Timer0 interrupts in cycles, the
+// interrupt stops measuring while ready is set until main has reported them
+static volatile uint32_t hil_last;
+static volatile uint32_t hil_min;
+static volatile uint32_t hil_max;
+static volatile uint32_t hil_count = 0;
+static volatile bool hil_ready = false;
+#endif
+
 /*================================= public ==================================*/
 
 int main (void)
@@ -40,6 +54,12 @@ int main (void)
     // Enable erasing the Flash with the user button
     board.enableFlashErase();
 
+#if HIL_TEST
+    // The jitter of Timer0 is reported over the UART
+    uart.enable(UART_BAUDRATE, UART_CONFIG, UART_INT_MODE);
+    hilInit();
+#endif
+
     // Initialize Timer0
     timer0.init(800000);
     timer0.setCallback(&timerCallback0);
@@ -72,8 +92,20 @@ int main (void)
     // Forever
     while(true)
     {
+#if HIL_TEST
+        // The cycle counter doesn't run while sleeping, so the core stays
+        // awake and reports the difference between the shortest and the
+        // longest interval of Timer0
+        if (hil_ready)
+        {
+            hilReport("timer_jitter_ns", (uint32_t)(((uint64_t)(hil_max - hil_min) * 1000000000) / SysCtrlClockGet()));
+            hil_count = 0;
+            hil_ready = false;
+        }
+#else
         // Sleep
         board.sleep();
+#endif
     }
 }
 
@@ -83,6 +115,31 @@ int main (void)
 
 static void timer0_callback(void)
 {
+#if HIL_TEST
+    uint32_t now = hilCycles();
+    uint32_t interval = now - hil_last;
+
+    if (!hil_ready)
+    {
+        if (hil_count == 0)
+        {
+            hil_min = 0xFFFFFFFF;
+            hil_max = 0;
+        }
+        else
+        {
+            if (interval < hil_min) hil_min = interval;
+            if (interval > hil_max) hil_max = interval;
+        }
+
+        hil_last = now;
+        if (++hil_count > HIL_TIMER_INTERVALS)
+        {
+            hil_ready = true;
+        }
+    }
+#endif
+
     // Toggle green LED and AD0 debug pin
     led_green.toggle();
 }
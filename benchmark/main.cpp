@@ -0,0 +1,338 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// All sources of the sniffer are compiled as part of this file, so that the functions which are declared inline
+// in the source files of the sniffer can be called here exactly as the sniffer calls them
+#include "sniffer_channel_hopping.cpp"
+#include "sniffer_decryption.cpp"
+#include "sniffer_ethernet.cpp"
+#include "sniffer_filter.cpp"
+#include "sniffer_flash_log.cpp"
+#include "sniffer_flow_control.cpp"
+#include "sniffer_global.cpp"
+#include "sniffer_integrity.cpp"
+#include "sniffer_profiling.cpp"
+#include "sniffer_radio.cpp"
+#include "sniffer_serial.cpp"
+#include "sniffer_serial_receive.cpp"
+#include "sniffer_serial_send.cpp"
+#include "sniffer_statistics.cpp"
+#include "sniffer_survey.cpp"
+#include "sniffer_sync.cpp"
+#undef UART_CONFIG // Defined by both the board and the UART transport
+#include "sniffer_uart.cpp"
+#include "sniffer_usb.cpp"
+#include "sniffer_zep.cpp"
+
+#define BENCHMARK_BAUDRATE          115200  // Baudrate of the UART on which the results are printed
+#define BENCHMARK_ITERATIONS        100     // Times that each kernel runs over its input
+#define BENCHMARK_VECTOR_LEN        125     // Length of the worst and best case inputs, the largest payload of a radio packet
+#define BENCHMARK_RADIO_CHANNEL     26      // Channel on which the performance-test program sends its packets
+#define BENCHMARK_RADIO_TIME        10      // Seconds to wait for radio packets
+#define BENCHMARK_RADIO_MAX_PACKETS 5000    // The radio measurement stops after this many packets
+
+namespace Sniffer
+{
+    // Frames as they are seen on a real network: an acknowledgement, a beacon, a 6LoWPAN data frame and a MAC command
+    const uint8_t realisticFrames[] = {
+        5,  0x02, 0x00, 0x2A, 0x7E, 0x41,
+        27, 0x00, 0x80, 0x17, 0x34, 0x12, 0x00, 0x00, 0xFF, 0xCF, 0x00, 0x00, 0x01, 0x7E, 0x12, 0x34, 0x56, 0x78,
+            0x9A, 0xBC, 0xDE, 0xF0, 0x12, 0x34, 0x56, 0x78, 0xC3, 0x1D,
+        82, 0x41, 0xCC, 0x5B, 0x34, 0x12, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC,
+            0xDD, 0xEE, 0xFF, 0x00, 0x7A, 0x33, 0x3A, 0x80, 0x00, 0x7D, 0x12, 0x00, 0x01, 0x00, 0x05, 0x48, 0x65,
+            0x6C, 0x6C, 0x6F, 0x20, 0x73, 0x65, 0x6E, 0x73, 0x6F, 0x72, 0x20, 0x32, 0x31, 0x2E, 0x35, 0x20, 0x43,
+            0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x27, 0x00, 0x00, 0x19, 0x00, 0x00, 0x00,
+            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x64, 0x00, 0x00, 0x00, 0x8F, 0x6E,
+        12, 0x63, 0xC8, 0x9D, 0x34, 0x12, 0xFF, 0xFF, 0x02, 0x00, 0x04, 0x0B, 0x7E,
+        0
+    };
+
+    uint8_t  benchmarkInput[2 * BENCHMARK_VECTOR_LEN];
+    uint16_t benchmarkInputLen = 0;
+    volatile uint16_t benchmarkSink; // Keeps the compiler from optimizing the CRC calculation away
+
+    uint32_t benchmarkRadioCycles = 0;
+    uint32_t benchmarkRadioMaxCycles = 0;
+    uint32_t benchmarkRadioBytes = 0;
+    volatile uint32_t benchmarkRadioPackets = 0;
+
+    class Benchmark
+    {
+    public:
+        // Run all kernels on all inputs and print the results
+        static void run()
+        {
+            HWREG(DEMCR) |= DEMCR_TRCENA;
+            HWREG(DWT_CYCCNT) = 0;
+            HWREG(DWT_CTRL) |= DWT_CTRL_CYCCNTENA;
+
+            print("\nBenchmark of the sniffer, in cycles per byte\n");
+            print("kernel                 all-escape    no-escape    realistic\n");
+            runKernel("crcCalculationStep  ", kernelCrcCalculationStep, false);
+            runKernel("addByteToHdlc       ", kernelAddByteToHdlc, false);
+            runKernel("hdlcEncode          ", kernelHdlcEncode, false);
+            runKernel("cobsEncode          ", kernelCobsEncode, false);
+            runKernel("processByte         ", kernelProcessByte, true);
+
+            runRadioInterrupt();
+        }
+
+    private:
+        static void kernelCrcCalculationStep(const uint8_t* data, uint16_t length)
+        {
+            uint16_t crc = CRC_INIT;
+            for (uint16_t i = 0; i < length; ++i)
+                crc = crcCalculationStep(data[i], crc);
+
+            benchmarkSink = crc;
+        }
+
+        static void kernelAddByteToHdlc(const uint8_t* data, uint16_t length)
+        {
+            uartTxBufferLen = 1;
+            for (uint16_t i = 0; i < length; ++i)
+                SerialSend::addByteToHdlc(data[i]);
+        }
+
+        static void kernelHdlcEncode(const uint8_t*, uint16_t length)
+        {
+            // The data was already placed at the start of the buffer, where the radio would have stored it
+            SerialSend::hdlcEncode(SerialDataType::Packet, 0, length);
+        }
+
+        static void kernelCobsEncode(const uint8_t*, uint16_t length)
+        {
+            SerialSend::cobsEncode(SerialDataType::Packet, 0, length);
+        }
+
+        static void kernelProcessByte(const uint8_t* data, uint16_t length)
+        {
+            // The input is what the host would send, messages are restarted before they get too long
+            receivingStatus = false;
+            SerialReceive::processByte(HDLC_FLAG);
+            for (uint16_t i = 0; i < length; ++i)
+            {
+                if (messageLen >= SERIAL_RX_MAX_MESSAGE_LEN - 1)
+                {
+                    receivingStatus = false;
+                    SerialReceive::processByte(HDLC_FLAG);
+                }
+
+                SerialReceive::processByte(data[i]);
+            }
+        }
+
+        static void emptyKernel(const uint8_t*, uint16_t)
+        {
+        }
+
+        // Place the input in benchmarkInput (and the buffer) as it would be on the wire when the kernel reads escaped data
+        static void prepareInput(const uint8_t* data, uint8_t length, bool escaped)
+        {
+            benchmarkInputLen = 0;
+            for (uint8_t i = 0; i < length; ++i)
+            {
+                buffer[i] = data[i];
+                if (escaped && ((data[i] == HDLC_FLAG) || (data[i] == HDLC_ESCAPE)))
+                {
+                    benchmarkInput[benchmarkInputLen++] = HDLC_ESCAPE;
+                    benchmarkInput[benchmarkInputLen++] = data[i] ^ HDLC_ESCAPE_MASK;
+                }
+                else
+                    benchmarkInput[benchmarkInputLen++] = data[i];
+            }
+        }
+
+        // Cycles spend in the kernel for a single run over the input, interrupts can't disturb the measurement
+        static uint32_t measure(void (*kernel)(const uint8_t*, uint16_t))
+        {
+            const bool interruptsWereDisabled = IntMasterDisable();
+
+            const uint32_t startCycles = HWREG(DWT_CYCCNT);
+            for (uint8_t i = 0; i < BENCHMARK_ITERATIONS; ++i)
+                kernel(benchmarkInput, benchmarkInputLen);
+            const uint32_t cycles = HWREG(DWT_CYCCNT) - startCycles;
+
+            if (!interruptsWereDisabled)
+                IntMasterEnable();
+
+            return cycles / BENCHMARK_ITERATIONS;
+        }
+
+        // Cycles of the kernel without the cost of calling it
+        static uint32_t measureInput(void (*kernel)(const uint8_t*, uint16_t), const uint8_t* data, uint8_t length, bool escaped)
+        {
+            prepareInput(data, length, escaped);
+            const uint32_t cycles = measure(kernel);
+            const uint32_t overhead = measure(emptyKernel);
+            return (cycles > overhead) ? (cycles - overhead) : 0;
+        }
+
+        static void runKernel(const char* name, void (*kernel)(const uint8_t*, uint16_t), bool escaped)
+        {
+            uint8_t vector[BENCHMARK_VECTOR_LEN];
+
+            // Every byte has to be escaped
+            for (uint8_t i = 0; i < BENCHMARK_VECTOR_LEN; ++i)
+                vector[i] = (i % 2) ? HDLC_ESCAPE : HDLC_FLAG;
+
+            uint32_t cycles = measureInput(kernel, vector, BENCHMARK_VECTOR_LEN, escaped);
+            print(name);
+            printCyclesPerByte(cycles, benchmarkInputLen);
+
+            // No byte has to be escaped
+            for (uint8_t i = 0; i < BENCHMARK_VECTOR_LEN; ++i)
+                vector[i] = (i * 7) & 0x3F;
+
+            cycles = measureInput(kernel, vector, BENCHMARK_VECTOR_LEN, escaped);
+            printCyclesPerByte(cycles, benchmarkInputLen);
+
+            // The realistic frames are each passed to the kernel on their own, like the sniffer would do
+            cycles = 0;
+            uint32_t bytes = 0;
+            for (uint16_t i = 0; realisticFrames[i] != 0; i += realisticFrames[i] + 1)
+            {
+                cycles += measureInput(kernel, &realisticFrames[i + 1], realisticFrames[i], escaped);
+                bytes += benchmarkInputLen;
+            }
+
+            printCyclesPerByte(cycles, bytes);
+            print("\n");
+        }
+
+        static void radioInterruptHandler()
+        {
+            // SFD interrupts also count, but only the bytes of completed packets
+            const bool packetCompleted = (HWREG(RFCORE_SFR_RFIRQF0) & RFCORE_SFR_RFIRQF0_RXPKTDONE);
+            const uint8_t bytes = HWREG(RFCORE_XREG_RXFIFOCNT);
+
+            const uint32_t startCycles = HWREG(DWT_CYCCNT);
+            Radio::handleRadioInterrupt();
+            const uint32_t cycles = HWREG(DWT_CYCCNT) - startCycles;
+
+            benchmarkRadioCycles += cycles;
+            if (cycles > benchmarkRadioMaxCycles)
+                benchmarkRadioMaxCycles = cycles;
+
+            if (packetCompleted)
+            {
+                benchmarkRadioBytes += bytes;
+                benchmarkRadioPackets++;
+            }
+        }
+
+        static void runRadioInterrupt()
+        {
+            // The radio interrupt can only be measured with real packets, it is skipped when no transmitter is near
+            print("\nRadio interrupt: waiting for packets from performance-test on channel 26\n");
+            benchmarkRadioCycles = 0;
+            benchmarkRadioMaxCycles = 0;
+            benchmarkRadioBytes = 0;
+            benchmarkRadioPackets = 0;
+
+            Radio::setChannel(BENCHMARK_RADIO_CHANNEL);
+            IntRegister(INT_RFCORERTX, Benchmark::radioInterruptHandler);
+            CC2538_RF_CSP_ISFLUSHRX();
+            CC2538_RF_CSP_ISRXON();
+            IntEnable(INT_RFCORERTX);
+
+            // The packets are thrown away as soon as they are in the buffer, which thus never gets full
+            for (uint16_t i = 0; (i < BENCHMARK_RADIO_TIME * configTICK_RATE_HZ) && (benchmarkRadioPackets < BENCHMARK_RADIO_MAX_PACKETS); ++i)
+            {
+                vTaskDelay(1);
+                bufferIndexSerialSend = bufferIndexRadio;
+                bufferIndexAcked = bufferIndexRadio;
+            }
+
+            IntDisable(INT_RFCORERTX);
+            CC2538_RF_CSP_ISRFOFF();
+
+            if (benchmarkRadioPackets == 0)
+            {
+                print("No packets were received\n");
+                return;
+            }
+
+            print("packets ");
+            printNumber(benchmarkRadioPackets);
+            print(", cycles per byte");
+            printCyclesPerByte(benchmarkRadioCycles, benchmarkRadioBytes);
+            print(", cycles per packet");
+            printCyclesPerByte(benchmarkRadioCycles, benchmarkRadioPackets);
+            print(", longest interrupt ");
+            printNumber(benchmarkRadioMaxCycles);
+            print(" cycles\n");
+        }
+
+        static void print(const char* text)
+        {
+            while (*text != '\0')
+                UARTCharPut(uart.getBase(), *text++);
+        }
+
+        static void printNumber(uint32_t value)
+        {
+            char digits[10];
+            uint8_t count = 0;
+            do
+            {
+                digits[count++] = '0' + (value % 10);
+                value /= 10;
+            }
+            while (value > 0);
+
+            while (count > 0)
+                UARTCharPut(uart.getBase(), digits[--count]);
+        }
+
+        // Prints the value with 2 decimals, right aligned in a column of 13 characters
+        static void printCyclesPerByte(uint32_t cycles, uint32_t bytes)
+        {
+            const uint32_t value = (bytes > 0) ? ((cycles * 100) / bytes) : 0;
+            uint8_t length = 4;
+            for (uint32_t rest = value / 1000; rest > 0; rest /= 10)
+                length++;
+
+            for (; length < 13; ++length)
+                print(" ");
+
+            printNumber(value / 100);
+            print(".");
+            printNumber((value / 10) % 10);
+            printNumber(value % 10);
+        }
+    };
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Called by FreeRTOS when the benchmark task is waiting
+extern "C" void vApplicationIdleHook()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void prvBenchmarkTask(void *pvParameters)
+{
+    uart.enable(BENCHMARK_BAUDRATE, UART_CONFIG_WLEN_8 | UART_CONFIG_STOP_ONE | UART_CONFIG_PAR_NONE, UART_TXINT_MODE_EOT);
+    Sniffer::Radio::initialize();
+
+    // The results are repeated every few seconds, so that a terminal can be opened at any moment
+    while (true)
+    {
+        Sniffer::Benchmark::run();
+        vTaskDelay(5 * configTICK_RATE_HZ);
+    }
+}
+
+int main()
+{
+    xTaskCreate(prvBenchmarkTask, "Benchmark", 256, NULL, tskIDLE_PRIORITY + 1, NULL);
+    portDISABLE_INTERRUPTS();
+    xPortStartScheduler();
+}
@@ -0,0 +1,350 @@
+#!/usr/bin/env python
+
+__author__ = 'Bruno Van de Velde (bruno@texus.me)'
+__license__ = 'GNU General Public License v2'
+
+import os
+import sys
+import mmap
+import time
+import struct
+import argparse
+
+import numpy
+
+import sniffer
+
+
+# Columns of every frame, the timestamp in microseconds since 1970 (UTC) as everywhere in sniffer.py
+PACKET_DTYPE = numpy.dtype([('timestamp', '<i8'), ('length', '<u2'), ('rssi', 'i1'), ('lqi', 'u1'), ('fcs_ok', '?'), ('channel', 'u1')])
+
+CHUNK_BYTES = 16 * 1024 * 1024  # Positions that are checked for a record header at a time, which bounds the memory of the index
+PCAP_GLOBAL_HEADER_LEN = 24
+PCAPNG_SECTION_HEADER = 0x0A0D0D0A
+PCAPNG_ENHANCED_PACKET = 0x00000006
+PCAPNG_EPB_DATA_OFFSET = 28
+PCAPNG_OPTION_FLAGS = 2
+TAP_RSSI_OFFSET = 16     # Offsets of the TLV values in TAP_HEADER
+TAP_CHANNEL_OFFSET = 24
+TAP_LQI_OFFSET = 32
+ARROW_CONTINUATION = 0xffffffff
+ARROW_HEADER_RECORD_BATCH = 3
+ARROW_BUFFERS = {'timestamp': 1, 'channel': 3, 'rssi': 5, 'lqi': 7, 'fcs_ok': 9, 'original_length': 11, 'frame': 29}  # Of ArrowStreamWriter
+
+
+class Capture:
+    # The frames of a capture as numpy arrays: packets has a row per frame with the columns of PACKET_DTYPE, and frame(i) is a view
+    # of the bytes of a frame in the memory map of the file (without the TAP header of a pcapng file), so nothing is copied
+    # until it is used. frameMatrix copies the frames into a matrix of a fixed width, for vectorised work on the headers.
+    def __init__(self, fileName, data, packets, frameOffsets, frameLengths, problems):
+        self.fileName = fileName
+        self.data = data
+        self.packets = packets
+        self.frameOffsets = frameOffsets
+        self.frameLengths = frameLengths
+        self.problems = problems
+
+    def __len__(self):
+        return len(self.packets)
+
+    def frame(self, i):
+        return self.data[self.frameOffsets[i]:self.frameOffsets[i] + self.frameLengths[i]]
+
+    def frameMatrix(self, width=127, rows=None):
+        # Bytes behind the end of a frame are zero, frames that are longer are cut off
+        offsets = self.frameOffsets if rows is None else self.frameOffsets[rows]
+        lengths = self.frameLengths if rows is None else self.frameLengths[rows]
+        columns = numpy.arange(width)
+        inside = columns[numpy.newaxis, :] < lengths[:, numpy.newaxis]
+        positions = numpy.minimum(offsets[:, numpy.newaxis] + columns[numpy.newaxis, :], len(self.data) - 1)
+        return numpy.where(inside, self.data[positions], 0).astype(numpy.uint8)
+
+
+def walkRecords(candidates, nextOffsets, start, size):
+    # Follows the records from the start to the end of the file, where every candidate position knows where the record behind
+    # it would begin. Bytes of a frame can look like a record header, but they are only in the result when the walk reaches
+    # them. The walk takes log2 passes instead of one step per record: every pass appends the records that lie as many steps
+    # further as have been found so far, with a table of jumps that doubles in every pass. Returns the offsets of the records
+    # and the offset where the walk got stuck, which is the size of the file when it reached the end.
+    count = len(candidates)
+    end, stuck = count, count + 1
+    following = numpy.searchsorted(candidates, nextOffsets)
+    found = following < count
+    found[found] = candidates[following[found]] == nextOffsets[found]
+    jumps = numpy.concatenate([numpy.where(found, following, numpy.where(nextOffsets == size, end, stuck)), [end, stuck]])
+
+    first = numpy.searchsorted(candidates, start)
+    path = numpy.array([first if first < count and candidates[first] == start else stuck], dtype=numpy.int64)
+    while path[-1] < count:
+        path = numpy.concatenate([path, jumps[path]])
+        jumps = jumps[jumps]
+
+    last = numpy.searchsorted(path, count)
+    records = candidates[path[:last]]
+    if path[last] == end:
+        return records, size
+    return records, int(nextOffsets[path[last - 1]]) if last > 0 else start
+
+
+def pcapCandidates(data, size):
+    # Positions where a record header of a sniffer pcap could start: saved and original length below 64 KB (so their upper
+    # bytes are zero), the saved length not longer than the original one and the microseconds below a second
+    candidates = []
+    nextOffsets = []
+    header = sniffer.PCAP_RECORD_HEADER.size
+    for chunk in range(PCAP_GLOBAL_HEADER_LEN, max(size - header + 1, PCAP_GLOBAL_HEADER_LEN), CHUNK_BYTES):
+        stop = min(chunk + CHUNK_BYTES, size - header + 1)
+
+        def field(offset):
+            return data[chunk + offset:stop + offset]
+
+        possible = (field(8) == 0) & (field(9) == 0) & (field(12) == 0) & (field(13) == 0)
+        positions = numpy.flatnonzero(possible) + chunk
+        saved = (data[positions + 10].astype(numpy.int64) << 8) | data[positions + 11]
+        original = (data[positions + 14].astype(numpy.int64) << 8) | data[positions + 15]
+        microseconds = ((data[positions + 4].astype(numpy.int64) << 24) | (data[positions + 5].astype(numpy.int64) << 16)
+                        | (data[positions + 6].astype(numpy.int64) << 8) | data[positions + 7])
+        nextOffset = positions + header + saved
+        valid = (saved <= original) & (microseconds < 1000000) & (nextOffset <= size)
+        candidates.append(positions[valid])
+        nextOffsets.append(nextOffset[valid])
+
+    if len(candidates) == 0:
+        return numpy.zeros(0, dtype=numpy.int64), numpy.zeros(0, dtype=numpy.int64)
+    return numpy.concatenate(candidates), numpy.concatenate(nextOffsets)
+
+
+def pcapngCandidates(words, size):
+    # Blocks are aligned to 32 bits, a block could start at every word whose length (in the next word) is a multiple of 4 that
+    # fits in the file and is repeated at the end of the block
+    candidates = []
+    nextOffsets = []
+    for chunk in range(0, max(len(words) - 2, 0), CHUNK_BYTES // 4):
+        stop = min(chunk + CHUNK_BYTES // 4, len(words) - 2)
+        lengths = words[chunk + 1:stop + 1].astype(numpy.int64)
+        positions = numpy.arange(chunk, stop, dtype=numpy.int64) * 4
+        possible = (lengths >= 12) & (lengths % 4 == 0) & (positions + lengths <= size)
+        positions = positions[possible]
+        lengths = lengths[possible]
+        valid = words[(positions + lengths) // 4 - 1] == lengths
+        candidates.append(positions[valid])
+        nextOffsets.append(positions[valid] + lengths[valid])
+
+    if len(candidates) == 0:
+        return numpy.zeros(0, dtype=numpy.int64), numpy.zeros(0, dtype=numpy.int64)
+    return numpy.concatenate(candidates), numpy.concatenate(nextOffsets)
+
+
+def radioCrcOk(data, offsets, lengths):
+    # CRC-16/KERMIT over the frames with their FCS, which leaves zero when the FCS is correct. A column of bytes at a time,
+    # so there are as many passes as the longest frame has bytes.
+    table = numpy.zeros(256, dtype=numpy.uint16)
+    for i in range(256):
+        crc = i
+        for bit in range(8):
+            crc = (crc >> 1) ^ 0x8408 if crc & 1 else crc >> 1
+        table[i] = crc
+
+    crc = numpy.zeros(len(offsets), dtype=numpy.uint16)
+    for column in range(int(lengths.max()) if len(lengths) > 0 else 0):
+        inside = lengths > column
+        values = data[offsets[inside] + column]
+        crc[inside] = (crc[inside] >> 8) ^ table[(crc[inside] ^ values) & 0xff]
+    return crc == 0
+
+
+def loadPcap(fileName, data, size):
+    header = sniffer.PCAP_RECORD_HEADER.size
+    candidates, nextOffsets = pcapCandidates(data, size)
+    records, stuck = walkRecords(candidates, nextOffsets, PCAP_GLOBAL_HEADER_LEN, size)
+    problems = [] if stuck == size else ['offset ' + str(stuck) + ': no valid record here, the rest of the file is left out']
+
+    def bigEndian(offset):
+        return ((data[records + offset].astype(numpy.int64) << 24) | (data[records + offset + 1].astype(numpy.int64) << 16)
+                | (data[records + offset + 2].astype(numpy.int64) << 8) | data[records + offset + 3])
+
+    packets = numpy.zeros(len(records), dtype=PACKET_DTYPE)
+    packets['timestamp'] = bigEndian(0) * 1000000 + bigEndian(4)
+    packets['length'] = bigEndian(12)
+    frameOffsets = records + header
+    frameLengths = bigEndian(8)
+
+    # The pcap has no RSSI, LQI or channel, unless --replace-fcs put the TI CC24XX FCS in place of the real one: the RSSI
+    # and a byte with the LQI and a bit that says whether the CRC was correct. Most frames have a correct FCS, so when
+    # most of them fail the CRC but have that bit set, the file was written with --replace-fcs.
+    complete = (frameLengths == packets['length']) & (frameLengths >= 2)
+    crcOk = radioCrcOk(data, frameOffsets[complete], frameLengths[complete])
+    lastBytes = data[frameOffsets[complete] + frameLengths[complete] - 1]
+    if len(crcOk) > 0 and numpy.count_nonzero(crcOk) * 2 < len(crcOk) and numpy.count_nonzero(lastBytes & 0x80) * 2 >= len(crcOk):
+        packets['rssi'][complete] = data[frameOffsets[complete] + frameLengths[complete] - 2].view(numpy.int8)
+        packets['lqi'][complete] = lastBytes & 0x7f
+        packets['fcs_ok'][complete] = (lastBytes & 0x80) != 0
+    else:
+        packets['fcs_ok'][complete] = crcOk
+    return Capture(fileName, data, packets, frameOffsets, frameLengths, problems)
+
+
+def loadPcapng(fileName, data, size):
+    words = numpy.frombuffer(data, dtype='>u4', count=size // 4)
+    candidates, nextOffsets = pcapngCandidates(words, size)
+    blocks, stuck = walkRecords(candidates, nextOffsets, 0, size)
+    problems = [] if stuck == size else ['offset ' + str(stuck) + ': no valid block here, the rest of the file is left out']
+
+    # Only the packet blocks, whose fields are at fixed places
+    records = blocks[words[blocks // 4] == PCAPNG_ENHANCED_PACKET]
+    index = records // 4
+    ends = records + words[index + 1].astype(numpy.int64)
+    savedLengths = words[index + 5].astype(numpy.int64)
+    records = records[PCAPNG_EPB_DATA_OFFSET + savedLengths + 4 <= ends - records]
+    index = records // 4
+    ends = records + words[index + 1].astype(numpy.int64)
+    savedLengths = words[index + 5].astype(numpy.int64)
+    originalLengths = words[index + 6].astype(numpy.int64)
+    dataStarts = records + PCAPNG_EPB_DATA_OFFSET
+
+    packets = numpy.zeros(len(records), dtype=PACKET_DTYPE)
+    nanoseconds = (words[index + 3].astype(numpy.uint64) << numpy.uint64(32)) | words[index + 4].astype(numpy.uint64)
+    packets['timestamp'] = (nanoseconds // numpy.uint64(1000)).astype(numpy.int64)
+
+    # The TAP header of sniffer.py has the same TLVs in the same order in every frame, the values are little endian
+    tapSize = sniffer.TAP_HEADER.size
+    tapped = savedLengths >= tapSize
+    tapLengths = numpy.where(tapped, data[numpy.minimum(dataStarts + 2, size - 1)].astype(numpy.int64)
+                             | (data[numpy.minimum(dataStarts + 3, size - 1)].astype(numpy.int64) << 8), 0)
+    tapped &= tapLengths == tapSize
+    tapLengths = numpy.where(tapped, tapLengths, 0)
+    starts = dataStarts[tapped]
+    rssi = numpy.frombuffer(data, dtype='<f4', count=size // 4)[(starts + TAP_RSSI_OFFSET) // 4]
+    packets['rssi'][tapped] = numpy.clip(numpy.round(rssi), -128, 127).astype(numpy.int8)
+    packets['channel'][tapped] = data[starts + TAP_CHANNEL_OFFSET]
+    packets['lqi'][tapped] = data[starts + TAP_LQI_OFFSET]
+    fcsIncluded = numpy.zeros(len(records), dtype=bool)
+    fcsIncluded[tapped] = data[starts + 8] == 1
+    packets['length'] = numpy.maximum(originalLengths - tapLengths, 0)
+
+    # The flags option is the first option when the FCS was wrong
+    optionStarts = dataStarts + savedLengths + (4 - savedLengths % 4) % 4
+    hasOptions = optionStarts + 8 <= ends - 4
+    optionWords = numpy.where(hasOptions, optionStarts // 4, 0)
+    crcError = hasOptions & ((words[optionWords] >> 16) == PCAPNG_OPTION_FLAGS) \
+                          & ((words[optionWords + 1] & sniffer.PCAPNG_EPB_CRC_ERROR) != 0)
+    packets['fcs_ok'] = fcsIncluded & ~crcError
+    return Capture(fileName, data, packets, dataStarts + tapLengths, savedLengths - tapLengths, problems)
+
+
+def arrowTable(metadata, position):
+    # Position of a table and a function that gives the position of one of its fields, or None when it isn't there
+    table = position + struct.unpack_from('<I', metadata, position)[0]
+    vtable = table - struct.unpack_from('<i', metadata, table)[0]
+    vtableSize = struct.unpack_from('<H', metadata, vtable)[0]
+
+    def field(index):
+        if 4 + 2 * index >= vtableSize:
+            return None
+        offset = struct.unpack_from('<H', metadata, vtable + 4 + 2 * index)[0]
+        return table + offset if offset != 0 else None
+    return field
+
+
+def loadArrow(fileName, data, size):
+    # Only the record batches of the stream are read, their buffers are in the order that ArrowStreamWriter writes them
+    columns = dict((name, []) for name in ARROW_BUFFERS)
+    frameOffsets = []
+    frameLengths = []
+    problems = []
+    raw = memoryview(data)
+    position = 0
+    while position + 8 <= size:
+        continuation, metadataLength = struct.unpack_from('<Ii', raw, position)
+        if continuation != ARROW_CONTINUATION or metadataLength < 0 or position + 8 + metadataLength > size:
+            problems.append('offset ' + str(position) + ': no valid message here, the rest of the file is left out')
+            break
+        if metadataLength == 0:
+            break
+
+        metadata = raw[position + 8:position + 8 + metadataLength]
+        message = arrowTable(metadata, 0)
+        headerType = metadata[message(1)] if message(1) != None else 0
+        bodyLength = struct.unpack_from('<q', metadata, message(3))[0] if message(3) != None else 0
+        body = position + 8 + metadataLength
+        position = body + bodyLength
+        if headerType != ARROW_HEADER_RECORD_BATCH or message(2) == None:
+            continue
+
+        batch = arrowTable(metadata, message(2))
+        rows = struct.unpack_from('<q', metadata, batch(0))[0]
+        vector = batch(2) + struct.unpack_from('<I', metadata, batch(2))[0]
+        buffers = [struct.unpack_from('<qq', metadata, vector + 4 + 16 * i) for i in range(struct.unpack_from('<I', metadata, vector)[0])]
+
+        def column(name, dtype):
+            offset, length = buffers[ARROW_BUFFERS[name]]
+            return numpy.frombuffer(data, dtype=dtype, count=rows, offset=body + offset)
+
+        for name, dtype in [('timestamp', '<i8'), ('channel', 'u1'), ('rssi', 'i1'), ('lqi', 'u1'), ('original_length', 'u1')]:
+            columns[name].append(column(name, dtype))
+        offset, length = buffers[ARROW_BUFFERS['fcs_ok']]
+        columns['fcs_ok'].append(numpy.unpackbits(numpy.frombuffer(data, dtype=numpy.uint8, count=(rows + 7) // 8, offset=body + offset),
+                                                  bitorder='little')[:rows].astype(bool))
+        offset, length = buffers[ARROW_BUFFERS['frame']]
+        dataOffset, dataLength = buffers[ARROW_BUFFERS['frame'] + 1]
+        offsets = numpy.frombuffer(data, dtype='<i4', count=rows + 1, offset=body + offset).astype(numpy.int64)
+        frameOffsets.append(body + dataOffset + offsets[:-1])
+        frameLengths.append(offsets[1:] - offsets[:-1])
+
+    def joined(parts, dtype):
+        return numpy.concatenate(parts) if len(parts) > 0 else numpy.zeros(0, dtype=dtype)
+
+    packets = numpy.zeros(sum(len(part) for part in frameOffsets), dtype=PACKET_DTYPE)
+    for name in ['timestamp', 'channel', 'rssi', 'lqi', 'fcs_ok']:
+        packets[name] = joined(columns[name], PACKET_DTYPE[name])
+    packets['length'] = joined(columns['original_length'], numpy.uint8)
+    return Capture(fileName, data, packets, joined(frameOffsets, numpy.int64), joined(frameLengths, numpy.int64), problems)
+
+
+def load(fileName):
+    # A pcap or pcapng file or an Arrow stream that sniffer.py wrote, told apart by the start of the file
+    with open(fileName, 'rb') as captureFile:
+        size = os.fstat(captureFile.fileno()).st_size
+        if size < 8:
+            raise ValueError(fileName + ' is too short to be a capture')
+        mapping = mmap.mmap(captureFile.fileno(), 0, access=mmap.ACCESS_READ)
+
+    data = numpy.frombuffer(mapping, dtype=numpy.uint8)
+    if data[:4].tobytes() == b'\xa1\xb2\xc3\xd4':
+        return loadPcap(fileName, data, size)
+    if struct.unpack_from('>I', mapping, 0)[0] == PCAPNG_SECTION_HEADER:
+        if mapping[8:12] != b'\x1a\x2b\x3c\x4d':
+            raise ValueError(fileName + ' is a little endian pcapng file, which sniffer.py never writes')
+        return loadPcapng(fileName, data, size)
+    if struct.unpack_from('<I', mapping, 0)[0] == ARROW_CONTINUATION:
+        return loadArrow(fileName, data, size)
+    raise ValueError(fileName + ' is neither a pcap, a pcapng nor an Arrow stream written by sniffer.py')
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Load a capture of sniffer.py into numpy arrays and print what it contains. '
+                                                 'In python, "capturearrays.load(FILE)" returns the arrays.')
+    parser.add_argument('captures', nargs='+', help='pcap, pcapng or Arrow stream (--arrow) files written by sniffer.py')
+    args = parser.parse_args()
+
+    for fileName in args.captures:
+        start = time.time()
+        try:
+            capture = load(fileName)
+        except (IOError, OSError, ValueError) as e:
+            sys.stderr.write('ERROR: Could not load ' + fileName + '. Exception: ' + str(e) + '\n')
+            return 1
+
+        packets = capture.packets
+        print('%s: %d frames in %.2f seconds' % (fileName, len(packets), time.time() - start))
+        if len(packets) > 0:
+            print('  %.1f seconds of capture, %d with a wrong or missing FCS, channels %s' % (
+                (packets['timestamp'].max() - packets['timestamp'].min()) / 1000000.0, numpy.count_nonzero(~packets['fcs_ok']),
+                ', '.join(str(channel) for channel in numpy.unique(packets['channel']))))
+        for problem in capture.problems:
+            print('  ' + problem)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
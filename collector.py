@@ -0,0 +1,179 @@
+#!/usr/bin/env python
+
+__author__ = 'Bruno Van de Velde (bruno@texus.me)'
+__license__ = 'GNU General Public License v2'
+
+import os
+import re
+import sys
+import json
+import time
+import socket
+import struct
+import argparse
+import threading
+import zlib
+
+import sniffer
+
+
+MAX_SESSIONS = 100  # Sessions per site that are remembered, the oldest is forgotten first
+
+
+class Site:
+    # Rotated pcapng files of a single site, with the index of the next frame of every session that streamed to it. The
+    # sessions are stored next to the files, so a sniffer continues where it was after the collector restarted.
+    def __init__(self, directory, name, args):
+        self.lock = threading.Lock()
+        self.directory = os.path.join(directory, re.sub(r'[^A-Za-z0-9_.-]', '_', name).lstrip('.') or '_')
+        if not os.path.isdir(self.directory):
+            os.makedirs(self.directory)
+
+        self.sessionsFile = os.path.join(self.directory, 'sessions.json')
+        self.sessions = {}  # Session as hex string to the next index and when it was last seen
+        if os.path.exists(self.sessionsFile):
+            with open(self.sessionsFile) as sessionsFile:
+                self.sessions = json.load(sessionsFile)
+
+        self.rotation = sniffer.FileRotation(os.path.join(self.directory, os.path.basename(self.directory) + '.pcapng'),
+                                             args.rotate_size * 1000000, args.rotate_time, args.max_files, resume=True)
+        self.rotation.header = sniffer.pcapngHeader([name])
+        self.rotation.write([(self.rotation.header, None)])
+        self.rotation.fileBytes = len(self.rotation.header)
+
+    def nextIndex(self, session):
+        return self.sessions.get('%016x' % session, [0, 0])[0]
+
+    def write(self, session, first, records):
+        # Returns the index of the next frame that is expected, frames that were already written are left out
+        nextIndex = self.nextIndex(session)
+        skip = max(nextIndex - first, 0)
+        blocks = [(sniffer.pcapngPacketBlock(*(record + (0,))), record[1]) for record in records[skip:]]
+        if len(blocks) > 0:
+            self.rotation.write(blocks)
+            self.rotation.file.flush()
+            nextIndex = max(nextIndex, first + len(records))
+
+        self.sessions['%016x' % session] = [nextIndex, int(time.time())]
+        while len(self.sessions) > MAX_SESSIONS:
+            del self.sessions[min(self.sessions, key=lambda key: self.sessions[key][1])]
+
+        # A new file is renamed over the old one, so a crash never leaves half a file behind (except on Windows)
+        with open(self.sessionsFile + '.tmp', 'w') as sessionsFile:
+            json.dump(self.sessions, sessionsFile)
+        if os.name == 'nt' and os.path.exists(self.sessionsFile):
+            os.remove(self.sessionsFile)
+        os.rename(self.sessionsFile + '.tmp', self.sessionsFile)
+        return nextIndex
+
+    def close(self):
+        with self.lock:
+            self.rotation.close()
+
+
+class Collector:
+    def __init__(self, args):
+        self.args = args
+        self.lock = threading.Lock()
+        self.sites = {}
+
+    def getSite(self, name):
+        with self.lock:
+            if name not in self.sites:
+                self.sites[name] = Site(self.args.directory, name, self.args)
+            return self.sites[name]
+
+    def serve(self, connection, address):
+        peer = address[0] + ':' + str(address[1])
+        try:
+            connection.settimeout(sniffer.REMOTE_TIMEOUT * 2)
+            blockType, payload = sniffer.remoteReadBlock(connection)
+            if blockType != sniffer.REMOTE_BLOCK_HELLO or len(payload) <= sniffer.REMOTE_HELLO.size:
+                raise IOError('no HELLO')
+            magic, version, session = sniffer.REMOTE_HELLO.unpack_from(payload)
+            if magic != sniffer.REMOTE_MAGIC or version != sniffer.REMOTE_VERSION:
+                raise IOError('not a sniffer of this version')
+
+            name = payload[sniffer.REMOTE_HELLO.size:].decode('utf-8', 'replace')
+            site = self.getSite(name)
+            with site.lock:
+                nextIndex = site.nextIndex(session)
+            sniffer.remoteSendBlock(connection, sniffer.REMOTE_BLOCK_RESUME, sniffer.REMOTE_INDEX.pack(nextIndex))
+            if not self.args.quiet:
+                print('Site ' + name + ' connected from ' + peer + ', continuing at frame ' + str(nextIndex))
+
+            while True:
+                blockType, payload = sniffer.remoteReadBlock(connection)
+                if blockType != sniffer.REMOTE_BLOCK_RECORDS:
+                    raise IOError('unexpected block ' + str(blockType))
+
+                first, count = sniffer.REMOTE_RECORDS.unpack_from(payload)
+                records = sniffer.remoteDecodeRecords(payload, count)
+                with site.lock:
+                    nextIndex = site.write(session, first, records)
+
+                # Only what is on the disk is acknowledged, the sniffer keeps the rest
+                sniffer.remoteSendBlock(connection, sniffer.REMOTE_BLOCK_ACK, sniffer.REMOTE_INDEX.pack(nextIndex))
+
+        except (socket.error, IOError, OSError, ValueError, struct.error, zlib.error) as e:
+            if not self.args.quiet:
+                print('Connection with ' + peer + ' ended: ' + str(e))
+        finally:
+            connection.close()
+
+    def close(self):
+        with self.lock:
+            for site in self.sites.values():
+                site.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Receive the frames that sniffer.py streams with --remote from any number of sites '
+                                                 'and write them to rotated pcapng files, in a directory per site')
+    parser.add_argument('--listen', default=str(sniffer.REMOTE_PORT), metavar='[HOST:]PORT',
+                        help='Address to accept the sniffers on, all interfaces when only a port is given (default: %d)' % sniffer.REMOTE_PORT)
+    parser.add_argument('-d', '--directory', default='.',
+                        help='Directory in which a directory is made for every site (default: the current directory)')
+    parser.add_argument('--rotate-size', type=int, default=100,
+                        help='Start a new file of a site after this amount of MB, 0 to never rotate on size (default: 100)')
+    parser.add_argument('--rotate-time', type=int, default=0,
+                        help='Start a new file of a site after this amount of seconds (default: never)')
+    parser.add_argument('--max-files', type=int, default=0,
+                        help='Only keep the newest files of every site (default: keep all)')
+    parser.add_argument('--quiet', action='store_true', help="Don't print when the sniffers connect and disconnect")
+    args = parser.parse_args()
+
+    host, _, port = args.listen.rpartition(':')
+    if not port.isdigit() or int(port) < 1 or int(port) > 65535:
+        sys.stderr.write('ERROR: The address to listen on should be "[HOST:]PORT"\n')
+        return 1
+    if args.rotate_size < 0 or args.rotate_time < 0 or args.max_files < 0:
+        sys.stderr.write('ERROR: The rotation limits can not be negative\n')
+        return 1
+
+    try:
+        server = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        server.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        server.bind((host, int(port)))
+        server.listen(16)
+    except (socket.error, OSError) as e:
+        sys.stderr.write('ERROR: Could not listen on ' + args.listen + '. Exception: ' + str(e) + '\n')
+        return 1
+
+    collector = Collector(args)
+    try:
+        while True:
+            connection, address = server.accept()
+            thread = threading.Thread(target=collector.serve, args=[connection, address])
+            thread.daemon = True
+            thread.start()
+    except KeyboardInterrupt:
+        pass
+
+    server.close()
+    collector.close()
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,220 @@
+#!/usr/bin/env python
+
+__author__ = 'Bruno Van de Velde (bruno@texus.me)'
+__license__ = 'GNU General Public License v2'
+
+import sys
+import struct
+import argparse
+
+import sniffer
+
+
+CCM_FLAGS = 1  # First byte of each counter block of CCM* with a length field of 2 bytes (L - 1), the counter starts at 1
+
+
+def multiply(a, b):
+    # Multiplication in GF(2^8) with the polynomial of AES
+    result = 0
+    while b:
+        if b & 1:
+            result ^= a
+        a = ((a << 1) ^ 0x11b) if a & 0x80 else (a << 1)
+        b >>= 1
+    return result
+
+
+def makeTables():
+    # The S-box is the inverse in GF(2^8) followed by an affine transformation, each table combines it with a column of MixColumns
+    sbox = [0] * 256
+    for x in range(256):
+        inverse = next((y for y in range(1, 256) if multiply(x, y) == 1), 0)
+        s = inverse
+        for shift in range(1, 5):
+            s ^= ((inverse << shift) | (inverse >> (8 - shift))) & 0xff
+        sbox[x] = s ^ 0x63
+
+    tables = [[0] * 256 for i in range(4)]
+    for x in range(256):
+        s = sbox[x]
+        word = (multiply(s, 2) << 24) | (s << 16) | (s << 8) | multiply(s, 3)
+        for i in range(4):
+            tables[i][x] = ((word >> (8 * i)) | (word << (32 - 8 * i))) & 0xffffffff
+    return sbox, tables
+
+
+class Aes128:
+    # Only the encryption of AES-128 in python, which is all that the counter mode needs. The cryptography module is used instead
+    # when it is installed, as it is a lot faster.
+    sbox = None
+    tables = None
+
+    def __init__(self, key):
+        try:
+            from cryptography.hazmat.primitives.ciphers import Cipher, algorithms, modes
+            self.encryptor = Cipher(algorithms.AES(key), modes.ECB()).encryptor()
+            return
+        except ImportError:
+            self.encryptor = None
+
+        if Aes128.sbox == None:
+            Aes128.sbox, Aes128.tables = makeTables()
+        sbox = Aes128.sbox
+        words = list(struct.unpack('>4I', key))
+        rcon = 1
+        for i in range(4, 44):
+            word = words[i - 1]
+            if i % 4 == 0:
+                word = ((sbox[(word >> 16) & 0xff] << 24) | (sbox[(word >> 8) & 0xff] << 16) | (sbox[word & 0xff] << 8)
+                        | sbox[word >> 24]) ^ (rcon << 24)
+                rcon = multiply(rcon, 2)
+            words.append(words[i - 4] ^ word)
+        self.roundKeys = [words[i:i + 4] for i in range(0, 44, 4)]
+
+    def encryptBlocks(self, blocks):
+        if self.encryptor != None:
+            return self.encryptor.update(blocks)
+
+        sbox = self.sbox
+        t0, t1, t2, t3 = self.tables
+        output = bytearray()
+        for pos in range(0, len(blocks), 16):
+            k = self.roundKeys[0]
+            s0, s1, s2, s3 = struct.unpack_from('>4I', blocks, pos)
+            s0 ^= k[0]
+            s1 ^= k[1]
+            s2 ^= k[2]
+            s3 ^= k[3]
+            for k in self.roundKeys[1:10]:
+                s0, s1, s2, s3 = \
+                    (t0[s0 >> 24] ^ t1[(s1 >> 16) & 0xff] ^ t2[(s2 >> 8) & 0xff] ^ t3[s3 & 0xff] ^ k[0],
+                     t0[s1 >> 24] ^ t1[(s2 >> 16) & 0xff] ^ t2[(s3 >> 8) & 0xff] ^ t3[s0 & 0xff] ^ k[1],
+                     t0[s2 >> 24] ^ t1[(s3 >> 16) & 0xff] ^ t2[(s0 >> 8) & 0xff] ^ t3[s1 & 0xff] ^ k[2],
+                     t0[s3 >> 24] ^ t1[(s0 >> 16) & 0xff] ^ t2[(s1 >> 8) & 0xff] ^ t3[s2 & 0xff] ^ k[3])
+
+            # The last round has no MixColumns
+            k = self.roundKeys[10]
+            state = (s0, s1, s2, s3)
+            for i in range(4):
+                word = ((sbox[state[i] >> 24] << 24) | (sbox[(state[(i + 1) % 4] >> 16) & 0xff] << 16)
+                        | (sbox[(state[(i + 2) % 4] >> 8) & 0xff] << 8) | sbox[state[(i + 3) % 4] & 0xff]) ^ k[i]
+                output += struct.pack('>I', word)
+        return bytes(output)
+
+
+def decryptRecord(aes, noncePrefix, fullSeqNr, data):
+    # CCM* without a MIC: the data is XORed with the encrypted counter blocks, as the AES engine of the OpenMote did
+    nonce = noncePrefix + struct.pack('>IB', fullSeqNr, 0)
+    blocks = b''.join(struct.pack('B', CCM_FLAGS) + nonce + struct.pack('>H', i + 1) for i in range((len(data) + 15) // 16))
+    keystream = aes.encryptBlocks(blocks)
+    return bytearray(a ^ b for a, b in zip(data, keystream))
+
+
+def readBlocks(fileName):
+    with open(fileName, 'rb') as f:
+        if f.read(len(sniffer.ENCRYPTED_MAGIC)) != sniffer.ENCRYPTED_MAGIC:
+            raise ValueError(fileName + ' was not written with --encrypt-key')
+
+        # A file that was cut off while writing keeps the blocks that were complete
+        while True:
+            header = f.read(sniffer.ENCRYPTED_BLOCK.size)
+            if len(header) < sniffer.ENCRYPTED_BLOCK.size:
+                return
+            blockType, length = sniffer.ENCRYPTED_BLOCK.unpack(header)
+            data = f.read(length)
+            if len(data) < length:
+                return
+            yield blockType, data
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Decrypt the frames that sniffer.py stored with --encrypt-key and write them to a pcap file')
+    parser.add_argument('capture', help='File written by sniffer.py with --encrypt-key')
+    parser.add_argument('-k', '--key', required=True, help='The key that was given to --encrypt-key (16 bytes in hex)')
+    parser.add_argument('-o', '--output', required=True, help='The pcap file to write')
+    parser.add_argument('--pcapng', action='store_true', help='Write a pcapng file, as sniffer.py does when hopping or with --pcapng')
+    parser.add_argument('--keep-bad-fcs', action='store_true', help="Don't discard packets that have a bad checksum")
+    parser.add_argument('--replace-fcs', action='store_true', help='Keep the TI CC24XX FCS which contains the RSSI and LQI')
+    args = parser.parse_args()
+
+    try:
+        key = bytes(bytearray.fromhex(args.key.replace(':', '')))
+    except ValueError:
+        key = b''
+    if len(key) != sniffer.ENCRYPTION_KEY_LEN:
+        print('The key should be ' + str(sniffer.ENCRYPTION_KEY_LEN) + ' bytes in hex')
+        return 1
+    aes = Aes128(key)
+
+    sniffer.pcapngOutput = args.pcapng
+    sniffer.output = open(args.output, 'wb')
+    sniffer.outputIsFile = True
+    sniffer.outputWriter = sniffer.OutputWriter()
+    sniffer.outputGlobalHeader()
+    sniffer.outputWriter.headerWritten()
+    sniffer.outputSinks = [sniffer.CaptureSink()]
+
+    frames = [0]
+    outputPacket = sniffer.outputPacket
+    def countPacket(*arguments, **keywords):
+        frames[0] += 1
+        outputPacket(*arguments, **keywords)
+    sniffer.outputPacket = countPacket
+
+    # The records go through the same processing as in sniffer.py, as if they had just arrived in the clear
+    packetProcessor = sniffer.PacketProcessor(not args.keep_bad_fcs, args.replace_fcs)
+    noncePrefix = None
+    aligned = False
+    hostTime = None
+    records = 0
+    invalid = 0
+    try:
+        for blockType, data in readBlocks(args.capture):
+            if blockType == sniffer.ENCRYPTED_BLOCK_SESSION and len(data) == sniffer.ENCRYPTED_SESSION.size:
+                nonce, epoch, hostTime, tickRate, flags = sniffer.ENCRYPTED_SESSION.unpack(data)
+                packetProcessor.resetVariables()
+                sniffer.timestampTickRate = tickRate
+                noncePrefix = nonce + struct.pack('>I', epoch)
+                aligned = (flags & sniffer.ENCRYPTED_SESSION_ALIGNED) != 0
+                continue
+
+            if blockType != sniffer.ENCRYPTED_BLOCK_RECORD or noncePrefix == None or len(data) < 4:
+                invalid += 1
+                continue
+
+            records += 1
+            fullSeqNr = struct.unpack_from('<I', data)[0]
+            record = bytearray(data[4:])
+            start = sniffer.TIMESTAMP_OFFSET - 2
+            msg = bytearray([sniffer.SerialDataType.Packet, 0]) + record[:start] + decryptRecord(aes, noncePrefix, fullSeqNr, record[start:])
+            msg[1] = len(msg)
+            if aligned:
+                msg = sniffer.removeRecordPadding(msg)
+            if msg == None or len(msg) < sniffer.DATA_OFFSET:
+                invalid += 1
+                continue
+
+            # The time of the first record of a session is the time at which the host received it
+            if packetProcessor.hostTimeAnchor == None:
+                moteTime = struct.unpack_from('>I', bytes(msg), sniffer.TIMESTAMP_OFFSET)[0]
+                packetProcessor.hostTimeAnchor = hostTime
+                packetProcessor.moteTimeAnchor = moteTime
+                packetProcessor.lastMoteTime = moteTime
+
+            packetProcessor.recordAccepted(msg)
+    except (IOError, OSError, ValueError) as e:
+        print('ERROR: Could not read the encrypted capture. Exception: ' + str(e))
+        return 1
+    finally:
+        sniffer.outputWriter.stop()
+        sniffer.output.close()
+
+    print('Decrypted ' + str(records) + ' records into ' + str(frames[0]) + ' frames' +
+          (', ' + str(invalid) + ' blocks were invalid' if invalid > 0 else ''))
+    if records > 0 and frames[0] == 0 and not args.keep_bad_fcs:
+        print('WARNING: No frame had a correct FCS, the key is probably wrong')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -1,10 +1,161 @@
 #!/usr/bin/env python
 
 import subprocess
+import threading
+import argparse
+import binascii
+import glob
+import time
 import sys
 import os
 
 bslScript = os.path.join(os.path.dirname(os.path.realpath(sys.argv[0])), 'OpenMoteFirmware/tools/openmote-bsl/openmote-bsl.py')
+bslModule = os.path.join(os.path.dirname(os.path.realpath(sys.argv[0])), 'OpenMoteFirmware/tools/openmote-bsl/cc2538-bsl/cc2538-bsl.py')
 hexFile = os.path.join(os.path.dirname(os.path.realpath(sys.argv[0])), 'OpenMoteSniffer.hex')
 
-subprocess.call([sys.executable, bslScript, hexFile, '--board=openbase'])
+# Images with a reduced capture path, build with "make CAPTURE=filter" or "make CAPTURE=basic" in src
+CAPTURE_IMAGES = {'full': 'OpenMoteSniffer.hex', 'filter': 'OpenMoteSniffer-filter.hex', 'basic': 'OpenMoteSniffer-basic.hex'}
+
+FLASH_START     = 0x00200000
+FLASH_PAGE_SIZE = 2048  # Smallest part of the flash that can be erased
+IMAGE_FULL_SIZE = 524288  # An image of the whole flash ends with the page that contains the boot loader backdoor configuration
+BACKDOOR_OFFSET = 524247  # Byte of the image with the bit that keeps the boot loader backdoor enabled
+BACKDOOR_ENABLE = 1 << 4
+
+# The ROM boot loader starts on the internal oscillator, after switching to the crystal it accepts these rates (fastest first)
+BSL_BAUDRATE   = 115200
+FAST_BAUDRATES = [1000000, 460800, 230400]
+
+
+def loadBslModule():
+    # cc2538-bsl.py isn't a valid module name, so it is loaded from its path
+    try:
+        import importlib.util
+        spec = importlib.util.spec_from_file_location('cc2538_bsl', bslModule)
+        module = importlib.util.module_from_spec(spec)
+        spec.loader.exec_module(module)
+    except ImportError:
+        import imp
+        module = imp.load_source('cc2538_bsl', bslModule)
+
+    # Its progress messages would be mixed up when flashing several ports, each port prints a summary instead
+    module.QUIET = 0
+    return module
+
+
+def findDefaultPort():
+    # The same ports that cc2538-bsl.py looks at when no port is given
+    ports = []
+    for name in ['tty.usbserial', 'ttyUSB', 'tty.usbmodem']:
+        ports.extend(glob.glob('/dev/%s*' % name))
+    return sorted(ports)[:1]
+
+
+def connect(bsl, cmd, port, useBslLines):
+    cmd.open(port, BSL_BAUDRATE, bsl=useBslLines)
+    if not cmd.sendSynch():
+        raise bsl.CmdException("Can't connect to target. Ensure boot loader is started.")
+
+    # The boot loader synchronizes on the first bytes after the port was opened again, the next rate is tried when it doesn't answer
+    if not cmd.cmdSetXOsc():
+        return BSL_BAUDRATE
+
+    for rate in FAST_BAUDRATES:
+        cmd.close(bsl=useBslLines)
+        cmd.open(port, rate, bsl=useBslLines)
+        if cmd.sendSynch():
+            return rate
+
+    raise bsl.CmdException("Can't connect to target after switching to the external crystal.")
+
+
+def flashPort(bsl, port, image, useBslLines, results):
+    start = time.time()
+    cmd = bsl.CommandInterface()
+    try:
+        baudrate = connect(bsl, cmd, port, useBslLines)
+
+        # Pages that already contain the right data are left alone, the target calculates their CRC32 itself.
+        # The page with the boot loader backdoor configuration comes last, so an interrupted flash can still be repeated.
+        pages = list(range(0, len(image), FLASH_PAGE_SIZE))
+        written = 0
+        for offset in pages:
+            page = image[offset:offset + FLASH_PAGE_SIZE]
+            address = FLASH_START + offset
+            if cmd.cmdCRC32(address, len(page)) == binascii.crc32(page) & 0xffffffff:
+                continue
+
+            if not cmd.cmdEraseMemory(address, FLASH_PAGE_SIZE):
+                raise bsl.CmdException('Erasing the page at 0x%X failed' % address)
+            if page != b'\xff' * len(page) and not cmd.writeMemory(address, page):
+                raise bsl.CmdException('Writing the page at 0x%X failed' % address)
+            written += 1
+
+        if cmd.cmdCRC32(FLASH_START, len(image)) != binascii.crc32(image) & 0xffffffff:
+            raise bsl.CmdException('The CRC32 of the flash does not match the image')
+
+        cmd.cmdReset()
+        cmd.close(bsl=useBslLines)
+        results[port] = '%d of %d pages written at %d baud in %.1f seconds' % (written, len(pages), baudrate, time.time() - start)
+    except Exception as e:
+        results[port] = 'ERROR: ' + str(e)
+        try:
+            cmd.close(bsl=useBslLines)
+        except Exception:
+            pass
+
+
+def fastFlash(ports, imageFile, useBslLines):
+    with open(imageFile, 'rb') as f:
+        image = bytearray(f.read())
+
+    # cc2538-bsl.py asks before writing such an image, there is nobody to ask when flashing several OpenMotes at once
+    if len(image) == IMAGE_FULL_SIZE and not image[BACKDOOR_OFFSET] & BACKDOOR_ENABLE:
+        print('ERROR: The boot loader backdoor is not enabled in ' + imageFile + ', flash it without --fast if you really want this')
+        return 1
+    if len(image) % 4 != 0:
+        image.extend(b'\xff' * (4 - len(image) % 4))
+
+    # The serial ports are independent, every OpenMote is flashed in its own thread
+    bsl = loadBslModule()
+    results = {}
+    threads = [threading.Thread(target=flashPort, args=(bsl, port, image, useBslLines, results)) for port in ports]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+
+    for port in ports:
+        print(port + ': ' + results[port])
+    return 1 if any(result.startswith('ERROR') for result in results.values()) else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Flash the sniffer firmware on an OpenMote that is connected with an OpenBase')
+    parser.add_argument('-f', '--fast', action='store_true',
+                        help='Flash at the highest baudrate of the boot loader and only erase and write the pages that changed')
+    parser.add_argument('-p', '--port', action='append', default=[],
+                        help='Serial port of the OpenMote, can be given several times to flash them in parallel (implies --fast)')
+    parser.add_argument('--bsl', action='store_true', help='Use the DTR/RTS lines to start the boot loader (OpenUSB)')
+    parser.add_argument('--image', default=hexFile, help='Firmware image to flash (default: OpenMoteSniffer.hex)')
+    parser.add_argument('--capture', choices=sorted(CAPTURE_IMAGES.keys()),
+                        help='Flash the image with this capture path instead: full has every feature, filter only the filter '
+                             'rules, FCS filter, snap length and overflow policy, basic only copies the frames')
+    args = parser.parse_args()
+
+    if args.capture != None:
+        args.image = os.path.join(os.path.dirname(hexFile), CAPTURE_IMAGES[args.capture])
+
+    if not args.fast and len(args.port) == 0:
+        return subprocess.call([sys.executable, bslScript, args.image, '--board=openbase'])
+
+    ports = args.port if len(args.port) > 0 else findDefaultPort()
+    if len(ports) == 0:
+        print('ERROR: No serial port found, pass it with --port')
+        return 1
+
+    return fastFlash(ports, args.image, args.bsl)
+
+
+if __name__ == '__main__':
+    sys.exit(main())
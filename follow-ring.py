@@ -0,0 +1,72 @@
+#!/usr/bin/env python
+
+__author__ = 'Bruno Van de Velde (bruno@texus.me)'
+__license__ = 'GNU General Public License v2'
+
+import sys
+import time
+import argparse
+
+import sniffer
+
+
+POLL_INTERVAL = 0.01  # Seconds between looking for new records when the ring had none
+
+
+def writeRecords(output, records):
+    for packet, timestamp, originalLength, channel, rssi, lqi, fcsIncluded, crcError, packetId in records:
+        output.write(sniffer.PCAP_RECORD_HEADER.pack((timestamp // 1000000) & 0xffffffff, timestamp % 1000000,
+                                                     len(packet), originalLength) + bytes(packet))
+    output.flush()
+    return len(records)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Follow the frames that sniffer.py publishes with --shared-ring and write them '
+                                                 'to a pcap file or stdout, next to any other program that follows the same ring')
+    parser.add_argument('ring', help='File given to sniffer.py with --shared-ring')
+    parser.add_argument('-o', '--output', help='Write the frames to this pcap file instead of stdout')
+    parser.add_argument('--quiet', action='store_true', help="Don't print how many frames were read and lost when stopping")
+    args = parser.parse_args()
+
+    try:
+        reader = sniffer.SharedRingReader(args.ring)
+    except (IOError, OSError, ValueError) as e:
+        sys.stderr.write('ERROR: Could not open the ring. Exception: ' + str(e) + '\n')
+        return 1
+
+    output = open(args.output, 'wb') if args.output != None else getattr(sys.stdout, 'buffer', sys.stdout)
+
+    # Same pcap header as sniffer.py writes, the FCS is kept when the frame has one
+    header = bytearray([0xa1, 0xb2, 0xc3, 0xd4, 0, 2, 0, 4] + [0] * 8 + [0, 0, 0xff, 0xff, 0, 0, 0, 195])
+    output.write(header)
+    output.flush()
+
+    frames = 0
+    try:
+        while not reader.closed():
+            records = reader.read()
+            if len(records) == 0:
+                time.sleep(POLL_INTERVAL)
+                continue
+
+            frames += writeRecords(output, records)
+
+        # The records that were completed just before the ring was closed
+        frames += writeRecords(output, reader.read())
+
+    except KeyboardInterrupt:
+        pass
+    except IOError:
+        pass  # The program reading stdout stopped
+
+    reader.close()
+    if args.output != None:
+        output.close()
+    if not args.quiet:
+        sys.stderr.write('Read ' + str(frames) + ' frames, lost ' + str(reader.lost) + ' frames by falling behind\n')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
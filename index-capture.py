@@ -0,0 +1,376 @@
+#!/usr/bin/env python
+
+__author__ = 'Bruno Van de Velde (bruno@texus.me)'
+__license__ = 'GNU General Public License v2'
+
+import os
+import sys
+import json
+import mmap
+import time
+import struct
+import argparse
+
+import sniffer
+
+
+INDEX_EXTENSION = '.idx'  # Same name as the index that sniffer.py writes next to a rotated file, which this one extends
+PCAP_GLOBAL_HEADER_LEN = 24
+PCAPNG_BLOCK = struct.Struct('>II')  # Block type and length
+PCAPNG_SECTION_HEADER = 0x0A0D0D0A
+PCAPNG_INTERFACE = 0x00000001
+PCAPNG_ENHANCED_PACKET = 0x00000006
+PCAPNG_EPB_DATA_OFFSET = 28  # Block type and length, interface, timestamp (2x), saved length and original length
+PCAPNG_OPTION_FLAGS = 2
+PCAPNG_OPTION_PACKETID = 5
+
+
+class CaptureReader:
+    # Walks the records of a pcap or pcapng file that sniffer.py wrote, through a memory map so that a capture of any size
+    # is never loaded at once. Problems with the structure of the file are collected instead of stopping at the first one,
+    # only a record that can't be delimited ends the walk.
+    def __init__(self, fileName):
+        self.fileName = fileName
+        self.file = open(fileName, 'rb')
+        self.size = os.fstat(self.file.fileno()).st_size
+        self.data = mmap.mmap(self.file.fileno(), 0, access=mmap.ACCESS_READ) if self.size > 0 else b''
+        self.problems = []
+        self.pcapng = self.size >= 4 and struct.unpack_from('>I', self.data, 0)[0] == PCAPNG_SECTION_HEADER
+        if not self.pcapng and (self.size < PCAP_GLOBAL_HEADER_LEN or self.data[:4] != b'\xa1\xb2\xc3\xd4'):
+            self.close()
+            raise ValueError(fileName + ' is neither a pcap nor a pcapng file written by sniffer.py')
+
+    def close(self):
+        if self.size > 0:
+            self.data.close()
+        self.file.close()
+
+    def problem(self, offset, text):
+        self.problems.append('offset ' + str(offset) + ': ' + text)
+
+    def header(self, end):
+        # The bytes in front of the first record, which make the records behind them readable on their own
+        return self.data[:end]
+
+    def records(self, offset=None, count=None):
+        # Yields the offset and end of every record, its timestamp in microseconds, the frame without the TAP header,
+        # the packet id (pcapng only, None otherwise) and whether the FCS was wrong
+        if offset == None:
+            offset = 0 if self.pcapng else PCAP_GLOBAL_HEADER_LEN
+        walk = self.pcapngRecords(offset) if self.pcapng else self.pcapRecords(offset)
+        for record in walk:
+            if count != None:
+                if count == 0:
+                    return
+                count -= 1
+            yield record
+
+    def pcapRecords(self, offset):
+        while offset < self.size:
+            if offset + sniffer.PCAP_RECORD_HEADER.size > self.size:
+                self.problem(offset, 'record header is cut off')
+                return
+            seconds, microseconds, savedLength, originalLength = sniffer.PCAP_RECORD_HEADER.unpack_from(self.data, offset)
+            end = offset + sniffer.PCAP_RECORD_HEADER.size + savedLength
+            if end > self.size:
+                self.problem(offset, 'record is cut off')
+                return
+            if savedLength > originalLength or microseconds >= 1000000:
+                self.problem(offset, 'invalid record header')
+
+            frame = self.data[offset + sniffer.PCAP_RECORD_HEADER.size:end]
+            yield (offset, end, seconds * 1000000 + microseconds, frame, None, False)
+            offset = end
+
+    def pcapngRecords(self, offset):
+        while offset < self.size:
+            if offset + PCAPNG_BLOCK.size > self.size:
+                self.problem(offset, 'block header is cut off')
+                return
+            blockType, blockLength = PCAPNG_BLOCK.unpack_from(self.data, offset)
+            end = offset + blockLength
+            if blockLength < 12 or blockLength % 4 != 0 or end > self.size:
+                self.problem(offset, 'block is cut off or has an invalid length')
+                return
+            if struct.unpack_from('>I', self.data, end - 4)[0] != blockLength:
+                self.problem(offset, 'block lengths in front and at the end differ')
+
+            if blockType == PCAPNG_ENHANCED_PACKET:
+                record = self.enhancedPacket(offset, end)
+                if record != None:
+                    yield record
+            offset = end
+
+    def enhancedPacket(self, offset, end):
+        if offset + PCAPNG_EPB_DATA_OFFSET + 4 > end:
+            self.problem(offset, 'packet block is too short')
+            return None
+
+        interface, high, low, savedLength, originalLength = struct.unpack_from('>IIIII', self.data, offset + 8)
+        dataStart = offset + PCAPNG_EPB_DATA_OFFSET
+        optionsStart = dataStart + savedLength + (4 - savedLength % 4) % 4
+        if optionsStart > end - 4 or savedLength > originalLength:
+            self.problem(offset, 'packet block has an invalid length')
+            return None
+
+        # The frame follows the TLVs with the FCS type, RSSI, channel and LQI
+        data = self.data[dataStart:dataStart + savedLength]
+        tapLength = struct.unpack_from('<H', data, 2)[0] if len(data) >= 4 else len(data)
+        frame = data[tapLength:]
+
+        packetId = None
+        crcError = False
+        pos = optionsStart
+        while pos + 4 <= end - 4:
+            code, length = struct.unpack_from('>HH', self.data, pos)
+            if code == 0:
+                break
+            if pos + 4 + length > end - 4:
+                self.problem(offset, 'packet block has an invalid option')
+                break
+            if code == PCAPNG_OPTION_PACKETID and length == 8:
+                packetId = struct.unpack_from('>Q', self.data, pos + 4)[0]
+            elif code == PCAPNG_OPTION_FLAGS and length == 4:
+                crcError = (struct.unpack_from('>I', self.data, pos + 4)[0] & sniffer.PCAPNG_EPB_CRC_ERROR) != 0
+            pos += 4 + length + (4 - length % 4) % 4
+
+        return (offset, end, ((high << 32) | low) // 1000, frame, packetId, crcError)
+
+
+def sourceKey(frame):
+    # Short addresses are only unique within their PAN, so the PAN is part of the key
+    frameType, dstPan, dstMode, dstAddr, srcPan, srcMode, srcAddr = sniffer.parseMacAddresses(bytearray(frame[:23]))
+    if srcMode == 2:
+        return '0x%04x/0x%04x' % (srcPan, srcAddr)
+    if srcMode == 3:
+        return ':'.join('%02x' % ((srcAddr >> (8 * i)) & 0xff) for i in reversed(range(8)))
+    return None
+
+
+def queryKeys(text):
+    # The source as given on the command line, a short address with or without the PAN as PAN/ADDRESS
+    pan, separator, address = text.rpartition('/')
+    mode, addr = sniffer.parseAddress(address)
+    if mode == 3:
+        return [':'.join('%02x' % byte for byte in addr)]
+    short = '0x%02x%02x' % (addr[0], addr[1])
+    return [('0x%04x/' % int(pan, 0)) + short] if separator else [short]
+
+
+def sourceMatches(key, wanted):
+    if key == None:
+        return False
+    return any(key == source or key.endswith('/' + source) for source in wanted)
+
+
+def buildIndex(reader, interval):
+    # Verifies every record while walking the file once and returns the index, which contains the offset of every
+    # interval-th record by time (as sniffer.py writes for a rotated file) and the intervals in which each source appears
+    index = []
+    sources = {}
+    epochs = []
+    packets = 0
+    crcErrors = 0
+    firstTimestamp = None
+    lastTimestamp = None
+    ordered = True
+    for offset, end, timestamp, frame, packetId, crcError in reader.records():
+        if packets % interval == 0:
+            index.append([packets, offset, timestamp])
+        if firstTimestamp == None:
+            firstTimestamp = timestamp
+        elif timestamp < lastTimestamp:
+            if ordered:
+                reader.problem(offset, 'timestamp goes back in time, the index can only be searched by source')
+            ordered = False
+        lastTimestamp = timestamp
+
+        key = sourceKey(frame)
+        if key != None:
+            blocks = sources.setdefault(key, [])
+            if len(blocks) == 0 or blocks[-1] != packets // interval:
+                blocks.append(packets // interval)
+
+        # Within an epoch the sequence numbers count up, a gap means that records were dropped on the way
+        if packetId != None:
+            epoch, seqNr = packetId >> 32, packetId & 0xffffffff
+            if len(epochs) == 0 or epochs[-1]['epoch'] != epoch:
+                epochs.append({'epoch': epoch, 'first': seqNr, 'last': seqNr, 'missing': 0, 'gaps': 0, 'out_of_order': 0})
+            else:
+                current = epochs[-1]
+                if seqNr > current['last'] + 1:
+                    current['missing'] += seqNr - current['last'] - 1
+                    current['gaps'] += 1
+                elif seqNr <= current['last']:
+                    current['out_of_order'] += 1
+                current['last'] = max(current['last'], seqNr)
+
+        crcErrors += 1 if crcError else 0
+        packets += 1
+
+    return {'first_timestamp': firstTimestamp, 'last_timestamp': lastTimestamp, 'packets': packets, 'bytes': reader.size,
+            'index_interval': interval, 'index': index, 'ordered': ordered, 'sources': sources, 'epochs': epochs,
+            'crc_errors': crcErrors, 'problems': reader.problems}
+
+
+def loadIndex(fileName):
+    # Only an index of this tool has the sources, and only when the file didn't grow since it was written
+    try:
+        with open(fileName + INDEX_EXTENSION, 'r') as indexFile:
+            index = json.load(indexFile)
+    except (IOError, OSError, ValueError):
+        return None
+    if 'sources' not in index or index['bytes'] != os.path.getsize(fileName):
+        return None
+    return index
+
+
+def printReport(fileName, index):
+    duration = (index['last_timestamp'] - index['first_timestamp']) / 1e6 if index['packets'] > 0 else 0
+    print(fileName + ': ' + str(index['packets']) + ' frames over ' + '%.1f' % duration + ' seconds from '
+          + str(len(index['sources'])) + ' sources, ' + str(index['crc_errors']) + ' with a bad FCS')
+    for epoch in index['epochs']:
+        print('  epoch 0x%08x: records %d to %d, %d missing in %d gaps, %d out of order'
+              % (epoch['epoch'], epoch['first'], epoch['last'], epoch['missing'], epoch['gaps'], epoch['out_of_order']))
+    for problem in index['problems']:
+        print('  ' + problem)
+
+
+def parseTime(text):
+    # Seconds since 1970 or a local time as YYYY-MM-DDTHH:MM:SS, returned in microseconds like the timestamps
+    try:
+        return int(float(text) * 1000000)
+    except ValueError:
+        pass
+    seconds, dot, fraction = text.partition('.')
+    value = time.mktime(time.strptime(seconds, '%Y-%m-%dT%H:%M:%S'))
+    return int(value * 1000000) + (int((fraction + '000000')[:6]) if dot else 0)
+
+
+def indexFiles(args):
+    failed = False
+    for fileName in args.files:
+        try:
+            reader = CaptureReader(fileName)
+        except (IOError, OSError, ValueError) as e:
+            print('ERROR: Could not read ' + fileName + '. Exception: ' + str(e))
+            failed = True
+            continue
+
+        index = buildIndex(reader, args.interval)
+        reader.close()
+        if args.command == 'index':
+            with open(fileName + INDEX_EXTENSION, 'w') as indexFile:
+                json.dump(index, indexFile, separators=(',', ':'))
+        if not args.quiet or len(index['problems']) > 0:
+            printReport(fileName, index)
+        if len(index['problems']) > 0:
+            failed = True
+    return 1 if failed else 0
+
+
+def queryFiles(args):
+    wanted = []
+    try:
+        for source in args.source:
+            wanted += queryKeys(source)
+        start = parseTime(args.start) if args.start != None else None
+        stop = parseTime(args.end) if args.end != None else None
+    except ValueError as e:
+        print('ERROR: ' + str(e))
+        return 2
+
+    output = open(args.output, 'wb') if args.output != None else getattr(sys.stdout, 'buffer', sys.stdout)
+    pcapngOutput = None
+    frames = 0
+    for fileName in args.files:
+        try:
+            reader = CaptureReader(fileName)
+        except (IOError, OSError, ValueError) as e:
+            sys.stderr.write('ERROR: Could not read ' + fileName + '. Exception: ' + str(e) + '\n')
+            continue
+
+        index = loadIndex(fileName)
+        if index == None:
+            sys.stderr.write('Indexing ' + fileName + ', run "index" first to do this only once\n')
+            index = buildIndex(reader, sniffer.ROTATION_INDEX_INTERVAL)
+
+        # A pcap file only has its header once, every pcapng file starts a section with its own interfaces
+        if pcapngOutput == None:
+            pcapngOutput = reader.pcapng
+        elif pcapngOutput != reader.pcapng:
+            sys.stderr.write('ERROR: ' + fileName + ' can not be combined with files of the other format\n')
+            reader.close()
+            continue
+
+        if index['packets'] == 0 or (index['ordered'] and ((start != None and index['last_timestamp'] < start)
+                                                           or (stop != None and index['first_timestamp'] > stop))):
+            reader.close()
+            continue
+
+        # Only the intervals that contain one of the sources and that overlap with the requested time are read
+        blocks = list(range(len(index['index'])))
+        if len(wanted) > 0:
+            blocks = sorted(set(block for key, keyBlocks in index['sources'].items() if sourceMatches(key, wanted)
+                                for block in keyBlocks))
+        if index['ordered']:
+            entries = index['index']
+            blocks = [block for block in blocks
+                      if (stop == None or entries[block][2] <= stop)
+                      and (start == None or block + 1 == len(entries) or entries[block + 1][2] >= start)]
+
+        headerWritten = frames > 0 and not reader.pcapng
+        for block in blocks:
+            for offset, end, timestamp, frame, packetId, crcError in reader.records(index['index'][block][1], index['index_interval']):
+                if (start != None and timestamp < start) or (stop != None and timestamp > stop):
+                    continue
+                if len(wanted) > 0 and not sourceMatches(sourceKey(frame), wanted):
+                    continue
+                if not headerWritten:
+                    output.write(reader.header(index['index'][0][1]))
+                    headerWritten = True
+                output.write(reader.data[offset:end])
+                frames += 1
+        reader.close()
+
+    if args.output != None:
+        output.close()
+    else:
+        output.flush()
+    sys.stderr.write('Found ' + str(frames) + ' frames\n')
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Verify the captures of sniffer.py, index them by time and source address, '
+                                                 'and find frames in them without reading the whole files')
+    subparsers = parser.add_subparsers(dest='command')
+    for command, description in [('index', 'Verify the files and write an index next to each of them'),
+                                 ('verify', 'Only verify the files')]:
+        subparser = subparsers.add_parser(command, help=description)
+        subparser.add_argument('files', nargs='+', help='pcap or pcapng files written by sniffer.py')
+        subparser.add_argument('--interval', type=int, default=sniffer.ROTATION_INDEX_INTERVAL,
+                               help='Frames between the entries of the index (default: ' + str(sniffer.ROTATION_INDEX_INTERVAL) + ')')
+        subparser.add_argument('-q', '--quiet', action='store_true', help='Only print the files that have problems')
+    query = subparsers.add_parser('query', help='Write the frames that match to a new capture')
+    query.add_argument('files', nargs='+', help='pcap or pcapng files written by sniffer.py, preferably indexed')
+    query.add_argument('--source', action='append', default=[],
+                       help='Short (PAN/ADDRESS or ADDRESS) or extended source address, can be given several times')
+    query.add_argument('--start', help='First time, in seconds since 1970 or as YYYY-MM-DDTHH:MM:SS (local time)')
+    query.add_argument('--end', help='Last time, in seconds since 1970 or as YYYY-MM-DDTHH:MM:SS (local time)')
+    query.add_argument('-o', '--output', help='Write the frames to this file instead of stdout')
+    args = parser.parse_args()
+
+    if args.command == 'query':
+        return queryFiles(args)
+    if args.command in ('index', 'verify'):
+        if args.interval <= 0:
+            print('The interval should be at least 1')
+            return 2
+        return indexFiles(args)
+    parser.print_help()
+    return 2
+
+
+if __name__ == '__main__':
+    sys.exit(main())
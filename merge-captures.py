@@ -0,0 +1,414 @@
+#!/usr/bin/env python
+
+__author__ = 'Bruno Van de Velde (bruno@texus.me)'
+__license__ = 'GNU General Public License v2'
+
+import os
+import re
+import sys
+import gzip
+import json
+import time
+import heapq
+import struct
+import argparse
+import threading
+import collections
+
+try:
+    import queue
+except ImportError:
+    import Queue as queue
+
+import sniffer
+
+
+BATCH_FRAMES      = 1000  # Frames that a reader hands to the merge at once
+QUEUED_BATCHES    = 4     # Batches that every reader may have waiting, which bounds the memory whatever the size of the files
+INDEX_EXTENSION   = '.idx'  # Index that sniffer.py writes next to a rotated file, or index-capture.py next to any capture
+COMPRESSED_EXTENSIONS = ('.gz', '.zst', '.lz4')  # Files that are decompressed while reading them
+ROTATION_NUMBER   = re.compile(r'_\d{5}$')  # Number that sniffer.py and collector.py put behind the name of a rotated file
+PCAPNG_SECTION_HEADER  = 0x0A0D0D0A
+PCAPNG_INTERFACE       = 0x00000001
+PCAPNG_ENHANCED_PACKET = 0x00000006
+PCAPNG_OPTION_IF_NAME    = 2
+PCAPNG_OPTION_IF_TSRESOL = 9
+PCAP_GLOBAL_HEADER = struct.Struct('>IHHiIII')  # Magic, version, time zone, accuracy, snap length and link type
+
+
+class CompressedReader:
+    # Decompresses a file from the frame that starts at the offset, the frames behind it follow without a break. A seek
+    # forward reads up to the position, the position counts the decompressed bytes from where the file started.
+    def __init__(self, fileName, extension, offset=0, position=0):
+        self.file = open(fileName, 'rb')
+        self.file.seek(offset)
+        self.position = position
+        try:
+            if extension == '.gz':
+                self.reader = gzip.GzipFile(fileobj=self.file, mode='rb')
+            elif extension == '.zst':
+                try:
+                    from compression import zstd
+                    self.reader = zstd.ZstdFile(self.file, 'rb')
+                except ImportError:
+                    import zstandard
+                    self.reader = zstandard.ZstdDecompressor().stream_reader(self.file, read_across_frames=True)
+            else:
+                import lz4.frame
+                self.reader = lz4.frame.LZ4FrameFile(self.file, 'rb')
+        except ImportError:
+            self.file.close()
+            raise IOError(fileName + ' can only be read with the ' + ('zstandard' if extension == '.zst' else 'lz4') + ' module')
+
+    def read(self, length):
+        data = self.reader.read(length)
+        self.position += len(data)
+        return data
+
+    def seek(self, position):
+        while self.position < position:
+            if len(self.read(min(position - self.position, 1024 * 1024))) == 0:
+                break
+
+    def close(self):
+        self.reader.close()
+        self.file.close()
+
+
+class Capture:
+    # A single input file with the time that it covers, from its index or else from reading it once
+    def __init__(self, fileName):
+        self.fileName = fileName
+        self.compression = os.path.splitext(fileName)[1] if fileName.endswith(COMPRESSED_EXTENSIONS) else None
+        base = os.path.splitext(fileName[:-len(self.compression)] if self.compression != None else fileName)[0]
+        self.sniffer = os.path.basename(ROTATION_NUMBER.sub('', base))  # Rotated files of the same sniffer share their interfaces
+        self.index = None
+        self.first = None
+        self.last = None
+        try:
+            with open(fileName + INDEX_EXTENSION, 'r') as indexFile:
+                index = json.load(indexFile)
+            # The index of a compressed file that sniffer.py wrote also has the size of the compressed file
+            size = index['compressed_bytes'] if self.compression != None else index['bytes']
+            if size == os.path.getsize(fileName) and index.get('ordered', True):
+                self.index = index
+                self.first, self.last = index['first_timestamp'], index['last_timestamp']
+        except (IOError, OSError, ValueError, KeyError):
+            pass
+
+    def scan(self):
+        # Without an index the file is read once to learn its first and last timestamp
+        for timestamp, interface, block in readCapture(self):
+            self.first = timestamp // 1000 if self.first == None else self.first
+            self.last = timestamp // 1000
+        self.first = 0 if self.first == None else self.first
+        self.last = self.first if self.last == None else self.last
+
+    def seekEntry(self, start):
+        # Last entry of the index before the start, the records in front of it are not read at all
+        if self.index == None or start == None or len(self.index['index']) == 0:
+            return None
+        entries = [entry for entry in self.index['index'] if entry[2] <= start]
+        return entries[-1] if len(entries) > 0 else None
+
+    def open(self):
+        if self.compression != None:
+            return CompressedReader(self.fileName, self.compression)
+        return open(self.fileName, 'rb')
+
+    def seek(self, file, entry):
+        # A compressed file of sniffer.py starts a frame at every entry, decompressing starts there instead of at the start
+        if self.compression != None and len(entry) > 3:
+            file.close()
+            return CompressedReader(self.fileName, self.compression, entry[3], entry[1])
+        file.seek(entry[1])
+        return file
+
+
+def readExact(file, length):
+    data = file.read(length)
+    if len(data) < length:
+        raise EOFError()
+    return data
+
+
+def readCapture(capture, start=None):
+    # Yields the timestamp in nanoseconds, the interface as (sniffer, name, link type) and the packet block of every frame,
+    # a pcap record is turned into a packet block
+    file = capture.open()
+    try:
+        magic = readExact(file, 4)
+        seekEntry = capture.seekEntry(start)
+        if magic == b'\xa1\xb2\xc3\xd4':
+            header = PCAP_GLOBAL_HEADER.unpack(magic + readExact(file, PCAP_GLOBAL_HEADER.size - 4))
+            interface = (capture.sniffer, capture.sniffer, header[6])
+            if seekEntry != None:
+                file = capture.seek(file, seekEntry)
+            while True:
+                try:
+                    seconds, microseconds, savedLength, originalLength = sniffer.PCAP_RECORD_HEADER.unpack(
+                        readExact(file, sniffer.PCAP_RECORD_HEADER.size))
+                    frame = readExact(file, savedLength)
+                except EOFError:
+                    return
+                nanoseconds = (seconds * 1000000 + microseconds) * 1000
+                yield nanoseconds, interface, packetBlock(nanoseconds, frame, originalLength)
+
+        if struct.unpack('>I', magic)[0] != PCAPNG_SECTION_HEADER:
+            raise ValueError(capture.fileName + ' is neither a pcap nor a pcapng file written by sniffer.py')
+
+        interfaces = []
+        blockType = PCAPNG_SECTION_HEADER
+        offset = 0
+        while True:
+            try:
+                blockLength = struct.unpack('>I', readExact(file, 4))[0]
+                body = readExact(file, blockLength - 8)
+            except EOFError:
+                return
+            if blockType == PCAPNG_SECTION_HEADER:
+                if struct.unpack_from('>I', body, 0)[0] != 0x1A2B3C4D:
+                    raise ValueError(capture.fileName + ' is not a big endian pcapng file as sniffer.py writes')
+                interfaces = []
+            elif blockType == PCAPNG_INTERFACE:
+                interfaces.append(interfaceDescription(capture, body))
+            elif blockType == PCAPNG_ENHANCED_PACKET and struct.unpack_from('>I', body, 0)[0] < len(interfaces):
+                interface, divisor = interfaces[struct.unpack_from('>I', body, 0)[0]]
+                high, low = struct.unpack_from('>II', body, 4)
+                nanoseconds = ((high << 32) | low) * 1000000000 // divisor
+                block = bytearray(struct.pack('>II', blockType, blockLength) + body)
+                struct.pack_into('>II', block, 12, (nanoseconds >> 32) & 0xffffffff, nanoseconds & 0xffffffff)
+                yield nanoseconds, interface, block
+
+            # The frames in front of the requested start are skipped once the interfaces are known
+            offset += blockLength
+            if seekEntry != None and blockType == PCAPNG_ENHANCED_PACKET and offset < seekEntry[1]:
+                file = capture.seek(file, seekEntry)
+                offset = seekEntry[1]
+                seekEntry = None
+            try:
+                blockType = struct.unpack('>I', readExact(file, 4))[0]
+            except EOFError:
+                return
+    finally:
+        file.close()
+
+
+def interfaceDescription(capture, body):
+    # The name of the interface within the sniffer and the units of its timestamps per second
+    linkType = struct.unpack_from('>H', body, 0)[0]
+    name = capture.sniffer
+    divisor = 1000000
+    position = 8
+    while position + 4 <= len(body) - 4:
+        code, length = struct.unpack_from('>HH', body, position)
+        if code == 0:
+            break
+        value = body[position + 4:position + 4 + length]
+        if code == PCAPNG_OPTION_IF_NAME:
+            name = capture.sniffer + ' ' + value.decode('ascii', 'replace')
+        elif code == PCAPNG_OPTION_IF_TSRESOL and length == 1:
+            resolution = bytearray(value)[0]
+            divisor = (2 ** (resolution & 0x7f)) if resolution & 0x80 else (10 ** resolution)
+        position += 4 + length + (4 - length % 4) % 4
+    return (capture.sniffer, name, linkType), divisor
+
+
+def packetBlock(nanoseconds, frame, originalLength):
+    padding = sniffer.PCAPNG_PADDING[(4 - len(frame) % 4) % 4]
+    blockLength = sniffer.PCAPNG_EPB_HEADER.size + len(frame) + len(padding) + 4
+    return bytearray(sniffer.PCAPNG_EPB_HEADER.pack(PCAPNG_ENHANCED_PACKET, blockLength, 0, (nanoseconds >> 32) & 0xffffffff,
+                                                    nanoseconds & 0xffffffff, len(frame), originalLength)
+                     + frame + padding + struct.pack('>I', blockLength))
+
+
+class ChainReader:
+    # Reads files that follow each other in time, one after the other, in a thread of its own. The frames are handed over
+    # in batches through a short queue, so the thread decompresses and decodes ahead of the merge without reading further.
+    def __init__(self, captures, start, stop):
+        self.captures = captures
+        self.start = start
+        self.stop = stop
+        self.batches = queue.Queue(QUEUED_BATCHES)
+        self.thread = threading.Thread(target=self.run)
+        self.thread.daemon = True
+        self.thread.start()
+
+    def run(self):
+        batch = []
+        try:
+            for capture in self.captures:
+                for timestamp, interface, block in readCapture(capture, self.start):
+                    if (self.start != None and timestamp // 1000 < self.start) or (self.stop != None and timestamp // 1000 > self.stop):
+                        continue
+                    batch.append((timestamp, interface, block))
+                    if len(batch) >= BATCH_FRAMES:
+                        self.batches.put(batch)
+                        batch = []
+        except (IOError, OSError, ValueError, struct.error, EOFError) as e:
+            sys.stderr.write('ERROR: Could not read ' + capture.fileName + '. Exception: ' + str(e) + '\n')
+        self.batches.put(batch)
+        self.batches.put(None)
+
+    def frames(self):
+        while True:
+            batch = self.batches.get()
+            if batch == None:
+                return
+            for frame in batch:
+                yield frame
+
+
+def buildChains(captures):
+    # Every file is appended to a chain of which the last file ended before it starts, so that no more files are read at
+    # the same time than overlap in time. Those of the same sniffer are preferred, which keeps them together.
+    chains = []
+    for capture in sorted(captures, key=lambda capture: (capture.first, capture.fileName)):
+        free = [chain for chain in chains if chain[-1].last <= capture.first]
+        if len(free) > 0:
+            sameSniffer = [chain for chain in free if chain[-1].sniffer == capture.sniffer]
+            (sameSniffer if len(sameSniffer) > 0 else free)[0].append(capture)
+        else:
+            chains.append([capture])
+    return chains
+
+
+class MergedOutput:
+    # Writes the frames in the order of their timestamps, with an interface for every interface of every sniffer. With a
+    # window the copies of a frame that other sniffers received on the same channel are merged, as sniffer.py does with
+    # --aggregate --merge-duplicates: the frames of the last window are kept to match the frames behind them.
+    def __init__(self, output, window):
+        self.output = output
+        self.window = window * 1000
+        self.interfaces = {}
+        self.pending = collections.deque()  # [timestamp, block, interface, reception or None, receivers]
+        self.frames = 0
+        self.merged = 0
+        output.write(sniffer.pcapngBlock(PCAPNG_SECTION_HEADER, struct.pack('>IHHq', 0x1A2B3C4D, 1, 0, -1)))
+
+    def interface(self, key):
+        if key not in self.interfaces:
+            options = sniffer.pcapngStringOption(PCAPNG_OPTION_IF_NAME, key[1])
+            options += struct.pack('>HHB3x', PCAPNG_OPTION_IF_TSRESOL, 1, 9) + struct.pack('>HH', 0, 0)
+            self.output.write(sniffer.pcapngBlock(PCAPNG_INTERFACE, struct.pack('>HHI', key[2], 0, 0xffff) + options))
+            self.interfaces[key] = len(self.interfaces)
+        return self.interfaces[key]
+
+    def add(self, timestamp, key, block):
+        interface = self.interface(key)
+        struct.pack_into('>I', block, 8, interface)
+        reception = None
+        if self.window > 0 and key[2] == sniffer.LINKTYPE_IEEE802_15_4_TAP:
+            reception = sniffer.aggregateReception(block)
+            for entry in reversed(self.pending):
+                if timestamp - entry[0] > self.window:
+                    break
+                if entry[3] != None and entry[3][0] == reception[0] and all(receiver[0] != interface for receiver in entry[4]):
+                    entry[4].append((interface, reception[1], reception[2], timestamp // 1000))
+                    self.merged += 1
+                    return
+
+        self.flush(timestamp - self.window)
+        self.pending.append([timestamp, block, interface, reception,
+                             [(interface, reception[1], reception[2], timestamp // 1000)] if reception != None else []])
+
+    def flush(self, before=None):
+        while len(self.pending) > 0 and (before == None or self.pending[0][0] < before):
+            timestamp, block, interface, reception, receivers = self.pending.popleft()
+            self.output.write(sniffer.pcapngAddReceivers(block, receivers) if len(receivers) > 1 else block)
+            self.frames += 1
+
+
+def parseTime(text):
+    # Seconds since 1970 or a local time as YYYY-MM-DDTHH:MM:SS, returned in microseconds like the timestamps
+    try:
+        return int(float(text) * 1000000)
+    except ValueError:
+        pass
+    seconds, dot, fraction = text.partition('.')
+    value = time.mktime(time.strptime(seconds, '%Y-%m-%dT%H:%M:%S'))
+    return int(value * 1000000) + (int((fraction + '000000')[:6]) if dot else 0)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Merge the captures of any number of sniffers, also over weeks, into a single '
+                                                 'pcapng in the order of the timestamps while reading only a few batches of frames '
+                                                 'ahead of every file')
+    parser.add_argument('files', nargs='+', help='pcap or pcapng files written by sniffer.py or collector.py, optionally gzipped')
+    parser.add_argument('-o', '--output', required=True, help='The merged pcapng file')
+    parser.add_argument('--merge-duplicates', type=int, nargs='?', const=sniffer.AGGREGATE_DUPLICATE_WINDOW, default=0,
+                        metavar='MICROSECONDS',
+                        help='Write a frame that several sniffers received on the same channel within MICROSECONDS (default: %d) '
+                             'only once, with the RSSI, LQI and timestamp of every sniffer' % sniffer.AGGREGATE_DUPLICATE_WINDOW)
+    parser.add_argument('--start', help='First time, in seconds since 1970 or as YYYY-MM-DDTHH:MM:SS (local time)')
+    parser.add_argument('--end', help='Last time, in seconds since 1970 or as YYYY-MM-DDTHH:MM:SS (local time)')
+    parser.add_argument('-j', '--jobs', type=int, default=4,
+                        help='Files without an index that are read at the same time to find the time they cover (default: 4)')
+    parser.add_argument('--quiet', action='store_true', help="Don't print how many frames were written and merged")
+    args = parser.parse_args()
+
+    try:
+        start = parseTime(args.start) if args.start != None else None
+        stop = parseTime(args.end) if args.end != None else None
+    except ValueError as e:
+        sys.stderr.write('ERROR: ' + str(e) + '\n')
+        return 2
+    if args.merge_duplicates < 0 or args.jobs < 1:
+        sys.stderr.write('ERROR: The window and the amount of jobs can not be negative\n')
+        return 2
+
+    captures = [Capture(fileName) for fileName in args.files if os.path.abspath(fileName) != os.path.abspath(args.output)]
+
+    # The files without an index are read in parallel, decompressing them doesn't hold up the others
+    unindexed = collections.deque(capture for capture in captures if capture.first == None)
+    failed = []
+    def scanFiles():
+        while True:
+            try:
+                capture = unindexed.popleft()
+            except IndexError:
+                return
+            try:
+                capture.scan()
+            except (IOError, OSError, ValueError, struct.error, EOFError) as e:
+                sys.stderr.write('ERROR: Could not read ' + capture.fileName + '. Exception: ' + str(e) + '\n')
+                failed.append(capture)
+    scanners = [threading.Thread(target=scanFiles) for i in range(min(args.jobs, len(unindexed)))]
+    for scanner in scanners:
+        scanner.start()
+    for scanner in scanners:
+        scanner.join()
+
+    captures = [capture for capture in captures if capture not in failed
+                and (start == None or capture.last >= start) and (stop == None or capture.first <= stop)]
+    chains = buildChains(captures)
+    readers = [ChainReader(chain, start, stop) for chain in chains]
+
+    with open(args.output, 'wb') as output:
+        merged = MergedOutput(output, args.merge_duplicates)
+        frames = [reader.frames() for reader in readers]
+        heap = []
+        for i, stream in enumerate(frames):
+            for timestamp, interface, block in stream:
+                heap.append((timestamp, i, interface, block))
+                break
+        heapq.heapify(heap)
+        while len(heap) > 0:
+            timestamp, i, interface, block = heap[0]
+            merged.add(timestamp, interface, block)
+            for timestamp, interface, block in frames[i]:
+                heapq.heapreplace(heap, (timestamp, i, interface, block))
+                break
+            else:
+                heapq.heappop(heap)
+        merged.flush()
+
+    if not args.quiet:
+        sys.stderr.write('Wrote ' + str(merged.frames) + ' frames from ' + str(len(captures)) + ' files, reading at most '
+                         + str(len(chains)) + ' at the same time')
+        sys.stderr.write((', merged ' + str(merged.merged) + ' copies\n') if args.merge_duplicates > 0 else '\n')
+    return 1 if len(failed) > 0 else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,693 @@
+#!/usr/bin/env python
+
+__author__ = 'Bruno Van de Velde (bruno@texus.me)'
+__license__ = 'GNU General Public License v2'
+
+import os
+import re
+import sys
+import json
+import time
+import struct
+import argparse
+import subprocess
+import threading
+import collections
+
+
+SEQUENCE_MAX    = 50000  # The transmitter counts from 1 to 50000 and then starts again at 1
+PHASE_MARKER    = 0xC0   # Third byte of every packet that is long enough, followed by the phase
+PHASE_NAMES     = ['MinLength', 'MediumLength', 'MaxLength', 'RapidMinMaxChange', 'Increasing', 'Decreasing',
+                   'SmallRandom', 'MediumRandom', 'LargeRandom', 'FullyRandom1', 'FullyRandom2', 'FullyRandom3', 'Profile']
+TX_TIMESTAMP_OFFSET = 3  # Position of the SFD time of the previous packet when the transmitter was build with TX_TIMESTAMPS
+TIMESTAMP_WRAP  = 2**32  # The microseconds of the transmitter and the sniffer wrap around every 71 minutes
+GENERATOR_BAUDRATE = 115200  # Baudrate of the command interface of the transmitter
+TRACE_MAX_ENTRIES = 1000     # Packets that the transmitter can remember from a trace
+TRACE_MAX_DELAY = 100000000  # Longest delay between two packets of a trace, in microseconds
+TDMA_SEQUENCE_MAX = 4000  # Sequence numbers of transmitters that share the channel, the upper 4 bits contain the node ID
+TDMA_BEACON_MARKER = 0xB0  # Third byte of the beacons of the leader, which are 7 bytes long without the FCS
+TDMA_BEACON_LENGTH = 7
+MAC_TRAILER_LENGTH = 3    # With "frames mac" the sequence number and the marker are the last bytes of the payload, before the MIC
+MAC_MIC_LENGTH  = 4       # Length of the MIC behind the payload of the secured MAC frames
+RECENT_SEQUENCE_NUMBERS = 1000  # Sequence numbers that are remembered to tell duplicates from packets that arrive late
+PROFILING_LINE  = re.compile(r'^\s*(radio interrupt|HDLC encode): (\d+) calls, cycles min \d+ max \d+ mean (\d+)')
+RESULTS_STATS_INTERVAL = 10  # Seconds between the STATS messages that the sniffer is asked for when writing results
+INJECTED_LINE   = re.compile(r'^Injected (\d+) of (\d+) frames: (\d+) transmitted')
+REPLAY_DRAIN_TIME = 2  # Seconds that the sniffer keeps running after the replay stopped, for the frames that are still on their way
+SNIFFER_SCRIPT  = os.path.join(os.path.dirname(os.path.dirname(os.path.abspath(__file__))), 'sniffer.py')
+
+
+class PhaseResult:
+    def __init__(self):
+        self.frames = 0
+        self.bytes = 0
+        self.lost = 0
+        self.duplicates = 0
+        self.reordered = 0
+        self.time = 0  # Microseconds between the previous packet and the packets of this result
+        self.latencies = []  # Microseconds between the timestamp of the sniffer and the arrival at the host
+
+    def add(self, other):
+        self.frames += other.frames
+        self.bytes += other.bytes
+        self.lost += other.lost
+        self.duplicates += other.duplicates
+        self.reordered += other.reordered
+        self.time += other.time
+        self.latencies += other.latencies
+
+    def duration(self):
+        return self.time / 1000000.0
+
+
+class SequenceChecker:
+    # Checks every sequence number as soon as the packet arrives. Packets of 2 bytes don't say to which phase they belong,
+    # they are counted for the phase of the packets around them. The packets of 2 bytes between FullyRandom3 and
+    # MediumLength are the MinLength phase.
+    def __init__(self, txTimestamps=False, sequenceMax=SEQUENCE_MAX):
+        self.sequenceMax = sequenceMax
+        self.phases = collections.OrderedDict((name, PhaseResult()) for name in PHASE_NAMES + ['unknown'])
+        self.pending = PhaseResult()  # Packets of which the phase becomes known when the next longer packet arrives
+        self.phase = None
+        self.expected = None
+        self.lastTimestamp = None
+        self.txTimestamps = txTimestamps
+        self.txSamples = []  # Time of the transmitter, timestamp of the sniffer, arrival at the host and phase of a packet
+        self.previous = None
+        self.recent = collections.deque(maxlen=RECENT_SEQUENCE_NUMBERS)
+        self.recentSet = set()
+
+    def packetReceived(self, packet, timestamp, arrival):
+        if len(packet) < 4:
+            return
+
+        result = PhaseResult()
+        result.frames = 1
+        result.bytes = len(packet)
+        if self.lastTimestamp != None and timestamp > self.lastTimestamp:
+            result.time = timestamp - self.lastTimestamp
+        self.lastTimestamp = timestamp
+        result.latencies.append(arrival - timestamp)
+
+        sequenceNumber = (packet[0] << 8) + packet[1]
+        if self.expected == None or sequenceNumber == self.expected:
+            pass
+        elif sequenceNumber in self.recentSet:
+            result.duplicates = 1
+        else:
+            distance = (sequenceNumber - self.expected) % self.sequenceMax
+            if distance < self.sequenceMax // 2:
+                result.lost = distance
+            else:
+                # The packet was counted as lost when a later one arrived before it
+                result.reordered = 1
+                result.lost = -1
+
+        if result.duplicates == 0:
+            if result.reordered == 0:
+                self.expected = sequenceNumber % self.sequenceMax + 1
+            if len(self.recent) == self.recent.maxlen:
+                self.recentSet.discard(self.recent[0])
+            self.recent.append(sequenceNumber)
+            self.recentSet.add(sequenceNumber)
+
+        # The FCS is behind the payload, only longer packets contain the phase
+        phase = None
+        if len(packet) >= 5 and packet[2] >= PHASE_MARKER and packet[2] < PHASE_MARKER + len(PHASE_NAMES):
+            phase = PHASE_NAMES[packet[2] - PHASE_MARKER]
+
+        # The packet contains when the previous packet was send, which only helps when that one was received as well
+        if result.duplicates == 0:
+            if self.txTimestamps and (phase != None) and (len(packet) >= TX_TIMESTAMP_OFFSET + 4 + 2) \
+             and (self.previous != None) and (self.previous[0] % self.sequenceMax + 1 == sequenceNumber):
+                txTime = struct.unpack('>I', bytes(packet[TX_TIMESTAMP_OFFSET:TX_TIMESTAMP_OFFSET + 4]))[0]
+                self.txSamples.append((txTime, self.previous[1], self.previous[2],
+                                       self.previous[3] if self.previous[3] != None else phase))
+            self.previous = (sequenceNumber, timestamp, arrival, phase)
+
+        if phase == None:
+            self.pending.add(result)
+            return
+
+        if self.pending.frames > 0:
+            if self.phase == None or (phase == 'MediumLength' and self.phase != 'MediumLength'):
+                self.phases['MinLength'].add(self.pending)
+            else:
+                self.phases[self.phase].add(self.pending)
+            self.pending = PhaseResult()
+
+        self.phase = phase
+        self.phases[phase].add(result)
+
+    def finish(self):
+        if self.pending.frames > 0:
+            self.phases[self.phase if self.phase != None else 'unknown'].add(self.pending)
+            self.pending = PhaseResult()
+
+    def transmitterLatencies(self):
+        # The clock of the transmitter is matched to the timestamps of the sniffer with a least squares fit, which
+        # leaves the latency independent of the jitter on each timestamp. The largest difference with the fit is returned as well.
+        if len(self.txSamples) < 2:
+            return {}, 0
+
+        txTimes = []
+        offset = 0
+        for i in range(len(self.txSamples)):
+            if i > 0 and self.txSamples[i][0] + TIMESTAMP_WRAP // 2 < self.txSamples[i-1][0]:
+                offset += TIMESTAMP_WRAP
+            txTimes.append(self.txSamples[i][0] + offset - self.txSamples[0][0])
+
+        timestamps = [sample[1] - self.txSamples[0][1] for sample in self.txSamples]
+        count = float(len(txTimes))
+        meanX = sum(txTimes) / count
+        meanY = sum(timestamps) / count
+        varianceX = sum((x - meanX) ** 2 for x in txTimes)
+        if varianceX == 0:
+            return {}, 0
+
+        slope = sum((x - meanX) * (y - meanY) for x, y in zip(txTimes, timestamps)) / varianceX
+        latencies = {}
+        maxError = 0
+        for x, y, sample in zip(txTimes, timestamps, self.txSamples):
+            airTime = meanY + slope * (x - meanX)
+            maxError = max(maxError, abs(y - airTime))
+            latencies.setdefault(sample[3], []).append(sample[2] - self.txSamples[0][1] - airTime)
+
+        return latencies, maxError
+
+
+class NodeChecker:
+    # Splits the packets of transmitters that share the channel over a SequenceChecker per node, so that every loss is
+    # attributed to the transmitter that send the packet. The beacons of the leader are only counted.
+    def __init__(self, nodes, txTimestamps=False):
+        self.nodes = [SequenceChecker(txTimestamps, TDMA_SEQUENCE_MAX) for node in range(nodes)]
+        self.txTimestamps = txTimestamps
+        self.beacons = 0
+        self.strangers = 0  # Packets with a node ID for which there is no transmitter
+
+    def packetReceived(self, packet, timestamp, arrival):
+        if len(packet) == TDMA_BEACON_LENGTH + 2 and packet[2] == TDMA_BEACON_MARKER:
+            self.beacons += 1
+            return
+        if len(packet) < 4:
+            return
+
+        node = packet[0] >> 4
+        if node >= len(self.nodes):
+            self.strangers += 1
+            return
+
+        packet[0] &= 0x0F
+        self.nodes[node].packetReceived(packet, timestamp, arrival)
+
+    def finish(self):
+        for checker in self.nodes:
+            checker.finish()
+
+    @property
+    def phases(self):
+        # The nodes send at the same time, so a phase lasts as long as it did for the node that send it the longest
+        phases = collections.OrderedDict((name, PhaseResult()) for name in PHASE_NAMES + ['unknown'])
+        for checker in self.nodes:
+            for name, result in checker.phases.items():
+                time = max(phases[name].time, result.time)
+                phases[name].add(result)
+                phases[name].time = time
+        return phases
+
+    @property
+    def pending(self):
+        pending = PhaseResult()
+        for checker in self.nodes:
+            pending.add(checker.pending)
+        return pending
+
+    def transmitterLatencies(self):
+        # Every transmitter has its own clock, which is matched separately
+        latencies = {}
+        maxError = 0
+        for checker in self.nodes:
+            nodeLatencies, nodeError = checker.transmitterLatencies()
+            for name, values in nodeLatencies.items():
+                latencies.setdefault(name, []).extend(values)
+            maxError = max(maxError, nodeError)
+        return latencies, maxError
+
+
+class ReplayChecker:
+    # Recognizes the frames that another OpenMote replays from a capture by their contents, as they don't have sequence numbers.
+    # The frames that were transmitted but never received are lost, frames that arrived more often than they were in the file
+    # (times the repetitions) are duplicates.
+    def __init__(self, frames, repeat):
+        self.expected = collections.Counter(bytes(frame) for delay, frame in frames)
+        self.repeat = repeat
+        self.received = collections.Counter()
+        self.phases = collections.OrderedDict((name, PhaseResult()) for name in ['Replay', 'unknown'])
+        self.pending = PhaseResult()
+        self.txTimestamps = False
+        self.lastTimestamp = None
+
+    def packetReceived(self, packet, timestamp, arrival):
+        # The capture contains the FCS, which the transmitting radio added
+        frame = bytes(packet[:-2])
+        result = PhaseResult()
+        result.frames = 1
+        result.bytes = len(packet)
+        if self.lastTimestamp != None and timestamp > self.lastTimestamp:
+            result.time = timestamp - self.lastTimestamp
+        self.lastTimestamp = timestamp
+        result.latencies.append(arrival - timestamp)
+
+        count = self.expected.get(frame, 0) * self.repeat
+        if count == 0:
+            self.phases['unknown'].add(result)
+            return
+
+        self.received[frame] += 1
+        if self.received[frame] > count:
+            result.duplicates = 1
+        self.phases['Replay'].add(result)
+
+    def finish(self, transmitted=None):
+        # Only the transmitter knows how many frames went on the air, the CCA or stopping early may have skipped some
+        if transmitted != None:
+            result = self.phases['Replay']
+            result.lost = max(transmitted - (result.frames - result.duplicates), 0)
+
+
+def percentile(values, fraction):
+    return values[int(round(fraction * (len(values) - 1)))]
+
+
+def printLatencies(title, latencies):
+    print('')
+    print('%-18s %9s %10s %10s %10s' % (title, 'Samples', 'p50 (us)', 'p99 (us)', 'max (us)'))
+    for name in PHASE_NAMES + ['unknown', 'Total']:
+        values = latencies.get(name, [])
+        if len(values) == 0:
+            continue
+        values = sorted(values)
+        print('%-18s %9d %10.0f %10.0f %10.0f' % (name, len(values), percentile(values, 0.5), percentile(values, 0.99), values[-1]))
+
+
+def readTraceCommands(fileName):
+    # The lengths and the time between the packets of a pcap file, in the commands of the transmitter
+    with open(fileName, 'rb') as traceFile:
+        header = traceFile.read(24)
+        if len(header) < 24:
+            return None
+
+        magic = struct.unpack('<I', header[0:4])[0]
+        if magic in (0xa1b2c3d4, 0xa1b23c4d):
+            endianness = '<'
+        elif magic in (0xd4c3b2a1, 0x4d3cb2a1):
+            endianness = '>'
+            magic = struct.unpack('>I', header[0:4])[0]
+        else:
+            return None
+
+        # Captures from the sniffer (LINKTYPE_IEEE802_15_4_WITHFCS) contain the FCS, which the radio adds itself
+        divider = 1000 if magic == 0xa1b23c4d else 1
+        linkType = struct.unpack(endianness + 'I', header[20:24])[0]
+        fcsLength = 2 if linkType == 195 else 0
+
+        commands = []
+        previousTimestamp = None
+        while len(commands) < TRACE_MAX_ENTRIES:
+            recordHeader = traceFile.read(16)
+            if len(recordHeader) < 16:
+                break
+
+            seconds, fraction, savedLength, originalLength = struct.unpack(endianness + 'IIII', recordHeader)
+            traceFile.read(savedLength)
+
+            timestamp = seconds * 1000000 + fraction // divider
+            delay = 0 if previousTimestamp == None else min(max(timestamp - previousTimestamp, 0), TRACE_MAX_DELAY)
+            previousTimestamp = timestamp
+            commands.append('trace %d %d' % (min(max(originalLength - fcsLength, 2), 125), delay))
+
+        return commands
+
+
+def configureGenerator(port, commands):
+    import serial
+
+    generator = serial.Serial(port=port, baudrate=GENERATOR_BAUDRATE, timeout=2)
+    generator.reset_input_buffer()
+    for command in commands:
+        generator.write((command + '\n').encode())
+        reply = generator.readline().strip()
+        if reply != b'OK':
+            print('ERROR: The transmitter did not accept "' + command + '"')
+            generator.close()
+            return False
+
+    generator.close()
+    return True
+
+
+def readExactly(stream, length):
+    data = b''
+    while len(data) < length:
+        part = stream.read(length - len(data))
+        if len(part) == 0:
+            return None
+        data += part
+    return data
+
+
+def macToRawPacket(packet):
+    # Move the trailer of a MAC frame to the front, where the checkers expect the sequence number. ACKs don't carry one and
+    # are left out, the beacons of the TDMA leader aren't MAC frames and stay as they are.
+    if packet[0] & 0x07 > 3:
+        return packet
+    if packet[0] & 0x07 == 2:
+        return None
+
+    end = len(packet) - 2 - (MAC_MIC_LENGTH if packet[0] & 0x08 else 0)
+    if end < MAC_TRAILER_LENGTH:
+        return None
+    return packet[end - MAC_TRAILER_LENGTH:end] + packet[:end - MAC_TRAILER_LENGTH] + packet[end:]
+
+
+def readCapture(stream, checker, lock, macFrames=False):
+    # The sniffer writes a pcap file to its stdout, with the FCS behind every packet
+    if readExactly(stream, 24) == None:
+        return
+
+    while True:
+        header = readExactly(stream, 16)
+        if header == None:
+            return
+
+        seconds, microseconds, savedLength, originalLength = struct.unpack('>IIII', header)
+        packet = readExactly(stream, savedLength)
+        if packet == None:
+            return
+
+        arrival = int(time.time() * 1000000)
+        packet = bytearray(packet)
+        if macFrames:
+            packet = macToRawPacket(packet)
+            if packet == None:
+                continue
+
+        with lock:
+            checker.packetReceived(packet, seconds * 1000000 + microseconds, arrival)
+
+
+def readMessages(stream, profiling, lock):
+    # Everything that the sniffer prints is shown as usual, the cycle measurements of a PROFILING build are remembered.
+    # They are counted from the start of the capture, so the last report covers the whole measurement.
+    for line in iter(stream.readline, b''):
+        line = line.decode('utf-8', 'replace')
+        sys.stderr.write(line)
+        match = PROFILING_LINE.match(line)
+        if match != None:
+            with lock:
+                profiling[match.group(1)] = (int(match.group(2)), int(match.group(3)))
+
+
+def readInjectorMessages(stream, injected, lock):
+    # The sniffer that replays the capture prints how many frames it transmitted when it stops
+    for line in iter(stream.readline, b''):
+        line = line.decode('utf-8', 'replace')
+        sys.stderr.write('replay: ' + line)
+        match = INJECTED_LINE.match(line)
+        if match != None:
+            with lock:
+                injected['transmitted'] = int(match.group(3))
+
+
+def firmwareVersion():
+    # The firmware doesn't know from which commit it was build, the checkout next to this script is assumed
+    try:
+        output = subprocess.check_output(['git', 'describe', '--always', '--dirty'], stderr=subprocess.STDOUT,
+                                         cwd=os.path.dirname(os.path.abspath(__file__)))
+        return output.decode().strip()
+    except (OSError, subprocess.CalledProcessError):
+        return 'unknown'
+
+
+def writeResults(fileName, checker, total, elapsed, profiling, run):
+    # One JSON object per line for every phase and the total, appended to the results of earlier runs
+    def latency(values, fraction):
+        return percentile(sorted(values), fraction) if len(values) > 0 else None
+
+    # The radio interrupt and the HDLC encoding both run once for every frame
+    cyclesPerFrame = None
+    if 'radio interrupt' in profiling and 'HDLC encode' in profiling:
+        cyclesPerFrame = sum(mean for calls, mean in profiling.values())
+
+    records = []
+    for name, result in list(checker.phases.items()) + [('Total', total)]:
+        if result.frames == 0 and result.lost == 0:
+            continue
+        duration = elapsed if name == 'Total' else result.duration()
+        record = dict(run)
+        record.update({
+            'phase': name,
+            'frames': result.frames,
+            'framesPerSecond': round(result.frames / duration, 1) if duration > 0 else 0,
+            'bytesPerSecond': round(result.bytes / duration, 1) if duration > 0 else 0,
+            'lost': result.lost,
+            'duplicates': result.duplicates,
+            'reordered': result.reordered,
+            'lossRatio': float(result.lost) / (result.frames + result.lost) if result.frames + result.lost > 0 else 0,
+            'latencyP50': latency(result.latencies, 0.5),
+            'latencyP99': latency(result.latencies, 0.99),
+            'cyclesPerFrame': cyclesPerFrame if name == 'Total' else None
+        })
+        records.append(record)
+
+    with open(fileName, 'a') as resultsFile:
+        for record in records:
+            resultsFile.write(json.dumps(record, sort_keys=True) + '\n')
+
+
+def printReport(checker, elapsed):
+    total = PhaseResult()
+    print('')
+    print('%-18s %9s %7s %6s %9s %10s %12s' % ('Phase', 'Frames', 'Lost', 'Dups', 'Reorders', 'Frames/s', 'Bytes/s'))
+    for name, result in checker.phases.items():
+        if result.frames == 0 and result.lost == 0:
+            continue
+        duration = result.duration()
+        print('%-18s %9d %7d %6d %9d %10.0f %12.0f' % (name, result.frames, result.lost, result.duplicates, result.reordered,
+                                                       result.frames / duration if duration > 0 else 0,
+                                                       result.bytes / duration if duration > 0 else 0))
+        total.add(result)
+
+    print('%-18s %9d %7d %6d %9d %10.0f %12.0f' % ('Total', total.frames, total.lost, total.duplicates, total.reordered,
+                                                   total.frames / elapsed if elapsed > 0 else 0,
+                                                   total.bytes / elapsed if elapsed > 0 else 0))
+
+    if isinstance(checker, NodeChecker):
+        print('')
+        print('%-18s %9s %7s %6s %9s %10s %12s' % ('Node', 'Frames', 'Lost', 'Dups', 'Reorders', 'Frames/s', 'Bytes/s'))
+        for node, nodeChecker in enumerate(checker.nodes):
+            result = PhaseResult()
+            for phaseResult in nodeChecker.phases.values():
+                result.add(phaseResult)
+            print('%-18s %9d %7d %6d %9d %10.0f %12.0f' % (node, result.frames, result.lost, result.duplicates, result.reordered,
+                                                           result.frames / elapsed if elapsed > 0 else 0,
+                                                           result.bytes / elapsed if elapsed > 0 else 0))
+        print('Beacons: %d, packets of unknown nodes: %d' % (checker.beacons, checker.strangers))
+
+    latencies = dict((name, result.latencies) for name, result in checker.phases.items())
+    latencies['Total'] = total.latencies
+    printLatencies('Sniffer to host', latencies)
+
+    if checker.txTimestamps:
+        latencies, maxError = checker.transmitterLatencies()
+        latencies['Total'] = sum(latencies.values(), [])
+        printLatencies('Air to host', latencies)
+        print('Largest difference between the sniffer timestamps and the transmitter clock: %.0f us' % maxError)
+
+    return total
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Check that the sniffer receives every packet from the performance-test transmitter')
+    parser.add_argument('-p', '--port', required=True, help='Serial port of the OpenMote that runs the sniffer')
+    parser.add_argument('-c', '--channel', type=int, default=26, help='Channel of the transmitter (26 unless main.cpp was changed)')
+    parser.add_argument('-d', '--duration', type=float, default=480,
+                        help='Seconds to measure, all phases of the transmitter take a little over 7.5 minutes')
+    parser.add_argument('--min-rate', type=float, default=0,
+                        help='Fail when less frames per second than this are received')
+    parser.add_argument('--tx-timestamps', action='store_true',
+                        help='The transmitter was build with TX_TIMESTAMPS, also measure the latency from the moment it send the packet')
+    parser.add_argument('--generator', action='append',
+                        help='Serial port of the transmitter, to send it the profile before measuring. Pass it once for every '
+                             'transmitter when several of them share the channel with --tdma-slot, the first one is the leader.')
+    parser.add_argument('--tdma-slot', type=int,
+                        help='Let the generators share the channel, each getting a slot of this many microseconds in turn '
+                             '(the transmitters have to be build with SCHEDULED_TX)')
+    parser.add_argument('--profile', default='',
+                        help='Commands for the transmitter separated by ";", e.g. "mode random 10 50; rate 500; channel 26"')
+    parser.add_argument('--trace',
+                        help='Let the transmitter replay the lengths and timing of the first packets in this pcap file')
+    parser.add_argument('--mac-frames', action='store_true',
+                        help='Let the transmitter send valid IEEE 802.15.4 frames ("frames mac"), configure them with the '
+                             '"mac" commands in --profile')
+    parser.add_argument('--replay',
+                        help='Let the OpenMote on --replay-port transmit the frames of this capture with their original timing, '
+                             'instead of measuring the packets of the performance-test transmitter')
+    parser.add_argument('--replay-port',
+                        help='Serial port of a second OpenMote with the sniffer firmware, which replays the capture')
+    parser.add_argument('--replay-repeat', type=int, default=1,
+                        help='Replay the capture this many times after each other (default: 1)')
+    parser.add_argument('--results',
+                        help='Append the results of every phase to this file as JSON lines, for compare-results.py')
+    parser.add_argument('--firmware', default=None,
+                        help='Version of the sniffer firmware in the results (default: git describe of this checkout)')
+    parser.add_argument('--build', default='default',
+                        help='Name of the build profile of the sniffer in the results, e.g. "release" or "hardware-crc"')
+    parser.add_argument('sniffer_arguments', nargs=argparse.REMAINDER,
+                        help='Other arguments for sniffer.py, after --')
+    args = parser.parse_args()
+
+    snifferArguments = args.sniffer_arguments
+    if len(snifferArguments) > 0 and snifferArguments[0] == '--':
+        snifferArguments = snifferArguments[1:]
+
+    if args.tdma_slot != None and (args.generator == None or len(args.generator) > 16):
+        print('ERROR: The --tdma-slot option requires between 1 and 16 times --generator')
+        sys.exit(1)
+
+    if args.mac_frames and args.generator == None:
+        print('ERROR: The --mac-frames option requires --generator')
+        sys.exit(1)
+
+    if args.generator != None:
+        commands = ['reset', 'stop'] + (['frames mac'] if args.mac_frames else [])
+        if args.trace != None:
+            traceCommands = readTraceCommands(args.trace)
+            if traceCommands == None or len(traceCommands) == 0:
+                print('ERROR: No packets could be read from the trace')
+                sys.exit(1)
+
+            commands += ['trace clear'] + traceCommands + ['mode trace']
+
+        commands += [command.strip() for command in args.profile.split(';') if command.strip() != '']
+        commands += ['channel ' + str(args.channel)]
+        if args.tdma_slot == None and len(args.generator) > 1:
+            print('ERROR: Several transmitters can only share the channel with --tdma-slot')
+            sys.exit(1)
+
+        # The leader is started last, so that the followers already listen to its first beacon
+        for node in reversed(range(len(args.generator))):
+            nodeCommands = commands[:]
+            if args.tdma_slot != None:
+                nodeCommands.append('tdma %d %d %d' % (node, len(args.generator), args.tdma_slot))
+            if not configureGenerator(args.generator[node], nodeCommands + ['start']):
+                sys.exit(1)
+    elif args.profile != '' or args.trace != None:
+        print('ERROR: The --profile and --trace options require --generator')
+        sys.exit(1)
+
+    replayFrames = None
+    if args.replay != None:
+        if args.replay_port == None or args.generator != None or args.replay_repeat < 1:
+            print('ERROR: The --replay option requires --replay-port, a positive --replay-repeat and no --generator')
+            sys.exit(1)
+
+        sys.path.insert(0, os.path.dirname(SNIFFER_SCRIPT))
+        import sniffer as snifferModule
+        try:
+            replayFrames = snifferModule.readInjectFrames(args.replay, False)
+        except (IOError, OSError, ValueError, struct.error) as e:
+            print('ERROR: Could not read the capture to replay: ' + str(e))
+            sys.exit(1)
+        if len(replayFrames) == 0:
+            print('ERROR: The capture to replay contains no frames')
+            sys.exit(1)
+    elif args.replay_port != None:
+        print('ERROR: The --replay-port option requires --replay')
+        sys.exit(1)
+
+    # The cycle measurements of a PROFILING build arrive in the STATS messages
+    if args.results != None and '--stats' not in snifferArguments:
+        snifferArguments = snifferArguments + ['--stats', str(RESULTS_STATS_INTERVAL)]
+
+    run = {'run': time.strftime('%Y-%m-%dT%H:%M:%S'), 'firmware': args.firmware if args.firmware != None else firmwareVersion(),
+           'build': args.build, 'profile': args.profile if args.replay == None else 'replay ' + os.path.basename(args.replay),
+           'nodes': len(args.generator) if args.tdma_slot != None else 1}
+
+    sniffer = subprocess.Popen([sys.executable, SNIFFER_SCRIPT, '-o', '-', '-p', args.port, '-c', str(args.channel)] + snifferArguments,
+                               stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+
+    if replayFrames != None:
+        checker = ReplayChecker(replayFrames, args.replay_repeat)
+    elif args.tdma_slot != None:
+        checker = NodeChecker(len(args.generator), args.tx_timestamps)
+    else:
+        checker = SequenceChecker(args.tx_timestamps)
+    lock = threading.Lock()
+    reader = threading.Thread(target=readCapture, args=[sniffer.stdout, checker, lock, args.mac_frames])
+    reader.daemon = True
+    reader.start()
+
+    profiling = {}
+    messages = threading.Thread(target=readMessages, args=[sniffer.stderr, profiling, lock])
+    messages.daemon = True
+    messages.start()
+
+    # The replay keeps the timeline of the capture, a frame that had to wait doesn't delay the ones behind it
+    injector = None
+    injected = {}
+    if replayFrames != None:
+        injector = subprocess.Popen([sys.executable, SNIFFER_SCRIPT, '-o', os.devnull, '-p', args.replay_port, '-c', str(args.channel),
+                                     '--inject', args.replay, '--inject-timeline', '--inject-repeat', str(args.replay_repeat)],
+                                    stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+        injectorMessages = threading.Thread(target=readInjectorMessages, args=[injector.stdout, injected, lock])
+        injectorMessages.daemon = True
+        injectorMessages.start()
+
+    begin = time.time()
+    try:
+        while time.time() - begin < args.duration and sniffer.poll() == None:
+            time.sleep(10)
+            with lock:
+                print('%4.0f s: %d frames, %d lost' % (time.time() - begin, sum(result.frames for result in checker.phases.values())
+                                                       + checker.pending.frames,
+                                                       sum(result.lost for result in checker.phases.values()) + checker.pending.lost))
+    except KeyboardInterrupt:
+        pass
+
+    # Closing stdin pauses the sniffer, which then quits as no channel can be chosen
+    elapsed = time.time() - begin
+    if injector != None:
+        try:
+            injector.stdin.close()
+        except (IOError, OSError):
+            pass
+        injector.wait()
+        injectorMessages.join(5)
+        time.sleep(REPLAY_DRAIN_TIME)
+    try:
+        sniffer.stdin.close()
+    except (IOError, OSError):
+        pass
+    sniffer.wait()
+    reader.join(5)
+    messages.join(5)
+
+    with lock:
+        if injector != None:
+            checker.finish(injected.get('transmitted'))
+        else:
+            checker.finish()
+        total = printReport(checker, elapsed)
+        if args.results != None:
+            writeResults(args.results, checker, total, elapsed, profiling, run)
+
+    rate = total.frames / elapsed if elapsed > 0 else 0
+    passed = total.frames > 0 and total.lost == 0 and total.duplicates == 0 and total.reordered == 0 and rate >= args.min_rate
+    print('')
+    print('PASS' if passed else 'FAIL')
+    sys.exit(0 if passed else 1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,222 @@
+#!/usr/bin/env python
+
+__author__ = 'Bruno Van de Velde (bruno@texus.me)'
+__license__ = 'GNU General Public License v2'
+
+import sys
+import json
+import time
+import argparse
+import subprocess
+import threading
+
+import benchmark
+
+
+TX_TURNAROUND_TIME = 192  # Microseconds between two packets of the transmitter when it sends them back-to-back
+TX_BYTE_TIME       = 32   # Microseconds to send a single byte
+TX_OVERHEAD_BYTES  = 8    # Preamble, SFD, length byte and FCS
+DRAIN_RATE         = 20   # Packets per second between the trials, which reveal the packets that got lost at the end of a trial
+CONNECT_TIMEOUT    = 30   # Seconds to wait for the first packet, while the sniffer connects to the OpenMote
+
+
+def airLimit(length):
+    # The highest rate at which the transmitter can send packets of this length
+    return 1000000 // (TX_TURNAROUND_TIME + (length + TX_OVERHEAD_BYTES) * TX_BYTE_TIME)
+
+
+def parseLengths(text):
+    lengths = []
+    for part in text.split(','):
+        if '-' in part:
+            first, last = part.split('-', 1)
+            lengths.extend(range(int(first), int(last) + 1))
+        else:
+            lengths.append(int(part))
+
+    for length in lengths:
+        if length < 2 or length > 125:
+            raise ValueError('Length ' + str(length) + ' is not between 2 and 125, the packets need room for their sequence number')
+    return lengths
+
+
+class Counters:
+    # Totals of the checker, of which the difference between two moments gives the result of a trial
+    def __init__(self, checker):
+        results = list(checker.phases.values()) + [checker.pending]
+        self.frames = sum(result.frames for result in results)
+        self.lost = sum(result.lost for result in results)
+        self.duplicates = sum(result.duplicates for result in results)
+        self.reordered = sum(result.reordered for result in results)
+
+
+class Sweep:
+    def __init__(self, args, checker, lock, sniffer):
+        self.args = args
+        self.checker = checker
+        self.lock = lock
+        self.sniffer = sniffer
+
+    def counters(self):
+        with self.lock:
+            return Counters(self.checker)
+
+    def trial(self, length, rate):
+        # Only the packets during the trial are counted. The slow packets behind it give the sniffer the time to catch up,
+        # and a packet that got lost at the end of the trial is only noticed once the next one arrives.
+        if not benchmark.configureGenerator(self.args.generator, ['stop', 'mode fixed ' + str(length), 'rate ' + str(rate), 'start']):
+            return None
+
+        before = self.counters()
+        time.sleep(self.args.trial)
+        measured = self.counters()
+        if not benchmark.configureGenerator(self.args.generator, ['rate ' + str(DRAIN_RATE)]):
+            return None
+
+        time.sleep(self.args.drain)
+        after = self.counters()
+        framesPerSecond = (measured.frames - before.frames) / float(self.args.trial)
+        lossFree = (after.lost == before.lost) and (after.duplicates == before.duplicates) and (after.reordered == before.reordered) \
+                   and (measured.frames > before.frames)
+        print('  %3d bytes at %5d frames/s: %7.0f frames/s received, %s'
+              % (length, rate, framesPerSecond, 'no loss' if lossFree else str(after.lost - before.lost) + ' lost'))
+        return lossFree, framesPerSecond
+
+    def capacity(self, length):
+        # The highest offered rate without any loss, found with a binary search between 0 and what fits on the air
+        highest = airLimit(length)
+        result = self.trial(length, highest)
+        if result == None:
+            return None
+        if result[0]:
+            return highest, result[1], True
+
+        low = 0
+        lowResult = 0.0
+        high = highest
+        while high - low > max(self.args.precision * high / 100.0, 1):
+            if self.sniffer.poll() != None:
+                return None
+
+            rate = (low + high) // 2
+            result = self.trial(length, rate)
+            if result == None:
+                return None
+            if result[0]:
+                low = rate
+                lowResult = result[1]
+            else:
+                high = rate
+
+        return low, lowResult, False
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Find the highest frame rate that the sniffer receives without loss for every '
+                                                 'packet length, with the performance-test transmitter')
+    parser.add_argument('-p', '--port', required=True, help='Serial port of the OpenMote that runs the sniffer')
+    parser.add_argument('-g', '--generator', required=True, help='Serial port of the transmitter')
+    parser.add_argument('-c', '--channel', type=int, default=26, help='Channel to send and capture on (default: 26)')
+    parser.add_argument('--lengths', default='2-125',
+                        help='Packet lengths without the FCS to measure, e.g. "2-125" or "10,50,125" (default: 2-125)')
+    parser.add_argument('--trial', type=float, default=3,
+                        help='Seconds that every rate is offered (default: 3)')
+    parser.add_argument('--drain', type=float, default=2,
+                        help='Seconds between the trials, in which the sniffer catches up (default: 2)')
+    parser.add_argument('--precision', type=float, default=2,
+                        help='Stop searching once the rate is known within this percentage (default: 2)')
+    parser.add_argument('--results',
+                        help='Append the capacity of every length to this file as JSON lines')
+    parser.add_argument('--firmware', default=None,
+                        help='Version of the sniffer firmware in the results (default: git describe of this checkout)')
+    parser.add_argument('--build', default='default',
+                        help='Name of the build profile of the sniffer in the results, e.g. "release" or "hardware-crc"')
+    parser.add_argument('sniffer_arguments', nargs=argparse.REMAINDER,
+                        help='Other arguments for sniffer.py, after --')
+    args = parser.parse_args()
+
+    try:
+        lengths = parseLengths(args.lengths)
+    except ValueError as e:
+        print('ERROR: ' + str(e))
+        sys.exit(1)
+
+    snifferArguments = args.sniffer_arguments
+    if len(snifferArguments) > 0 and snifferArguments[0] == '--':
+        snifferArguments = snifferArguments[1:]
+
+    # The transmitter stays quiet until the first trial, its sequence numbers continue over all trials
+    if not benchmark.configureGenerator(args.generator, ['reset', 'stop', 'channel ' + str(args.channel)]):
+        sys.exit(1)
+
+    run = {'run': time.strftime('%Y-%m-%dT%H:%M:%S'), 'firmware': args.firmware if args.firmware != None else benchmark.firmwareVersion(),
+           'build': args.build}
+
+    sniffer = subprocess.Popen([sys.executable, benchmark.SNIFFER_SCRIPT, '-o', '-', '-p', args.port, '-c', str(args.channel)]
+                               + snifferArguments, stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+
+    checker = benchmark.SequenceChecker()
+    lock = threading.Lock()
+    reader = threading.Thread(target=benchmark.readCapture, args=[sniffer.stdout, checker, lock])
+    reader.daemon = True
+    reader.start()
+    messages = threading.Thread(target=benchmark.readMessages, args=[sniffer.stderr, {}, lock])
+    messages.daemon = True
+    messages.start()
+
+    sweep = Sweep(args, checker, lock, sniffer)
+    curve = []
+    connected = False
+    try:
+        # The trials only start once the sniffer is capturing, which takes a few seconds after starting it
+        connected = benchmark.configureGenerator(args.generator, ['mode fixed ' + str(lengths[0]), 'rate ' + str(DRAIN_RATE), 'start'])
+        begin = time.time()
+        while connected and sweep.counters().frames == 0:
+            if sniffer.poll() != None or time.time() - begin > CONNECT_TIMEOUT:
+                print('ERROR: The sniffer did not receive any packet from the transmitter')
+                connected = False
+            time.sleep(0.5)
+
+        for length in (lengths if connected else []):
+            if sniffer.poll() != None:
+                print('ERROR: The sniffer stopped')
+                break
+
+            result = sweep.capacity(length)
+            if result == None:
+                break
+
+            rate, received, atAirLimit = result
+            curve.append((length, rate, received, atAirLimit))
+            print('%3d bytes: %d frames/s, %.1f kbit/s%s' % (length, rate, rate * length * 8 / 1000.0,
+                                                             ' (the most that fits on the air)' if atAirLimit else ''))
+    except KeyboardInterrupt:
+        pass
+
+    benchmark.configureGenerator(args.generator, ['stop'])
+    try:
+        sniffer.stdin.close()
+    except (IOError, OSError):
+        pass
+    sniffer.wait()
+    reader.join(5)
+    messages.join(5)
+
+    print('')
+    print('%7s %10s %14s %10s' % ('Length', 'Frames/s', 'Payload kbit/s', 'Air limit'))
+    for length, rate, received, atAirLimit in curve:
+        print('%7d %10d %14.1f %10s' % (length, rate, rate * length * 8 / 1000.0, 'yes' if atAirLimit else 'no'))
+
+    if args.results != None and len(curve) > 0:
+        with open(args.results, 'a') as resultsFile:
+            for length, rate, received, atAirLimit in curve:
+                record = dict(run)
+                record.update({'length': length, 'framesPerSecond': rate, 'receivedPerSecond': round(received, 1),
+                               'payloadKbps': round(rate * length * 8 / 1000.0, 1), 'airLimit': atAirLimit})
+                resultsFile.write(json.dumps(record, sort_keys=True) + '\n')
+
+    sys.exit(0 if connected and len(curve) == len(lengths) else 1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,88 @@
+#!/usr/bin/env python
+
+__author__ = 'Bruno Van de Velde (bruno@texus.me)'
+__license__ = 'GNU General Public License v2'
+
+import sys
+import json
+import argparse
+import collections
+
+
+def loadLatestRun(fileName):
+    # The results of benchmark.py are appended, only the last run in the file is compared
+    runs = collections.OrderedDict()
+    with open(fileName, 'r') as resultsFile:
+        for line in resultsFile:
+            line = line.strip()
+            if line == '':
+                continue
+            record = json.loads(line)
+            runs.setdefault((record['run'], record['firmware'], record['build']), []).append(record)
+
+    if len(runs) == 0:
+        return None, {}
+
+    key, records = list(runs.items())[-1]
+    return key, dict((record['phase'], record) for record in records)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Compare the last run in two result files that benchmark.py wrote with --results '
+                                                 'and report the phases that became slower')
+    parser.add_argument('baseline', help='Results of the firmware to compare against')
+    parser.add_argument('results', help='Results of the new firmware')
+    parser.add_argument('-t', '--threshold', type=float, default=5,
+                        help='Percentage by which the frames per second may drop, or the cycles per frame may rise (default: 5)')
+    args = parser.parse_args()
+
+    try:
+        baselineRun, baseline = loadLatestRun(args.baseline)
+        newRun, results = loadLatestRun(args.results)
+    except (IOError, OSError, ValueError, KeyError) as e:
+        print('ERROR: Could not read the results. Exception: ' + str(e))
+        sys.exit(2)
+
+    if baselineRun == None or newRun == None:
+        print('ERROR: A result file contains no runs')
+        sys.exit(2)
+
+    print('Baseline: ' + baselineRun[1] + ' (' + baselineRun[2] + ') from ' + baselineRun[0])
+    print('Results:  ' + newRun[1] + ' (' + newRun[2] + ') from ' + newRun[0])
+    print('')
+    print('%-18s %12s %12s %8s %8s %8s' % ('Phase', 'Baseline/s', 'Frames/s', 'Change', 'Lost', 'p99 (us)'))
+
+    regressions = 0
+    for phase in baseline:
+        if phase not in results:
+            continue
+
+        old = baseline[phase]
+        new = results[phase]
+        change = (new['framesPerSecond'] - old['framesPerSecond']) * 100.0 / old['framesPerSecond'] if old['framesPerSecond'] > 0 else 0
+        flags = []
+        if change < -args.threshold:
+            flags.append('SLOWER')
+        if new['lost'] > 0 and old['lost'] == 0:
+            flags.append('LOSING FRAMES')
+        if old.get('cyclesPerFrame') != None and new.get('cyclesPerFrame') != None \
+         and new['cyclesPerFrame'] > old['cyclesPerFrame'] * (1 + args.threshold / 100.0):
+            flags.append('CYCLES ' + str(old['cyclesPerFrame']) + ' -> ' + str(new['cyclesPerFrame']))
+
+        latency = '%.0f' % new['latencyP99'] if new.get('latencyP99') != None else '-'
+        print('%-18s %12.0f %12.0f %7.1f%% %8d %8s  %s' % (phase, old['framesPerSecond'], new['framesPerSecond'], change,
+                                                            new['lost'], latency, ', '.join(flags)))
+        if len(flags) > 0:
+            regressions += 1
+
+    print('')
+    if regressions > 0:
+        print('REGRESSION in ' + str(regressions) + ' phase' + ('s' if regressions > 1 else ''))
+        sys.exit(1)
+
+    print('No regressions above ' + str(args.threshold) + '%')
+    sys.exit(0)
+
+
+if __name__ == '__main__':
+    main()
@@ -8,6 +8,8 @@
 /*
 #define MAX_PERFORMANCE
 #define FIXED_PACKET_SIZE   125
+#define TX_TIMESTAMPS
+#define SCHEDULED_TX
 */
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -17,6 +19,42 @@
 #define CC2538_RF_CSP_OP_ISTXON     0xE9
 #define CC2538_RF_CSP_OP_ISRXON     0xE3
 #define CC2538_RF_CSP_OP_ISRFOFF    0xEF
+#define CC2538_RF_CSP_OP_ISFLUSHTX  0xEE
+#define CC2538_RF_CSP_OP_ISFLUSHRX  0xED
+
+#define PHASE_MARKER                0xC0    // The third byte of the packet is PHASE_MARKER + phase, still larger than any length byte
+#define TX_TIMESTAMP_OFFSET         3       // Packets of at least 7 bytes carry the SFD time of the previous packet here (big endian)
+#define MAC_TIMER_PERIOD            32768   // Overflow of the MAC timer every 1024 microseconds, the same as on the sniffer
+
+#define COMMAND_BAUDRATE            115200  // Baudrate of the UART on which the pc can change the profile
+#define COMMAND_MAX_LENGTH          40      // Longest command line, longer lines are rejected
+#define TRACE_MAX_ENTRIES           1000    // Amount of packets in a trace that can be replayed
+#define TX_TURNAROUND_TIME          192     // Microseconds between the ISTXON strobe and the start of the preamble
+#define TX_BYTE_TIME                32      // Microseconds to send a single byte
+#define TX_OVERHEAD_BYTES           8       // Preamble, SFD, length byte and FCS
+#define TX_SFD_TIME                 (TX_TURNAROUND_TIME + (5 * TX_BYTE_TIME)) // Microseconds between the ISTXON strobe and the end of the SFD
+#define TX_SCHEDULE_MIN_DELAY       20      // Microseconds that a packet is scheduled ahead at least, so that its compare value still lies in the future
+#define SEQUENCE_MAX                50000   // The sequence number counts from 1 to this value and then starts again at 1
+
+#define MAC_TRAILER_LENGTH          3       // MAC frames carry the sequence number and the phase marker at the end of their payload
+#define MAC_ACK_LENGTH              3       // Frame control and sequence number, an ACK has no room for the trailer
+#define MAC_MIC_LENGTH              4       // The secured frames use security level 5 (ENC-MIC-32)
+#define MAC_PAN_BASE                0x1A00  // PAN ID of the first PAN, the others follow it
+#define MAC_BROADCAST               0xFFFF
+
+#define TDMA_MAX_NODES              16      // Motes that can share the channel, the node ID is stored in the upper 4 bits of the sequence number
+#define TDMA_SEQUENCE_MAX           4000    // Highest sequence number of a mote that shares the channel, which leaves 12 bits for it
+#define TDMA_BEACON_MAGIC           0xBEAC  // First two bytes of the beacon, followed by TDMA_BEACON_MARKER and the cycle number
+#define TDMA_BEACON_MARKER          0xB0    // Third byte of the beacon, which a data packet of the same length never has
+#define TDMA_BEACON_LENGTH          7       // Magic, marker and 4 bytes cycle number
+#define TDMA_BEACON_DURATION        (TX_TURNAROUND_TIME + ((TDMA_BEACON_LENGTH + TX_OVERHEAD_BYTES) * TX_BYTE_TIME))
+#define TDMA_GUARD_TIME             100     // Microseconds at the end of every slot without packets, for the drift between the clocks of the motes
+#define TDMA_SYNC_TIMEOUT           1000000 // Microseconds without beacon after which a follower stops sending, its clock may have drifted too far by then
+#define TDMA_MIN_SLOT               (TDMA_BEACON_DURATION + TX_TURNAROUND_TIME + ((125 + TX_OVERHEAD_BYTES) * TX_BYTE_TIME) + TDMA_GUARD_TIME)
+
+#if defined(SCHEDULED_TX) && defined(MAX_PERFORMANCE)
+    #error "SCHEDULED_TX can't be combined with MAX_PERFORMANCE"
+#endif
 
 enum Phase
 {
@@ -32,11 +70,94 @@ enum Phase
     FullyRandom1,
     FullyRandom2,
     FullyRandom3,
-    PhaseCount // # of phases described in this enum
+    PhaseCount // # of phases described in this enum, also send in the packets when the length doesn't come from the phases
+};
+
+enum ProfileMode
+{
+    ModePhases, // Go through all phases above
+    ModeFixed,  // Every packet has the minimum length
+    ModeRandom, // Uniformly distributed lengths between the minimum and maximum length
+    ModeTrace   // Lengths and delays of the trace that the pc send
+};
+
+enum FrameFormat
+{
+    FramesRaw, // The sequence number and phase marker at the start, followed by bytes that can't be a length byte
+    FramesMac  // Valid IEEE 802.15.4 frames of the types in macTypes, with the sequence number in a trailer
+};
+
+enum MacType
+{
+    MacBeacon  = 0,
+    MacData    = 1,
+    MacAck     = 2,
+    MacCommand = 3
+};
+
+enum MacAddressing
+{
+    AddressingShort,
+    AddressingLong,
+    AddressingMixed // Every address is either short or long
+};
+
+// Describes which packets are send and when, it can be changed over the UART at any time
+struct Profile
+{
+    uint8_t  mode;
+    uint8_t  minLength;
+    uint8_t  maxLength;
+    uint8_t  channel;
+    uint32_t period;     // Microseconds between the start of two packets, 0 to send back-to-back
+    uint32_t rate;       // Packets per second that the period was calculated from, the remainder is spread over the packets
+    uint32_t gap;        // Microseconds between the end of a packet and the start of the next one
+    uint16_t burstCount; // Packets in a burst, 0 when not sending in bursts
+    uint32_t burstPause; // Microseconds between the end of one burst and the start of the next
+    uint8_t  tdmaNode;   // Slot of this mote when sharing the channel, the leader (node 0) sends the beacons
+    uint8_t  tdmaCount;  // Motes that share the channel, 0 when the mote has the channel for itself
+    uint32_t tdmaSlot;   // Microseconds of every slot, the cycle consists of tdmaCount slots
+    uint8_t  frames;     // FrameFormat of the packets
+    uint8_t  macTypes;   // Bit for every MacType that is send, one of them is chosen at random for every frame
+    uint8_t  macPans;    // PANs of which the frames are send, their IDs start at MAC_PAN_BASE
+    uint8_t  macNodes;   // Nodes in every PAN besides the coordinator, which has short address 0
+    uint8_t  macAddressing;
+    bool     macSecurity; // Add an auxiliary security header and a MIC (the payload isn't really encrypted)
+    bool     macLowpan;   // Data frames carry a compressed 6LoWPAN IPv6 and UDP header
+    bool     running;
 };
 
 static volatile tDMAControlTable uDMAChannelControlTable __attribute__((section(".udma_channel_control_table")));
 static uint8_t radio_buffer[125];
+static uint8_t mac_buffer[125];
+static const uint8_t* tx_buffer = radio_buffer; // Packet that the uDMA copies to the TX FIFO
+static uint32_t macFrameCounter = 0;
+
+static Profile profile;
+static uint8_t  traceLengths[TRACE_MAX_ENTRIES];
+static uint32_t traceDelays[TRACE_MAX_ENTRIES]; // Microseconds between the start of the previous packet and this one
+static uint16_t traceCount = 0;
+static uint16_t traceIndex = 0;
+
+#ifdef SCHEDULED_TX
+// The next packet waits in radio_buffer until the MAC timer interrupt starts it and lets the uDMA copy it
+static volatile uint8_t  txPacketLen;
+static volatile uint16_t txCompareTicks;    // MAC timer ticks within the overflow period in which the packet starts
+static volatile bool     txStarted = false;
+static bool              txScheduled = false;
+
+// The schedule that the mote shares with the others, relative to the start of the cycle in which the leader send its last beacon
+static uint8_t  tdmaBeacon[TDMA_BEACON_LENGTH];
+static uint32_t tdmaCycleStart;
+static uint32_t tdmaCycle = 0;
+static uint32_t tdmaBeaconTime;     // When a follower received the last beacon
+static bool     tdmaSynchronized = false;
+static bool     tdmaBeaconDue = false;
+#endif
+
+static char    commandLine[COMMAND_MAX_LENGTH + 1];
+static uint8_t commandLength = 0;
+static bool    commandTooLong = false;
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -82,12 +203,19 @@ void seedRandom()
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-uint8_t rnd()
+uint16_t rndWord()
 {
     // Clock the RNG LSFR once
     HWREG(SOC_ADC_ADCCON1) |= 0x00000004;
 
-    uint32_t retVal = (HWREG(SOC_ADC_RNDL) | (HWREG(SOC_ADC_RNDH) << 8)) & 0x7F;
+    return HWREG(SOC_ADC_RNDL) | (HWREG(SOC_ADC_RNDH) << 8);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint8_t rnd()
+{
+    uint32_t retVal = rndWord() & 0x7F;
 
     if (retVal < 2)
         return 2;
@@ -99,6 +227,821 @@ uint8_t rnd()
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+void startMacTimer()
+{
+    // The MAC timer captures its value when the SFD of a packet leaves the radio
+    HWREG(RFCORE_SFR_MTMSEL) = (0x02 << RFCORE_SFR_MTMSEL_MTMSEL_S); // Select the timer period
+    HWREG(RFCORE_SFR_MTM0) = (MAC_TIMER_PERIOD >> 0) & 0xff;
+    HWREG(RFCORE_SFR_MTM1) = (MAC_TIMER_PERIOD >> 8) & 0xff;
+    HWREG(RFCORE_SFR_MTCTRL) = RFCORE_SFR_MTCTRL_RUN | RFCORE_SFR_MTCTRL_SYNC | RFCORE_SFR_MTCTRL_LATCH_MODE;
+    while (!(HWREG(RFCORE_SFR_MTCTRL) & RFCORE_SFR_MTCTRL_STATE))
+        ;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void readTimer(uint32_t select, uint32_t& ticks, uint32_t& overflows)
+{
+    // The MAC timer interrupt also uses MTMSEL, so it may not occur while reading the timer
+    const bool interruptsWereDisabled = IntMasterDisable();
+
+    // Select the timer and overflow values, the timer is latched when reading MTM0
+    HWREG(RFCORE_SFR_MTMSEL) = (select << RFCORE_SFR_MTMSEL_MTMSEL_S) | (select << RFCORE_SFR_MTMSEL_MTMOVFSEL_S);
+
+    ticks = HWREG(RFCORE_SFR_MTM0);
+    ticks |= HWREG(RFCORE_SFR_MTM1) << 8;
+
+    overflows = HWREG(RFCORE_SFR_MTMOVF0);
+    overflows |= HWREG(RFCORE_SFR_MTMOVF1) << 8;
+    overflows |= HWREG(RFCORE_SFR_MTMOVF2) << 16;
+
+    if (!interruptsWereDisabled)
+        IntMasterEnable();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t readTime(uint32_t select)
+{
+    uint32_t ticks;
+    uint32_t overflows;
+    readTimer(select, ticks, overflows);
+
+    // Microseconds, in the same format as the timestamps of the sniffer
+    return (overflows << 10) | (ticks >> 5);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t readCurrentTime()
+{
+    return readTime(0x00);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t readSfdTime()
+{
+    return readTime(0x01);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void resetProfile()
+{
+    // By default the program behaves as if it wasn't remote controlled
+#ifdef FIXED_PACKET_SIZE
+    profile.mode = ModeFixed;
+    profile.minLength = FIXED_PACKET_SIZE;
+    profile.maxLength = FIXED_PACKET_SIZE;
+#else
+    profile.mode = ModePhases;
+    profile.minLength = 2;
+    profile.maxLength = 125;
+#endif
+    profile.channel = 26;
+    profile.period = 0;
+    profile.rate = 0;
+    profile.gap = 0;
+    profile.burstCount = 0;
+    profile.burstPause = 0;
+    profile.tdmaNode = 0;
+    profile.tdmaCount = 0;
+    profile.tdmaSlot = 0;
+    profile.frames = FramesRaw;
+    profile.macTypes = (1 << MacData);
+    profile.macPans = 1;
+    profile.macNodes = 8;
+    profile.macAddressing = AddressingShort;
+    profile.macSecurity = false;
+    profile.macLowpan = false;
+    profile.running = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint16_t sequenceMax()
+{
+    return (profile.tdmaCount > 0) ? TDMA_SEQUENCE_MAX : SEQUENCE_MAX;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool readWord(const char*& pos, const char* word)
+{
+    while (*pos == ' ')
+        pos++;
+
+    const char* end = pos;
+    while (*word != '\0')
+    {
+        if (*end++ != *word++)
+            return false;
+    }
+
+    if ((*end != ' ') && (*end != '\0'))
+        return false;
+
+    pos = end;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool readNumber(const char*& pos, uint32_t& value, uint32_t minValue, uint32_t maxValue)
+{
+    while (*pos == ' ')
+        pos++;
+
+    if ((*pos < '0') || (*pos > '9'))
+        return false;
+
+    value = 0;
+    while ((*pos >= '0') && (*pos <= '9'))
+    {
+        const uint32_t digit = *pos++ - '0';
+        if ((value > maxValue / 10) || ((value * 10) + digit > maxValue))
+            return false;
+
+        value = (value * 10) + digit;
+    }
+
+    return (value >= minValue) && ((*pos == ' ') || (*pos == '\0'));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool readEnd(const char* pos)
+{
+    while (*pos == ' ')
+        pos++;
+
+    return *pos == '\0';
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool readSwitch(const char*& pos, bool& value)
+{
+    if (readWord(pos, "on") && readEnd(pos))
+        value = true;
+    else if (readWord(pos, "off") && readEnd(pos))
+        value = false;
+    else
+        return false;
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool executeMacCommand(const char* pos)
+{
+    uint32_t value;
+    if (readWord(pos, "types"))
+    {
+        // Bit 0 for beacons, bit 1 for data frames, bit 2 for ACKs and bit 3 for MAC commands
+        if (!readNumber(pos, value, 1, 15) || !readEnd(pos))
+            return false;
+
+        profile.macTypes = value;
+    }
+    else if (readWord(pos, "pans"))
+    {
+        if (!readNumber(pos, value, 1, 255) || !readEnd(pos))
+            return false;
+
+        profile.macPans = value;
+    }
+    else if (readWord(pos, "nodes"))
+    {
+        if (!readNumber(pos, value, 1, 255) || !readEnd(pos))
+            return false;
+
+        profile.macNodes = value;
+    }
+    else if (readWord(pos, "addressing"))
+    {
+        if (readWord(pos, "short") && readEnd(pos))
+            profile.macAddressing = AddressingShort;
+        else if (readWord(pos, "long") && readEnd(pos))
+            profile.macAddressing = AddressingLong;
+        else if (readWord(pos, "mixed") && readEnd(pos))
+            profile.macAddressing = AddressingMixed;
+        else
+            return false;
+    }
+    else if (readWord(pos, "security"))
+        return readSwitch(pos, profile.macSecurity);
+    else if (readWord(pos, "lowpan"))
+        return readSwitch(pos, profile.macLowpan);
+    else
+        return false;
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool executeCommand(const char* pos)
+{
+    uint32_t value1;
+    uint32_t value2;
+
+    if (readWord(pos, "start") && readEnd(pos))
+        profile.running = true;
+    else if (readWord(pos, "stop") && readEnd(pos))
+        profile.running = false;
+    else if (readWord(pos, "reset") && readEnd(pos))
+        resetProfile();
+    else if (readWord(pos, "channel"))
+    {
+        if (!readNumber(pos, value1, 11, 26) || !readEnd(pos))
+            return false;
+
+        profile.channel = value1;
+    }
+    else if (readWord(pos, "rate"))
+    {
+        // Packets per second, 0 sends them back-to-back
+        if (!readNumber(pos, value1, 0, 1000000) || !readEnd(pos))
+            return false;
+
+        profile.period = (value1 > 0) ? (1000000 / value1) : 0;
+        profile.rate = value1;
+    }
+    else if (readWord(pos, "gap"))
+    {
+        if (!readNumber(pos, value1, 0, 100000000) || !readEnd(pos))
+            return false;
+
+        profile.gap = value1;
+    }
+    else if (readWord(pos, "burst"))
+    {
+        if (!readNumber(pos, value1, 0, 65535) || !readNumber(pos, value2, 0, 100000000) || !readEnd(pos))
+            return false;
+
+        profile.burstCount = value1;
+        profile.burstPause = value2;
+    }
+#ifdef SCHEDULED_TX
+    else if (readWord(pos, "tdma"))
+    {
+        // Either "tdma off" or "tdma <node> <count> <slot>", a follower only sends after it received a beacon of node 0
+        if (readWord(pos, "off") && readEnd(pos))
+            profile.tdmaCount = 0;
+        else
+        {
+            uint32_t value3;
+            if (!readNumber(pos, value1, 0, TDMA_MAX_NODES - 1) || !readNumber(pos, value2, value1 + 1, TDMA_MAX_NODES)
+             || !readNumber(pos, value3, TDMA_MIN_SLOT, 1000000) || !readEnd(pos))
+                return false;
+
+            profile.tdmaNode = value1;
+            profile.tdmaCount = value2;
+            profile.tdmaSlot = value3;
+        }
+
+        tdmaSynchronized = false;
+        tdmaBeaconDue = true;
+        tdmaCycleStart = readCurrentTime() + profile.tdmaSlot;
+    }
+#endif
+    else if (readWord(pos, "mode"))
+    {
+        if (readWord(pos, "phases") && readEnd(pos))
+            profile.mode = ModePhases;
+        else if (readWord(pos, "fixed"))
+        {
+            if (!readNumber(pos, value1, 2, 125) || !readEnd(pos))
+                return false;
+
+            profile.mode = ModeFixed;
+            profile.minLength = value1;
+            profile.maxLength = value1;
+        }
+        else if (readWord(pos, "random"))
+        {
+            if (!readNumber(pos, value1, 2, 125) || !readNumber(pos, value2, value1, 125) || !readEnd(pos))
+                return false;
+
+            profile.mode = ModeRandom;
+            profile.minLength = value1;
+            profile.maxLength = value2;
+        }
+        else if (readWord(pos, "trace") && readEnd(pos))
+        {
+            if (traceCount == 0)
+                return false;
+
+            profile.mode = ModeTrace;
+            traceIndex = 0;
+        }
+        else
+            return false;
+    }
+    else if (readWord(pos, "frames"))
+    {
+        if (readWord(pos, "raw") && readEnd(pos))
+            profile.frames = FramesRaw;
+        else if (readWord(pos, "mac") && readEnd(pos))
+            profile.frames = FramesMac;
+        else
+            return false;
+    }
+    else if (readWord(pos, "mac"))
+        return executeMacCommand(pos);
+    else if (readWord(pos, "trace"))
+    {
+        // Either "trace clear" or "trace <length> <delay>" to add a packet at the end of the trace
+        if (readWord(pos, "clear") && readEnd(pos))
+        {
+            if (profile.mode == ModeTrace)
+                return false;
+
+            traceCount = 0;
+        }
+        else
+        {
+            if ((traceCount == TRACE_MAX_ENTRIES) || !readNumber(pos, value1, 2, 125)
+             || !readNumber(pos, value2, 0, 100000000) || !readEnd(pos))
+                return false;
+
+            traceLengths[traceCount] = value1;
+            traceDelays[traceCount] = value2;
+            traceCount++;
+        }
+    }
+    else
+        return false;
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void sendReply(const char* reply)
+{
+    while (*reply != '\0')
+        UARTCharPut(uart.getBase(), *reply++);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void processCommands()
+{
+    // Commands are lines of text, every line is answered with OK or ERROR
+    while (UARTCharsAvail(uart.getBase()))
+    {
+        const char c = UARTCharGetNonBlocking(uart.getBase());
+        if ((c == '\n') || (c == '\r'))
+        {
+            if ((commandLength == 0) && !commandTooLong)
+                continue;
+
+            commandLine[commandLength] = '\0';
+            sendReply((!commandTooLong && executeCommand(commandLine)) ? "OK\n" : "ERROR\n");
+            commandLength = 0;
+            commandTooLong = false;
+        }
+        else if (commandLength < COMMAND_MAX_LENGTH)
+            commandLine[commandLength++] = c;
+        else
+            commandTooLong = true;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool waitUntil(uint32_t time)
+{
+    // Commands are still handled while waiting, returns false when the pc stopped sending
+    while (static_cast<int32_t>(readCurrentTime() - time) < 0)
+    {
+        processCommands();
+        if (!profile.running)
+            return false;
+    }
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint8_t writeMacAddress(uint8_t pos, uint8_t mode, uint8_t pan, uint8_t node)
+{
+    // Short addresses are the node number, long addresses contain the PAN and the node behind an OUI. Both are little endian.
+    if (mode == 2)
+    {
+        const uint16_t address = (node == 0xFF) ? MAC_BROADCAST : node;
+        mac_buffer[pos++] = address & 0xff;
+        mac_buffer[pos++] = (address >> 8) & 0xff;
+    }
+    else
+    {
+        const uint8_t address[8] = {0x00, 0x12, 0x4B, 0x00, 0x00, pan, 0x00, node};
+        for (int i = 7; i >= 0; --i)
+            mac_buffer[pos++] = address[i];
+    }
+
+    return pos;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint8_t chooseAddressMode()
+{
+    if (profile.macAddressing == AddressingShort)
+        return 2;
+    else if (profile.macAddressing == AddressingLong)
+        return 3;
+    else
+        return (rndWord() & 1) ? 3 : 2;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint8_t buildMacFrame(uint16_t sequenceNumber, uint8_t marker, uint8_t packetLen)
+{
+    uint8_t type;
+    do
+    {
+        type = rndWord() & 0x03;
+    } while (!(profile.macTypes & (1 << type)));
+
+    const uint8_t pan = rndWord() % profile.macPans;
+    const uint16_t panId = MAC_PAN_BASE + pan;
+    const uint8_t node = 1 + (rndWord() % profile.macNodes);
+    if (type == MacAck)
+    {
+        mac_buffer[0] = MacAck;
+        mac_buffer[1] = 0x00;
+        mac_buffer[2] = sequenceNumber & 0xff;
+        return MAC_ACK_LENGTH;
+    }
+
+    // Beacons come from the coordinator of the PAN. Data frames go between a node and the coordinator in either direction, one
+    // in eight is a broadcast from the coordinator. A MAC command is a data request of a node to the coordinator.
+    uint8_t dstMode = 0;
+    uint8_t srcMode = chooseAddressMode();
+    uint8_t dstNode = 0;
+    uint8_t srcNode = 0;
+    bool ackRequest = false;
+    if (type == MacData)
+    {
+        dstMode = chooseAddressMode();
+        const uint16_t direction = rndWord() & 0x07;
+        if (direction == 0)
+        {
+            dstMode = 2;
+            dstNode = 0xFF;
+        }
+        else if (direction & 1)
+            srcNode = node;
+        else
+            dstNode = node;
+
+        ackRequest = (dstNode != 0xFF);
+    }
+    else if (type == MacCommand)
+    {
+        dstMode = chooseAddressMode();
+        srcNode = node;
+        ackRequest = true;
+    }
+
+    const bool secured = profile.macSecurity;
+    const uint16_t frameControl = type | (secured ? 0x0008 : 0) | (ackRequest ? 0x0020 : 0) | ((dstMode != 0) ? 0x0040 : 0)
+                                | (dstMode << 10) | ((secured ? 1 : 0) << 12) | (srcMode << 14);
+    uint8_t pos = 0;
+    mac_buffer[pos++] = frameControl & 0xff;
+    mac_buffer[pos++] = (frameControl >> 8) & 0xff;
+    mac_buffer[pos++] = sequenceNumber & 0xff;
+
+    // The PAN ID is only given once, as both addresses belong to the same PAN
+    mac_buffer[pos++] = panId & 0xff;
+    mac_buffer[pos++] = (panId >> 8) & 0xff;
+    if (dstMode != 0)
+        pos = writeMacAddress(pos, dstMode, pan, dstNode);
+    pos = writeMacAddress(pos, srcMode, pan, srcNode);
+
+    if (secured)
+    {
+        // Security level 5 with key identifier mode 1, the key index follows the frame counter
+        mac_buffer[pos++] = 0x0D;
+        mac_buffer[pos++] = macFrameCounter & 0xff;
+        mac_buffer[pos++] = (macFrameCounter >> 8) & 0xff;
+        mac_buffer[pos++] = (macFrameCounter >> 16) & 0xff;
+        mac_buffer[pos++] = (macFrameCounter >> 24) & 0xff;
+        mac_buffer[pos++] = 0x01;
+        macFrameCounter++;
+    }
+
+    if (type == MacBeacon)
+    {
+        // Non-beacon-enabled PAN coordinator that permits association, without GTSs or pending addresses
+        mac_buffer[pos++] = 0xFF;
+        mac_buffer[pos++] = 0xCF;
+        mac_buffer[pos++] = 0x00;
+        mac_buffer[pos++] = 0x00;
+    }
+    else if (type == MacCommand)
+        mac_buffer[pos++] = 0x04;
+    else if (profile.macLowpan)
+    {
+        // IPHC with the traffic class, flow label and hop limit elided and addresses derived from the MAC header,
+        // followed by a UDP header with compressed ports (0xF0B0 to 0xF0BF) and an elided checksum
+        mac_buffer[pos++] = 0x7F;
+        mac_buffer[pos++] = 0x33;
+        mac_buffer[pos++] = 0xF7;
+        mac_buffer[pos++] = 0x00 | (node & 0x0F);
+    }
+
+    // The payload is filled up to the requested length, the frame becomes longer when its headers don't fit
+    const uint8_t micLength = secured ? MAC_MIC_LENGTH : 0;
+    uint8_t length = pos + MAC_TRAILER_LENGTH + micLength;
+    if (packetLen > length)
+        length = packetLen;
+
+    while (pos < length - MAC_TRAILER_LENGTH - micLength)
+    {
+        mac_buffer[pos] = 140 + pos;
+        pos++;
+    }
+
+    mac_buffer[pos++] = (sequenceNumber >> 8) & 0xff;
+    mac_buffer[pos++] = sequenceNumber & 0xff;
+    mac_buffer[pos++] = marker;
+    for (uint8_t i = 0; i < micLength; ++i)
+        mac_buffer[pos++] = rndWord() & 0xff;
+
+    return length;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void setTransferSource(const uint8_t* data, uint8_t length)
+{
+    uDMAChannelControlTable.pvSrcEndAddr = (void*)&data[length-1];
+    uDMAChannelControlTable.ui32Control &= ~(UDMACHCTL_CHCTL_XFERSIZE_M | UDMACHCTL_CHCTL_XFERMODE_M);
+    uDMAChannelControlTable.ui32Control |= UDMA_MODE_AUTO | ((length-1) << 4);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifdef SCHEDULED_TX
+void transmitScheduledPacket()
+{
+    // Disable the interrupt first, the compare also matches in every following overflow period
+    HWREG(RFCORE_SFR_MTIRQM) &= ~RFCORE_SFR_MTIRQM_MACTIMER_COMPARE1M;
+
+    // When sending at the PHY maximum the previous packet only just ended
+    while (HWREG(RFCORE_XREG_FSMSTAT1) & RFCORE_XREG_FSMSTAT1_TX_ACTIVE)
+        ;
+
+    // The radio only needs the length byte once the preamble and SFD were send, the uDMA fills the TX FIFO long before that
+    HWREG(RFCORE_SFR_RFST) = CC2538_RF_CSP_OP_ISFLUSHTX;
+    HWREG(RFCORE_SFR_RFST) = CC2538_RF_CSP_OP_ISTXON;
+    HWREG(RFCORE_SFR_RFDATA) = txPacketLen + 2;
+    HWREG(UDMA_ENASET) = 1;
+    HWREG(UDMA_SWREQ) = 1;
+    txStarted = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void armTickCompare()
+{
+    HWREG(RFCORE_SFR_MTMSEL) = (0x03 << RFCORE_SFR_MTMSEL_MTMSEL_S);
+    HWREG(RFCORE_SFR_MTM0) = (txCompareTicks >> 0) & 0xff;
+    HWREG(RFCORE_SFR_MTM1) = (txCompareTicks >> 8) & 0xff;
+
+    // The flag is set in every overflow period, it would immediately trigger the interrupt if it wasn't cleared
+    HWREG(RFCORE_SFR_MTIRQF) = 0;
+    HWREG(RFCORE_SFR_MTIRQM) |= RFCORE_SFR_MTIRQM_MACTIMER_COMPARE1M;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void macTimerInterruptHandler()
+{
+    IntPendClear(INT_MACTIMR);
+    const uint32_t flags = HWREG(RFCORE_SFR_MTIRQF) & HWREG(RFCORE_SFR_MTIRQM);
+    HWREG(RFCORE_SFR_MTIRQF) = 0;
+
+    // The overflow period in which the packet has to start has begun, the timer compare gives the exact moment
+    if (flags & RFCORE_SFR_MTIRQM_MACTIMER_OVF_COMPARE1M)
+    {
+        HWREG(RFCORE_SFR_MTIRQM) &= ~RFCORE_SFR_MTIRQM_MACTIMER_OVF_COMPARE1M;
+        armTickCompare();
+
+        // The compare only triggers when the timer passes it, which may already have happened when starting early in the period
+        uint32_t ticks;
+        uint32_t overflows;
+        readTimer(0x00, ticks, overflows);
+        if (ticks >= txCompareTicks)
+            transmitScheduledPacket();
+    }
+    else if (flags & RFCORE_SFR_MTIRQM_MACTIMER_COMPARE1M)
+        transmitScheduledPacket();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t scheduleTransmission(uint32_t startTime, uint8_t packetLen)
+{
+    txPacketLen = packetLen;
+    txStarted = false;
+    txScheduled = true;
+
+    const bool interruptsWereDisabled = IntMasterDisable();
+
+    uint32_t ticks;
+    uint32_t overflows;
+    readTimer(0x00, ticks, overflows);
+
+    // A packet that is late starts as soon as possible, the ones after it are spaced from that moment
+    uint32_t delay = startTime - ((overflows << 10) | (ticks >> 5));
+    if (static_cast<int32_t>(delay) < TX_SCHEDULE_MIN_DELAY)
+    {
+        startTime += TX_SCHEDULE_MIN_DELAY - delay;
+        delay = TX_SCHEDULE_MIN_DELAY;
+    }
+
+    // Both the overflow counter and its compare register are 24 bits wide
+    const uint32_t target = (ticks >> 5) + delay;
+    txCompareTicks = (target & 1023) << 5;
+    if ((target >> 10) == 0)
+        armTickCompare();
+    else
+    {
+        const uint32_t compare = overflows + (target >> 10);
+        HWREG(RFCORE_SFR_MTMSEL) = (0x03 << RFCORE_SFR_MTMSEL_MTMOVFSEL_S);
+        HWREG(RFCORE_SFR_MTMOVF0) = (compare >> 0) & 0xff;
+        HWREG(RFCORE_SFR_MTMOVF1) = (compare >> 8) & 0xff;
+        HWREG(RFCORE_SFR_MTMOVF2) = (compare >> 16) & 0xff;
+        HWREG(RFCORE_SFR_MTIRQF) = 0;
+        HWREG(RFCORE_SFR_MTIRQM) |= RFCORE_SFR_MTIRQM_MACTIMER_OVF_COMPARE1M;
+    }
+
+    if (!interruptsWereDisabled)
+        IntMasterEnable();
+
+    return startTime;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void receiveBeacons()
+{
+    // Between its own packets the radio of a follower listens to the beacons of the leader
+    const bool interruptsWereDisabled = IntMasterDisable();
+    if (!(HWREG(RFCORE_XREG_FSMSTAT1) & (RFCORE_XREG_FSMSTAT1_RX_ACTIVE | RFCORE_XREG_FSMSTAT1_TX_ACTIVE)))
+        HWREG(RFCORE_SFR_RFST) = CC2538_RF_CSP_OP_ISRXON;
+    if (!interruptsWereDisabled)
+        IntMasterEnable();
+
+    // FIFOP without FIFO means that the RX FIFO overflowed
+    if ((HWREG(RFCORE_XREG_FSMSTAT1) & RFCORE_XREG_FSMSTAT1_FIFOP) && !(HWREG(RFCORE_XREG_FSMSTAT1) & RFCORE_XREG_FSMSTAT1_FIFO))
+    {
+        HWREG(RFCORE_SFR_RFST) = CC2538_RF_CSP_OP_ISFLUSHRX;
+        HWREG(RFCORE_SFR_RFST) = CC2538_RF_CSP_OP_ISFLUSHRX;
+        return;
+    }
+
+    // FIFOP is set while there is a complete frame in the RX FIFO, the packets of the other motes are read away as well
+    while (HWREG(RFCORE_XREG_FSMSTAT1) & RFCORE_XREG_FSMSTAT1_FIFOP)
+    {
+        const uint8_t length = HWREG(RFCORE_SFR_RFDATA);
+        if ((length < 3) || (length > 127))
+        {
+            HWREG(RFCORE_SFR_RFST) = CC2538_RF_CSP_OP_ISFLUSHRX;
+            HWREG(RFCORE_SFR_RFST) = CC2538_RF_CSP_OP_ISFLUSHRX;
+            return;
+        }
+
+        uint8_t header[3];
+        uint8_t status = 0;
+        for (uint8_t i = 0; i < length; ++i)
+        {
+            status = HWREG(RFCORE_SFR_RFDATA);
+            if (i < sizeof(header))
+                header[i] = status;
+        }
+
+        // The captured SFD only belongs to the beacon when no other frame was started after it
+        if ((length == TDMA_BEACON_LENGTH + 2) && (((header[0] << 8) | header[1]) == TDMA_BEACON_MAGIC)
+         && (header[2] == TDMA_BEACON_MARKER) && (status & 0x80) && (HWREG(RFCORE_XREG_RXFIFOCNT) == 0)
+         && !(HWREG(RFCORE_XREG_FSMSTAT1) & RFCORE_XREG_FSMSTAT1_SFD))
+        {
+            tdmaCycleStart = readSfdTime() - TX_SFD_TIME;
+            tdmaBeaconTime = readCurrentTime();
+            tdmaSynchronized = true;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t fitIntoSlot(uint32_t startTime, uint8_t packetLen)
+{
+    // The packet has to end in the slot of this mote, otherwise it waits for the slot in the next cycle
+    const uint32_t cycleLength = profile.tdmaCount * profile.tdmaSlot;
+    const uint32_t slotStart = (profile.tdmaNode * profile.tdmaSlot) + ((profile.tdmaNode == 0) ? TDMA_BEACON_DURATION : 0);
+    const uint32_t slotEnd = ((profile.tdmaNode + 1) * profile.tdmaSlot) - TDMA_GUARD_TIME;
+    const uint32_t duration = TX_TURNAROUND_TIME + ((packetLen + TX_OVERHEAD_BYTES) * TX_BYTE_TIME);
+
+    const uint32_t now = readCurrentTime();
+    if (static_cast<int32_t>(startTime - now) < 0)
+        startTime = now;
+    if (static_cast<int32_t>(startTime - tdmaCycleStart) < 0)
+        startTime = tdmaCycleStart;
+
+    uint32_t cycles = (startTime - tdmaCycleStart) / cycleLength;
+    uint32_t offset = (startTime - tdmaCycleStart) % cycleLength;
+    if (offset < slotStart)
+        offset = slotStart;
+    else if (offset + duration > slotEnd)
+    {
+        offset = slotStart;
+        cycles++;
+    }
+
+    // The cycle start moves along, so that the time never wraps around between it and the packets. The leader sends a
+    // beacon at the start of every cycle in which it sends packets.
+    if (cycles > 0)
+    {
+        tdmaCycleStart += cycles * cycleLength;
+        tdmaCycle += cycles;
+        tdmaBeaconDue = true;
+    }
+
+    return tdmaCycleStart + offset;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool waitForScheduledPacket()
+{
+    // Commands are still handled while waiting, returns false when the packet was cancelled because the pc stopped sending
+    while (txScheduled && !txStarted)
+    {
+        if ((profile.tdmaCount > 0) && (profile.tdmaNode != 0))
+            receiveBeacons();
+
+        processCommands();
+        if (!profile.running)
+        {
+            const bool interruptsWereDisabled = IntMasterDisable();
+            HWREG(RFCORE_SFR_MTIRQM) &= ~(RFCORE_SFR_MTIRQM_MACTIMER_OVF_COMPARE1M | RFCORE_SFR_MTIRQM_MACTIMER_COMPARE1M);
+            const bool started = txStarted;
+            if (!interruptsWereDisabled)
+                IntMasterEnable();
+
+            if (!started)
+            {
+                txScheduled = false;
+                return false;
+            }
+        }
+    }
+
+    // The uDMA reads radio_buffer until it has copied the whole packet to the TX FIFO
+    while (HWREG(UDMA_ENASET))
+        ;
+
+    txScheduled = false;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool sendBeacon(uint8_t packetLen)
+{
+    tdmaBeacon[0] = (TDMA_BEACON_MAGIC >> 8) & 0xff;
+    tdmaBeacon[1] = TDMA_BEACON_MAGIC & 0xff;
+    tdmaBeacon[2] = TDMA_BEACON_MARKER;
+    tdmaBeacon[3] = (tdmaCycle >> 24) & 0xff;
+    tdmaBeacon[4] = (tdmaCycle >> 16) & 0xff;
+    tdmaBeacon[5] = (tdmaCycle >> 8) & 0xff;
+    tdmaBeacon[6] = tdmaCycle & 0xff;
+
+    // The beacon goes first, the uDMA is pointed back to the packet once it copied the beacon
+    setTransferSource(tdmaBeacon, TDMA_BEACON_LENGTH);
+    const uint32_t beaconTime = scheduleTransmission(tdmaCycleStart, TDMA_BEACON_LENGTH);
+    const bool sent = waitForScheduledPacket();
+    setTransferSource(tx_buffer, packetLen);
+
+    // A late beacon moves the whole cycle, the followers synchronize on it anyway
+    tdmaCycleStart = beaconTime;
+    tdmaBeaconDue = false;
+    return sent;
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 static void prvRadioSendTask(void *pvParameters)
 {
     seedRandom();
@@ -109,14 +1052,35 @@ static void prvRadioSendTask(void *pvParameters)
     uDMAChannelControlSet(0, UDMA_SIZE_8 | UDMA_DST_INC_NONE | UDMA_SRC_INC_8 | UDMA_ARB_128);
     uDMAChannelControlTable.pvDstEndAddr = (void*)RFCORE_SFR_RFDATA;
 
+    resetProfile();
+    uart.enable(COMMAND_BAUDRATE, UART_CONFIG_WLEN_8 | UART_CONFIG_STOP_ONE | UART_CONFIG_PAR_NONE, UART_TXINT_MODE_EOT);
+    UARTFIFOEnable(uart.getBase()); // Characters may arrive while waiting for a packet to be send
+
+    uint8_t channel = profile.channel;
     radio.enable();
-    radio.setChannel(26);
+    radio.setChannel(channel);
+    startMacTimer();
+
+#ifdef SCHEDULED_TX
+    // The packets are started from the compare interrupts of the MAC timer
+    IntRegister(INT_MACTIMR, macTimerInterruptHandler);
+    HWREG(RFCORE_SFR_MTIRQM) = 0;
+    HWREG(RFCORE_SFR_MTIRQF) = 0;
+    IntPendClear(INT_MACTIMR);
+    IntEnable(INT_MACTIMR);
+#endif
 
     uint16_t packetLen = rnd();
     uint16_t count = 0;
     uint32_t byteCountInPhase = 0;
     uint32_t maxBytesInPhase = 100000;
     uint8_t phase = 0;
+#ifndef MAX_PERFORMANCE
+    uint32_t lastStartTime = readCurrentTime();
+    uint16_t lastPacketLen = 0;
+    uint16_t packetsInBurst = 0;
+    uint32_t periodRemainder = 0;
+#endif
     while (true)
     {
 #ifdef MAX_PERFORMANCE
@@ -126,15 +1090,58 @@ static void prvRadioSendTask(void *pvParameters)
         packetLen = 1;
     #endif
 #else
-    if (++count > 50000)
+    #ifdef SCHEDULED_TX
+    // The next packet is prepared while the previous one is on the air, once the uDMA no longer needs radio_buffer
+    if (!waitForScheduledPacket())
+        count = (count > 1) ? (count - 1) : sequenceMax();
+    #endif
+
+    processCommands();
+    if (!profile.running)
+        continue;
+
+    #ifdef SCHEDULED_TX
+    // A follower only knows its slots once it received a beacon, and stops when its clock may have drifted too far
+    if ((profile.tdmaCount > 0) && (profile.tdmaNode != 0)
+     && (!tdmaSynchronized || (readCurrentTime() - tdmaBeaconTime > TDMA_SYNC_TIMEOUT)))
+    {
+        tdmaSynchronized = false;
+        receiveBeacons();
+        continue;
+    }
+    #endif
+
+    if (++count > sequenceMax())
         count = 1;
 
-    radio_buffer[0] = (count >> 8) & 0xff;
+    // When sharing the channel, the upper 4 bits of the sequence number contain the node ID
+    radio_buffer[0] = ((count >> 8) & 0xff) | ((profile.tdmaCount > 0) ? (profile.tdmaNode << 4) : 0);
     radio_buffer[1] = count & 0xff;
 
-    #ifdef FIXED_PACKET_SIZE
-        packetLen = FIXED_PACKET_SIZE;
-    #else
+    // Microseconds between the start of the previous packet and this one, some packets wait an extra microsecond to keep the exact rate
+    uint32_t delay = profile.period;
+    if (profile.rate > 0)
+    {
+        periodRemainder += 1000000 % profile.rate;
+        if (periodRemainder >= profile.rate)
+        {
+            periodRemainder -= profile.rate;
+            delay++;
+        }
+    }
+
+    if (profile.mode == ModeFixed)
+        packetLen = profile.minLength;
+    else if (profile.mode == ModeRandom)
+        packetLen = profile.minLength + (rndWord() % (profile.maxLength - profile.minLength + 1));
+    else if (profile.mode == ModeTrace)
+    {
+        packetLen = traceLengths[traceIndex];
+        delay = traceDelays[traceIndex];
+        traceIndex = (traceIndex + 1) % traceCount;
+    }
+    else
+    {
         // Determine the packet length based on the phase
         switch (phase)
         {
@@ -209,26 +1216,78 @@ static void prvRadioSendTask(void *pvParameters)
             else
                 maxBytesInPhase = 1000000;
         }
-    #endif
+    }
+
+    // Let the benchmark on the pc know to which phase the packet belongs (packets of 2 bytes have no room for it)
+    radio_buffer[2] = PHASE_MARKER + ((profile.mode == ModePhases) ? phase : PhaseCount);
+
+    // MAC frames carry the sequence number and the marker at the end of their payload instead. An ACK has no room for
+    // them, so the sequence number is given back for the next frame.
+    tx_buffer = radio_buffer;
+    if (profile.frames == FramesMac)
+    {
+        packetLen = buildMacFrame((radio_buffer[0] << 8) | radio_buffer[1], radio_buffer[2], packetLen);
+        tx_buffer = mac_buffer;
+        if (packetLen == MAC_ACK_LENGTH)
+            count = (count > 1) ? (count - 1) : sequenceMax();
+    }
 #endif
 
+#ifndef SCHEDULED_TX
         // Wait for ongoing TX to complete
         while (HWREG(RFCORE_XREG_FSMSTAT1) & RFCORE_XREG_FSMSTAT1_TX_ACTIVE)
-            ;
+        {
+#ifndef MAX_PERFORMANCE
+            processCommands();
+#endif
+        }
+#endif
+
+#ifndef MAX_PERFORMANCE
+        // The channel can only change while the radio isn't sending
+        if (channel != profile.channel)
+        {
+    #ifdef SCHEDULED_TX
+            while (HWREG(RFCORE_XREG_FSMSTAT1) & RFCORE_XREG_FSMSTAT1_TX_ACTIVE)
+                processCommands();
+    #endif
+            channel = profile.channel;
+            radio.setChannel(channel);
+        }
+#endif
+
+#if defined(TX_TIMESTAMPS) && !defined(MAX_PERFORMANCE)
+        // The time of this packet is only known once it is send, so the packet contains when the previous one went on the air
+        if ((packetLen >= TX_TIMESTAMP_OFFSET + 4) && (profile.frames == FramesRaw))
+        {
+    #ifdef SCHEDULED_TX
+            // The previous packet was only just started, its SFD has to be send before its time was captured
+            while (static_cast<int32_t>(readCurrentTime() - (lastStartTime + TX_SFD_TIME)) < 0)
+                ;
+    #endif
+            const uint32_t sfdTime = readSfdTime();
+            radio_buffer[TX_TIMESTAMP_OFFSET + 0] = (sfdTime >> 24) & 0xff;
+            radio_buffer[TX_TIMESTAMP_OFFSET + 1] = (sfdTime >> 16) & 0xff;
+            radio_buffer[TX_TIMESTAMP_OFFSET + 2] = (sfdTime >> 8) & 0xff;
+            radio_buffer[TX_TIMESTAMP_OFFSET + 3] = sfdTime & 0xff;
+        }
+#endif
 
         led_red.off();
 
+#ifndef SCHEDULED_TX
         // Append the PHY length to the TX buffer
         HWREG(RFCORE_SFR_RFDATA) = packetLen+2;
+#endif
 
         // Append the packet payload to the TX buffer
-        uDMAChannelControlTable.pvSrcEndAddr = (void*)&radio_buffer[packetLen-1];
-        uDMAChannelControlTable.ui32Control &= ~(UDMACHCTL_CHCTL_XFERSIZE_M | UDMACHCTL_CHCTL_XFERMODE_M);
-        uDMAChannelControlTable.ui32Control |= UDMA_MODE_AUTO | ((packetLen-1) << 4);
+        setTransferSource(tx_buffer, packetLen);
+#ifndef SCHEDULED_TX
         HWREG(UDMA_ENASET) = 1;
         HWREG(UDMA_SWREQ) = 1;
         while (HWREG(UDMA_ENASET))
             ;
+#endif
 
         led_red.on();
 
@@ -242,7 +1301,59 @@ static void prvRadioSendTask(void *pvParameters)
             HWREG(RFCORE_SFR_RFST) = CC2538_RF_CSP_OP_ISTXON;
         }
 #else
-        HWREG(RFCORE_SFR_RFST) = CC2538_RF_CSP_OP_ISTXON;
+        // The packet is already in the TX FIFO while waiting, the gap is counted from the calculated end of the previous packet
+        uint32_t startTime = lastStartTime + delay;
+        const uint32_t earliestStartTime = lastStartTime + TX_TURNAROUND_TIME + ((lastPacketLen + TX_OVERHEAD_BYTES) * TX_BYTE_TIME) + profile.gap;
+    #ifdef SCHEDULED_TX
+        // Without waiting for the end of the previous packet, only the calculation keeps the packets from overlapping
+        if (static_cast<int32_t>(earliestStartTime - startTime) > 0)
+    #else
+        if ((profile.gap > 0) && (static_cast<int32_t>(earliestStartTime - startTime) > 0))
+    #endif
+            startTime = earliestStartTime;
+
+        if ((profile.burstCount > 0) && (++packetsInBurst > profile.burstCount))
+        {
+            packetsInBurst = 1;
+            const uint32_t burstStartTime = lastStartTime + TX_TURNAROUND_TIME + ((lastPacketLen + TX_OVERHEAD_BYTES) * TX_BYTE_TIME) + profile.burstPause;
+            if (static_cast<int32_t>(burstStartTime - startTime) > 0)
+                startTime = burstStartTime;
+        }
+
+    #ifdef SCHEDULED_TX
+        if (profile.tdmaCount > 0)
+        {
+            startTime = fitIntoSlot(startTime, packetLen);
+            if ((profile.tdmaNode == 0) && tdmaBeaconDue)
+            {
+                if (!sendBeacon(packetLen))
+                {
+                    count = (count > 1) ? (count - 1) : sequenceMax();
+                    continue;
+                }
+
+                if (static_cast<int32_t>(tdmaCycleStart + TDMA_BEACON_DURATION - startTime) > 0)
+                    startTime = tdmaCycleStart + TDMA_BEACON_DURATION;
+            }
+        }
+
+        // The MAC timer interrupt strobes ISTXON at the exact start time and lets the uDMA fill the TX FIFO
+        lastStartTime = scheduleTransmission(startTime, packetLen);
+        lastPacketLen = packetLen;
+    #else
+        if (((delay == 0) && (profile.gap == 0) && (packetsInBurst != 1)) || waitUntil(startTime))
+        {
+            lastStartTime = readCurrentTime();
+            lastPacketLen = packetLen;
+            HWREG(RFCORE_SFR_RFST) = CC2538_RF_CSP_OP_ISTXON;
+        }
+        else
+        {
+            // The packet that was never send gets send again when the pc starts the generator again
+            HWREG(RFCORE_SFR_RFST) = CC2538_RF_CSP_OP_ISFLUSHTX;
+            count = (count > 1) ? (count - 1) : sequenceMax();
+        }
+    #endif
 #endif
     }
 }
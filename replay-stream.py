@@ -0,0 +1,268 @@
+#!/usr/bin/env python
+
+__author__ = 'Bruno Van de Velde (bruno@texus.me)'
+__license__ = 'GNU General Public License v2'
+
+import os
+import sys
+import time
+import argparse
+import collections
+import multiprocessing
+
+import sniffer
+
+
+CHUNK_BYTES = 4 * 1024 * 1024  # Bytes of the stream that a decoder process gets at once, cut behind a flag
+QUEUED_CHUNKS_PER_JOB = 2  # Chunks per decoder process that are decoded ahead of the sequential pass, which bounds the memory
+
+
+class ReplayPort:
+    """Takes the place of the serial port: every read returns the bytes of the next recorded read (or what was
+    left of it), either immediately or at the moment at which they arrived during the recording. The ACK and NACK
+    messages that the sniffer writes are only counted."""
+
+    def __init__(self, reads, realTime):
+        self.reads = reads
+        self.position = 0
+        self.pending = b''
+        self.realTime = realTime
+        self.start = time.time()
+        self.baudrate = sniffer.BAUDRATE
+        self.timeout = sniffer.SERIAL_TIMEOUT
+        self.bytesWritten = 0
+
+    def nextArrived(self):
+        if self.position >= len(self.reads):
+            return False
+        return not self.realTime or time.time() - self.start >= self.reads[self.position][0]
+
+    def inWaiting(self):
+        if len(self.pending) == 0 and self.nextArrived():
+            return len(self.reads[self.position][1])
+        return len(self.pending)
+
+    def read(self, size=1):
+        if len(self.pending) == 0:
+            # The sniffer thread stops once the whole recording was read
+            if self.position >= len(self.reads):
+                sniffer.stopSniffingThread = True
+                return b''
+
+            arrival, self.pending = self.reads[self.position]
+            self.position += 1
+            if self.realTime:
+                delay = self.start + arrival - time.time()
+                if delay > 0:
+                    time.sleep(delay)
+
+        data = self.pending[:size]
+        self.pending = self.pending[size:]
+        return data
+
+    def write(self, data):
+        self.bytesWritten += len(data)
+        return len(data)
+
+    def flushInput(self):
+        pass
+
+    def flushOutput(self):
+        pass
+
+    def flush(self):
+        pass
+
+    def close(self):
+        pass
+
+
+def loadRecording(fileName):
+    with open(fileName, 'rb') as f:
+        data = f.read()
+
+    header = len(sniffer.STREAM_MAGIC) + 8
+    if data[:len(sniffer.STREAM_MAGIC)] != sniffer.STREAM_MAGIC:
+        raise ValueError(fileName + ' was not written with --record-stream')
+
+    # A recording that was cut off while writing keeps the reads that were complete
+    reads = []
+    pos = header
+    while pos + sniffer.STREAM_RECORD.size <= len(data):
+        arrival, length = sniffer.STREAM_RECORD.unpack_from(data, pos)
+        pos += sniffer.STREAM_RECORD.size
+        if pos + length > len(data):
+            break
+        reads.append((arrival, data[pos:pos + length]))
+        pos += length
+
+    return reads
+
+
+def readStream(fileName):
+    # Yields the bytes of every recorded read, without loading the whole recording
+    with open(fileName, 'rb') as f:
+        if f.read(len(sniffer.STREAM_MAGIC) + 8)[:len(sniffer.STREAM_MAGIC)] != sniffer.STREAM_MAGIC:
+            raise ValueError(fileName + ' was not written with --record-stream')
+        while True:
+            header = f.read(sniffer.STREAM_RECORD.size)
+            if len(header) < sniffer.STREAM_RECORD.size:
+                return
+            arrival, length = sniffer.STREAM_RECORD.unpack(header)
+            data = f.read(length)
+            if len(data) < length:
+                return
+            yield data
+
+
+def streamChunks(fileName):
+    # Every flag ends or starts a message (both HDLC and COBS keep it out of the messages), so a chunk that is cut behind
+    # a flag only holds whole messages. The bytes behind the last flag go to the next chunk.
+    pending = bytearray()
+    for data in readStream(fileName):
+        pending += data
+        if len(pending) >= CHUNK_BYTES:
+            cut = pending.rfind(sniffer.HDLC_FLAG_BYTE) + 1
+            if cut > 0:
+                yield bytes(pending[:cut])
+                del pending[:cut]
+    if len(pending) > 0:
+        yield bytes(pending)
+
+
+def configureDecoder(framing, hardwareCRC):
+    sniffer.framing = framing
+    sniffer.cobsFraming = (framing == 'cobs')
+    sniffer.hardwareCRC = hardwareCRC
+
+
+def decodeChunk(chunk):
+    # Runs in a decoder process: unescapes every message between the flags and checks its serial CRC. A message that
+    # isn't valid stays in the list as an empty one, the sequential pass handles it as the receiver would.
+    return [bytes(sniffer.decode(part, quiet=True)) for part in chunk.split(sniffer.HDLC_FLAG_BYTE) if len(part) > 0]
+
+
+def replayInParallel(args, port):
+    # The messages are decoded on all cores, only the records in them go through a single PacketProcessor in the order
+    # of the stream, which puts the sequence numbers in order and leaves out the retransmitted records
+    packetProcessor = sniffer.PacketProcessor(not args.keep_bad_fcs, args.replace_fcs)
+    packetProcessor.channel = args.channel
+    pool = multiprocessing.Pool(args.jobs, initializer=configureDecoder, initargs=(args.framing, args.hardware_crc))
+    pending = collections.deque()
+    messages = 0
+    invalid = 0
+    receivedBytes = 0
+    try:
+        chunks = streamChunks(args.stream)
+        while True:
+            for chunk in chunks:
+                receivedBytes += len(chunk)
+                pending.append(pool.apply_async(decodeChunk, (chunk,)))
+                if len(pending) >= args.jobs * QUEUED_CHUNKS_PER_JOB:
+                    break
+            if len(pending) == 0:
+                break
+
+            for msg in pending.popleft().get():
+                messages += 1
+                invalid += 1 if len(msg) == 0 else 0
+                if not packetProcessor.processPacket(bytearray(msg)):
+                    # The OpenMote was reset, the recording continues with the new connection
+                    packetProcessor.resetVariables()
+    finally:
+        pool.terminate()
+        pool.join()
+    return receivedBytes, messages, invalid
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Feed a stream that sniffer.py recorded with --record-stream through its '
+                                                 'receiving code again and measure how fast it is decoded')
+    parser.add_argument('stream', help='File written by sniffer.py with --record-stream')
+    parser.add_argument('-o', '--output', help='Write the decoded frames to this pcap file instead of discarding them')
+    parser.add_argument('--real-time', action='store_true',
+                        help='Hand out the bytes at the moments they arrived during the recording instead of as fast as possible')
+    parser.add_argument('--pcapng', action='store_true', help='Write a pcapng file, as sniffer.py does when hopping or with --pcapng')
+    parser.add_argument('--keep-bad-fcs', action='store_true', help="Don't discard packets that have a bad checksum")
+    parser.add_argument('--replace-fcs', action='store_true', help='Keep the TI CC24XX FCS which contains the RSSI and LQI')
+    parser.add_argument('--hardware-crc', action='store_true', help='The stream was recorded from a SERIAL_HARDWARE_CRC build')
+    parser.add_argument('--framing', choices=sorted(sniffer.FRAMINGS.keys()), default='hdlc',
+                        help='Framing that sniffer.py asked the OpenMote for while recording (default: hdlc)')
+    parser.add_argument('--python-receiver', action='store_true',
+                        help='Process the bytes in python even when the native library in src/host was build')
+    parser.add_argument('-c', '--channel', type=int, default=11,
+                        help='Channel of the RESET message when the recording contains a reconnection')
+    parser.add_argument('-j', '--jobs', type=int, default=0,
+                        help='Decode the messages in this many processes and only put the records in order in this one, for '
+                             'large recordings (default: all in this process, like sniffer.py)')
+    args = parser.parse_args()
+
+    if args.jobs < 0 or (args.jobs > 0 and args.real_time):
+        print('The amount of jobs can not be negative, and the recording can only be replayed in real time by a single process')
+        return 1
+
+    try:
+        reads = loadRecording(args.stream) if args.jobs == 0 else []
+    except (IOError, OSError, ValueError) as e:
+        print('ERROR: Could not read the recording. Exception: ' + str(e))
+        return 1
+
+    sniffer.hardwareCRC = args.hardware_crc
+    sniffer.pcapngOutput = args.pcapng
+    sniffer.framing = args.framing
+    sniffer.cobsFraming = (args.framing == 'cobs')
+    if not args.python_receiver:
+        sniffer.hostLibrary = sniffer.loadHostLibrary()
+
+    sniffer.output = open(args.output if args.output != None else os.devnull, 'wb')
+    sniffer.outputIsFile = True
+    sniffer.outputWriter = sniffer.OutputWriter()
+    sniffer.outputGlobalHeader()
+    sniffer.outputWriter.headerWritten()
+    sniffer.outputSinks = [sniffer.CaptureSink()]
+
+    # Every frame that reaches the output is counted
+    frames = [0]
+    outputPacket = sniffer.outputPacket
+    def countPacket(*arguments, **keywords):
+        frames[0] += 1
+        outputPacket(*arguments, **keywords)
+    sniffer.outputPacket = countPacket
+
+    port = ReplayPort(reads, args.real_time)
+    sniffer.ser = port
+    sniffer.stopSniffingThread = False
+
+    wallStart = time.time()
+    cpuStart = time.process_time()
+    if args.jobs == 0:
+        sniffer.snifferThread(args.channel, not args.keep_bad_fcs, args.replace_fcs)
+    else:
+        try:
+            receivedBytes, messages, invalid = replayInParallel(args, port)
+        except (IOError, OSError, ValueError) as e:
+            print('ERROR: Could not read the recording. Exception: ' + str(e))
+            return 1
+    sniffer.outputWriter.stop()
+    cpuTime = time.process_time() - cpuStart
+    wallTime = time.time() - wallStart
+    sniffer.output.close()
+
+    if args.jobs == 0:
+        receivedBytes = sum(len(data) for arrival, data in reads)
+        duration = reads[-1][0] - reads[0][0] if len(reads) > 0 else 0
+        print('Recording:  ' + str(receivedBytes) + ' bytes in ' + str(len(reads)) + ' reads over ' + '%.1f' % duration + ' seconds')
+        print('Receiver:   ' + ('native library' if sniffer.hostLibrary != None else 'python'))
+    else:
+        print('Recording:  ' + str(receivedBytes) + ' bytes in ' + str(messages) + ' messages, ' + str(invalid) + ' of them invalid')
+        print('Receiver:   ' + str(args.jobs) + ' decoder processes')
+    print('Decoded:    ' + str(frames[0]) + ' frames, ' + str(port.bytesWritten) + ' bytes of ACK and NACK messages written')
+    print('Wall time:  ' + '%.3f' % wallTime + ' seconds, ' + '%.2f' % (receivedBytes / wallTime / 1e6 if wallTime > 0 else 0) + ' MB/s, '
+          + '%.0f' % (frames[0] / wallTime if wallTime > 0 else 0) + ' frames/s')
+    print('CPU time:   ' + '%.3f' % cpuTime + ' seconds, ' + '%.1f' % (cpuTime * 1e6 / frames[0] if frames[0] > 0 else 0)
+          + ' microseconds per frame')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,175 @@
+#!/usr/bin/env python
+
+__author__ = 'Bruno Van de Velde (bruno@texus.me)'
+__license__ = 'GNU General Public License v2'
+
+import sys
+import json
+import argparse
+
+
+CLOCK_HZ = 32000000  # The events are timed with the cycle counter of the CC2538
+
+# Events of TraceEvent in sniffer_trace.hpp
+TASK_SWITCHED_IN = 0
+TASK_BLOCKED     = 1
+TICK             = 2
+GIVEN_FROM_ISR   = 3
+RADIO_ISR_ENTER  = 4
+RADIO_ISR_EXIT   = 5
+UART_ISR_ENTER   = 6
+UART_ISR_EXIT    = 7
+RETRANSMIT       = 8
+
+TASK_NAMES = ['idle task', 'serial task']
+ISR_EVENTS = {RADIO_ISR_ENTER: ('radio interrupt', True), RADIO_ISR_EXIT: ('radio interrupt', False),
+              UART_ISR_ENTER: ('UART interrupt', True), UART_ISR_EXIT: ('UART interrupt', False)}
+ROWS = {'idle task': 1, 'serial task': 2, 'radio interrupt': 3, 'UART interrupt': 4}
+RETRANSMIT_REASONS = ['retransmit threshold', 'NACK']
+
+
+def readEvents(path):
+    # Lines of sniffer.py --rtos-trace: "cycles event argument", or "lost COUNT" where events didn't fit in the ring
+    events = []
+    with open(path) as traceFile:
+        for line in traceFile:
+            parts = line.split()
+            if len(parts) == 0 or parts[0].startswith('#'):
+                continue
+            if parts[0] == 'lost':
+                events.append((events[-1][0] if len(events) > 0 else 0, None, int(parts[1])))
+            else:
+                events.append((int(parts[0]), int(parts[1]), int(parts[2])))
+    return events
+
+
+def percentile(values, fraction):
+    if len(values) == 0:
+        return 0
+    values = sorted(values)
+    return values[min(len(values) - 1, int(fraction * len(values)))]
+
+
+class Timeline:
+    # Builds the events of the Chrome trace format, which Perfetto and chrome://tracing open. Every task and interrupt gets
+    # its own row, the interrupts are shown next to the task that they interrupted.
+    def __init__(self):
+        self.traceEvents = []
+        self.start = None
+        self.task = None  # (name, start in microseconds) of the task that is running
+        self.isrStarts = {}
+        self.wakeTime = None  # When an interrupt gave the semaphore while the serial task wasn't running
+        self.wakeLatencies = []
+        self.isrDurations = {}
+        self.serialRuns = []
+
+    def time(self, cycles):
+        if self.start == None:
+            self.start = cycles
+        return (cycles - self.start) * 1000000.0 / CLOCK_HZ
+
+    def slice(self, name, begin, end, args=None):
+        event = {'name': name, 'ph': 'X', 'ts': begin, 'dur': max(end - begin, 0), 'pid': 1, 'tid': ROWS[name]}
+        if args != None:
+            event['args'] = args
+        self.traceEvents.append(event)
+
+    def instant(self, name, timestamp, row, args=None):
+        event = {'name': name, 'ph': 'i', 's': 't', 'ts': timestamp, 'pid': 1, 'tid': row}
+        if args != None:
+            event['args'] = args
+        self.traceEvents.append(event)
+
+    def add(self, cycles, event, arg):
+        now = self.time(cycles)
+        if event == None:
+            # The ring was full, so the gap before this point is missing events and a slice around it can't be trusted
+            self.instant('%d events lost' % arg, now, ROWS['serial task'])
+            self.task = None
+            self.isrStarts = {}
+            self.wakeTime = None
+        elif event == TASK_SWITCHED_IN:
+            name = TASK_NAMES[arg] if arg < len(TASK_NAMES) else 'task ' + str(arg)
+            if name not in ROWS:
+                ROWS[name] = len(ROWS) + 1
+            if self.task != None:
+                self.slice(self.task[0], self.task[1], now)
+                if self.task[0] == 'serial task':
+                    self.serialRuns.append(now - self.task[1])
+            if name == 'serial task' and self.wakeTime != None:
+                self.wakeLatencies.append(now - self.wakeTime)
+                self.wakeTime = None
+            self.task = (name, now)
+        elif event in ISR_EVENTS:
+            name, entering = ISR_EVENTS[event]
+            if entering:
+                self.isrStarts[name] = now
+            elif name in self.isrStarts:
+                begin = self.isrStarts.pop(name)
+                self.slice(name, begin, now)
+                self.isrDurations.setdefault(name, []).append(now - begin)
+        elif event == GIVEN_FROM_ISR:
+            if (self.task == None or self.task[0] != 'serial task') and self.wakeTime == None:
+                self.wakeTime = now
+        elif event == TASK_BLOCKED:
+            self.instant('blocked', now, ROWS[self.task[0]] if self.task != None else ROWS['serial task'])
+        elif event == TICK:
+            self.instant('tick', now, ROWS['idle task'])
+        elif event == RETRANSMIT:
+            self.instant('retransmit', now, ROWS['serial task'],
+                         {'reason': RETRANSMIT_REASONS[arg] if arg < len(RETRANSMIT_REASONS) else str(arg)})
+
+    def finish(self, cycles):
+        if self.task != None:
+            self.slice(self.task[0], self.task[1], self.time(cycles))
+
+        for name, row in ROWS.items():
+            self.traceEvents.append({'name': 'thread_name', 'ph': 'M', 'pid': 1, 'tid': row, 'args': {'name': name}})
+            self.traceEvents.append({'name': 'thread_sort_index', 'ph': 'M', 'pid': 1, 'tid': row, 'args': {'sort_index': row}})
+        self.traceEvents.append({'name': 'process_name', 'ph': 'M', 'pid': 1, 'args': {'name': 'OpenMote sniffer'}})
+
+    def printSummary(self):
+        # How long the serial task had to wait after an interrupt woke it up shows the scheduling stalls
+        print('%-28s %8s %10s %10s %10s' % ('', 'Count', 'p50 (us)', 'p99 (us)', 'max (us)'))
+        rows = [('serial task wake-up', self.wakeLatencies), ('serial task runs', self.serialRuns)]
+        rows += sorted(self.isrDurations.items())
+        for name, values in rows:
+            print('%-28s %8d %10.1f %10.1f %10.1f' % (name, len(values), percentile(values, 0.5), percentile(values, 0.99),
+                                                     max(values) if len(values) > 0 else 0))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Turn the events that sniffer.py stored with --rtos-trace into a timeline '
+                                                 'for Perfetto (ui.perfetto.dev) or chrome://tracing')
+    parser.add_argument('trace', help='File written by sniffer.py --rtos-trace')
+    parser.add_argument('-o', '--output', help='Write the timeline to this JSON file (default: the trace file with .json behind it)')
+    parser.add_argument('--quiet', action='store_true', help="Don't print the wake-up latencies and interrupt durations")
+    args = parser.parse_args()
+
+    try:
+        events = readEvents(args.trace)
+    except (IOError, OSError, ValueError, IndexError) as e:
+        sys.stderr.write('ERROR: Could not read the trace. Exception: ' + str(e) + '\n')
+        return 1
+
+    if len(events) == 0:
+        sys.stderr.write('ERROR: The trace contains no events\n')
+        return 1
+
+    timeline = Timeline()
+    for cycles, event, arg in events:
+        timeline.add(cycles, event, arg)
+    timeline.finish(events[-1][0])
+
+    outputPath = args.output if args.output != None else args.trace + '.json'
+    with open(outputPath, 'w') as output:
+        json.dump({'traceEvents': timeline.traceEvents, 'displayTimeUnit': 'ns'}, output)
+
+    if not args.quiet:
+        timeline.printSummary()
+        print('Timeline written to ' + outputPath)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -13,6 +13,20 @@ import platform
 import threading
 import argparse
 import errno
+import struct
+import socket
+import select
+import hashlib
+import hmac
+import ctypes
+import binascii
+import collections
+import json
+import signal
+import mmap
+import array
+import zlib
+import re
 
 platform = platform.system()
 if platform != 'Windows' and platform != 'Linux' and platform != 'Darwin':
@@ -22,6 +36,9 @@ if platform == 'Windows':
     from win32process import DETACHED_PROCESS
     import win32pipe
     import win32file
+    import win32event
+    import winerror
+    import pywintypes
 
     if (sys.version_info > (3, 0)):
         import winreg
@@ -30,21 +47,78 @@ if platform == 'Windows':
 
 if (sys.version_info > (3, 0)):
     INPUT = input
+    from http.server import BaseHTTPRequestHandler, HTTPServer
 else:
     INPUT = raw_input
+    from BaseHTTPServer import BaseHTTPRequestHandler, HTTPServer
 
 
-BAUDRATE          = 921600
-ACK_THRESHOLD     = 300
+BAUDRATE          = 921600  # Baudrate at which the OpenMote starts, a faster one can be negotiated afterwards
+BAUDRATE_CANDIDATES = [4000000, 3000000, 2000000, 1500000, 1000000]  # Tried from fast to slow with --baudrate max
+BAUDRATE_PATTERN  = [0x55, 0xAA, 0x7E, 0x7D]  # Send along with the baudrate, to detect the other side using a different baudrate
+BAUDRATE_VERIFY_TIMEOUT = 1  # Seconds after which the OpenMote returns to BAUDRATE when the new baudrate wasn't confirmed
+ACK_THRESHOLD     = 300  # Default amount of bytes after which an ACK is send, the OpenMote confirms the value in use
+MAX_OUT_OF_ORDER_PACKETS = 500
+CUMULATIVE_ACK_MISSING_RANGE = 32  # Packets behind the acknowledged one that the bitmap of a cumulative ACK covers
 SERIAL_TIMEOUT    = 0.3
+ACK_DELAY         = 0.005  # Default seconds after which received bytes are acknowledged when the ACK threshold wasn't reached
+ACK_REQUEST_DELAY = 0.05  # Shortest ACK delay when the OpenMote asks for the ACKs, it only needs them when its buffer fills up
+ACK_INTERVAL_ON_REQUEST = 0x8000  # Set in the ACK interval of RESET, SURVEY and READY when the records ask for the ACKs
+ACK_REQUESTED     = 0x80  # Set in the type of a Packet, PacketBatch or Survey message when the OpenMote wants an ACK
+CONNECT_RETRY_INTERVAL = 0.1  # Seconds to wait for the answer to a RESET or RESUME before sending it again
+CONNECT_ATTEMPTS  = 30
+CONNECT_POLL_INTERVAL = 0.002  # Seconds between checking whether bytes arrived while waiting for an answer
+RESUME_ATTEMPTS   = 3  # The OpenMote always answers a RESUME, only a lost message or answer makes it necessary to try again
+REOPEN_TIMEOUT    = 5  # Seconds during which the serial port is opened again after it disappeared
+HOTPLUG_POLL_INTERVAL = 0.1  # Seconds between looking for the serial port of the OpenMote with --hotplug while it is gone
+HOTPLUG_BOOT_TIME = 5  # Seconds during which a new serial port is asked again when it doesn't answer, an OpenMote may still be booting
+BOND_POLL_INTERVAL = 0.001  # Seconds between looking at both lanes with --bond-port when neither had bytes
+BOND_REORDER_TIMEOUT = 0.03  # Seconds that a record of one lane waits at most for the earlier records of the other lane
+LOW_LATENCY_TIMER = 1  # Milliseconds that an FTDI chip buffers received bytes with --low-latency, instead of its default 16
+LOW_LATENCY_PRIORITY = 50  # SCHED_FIFO priority of the sniffer thread with --low-latency
+SERIAL_RX_BUFFER_SIZE = 1024 * 1024  # Receive buffer of the serial driver, where the driver allows it
+ROUND_TRIP_PROBE_INTERVAL = 1  # Seconds between round-trip time measurements with --low-latency
+ROUND_TRIP_PROBE_TIMEOUT  = 1  # Seconds after which an unanswered measurement is given up
+ROUND_TRIP_PERCENTILES = [50, 90, 99]
+LINK_MONITOR_INTERVAL = 1  # Seconds over which the utilisation of the serial link is measured
+LINK_SATURATED = 0.8  # Utilisation above which the link is assumed to limit how fast the frames reach the host
+LINK_WARNING_TIME = 30  # A warning is printed when the buffer of the OpenMote is estimated to overflow within this many seconds
+DEFAULT_MOTE_BUFFER_SIZE = 24000  # Buffer of firmware that doesn't report its size in the READY message
 
 INDEX_OFFSET      = 2
 SEQ_NR_OFFSET     = 4
-DATA_OFFSET       = 6
+TIMESTAMP_OFFSET  = 6
+ORIGINAL_LENGTH_OFFSET = 10
+CHANNEL_OFFSET    = 11
+DATA_OFFSET       = 12
+CHANNEL_DECRYPTED = 0x80  # Set in the channel byte when the OpenMote decrypted the frame
+CHANNEL_DUPLICATE = 0x40  # Set in the channel byte when the record only refers to an earlier frame with the same contents
+CHANNEL_COMPRESSED = 0x20  # Set in the channel byte when the MAC header is send as its difference with an earlier one
+ORIGINAL_LENGTH_DESCRIPTOR = 0x80  # Set in the original length when a descriptor of the frame follows the RSSI and CRC/LQI bytes
+RECORD_TYPE_TELEMETRY = 0  # Channel byte of a record without a frame (original length 0) is its type
+RECORD_TYPE_PPS = 1
+RECORD_TYPE_TIMEBASE = 2
+RECORD_TYPE_FIRST_CHANNEL = 11  # The types of the channel markers are the channel to which the OpenMote switched
+RECORD_TYPE_LAST_CHANNEL = 26
+DESCRIPTOR_LENGTH = 2
+PADDING_OFFSET    = 12  # With CAPABILITY_ALIGNED_RECORDS the amount of padding behind the record is stored in front of the data
+RECORD_ALIGNMENT  = 4
 
 HDLC_FLAG        = 0x7E
 HDLC_ESCAPE      = 0x7D
 HDLC_ESCAPE_MASK = 0x20
+HDLC_FLAG_BYTE   = bytes(bytearray([HDLC_FLAG]))
+HDLC_ESCAPE_BYTE = bytes(bytearray([HDLC_ESCAPE]))
+
+# With COBS framing every byte between the flags is XORed with the flag, the code bytes tell where the zeros were
+COBS_XOR_TABLE     = bytes(bytearray(i ^ HDLC_FLAG for i in range(256)))
+COBS_MAX_BLOCK_LEN = 0xFF
+FRAMINGS = {'hdlc': 0, 'cobs': 1}
+BATCHING_MODES = {'latency': 0, 'throughput': 1}
+BATCH_THRESHOLD = 512  # Default bytes that the records wait for in throughput mode
+BATCH_HOLD_TIME = 20   # Default milliseconds that a record waits at most in throughput mode
+BATCH_MAX_THRESHOLD = 2048
+BATCH_MAX_HOLD_TIME = 250  # Below SERIAL_TIMEOUT, so that holding back the records doesn't look like a lost connection
 
 class SerialDataType:
     Packet = 1
@@ -53,28 +127,908 @@ class SerialDataType:
     Reset  = 4
     Ready  = 5
     Stop   = 6
+    PacketBatch = 7
+    SelectiveNack = 8
+    Filter = 9
+    FilterStats = 10
+    SnapLength = 11
+    Hop = 12
+    Survey = 13
+    Stats = 14
+    FlashLog = 15
+    Baudrate = 16
+    Zep = 17
+    Key = 18
+    Integrity = 19
+    Sync = 20
+    Overflow = 21
+    Duplicates = 22
+    Compression = 23
+    Resume = 24
+    SetChannel = 25
+    Framing = 26
+    Summary = 27
+    TopTalkers = 28
+    Descriptor = 29
+    Trigger = 30
+    Epoch = 31
+    Recovery = 32
+    Tsch = 33
+    Inject = 34
+    Telemetry = 35
+    CumulativeAck = 36
+    FcsFilter = 37
+    Degradation = 38
+    FilterProgram = 39
+    Control = 40
+    Batching = 41
+    Pause = 42
+    Lanes = 43
+    Autostart = 44
+    Superframe = 45
+    AdaptiveHop = 46
+    Latency = 47
+    Trace = 48
+    Pps = 49
+    Timebase = 50
+    Fec = 51
+    Identify = 52
+    Encryption = 53
+
+
+# Bits in the capabilities of the READY message, for the optional messages that the firmware understands
+CAPABILITY_FILTER          = 1 << 0
+CAPABILITY_SNAP_LENGTH     = 1 << 1
+CAPABILITY_HOPPING         = 1 << 2
+CAPABILITY_SURVEY          = 1 << 3
+CAPABILITY_STATS           = 1 << 4
+CAPABILITY_FLASH_LOG       = 1 << 5
+CAPABILITY_BAUDRATE        = 1 << 6
+CAPABILITY_ZEP             = 1 << 7
+CAPABILITY_DECRYPTION      = 1 << 8
+CAPABILITY_INTEGRITY       = 1 << 9
+CAPABILITY_SYNC            = 1 << 10
+CAPABILITY_OVERFLOW_POLICY = 1 << 11
+CAPABILITY_DUPLICATES      = 1 << 12
+CAPABILITY_COMPRESSION     = 1 << 13
+CAPABILITY_RESUME          = 1 << 14
+CAPABILITY_SET_CHANNEL     = 1 << 15
+CAPABILITY_HARDWARE_CRC    = 1 << 16
+CAPABILITY_PROFILING       = 1 << 17
+CAPABILITY_COBS            = 1 << 18
+CAPABILITY_SUMMARY         = 1 << 19
+CAPABILITY_DESCRIPTOR      = 1 << 20
+CAPABILITY_TRIGGER         = 1 << 21
+CAPABILITY_EPOCH           = 1 << 22
+CAPABILITY_RECORD_INDEX    = 1 << 23  # The index in an ACK, NACK or RESUME may be unknown, the record is found by its sequence number
+CAPABILITY_RECOVERY        = 1 << 24
+CAPABILITY_TSCH            = 1 << 25
+CAPABILITY_INJECT          = 1 << 26
+CAPABILITY_TELEMETRY       = 1 << 27
+CAPABILITY_CUMULATIVE_ACK  = 1 << 28  # Missing packets are asked for with a cumulative ACK instead of a selective NACK
+CAPABILITY_FCS_FILTER      = 1 << 29
+CAPABILITY_ADAPTIVE_OVERFLOW = 1 << 30
+CAPABILITY_ALIGNED_RECORDS = 1 << 31  # The records are padded to whole words, see removeRecordPadding
+
+# The bits of the second capabilities word of the READY message follow behind those of the first one
+CAPABILITY_FILTER_PROGRAM  = 1 << 32
+CAPABILITY_CONTROL         = 1 << 33
+CAPABILITY_ACK_REQUEST     = 1 << 34
+CAPABILITY_BATCHING        = 1 << 35
+CAPABILITY_PAUSE           = 1 << 36
+CAPABILITY_LANES           = 1 << 37
+CAPABILITY_AUTOSTART       = 1 << 38
+CAPABILITY_SUPERFRAME      = 1 << 39
+CAPABILITY_ADAPTIVE_HOP    = 1 << 40
+CAPABILITY_TRACE           = 1 << 41
+CAPABILITY_PPS             = 1 << 42
+CAPABILITY_TIMEBASE        = 1 << 43
+CAPABILITY_FEC             = 1 << 44
+CAPABILITY_IDENTIFY        = 1 << 45
+CAPABILITY_ENCRYPTION      = 1 << 46
+
+# The firmware images with a reduced capture path (make CAPTURE=filter or CAPTURE=basic) leave out these capabilities,
+# the first image in this list that has a capability is the one that should be flashed for it
+CAPTURE_FILTER_CAPABILITIES = (CAPABILITY_FILTER | CAPABILITY_SNAP_LENGTH | CAPABILITY_OVERFLOW_POLICY | CAPABILITY_FCS_FILTER
+                               | CAPABILITY_ADAPTIVE_OVERFLOW | CAPABILITY_FILTER_PROGRAM)
+CAPTURE_FULL_CAPABILITIES   = (CAPTURE_FILTER_CAPABILITIES | CAPABILITY_DUPLICATES | CAPABILITY_COMPRESSION | CAPABILITY_DESCRIPTOR
+                               | CAPABILITY_SUMMARY | CAPABILITY_TRIGGER | CAPABILITY_TSCH | CAPABILITY_SUPERFRAME)
+CAPTURE_IMAGES = [('OpenMoteSniffer-filter.hex', CAPTURE_FILTER_CAPABILITIES), ('OpenMoteSniffer.hex', CAPTURE_FULL_CAPABILITIES)]
+
+# Firmware with a READY message without capabilities is assumed to understand the messages that are older than them
+LEGACY_CAPABILITIES = (CAPABILITY_FILTER | CAPABILITY_SNAP_LENGTH | CAPABILITY_HOPPING | CAPABILITY_SURVEY | CAPABILITY_STATS
+                       | CAPABILITY_FLASH_LOG | CAPABILITY_BAUDRATE | CAPABILITY_ZEP | CAPABILITY_DECRYPTION
+                       | CAPABILITY_INTEGRITY | CAPABILITY_SYNC)
+READY_EXTENDED_LENGTH = 23  # Type and length bytes, the version with the capabilities and parameters, and the crc
+READY_EPOCH_OFFSET    = 21  # Epoch of the sequence numbers behind the parameters, when the OpenMote has CAPABILITY_EPOCH
+READY_MORE_CAPABILITIES_OFFSET = 25  # Second capabilities word behind the epoch
+TIMESTAMP_TICK_RATE   = 1000000  # Timestamps are in microseconds unless the READY message tells otherwise
+
+FILTER_MAX_RULES        = 8
+FILTER_MATCH_FRAME_TYPE = 1 << 0
+FILTER_MATCH_DST_PAN    = 1 << 1
+FILTER_MATCH_SRC_PAN    = 1 << 2
+FILTER_MATCH_DST_ADDR   = 1 << 3
+FILTER_MATCH_SRC_ADDR   = 1 << 4
+FRAME_TYPES = {'beacon': 0, 'data': 1, 'ack': 2, 'cmd': 3}
+
+FILTER_PROGRAM_MAX_INSTRUCTIONS = 48
+FILTER_OP_RET        = 0
+FILTER_OP_LD_BYTE    = 1
+FILTER_OP_LD_HALF    = 2  # Big endian
+FILTER_OP_LD_HALF_LE = 3
+FILTER_OP_LD_LENGTH  = 4
+FILTER_OP_AND        = 5
+FILTER_OP_JEQ        = 6
+FILTER_OP_JGT        = 7
+FILTER_OP_JGE        = 8
+FILTER_OP_JSET       = 9
+FILTER_OP_PAYLOAD    = 0x80  # The offset of a load counts from the start of the MAC payload
+
+SERIAL_RX_MAX_MESSAGE_LEN = 136  # Longest message that the OpenMote can receive at once, longer ones are send with CONTROL
+CONTROL_CHUNK_LEN      = 64   # Bytes of the message per CONTROL message, even when every byte is escaped it fits in the RX buffer
+CONTROL_ATTEMPTS       = 5    # Times that a chunk is send before giving up on the answer
+CONTROL_TIMEOUT        = 0.1  # Seconds to wait for the answer to a chunk
+CONTROL_STATUS_PENDING  = 0
+CONTROL_STATUS_ACCEPTED = 1
+CONTROL_STATUS_REJECTED = 2
+CONTROL_STATUS_RESEND   = 3
+
+TRIGGER_MAX_PATTERN_LEN  = 8
+TRIGGER_MATCH_FRAME_TYPE = 1 << 0
+TRIGGER_MATCH_DST_ADDR   = 1 << 1
+TRIGGER_MATCH_SRC_ADDR   = 1 << 2
+TRIGGER_MATCH_PATTERN    = 1 << 3
+TRIGGER_REPORT_LENGTH    = 12  # Acked index and sequence number, sequence number of the trigger, frames before it and discarded records
+
+EPOCH_REPORT_LENGTH = 8  # Epoch and the full 32-bit sequence number of a record that was send
+
+OVERFLOW_POLICIES = {'drop-new': 0, 'keep-headers': 1, 'prefer-control': 2, 'adaptive': 3}
+OVERFLOW_POLICY_ADAPTIVE = 3
+DEGRADATION_REPORT_LENGTH = 5  # New level, sequence number of the first record at that level and the bytes in the buffer
+DEGRADATION_LEVELS = ['entire frames', 'MAC headers only', 'MAC headers only without ACK frames',
+                      'frame control and sequence number only without ACK frames']
+
+# What the OpenMote parsed from the frame control field, the header length covers the addressing fields and is 0 when unknown
+FrameDescriptor = collections.namedtuple('FrameDescriptor', ['frameType', 'securityEnabled', 'dstAddrMode', 'srcAddrMode',
+                                                             'headerLength', 'frameVersion', 'panIdCompression'])
+
+DUPLICATE_MAX_DISTANCE = 64  # A reference or compressed header never points further back than this amount of records
+
+DECRYPTION_MAX_KEYS         = 8
+DECRYPTION_MATCH_PAN        = 1 << 0
+DECRYPTION_MATCH_SHORT_ADDR = 1 << 1
+DECRYPTION_MATCH_EXT_ADDR   = 1 << 2
+
+INTEGRITY_KEY_LEN          = 32
+INTEGRITY_HISTORY_LEN      = 4096  # Hashes of the last records are remembered for checkpoints that arrive late
+DEFAULT_CHECKPOINT_INTERVAL = 1000
+
+ENCRYPTION_KEY_LEN         = 16
+ENCRYPTION_NONCE_LEN       = 4    # Random for every run, the OpenMote adds its epoch and the sequence number of the record
+ENCRYPTION_KEY_AREA        = DECRYPTION_MAX_KEYS - 1  # Area of the key store that the encryption key takes from the decryption keys
+
+HOP_MAX_CHANNELS  = 16
+HOP_TIME_UNIT     = 1024  # Dwell times are send in steps of 1024 microseconds
+ADAPTIVE_HOP_ENTRY_LENGTH = 6  # Channel, dwell time, frames per second in steps of 1/16 and RSSI
+
+TSCH_MAX_SEQUENCE_LEN           = 16
+TSCH_CHANNEL_OFFSET_FROM_BEACON = 0xff
+TSCH_ANY_PAN                    = 0xffff
+TSCH_REPORT_LENGTH              = 14  # Locked, ASN, start time of that timeslot, channel offset, sequence length and timeslot length
+SUPERFRAME_ANY_PAN              = 0xffff
+SUPERFRAME_REPORT_LENGTH        = 9  # Locked, beacon order, superframe order, PAN and start time of the superframe
+SUPERFRAME_BASE_DURATION        = 15360  # Microseconds of a superframe with order 0
+DEFAULT_SUPERFRAME_GUARD_TIME   = 2000  # Microseconds that the radio is turned on before the beacon and left on after the active portion
+
+INJECT_FLAG_ABSOLUTE       = 1 << 0
+INJECT_FLAG_CCA            = 1 << 1
+INJECT_FLAG_TIMELINE       = 1 << 2  # Relative times count from when the previous frame should have started, older firmware ignores it
+INJECT_STATUS_QUEUED       = 0
+INJECT_STATUS_SENT         = 1
+INJECT_STATUS_BUSY         = 2
+INJECT_STATUS_REJECTED     = 3
+INJECT_STATUS_UNAVAILABLE  = 4
+INJECT_REPORT_LENGTH       = 10   # Id, status, free places in the queue, id that is expected next and the time of the SFD
+INJECT_MAX_FRAME_LEN       = 125  # Frame without the FCS, which the radio adds
+INJECT_MAX_UNCONFIRMED_BYTES = 192  # The OpenMote only has room for 256 bytes of messages that its serial task didn't read yet
+INJECT_MAX_MESSAGE_BYTES   = 240  # Encoded INJECT message that is send on its own
+INJECT_RETRY_TIMEOUT       = 0.2  # Seconds without a report before the frames that weren't queued are send again
+
+TELEMETRY_MAX_INTERVAL     = 3600
+TELEMETRY_RECORD_LENGTH    = 13   # Sensor bits, temperature, humidity, light and the acceleration on 3 axes
+TELEMETRY_SENSOR_SHT21     = 1 << 0
+TELEMETRY_SENSOR_MAX44009  = 1 << 1
+TELEMETRY_SENSOR_ADXL346   = 1 << 2
+TELEMETRY_ACCELERATION_UNIT = 0.0039  # g per step of the ADXL346 in full resolution
+PPS_RECORD_LENGTH          = 4    # Number of the pulse since the PPS input was enabled
+TIMEBASE_RECORD_LENGTH     = 8    # Full 64-bit time of the OpenMote, of which the timestamp of the record is the lower half
+FEC_MAX_GROUP_SIZE         = 16   # Packets with records that are protected by one FEC message at most
+IDENTIFY_ANSWER_LENGTH     = 8    # Type and length bytes and the EUI-48 of the OpenMote
+IDENTIFY_EUI_OFFSET        = 2
+
+SURVEY_HISTOGRAM_MIN   = -100 # RSSI values (in dBm) below this value are counted in the lowest bin
+SURVEY_HISTOGRAM_STEP  = 10
+SURVEY_HISTOGRAM_BINS  = 8
+SURVEY_BUSY_THRESHOLD  = -75  # A sample with at least this RSSI (in dBm) counts as the channel being occupied
+
+SUMMARY_MAX_INTERVAL  = 20000  # Milliseconds, the frame counters of a link on the OpenMote are 16-bit
+SUMMARY_KEY_LENGTH    = 19  # Frame type and addressing modes, PAN, destination address and source address
+SUMMARY_HEADER_LENGTH = 6
+SUMMARY_LINK_LENGTH   = 29
+SUMMARY_RATE_BINS     = 8  # Bins of the histogram of the frames per second over all intervals
+TOP_TALKERS_KEY_LENGTH   = 11  # Address mode, PAN and address of the source
+TOP_TALKERS_ENTRY_LENGTH = 13
+TOP_TALKERS_PRINTED      = 10  # Sources listed when stopping
+NODE_STATS_WINDOW        = 10    # Default seconds of an ageing window of the statistics per node
+NODE_STATS_IDLE_WINDOWS  = 6     # Windows without frames after which a node is removed from the table
+NODE_STATS_MAX_NODES     = 4096  # Nodes in the table at most, the frames of other sources are only counted in total
+NODE_STATS_PRINTED       = 10    # Busiest nodes listed in the table that is printed every window
+NODE_STATS_METRICS       = 100   # Busiest nodes on the metrics endpoint, to keep the amount of series bounded
+
+STATS_NAMES = ['frames received', 'dropped (buffer full)', 'RX FIFO flushes', 'invalid lengths',
+               'NACKs', 'retransmitted bytes', 'buffer peak', 'truncated (overflow policy)', 'dropped beacons',
+               'dropped data', 'dropped ACKs', 'dropped commands', 'dropped other', 'duplicates replaced',
+               'bytes saved by compression', 'UART RX overruns', 'dropped (bad FCS)', 'bytes unused at buffer end',
+               'buffer occupancy', 'times held back (throughput mode)', 'microseconds held back', 'longest hold (us)']
+PROFILING_SECTIONS  = ['radio interrupt', 'HDLC encode', 'serial receive']
+PROFILING_HISTOGRAM_BINS = 8
+PROFILING_FIRST_BIN_BITS = 6
+LATENCY_POINTS = ['interrupt', 'copied', 'receiver ready']
+LATENCY_LENGTH_CLASSES = 4  # Frames of up to 31, 63, 95 and 127 bytes
+LATENCY_HISTOGRAM_BINS = 6
+LATENCY_FIRST_BIN_BITS = 4
+RTOS_TRACE_CLOCK_HZ = 32000000  # The events of the trace recorder are timed with the cycle counter
+RTOS_TRACE_EVENT_LENGTH = 6
+FLASH_LOG_ENABLE = 1
+FLASH_LOG_DUMP   = 2
+FLASH_LOG_ERASE  = 3
+FLASH_LOG_TIMEOUT = 5  # Seconds to wait for the next part of the log
+FLASH_LOG_ERASE_TIMEOUT = 300  # Seconds to wait for the erase, which takes a few seconds but up to minutes for a large SPI flash
+
+# Commands of the AUTOSTART message
+AUTOSTART_CLEAR  = 0
+AUTOSTART_SAVE   = 1
+AUTOSTART_ATTACH = 2
+RECOVERY_TIMEOUT  = 0.2  # Seconds to wait for the records that survived a reset, older firmware never answers
+PCAPNG_CUSTOM_BLOCK = 0x40000BAD  # Custom block that shouldn't be copied when editing the file
+PCAPNG_CUSTOM_COPY_BLOCK = 0x00000BAD  # Custom block that may be copied, the telemetry doesn't depend on the frames around it
+PCAPNG_CUSTOM_PEN   = 32473       # Private Enterprise Number reserved for documentation, as the sniffer has none of its own
+ETHERNET_ETHERTYPE   = 0x809A  # EtherType of the frames when the firmware was build with SNIFFER_ETHERNET
+ETHERNET_HEADER_LEN  = 16      # Addresses, EtherType and the length of the data
+ETHERNET_MAX_DATA_LEN = 1498
+SPI_BURST_LEN        = 512     # Bytes in every transfer when the firmware was build with SNIFFER_SPI_SLAVE, in both directions
+SPI_CLOCK            = 2000000 # The OpenMote can follow at most a twelfth of its 32 MHz clock as a slave
+SPI_MODE             = 1       # Keeps the chip select low for the whole burst
+SPI_POLL_INTERVAL    = 0.0005  # Seconds between looking at the data ready line while it is low
+SPI_IDLE_INTERVAL    = 0.005   # Seconds between the bursts without a data ready line, once a burst came back empty
+SPI_FLAG_RUNS        = re.compile(b'(\x7e+)')  # Splits a burst in runs of flags (HDLC_FLAG) and the bytes between them
+ZEP_PORT             = 17754   # Port on which Wireshark recognizes ZEP packets
+STREAM_MAGIC         = b'OMSTREAM'  # Start of a file written with --record-stream, followed by the time at which it started
+STREAM_RECORD        = struct.Struct('<dI')  # Seconds since the start of the recording and length of the bytes of a read
+ENCRYPTED_MAGIC      = b'OMCRYPT1'  # Start of a file written with --encrypt-key, followed by blocks with a type and length
+ENCRYPTED_BLOCK      = struct.Struct('<BH')
+ENCRYPTED_BLOCK_SESSION = 1  # In front of the first record of every epoch: nonce, epoch, host time in microseconds, tick rate and flags
+ENCRYPTED_BLOCK_RECORD  = 2  # Full sequence number and the record as it arrived from the index on, still encrypted
+ENCRYPTED_SESSION    = struct.Struct('<4sIqIB')
+ENCRYPTED_SESSION_ALIGNED = 1 << 0  # The records still contain the padding of CAPABILITY_ALIGNED_RECORDS
+OUTPUT_QUEUE_MAX_BYTES = 32 * 1024 * 1024  # Frames are dropped when this much is waiting for a slow Wireshark or disk
+OUTPUT_PAUSE_BYTES     = 8 * 1024 * 1024  # The OpenMote is asked to pause sending frames when this much is waiting
+OUTPUT_RESUME_BYTES    = 2 * 1024 * 1024  # and to continue once the output caught up to this
+PAUSE_REPEAT_INTERVAL  = 0.25  # Seconds between repeating the pause, the OpenMote continues by itself after a second without it
+LIVE_VIEW_MAX_RATE     = 200  # Frames per second that Wireshark gets by default when it only shows a live view of the capture file
+LIVE_VIEW_QUEUE_MAX_BYTES = 1024 * 1024  # The live view drops frames sooner than the file, it only has to show what is happening now
+FRAME_BATCH_MAX_FRAMES = 1024  # Frames in a FrameBatch that is handed to a program that uses the Sniffer class
+FRAME_BATCH_MAX_BYTES  = 128 * 1024  # Bytes of the frames in a FrameBatch
+FRAME_BATCH_MAX_DELAY  = 0.1  # Seconds that the first frame of a batch waits for the batch to fill up
+FRAME_BATCHES          = 4  # Batches that are reused, frames are dropped when the program still holds all of them
+SINK_BATCH_FRAMES      = 256  # Frames that a SinkWorker hands to its thread at once, unless the first one waited OUTPUT_FLUSH_INTERVAL
+SINK_MAX_FRAMES        = 100000  # Frames waiting for a SinkWorker before the new ones are dropped for that sink
+REMOTE_PORT            = 17755  # TCP port of collector.py, which gathers the frames of the sniffers at all sites
+REMOTE_MAGIC           = b'OMRC'
+REMOTE_VERSION         = 1
+REMOTE_BLOCK_HEADER    = struct.Struct('>BBI')  # Type, flags and length of the payload behind it
+REMOTE_HELLO           = struct.Struct('>4sBQ')  # Magic, version and session, followed by the name of the site
+REMOTE_INDEX           = struct.Struct('>Q')  # Index of the next frame that the collector expects, in RESUME and ACK
+REMOTE_RECORDS         = struct.Struct('>QI')  # Index of the first frame and amount of frames, followed by the frames
+REMOTE_RECORD          = struct.Struct('>qqHBbBBB')  # Packet identifier, timestamp, original length, channel, RSSI, LQI, flags, length
+REMOTE_BLOCK_HELLO     = 1
+REMOTE_BLOCK_RESUME    = 2
+REMOTE_BLOCK_RECORDS   = 3
+REMOTE_BLOCK_ACK       = 4
+REMOTE_FLAG_COMPRESSED = 0x01  # The payload of the block was compressed with zlib
+REMOTE_RECORD_FCS_INCLUDED = 0x01
+REMOTE_RECORD_CRC_ERROR    = 0x02
+REMOTE_RECORD_PACKET_ID    = 0x04
+REMOTE_MAX_BLOCK_LEN   = 16 * 1024 * 1024  # Longer blocks are taken for a broken connection
+REMOTE_BLOCK_MAX_RECORDS = 1000  # Frames in a block, a block is also send when fewer frames arrived within REMOTE_BLOCK_INTERVAL
+REMOTE_BLOCK_INTERVAL  = 0.1  # Seconds between looking for new frames and answers of the collector
+REMOTE_MAX_RETAINED_BYTES = 64 * 1024 * 1024  # Frames that the collector didn't acknowledge yet, new frames are dropped above this
+REMOTE_TIMEOUT         = 30  # Seconds without an answer of the collector before connecting again
+REMOTE_RETRY_INTERVAL  = 5  # Seconds between the attempts to connect to the collector
+REMOTE_CLOSE_TIMEOUT   = 10  # Seconds that stopping the sniffer waits for the collector to acknowledge the last frames
+OUTPUT_WRITE_MAX_BYTES = 65536  # Blocks are combined in writes up to this size, which is the pipe buffer on Linux
+PIPE_BUFFER_SIZE       = 1024 * 1024  # Buffer of the named pipe on Windows, which holds several writes while Wireshark is busy
+PIPE_WAIT_INTERVAL     = 100    # Milliseconds between checking for CTRL+C while waiting for the named pipe on Windows
+OUTPUT_FLUSH_INTERVAL  = 0.1    # Seconds that a block waits at most for more blocks before it is written
+ROTATION_INDEX_INTERVAL = 1000  # The index next to a rotated file has the offset of every this many packets
+COMPRESSION_EXTENSIONS = {'gzip': '.gz', 'zstd': '.zst', 'lz4': '.lz4'}  # Added behind the name of a compressed output file
+COMPRESSION_FRAME_MAX_BYTES = 4 * 1024 * 1024  # Uncompressed bytes after which a compressed frame is ended, besides at every index entry
+COMPRESSION_FRAME_INTERVAL = 10  # Seconds after which the next write ends the compressed frame, so a quiet channel still reaches the disk
+BLOCK_WRITE_SIZE       = 1024   # KB in a write of --block-writes when no size is given
+BLOCK_WRITE_PREALLOCATE = 64 * 1024 * 1024  # Bytes that are allocated ahead of the writes, unless the rotation size tells the size of the file
+BLOCK_WRITE_SYNC_INTERVAL = 5   # Seconds between the syncs of the written blocks to the disk
+BLOCK_WRITE_LATENCY_SAMPLES = 1000  # Latest writes and syncs over which the percentiles are calculated
+FALLOC_FL_KEEP_SIZE    = 0x01   # Allocate the space behind the end of the file without changing its size
+PCAP_RECORD_HEADER     = struct.Struct('>IIII')  # Timestamp seconds and microseconds, saved length and original length
+PCAPNG_EPB_HEADER      = struct.Struct('>IIIIIII')  # Block type and length, interface, timestamp (2x), saved length and original length
+PCAPNG_EPB_FLAGS       = struct.Struct('>HHI')  # epb_flags option
+PCAPNG_EPB_PACKETID    = struct.Struct('>HHQ')  # epb_packetid option, the epoch in the upper half and the 32-bit sequence number
+PCAPNG_EPB_CRC_ERROR   = 1 << 24  # Link-layer dependent error bit in epb_flags for a frame with a wrong FCS
+PCAPNG_PADDING         = [b'', b'\x00', b'\x00\x00', b'\x00\x00\x00']
+ARROW_METADATA_VERSION = 4   # MetadataVersion V5 of the Arrow IPC format
+ARROW_HEADER_SCHEMA    = 1   # MessageHeader union
+ARROW_HEADER_RECORD_BATCH = 3
+ARROW_TYPE_INT         = 2   # Type union
+ARROW_TYPE_BINARY      = 4
+ARROW_TYPE_BOOL        = 6
+ARROW_TYPE_TIMESTAMP   = 10
+ARROW_TIME_UNIT_MICROSECOND = 2
+ARROW_MAX_BATCH_AGE    = 60  # Seconds after which the frames are written even when their batch isn't full yet
+METRICS_PHY_OVERHEAD_BYTES = 6   # Preamble, SFD and length byte in front of every frame on the air
+METRICS_BYTE_TIME      = 32  # Microseconds per byte at 250 kbit/s
+METRICS_CHANNEL_COUNTERS = [('frames_total', 1, 'Frames written to the output'),  # Name, unit of the kept value and description
+                            ('frame_bytes_total', 1, 'Bytes of the frames written to the output'),
+                            ('fcs_errors_total', 1, 'Frames with an incorrect FCS written to the output'),
+                            ('airtime_seconds_total', 1e-6, 'Time that the frames written to the output were on the air, its rate is the utilisation of the channel')]
+METRICS_MOTE_COUNTERS = [('frames_received_total', 'counter', 'Frames received by the radio of the OpenMote'),
+                         ('dropped_buffer_full_total', 'counter', 'Frames dropped because the buffer of the OpenMote was full'),
+                         ('rx_fifo_flushes_total', 'counter', 'Times that the RX FIFO of the radio was flushed'),
+                         ('invalid_lengths_total', 'counter', 'Frames with an invalid length'),
+                         ('nacks_total', 'counter', 'NACKs received by the OpenMote'),
+                         ('retransmitted_bytes_total', 'counter', 'Bytes send again by the OpenMote after a NACK or timeout'),
+                         ('buffer_peak_bytes', 'gauge', 'Highest amount of unacknowledged bytes in the buffer of the OpenMote'),
+                         ('truncated_total', 'counter', 'Frames truncated by the overflow policy'),
+                         ('dropped_beacons_total', 'counter', 'Beacons dropped because the buffer was full'),
+                         ('dropped_data_total', 'counter', 'Data frames dropped because the buffer was full'),
+                         ('dropped_acks_total', 'counter', 'ACKs dropped because the buffer was full'),
+                         ('dropped_commands_total', 'counter', 'MAC commands dropped because the buffer was full'),
+                         ('dropped_other_total', 'counter', 'Other frames dropped because the buffer was full'),
+                         ('duplicates_replaced_total', 'counter', 'Retries that were send as a reference to the earlier frame'),
+                         ('compression_saved_bytes_total', 'counter', 'Bytes saved by compressing the headers'),
+                         ('uart_overruns_total', 'counter', 'Times that the UART of the OpenMote lost bytes from the host because its RX FIFO overflowed'),
+                         ('bad_fcs_dropped_total', 'counter', 'Frames with a bad FCS that the OpenMote discarded instead of sending them'),
+                         ('buffer_wrap_unused_bytes_total', 'counter', 'Bytes at the end of the buffer of the OpenMote that stayed unused when it wrapped around'),
+                         ('buffer_occupancy_bytes', 'gauge', 'Unacknowledged bytes in the buffer of the OpenMote'),
+                         ('batches_held_total', 'counter', 'Times that the OpenMote held the records back in throughput mode'),
+                         ('batch_hold_microseconds_total', 'counter', 'Microseconds that the OpenMote held the records back, the latency added by throughput mode'),
+                         ('batch_hold_peak_microseconds', 'gauge', 'Longest time that the OpenMote held the records back')]
+METRICS_TELEMETRY_GAUGES = [('temperature_celsius', 'temperature', 'Temperature measured by the SHT21 of the OpenMote'),  # Name, reading and description
+                            ('humidity_percent', 'humidity', 'Relative humidity measured by the SHT21 of the OpenMote'),
+                            ('light_lux', 'light', 'Illuminance measured by the MAX44009 of the OpenMote')]
+RING_MAGIC             = b'OMSHRING'
+RING_VERSION           = 1
+RING_HEADER            = struct.Struct('<8sIIQQQQQQI60x')  # Magic, version, header size, capacity, seqlock sequence, reserved end,
+                                                          # head, records, instance and flags, padded to 128 bytes
+RING_SEQUENCE_OFFSET   = 24
+RING_RESERVED_OFFSET   = 32  # Followed by the head and the amount of records
+RING_INSTANCE_OFFSET   = 56
+RING_FLAGS_OFFSET      = 64
+RING_FLAG_CLOSED       = 1 << 0
+RING_RECORD            = struct.Struct('<IHBbBB6xqQ')  # Length with this header, original length, channel, RSSI, LQI, flags, timestamp, packet id
+RING_RECORD_FCS_INCLUDED = 1 << 0
+RING_RECORD_CRC_ERROR    = 1 << 1
+RING_RECORD_PACKET_ID    = 1 << 2
+FLIGHT_RECORDER_SIZE   = 64     # MB of frames that the flight recorder keeps by default
+FLIGHT_RECORDER_AFTER  = 10     # Seconds of frames after a trigger that are also written by default
+FLIGHT_RECORD          = struct.Struct('<Iq')  # Length with this header and timestamp, followed by the packet block
+LINKTYPE_IEEE802_15_4_WITHFCS = 195
+LINKTYPE_IPV6                 = 229
+LINKTYPE_IEEE802_15_4_NOFCS   = 230
+LINKTYPE_IEEE802_15_4_TAP = 283  # Frames in the pcapng file start with TLVs that contain the FCS type, RSSI, channel and LQI
+TAP_HEADER = struct.Struct('<BBH' + 'HHB3x' + 'HHf' + 'HHHBx' + 'HHB3x')  # Header with the FCS type, RSS, channel and LQI TLVs
+TAP_CACHE_SIZE = 4096  # Amount of different TAP headers that are remembered instead of packing them again
+SYNC_FRAME_LENGTH    = 25      # Broadcast data frame with a counter and the time of the previous sync frame on the same channel
+SYNC_FRAME_MAGIC     = b'OMSY'
+SYNC_FRAME_MAGIC_OFFSET = 7
+SYNC_FRAME_COUNTER_OFFSET = 11  # Followed by the previous counter and its time
+SYNC_MAX_WAITING     = 1000    # Sync frames of which the time didn't arrive yet that are remembered
+SYNC_FIT_POINTS      = 64      # The drift and offset are fitted over this many of the last sync frames
+DEFAULT_SYNC_INTERVAL = 100    # Milliseconds between two sync frames
+PPS_FIT_POINTS       = 64      # The drift and offset are fitted over this many of the last pulses on the PPS input
+PPS_MAX_DEVIATION    = 1000    # Microseconds that a pulse may be off from the fit before it is taken for noise on the input
+PPS_MAX_DRIFT        = 100     # Microseconds per second that the clock of the OpenMote may drift while there are no pulses
+DEJITTER_WINDOW      = 1       # Seconds of the OpenMote clock of which only the record that arrived the soonest is kept
+DEJITTER_FIT_POINTS  = 120     # The drift and offset to the clock of the pc are fitted over this many of the last windows
+DEJITTER_MIN_POINTS  = 10      # Windows before the drift is fitted, until then the clock of the OpenMote is assumed to be exact
+AGGREGATE_MAX_MOTES  = 16     # OpenMotes that can be merged into one capture, one for every channel
+AGGREGATE_MERGE_DELAY = 0.5   # Seconds that a frame waits for earlier frames from the other OpenMotes before it is written
+AGGREGATE_MAX_PENDING = 10000 # Frames waiting per OpenMote, the oldest frame is written anyway when there are more
+AGGREGATE_DUPLICATE_WINDOW = 1000  # Microseconds between copies of a frame from OpenMotes on the same channel, a MAC retry comes later
+AGGREGATE_RECEIVER = struct.Struct('>BbBxq')  # Interface, RSSI, LQI and timestamp in microseconds of every OpenMote that received a frame
+PCAPNG_OPT_CUSTOM_BINARY = 2989  # Custom option with binary data that may be copied
+FLEET_SCAN_INTERVAL  = 2      # Seconds between looking for OpenMotes that were plugged in or stopped working
+FLEET_START_TIMEOUT  = 30     # Seconds that a new sniffer of the fleet gets to connect and send its first statistics
+FLEET_STATS_TIMEOUT  = 10     # Seconds without statistics after which an OpenMote of the fleet is taken for dead
+FLEET_RETRY_INTERVAL = 30     # Seconds before a port of which the sniffer failed is tried again
+FLEET_STOP_TIMEOUT   = 5      # Seconds that a sniffer of the fleet gets to stop before it is killed
+FLEET_REBALANCE_INTERVAL = 60 # Seconds between checking whether the channels are still divided well over the OpenMotes
+FLEET_REBALANCE_GAIN = 0.75   # The channels are only divided again when the busiest OpenMote gets at most this part of its load
+FLEET_LOAD_SMOOTHING = 0.2    # Weight of the last interval in the frames per second of every channel
+EXTCAP_INTERFACE     = 'openmote'  # Name of the interface that Wireshark shows when the sniffer is installed as extcap
+EXTCAP_CHANNEL_CONTROL = 0  # Number of the channel selector in the toolbar of Wireshark
+EXTCAP_NO_CONTROL      = 255  # Control number of messages that don't belong to a control, such as those for the status bar
+EXTCAP_COMMAND_INITIALIZED = 0
+EXTCAP_COMMAND_SET         = 1
+EXTCAP_COMMAND_STATUSBAR   = 6
+HOST_LIBRARY_DIR     = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'src', 'host')
+HOST_LIBRARY_NAMES   = ['libsniffer_host.so', 'libsniffer_host.dylib', 'sniffer_host.dll']
+HOST_EVENT_RECORD    = 1
+HOST_EVENT_MESSAGE   = 2
+HOST_EVENT_WARNING   = 3
+HOST_EVENT_MAX_LEN   = 512
+LOWPAN_DATAGRAMS     = 16    # 6LoWPAN datagrams that --ipv6 reassembles at the same time by default
+LOWPAN_TIMEOUT       = 60    # Seconds after which a datagram with missing fragments is dropped by default (RFC 4944)
+LOWPAN_PACKET_MAX_LEN = 4096  # A datagram has at most 2047 bytes, an unfragmented frame with decompressed headers less
+LOWPAN_COUNTERS      = ['packets', 'reassembled', 'timed out', 'evicted', 'invalid']  # LowpanCounter in sniffer_host_lowpan.hpp
+BIT_REVERSED_BYTES   = bytearray(int('{:08b}'.format(i)[::-1], 2) for i in range(256))
+HOST_WARNINGS = {1: 'WARNING: Received message too short',
+                 2: 'WARNING: Received message had incorrect serial CRC',
+                 3: 'WARNING: Received message had invalid type',
+                 4: 'WARNING: Received message had incorrect length byte',
+                 5: 'WARNING: Received message too short for type Packet',
+                 6: 'WARNING: Received message too short for type Survey',
+                 7: 'WARNING: Received message too short for type PacketBatch',
+                 8: 'WARNING: Received batch with incorrect packet length',
+                 9: 'WARNING: encountered unexpected byte, assuming out of sync',
+                 10: 'WARNING: out of sync detected',
+                 11: 'WARNING: expected another byte, assuming out of sync',
+                 12: 'WARNING: Received record had incorrect padding'}
 
 
 stopSniffingThread = False
 ser = serial.Serial()
 output = None
 outputIsFile = True
+outputPipe = None  # OverlappedPipe that writes to the named pipe on Windows, None when writing to a file or fifo
+outputWriter = None  # Thread that writes to the output, so that the sniffer thread never waits for Wireshark
+liveView = None  # LiveView that passes a part of the frames to Wireshark while all of them go to the file, None otherwise
+outputSinks = []  # OutputSinks that every frame is handed to: the capture output, a shared ring, an Arrow stream, ...
+metrics = None  # Metrics served over HTTP, None when there is no metrics endpoint
+nodeStatistics = None  # NodeStatistics that count the frames per source, None without --node-stats or --metrics
+writeLatency = None  # WriteLatency of the BlockFiles, None without --block-writes
+statsPrinted = True  # The statistics of the OpenMote are only counted in the metrics when they weren't asked for
 snifferThreadTerminated = False
 enableWarnings = False
+requestedWindow = 0  # 0 lets the OpenMote adapt the window to the measured round-trip time
+requestedAckInterval = ACK_THRESHOLD
+filterRules = []
+filterProgram = None  # Instructions of --filter-program, as send in the FILTER_PROGRAM message
+controlCommand = 0  # ID of the last message that was send with CONTROL
+decryptionKeys = []
+integrityKey = None  # HMAC key for the checkpoints of the hash chain, None when the records aren't hashed
+checkpointInterval = DEFAULT_CHECKPOINT_INTERVAL
+encryptionKey = None  # Key with which the OpenMote encrypts the records, None when the output is an ordinary capture
+encryptionNonce = None  # Part of the nonce that is chosen for this run
+snapLength = 0  # 0 captures the entire frame
+overflowPolicy = 0  # What the OpenMote does with new frames while its buffer is almost full, one of OVERFLOW_POLICIES
+duplicates = 'send'  # 'send' all frames, let the OpenMote send a 'reference' for retries or 'drop' those references
+compressHeaders = False  # Let the OpenMote send the MAC headers as their difference with an earlier header
+moteFcsFilter = False  # Let the OpenMote discard the frames with a bad FCS, they are only counted in its statistics
+frameDescriptors = False  # Let the OpenMote add a descriptor of the frame control field to every record
+triggerRule = None  # Fields of the TRIGGER message, None when the records are send without waiting for a trigger
+triggerPostFrames = 0  # Frames after the trigger that complete the capture
+framing = 'hdlc'  # How the OpenMote frames the records, one of FRAMINGS
+cobsFraming = False  # Set once the OpenMote was asked for COBS framing, until its next READY message
+hopSchedule = []  # List of (channel, dwell time) pairs, empty when listening on a single channel
+adaptiveMinDwellTime = None  # Minimum dwell time when the OpenMote divides the time of the schedule by activity, None otherwise
+tschRequest = None  # Fields of the TSCH message when following the channel hopping of a TSCH network, None otherwise
+superframeRequest = None  # Fields of the SUPERFRAME message when only listening during the active superframes, None otherwise
+injector = None  # FrameInjector that transmits the frames of a capture file, None when only capturing
+rtosTrace = None  # RtosTraceWriter that stores the scheduling events of a trace build of the firmware, None when not tracing
+fecGroupSize = 0  # Packets with records of which the OpenMote sends the XOR in a FEC message, 0 without forward error correction
+fecRepairedPackets = 0  # Packets that were rebuilt from the FEC messages instead of being send again
+lowLatency = False  # Tune the serial port and the sniffer thread for the shortest delay of the ACKs
+roundTripProbe = None  # RoundTripProbe that measures how long the OpenMote takes to answer, None without --low-latency
+linkMonitor = None  # LinkMonitor that warns before the serial link loses frames, None when not capturing live
+flightRecorder = None  # FlightRecorder that only writes the frames around a trigger, None without --flight-recorder
+outputPause = None  # OutputPause that pauses the OpenMote while the output is behind, None when not capturing live
+surveySampleInterval = 0  # Time per channel when doing an energy survey instead of capturing frames, 0 when not surveying
+surveyHistograms = {}  # Amount of samples in each RSSI bin, per channel
+surveyCounters = {}  # Amount of samples, busy samples and highest RSSI, per channel
+summaryInterval = 0  # Milliseconds between summaries of the traffic when counting frames instead of capturing them, 0 otherwise
+summaryLinks = {}  # Frames, bytes, FCS errors and the sums of the RSSI and LQI, per link
+summaryCurrent = {'interval': None, 'parts': 0, 'frames': 0, 'links': 0}  # The interval of which the parts are arriving
+summaryNextInterval = None  # Number of the interval that should follow the last complete one
+summaryLost = 0  # Intervals of which no SUMMARY message arrived
+summaryRates = []  # Frames per second in every interval
+topTalkers = {}  # Estimated frames in total and in the busiest interval, per source
+statsInterval = 0  # Milliseconds between statistics send by the OpenMote, 0 to not request them
+telemetryInterval = 0  # Seconds between samples of the sensors of the OpenMote, 0 when they aren't read
+ppsInput = False  # The timestamps follow the pulse-per-second input of the OpenMote
+dejitter = False  # The offset to the clock of the pc is fitted over all records instead of taken from the first one
+pcapngOutput = False  # Write a pcapng file instead of a pcap file
+hardwareCRC = False  # The OpenMote calculates the serial CRC with its CRC engine instead of with the table
+flashLog = False  # Let the OpenMote store the frames in its flash when the host stops responding
+saveAutostart = False  # Store the configuration in the OpenMote, which starts capturing with it after booting
+attachedCapture = False  # The capture was started by the OpenMote itself, the first record that arrives has an unknown sequence number
+requestedBaudrates = []  # Baudrates to try after connecting, the first one that works is used
+ackThreshold = ACK_THRESHOLD
+ackDelay = ACK_DELAY  # Longest time that received bytes stay unacknowledged, in seconds
+ackMode = 'request'  # Whether the ACKs are send when the OpenMote asks for them or after every ACK interval
+ackOnRequest = False  # The connected OpenMote confirmed that it asks for the ACKs
+batching = 'latency'  # When the OpenMote sends the records, one of BATCHING_MODES
+batchThreshold = BATCH_THRESHOLD
+batchHoldTime = BATCH_HOLD_TIME
+moteCapabilities = LEGACY_CAPABILITIES  # What the connected OpenMote understands, from its READY message
+moteMaxBaudrate = None  # Fastest baudrate that the connected OpenMote could use, None when it didn't tell
+moteBufferSize = DEFAULT_MOTE_BUFFER_SIZE  # Bytes in which the connected OpenMote keeps the records until they are acknowledged
+moteEpoch = None  # Epoch of the sequence numbers since the last reset of the OpenMote, None when it didn't tell
+recoveryRequested = False  # The records that survived a reset of the OpenMote are only asked for once, before the first RESET
+recoveredRecords = None  # Records from before a reset of the OpenMote, until they are written to the output
+timestampTickRate = TIMESTAMP_TICK_RATE
+tapHeaders = {}  # Packed TAP headers by FCS type, RSSI, channel and LQI, most frames share one with an earlier frame
+syncClock = None  # Converts the time of the OpenMote to the time of the sync beacon, None when there is no beacon
+aggregateMotes = []  # Serial port and channel of every OpenMote when merging several sniffers, empty otherwise
+fleetChannels = []  # Channels that the OpenMotes of --fleet divide between them, empty otherwise
+extcapControl = None  # Control pipes of Wireshark when running as extcap, None otherwise
+hostLibrary = None  # Native library from src/host that processes the received bytes, None when they are processed here
+bondPort = None  # Serial port of the second lane with --bond-port, None otherwise
+serialDevice = None  # The serial.Serial below the wrappers of ser, None with Ethernet or SPI
+hotplug = False  # Look for the OpenMote on every serial port that appears while its port is gone
+moteEui = None  # EUI-48 of the OpenMote with --hotplug, None when its firmware can't tell
+
+
+class EthernetPort:
+    """Carries the same bytes as the serial port in raw Ethernet frames (Linux only, requires root)"""
+
+    def __init__(self, interface, timeout):
+        self.sock = socket.socket(socket.AF_PACKET, socket.SOCK_RAW, socket.htons(ETHERNET_ETHERTYPE))
+        self.sock.bind((interface, ETHERNET_ETHERTYPE))
+        self.address = self.sock.getsockname()[4]
+        self.moteAddress = b'\xff' * 6  # Broadcast until the OpenMote was heard
+        self.timeout = timeout
+        self.baudrate = BAUDRATE  # Only there for the code that would change the baudrate of a serial port
+        self.received = bytearray()
+
+    def receiveFrames(self, timeout):
+        while len(select.select([self.sock], [], [], timeout)[0]) > 0:
+            frame = self.sock.recv(ETHERNET_HEADER_LEN + ETHERNET_MAX_DATA_LEN)
+            if len(frame) < ETHERNET_HEADER_LEN or struct.unpack('>H', frame[12:14])[0] != ETHERNET_ETHERTYPE:
+                continue
+
+            # Frames shorter than 60 bytes were padded, the length tells how much of it is data
+            length = struct.unpack('>H', frame[14:16])[0]
+            if ETHERNET_HEADER_LEN + length > len(frame):
+                continue
+
+            self.moteAddress = frame[6:12]
+            self.received += frame[ETHERNET_HEADER_LEN:ETHERNET_HEADER_LEN + length]
+            timeout = 0
+
+    def inWaiting(self):
+        self.receiveFrames(0)
+        return len(self.received)
+
+    def read(self, size):
+        if len(self.received) == 0:
+            self.receiveFrames(self.timeout)
+        data = bytes(self.received[:size])
+        del self.received[:size]
+        return data
+
+    def write(self, data):
+        data = bytes(data)
+        header = self.moteAddress + self.address + struct.pack('>H', ETHERNET_ETHERTYPE)
+        for i in range(0, len(data), ETHERNET_MAX_DATA_LEN):
+            chunk = data[i:i + ETHERNET_MAX_DATA_LEN]
+            self.sock.send(header + struct.pack('>H', len(chunk)) + chunk)
+
+    def flushInput(self):
+        self.receiveFrames(0)
+        self.received = bytearray()
+
+    def flushOutput(self):
+        pass
+
+    def flush(self):
+        pass
+
+    def close(self):
+        self.sock.close()
+
+
+class BondedPort:
+    """Merges the second lane of an OpenMote build with SNIFFER_UART_BONDING into the bytes of its serial port. Each lane sends
+    its records in order, but a record that was started later on one lane can arrive before an earlier one on the other lane.
+    The frames that lie ahead are held until the records in front of them arrived, until the other lane passed them (the
+    missing ones were lost, the NACK asks for them) or for BOND_REORDER_TIMEOUT. Everything is written to the first port."""
+
+    def __init__(self, primary, secondary, timeout):
+        self.ports = [primary, secondary]
+        self.timeout = timeout
+        self.reset()
+
+    def reset(self):
+        self.frames = [None, None]  # Bytes of the frame that each lane is receiving, without the flags, None between frames
+        self.held = []  # [first sequence number, bit of every lane heard since, time, frame], sorted on the sequence numbers
+        self.expectedSeqNr = None  # Sequence number of the record that is passed on next, None when any record may follow
+        self.received = bytearray()
+
+    @property
+    def baudrate(self):
+        return self.ports[0].baudrate
+
+    @baudrate.setter
+    def baudrate(self, rate):
+        for port in self.ports:
+            port.baudrate = rate
+
+    def decodeFrame(self, frame):
+        # Same as decode, but without the warnings, these are given when the frame is processed
+        result = decodeCobs(frame) if cobsFraming else None
+        if result == None or not hasValidCRC(result):
+            result = unescape(frame)
+        return result if hasValidCRC(result) else None
+
+    def releaseHeldFrames(self, releaseAll):
+        while len(self.held) > 0 and (releaseAll or self.expectedSeqNr == None
+                                      or ((self.held[0][0] - self.expectedSeqNr + 0x8000) & 0xffff) <= 0x8000):
+            frame = self.held.pop(0)[3]
+            self.received += HDLC_FLAG_BYTE + frame + HDLC_FLAG_BYTE
+
+            # The sequence number of the last record in the frame tells which one follows
+            msg = self.decodeFrame(frame)
+            lastSeqNr = (msg[SEQ_NR_OFFSET] << 8) + msg[SEQ_NR_OFFSET+1]
+            if msg[0] & ~ACK_REQUESTED == SerialDataType.PacketBatch:
+                pos = 2
+                while pos + SEQ_NR_OFFSET + 1 <= len(msg) - 2 and msg[pos] != 0:
+                    lastSeqNr = (msg[pos+SEQ_NR_OFFSET-1] << 8) + msg[pos+SEQ_NR_OFFSET]
+                    pos += msg[pos]
+            self.expectedSeqNr = (lastSeqNr + 1) & 0xffff
+
+    def mergeFrame(self, lane, frame):
+        msg = self.decodeFrame(frame)
+        dataType = msg[0] & ~ACK_REQUESTED if msg != None else None
+        if (dataType not in (SerialDataType.Packet, SerialDataType.PacketBatch, SerialDataType.Survey)
+                or len(msg) < SEQ_NR_OFFSET + 4):
+            if dataType == SerialDataType.Ready:
+                self.releaseHeldFrames(True)
+                self.expectedSeqNr = None
+            self.received += HDLC_FLAG_BYTE + frame + HDLC_FLAG_BYTE
+        else:
+            offset = SEQ_NR_OFFSET + 1 if dataType == SerialDataType.PacketBatch else SEQ_NR_OFFSET
+            seqNr = (msg[offset] << 8) + msg[offset+1]
+            pos = 0
+            while pos < len(self.held) and ((self.held[pos][0] - seqNr) & 0xffff) >= 0x8000:
+                pos += 1
+            self.held.insert(pos, [seqNr, 0, time.time(), frame])
+            self.releaseHeldFrames(False)
+
+        # What is still missing in front of a frame that both lanes have passed was lost
+        for held in self.held:
+            held[1] |= 1 << lane
+        while len(self.held) > 0 and self.held[0][1] == 3:
+            self.expectedSeqNr = None
+            self.releaseHeldFrames(False)
+
+    def receive(self, timeout):
+        begin = time.time()
+        while True:
+            for lane in range(2):
+                available = self.ports[lane].inWaiting()
+                if available == 0:
+                    continue
+
+                # Every flag ends the frame that was being received, if any, and starts the next one. The bytes outside the
+                # frames are passed on unchanged.
+                parts = bytes(self.ports[lane].read(available)).split(HDLC_FLAG_BYTE)
+                if self.frames[lane] == None:
+                    self.received += parts[0]
+                else:
+                    self.frames[lane] += parts[0]
+                for part in parts[1:]:
+                    if self.frames[lane] != None and len(self.frames[lane]) > 0:
+                        self.mergeFrame(lane, bytes(self.frames[lane]))
+                    self.frames[lane] = bytearray(part)
+
+            if len(self.held) > 0 and time.time() - self.held[0][2] >= BOND_REORDER_TIMEOUT:
+                self.expectedSeqNr = None
+                self.releaseHeldFrames(False)
+
+            if len(self.received) > 0 or time.time() - begin >= timeout:
+                return
+            time.sleep(BOND_POLL_INTERVAL)
+
+    def inWaiting(self):
+        self.receive(0)
+        return len(self.received)
+
+    def read(self, size=1):
+        if len(self.received) == 0:
+            self.receive(self.timeout)
+        data = bytes(self.received[:size])
+        del self.received[:size]
+        return data
+
+    def flushInput(self):
+        for port in self.ports:
+            port.flushInput()
+        self.reset()
+
+    def close(self):
+        for port in self.ports:
+            port.close()
+
+    def open(self):
+        for port in self.ports:
+            port.open()
+        self.reset()
+
+    def __getattr__(self, name):
+        return getattr(self.ports[0], name)
+
+
+class SpiPort:
+    """Carries the same bytes as the serial port in the bursts of an OpenMote build with SNIFFER_SPI_SLAVE, with the pc as
+    SPI master (Linux spidev). Both sides fill a burst behind their last message with flags, which are removed again."""
+
+    def __init__(self, device, readyGpio, timeout):
+        import spidev
+
+        match = re.match(r'^/dev/spidev(\d+)\.(\d+)$', device)
+        if match == None:
+            raise ValueError('the SPI device should be /dev/spidevBUS.DEVICE')
+        self.bus = int(match.group(1))
+        self.device = int(match.group(2))
+        self.spi = spidev.SpiDev()
+        self.open()
+
+        # The data ready line of the OpenMote is high while it has records, without it the bursts are clocked continuously
+        self.ready = None
+        if readyGpio != None:
+            path = '/sys/class/gpio/gpio' + str(readyGpio)
+            if not os.path.exists(path):
+                with open('/sys/class/gpio/export', 'w') as exportFile:
+                    exportFile.write(str(readyGpio))
+            with open(path + '/direction', 'w') as directionFile:
+                directionFile.write('in')
+            self.ready = open(path + '/value', 'rb', 0)
+
+        self.timeout = timeout
+        self.baudrate = BAUDRATE  # Only there for the code that would change the baudrate of a serial port
+        self.linkBaudrate = SPI_CLOCK // 8 * 10  # Same bytes per second with a start and a stop bit, for the LinkMonitor
+        self.lock = threading.Lock()  # The ACKs are written from another thread than the one that reads
+        self.received = bytearray()
+        self.outgoing = bytearray()
+        self.frameLen = -1  # Bytes of the message that is being received, 0 after an opening flag and -1 between the messages
+        self.lastBurstEmpty = False
+        self.lastBurstTime = 0
+
+    def open(self):
+        self.spi.open(self.bus, self.device)
+        self.spi.mode = SPI_MODE
+        self.spi.bits_per_word = 8
+        self.spi.max_speed_hz = SPI_CLOCK
+
+    def hasRecords(self):
+        if self.ready == None:
+            return not self.lastBurstEmpty or time.time() - self.lastBurstTime >= SPI_IDLE_INTERVAL
+        self.ready.seek(0)
+        return self.ready.read(1) == b'1'
+
+    def transfer(self):
+        # Only called with the lock held. The receiver takes two flags in a row as a lost message, so only one flag is kept
+        # in front of every message and one behind it.
+        data = bytes(self.outgoing[:SPI_BURST_LEN])
+        del self.outgoing[:SPI_BURST_LEN]
+        burst = bytes(bytearray(self.spi.xfer2(list(data + HDLC_FLAG_BYTE * (SPI_BURST_LEN - len(data))))))
+        self.lastBurstTime = time.time()
+
+        receivedLen = len(self.received)
+        for part in SPI_FLAG_RUNS.split(burst):
+            if len(part) == 0:
+                continue
+            if part[0] == HDLC_FLAG:
+                if self.frameLen > 0:
+                    self.received += HDLC_FLAG_BYTE
+                    self.frameLen = 0 if len(part) > 1 else -1
+                else:
+                    self.frameLen = 0
+                continue
+
+            if self.frameLen == 0:
+                self.received += HDLC_FLAG_BYTE
+            if self.frameLen >= 0:
+                self.frameLen += len(part)
+            self.received += part
+
+        self.lastBurstEmpty = (len(self.received) == receivedLen)
+
+    def inWaiting(self):
+        with self.lock:
+            if len(self.received) == 0 and (len(self.outgoing) > 0 or self.hasRecords()):
+                self.transfer()
+            return len(self.received)
+
+    def read(self, size=1):
+        begin = time.time()
+        while True:
+            with self.lock:
+                if len(self.received) == 0 and (len(self.outgoing) > 0 or self.hasRecords()):
+                    self.transfer()
+                if len(self.received) > 0 or time.time() - begin >= self.timeout:
+                    data = bytes(self.received[:size])
+                    del self.received[:size]
+                    return data
+            time.sleep(SPI_POLL_INTERVAL)
+
+    def write(self, data):
+        with self.lock:
+            self.outgoing += bytes(data)
+            while len(self.outgoing) > 0:
+                self.transfer()
+
+    def flushInput(self):
+        with self.lock:
+            self.received = bytearray()
+            self.frameLen = -1
+
+    def flushOutput(self):
+        pass
+
+    def flush(self):
+        pass
+
+    def close(self):
+        self.spi.close()
+
+
+class StreamRecorder:
+    """Passes everything to the serial port (or EthernetPort) and writes what it reads to a file, with the time at which
+    each read returned. Reads that timed out are written as well, so that replay-stream.py sees the same timeouts."""
+
+    def __init__(self, port, fileName):
+        self.port = port
+        self.recording = False  # Only the reads of the sniffer thread are stored
+        self.file = open(fileName, 'wb')
+        self.start = time.time()
+        self.file.write(STREAM_MAGIC + struct.pack('<d', self.start))
+
+    @property
+    def baudrate(self):
+        return self.port.baudrate
+
+    @baudrate.setter
+    def baudrate(self, rate):
+        self.port.baudrate = rate
+
+    def read(self, size=1):
+        data = self.port.read(size)
+        if self.recording:
+            self.file.write(STREAM_RECORD.pack(time.time() - self.start, len(data)) + bytes(data))
+        return data
+
+    def stopRecording(self):
+        self.recording = False
+        self.file.close()
+
+    def __getattr__(self, name):
+        return getattr(self.port, name)
 
 
 def getSerialPortList():
     ports = []
     if platform == 'Darwin':
-        ports = [port for port in glob.glob('/dev/tty.usbserial*')]
+        ports = [port for port in glob.glob('/dev/tty.usbserial*') + glob.glob('/dev/tty.usbmodem*')]
     elif platform == 'Linux':
-        ports = [port for port in glob.glob('/dev/ttyUSB*')]
+        ports = [port for port in glob.glob('/dev/ttyUSB*') + glob.glob('/dev/ttyACM*')]  # ttyACM when using the native USB port
     else:
         key = winreg.OpenKey(winreg.HKEY_LOCAL_MACHINE, 'HARDWARE\\DEVICEMAP\\SERIALCOMM')
         for i in range(winreg.QueryInfoKey(key)[1]):
             try:
                 val = winreg.EnumValue(key,i)
-                if val[0].find('VCP') > -1:
+                if val[0].find('VCP') > -1 or val[0].find('USBSER') > -1:
                     ports.append(str(val[1]))
             except:
                 pass
@@ -154,16 +1108,46 @@ def createPipe(name, force):
     else:
         global output
         output = win32pipe.CreateNamedPipe('\\\\.\\pipe\\' + name,
-                                           win32pipe.PIPE_ACCESS_OUTBOUND,
-                                           win32pipe.PIPE_TYPE_MESSAGE | win32pipe.PIPE_WAIT,
+                                           win32pipe.PIPE_ACCESS_OUTBOUND | win32file.FILE_FLAG_OVERLAPPED,
+                                           win32pipe.PIPE_TYPE_BYTE | win32pipe.PIPE_WAIT,
                                            1,
-                                           65536,
-                                           65536,
+                                           PIPE_BUFFER_SIZE,
+                                           PIPE_BUFFER_SIZE,
                                            300,
                                            None)
     return True
 
 
+class OverlappedPipe:
+    # Writes to the named pipe of Wireshark on Windows without waiting for the write to finish, so that the output thread can
+    # already collect the next blocks while Wireshark reads. Only a single write is underway at a time, it is waited for
+    # before starting the next one. The pipe is a byte stream, so the pcap records don't need a write each.
+    def __init__(self, handle):
+        self.handle = handle
+        self.overlapped = pywintypes.OVERLAPPED()
+        self.overlapped.hEvent = win32event.CreateEvent(None, True, False, None)
+        self.pending = None  # Data of the write that is underway, which has to stay alive until it finished
+
+    def connect(self):
+        # Waits for Wireshark to open the pipe, in short steps so that CTRL+C still works
+        result = win32pipe.ConnectNamedPipe(self.handle, self.overlapped)
+        if result == winerror.ERROR_IO_PENDING:
+            while win32event.WaitForSingleObject(self.overlapped.hEvent, PIPE_WAIT_INTERVAL) == win32event.WAIT_TIMEOUT:
+                pass
+            win32file.GetOverlappedResult(self.handle, self.overlapped, True)
+
+    def write(self, data):
+        self.wait()
+        self.pending = bytes(data)
+        win32file.WriteFile(self.handle, self.pending, self.overlapped)
+
+    def wait(self):
+        if self.pending == None:
+            return
+        self.pending = None
+        win32file.GetOverlappedResult(self.handle, self.overlapped, True)
+
+
 def removePipe(name):
     try:
         if platform != 'Windows':
@@ -193,7 +1177,759 @@ def startWireshark(executableName, pipeName):
             executableName = str(INPUT('Please provide wireshark executable name: '))
 
 
+def extcapListInterfaces():
+    print('extcap {version=1.0}{help=https://github.com/canghaiwuhen/OpenMote-CC2538-Sniffer}')
+    print('interface {value=' + EXTCAP_INTERFACE + '}{display=OpenMote-CC2538 IEEE 802.15.4 sniffer}')
+    print('control {number=' + str(EXTCAP_CHANNEL_CONTROL) + '}{type=selector}{display=Channel}{tooltip=IEEE 802.15.4 channel}')
+    for channel in range(11, 27):
+        print('value {control=' + str(EXTCAP_CHANNEL_CONTROL) + '}{value=' + str(channel) + '}{display=' + str(channel) + '}'
+              + ('{default=true}' if channel == 11 else ''))
+
+
+def extcapListDlts():
+    print('dlt {number=195}{name=IEEE802_15_4_WITHFCS}{display=IEEE 802.15.4 with FCS}')
+
+
+def extcapListConfig():
+    # The same long options as on the command line are used, Wireshark passes them to the capture
+    print('arg {number=0}{call=--port}{display=Serial port}{type=editselector}{required=true}{tooltip=Serial port of the OpenMote}')
+    for port in sorted(getSerialPortList()):
+        print('value {arg=0}{value=' + port + '}{display=' + port + '}')
+    print('arg {number=1}{call=--channel}{display=Channel}{type=integer}{range=11,26}{default=11}'
+          '{tooltip=Channel on which the sniffer starts listening, it can be changed in the toolbar during the capture}')
+    print('arg {number=2}{call=--baudrate}{display=Baudrate}{type=string}{tooltip=Baudrate to switch to after connecting or "max"}')
+    print('arg {number=3}{call=--keep-bad-fcs}{display=Keep frames with a bad FCS}{type=boolflag}')
+    print('arg {number=4}{call=--pcapng}{display=Store RSSI, LQI and channel (pcapng)}{type=boolflag}')
+
+
+class ExtcapControl:
+    # The messages on the control pipes start with 'T', followed by the length (3 bytes), the control number and the command.
+    # Wireshark only sends the channel selected in the toolbar, the capture is restarted on the new channel by the main thread.
+    def __init__(self, controlIn, controlOut, channel):
+        self.condition = threading.Condition()
+        self.writeLock = threading.Lock()
+        self.channel = channel
+        self.closed = False
+        self.outPipe = None
+        self.inPipeName = controlIn
+
+        # Opening a pipe waits for the other side, so the reading one is opened by the thread.
+        # Nothing can be send to Wireshark before the other pipe is open.
+        with self.writeLock:
+            if controlIn != None:
+                self.thread = threading.Thread(target=self.run)
+                self.thread.daemon = True
+                self.thread.start()
+            if controlOut != None:
+                self.outPipe = open(controlOut, 'wb', 0)
+
+    def send(self, control, command, payload=b''):
+        with self.writeLock:
+            if self.outPipe == None:
+                return
+            try:
+                self.outPipe.write(b'T' + struct.pack('>I', len(payload) + 2)[1:] + bytes(bytearray([control, command])) + payload)
+            except (IOError, OSError):
+                pass  # Wireshark already stopped the capture
+
+    def setStatus(self, text):
+        self.send(EXTCAP_NO_CONTROL, EXTCAP_COMMAND_STATUSBAR, text.encode('utf-8'))
+
+    def run(self):
+        try:
+            with open(self.inPipeName, 'rb', 0) as inPipe:
+                while True:
+                    header = inPipe.read(6)
+                    if len(header) < 6 or header[0:1] != b'T':
+                        break
+
+                    length = struct.unpack('>I', b'\x00' + header[1:4])[0]
+                    control, command = bytearray(header[4:6])
+                    payload = inPipe.read(length - 2) if length > 2 else b''
+                    if control != EXTCAP_CHANNEL_CONTROL:
+                        continue
+
+                    # Let the toolbar show the channel that is in use when the capture starts
+                    if command == EXTCAP_COMMAND_INITIALIZED:
+                        self.send(EXTCAP_CHANNEL_CONTROL, EXTCAP_COMMAND_SET, str(self.channel).encode('ascii'))
+                    elif command == EXTCAP_COMMAND_SET:
+                        try:
+                            channel = int(payload.decode('ascii'))
+                        except ValueError:
+                            continue
+                        if channel >= 11 and channel <= 26:
+                            with self.condition:
+                                self.channel = channel
+                                self.condition.notify()
+        except (IOError, OSError):
+            pass
+
+        with self.condition:
+            self.closed = True
+            self.condition.notify()
+
+    def waitForChanges(self, currentChannel):
+        # Returns when another channel was selected, when Wireshark closed the pipe or when the sniffer thread stopped
+        with self.condition:
+            while self.channel == currentChannel and not self.closed and not snifferThreadTerminated:
+                self.condition.wait(0.1)
+
+
+def writeOutputNow(data):
+    if outputIsFile:
+        output.write(data)
+    else:
+        outputPipe.write(data)
+
+
+def writeOutput(data, timestamp=None):
+    if outputWriter != None:
+        outputWriter.put(data, timestamp)
+    else:
+        writeOutputNow(data)
+    if liveView != None:
+        liveView.put(data, timestamp)
+
+
+def loadCompressor(compression):
+    # Returns a function that compresses bytes into a frame that can be decompressed on its own. gzip only needs zlib, zstd
+    # needs the zstandard module (or python 3.14) and lz4 needs the lz4 module. Raises ImportError when the module is missing.
+    if compression == 'gzip':
+        def compressGzip(data):
+            compressor = zlib.compressobj(6, zlib.DEFLATED, 16 + zlib.MAX_WBITS)  # A gzip member instead of a zlib stream
+            return compressor.compress(data) + compressor.flush()
+        return compressGzip
+    elif compression == 'zstd':
+        try:
+            from compression import zstd
+            return zstd.compress
+        except ImportError:
+            import zstandard
+            return zstandard.ZstdCompressor().compress
+    else:
+        import lz4.frame
+        return lz4.frame.compress
+
+
+def loadFallocate():
+    # fallocate of the C library, which reserves the space of a file without changing its size so that neither a reader
+    # nor a crash ever sees the reserved part. Other systems write without reserving the space.
+    if not sys.platform.startswith('linux'):
+        return None
+    try:
+        fallocate = ctypes.CDLL(None, use_errno=True).fallocate64
+    except (OSError, AttributeError):
+        return None
+    fallocate.argtypes = [ctypes.c_int, ctypes.c_int, ctypes.c_int64, ctypes.c_int64]
+    fallocate.restype = ctypes.c_int
+    return fallocate
+
+
+class WriteLatency:
+    # Durations of the writes and syncs of the BlockFiles, which the disk threads add and the metrics endpoint reads
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.samples = {'write': collections.deque(maxlen=BLOCK_WRITE_LATENCY_SAMPLES),
+                        'sync': collections.deque(maxlen=BLOCK_WRITE_LATENCY_SAMPLES)}
+        self.counts = {'write': 0, 'sync': 0}
+        self.totals = {'write': 0.0, 'sync': 0.0}
+        self.maximums = {'write': 0.0, 'sync': 0.0}
+
+    def add(self, kind, seconds):
+        with self.lock:
+            self.samples[kind].append(seconds)
+            self.counts[kind] += 1
+            self.totals[kind] += seconds
+            self.maximums[kind] = max(self.maximums[kind], seconds)
+
+    def percentiles(self, kind, fractions=(0.5, 0.99)):
+        with self.lock:
+            samples = sorted(self.samples[kind])
+        return [samples[min(len(samples) - 1, int(fraction * len(samples)))] if len(samples) > 0 else 0 for fraction in fractions]
+
+    def summary(self):
+        lines = []
+        for kind in ('write', 'sync'):
+            p50, p99 = self.percentiles(kind)
+            lines.append('%d block %ss: p50 %.1f ms, p99 %.1f ms, max %.1f ms'
+                         % (self.counts[kind], kind, p50 * 1000, p99 * 1000, self.maximums[kind] * 1000))
+        return '\n'.join(lines)
+
+
+class BlockFile:
+    # Output file that is written in large blocks that each start at a multiple of the block size, which SD cards and flash
+    # handle far better than many small appends. The output thread fills one buffer while a disk thread writes the other
+    # one, so a slow write only holds up the output thread when both buffers are full. On Linux the space of the file is
+    # reserved ahead of the writes, and the blocks are synced to the disk every few seconds instead of after every write.
+    # The last block that isn't full yet is written at every sync, and written again once it is full.
+    def __init__(self, fileName, blockSize, preallocate):
+        self.fd = os.open(fileName, os.O_WRONLY | os.O_CREAT | os.O_TRUNC | getattr(os, 'O_BINARY', 0), 0o666)
+        self.blockSize = blockSize
+        self.preallocate = preallocate
+        self.fallocate = loadFallocate() if preallocate > 0 else None
+        self.allocated = 0
+        self.condition = threading.Condition()
+        self.buffer = bytearray()
+        self.bufferOffset = 0  # Offset in the file of the first byte of the buffer
+        self.fullBlock = None  # Offset and buffer of the block that the disk thread has to write
+        self.partialWritten = 0  # Bytes of the buffer that the last sync already wrote
+        self.closing = False
+        self.error = None
+        self.thread = threading.Thread(target=self.run)
+        self.thread.daemon = True
+        self.thread.start()
+
+    def write(self, data):
+        data = memoryview(data)
+        with self.condition:
+            while len(data) > 0:
+                if self.error != None:
+                    raise self.error
+
+                length = min(self.blockSize - len(self.buffer), len(data))
+                self.buffer += data[:length]
+                data = data[length:]
+                if len(self.buffer) == self.blockSize:
+                    # The previous block has to be written before its buffer can be handed over, which is the only wait
+                    while self.fullBlock != None and self.error == None:
+                        self.condition.wait()
+                    if self.error != None:
+                        raise self.error
+                    self.fullBlock = (self.bufferOffset, self.buffer)
+                    self.bufferOffset += self.blockSize
+                    self.buffer = bytearray()
+                    self.partialWritten = 0
+                    self.condition.notify_all()
+
+    def flush(self):
+        pass  # The blocks reach the disk at the next sync
+
+    def writeAt(self, offset, data):
+        if self.fallocate != None and offset + len(data) > self.allocated:
+            # The space is reserved in large steps, when the file system can't do it the file grows with the writes
+            if self.fallocate(self.fd, FALLOC_FL_KEEP_SIZE, self.allocated, self.preallocate) == 0:
+                self.allocated += self.preallocate
+            else:
+                self.fallocate = None
+
+        start = time.time()
+        os.lseek(self.fd, offset, os.SEEK_SET)
+        view = memoryview(data)
+        while len(view) > 0:
+            view = view[os.write(self.fd, view):]
+        if writeLatency != None:
+            writeLatency.add('write', time.time() - start)
+
+    def sync(self):
+        start = time.time()
+        if hasattr(os, 'fdatasync'):
+            os.fdatasync(self.fd)
+        else:
+            os.fsync(self.fd)
+        if writeLatency != None:
+            writeLatency.add('sync', time.time() - start)
+
+    def run(self):
+        nextSync = time.time() + BLOCK_WRITE_SYNC_INTERVAL
+        written = False  # Whether there was a write since the last sync
+        try:
+            while True:
+                with self.condition:
+                    while self.fullBlock == None and not self.closing and time.time() < nextSync:
+                        self.condition.wait(max(nextSync - time.time(), 0))
+                    block = self.fullBlock
+                    partial = None
+                    if block == None and len(self.buffer) > self.partialWritten:
+                        partial = (self.bufferOffset, bytes(self.buffer))
+                        self.partialWritten = len(self.buffer)
+                    closing = self.closing and block == None
+
+                if block != None:
+                    self.writeAt(*block)
+                    written = True
+                    with self.condition:
+                        self.fullBlock = None
+                        self.condition.notify_all()
+                    continue
+
+                if partial != None:
+                    self.writeAt(*partial)
+                    written = True
+                if written:
+                    self.sync()
+                    written = False
+                nextSync = time.time() + BLOCK_WRITE_SYNC_INTERVAL
+                if closing:
+                    return
+        except (IOError, OSError) as e:
+            with self.condition:
+                self.error = e
+                self.condition.notify_all()
+
+    def close(self):
+        with self.condition:
+            self.closing = True
+            self.condition.notify_all()
+        self.thread.join()
+
+        # The space that was reserved behind the end of the file is given back
+        try:
+            if self.error == None:
+                os.ftruncate(self.fd, self.bufferOffset + len(self.buffer))
+        finally:
+            os.close(self.fd)
+        if self.error != None:
+            raise self.error
+
+
+class CompressedFile:
+    # Output file that is written as a series of compressed frames (gzip members, zstd or lz4 frames) which can each be
+    # decompressed on their own, so that a reader can start at any frame. Together the frames form an ordinary compressed
+    # file, which Wireshark opens directly (zstd and lz4 since Wireshark 4.2). FileRotation ends a frame in front of every
+    # entry of the index. It is only written by the output thread, so the compression never delays the sniffer thread.
+    def __init__(self, file, compression):
+        self.compress = loadCompressor(compression)
+        self.file = file
+        self.pending = []
+        self.pendingBytes = 0
+        self.frameStart = time.time()
+        self.compressedBytes = 0  # Offset in the file at which the next frame starts
+
+    def write(self, data):
+        self.pending.append(data)
+        self.pendingBytes += len(data)
+        if self.pendingBytes >= COMPRESSION_FRAME_MAX_BYTES or time.time() - self.frameStart >= COMPRESSION_FRAME_INTERVAL:
+            self.endFrame()
+
+    def endFrame(self):
+        if self.pendingBytes > 0:
+            frame = self.compress(b''.join(self.pending))
+            self.file.write(frame)
+            self.compressedBytes += len(frame)
+            self.pending = []
+            self.pendingBytes = 0
+        self.frameStart = time.time()
+
+    def flush(self):
+        # The frame that isn't finished stays in memory, half a frame can't be decompressed anyway
+        self.file.flush()
+
+    def close(self):
+        self.endFrame()
+        self.file.close()
+
+
+class FileRotation:
+    # Splits a long capture over numbered files (capture_00001.pcap, capture_00002.pcap, ...) that each start with the
+    # global header, keeping only the newest files when a maximum is given. Next to every file an index (capture_00001.pcap.idx)
+    # is written in JSON with the first and last timestamp, the amount of packets and the offset of every 1000th packet.
+    # The files are only opened and closed by the output thread, so rotating never delays the sniffer thread.
+    # With resume, the numbering continues behind the files that already exist instead of overwriting them.
+    # With a compression the files are CompressedFiles (capture_00001.pcap.zst) and every entry of the index also has the
+    # offset of the compressed frame that starts with that packet. With a block size they are written as BlockFiles.
+    # Without numbered, the single file keeps its name.
+    def __init__(self, fileName, maxBytes, maxSeconds, maxFiles, resume=False, compression=None, numbered=True, blockSize=0):
+        suffix = COMPRESSION_EXTENSIONS[compression] if compression != None else ''
+        if suffix != '' and fileName.endswith(suffix):
+            fileName = fileName[:-len(suffix)]
+        self.base, self.extension = os.path.splitext(fileName)
+        self.extension += suffix
+        self.compression = compression
+        self.numbered = numbered
+        self.blockSize = blockSize
+        self.maxBytes = maxBytes
+        self.maxSeconds = maxSeconds
+        self.maxFiles = maxFiles
+        self.header = b''  # Written at the start of every file after the first one
+        self.number = 0
+        self.fileNames = collections.deque()  # Files that were not yet removed, oldest first
+        self.file = None
+        if resume:
+            directory, prefix = os.path.split(self.base)
+            pattern = re.compile(re.escape(prefix) + r'_(\d{5})' + re.escape(self.extension) + '$')
+            for name in sorted(os.listdir(directory if directory != '' else '.')):
+                match = pattern.match(name)
+                if match != None:
+                    self.number = int(match.group(1))
+                    self.fileNames.append(os.path.join(directory, name))
+        self.open()
+
+    def getFileName(self, number):
+        if not self.numbered:
+            return self.base + self.extension
+        return self.base + '_' + '%05d' % number + self.extension
+
+    def open(self):
+        self.number += 1
+        self.fileName = self.getFileName(self.number)
+        if self.blockSize > 0:
+            # Only an uncompressed file is known to become as large as the rotation size
+            preallocate = self.maxBytes if self.maxBytes > 0 and self.compression == None else BLOCK_WRITE_PREALLOCATE
+            self.file = BlockFile(self.fileName, self.blockSize, preallocate)
+        else:
+            self.file = open(self.fileName, 'wb')
+        if self.compression != None:
+            self.file = CompressedFile(self.file, self.compression)
+        self.fileNames.append(self.fileName)
+        self.fileBytes = 0
+        self.fileStart = time.time()
+        self.packets = 0
+        self.firstTimestamp = None
+        self.lastTimestamp = None
+        self.index = []
+
+        # The oldest file and its index are removed when there are too many files
+        while self.maxFiles > 0 and len(self.fileNames) > self.maxFiles:
+            oldFileName = self.fileNames.popleft()
+            for name in (oldFileName, oldFileName + '.idx'):
+                try:
+                    os.remove(name)
+                except OSError:
+                    pass
+
+    def close(self):
+        if self.file == None:
+            return
+
+        self.file.close()
+        index = {'first_timestamp': self.firstTimestamp, 'last_timestamp': self.lastTimestamp,
+                 'packets': self.packets, 'bytes': self.fileBytes,
+                 'index_interval': ROTATION_INDEX_INTERVAL, 'index': self.index}
+        if self.compression != None:
+            index['compression'] = self.compression
+            index['compressed_bytes'] = self.file.compressedBytes
+        self.file = None
+        with open(self.fileName + '.idx', 'w') as indexFile:
+            json.dump(index, indexFile)
+
+    def write(self, blocks):
+        # Blocks with a timestamp are packets, a new file is only started in front of a packet so that no file is empty
+        data = []
+        for block, timestamp in blocks:
+            if timestamp != None:
+                if self.packets > 0 and ((self.maxBytes > 0 and self.fileBytes + len(block) > self.maxBytes)
+                                         or (self.maxSeconds > 0 and time.time() - self.fileStart >= self.maxSeconds)):
+                    self.file.write(b''.join(data))
+                    data = [self.header]
+                    self.close()
+                    self.open()
+                    self.fileBytes = len(self.header)
+
+                if self.packets % ROTATION_INDEX_INTERVAL == 0:
+                    if self.compression != None:
+                        # A reader that starts at this entry starts decompressing at the frame that is started here
+                        self.file.write(b''.join(data))
+                        data = []
+                        self.file.endFrame()
+                        self.index.append([self.packets, self.fileBytes, timestamp, self.file.compressedBytes])
+                    else:
+                        self.index.append([self.packets, self.fileBytes, timestamp])
+                if self.firstTimestamp == None:
+                    self.firstTimestamp = timestamp
+                self.lastTimestamp = timestamp
+                self.packets += 1
+
+            data.append(block)
+            self.fileBytes += len(block)
+
+        self.file.write(b''.join(data))
+
+
+class OutputSink:
+    # Something that the frames are written to. outputPacket hands every frame to add() in the sniffer thread, which therefore
+    # has to return quickly; a sink that can block or takes long per frame is wrapped in a SinkWorker. A sink with its own
+    # queue tells through backlog() and dropped how far it is behind, which the metrics show per sink.
+    name = 'output'
+    dropped = 0
+
+    def add(self, packet, timestamp, originalLength, channel, rssi, lqi, fcsIncluded, crcError, packetId):
+        pass
+
+    def addBatch(self, frames):
+        for frame in frames:
+            self.add(*frame)
+
+    def backlog(self):
+        return 0
+
+    def close(self):
+        pass
+
+
+class CaptureSink(OutputSink):
+    # The pcap or pcapng output of Wireshark, a file or stdout. The blocks are made in the sniffer thread, in the same order
+    # as the other blocks that the sniffer writes, and the OutputWriter thread writes them.
+    name = 'capture'
+
+    def add(self, packet, timestamp, originalLength, channel, rssi, lqi, fcsIncluded, crcError, packetId):
+        writeCapturePacket(packet, timestamp, originalLength, channel, rssi, lqi, fcsIncluded, crcError, packetId)
+
+    def backlog(self):
+        return outputWriter.queuedBytes if outputWriter != None else 0
+
+
+class SinkWorker(OutputSink):
+    # Runs a sink on a thread of its own, so that neither a slow sink nor the work that it does per frame holds up the sniffer
+    # thread or the other sinks. The frames are collected and handed to the sink in batches. When the thread falls more
+    # than SINK_MAX_FRAMES behind, the new frames are dropped for this sink only.
+    def __init__(self, sink):
+        self.sink = sink
+        self.name = sink.name
+        self.condition = threading.Condition()
+        self.frames = []
+        self.writing = 0  # Frames that the thread took but didn't finish yet
+        self.dropped = 0
+        self.dropping = False
+        self.stopping = False
+        self.error = None
+        self.thread = threading.Thread(target=self.run)
+        self.thread.daemon = True
+        self.thread.start()
+
+    def add(self, packet, timestamp, originalLength, channel, rssi, lqi, fcsIncluded, crcError, packetId):
+        with self.condition:
+            # The sniffer thread handles a failed write in the same way as when it wrote to the sink itself
+            if self.error != None:
+                raise self.error
+
+            if len(self.frames) + self.writing >= SINK_MAX_FRAMES:
+                if not self.dropping:
+                    self.dropping = True
+                    print('WARNING: The ' + self.name + ' output is too slow, dropping frames until it catches up')
+                self.dropped += 1
+                return
+            if len(self.frames) + self.writing < SINK_MAX_FRAMES // 2:
+                self.dropping = False
+
+            # The frame may be a buffer that is used again for the next one
+            self.frames.append((bytes(packet), timestamp, originalLength, channel, rssi, lqi, fcsIncluded, crcError, packetId))
+            if len(self.frames) == 1 or len(self.frames) == SINK_BATCH_FRAMES:
+                self.condition.notify()
+
+    def run(self):
+        while True:
+            with self.condition:
+                while len(self.frames) == 0 and not self.stopping:
+                    self.condition.wait()
+                if len(self.frames) == 0:
+                    return
+
+                # A batch that isn't full yet waits for a moment, a quiet channel still gets its frames written
+                deadline = time.time() + OUTPUT_FLUSH_INTERVAL
+                while not self.stopping and len(self.frames) < SINK_BATCH_FRAMES:
+                    remaining = deadline - time.time()
+                    if remaining <= 0:
+                        break
+                    self.condition.wait(remaining)
+
+                frames = self.frames
+                self.frames = []
+                self.writing = len(frames)
+
+            try:
+                self.sink.addBatch(frames)
+            except Exception as e:
+                with self.condition:
+                    self.error = e
+                    self.writing = 0
+                return
+
+            with self.condition:
+                self.writing = 0
+
+    def backlog(self):
+        with self.condition:
+            return len(self.frames) + self.writing
+
+    def close(self):
+        # The frames that are still waiting are written first
+        with self.condition:
+            self.stopping = True
+            self.condition.notify()
+        self.thread.join()
+        self.sink.close()
+        if self.dropped > 0:
+            print('WARNING: ' + str(self.dropped) + ' frames were not written to the ' + self.name + ' output because it was too slow')
+
+
+class OutputWriter:
+    # When Wireshark doesn't read the pipe fast enough, a write to it blocks. The sniffer thread would then stop sending ACKs
+    # and the OpenMote would start retransmitting or fill its buffer. So the sniffer thread only puts the blocks in a queue,
+    # which this thread writes to the output. When the queue is full, new blocks are dropped instead of waiting.
+    def __init__(self, rotation=None, write=writeOutputNow, maxBytes=OUTPUT_QUEUE_MAX_BYTES, name='the output'):
+        self.condition = threading.Condition()
+        self.rotation = rotation
+        self.write = write
+        self.maxBytes = maxBytes
+        self.name = name
+        self.headerBlocks = []  # Blocks that were put before headerWritten was called
+        self.collectingHeader = rotation != None
+        self.blocks = collections.deque()
+        self.waitingBytes = 0  # Bytes in the blocks that weren't taken by the thread yet
+        self.queuedBytes = 0  # Also includes the bytes that are being written
+        self.peakBytes = 0
+        self.droppedBlocks = 0
+        self.droppedBytes = 0
+        self.dropping = False
+        self.stopping = False
+        self.error = None
+        self.thread = threading.Thread(target=self.run)
+        self.thread.daemon = True
+        self.thread.start()
+
+    def headerWritten(self):
+        # Everything that was written until now has to be at the start of every file
+        with self.condition:
+            self.collectingHeader = False
+            if self.rotation != None:
+                self.rotation.header = b''.join(self.headerBlocks)
+
+    def put(self, data, timestamp=None):
+        with self.condition:
+            # The sniffer thread handles a failed write in the same way as when it wrote to the output itself
+            if self.error != None:
+                raise self.error
+
+            if self.queuedBytes + len(data) > self.maxBytes:
+                if not self.dropping:
+                    self.dropping = True
+                    print('WARNING: ' + self.name.capitalize() + ' is too slow, dropping frames until it catches up')
+                self.droppedBlocks += 1
+                self.droppedBytes += len(data)
+                return
+
+            # Only warn again once the output caught up with half of the queue
+            if self.queuedBytes < self.maxBytes // 2:
+                self.dropping = False
+
+            if self.collectingHeader:
+                self.headerBlocks.append(bytes(data))
+
+            self.blocks.append((bytes(data), timestamp))
+            self.waitingBytes += len(data)
+            self.queuedBytes += len(data)
+            self.peakBytes = max(self.peakBytes, self.queuedBytes)
+
+            # The thread only has to wake up for the first block and when there is enough for a full write
+            if len(self.blocks) == 1 or self.waitingBytes >= OUTPUT_WRITE_MAX_BYTES:
+                self.condition.notify()
+
+    def run(self):
+        while True:
+            with self.condition:
+                while len(self.blocks) == 0 and not self.stopping:
+                    self.condition.wait()
+                if len(self.blocks) == 0:
+                    return
+
+                # More blocks are collected for a moment, so that a write contains many frames even at low rates
+                deadline = time.time() + OUTPUT_FLUSH_INTERVAL
+                while not self.stopping and self.waitingBytes < OUTPUT_WRITE_MAX_BYTES:
+                    remaining = deadline - time.time()
+                    if remaining <= 0:
+                        break
+                    self.condition.wait(remaining)
+
+                # Blocks that are waiting are written together, which keeps up better than a write per frame
+                blocks = [self.blocks.popleft()]
+                length = len(blocks[0][0])
+                while len(self.blocks) > 0 and length + len(self.blocks[0][0]) <= OUTPUT_WRITE_MAX_BYTES:
+                    length += len(self.blocks[0][0])
+                    blocks.append(self.blocks.popleft())
+                self.waitingBytes -= length
+
+            try:
+                if self.rotation != None:
+                    self.rotation.write(blocks)
+                else:
+                    self.write(b''.join(block for block, timestamp in blocks))
+            except Exception as e:
+                with self.condition:
+                    self.error = e
+                    self.queuedBytes = 0
+                return
+
+            with self.condition:
+                self.queuedBytes -= length
+
+    def stop(self):
+        # Blocks that are still in the queue are written first
+        with self.condition:
+            self.stopping = True
+            self.condition.notify()
+        self.thread.join()
+
+        if self.rotation != None:
+            try:
+                self.rotation.close()
+            except Exception as e:
+                print('ERROR: Failed to close ' + self.rotation.fileName + '. Exception: ' + str(e))
+
+        if self.droppedBlocks > 0:
+            print('WARNING: ' + str(self.droppedBlocks) + ' blocks (' + str(self.droppedBytes) + ' bytes) were dropped because '
+                  + self.name + ' was too slow, at most ' + str(self.peakBytes) + ' bytes were waiting')
+        elif enableWarnings:
+            print('At most ' + str(self.peakBytes) + ' bytes were waiting to be written to ' + self.name)
+
+
+class LiveView:
+    # Shows the capture in Wireshark while every frame goes to the file. Wireshark can't keep up with a busy channel, so it
+    # only gets every sample-th frame and at most maxRate frames per second, through an output thread of its own that drops
+    # frames when Wireshark still falls behind. The headers and the other blocks always go to both.
+    def __init__(self, write, maxRate, sample):
+        self.writer = OutputWriter(write=write, maxBytes=LIVE_VIEW_QUEUE_MAX_BYTES, name='the live view')
+        self.maxRate = maxRate
+        self.sample = sample
+        self.tokens = float(maxRate)
+        self.lastTime = time.time()
+        self.frames = 0
+        self.skipped = 0
+        self.closed = False
+
+    def put(self, data, timestamp):
+        # Only the frames are written with a timestamp
+        if self.closed:
+            return
+        if timestamp != None:
+            self.frames += 1
+            if self.frames % self.sample != 0:
+                self.skipped += 1
+                return
+
+            if self.maxRate > 0:
+                now = time.time()
+                self.tokens = min(float(self.maxRate), self.tokens + (now - self.lastTime) * self.maxRate)
+                self.lastTime = now
+                if self.tokens < 1:
+                    self.skipped += 1
+                    return
+                self.tokens -= 1
+
+        # Closing Wireshark only ends the view, the capture goes on in the file
+        try:
+            self.writer.put(data, timestamp)
+        except (IOError, OSError):
+            self.closed = True
+            print('WARNING: Wireshark closed the live view, the capture continues in the file')
+
+    def stop(self):
+        self.writer.stop()
+        if enableWarnings and self.skipped > 0:
+            print(str(self.skipped) + ' of ' + str(self.frames) + ' frames were only written to the file, not to the live view')
+
+
 def outputGlobalHeader():
+    # The encrypted records aren't a capture yet, decrypt-capture.py writes the pcap header when it makes one of them
+    if encryptionKey != None:
+        writeOutput(ENCRYPTED_MAGIC)
+        return
+
+    # When hopping, a pcapng file is written with an interface per channel so that packets can be told apart.
+    # A pcapng file is also needed to store the statistics of the OpenMote in between the packets.
+    if pcapngOutput:
+        outputPcapngHeader()
+        return
+
     header = bytearray()
     header.extend([0xa1, 0xb2, 0xc3, 0xd4]) # magic number
     header.extend([0, 2]) # major version number
@@ -202,76 +1938,1595 @@ def outputGlobalHeader():
     header.extend([0]*4) # accuracy of timestamps
     header.extend([0, 0, 0xff, 0xff]) # max length of captured packets, in octets
     header.extend([0, 0, 0, 195]) # 802.15.4 protocol
-    if outputIsFile:
-        output.write(header)
+    writeOutput(header)
+
+
+def pcapngBlock(blockType, body):
+    # Blocks are padded to 32 bits and have their total length both in front and at the end
+    body = body + bytearray((4 - len(body) % 4) % 4)
+    return struct.pack('>II', blockType, len(body) + 12) + body + struct.pack('>I', len(body) + 12)
+
+
+def outputPcapngBlock(blockType, body):
+    writeOutput(pcapngBlock(blockType, body))
+
+
+def pcapngStringOption(code, text):
+    text = text.encode('ascii')
+    return struct.pack('>HH', code, len(text)) + text + PCAPNG_PADDING[(4 - len(text) % 4) % 4]
+
+
+def pcapngHeader(names, linkType=LINKTYPE_IEEE802_15_4_TAP):
+    # Section Header Block (byte-order magic, version 1.0, unknown section length)
+    header = pcapngBlock(0x0A0D0D0A, struct.pack('>IHHq', 0x1A2B3C4D, 1, 0, -1))
+
+    # Interface Description Block for every name
+    for name in names:
+        options = pcapngStringOption(2, name) # if_name
+        options += pcapngStringOption(15, 'OpenMote-CC2538') # if_hardware
+        options += struct.pack('>HHB3x', 9, 1, 9) # if_tsresol, timestamps in nanoseconds
+        options += struct.pack('>HH', 0, 0) # opt_endofopt
+        header += pcapngBlock(0x00000001, struct.pack('>HHI', linkType, 0, 0xffff) + options)
+    return header
+
+
+def pcapngInterfaceNames():
+    # An interface for every channel, in the order of the schedule
+    if len(aggregateMotes) > 0:
+        return [port + ' channel ' + str(channel) for port, channel in aggregateMotes]
+    elif len(fleetChannels) > 0:
+        return ['channel ' + str(channel) for channel in fleetChannels]
+    elif len(hopSchedule) > 0:
+        return ['channel ' + str(channel) for channel, dwellTime in hopSchedule]
     else:
-        win32file.WriteFile(output, header)
+        return ['OpenMote']
+
+
+def outputPcapngHeader():
+    writeOutput(pcapngHeader(pcapngInterfaceNames()))
+
+
+def printProfilingReport(data):
+    # Only firmware that was build with PROFILING set adds the cycle measurements behind the counters
+    sectionLength = 20 + 2 * PROFILING_HISTOGRAM_BINS
+    for section in range(min(len(PROFILING_SECTIONS), len(data) // sectionLength)):
+        values = struct.unpack('>IIIQ' + 'H' * PROFILING_HISTOGRAM_BINS, bytes(data[section * sectionLength:(section + 1) * sectionLength]))
+        count, minCycles, maxCycles, totalCycles = values[:4]
+        meanCycles = totalCycles // count if count > 0 else 0
+        histogram = ', '.join('<' + str(1 << (PROFILING_FIRST_BIN_BITS + i)) + ': ' + str(values[4 + i])
+                              for i in range(PROFILING_HISTOGRAM_BINS - 1))
+        histogram += ', more: ' + str(values[-1])
+        print('  ' + PROFILING_SECTIONS[section] + ': ' + str(count) + ' calls, cycles min ' + str(minCycles)
+              + ' max ' + str(maxCycles) + ' mean ' + str(meanCycles) + ' (' + histogram + ')')
+
+
+def printLatencyReport(data):
+    # Microseconds from the end of every frame until the firmware reached each point, per class of frame lengths
+    pointLength = 6 + 2 * LATENCY_HISTOGRAM_BINS
+    classLength = 4 + len(LATENCY_POINTS) * pointLength
+    for lengthClass in range(min(LATENCY_LENGTH_CLASSES, len(data) // classLength)):
+        classData = bytes(data[lengthClass * classLength:(lengthClass + 1) * classLength])
+        frames = struct.unpack('>I', classData[:4])[0]
+        if frames == 0:
+            continue
+
+        print('  frames of %d-%d bytes: %d' % (max(lengthClass * 32, 5), lengthClass * 32 + 31, frames))
+        for point in range(len(LATENCY_POINTS)):
+            values = struct.unpack('>HI' + 'H' * LATENCY_HISTOGRAM_BINS, classData[4 + point * pointLength:4 + (point + 1) * pointLength])
+            histogram = ', '.join('<' + str(1 << (LATENCY_FIRST_BIN_BITS + i)) + ': ' + str(values[2 + i])
+                                  for i in range(LATENCY_HISTOGRAM_BINS - 1))
+            histogram += ', more: ' + str(values[-1])
+            print('    ' + LATENCY_POINTS[point] + ': us max ' + str(values[0]) + ' mean ' + str(values[1] // frames)
+                  + ' (' + histogram + ')')
+
+
+def outputPcapngStats(data):
+    outputPcapngBlock(PCAPNG_CUSTOM_BLOCK, struct.pack('>I', PCAPNG_CUSTOM_PEN) + bytearray(data))
+
+
+def decodeTelemetry(data):
+    # Converts the raw readings to units, only of the sensors that answered
+    sensors = data[0]
+    readings = {}
+    if sensors & TELEMETRY_SENSOR_SHT21:
+        readings['temperature'] = -46.85 + 175.72 * ((data[1] << 8) | data[2]) / 65536
+        readings['humidity'] = -6.0 + 125.0 * ((data[3] << 8) | data[4]) / 65536
+    if sensors & TELEMETRY_SENSOR_MAX44009:
+        readings['light'] = 0.045 * (2 ** (data[5] & 0x0f)) * data[6]
+    if sensors & TELEMETRY_SENSOR_ADXL346:
+        axes = struct.unpack('>hhh', bytes(data[7:13]))
+        readings['acceleration'] = [axis * TELEMETRY_ACCELERATION_UNIT for axis in axes]
+    return readings
+
+
+def outputTelemetry(data, timestamp):
+    if len(data) < TELEMETRY_RECORD_LENGTH:
+        return
 
+    readings = decodeTelemetry(data)
+    if metrics != None:
+        metrics.telemetry = readings
 
-def outputPacket(packet):
-    ts_sec = int(time.time())
-    ts_usec = int((time.time() - ts_sec) * 1000000)
+    # The raw record is stored with its timestamp, the same microseconds as the packets, in front of it
+    if pcapngOutput:
+        outputPcapngBlock(PCAPNG_CUSTOM_COPY_BLOCK, struct.pack('>IIIB', PCAPNG_CUSTOM_PEN, (timestamp >> 32) & 0xffffffff,
+                                                                timestamp & 0xffffffff, SerialDataType.Telemetry)
+                                                    + bytearray(data[:TELEMETRY_RECORD_LENGTH]))
+    else:
+        parts = []
+        if 'temperature' in readings:
+            parts.append('%.2f C, %.1f %%RH' % (readings['temperature'], readings['humidity']))
+        if 'light' in readings:
+            parts.append('%.1f lux' % readings['light'])
+        if 'acceleration' in readings:
+            parts.append('acceleration %.2f %.2f %.2f g' % tuple(readings['acceleration']))
+        print('Telemetry: ' + (', '.join(parts) if len(parts) > 0 else 'no sensors answered'))
+
+
+def outputPacket(packet, timestamp, originalLength, channel, rssi=0, lqi=0, fcsIncluded=True, crcError=False, packetId=None):
+    # The counters follow the frames as they arrive, the sinks decide themselves how and when the frames are written
+    if metrics != None:
+        metrics.addFrame(channel, originalLength, crcError)
+    if nodeStatistics != None:
+        nodeStatistics.addFrame(packet, timestamp, originalLength, rssi, crcError)
+    if linkMonitor != None:
+        linkMonitor.frame(timestamp)
+
+    for sink in outputSinks:
+        sink.add(packet, timestamp, originalLength, channel, rssi, lqi, fcsIncluded, crcError, packetId)
+
+
+def pcapngInterface(channel):
+    # Packets from unknown channels are placed on the first interface
+    interface = 0
+    for i in range(len(hopSchedule)):
+        if hopSchedule[i][0] == channel:
+            interface = i
+    return interface
+
+
+def writeCapturePacket(packet, timestamp, originalLength, channel, rssi, lqi, fcsIncluded, crcError, packetId):
+    if pcapngOutput:
+        writeOutput(pcapngPacketBlock(packet, timestamp, originalLength, channel, rssi, lqi, fcsIncluded, crcError, packetId,
+                                      pcapngInterface(channel)), timestamp)
+        return
 
-    header = bytearray()
-    header.append((ts_sec >> 24) & 0xff) # timestamp seconds
-    header.append((ts_sec >> 16) & 0xff) # timestamp seconds
-    header.append((ts_sec >> 8) & 0xff)  # timestamp seconds
-    header.append((ts_sec >> 0) & 0xff)  # timestamp seconds
-    header.append((ts_usec >> 24) & 0xff) # timestamp microseconds
-    header.append((ts_usec >> 16) & 0xff) # timestamp microseconds
-    header.append((ts_usec >> 8) & 0xff)  # timestamp microseconds
-    header.append((ts_usec >> 0) & 0xff)  # timestamp microseconds
-    header.extend([0, 0, len(packet) >> 8, len(packet) & 0xff]) # nr of octets of packet saved
-    header.extend([0, 0, len(packet) >> 8, len(packet) & 0xff]) # actual length of packet
-    if outputIsFile:
-        output.write(header)
-        output.write(packet)
+    header = PCAP_RECORD_HEADER.pack((timestamp // 1000000) & 0xffffffff, timestamp % 1000000, len(packet), originalLength)
+    writeOutput(header + bytes(packet), timestamp)
+
+
+def pcapngPacketBlock(packet, timestamp, originalLength, channel, rssi, lqi, fcsIncluded, crcError, packetId, interface):
+    # Enhanced Packet Block. The TLVs in front of the frame replace the TI CC24XX FCS, so the real FCS is always kept (when it
+    # was captured).
+    key = (fcsIncluded, rssi, channel, lqi)
+    tapHeader = tapHeaders.get(key)
+    if tapHeader == None:
+        if len(tapHeaders) >= TAP_CACHE_SIZE:
+            tapHeaders.clear()
+        tapHeader = TAP_HEADER.pack(0, 0, TAP_HEADER.size,
+                                    0, 1, 1 if fcsIncluded else 0, # FCS type: 16-bit CRC or none
+                                    1, 4, rssi, # RSS in dBm
+                                    3, 3, channel, 0, # Channel assignment: channel number and page 0
+                                    10, 1, lqi)
+        tapHeaders[key] = tapHeader
+
+    data = tapHeader + bytes(packet)
+    padding = PCAPNG_PADDING[(4 - len(data) % 4) % 4]
+    options = PCAPNG_EPB_FLAGS.pack(2, 4, PCAPNG_EPB_CRC_ERROR) if crcError else b''
+    if packetId != None:
+        options += PCAPNG_EPB_PACKETID.pack(5, 8, packetId)
+    if len(options) > 0:
+        options += struct.pack('>HH', 0, 0) # opt_endofopt
+
+    nanoseconds = timestamp * 1000
+    blockLength = PCAPNG_EPB_HEADER.size + len(data) + len(padding) + len(options) + 4
+    return (PCAPNG_EPB_HEADER.pack(0x00000006, blockLength, interface, (nanoseconds >> 32) & 0xffffffff, nanoseconds & 0xffffffff,
+                                   len(data), TAP_HEADER.size + originalLength)
+            + data + padding + options + struct.pack('>I', blockLength))
+
+
+def encodeFlatBuffer(root):
+    # Minimal flatbuffer encoder for the Arrow metadata. A table is a dict from field index to a scalar (struct format, value)
+    # or to a child, a child is another table, a string, a list of children or a (struct format, alignment, rows) vector.
+    # Everything is written front to back, so each offset points forward to a child that is placed later.
+    buf = bytearray(4)
+    pending = collections.deque([(0, root)])
+
+    def align(alignment, extra=0):
+        buf.extend(bytearray((alignment - (len(buf) + extra) % alignment) % alignment))
+
+    while pending:
+        reference, obj = pending.popleft()
+        if isinstance(obj, dict):
+            # The table is aligned to 8 bytes, its fields are placed from large to small and its vtable follows it
+            align(8)
+            position = len(buf)
+            fields = []
+            for index, value in obj.items():
+                scalar = isinstance(value, tuple) and len(value) == 2
+                fields.append((struct.calcsize('<' + value[0]) if scalar else 4, index, scalar, value))
+            fields.sort(key=lambda field: -field[0])
+
+            table = bytearray(4)
+            slots = {}
+            for size, index, scalar, value in fields:
+                table.extend(bytearray((size - len(table) % size) % size))
+                slots[index] = len(table)
+                if scalar:
+                    table.extend(struct.pack('<' + value[0], value[1]))
+                else:
+                    pending.append((position + len(table), value))
+                    table.extend(bytearray(4))
+            table.extend(bytearray(len(table) % 2))
+            buf.extend(table)
+
+            slotCount = max(obj.keys()) + 1 if obj else 0
+            vtable = struct.pack('<HH', 4 + 2 * slotCount, len(table)) + b''.join(struct.pack('<H', slots.get(i, 0)) for i in range(slotCount))
+            struct.pack_into('<i', buf, position, position - len(buf))
+            buf.extend(vtable)
+        elif isinstance(obj, str):
+            align(4)
+            position = len(buf)
+            text = obj.encode('utf-8')
+            buf.extend(struct.pack('<I', len(text)) + text + b'\x00')
+        elif isinstance(obj, list):
+            align(4)
+            position = len(buf)
+            buf.extend(struct.pack('<I', len(obj)))
+            for child in obj:
+                pending.append((len(buf), child))
+                buf.extend(bytearray(4))
+        else:
+            rowFormat, alignment, rows = obj
+            align(alignment, 4)
+            position = len(buf)
+            buf.extend(struct.pack('<I', len(rows)))
+            for row in rows:
+                buf.extend(struct.pack('<' + rowFormat, *row))
+
+        struct.pack_into('<I', buf, reference, position - reference)
+
+    return bytes(buf)
+
+
+class ArrowStreamWriter(OutputSink):
+    # Writes the frames as an Arrow IPC stream, with a record batch for every batch of frames, for analytics tools that read only the
+    # columns that a query needs. The addresses are parsed from the MAC header, columns that a frame doesn't have are null.
+    # The scalars of the Arrow metadata are little endian, as are the columns.
+    COLUMNS = [('timestamp', 'q', False), ('channel', 'B', False), ('rssi', 'b', False), ('lqi', 'B', False), ('fcs_ok', '?', False),
+               ('original_length', 'B', False), ('packet_id', 'Q', True), ('frame_type', 'B', True), ('dst_pan', 'H', True),
+               ('dst_addr_mode', 'B', True), ('dst_addr', 'Q', True), ('src_pan', 'H', True), ('src_addr_mode', 'B', True),
+               ('src_addr', 'Q', True), ('frame', 'binary', False)]
+
+    def __init__(self, filename, batchRows):
+        self.file = open(filename, 'wb')
+        self.batchRows = batchRows
+        self.columns = [[] for column in self.COLUMNS]
+        self.batchStart = None
+        self.writeMessage(ARROW_HEADER_SCHEMA, {0: ('h', 0), 1: [self.fieldMetadata(column) for column in self.COLUMNS]}, b'')
+
+    def fieldMetadata(self, column):
+        name, fmt, nullable = column
+        if name == 'timestamp':
+            typeType, typeTable = ARROW_TYPE_TIMESTAMP, {0: ('h', ARROW_TIME_UNIT_MICROSECOND), 1: 'UTC'}
+        elif fmt == 'binary':
+            typeType, typeTable = ARROW_TYPE_BINARY, {}
+        elif fmt == '?':
+            typeType, typeTable = ARROW_TYPE_BOOL, {}
+        else:
+            typeType, typeTable = ARROW_TYPE_INT, {0: ('i', struct.calcsize(fmt) * 8), 1: ('?', fmt.islower())}
+        return {0: name, 1: ('?', nullable), 2: ('B', typeType), 3: typeTable, 5: []}
+
+    def writeMessage(self, headerType, header, body):
+        # Encapsulated message: continuation marker, metadata length and the metadata padded to 8 bytes, followed by the body
+        metadata = encodeFlatBuffer({0: ('h', ARROW_METADATA_VERSION), 1: ('B', headerType), 2: header, 3: ('q', len(body))})
+        metadata += bytearray((8 - len(metadata) % 8) % 8)
+        self.file.write(struct.pack('<Ii', 0xffffffff, len(metadata)) + metadata + body)
+
+    name = 'Arrow'
+
+    def add(self, packet, timestamp, originalLength, channel, rssi, lqi, fcsIncluded, crcError, packetId):
+        addresses = parseMacAddresses(packet)
+        row = [timestamp, channel, rssi, lqi, not crcError, originalLength, packetId] + list(addresses) + [bytes(packet)]
+        for column, value in zip(self.columns, row):
+            column.append(value)
+
+        # A quiet channel would keep the frames in memory for a long time, so a batch is also written after a while
+        now = time.time()
+        if self.batchStart == None:
+            self.batchStart = now
+        if len(self.columns[0]) >= self.batchRows or now - self.batchStart >= ARROW_MAX_BATCH_AGE:
+            self.flush()
+
+    def flush(self):
+        rows = len(self.columns[0])
+        if rows == 0:
+            return
+
+        body = bytearray()
+        nodes = []
+        buffers = []
+
+        def addBuffer(data):
+            buffers.append((len(body), len(data)))
+            body.extend(data)
+            body.extend(bytearray((8 - len(data) % 8) % 8))
+
+        def bitmap(bits):
+            data = bytearray((len(bits) + 7) // 8)
+            for i, bit in enumerate(bits):
+                if bit:
+                    data[i >> 3] |= 1 << (i & 7)
+            return data
+
+        for (name, fmt, nullable), values in zip(self.COLUMNS, self.columns):
+            # The validity bitmap is left empty when every value is present
+            nullCount = values.count(None)
+            nodes.append((rows, nullCount))
+            addBuffer(bitmap([value != None for value in values]) if nullCount > 0 else b'')
+            if fmt == 'binary':
+                offsets = [0]
+                for value in values:
+                    offsets.append(offsets[-1] + len(value))
+                addBuffer(struct.pack('<%di' % len(offsets), *offsets))
+                addBuffer(b''.join(values))
+            elif fmt == '?':
+                addBuffer(bitmap(values))
+            else:
+                addBuffer(struct.pack('<%d%s' % (rows, fmt), *[0 if value == None else value for value in values]))
+
+        self.writeMessage(ARROW_HEADER_RECORD_BATCH, {0: ('q', rows), 1: ('qq', 8, nodes), 2: ('qq', 8, buffers)}, bytes(body))
+        self.columns = [[] for column in self.COLUMNS]
+        self.batchStart = None
+
+    def close(self):
+        self.flush()
+        self.file.write(struct.pack('<Ii', 0xffffffff, 0))
+        self.file.close()
+
+
+class Ipv6Writer(OutputSink):
+    # Writes the IPv6 packets that the 6LoWPAN frames carry to a pcapng file of their own, while capturing: HostLowpan in the
+    # native library reassembles the fragments and decompresses the headers, so that tools that work at the IPv6, UDP or
+    # CoAP level don't have to do it again afterwards. A packet gets the timestamp of its last fragment.
+    name = 'IPv6'
+
+    def __init__(self, fileName, library, maxDatagrams, timeout, contexts):
+        self.library = library
+        self.file = open(fileName, 'wb')
+        self.file.write(pcapngHeader(['6LoWPAN'], LINKTYPE_IPV6))
+        self.lowpan = library.snifferLowpanCreate(maxDatagrams, int(timeout * 1000000))
+        for contextId, prefix, prefixLength in contexts:
+            library.snifferLowpanSetContext(self.lowpan, contextId, prefix, prefixLength)
+        self.packetBuffer = ctypes.create_string_buffer(LOWPAN_PACKET_MAX_LEN)
+        self.packetLength = ctypes.c_size_t()
+        self.packetTimestamp = ctypes.c_int64()
+
+    def add(self, packet, timestamp, originalLength, channel, rssi, lqi, fcsIncluded, crcError, packetId):
+        # A truncated frame (the only kind without FCS) misses the end of its datagram
+        if crcError or not fcsIncluded:
+            return
+
+        frame = bytes(packet[:-2])
+        self.library.snifferLowpanFeed(self.lowpan, frame, len(frame), timestamp)
+        while self.library.snifferLowpanNextPacket(self.lowpan, self.packetBuffer, LOWPAN_PACKET_MAX_LEN,
+                                                   ctypes.byref(self.packetLength), ctypes.byref(self.packetTimestamp)):
+            data = self.packetBuffer.raw[:self.packetLength.value]
+            padding = PCAPNG_PADDING[(4 - len(data) % 4) % 4]
+            nanoseconds = self.packetTimestamp.value * 1000
+            blockLength = PCAPNG_EPB_HEADER.size + len(data) + len(padding) + 4
+            self.file.write(PCAPNG_EPB_HEADER.pack(0x00000006, blockLength, 0, (nanoseconds >> 32) & 0xffffffff,
+                                                   nanoseconds & 0xffffffff, len(data), len(data))
+                            + data + padding + struct.pack('>I', blockLength))
+
+        # Datagrams of which a fragment never arrived are what this sink loses
+        self.dropped = self.counter('timed out') + self.counter('evicted')
+
+    def counter(self, name):
+        return self.library.snifferLowpanCounter(self.lowpan, LOWPAN_COUNTERS.index(name))
+
+    def close(self):
+        self.file.close()
+        print('IPv6 packets: ' + ', '.join(str(self.counter(name)) + ' ' + name for name in LOWPAN_COUNTERS))
+        self.library.snifferLowpanDestroy(self.lowpan)
+
+
+def parseLowpanContext(text):
+    # "ID=PREFIX/LENGTH" of --ipv6-context, returns the id, the 16 bytes of the prefix and its length
+    contextId, _, prefix = text.partition('=')
+    address, _, prefixLength = prefix.partition('/')
+    if not contextId.isdigit() or int(contextId) > 15 or not prefixLength.isdigit() or int(prefixLength) > 128:
+        raise ValueError('expected ID=PREFIX/LENGTH with an id up to 15, e.g. 0=2001:db8::/64')
+    return int(contextId), socket.inet_pton(socket.AF_INET6, address), int(prefixLength)
+
+
+def parseMacAddresses(frame):
+    # Frame type, destination PAN, address mode and address, and source PAN, address mode and address of the MAC header.
+    # Fields that the frame doesn't contain are None, as are the fields of a header that is cut off.
+    if len(frame) < 2:
+        return (None,) * 7
+
+    frameControl = frame[0] + (frame[1] << 8)
+    frameType = frameControl & 0x07
+    panIdCompression = (frameControl >> 6) & 1
+    dstMode = (frameControl >> 10) & 3
+    frameVersion = (frameControl >> 12) & 3
+    srcMode = (frameControl >> 14) & 3
+    if dstMode == 1 or srcMode == 1:
+        return (frameType, None, None, None, None, None, None)
+
+    # Frames of IEEE 802.15.4-2015 can leave out the sequence number and have other rules for which PAN IDs are present
+    pos = 2 if frameVersion == 2 and frameControl & (1 << 8) else 3
+    if frameVersion == 2:
+        if dstMode == 0 or srcMode == 0:
+            dstPanPresent = (dstMode != 0 or srcMode == 0) and (panIdCompression == (1 if dstMode == 0 else 0))
+            srcPanPresent = dstMode == 0 and srcMode != 0 and not panIdCompression
+        elif dstMode == 3 and srcMode == 3:
+            dstPanPresent, srcPanPresent = not panIdCompression, False
+        else:
+            dstPanPresent, srcPanPresent = True, not panIdCompression
+    else:
+        dstPanPresent = dstMode != 0
+        srcPanPresent = srcMode != 0 and not panIdCompression
+
+    fields = []
+    for panPresent, mode in ((dstPanPresent, dstMode), (srcPanPresent, srcMode)):
+        pan = None
+        if panPresent:
+            if pos + 2 > len(frame):
+                return (frameType, None, None, None, None, None, None)
+            pan = frame[pos] + (frame[pos+1] << 8)
+            pos += 2
+
+        address = None
+        length = {0: 0, 2: 2, 3: 8}[mode]
+        if pos + length > len(frame):
+            return (frameType, None, None, None, None, None, None)
+        if mode != 0:
+            address = 0
+            for i in range(length):
+                address |= frame[pos+i] << (8 * i)
+            pos += length
+        fields.append((pan, mode if mode != 0 else None, address))
+
+    # Without a source PAN the source is in the PAN of the destination
+    (dstPan, dstMode, dstAddr), (srcPan, srcMode, srcAddr) = fields
+    if srcMode != None and srcPan == None:
+        srcPan = dstPan
+    return (frameType, dstPan, dstMode, dstAddr, srcPan, srcMode, srcAddr)
+
+
+class SharedRing(OutputSink):
+    # Publishes the frames in a memory-mapped file that any number of local programs can follow at the same time, see
+    # SharedRingReader. Records are written behind each other and wrap around at the end, the writer never waits for a reader.
+    # The end of the record that is being written and the end of the last complete record are updated under a seqlock:
+    # the sequence is odd while they change, so a reader retries when it was odd or changed while reading them.
+    name = 'shared ring'
+
+    def __init__(self, filename, capacity):
+        self.file = open(filename, 'w+b')
+        self.file.truncate(RING_HEADER.size + capacity)
+        self.map = mmap.mmap(self.file.fileno(), RING_HEADER.size + capacity)
+        self.capacity = capacity
+        self.sequence = 0
+        self.head = 0
+        self.records = 0
+
+        # A new instance tells the readers that they have to start over, the magic is written last
+        RING_HEADER.pack_into(self.map, 0, b'\x00' * len(RING_MAGIC), RING_VERSION, RING_HEADER.size, capacity, 0, 0, 0, 0,
+                              struct.unpack('<Q', os.urandom(8))[0], 0)
+        self.map[0:len(RING_MAGIC)] = RING_MAGIC
+
+    def publish(self, reserved, flags=0):
+        self.sequence += 1
+        struct.pack_into('<Q', self.map, RING_SEQUENCE_OFFSET, self.sequence)
+        struct.pack_into('<QQQ', self.map, RING_RESERVED_OFFSET, reserved, self.head, self.records)
+        struct.pack_into('<I', self.map, RING_FLAGS_OFFSET, flags)
+        self.sequence += 1
+        struct.pack_into('<Q', self.map, RING_SEQUENCE_OFFSET, self.sequence)
+
+    def add(self, packet, timestamp, originalLength, channel, rssi, lqi, fcsIncluded, crcError, packetId):
+        # A record doesn't wrap around, the rest of the ring is skipped when it doesn't fit (marked with a zero length).
+        # Records are aligned to 8 bytes, as is the capacity.
+        length = RING_RECORD.size + len(packet)
+        size = (length + 7) & ~7
+        position = self.head
+        if position % self.capacity + size > self.capacity:
+            self.publish(position + 8)
+            struct.pack_into('<I', self.map, RING_HEADER.size + position % self.capacity, 0)
+            position += self.capacity - position % self.capacity
+
+        self.publish(position + size)
+        flags = (RING_RECORD_FCS_INCLUDED if fcsIncluded else 0) | (RING_RECORD_CRC_ERROR if crcError else 0) \
+              | (RING_RECORD_PACKET_ID if packetId != None else 0)
+        offset = RING_HEADER.size + position % self.capacity
+        RING_RECORD.pack_into(self.map, offset, length, originalLength, channel, rssi, lqi, flags, timestamp,
+                              packetId if packetId != None else 0)
+        self.map[offset+RING_RECORD.size:offset+length] = bytes(packet)
+
+        self.head = position + size
+        self.records += 1
+        self.publish(self.head)
+
+    def close(self):
+        self.publish(self.head, RING_FLAG_CLOSED)
+        self.map.close()
+        self.file.close()
+
+
+class FlightRecorder(OutputSink):
+    # Keeps the frames of the last minutes in a ring of a fixed size in memory, and only writes them to a pcapng file when
+    # something triggers it: SIGUSR1, a request to /trigger on the metrics endpoint or a frame that matches an expression
+    # of --filter-program. The frames that arrive in the seconds after the trigger are written as well. Each record is the
+    # length, the timestamp and the packet block; a record doesn't wrap around, the rest of the ring is then skipped
+    # (marked with a zero length). The file is written by a thread of its own, from a copy of the ring.
+    name = 'flight recorder'
+
+    def __init__(self, fileName, seconds, capacity, afterSeconds, program):
+        self.fileName = fileName
+        self.window = int(seconds * 1000000)
+        self.capacity = capacity & ~3
+        self.afterSeconds = afterSeconds
+        self.program = program
+        self.ring = bytearray(self.capacity)
+        self.head = 0  # Bytes that were ever added, the ring position is modulo the capacity
+        self.tail = 0  # Start of the oldest record that is still kept
+        self.condition = threading.Condition()  # Reentrant, the signal handler may interrupt add in the same thread
+        self.dumpTime = None  # When the frames have to be written after a trigger
+        self.stopping = False
+        self.thread = threading.Thread(target=self.run)
+        self.thread.daemon = True
+        self.thread.start()
+
+    def lengthAt(self, position):
+        return struct.unpack_from('<I', self.ring, position % self.capacity)[0]
+
+    def evict(self):
+        length = self.lengthAt(self.tail)
+        self.tail += length if length != 0 else self.capacity - self.tail % self.capacity
+
+    def makeRoom(self, size):
+        while self.head + size - self.tail > self.capacity:
+            self.evict()
+
+    def add(self, packet, timestamp, originalLength, channel, rssi, lqi, fcsIncluded, crcError, packetId):
+        block = pcapngPacketBlock(packet, timestamp, originalLength, channel, rssi, lqi, fcsIncluded, crcError, packetId,
+                                  pcapngInterface(channel))
+        size = FLIGHT_RECORD.size + len(block)
+        with self.condition:
+            position = self.head % self.capacity
+            if position + size > self.capacity:
+                self.makeRoom(self.capacity - position)
+                struct.pack_into('<I', self.ring, position, 0)
+                self.head += self.capacity - position
+                position = 0
+
+            self.makeRoom(size)
+            FLIGHT_RECORD.pack_into(self.ring, position, size, timestamp)
+            self.ring[position+FLIGHT_RECORD.size:position+size] = block
+            self.head += size
+
+            # The frames that are older than the window are kept until their space is needed, they are left out of the file
+            if self.dumpTime == None and self.program != None:
+                if runFilterProgram(self.program, packet[:-2] if fcsIncluded else packet):
+                    self.trigger('a frame that matched')
+
+    def trigger(self, reason):
+        with self.condition:
+            if self.dumpTime != None:
+                return
+            self.dumpTime = time.time() + self.afterSeconds
+            self.condition.notify()
+        print('Flight recorder triggered by ' + reason + ', writing the capture in ' + str(self.afterSeconds) + ' seconds')
+
+    def snapshot(self):
+        # Only the bytes are copied while the sniffer thread waits, the records are found in the copy
+        with self.condition:
+            start = self.tail % self.capacity
+            end = start + (self.head - self.tail)
+            if end <= self.capacity:
+                data = bytes(self.ring[start:end])
+            else:
+                data = bytes(self.ring[start:]) + bytes(self.ring[:end - self.capacity])
+
+        records = []
+        position = 0
+        while position < len(data):
+            length, timestamp = FLIGHT_RECORD.unpack_from(data, position) if len(data) - position >= FLIGHT_RECORD.size else (0, 0)
+            if length == 0:
+                position += self.capacity - (start + position) % self.capacity
+                continue
+            records.append((timestamp, position + FLIGHT_RECORD.size, position + length))
+            position += length
+        return data, records
+
+    def dump(self):
+        data, records = self.snapshot()
+        newest = max(timestamp for timestamp, start, end in records) if len(records) > 0 else 0
+        base, extension = os.path.splitext(self.fileName)
+        fileName = base + '_' + time.strftime('%Y%m%d-%H%M%S') + extension
+        number = 1
+        while os.path.exists(fileName):
+            number += 1
+            fileName = base + '_' + time.strftime('%Y%m%d-%H%M%S') + '-' + str(number) + extension
+
+        frames = 0
+        view = memoryview(data)
+        try:
+            with open(fileName, 'wb') as dumpFile:
+                dumpFile.write(pcapngHeader(pcapngInterfaceNames()))
+                for timestamp, start, end in records:
+                    if timestamp >= newest - self.window:
+                        dumpFile.write(view[start:end])
+                        frames += 1
+            print('Flight recorder wrote ' + str(frames) + ' frames to ' + fileName)
+        except (IOError, OSError) as e:
+            print('ERROR: The flight recorder could not write ' + fileName + '. Exception: ' + str(e))
+
+    def run(self):
+        while True:
+            with self.condition:
+                while not self.stopping and (self.dumpTime == None or time.time() < self.dumpTime):
+                    self.condition.wait(max(self.dumpTime - time.time(), 0.01) if self.dumpTime != None else None)
+                if self.dumpTime == None:
+                    return
+                stopping = self.stopping
+
+            self.dump()
+            with self.condition:
+                self.dumpTime = None
+            if stopping:
+                return
+
+    def close(self):
+        # A trigger that is still waiting for the frames behind it is written right away
+        with self.condition:
+            self.stopping = True
+            self.condition.notify()
+        self.thread.join()
+
+
+class SharedRingReader:
+    # Follows the records of a SharedRing without ever blocking its writer. A reader that falls behind by more than the ring
+    # loses the oldest records, which it notices because the writer already reserved the place where they were.
+    def __init__(self, filename):
+        self.file = open(filename, 'rb')
+        self.map = mmap.mmap(self.file.fileno(), 0, access=mmap.ACCESS_READ)
+        magic, version, headerSize, self.capacity = struct.unpack_from('<8sIIQ', self.map, 0)
+        if magic != RING_MAGIC or version != RING_VERSION:
+            raise ValueError(filename + ' is not a ring written with --shared-ring')
+        self.headerSize = headerSize
+        self.instance = struct.unpack_from('<Q', self.map, RING_INSTANCE_OFFSET)[0]
+        self.lost = 0
+
+        # Only the records that are written from now on are read
+        reserved, self.position, self.count, flags = self.readState()
+
+    def readState(self):
+        # Reserved end, head, amount of records and flags, as one consistent set
+        while True:
+            before = struct.unpack_from('<Q', self.map, RING_SEQUENCE_OFFSET)[0]
+            if before & 1 == 0:
+                reserved, head, records = struct.unpack_from('<QQQ', self.map, RING_RESERVED_OFFSET)
+                flags = struct.unpack_from('<I', self.map, RING_FLAGS_OFFSET)[0]
+                if struct.unpack_from('<Q', self.map, RING_SEQUENCE_OFFSET)[0] == before:
+                    return reserved, head, records, flags
+            time.sleep(0)
+
+    def closed(self):
+        # The writer closed the ring or another sniffer started writing a new one in the same file
+        return (self.readState()[3] & RING_FLAG_CLOSED) != 0 or struct.unpack_from('<Q', self.map, RING_INSTANCE_OFFSET)[0] != self.instance
+
+    def read(self):
+        # Returns the records that were completed since the previous call, as tuples like the arguments of outputPacket
+        reserved, head, records, flags = self.readState()
+        result = []
+        while self.position < head:
+            # The writer went around the ring since the oldest record that wasn't read, the reader continues at the newest one
+            if reserved - self.position > self.capacity:
+                self.lost += records - self.count
+                self.count = records
+                self.position = head
+                break
+
+            offset = self.headerSize + self.position % self.capacity
+            left = self.capacity - self.position % self.capacity
+            length = struct.unpack_from('<I', self.map, offset)[0] if left >= RING_RECORD.size else 0
+            if length == 0:
+                self.position += left
+                continue
+
+            header = RING_RECORD.unpack_from(self.map, offset)
+            packet = bytearray(self.map[offset+RING_RECORD.size:offset+length])
+
+            # The copy is only valid when the writer didn't reserve its place in the meantime
+            reserved = self.readState()[0]
+            if reserved - self.position > self.capacity:
+                continue
+
+            length, originalLength, channel, rssi, lqi, recordFlags, timestamp, packetId = header
+            result.append((packet, timestamp, originalLength, channel, rssi, lqi, (recordFlags & RING_RECORD_FCS_INCLUDED) != 0,
+                           (recordFlags & RING_RECORD_CRC_ERROR) != 0, packetId if recordFlags & RING_RECORD_PACKET_ID else None))
+            self.position += (length + 7) & ~7
+            self.count += 1
+
+        return result
+
+    def close(self):
+        self.map.close()
+        self.file.close()
+
+
+def remoteEncodeRecord(packet, timestamp, originalLength, channel, rssi, lqi, fcsIncluded, crcError, packetId):
+    flags = (REMOTE_RECORD_FCS_INCLUDED if fcsIncluded else 0) | (REMOTE_RECORD_CRC_ERROR if crcError else 0) \
+          | (REMOTE_RECORD_PACKET_ID if packetId != None else 0)
+    return REMOTE_RECORD.pack(packetId if packetId != None else 0, timestamp, originalLength, channel, rssi, lqi, flags,
+                              len(packet)) + bytes(packet)
+
+
+def remoteDecodeRecords(data, count):
+    # Returns the frames of a RECORDS block as tuples like the arguments of outputPacket
+    records = []
+    offset = REMOTE_RECORDS.size
+    for i in range(count):
+        packetId, timestamp, originalLength, channel, rssi, lqi, flags, length = REMOTE_RECORD.unpack_from(data, offset)
+        offset += REMOTE_RECORD.size
+        if offset + length > len(data):
+            raise ValueError('frame behind the end of the block')
+        records.append((bytearray(data[offset:offset+length]), timestamp, originalLength, channel, rssi, lqi,
+                        (flags & REMOTE_RECORD_FCS_INCLUDED) != 0, (flags & REMOTE_RECORD_CRC_ERROR) != 0,
+                        packetId if flags & REMOTE_RECORD_PACKET_ID else None))
+        offset += length
+    return records
+
+
+def remoteSendBlock(sock, blockType, payload, compress=False):
+    flags = 0
+    if compress:
+        payload = zlib.compress(bytes(payload))
+        flags |= REMOTE_FLAG_COMPRESSED
+    sock.sendall(REMOTE_BLOCK_HEADER.pack(blockType, flags, len(payload)) + bytes(payload))
+
+
+def remoteReceive(sock, length):
+    data = bytearray()
+    while len(data) < length:
+        chunk = sock.recv(length - len(data))
+        if len(chunk) == 0:
+            raise IOError('the connection was closed')
+        data.extend(chunk)
+    return bytes(data)
+
+
+def remoteReadBlock(sock):
+    # Returns the type and the uncompressed payload of the next block
+    blockType, flags, length = REMOTE_BLOCK_HEADER.unpack(remoteReceive(sock, REMOTE_BLOCK_HEADER.size))
+    if length > REMOTE_MAX_BLOCK_LEN:
+        raise IOError('block of ' + str(length) + ' bytes')
+    payload = remoteReceive(sock, length)
+    if flags & REMOTE_FLAG_COMPRESSED:
+        payload = zlib.decompress(payload)
+    return blockType, payload
+
+
+class RemoteSink(OutputSink):
+    # Streams the frames over TCP to collector.py, which writes a capture for every site. The frames are numbered from 0 in a
+    # random session of this sniffer, and are kept until the collector acknowledged that it wrote them. After the connection
+    # was lost, the collector tells from which frame of the session it has to continue, so a drop of the WAN loses nothing
+    # as long as the unacknowledged frames fit in REMOTE_MAX_RETAINED_BYTES. A thread of its own does all the networking.
+    name = 'remote'
+
+    def __init__(self, host, port, site, compress):
+        self.address = (host, port)
+        self.site = site
+        self.compress = compress
+        self.session = struct.unpack('>Q', os.urandom(8))[0]
+        self.condition = threading.Condition()
+        self.pending = collections.deque()  # Index and encoded frame of the frames that weren't send yet
+        self.unacked = collections.deque()  # Frames that were send but not acknowledged
+        self.retainedBytes = 0
+        self.nextIndex = 0
+        self.dropped = 0
+        self.dropping = False
+        self.connected = False
+        self.warned = False
+        self.stopping = False
+        self.abandoned = False  # Stopping gave up on the collector
+        self.thread = threading.Thread(target=self.run)
+        self.thread.daemon = True
+        self.thread.start()
+
+    def add(self, packet, timestamp, originalLength, channel, rssi, lqi, fcsIncluded, crcError, packetId):
+        record = remoteEncodeRecord(packet, timestamp, originalLength, channel, rssi, lqi, fcsIncluded, crcError, packetId)
+        with self.condition:
+            if self.retainedBytes + len(record) > REMOTE_MAX_RETAINED_BYTES:
+                if not self.dropping:
+                    self.dropping = True
+                    print('WARNING: The collector is unreachable for too long, dropping frames until it catches up')
+                self.dropped += 1
+                return
+            if self.retainedBytes < REMOTE_MAX_RETAINED_BYTES // 2:
+                self.dropping = False
+
+            self.pending.append((self.nextIndex, record))
+            self.nextIndex += 1
+            self.retainedBytes += len(record)
+
+    def backlog(self):
+        with self.condition:
+            return len(self.pending) + len(self.unacked)
+
+    def acknowledged(self, index):
+        # Called with the condition held, the frames in front of the index are forgotten
+        for frames in (self.unacked, self.pending):
+            while len(frames) > 0 and frames[0][0] < index:
+                self.retainedBytes -= len(frames.popleft()[1])
+
+    def run(self):
+        while True:
+            with self.condition:
+                if self.abandoned or (self.stopping and len(self.pending) == 0 and len(self.unacked) == 0):
+                    return
+
+            sock = None
+            try:
+                sock = socket.create_connection(self.address, REMOTE_TIMEOUT)
+                sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+                self.resume(sock)
+                if not self.connected:
+                    self.connected = True
+                    self.warned = False
+                    print('Streaming the frames to the collector at ' + self.address[0] + ':' + str(self.address[1]))
+                self.stream(sock)
+            except (socket.error, IOError, OSError, ValueError, struct.error, zlib.error) as e:
+                if self.connected or not self.warned:
+                    self.warned = True
+                    print('WARNING: No connection with the collector at ' + self.address[0] + ':' + str(self.address[1])
+                          + ', keeping the frames until it is back. Error: ' + str(e))
+                self.connected = False
+                with self.condition:
+                    if not self.abandoned:
+                        self.condition.wait(REMOTE_RETRY_INTERVAL)
+            finally:
+                if sock != None:
+                    sock.close()
+
+    def resume(self, sock):
+        remoteSendBlock(sock, REMOTE_BLOCK_HELLO, REMOTE_HELLO.pack(REMOTE_MAGIC, REMOTE_VERSION, self.session) + self.site.encode('utf-8'))
+        blockType, payload = remoteReadBlock(sock)
+        if blockType != REMOTE_BLOCK_RESUME or len(payload) != REMOTE_INDEX.size:
+            raise IOError('the collector did not answer with RESUME')
+
+        # Everything that wasn't acknowledged is send again, from where the collector continues
+        with self.condition:
+            self.pending.extendleft(reversed(self.unacked))
+            self.unacked.clear()
+            self.acknowledged(REMOTE_INDEX.unpack(payload)[0])
+
+    def stream(self, sock):
+        lastAnswer = time.time()
+        while True:
+            with self.condition:
+                if self.abandoned or (self.stopping and len(self.pending) == 0 and len(self.unacked) == 0):
+                    return
+                records = []
+                while len(self.pending) > 0 and len(records) < REMOTE_BLOCK_MAX_RECORDS:
+                    record = self.pending.popleft()
+                    self.unacked.append(record)
+                    records.append(record)
+                waiting = len(self.unacked) > 0
+
+            if len(records) > 0:
+                remoteSendBlock(sock, REMOTE_BLOCK_RECORDS, REMOTE_RECORDS.pack(records[0][0], len(records))
+                                + b''.join(record for index, record in records), self.compress)
+
+            # The answers are read in between, the next block is send right away while the frames keep coming
+            readable = select.select([sock], [], [], 0 if len(records) == REMOTE_BLOCK_MAX_RECORDS else REMOTE_BLOCK_INTERVAL)[0]
+            while len(readable) > 0:
+                blockType, payload = remoteReadBlock(sock)
+                if blockType != REMOTE_BLOCK_ACK or len(payload) != REMOTE_INDEX.size:
+                    raise IOError('unexpected block from the collector')
+                with self.condition:
+                    self.acknowledged(REMOTE_INDEX.unpack(payload)[0])
+                lastAnswer = time.time()
+                readable = select.select([sock], [], [], 0)[0]
+
+            if waiting and time.time() - lastAnswer > REMOTE_TIMEOUT:
+                raise IOError('the collector stopped answering')
+            if not waiting:
+                lastAnswer = time.time()
+
+    def close(self):
+        # The last frames are still delivered when the collector can be reached
+        with self.condition:
+            self.stopping = True
+        self.thread.join(REMOTE_CLOSE_TIMEOUT)
+        with self.condition:
+            self.abandoned = True
+            lost = len(self.pending) + len(self.unacked)
+            self.condition.notify()
+        self.thread.join()
+        if lost > 0 or self.dropped > 0:
+            print('WARNING: ' + str(lost + self.dropped) + ' frames did not reach the collector')
+
+
+class FrameBatch:
+    # Frames that are handed to the program at once. The bytes of all frames are in a single buffer and the other fields in
+    # arrays, which are filled again for a later batch, so a program that keeps a frame after the batch has to copy it.
+    def __init__(self):
+        self.buffer = bytearray(FRAME_BATCH_MAX_BYTES)
+        self.view = memoryview(self.buffer)
+        self.offsets = array.array('I', [0] * (FRAME_BATCH_MAX_FRAMES + 1))  # Start of every frame and the end of the last one
+        self.timestamps = array.array('q', [0] * FRAME_BATCH_MAX_FRAMES)  # Microseconds, like the timestamps in the pcap
+        self.originalLengths = array.array('H', [0] * FRAME_BATCH_MAX_FRAMES)
+        self.channels = array.array('B', [0] * FRAME_BATCH_MAX_FRAMES)
+        self.rssi = array.array('b', [0] * FRAME_BATCH_MAX_FRAMES)
+        self.lqi = array.array('B', [0] * FRAME_BATCH_MAX_FRAMES)
+        self.fcsIncluded = array.array('B', [0] * FRAME_BATCH_MAX_FRAMES)
+        self.crcErrors = array.array('B', [0] * FRAME_BATCH_MAX_FRAMES)
+        self.packetIds = array.array('q', [0] * FRAME_BATCH_MAX_FRAMES)  # -1 when the frame has no packet identifier
+        self.count = 0
+        self.created = 0
+
+    def __len__(self):
+        return self.count
+
+    def frame(self, index):
+        return self.view[self.offsets[index]:self.offsets[index + 1]]
+
+    def fits(self, length):
+        return self.count < FRAME_BATCH_MAX_FRAMES and self.offsets[self.count] + length <= FRAME_BATCH_MAX_BYTES
+
+    def add(self, packet, timestamp, originalLength, channel, rssi, lqi, fcsIncluded, crcError, packetId):
+        if self.count == 0:
+            self.created = time.time()
+        i = self.count
+        start = self.offsets[i]
+        self.buffer[start:start+len(packet)] = packet
+        self.offsets[i + 1] = start + len(packet)
+        self.timestamps[i] = timestamp
+        self.originalLengths[i] = originalLength
+        self.channels[i] = channel
+        self.rssi[i] = rssi
+        self.lqi[i] = lqi
+        self.fcsIncluded[i] = 1 if fcsIncluded else 0
+        self.crcErrors[i] = 1 if crcError else 0
+        self.packetIds[i] = packetId if packetId != None else -1
+        self.count += 1
+
+    def clear(self):
+        self.count = 0
+
+
+class FrameConsumer(OutputSink):
+    # Collects the frames of the sniffer thread in batches for the program that uses the Sniffer class. The sniffer thread never
+    # waits for the program: when the program still holds every batch, the new frames are dropped and counted.
+    name = 'Python'
+
+    def __init__(self):
+        self.condition = threading.Condition()
+        self.free = collections.deque(FrameBatch() for i in range(FRAME_BATCHES))
+        self.ready = collections.deque()
+        self.current = self.free.popleft()
+        self.dropped = 0
+
+    def add(self, packet, timestamp, originalLength, channel, rssi, lqi, fcsIncluded, crcError, packetId):
+        with self.condition:
+            if self.current != None and not self.current.fits(len(packet)):
+                self.handOver()
+            if self.current == None:
+                self.dropped += 1
+                return
+
+            self.current.add(packet, timestamp, originalLength, channel, rssi, lqi, fcsIncluded, crcError, packetId)
+            if time.time() - self.current.created >= FRAME_BATCH_MAX_DELAY:
+                self.handOver()
+
+    def handOver(self):
+        # Called with the condition held, the next frames go into a free batch if there is one
+        if self.current != None and self.current.count > 0:
+            self.ready.append(self.current)
+            self.current = None
+            self.condition.notify()
+        if self.current == None and len(self.free) > 0:
+            self.current = self.free.popleft()
+
+    def take(self, timeout):
+        # Returns the next batch, or None when nothing arrived in time. A batch that isn't full is handed over once its first
+        # frame waited long enough, also when no frame arrives after it.
+        with self.condition:
+            if len(self.ready) == 0:
+                self.condition.wait(timeout)
+            if len(self.ready) == 0 and self.current != None and self.current.count > 0 \
+             and time.time() - self.current.created >= FRAME_BATCH_MAX_DELAY:
+                self.handOver()
+            return self.ready.popleft() if len(self.ready) > 0 else None
+
+    def release(self, batch):
+        with self.condition:
+            batch.clear()
+            if self.current == None:
+                self.current = batch
+            else:
+                self.free.append(batch)
+
+
+class Sniffer:
+    # Captures frames inside another Python program, without Wireshark or a pcap in between:
+    #
+    #     with sniffer.Sniffer() as capture:
+    #         capture.open('/dev/ttyUSB0', 26)
+    #         for batch in capture.batches():
+    #             for i in range(len(batch)):
+    #                 process(batch.frame(i), batch.timestamps[i], batch.rssi[i])
+    #
+    # The frames of a batch are memoryviews into its buffer, which are only valid until the next batch is asked for. The
+    # connection uses the state of the module like the command line does, so only one Sniffer can be open at a time.
+    def __init__(self, keepBadFcs=False):
+        self.keepBadFcs = keepBadFcs
+        self.consumer = None
+        self.thread = None
+        self.emptyBatch = None
+
+    def open(self, port, channel):
+        global ser
+        global outputSinks
+        global stopSniffingThread
+        global snifferThreadTerminated
+
+        if channel < 11 or channel > 26:
+            raise ValueError('Channel should be between 11 and 26')
+        ser = serial.Serial(port=port, baudrate=BAUDRATE, parity=serial.PARITY_NONE, stopbits=serial.STOPBITS_ONE,
+                            bytesize=serial.EIGHTBITS, xonxoff=False, rtscts=False, dsrdtr=False, timeout=SERIAL_TIMEOUT)
+        if not connectToOpenMote(channel, quiet=True):
+            ser.close()
+            raise IOError('Could not connect to the OpenMote on ' + port)
+
+        # A program that imported the sniffer takes the frames itself, there is no pcap output then
+        self.consumer = FrameConsumer()
+        outputSinks = [self.consumer]
+        stopSniffingThread = False
+        snifferThreadTerminated = False
+        self.thread = threading.Thread(target=snifferThread, args=[channel, not self.keepBadFcs, False])
+        self.thread.daemon = True
+        self.thread.start()
+
+    def batches(self, timeout=None):
+        # Yields the batches until the capture is closed or the connection was lost. When a timeout in seconds is given, an
+        # empty batch is yielded when nothing arrived in that time, so that the program can do something else in between.
+        waitStart = time.time()
+        while self.thread != None:
+            batch = self.consumer.take(FRAME_BATCH_MAX_DELAY)
+            if batch != None:
+                yield batch
+                self.consumer.release(batch)
+                waitStart = time.time()
+            elif snifferThreadTerminated:
+                return
+            elif timeout != None and time.time() - waitStart >= timeout:
+                if self.emptyBatch == None:
+                    self.emptyBatch = FrameBatch()
+                yield self.emptyBatch
+                waitStart = time.time()
+
+    def run(self, callback):
+        # Calls callback(batch) for every batch, until the capture is closed from the callback or another thread
+        for batch in self.batches():
+            callback(batch)
+
+    def dropped(self):
+        # Frames that were lost because the program held on to all batches
+        return self.consumer.dropped if self.consumer != None else 0
+
+    def close(self):
+        global outputSinks
+        global stopSniffingThread
+
+        if self.thread == None:
+            return
+        stopSniffingThread = True
+        if self.thread != threading.current_thread():
+            self.thread.join()
+        self.thread = None
+        serialWriteStop()
+        ser.close()
+        outputSinks = []
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, excType, excValue, traceback):
+        self.close()
+
+
+class Metrics:
+    # Counters for the metrics endpoint. Only the sniffer thread changes them and the HTTP thread only reads them, so no lock is
+    # needed: the values are plain integers and a changed set of counters replaces the old one instead of being modified in place.
+    def __init__(self):
+        self.channels = {}  # Frames, bytes, FCS errors and microseconds on the air, per channel
+        self.serialBytes = 0
+        self.connects = 0
+        self.moteStats = []  # Counters of the last STATS message of the OpenMote
+        self.telemetry = {}  # Readings of the last telemetry record, by name
+        self.degradationLevel = None  # Level of the adaptive overflow policy since its last change
+        self.started = time.time()
+
+    def addFrame(self, channel, length, crcError):
+        counters = self.channels.get(channel)
+        if counters == None:
+            counters = [0, 0, 0, 0]
+            self.channels[channel] = counters
+        counters[0] += 1
+        counters[1] += length
+        if crcError:
+            counters[2] += 1
+        counters[3] += (length + METRICS_PHY_OVERHEAD_BYTES) * METRICS_BYTE_TIME
+
+    def render(self):
+        lines = []
+        def metric(name, metricType, help, samples):
+            lines.append('# HELP openmote_' + name + ' ' + help)
+            lines.append('# TYPE openmote_' + name + ' ' + metricType)
+            for labels, value in samples:
+                lines.append('openmote_' + name + labels + ' ' + str(value))
+
+        channels = sorted(list(self.channels.items()))
+        for index, (name, unit, help) in enumerate(METRICS_CHANNEL_COUNTERS):
+            metric(name, 'counter', help, [('{channel="' + str(channel) + '"}', counters[index] * unit) for channel, counters in channels])
+
+        metric('serial_bytes_total', 'counter', 'Bytes received from the OpenMote over the serial port', [('', self.serialBytes)])
+        metric('connects_total', 'counter', 'Connections made to the OpenMote, including reconnections after it was reset', [('', self.connects)])
+        metric('output_dropped_blocks_total', 'counter', 'Blocks that were dropped because the output could not keep up',
+               [('', outputWriter.droppedBlocks if outputWriter != None else 0)])
+        sinks = outputSinks
+        metric('sink_backlog', 'gauge', 'Frames or bytes that an output received but did not write yet',
+               [('{sink="' + sink.name + '"}', sink.backlog()) for sink in sinks])
+        metric('sink_dropped_frames_total', 'counter', 'Frames that an output with its own thread dropped because it could not keep up',
+               [('{sink="' + sink.name + '"}', sink.dropped) for sink in sinks])
+        if writeLatency != None:
+            for kind in ('write', 'sync'):
+                p50, p99 = writeLatency.percentiles(kind)
+                metric('output_block_' + kind + '_seconds', 'summary', 'Duration of the block ' + kind + 's of the output file',
+                       [('{quantile="0.5"}', round(p50, 6)), ('{quantile="0.99"}', round(p99, 6))])
+                lines.append('openmote_output_block_' + kind + '_seconds_sum ' + str(round(writeLatency.totals[kind], 6)))
+                lines.append('openmote_output_block_' + kind + '_seconds_count ' + str(writeLatency.counts[kind]))
+        metric('up', 'gauge', 'Whether the sniffer thread is capturing', [('', 0 if snifferThreadTerminated else 1)])
+        if linkMonitor != None:
+            metric('link_utilisation_ratio', 'gauge', 'Part of the capacity of the serial link that was used in the last second',
+                   [('', round(linkMonitor.utilisation, 3))])
+            metric('link_offered_load_ratio', 'gauge', 'Load that the radio offers relative to the capacity of the serial link',
+                   [('', round(linkMonitor.offeredLoad, 3))])
+            metric('mote_buffer_estimate_bytes', 'gauge', 'Estimated bytes waiting in the buffer of the OpenMote',
+                   [('', linkMonitor.bufferEstimate)])
+        if self.degradationLevel != None:
+            metric('mote_degradation_level', 'gauge', 'Level to which the adaptive overflow policy of the OpenMote degraded the capture',
+                   [('', self.degradationLevel)])
+        metric('start_time_seconds', 'gauge', 'Time at which the sniffer started', [('', int(self.started))])
+
+        # Rates of the last complete window of the statistics per node, only of the busiest nodes
+        if nodeStatistics != None:
+            windowEnd, rows, untracked = nodeStatistics.snapshot
+            nodes = len(rows)
+            rows = rows[:NODE_STATS_METRICS]
+            labels = ['{pan="' + ('0x%04x' % pan if pan != None else '') + '",source="' + formatNodeAddress(None, mode, address) + '"}'
+                      for (pan, mode, address) in [row[0] for row in rows]]
+            metric('node_frames_per_second', 'gauge', 'Frames per second that the node sent in the last window',
+                   [(label, round(row[1], 3)) for label, row in zip(labels, rows)])
+            metric('node_bytes_per_second', 'gauge', 'Bytes per second that the node sent in the last window',
+                   [(label, round(row[2], 1)) for label, row in zip(labels, rows)])
+            metric('node_rssi_dbm', 'gauge', 'Average RSSI of the frames of the node in the last window',
+                   [(label, round(row[3], 1)) for label, row in zip(labels, rows) if row[3] != None])
+            metric('node_retry_ratio', 'gauge', 'Part of the frames of the node in the last window that were retries',
+                   [(label, round(row[4], 3)) for label, row in zip(labels, rows)])
+            metric('node_last_seen_seconds', 'gauge', 'Time at which the last frame of the node was received',
+                   [(label, round(row[5], 3)) for label, row in zip(labels, rows)])
+            metric('nodes', 'gauge', 'Nodes that sent frames in the last windows', [('', nodes)])
+            metric('node_untracked_frames_per_second', 'gauge', 'Frames per second of nodes that did not fit in the table',
+                   [('', round(untracked, 3))])
+
+        # The OpenMote counts from its last reset, which a counter that goes down shows to Prometheus
+        moteStats = self.moteStats
+        for index, (name, metricType, help) in enumerate(METRICS_MOTE_COUNTERS[:len(moteStats)]):
+            metric('mote_' + name, metricType, help, [('', moteStats[index])])
+
+        # Only the sensors that answered the last time have a value
+        telemetry = self.telemetry
+        for name, key, help in METRICS_TELEMETRY_GAUGES:
+            if key in telemetry:
+                metric(name, 'gauge', help, [('', telemetry[key])])
+        if 'acceleration' in telemetry:
+            metric('acceleration_g', 'gauge', 'Acceleration measured by the ADXL346 of the OpenMote',
+                   [('{axis="' + axis + '"}', value) for axis, value in zip('xyz', telemetry['acceleration'])])
+
+        return '\n'.join(lines) + '\n'
+
+
+class NodeStatistics:
+    # Frames, bytes, RSSI and retries per source address, updated once per frame by the sniffer thread. The counts only cover the
+    # current ageing window: at the end of a window they are turned into rates, published as a new snapshot and started again,
+    # and a node that sent nothing for several windows is removed, so the table stays bounded by the nodes that are active.
+    # The terminal view and the metrics endpoint only read the last snapshot, which is replaced instead of modified, so like
+    # for the Metrics no lock is needed and the sniffer thread never waits for them.
+    def __init__(self, window):
+        self.window = window
+        self.windowStart = time.time()
+        self.nodes = {}  # Frames, bytes, RSSI sum, retries, last sequence number, last timestamp and idle windows, per source
+        self.untracked = 0  # Frames of sources that didn't fit in the table in the current window
+        self.snapshot = (self.windowStart, [], 0)  # End of the window, rows ordered by frames and untracked frames per second
+
+    def addFrame(self, packet, timestamp, length, rssi, crcError):
+        # The source of a frame with a bad FCS may be wrong, it would only add nodes that don't exist
+        if crcError:
+            return
+        frameType, dstPan, dstMode, dstAddr, srcPan, srcMode, srcAddr = parseMacAddresses(packet)
+        if srcMode == None:
+            return
+
+        key = (srcPan, srcMode, srcAddr)
+        node = self.nodes.get(key)
+        if node == None:
+            if len(self.nodes) >= NODE_STATS_MAX_NODES:
+                self.untracked += 1
+                return
+            node = [0, 0, 0, 0, None, 0, 0]
+            self.nodes[key] = node
+
+        # A retry has the same sequence number as the previous frame of the source and requests an ACK again. Frames of
+        # IEEE 802.15.4-2015 without a sequence number can't be recognised as retries.
+        frameControl = packet[0] + (packet[1] << 8)
+        seqNr = None if (frameControl >> 12) & 3 == 2 and frameControl & (1 << 8) else packet[2]
+        if seqNr != None and seqNr == node[4] and frameControl & (1 << 5):
+            node[3] += 1
+        node[0] += 1
+        node[1] += length
+        node[2] += rssi
+        node[4] = seqNr
+        node[5] = timestamp
+
+    def poll(self):
+        now = time.time()
+        elapsed = now - self.windowStart
+        if elapsed < self.window:
+            return
+
+        rows = []
+        for key, node in list(self.nodes.items()):
+            frames = node[0]
+            if frames == 0:
+                node[6] += 1
+                if node[6] >= NODE_STATS_IDLE_WINDOWS:
+                    del self.nodes[key]
+                    continue
+            else:
+                node[6] = 0
+
+            # Source, frames and bytes per second, average RSSI, retry ratio and the time at which the last frame arrived
+            rows.append((key, frames / elapsed, node[1] / elapsed, float(node[2]) / frames if frames > 0 else None,
+                         float(node[3]) / frames if frames > 0 else 0.0, node[5] / 1000000.0))
+            node[0:4] = [0, 0, 0, 0]
+
+        rows.sort(key=lambda row: -row[1])
+        self.snapshot = (now, rows, self.untracked / elapsed)
+        self.untracked = 0
+        self.windowStart = now
+
+
+class NodeStatisticsView:
+    # Prints the busiest nodes of every new snapshot from its own thread, so the sniffer thread doesn't wait for the terminal
+    def __init__(self, statistics):
+        self.statistics = statistics
+        self.thread = threading.Thread(target=self.run)
+        self.thread.daemon = True
+        self.thread.start()
+
+    def run(self):
+        printed = None
+        while True:
+            time.sleep(self.statistics.window / 4.0)
+            windowEnd, rows, untracked = self.statistics.snapshot
+            if windowEnd == printed:
+                continue
+            printed = windowEnd
+
+            now = time.time()
+            lines = ['Node                                   Frames/s   Bytes/s  RSSI  Retries  Last seen']
+            for (pan, mode, address), frameRate, byteRate, rssi, retries, lastSeen in rows[:NODE_STATS_PRINTED]:
+                lines.append('{0:<36} {1:>10.1f} {2:>9.0f} {3:>5} {4:>7.1f}% {5:>9}'.format(
+                    formatNodeAddress(pan, mode, address), frameRate, byteRate, '%.0f' % rssi if rssi != None else '-',
+                    100 * retries, '%.0fs ago' % max(0, now - lastSeen)))
+            if len(rows) > NODE_STATS_PRINTED:
+                lines.append('... and ' + str(len(rows) - NODE_STATS_PRINTED) + ' other nodes')
+            if untracked > 0:
+                lines.append('%.1f frames/s came from nodes that did not fit in the table' % untracked)
+            print('\n'.join(lines) + '\n')
+
+
+def formatNodeAddress(pan, mode, address):
+    if mode == 3:
+        text = ':'.join('%02x' % ((address >> (8 * i)) & 0xff) for i in reversed(range(8)))
     else:
-        win32file.WriteFile(output, header)
-        win32file.WriteFile(output, packet)
+        text = '0x%04x' % address
+    return text + (' in PAN 0x%04x' % pan if pan != None else '')
+
+
+class MetricsRequestHandler(BaseHTTPRequestHandler):
+    def do_GET(self):
+        if self.path.split('?')[0] == '/trigger' and flightRecorder != None:
+            flightRecorder.trigger('a request from ' + self.client_address[0])
+            body = b'Triggered\n'
+            self.send_response(200)
+            self.send_header('Content-Type', 'text/plain; charset=utf-8')
+            self.send_header('Content-Length', str(len(body)))
+            self.end_headers()
+            self.wfile.write(body)
+            return
+        if self.path.split('?')[0] != '/metrics':
+            self.send_error(404)
+            return
+
+        body = metrics.render().encode('utf-8')
+        self.send_response(200)
+        self.send_header('Content-Type', 'text/plain; version=0.0.4; charset=utf-8')
+        self.send_header('Content-Length', str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    do_POST = do_GET  # An alarm system may only know how to post to /trigger
+
+    def log_message(self, format, *args):
+        pass  # Every scrape would otherwise print a line
+
+
+def startMetricsServer(address):
+    # Serves the metrics from its own thread, the sniffer thread only increments the counters
+    host, separator, port = address.rpartition(':')
+    server = HTTPServer((host, int(port)), MetricsRequestHandler)
+    thread = threading.Thread(target=server.serve_forever)
+    thread.daemon = True
+    thread.start()
+    return server
+
+
+def addSurveySamples(firstChannel, samples):
+    # Samples are taken on consecutive channels, going back to channel 11 after channel 26
+    channel = firstChannel
+    for sample in samples:
+        rssi = sample - 256 if sample >= 128 else sample
+        histogram = surveyHistograms.setdefault(channel, [0] * SURVEY_HISTOGRAM_BINS)
+        histogram[max(0, min(SURVEY_HISTOGRAM_BINS - 1, (rssi - SURVEY_HISTOGRAM_MIN) // SURVEY_HISTOGRAM_STEP))] += 1
+
+        # Amount of samples, amount of samples where the channel was busy and the highest RSSI
+        counters = surveyCounters.setdefault(channel, [0, 0, rssi])
+        counters[0] += 1
+        if rssi >= SURVEY_BUSY_THRESHOLD:
+            counters[1] += 1
+        counters[2] = max(counters[2], rssi)
+
+        channel = 11 if channel >= 26 else channel + 1
+
+
+def printSurveyHistograms():
+    labels = []
+    for i in range(SURVEY_HISTOGRAM_BINS):
+        low = SURVEY_HISTOGRAM_MIN + i * SURVEY_HISTOGRAM_STEP
+        if i == 0:
+            labels.append('<' + str(low + SURVEY_HISTOGRAM_STEP))
+        elif i == SURVEY_HISTOGRAM_BINS - 1:
+            labels.append('>=' + str(low))
+        else:
+            labels.append(str(low))
+
+    print('Channel  Samples    Busy  Max dBm  Samples per RSSI range (dBm)')
+    print(' ' * 35 + ' '.join('{0:>6}'.format(label) for label in labels))
+    for channel in sorted(surveyHistograms):
+        count, busy, maxRssi = surveyCounters[channel]
+        print('{0:>7}  {1:>7}  {2:>5.1f}%  {3:>7}  '.format(channel, count, 100.0 * busy / count, maxRssi)
+              + ' '.join('{0:>6}'.format(n) for n in surveyHistograms[channel]))
+
+
+def addSummary(data):
+    global summaryNextInterval
+    global summaryLost
+
+    if len(data) < SUMMARY_HEADER_LENGTH:
+        return
+
+    interval = (data[0] << 8) + data[1]
+    part = data[2]
+    partCount = data[3]
+    untracked = (data[4] << 8) + data[5]
+
+    # SUMMARY messages are not retransmitted, a gap in the interval numbers means that intervals are missing
+    if interval != summaryCurrent['interval']:
+        if summaryNextInterval != None and interval != summaryNextInterval:
+            lost = (interval - summaryNextInterval) & 0xffff
+            summaryLost += lost
+            print('WARNING: Lost the summary of ' + str(lost) + ' interval' + ('s' if lost > 1 else ''))
+        summaryCurrent.update({'interval': interval, 'parts': 0, 'frames': 0, 'links': 0})
+        summaryNextInterval = (interval + 1) & 0xffff
+
+    # Every part repeats the amount of frames that didn't fit in the table of the OpenMote
+    if part == 0:
+        summaryCurrent['frames'] += untracked
+    summaryCurrent['parts'] += 1
+
+    for pos in range(SUMMARY_HEADER_LENGTH, len(data) - SUMMARY_LINK_LENGTH + 1, SUMMARY_LINK_LENGTH):
+        link = data[pos:pos + SUMMARY_LINK_LENGTH]
+        frames = (link[19] << 8) + link[20]
+        rssi = link[27] - 256 if link[27] >= 128 else link[27]
+        counters = summaryLinks.setdefault(bytes(link[:SUMMARY_KEY_LENGTH]), [0, 0, 0, 0, 0])
+        counters[0] += frames
+        counters[1] += struct.unpack('>I', bytes(link[21:25]))[0]
+        counters[2] += (link[25] << 8) + link[26]
+        counters[3] += rssi * frames
+        counters[4] += link[28] * frames
+        summaryCurrent['frames'] += frames
+        summaryCurrent['links'] += 1
+
+    if part == partCount - 1:
+        frames = summaryCurrent['frames']
+        summaryRates.append(frames * 1000.0 / summaryInterval)
+        print('Interval ' + str(interval) + ': ' + str(frames) + ' frames on ' + str(summaryCurrent['links']) + ' links'
+              + (', ' + str(untracked) + ' frames on links that did not fit in the table' if untracked > 0 else '')
+              + ('' if summaryCurrent['parts'] == partCount else ' (incomplete, a part of the summary was lost)'))
+
+
+def addTopTalkers(data):
+    # The estimates of the OpenMote can be too high, but never too low, when the sources share the counters of its sketch
+    talkers = []
+    for pos in range(2, len(data) - TOP_TALKERS_ENTRY_LENGTH + 1, TOP_TALKERS_ENTRY_LENGTH):
+        key = bytes(data[pos:pos + TOP_TALKERS_KEY_LENGTH])
+        frames = (data[pos + TOP_TALKERS_KEY_LENGTH] << 8) + data[pos + TOP_TALKERS_KEY_LENGTH + 1]
+        counters = topTalkers.setdefault(key, [0, 0])
+        counters[0] += frames
+        counters[1] = max(counters[1], frames)
+        talkers.append((frames, key))
+
+    if len(talkers) > 0:
+        frames, key = max(talkers)
+        print('Interval ' + str((data[0] << 8) + data[1]) + ': top talker ' + formatTalker(key) + ' with ' + str(frames) + ' frames')
+
+
+def formatTalker(key):
+    key = bytearray(key)
+    return formatSummaryAddress(key[0], key[3:3 + (8 if key[0] == 3 else 2)]) + ' in PAN ' + '0x%02x%02x' % (key[2], key[1])
+
+
+def formatSummaryAddress(mode, address):
+    # The addresses are stored as in the frame, with the least significant byte first
+    if mode == 2:
+        return '0x%02x%02x' % (address[1], address[0])
+    if mode == 3:
+        return ':'.join('%02x' % byte for byte in reversed(address))
+    return '-'
+
+
+def printSummary():
+    print('Type    PAN     Source                   Destination               Frames       Bytes  FCS errors  RSSI  LQI')
+    frameTypes = dict((value, name) for name, value in FRAME_TYPES.items())
+    for key, counters in sorted(summaryLinks.items(), key=lambda item: -item[1][0]):
+        key = bytearray(key)
+        dstMode = (key[0] >> 4) & 0x03
+        srcMode = (key[0] >> 6) & 0x03
+        frames = counters[0]
+        print('{0:<7} {1:<7} {2:<24} {3:<24} {4:>7} {5:>11} {6:>11} {7:>5} {8:>4}'.format(
+            frameTypes.get(key[0] & 0x07, str(key[0] & 0x07)),
+            '0x%02x%02x' % (key[2], key[1]) if dstMode >= 2 or srcMode >= 2 else '-',
+            formatSummaryAddress(srcMode, key[11:11 + (8 if srcMode == 3 else 2)]),
+            formatSummaryAddress(dstMode, key[3:3 + (8 if dstMode == 3 else 2)]),
+            frames, counters[1], counters[2], counters[3] // frames, counters[4] // frames))
+
+    if len(topTalkers) > 0:
+        print('')
+        print('Top talkers                            Frames  Busiest interval')
+        for key, counters in sorted(topTalkers.items(), key=lambda item: -item[1][0])[:TOP_TALKERS_PRINTED]:
+            print('{0:<36} {1:>8} {2:>17}'.format(formatTalker(key), counters[0], counters[1]))
+
+    if len(summaryRates) == 0:
+        return
+
+    # How often each rate occurred, so that bursts stand out from the average
+    print('')
+    print('Frames per second   Intervals' + ('  (' + str(summaryLost) + ' intervals lost)' if summaryLost > 0 else ''))
+    step = max(1.0, max(summaryRates) / SUMMARY_RATE_BINS)
+    histogram = [0] * SUMMARY_RATE_BINS
+    for rate in summaryRates:
+        histogram[min(SUMMARY_RATE_BINS - 1, int(rate / step))] += 1
+    for i in range(SUMMARY_RATE_BINS):
+        print('{0:>8.0f} - {1:<8.0f} {2:>9}  {3}'.format(i * step, (i + 1) * step, histogram[i],
+                                                        '#' * (histogram[i] * 50 // len(summaryRates))))
 
 
 def calcRadioCRC(msg):
-    crc = 0x0000
-    for val in msg:
-        crc = precompiled_crc16_table[(crc ^ val) & 0xff] ^ (crc >> 8)
-    return crc
-    crc ^= 0xFFFF
-    return crc ^ 0xffff
+    msg = bytes(msg)
+    if hostLibrary != None:
+        return hostLibrary.snifferHostCalculateRadioCrc(msg, len(msg))
+
+    # The FCS is CRC-16/KERMIT, which is CRC-16/XMODEM (as calculated by crc_hqx) with the bits of every byte reversed
+    crc = binascii.crc_hqx(msg.translate(bytes(BIT_REVERSED_BYTES)), 0)
+    return (BIT_REVERSED_BYTES[crc & 0xff] << 8) + BIT_REVERSED_BYTES[crc >> 8]
 
 
 def calcCRC(msg):
+    if hostLibrary != None:
+        msg = bytes(msg)
+        return hostLibrary.snifferHostCalculateCrc(1 if hardwareCRC else 0, msg, len(msg), 0xFFFF)
+
+    # The serial CRC mixes the table of the radio CRC with shifting to the left, no standard CRC function matches it
     crc = 0xFFFF
+
+    # Firmware build with SERIAL_HARDWARE_CRC uses the CRC engine of the CC2538, with polynomial x^16 + x^15 + x^2 + 1
+    if hardwareCRC:
+        for c in msg:
+            crc ^= c << 8
+            for i in range(8):
+                crc = ((crc << 1) ^ 0x8005) & 0xFFFF if crc & 0x8000 else (crc << 1) & 0xFFFF
+        return crc
+
     for c in msg:
         crc = precompiled_crc16_table[c ^ ((crc >> 8) & 0xFF)] ^ ((crc << 8) & 0xFFFF)
     return crc
 
 
-def decode(msg, quiet=False):
-    escaped = False
+def unescape(msg):
+    # Every part after an escape byte starts with an escaped byte, consecutive escape bytes leave empty parts
+    parts = bytes(msg).split(HDLC_ESCAPE_BYTE)
+    result = bytearray(parts[0])
+    for part in parts[1:]:
+        if len(part) > 0:
+            result.append(bytearray(part[:1])[0] ^ HDLC_ESCAPE_MASK)
+            result.extend(part[1:])
+    return result
+
+
+def decodeCobs(msg):
+    # Each code byte tells where the next zero was, except after a full block that wasn't followed by a zero
+    data = bytearray(bytes(msg).translate(COBS_XOR_TABLE))
     result = bytearray()
-    for c in msg:
-        if c == HDLC_ESCAPE:
-            escaped = True
-            continue
-        else:
-            if escaped:
-                result.append(c ^ HDLC_ESCAPE_MASK)
-                escaped = False
-            else:
-                result.append(c)
+    pos = 0
+    while pos < len(data):
+        code = data[pos]
+        if code == 0 or pos + code > len(data):
+            return None
+        result.extend(data[pos + 1:pos + code])
+        pos += code
+        if code != COBS_MAX_BLOCK_LEN and pos < len(data):
+            result.append(0)
+    return result
+
+
+def hasValidCRC(result):
+    return len(result) >= 4 and calcCRC(result[:-2]) == ((result[-2] << 8) + result[-1])
+
+
+def decode(msg, quiet=False):
+    # The messages that the OpenMote sends itself, and the records that it encoded before switching, are still HDLC framed
+    result = decodeCobs(msg) if cobsFraming else None
+    if result == None or not hasValidCRC(result):
+        result = unescape(msg)
 
     if len(result) < 4:
         if enableWarnings and not quiet:
             print('WARNING: Received message too short')
         return ''
 
-    if calcCRC(result[:-2]) != ((result[-2] << 8) + result[-1]):
+    if not hasValidCRC(result):
         if enableWarnings and not quiet:
             print('WARNING: Received message had incorrect serial CRC')
         return ''
 
-    if result[0] != SerialDataType.Packet and result[0] != SerialDataType.Ready:
+    # Only the messages with records can ask for an ACK, processPacket takes the flag off
+    dataType = result[0]
+    if dataType & ~ACK_REQUESTED in (SerialDataType.Packet, SerialDataType.PacketBatch, SerialDataType.Survey):
+        dataType &= ~ACK_REQUESTED
+
+    if dataType not in (SerialDataType.Packet, SerialDataType.PacketBatch, SerialDataType.Ready, SerialDataType.FilterStats,
+                         SerialDataType.Survey, SerialDataType.Stats, SerialDataType.FlashLog, SerialDataType.Baudrate,
+                         SerialDataType.Zep, SerialDataType.Integrity, SerialDataType.Sync, SerialDataType.Resume,
+                         SerialDataType.Summary, SerialDataType.TopTalkers, SerialDataType.Trigger, SerialDataType.Epoch,
+                         SerialDataType.Recovery, SerialDataType.Tsch, SerialDataType.Inject, SerialDataType.Degradation,
+                         SerialDataType.Control, SerialDataType.Superframe, SerialDataType.AdaptiveHop,
+                         SerialDataType.Latency, SerialDataType.Trace, SerialDataType.Fec, SerialDataType.Identify):
         if enableWarnings and not quiet:
             print('WARNING: Received message had invalid type')
         return ''
@@ -281,14 +3536,45 @@ def decode(msg, quiet=False):
             print('WARNING: Received message had incorrect length byte')
         return ''
 
-    if result[0] == SerialDataType.Packet and len(result) < 8:
+    if dataType == SerialDataType.Packet and len(result) < DATA_OFFSET + 2:
         if enableWarnings and not quiet:
             print('WARNING: Received message too short for type Packet')
         return ''
 
+    if dataType == SerialDataType.Survey and len(result) < DATA_OFFSET + 3:
+        if enableWarnings and not quiet:
+            print('WARNING: Received message too short for type Survey')
+        return ''
+
+    if dataType == SerialDataType.PacketBatch and len(result) < DATA_OFFSET + 3:
+        if enableWarnings and not quiet:
+            print('WARNING: Received message too short for type PacketBatch')
+        return ''
+
+    # The padding of encrypted records is only known after decrypting them
+    if dataType in (SerialDataType.Packet, SerialDataType.Survey) and moteSupports(CAPABILITY_ALIGNED_RECORDS) and encryptionKey == None:
+        record = removeRecordPadding(result[:-2])
+        if record == None:
+            if enableWarnings and not quiet:
+                print('WARNING: Received record had incorrect padding')
+            return ''
+        return record
+
     return result[:-2]
 
 
+def removeRecordPadding(msg):
+    # Gives a record with the word-aligned layout the layout of a Packet message without padding, returns None when the
+    # padding can't be right. The padding byte in front of the data and the padding behind the record are removed.
+    padding = msg[PADDING_OFFSET]
+    if padding >= RECORD_ALIGNMENT or len(msg) < DATA_OFFSET + 2 + padding:
+        return None
+
+    record = msg[:PADDING_OFFSET] + msg[PADDING_OFFSET+1:len(msg)-padding]
+    record[1] = len(record)
+    return record
+
+
 def encodeByte(byte):
     if byte == HDLC_FLAG or byte == HDLC_ESCAPE:
         return [HDLC_ESCAPE, byte ^ HDLC_ESCAPE_MASK]
@@ -329,284 +3615,4547 @@ def serialWriteNack(lastIndex, lastSeqNr):
                                       (lastSeqNr >> 8) & 0xff, lastSeqNr & 0xff])
 
 
-def serialWriteStop():
-    try:
-        serialWrite(SerialDataType.Stop, [])
-    except:
-        pass
+def serialWriteResume(lastIndex, lastSeqNr):
+    serialWrite(SerialDataType.Resume, [(lastIndex >> 8) & 0xff, lastIndex & 0xff,
+                                        (lastSeqNr >> 8) & 0xff, lastSeqNr & 0xff])
 
 
-class PacketProcessor:
-    def __init__(self, discardPacketsWithBadCRC, replaceFCS):
-        self.discardPacketsWithBadCRC = discardPacketsWithBadCRC
-        self.replaceFCS = replaceFCS
-        self.resetVariables()
+def serialWriteChannel(channel):
+    # The OpenMote switches between two frames, the records from the old channel are still delivered
+    serialWrite(SerialDataType.SetChannel, [channel])
 
-    def resetVariables(self):
-        self.unackedByteCount = 0
-        self.lastIndex = 0
-        self.lastSeqNr = 0
-        self.expectedSeqNr = 0
-        self.retransmission = False
 
-    def serialWriteAck(self):
-        if self.unackedByteCount >= ACK_THRESHOLD:
-            self.unackedByteCount = 0
-            serialWriteAck(self.lastIndex, self.lastSeqNr)
+def serialWriteSelectiveNack(lastIndex, lastSeqNr, count):
+    serialWrite(SerialDataType.SelectiveNack, [(lastIndex >> 8) & 0xff, lastIndex & 0xff,
+                                               (lastSeqNr >> 8) & 0xff, lastSeqNr & 0xff,
+                                               (count >> 8) & 0xff, count & 0xff])
 
-    def ackUnackedBytes(self):
-        if self.unackedByteCount > 0:
-            self.unackedByteCount = ACK_THRESHOLD
-            self.serialWriteAck()
 
-    def processPacket(self, msg):
-        if len(msg) == 0: # Message was invalid (e.g. wrong serial CRC)
-            serialWriteNack(self.lastIndex, self.lastSeqNr)
-            return True
+def serialWriteCumulativeAck(lastIndex, lastSeqNr, missing):
+    serialWrite(SerialDataType.CumulativeAck, [(lastIndex >> 8) & 0xff, lastIndex & 0xff,
+                                               (lastSeqNr >> 8) & 0xff, lastSeqNr & 0xff,
+                                               (missing >> 24) & 0xff, (missing >> 16) & 0xff,
+                                               (missing >> 8) & 0xff, missing & 0xff])
 
-        if msg[0] == SerialDataType.Ready:
-            print('WARNING: Sniffer reset detected, restarting')
+
+def parseHopSchedule(text, dwellTimeMs):
+    channels = []
+    for part in text.split(','):
+        if '-' in part:
+            first, last = part.split('-', 1)
+            channels.extend(range(int(first), int(last) + 1))
+        else:
+            channels.append(int(part))
+
+    if len(channels) == 0 or len(channels) > HOP_MAX_CHANNELS:
+        raise ValueError('Between 1 and ' + str(HOP_MAX_CHANNELS) + ' channels have to be given')
+    for channel in channels:
+        if channel < 11 or channel > 26:
+            raise ValueError('Channel ' + str(channel) + ' is not between 11 and 26')
+        if channels.count(channel) > 1:
+            raise ValueError('Channel ' + str(channel) + ' is given more than once')
+
+    dwellTime = (dwellTimeMs * 1000 + HOP_TIME_UNIT // 2) // HOP_TIME_UNIT
+    if dwellTime < 2 or dwellTime > 0xffff:
+        raise ValueError('Dwell time should be between 2 and 67000 milliseconds')
+
+    return [(channel, dwellTime) for channel in channels]
+
+
+def serialWriteControl(dataType, msg, description):
+    # Sends the message in CONTROL chunks and returns whether the OpenMote accepted it, or None when it didn't answer. Firmware
+    # without CONTROL gets the message on its own as before, without an answer.
+    global controlCommand
+    if not moteSupports(CAPABILITY_CONTROL):
+        if len(msg) + 4 > SERIAL_RX_MAX_MESSAGE_LEN:
+            print('WARNING: The firmware of the OpenMote can not receive ' + description + ' of this size, continuing without it')
             return False
+        serialWrite(dataType, msg)
+        return None
 
-        # Ignore the packet if it had a wrong sequence number
+    message = bytearray([dataType, len(msg) + 2]) + bytearray(msg)
+    crc = calcCRC(message)
+    message += bytearray([(crc >> 8) & 0xff, crc & 0xff])
+
+    controlCommand = (controlCommand + 1) & 0xff
+    offset = 0
+    attempts = 0
+    while attempts < CONTROL_ATTEMPTS:
+        serialWrite(SerialDataType.Control, [controlCommand, (offset >> 8) & 0xff, offset & 0xff]
+                                            + list(message[offset:offset + CONTROL_CHUNK_LEN]))
+        answer = waitForControlAnswer(controlCommand)
+        if answer == None:
+            attempts += 1
+            continue
+
+        status, received = answer
+        if status == CONTROL_STATUS_ACCEPTED:
+            return True
+        if status == CONTROL_STATUS_REJECTED:
+            print('WARNING: The OpenMote rejected ' + description)
+            return False
+
+        # Continue behind the bytes that the OpenMote has, a chunk that it had to ask for again counts as a failed attempt
+        if status == CONTROL_STATUS_RESEND or received <= offset:
+            attempts += 1
+        offset = min(received, len(message) - 1)
+
+    print('WARNING: The OpenMote did not confirm ' + description)
+    return None
+
+
+def waitForControlAnswer(command):
+    # Returns the status and the amount of received bytes from the answer to a chunk of the command, answers to earlier
+    # commands that arrive late are skipped
+    begin = time.time()
+    while time.time() - begin < CONTROL_TIMEOUT:
+        msg = waitForMessage([SerialDataType.Control], CONTROL_TIMEOUT - (time.time() - begin))
+        if msg == None:
+            return None
+        if len(msg) >= 6 and msg[2] == command:
+            return msg[3], (msg[4] << 8) + msg[5]
+    return None
+
+
+def serialWriteFilterRules():
+    for i in range(len(filterRules)):
+        serialWriteControl(SerialDataType.Filter, [i] + filterRules[i], 'filter rule ' + str(i))
+
+    if filterProgram != None and moteSupports(CAPABILITY_FILTER_PROGRAM, '--filter-program'):
+        serialWriteControl(SerialDataType.FilterProgram, filterProgram, 'the filter program')
+
+
+def serialWriteDecryptionKeys():
+    for i in range(len(decryptionKeys)):
+        serialWriteControl(SerialDataType.Key, [i] + decryptionKeys[i], 'key ' + str(i))
+
+
+def serialWriteIntegrity():
+    if integrityKey != None:
+        serialWrite(SerialDataType.Integrity, [(checkpointInterval >> 8) & 0xff, checkpointInterval & 0xff] + list(integrityKey))
+
+
+def serialWriteEncryption():
+    # Send in front of the RESET, so that the first record of the capture is already encrypted. The OpenMote keeps encrypting
+    # the captures after it until it is told to stop. Returns False when the records wouldn't be encrypted.
+    if encryptionKey == None:
+        if moteSupports(CAPABILITY_ENCRYPTION):
+            serialWriteControl(SerialDataType.Encryption, [0] * (1 + ENCRYPTION_KEY_LEN + ENCRYPTION_NONCE_LEN), 'stopping the encryption')
+        return True
+
+    if not moteSupports(CAPABILITY_ENCRYPTION):
+        print('ERROR: The firmware of the OpenMote can not encrypt the records')
+        return False
+    if serialWriteControl(SerialDataType.Encryption, [1] + list(encryptionKey) + list(encryptionNonce), 'the encryption key') != True:
+        print('ERROR: The OpenMote did not confirm that it encrypts the records')
+        return False
+    return True
+
+
+def serialWriteHopSchedule():
+    for i in range(len(hopSchedule)):
+        channel, dwellTime = hopSchedule[i]
+        serialWriteControl(SerialDataType.Hop, [i, len(hopSchedule), channel, (dwellTime >> 8) & 0xff, dwellTime & 0xff],
+                           'hop entry ' + str(i))
+
+    # The whole schedule has to be known before the OpenMote can divide its time
+    if len(hopSchedule) > 0 and adaptiveMinDwellTime != None and moteSupports(CAPABILITY_ADAPTIVE_HOP, '--adaptive-dwell'):
+        serialWriteControl(SerialDataType.AdaptiveHop, [(adaptiveMinDwellTime >> 8) & 0xff, adaptiveMinDwellTime & 0xff],
+                           'adaptive dwell times')
+
+
+def parseAdaptiveDwellTime(minDwellTimeMs):
+    minDwellTime = (minDwellTimeMs * 1000 + HOP_TIME_UNIT // 2) // HOP_TIME_UNIT
+    if minDwellTime < 2 or minDwellTime > 0xffff:
+        raise ValueError('Minimum dwell time should be between 2 and 67000 milliseconds')
+
+    # Every channel is visited once per cycle, which keeps the length of the fixed schedule
+    if minDwellTime * len(hopSchedule) > sum(dwellTime for channel, dwellTime in hopSchedule):
+        raise ValueError('The minimum dwell time of every channel together is longer than a cycle through the channels with --dwell')
+
+    return minDwellTime
+
+
+def receivedAdaptiveHop(data):
+    if len(data) < 1 or len(data) < 1 + data[0] * ADAPTIVE_HOP_ENTRY_LENGTH:
+        return
+
+    entries = []
+    for i in range(data[0]):
+        channel, dwellTime, frameRate, rssi = struct.unpack('>BHHb', bytes(data[1 + i * ADAPTIVE_HOP_ENTRY_LENGTH:
+                                                                              1 + (i + 1) * ADAPTIVE_HOP_ENTRY_LENGTH]))
+        entries.append((channel, dwellTime, frameRate / 16.0, rssi))
+
+    # The share of the cycle that the radio spends on a channel is the chance that a frame on it is captured
+    cycleTime = sum(dwellTime for channel, dwellTime, frameRate, rssi in entries)
+    if cycleTime == 0:
+        return
+    print('Adaptive dwell times over a cycle of %d ms:' % (cycleTime * HOP_TIME_UNIT // 1000))
+    for channel, dwellTime, frameRate, rssi in entries:
+        print('  channel %d: %d ms, coverage %.1f%%, %.1f frames/s, %d dBm'
+              % (channel, dwellTime * HOP_TIME_UNIT // 1000, 100.0 * dwellTime / cycleTime, frameRate, rssi))
+
+
+def parseTschRequest(channelOffset, pan, sequence):
+    # The channel offset of the beacon is followed unless another one is given
+    if channelOffset == 'beacon':
+        channelOffset = TSCH_CHANNEL_OFFSET_FROM_BEACON
+    else:
+        channelOffset = int(channelOffset, 0)
+        if channelOffset < 0 or channelOffset >= TSCH_MAX_SEQUENCE_LEN:
+            raise ValueError('Channel offset should be between 0 and ' + str(TSCH_MAX_SEQUENCE_LEN - 1))
+
+    pan = TSCH_ANY_PAN if pan == None else int(pan, 0)
+    if pan < 0 or pan > 0xffff:
+        raise ValueError('PAN should be a 16-bit number')
+
+    channels = [] if sequence == None else [int(channel) for channel in sequence.split(',')]
+    if len(channels) > TSCH_MAX_SEQUENCE_LEN:
+        raise ValueError('The hopping sequence can have at most ' + str(TSCH_MAX_SEQUENCE_LEN) + ' channels')
+    for channel in channels:
+        if channel < 11 or channel > 26:
+            raise ValueError('Channel ' + str(channel) + ' is not between 11 and 26')
+    if channelOffset != TSCH_CHANNEL_OFFSET_FROM_BEACON and channels and channelOffset >= len(channels):
+        raise ValueError('Channel offset should be smaller than the length of the hopping sequence')
+
+    return [channelOffset, (pan >> 8) & 0xff, pan & 0xff, len(channels)] + channels + [0] * (TSCH_MAX_SEQUENCE_LEN - len(channels))
+
+
+def serialWriteTsch():
+    if tschRequest != None and moteSupports(CAPABILITY_TSCH, '--tsch'):
+        serialWrite(SerialDataType.Tsch, tschRequest)
+
+
+def receivedTsch(data):
+    if len(data) != TSCH_REPORT_LENGTH:
+        return
+
+    locked = data[0]
+    asn = (data[1] << 32) + struct.unpack('>I', bytes(data[2:6]))[0]
+    channelOffset, sequenceLength = data[10], data[11]
+    timeslotLength = (data[12] << 8) + data[13]
+    if locked:
+        print('Following the TSCH network from ASN ' + str(asn) + ': channel offset ' + str(channelOffset) + ' of a hopping sequence of '
+              + str(sequenceLength) + ' channels, timeslots of ' + str(timeslotLength / 1000.0) + ' ms')
+    else:
+        print('WARNING: Lost the TSCH network at ASN ' + str(asn) + ', waiting for its next enhanced beacon')
+
+
+def parseSuperframeRequest(pan, guardTime):
+    pan = SUPERFRAME_ANY_PAN if pan == 'any' else int(pan, 0)
+    if pan < 0 or pan > 0xffff:
+        raise ValueError('PAN ID should be between 0 and 0xffff')
+    if guardTime < 0 or guardTime > 0xffff:
+        raise ValueError('Guard time should be between 0 and 65535 microseconds')
+
+    return [(pan >> 8) & 0xff, pan & 0xff, (guardTime >> 8) & 0xff, guardTime & 0xff]
+
+
+def serialWriteSuperframe():
+    if superframeRequest != None and moteSupports(CAPABILITY_SUPERFRAME, '--superframe'):
+        serialWrite(SerialDataType.Superframe, superframeRequest)
+
+
+def receivedSuperframe(data):
+    if len(data) != SUPERFRAME_REPORT_LENGTH:
+        return
+
+    locked, beaconOrder, superframeOrder = data[0], data[1], data[2]
+    pan = (data[3] << 8) + data[4]
+    if locked:
+        interval = (SUPERFRAME_BASE_DURATION << beaconOrder) / 1000.0
+        duration = (SUPERFRAME_BASE_DURATION << superframeOrder) / 1000.0
+        print('Following the superframes of PAN 0x%04x: active for %.2f ms of every %.2f ms' % (pan, duration, interval))
+    else:
+        print('WARNING: Lost the superframes of PAN 0x%04x, listening until the next beacon' % pan)
+
+
+def receivedDegradation(data):
+    if len(data) != DEGRADATION_REPORT_LENGTH or data[0] >= len(DEGRADATION_LEVELS):
+        return
+
+    level = data[0]
+    firstSeqNr = (data[1] << 8) + data[2]
+    bytesUsed = (data[3] << 8) + data[4]
+    if metrics != None:
+        metrics.degradationLevel = level
+
+    # The change is kept in the capture so that the truncated frames and missing ACKs behind it can be explained
+    if pcapngOutput:
+        outputPcapngBlock(PCAPNG_CUSTOM_BLOCK, struct.pack('>IB', PCAPNG_CUSTOM_PEN, SerialDataType.Degradation) + bytearray(data))
+
+    print(('WARNING: The OpenMote is capturing ' if level > 0 else 'The OpenMote is back to capturing ') + DEGRADATION_LEVELS[level]
+          + ' from record ' + str(firstSeqNr) + ' on, ' + str(bytesUsed) + ' bytes were waiting in its buffer')
+
+
+def readInjectFrames(filename, backToBack):
+    # Reads the frames of a pcap or pcapng file, each with the time since the previous frame in microseconds.
+    # The FCS is left out as the radio adds it, frames that don't fit in an INJECT message are skipped.
+    with open(filename, 'rb') as f:
+        data = f.read()
+
+    timestamps = []
+    frames = []
+    skipped = 0
+    magic = data[0:4]
+    if magic in (b'\xa1\xb2\xc3\xd4', b'\xd4\xc3\xb2\xa1', b'\xa1\xb2\x3c\x4d', b'\x4d\x3c\xb2\xa1'):
+        # The magic number also tells whether the timestamps are in microseconds or in nanoseconds
+        endian = '>' if magic[0:1] == b'\xa1' else '<'
+        fraction = 1000 if magic in (b'\xa1\xb2\x3c\x4d', b'\x4d\x3c\xb2\xa1') else 1
+        if len(data) < 24:
+            raise ValueError('the pcap header is incomplete')
+        linkType = struct.unpack_from(endian + 'I', data, 20)[0] & 0xffff
+        if linkType not in (LINKTYPE_IEEE802_15_4_WITHFCS, LINKTYPE_IEEE802_15_4_NOFCS):
+            raise ValueError('link type ' + str(linkType) + ' is not IEEE 802.15.4')
+
+        pos = 24
+        while pos + 16 <= len(data):
+            seconds, subseconds, savedLength, originalLength = struct.unpack_from(endian + 'IIII', data, pos)
+            frame = bytearray(data[pos+16:pos+16+savedLength])
+            pos += 16 + savedLength
+            if linkType == LINKTYPE_IEEE802_15_4_WITHFCS:
+                frame = frame[:-2]
+            timestamps.append(seconds * 1000000 + subseconds // fraction)
+            frames.append(frame)
+
+    elif magic == b'\x0a\x0d\x0d\x0a':
+        interfaces = []  # Link type and timestamp units per second of every interface in the section
+        endian = '>'
+        pos = 0
+        while pos + 12 <= len(data):
+            if data[pos:pos+4] == b'\x0a\x0d\x0d\x0a':
+                endian = '>' if data[pos+8:pos+12] == b'\x1a\x2b\x3c\x4d' else '<'
+                interfaces = []
+            blockType, blockLength = struct.unpack_from(endian + 'II', data, pos)
+            if blockLength < 12 or pos + blockLength > len(data):
+                break
+            body = data[pos+8:pos+blockLength-4]
+            pos += blockLength
+
+            if blockType == 0x00000001 and len(body) >= 8:
+                # The if_tsresol option gives the timestamp resolution, microseconds by default
+                unitsPerSecond = 1000000
+                option = 8
+                while option + 4 <= len(body):
+                    code, length = struct.unpack_from(endian + 'HH', body, option)
+                    if code == 0:
+                        break
+                    if code == 9 and length >= 1:
+                        resolution = bytearray(body[option+4:option+5])[0]
+                        unitsPerSecond = (2 ** (resolution & 0x7f)) if resolution & 0x80 else (10 ** resolution)
+                    option += 4 + length + (4 - length % 4) % 4
+                interfaces.append((struct.unpack_from(endian + 'H', body, 0)[0], unitsPerSecond))
+
+            elif blockType == 0x00000006 and len(body) >= 20:
+                interface, timestampHigh, timestampLow, savedLength = struct.unpack_from(endian + 'IIII', body, 0)
+                if interface >= len(interfaces):
+                    continue
+                linkType, unitsPerSecond = interfaces[interface]
+                frame = bytearray(body[20:20+savedLength])
+                fcsLength = 2
+                if linkType == LINKTYPE_IEEE802_15_4_TAP:
+                    # The TLVs behind the TAP header are little endian, the FCS type TLV tells whether the frame has an FCS
+                    headerLength = struct.unpack_from('<H', bytes(frame), 2)[0] if len(frame) >= 4 else len(frame)
+                    tlv = 4
+                    while tlv + 4 <= headerLength:
+                        tlvType, tlvLength = struct.unpack_from('<HH', bytes(frame), tlv)
+                        if tlvType == 0 and tlvLength >= 1:
+                            fcsLength = {0: 0, 1: 2, 2: 4}.get(frame[tlv+4], 2)
+                        tlv += 4 + tlvLength + (4 - tlvLength % 4) % 4
+                    frame = frame[headerLength:]
+                elif linkType == LINKTYPE_IEEE802_15_4_NOFCS:
+                    fcsLength = 0
+                elif linkType != LINKTYPE_IEEE802_15_4_WITHFCS:
+                    continue
+                frame = frame[:len(frame)-fcsLength]
+                timestamps.append((((timestampHigh << 32) | timestampLow) * 1000000) // unitsPerSecond)
+                frames.append(frame)
+    else:
+        raise ValueError('it is not a pcap or pcapng file')
+
+    result = []
+    previous = None
+    for timestamp, frame in zip(timestamps, frames):
+        # In the worst case every byte of the other fields of the message is escaped
+        escapedBytes = sum(1 for byte in frame if byte in (HDLC_FLAG, HDLC_ESCAPE))
+        if len(frame) < 1 or len(frame) > INJECT_MAX_FRAME_LEN or 2 + 2 * 11 + len(frame) + escapedBytes > INJECT_MAX_MESSAGE_BYTES:
+            skipped += 1
+            continue
+
+        # The times are kept between the SFDs, which is also the distance between the timestamps of a capture
+        delay = 0 if previous == None or backToBack else min(max(timestamp - previous, 0), 0xffffffff)
+        previous = timestamp
+        result.append((delay, frame))
+
+    if skipped > 0:
+        print('WARNING: Skipped ' + str(skipped) + ' frames of ' + filename + ' that are empty or too long to inject')
+    return result
+
+
+class FecDecoder:
+    # Keeps the packets with records since the last FEC message, as they were decoded. The parity is the XOR of all packets of
+    # the group, so when exactly one of them is missing (because it failed its crc or never arrived) the XOR of the parity and
+    # the others gives it back. The crc of the rebuilt packet tells whether the group was the one that the OpenMote meant.
+    def __init__(self):
+        self.packets = []
+
+    def add(self, msg):
+        if len(msg) > 0 and msg[0] & ~ACK_REQUESTED in (SerialDataType.Packet, SerialDataType.PacketBatch, SerialDataType.Survey):
+            self.packets.append(bytearray(msg))
+
+    def repair(self, msg):
+        global fecRepairedPackets
+
+        # Returns the packet that was missing from the group of the FEC message, or None when nothing could be repaired
+        count = msg[2]
+        packets = self.packets
+        self.packets = []
+        if len(packets) != count - 1:
+            return None
+
+        packet = bytearray(msg[3:-2])
+        for received in packets:
+            for i in range(min(len(received), len(packet))):
+                packet[i] ^= received[i]
+
+        if len(packet) < 4 or packet[1] + 2 > len(packet):
+            return None
+        packet = packet[:packet[1] + 2]
+        if not hasValidCRC(packet):
+            return None
+
+        fecRepairedPackets += 1
+        return packet
+
+
+class RtosTraceWriter:
+    # Writes the events of the trace recorder of the firmware (make TRACE=TRUE) to a text file, one line per event with the
+    # cycle count (counted on past the 32-bit wrap-around), the event and its argument. rtos-trace.py turns it into a timeline.
+    def __init__(self, path):
+        self.output = open(path, 'w')
+        self.output.write('# OpenMote trace, cycles at ' + str(RTOS_TRACE_CLOCK_HZ) + ' Hz: cycles event argument\n')
+        self.lastCycles = None
+        self.wraps = 0
+        self.events = 0
+        self.lost = 0
+
+    def received(self, data):
+        if self.output.closed or len(data) < 2 or (len(data) - 2) % RTOS_TRACE_EVENT_LENGTH != 0:
+            return
+
+        lost = (data[0] << 8) | data[1]
+        if lost > 0:
+            self.lost += lost
+            self.output.write('lost ' + str(lost) + '\n')
+
+        for offset in range(2, len(data), RTOS_TRACE_EVENT_LENGTH):
+            cycles = struct.unpack('>I', bytes(data[offset:offset + 4]))[0]
+            if self.lastCycles != None and cycles < self.lastCycles:
+                self.wraps += 1
+            self.lastCycles = cycles
+            self.output.write('%d %d %d\n' % ((self.wraps << 32) + cycles, data[offset + 4], data[offset + 5]))
+            self.events += 1
+
+        self.output.flush()
+
+    def close(self):
+        if self.output.closed:
+            return
+
+        self.output.close()
+        print('Trace: ' + str(self.events) + ' events written, ' + str(self.lost) + ' lost because the ring of the OpenMote was full')
+
+
+class FrameInjector:
+    # Lets the OpenMote transmit the frames of a capture file while it keeps capturing. Only the messages from the OpenMote are
+    # acknowledged, so every INJECT message has an id and the OpenMote reports whether it queued the frame. After a lost message
+    # it rejects the frames behind it until the expected id arrives again, those frames are then send again starting at that id.
+    # It answers at most a few places in its queue, which limits the frames that are send before being confirmed.
+    def __init__(self, frames, cca, timeline=False, repeat=1):
+        self.frames = frames * repeat  # (microseconds after the SFD of the previous frame, frame without FCS)
+        self.flags = (INJECT_FLAG_CCA if cca else 0) | (INJECT_FLAG_TIMELINE if timeline else 0)
+        self.finished = 0  # Frames of which the OpenMote reported the outcome, or of which a later frame was reported
+        self.sentCount = 0
+        self.busyCount = 0
+        self.stopped = False
+        self.deviations = []  # Microseconds that the SFD of every transmitted frame was later than the file asked for
+
+        # Start of every frame in the file, measured from the start of the first one
+        self.offsets = []
+        offset = 0
+        for delay, frame in self.frames:
+            offset += delay
+            self.offsets.append(offset)
+
+        self.reset()
+
+    def reset(self):
+        # The OpenMote counts the ids from 0 after every RESET, the frames that it queued without transmitting them are lost
+        self.base = self.finished
+        self.next = self.finished  # Frame that is send next
+        self.accepted = self.finished  # Frames before this one were queued by the OpenMote
+        self.freePlaces = 1  # Places in the queue of the OpenMote after the accepted frames, until the first report arrives
+        self.sendNumber = 0
+        self.sendNumbers = {}  # When each frame that is not yet accepted was send, to ignore rejections from before going back
+        self.rewindNumber = 0
+        self.lastReport = time.time()
+        self.anchor = None  # Index and SFD time of the first frame that was transmitted after the reset
+        self.previousSent = None  # Index and SFD time of the last frame that was transmitted
+
+    def restart(self):
+        if not self.stopped and self.finished < len(self.frames):
+            self.reset()
+            self.send()
+
+    def index(self, frameId):
+        # The ids are 16-bit, a report is about a frame near the ones that were send
+        offset = (frameId - (self.next - self.base)) & 0xffff
+        if offset >= 0x8000:
+            offset -= 0x10000
+        return self.next + offset
+
+    def message(self, index):
+        delay, frame = self.frames[index]
+        frameId = (index - self.base) & 0xffff
+        msg = bytearray([(frameId >> 8) & 0xff, frameId & 0xff]) + bytearray(struct.pack('>I', delay)) + bytearray([self.flags])
+        return msg + frame
+
+    def send(self, force=False):
+        unconfirmedBytes = 0
+        for index in range(self.accepted, self.next):
+            unconfirmedBytes += len(encode(bytearray([SerialDataType.Inject, 0]) + self.message(index)))
+
+        while not self.stopped and self.next < len(self.frames):
+            if self.next - self.accepted >= self.freePlaces and not force:
+                break
+
+            msg = self.message(self.next)
+            size = len(encode(bytearray([SerialDataType.Inject, len(msg) + 2]) + msg))
+            if unconfirmedBytes > 0 and unconfirmedBytes + size > INJECT_MAX_UNCONFIRMED_BYTES:
+                break
+
+            serialWrite(SerialDataType.Inject, msg)
+            self.sendNumbers[self.next] = self.sendNumber
+            self.sendNumber += 1
+            self.next += 1
+            unconfirmedBytes += size
+            force = False
+
+    def goBack(self):
+        # The frames that were send before going back are rejected as well, only the first rejection counts
+        self.next = self.accepted
+        self.rewindNumber = self.sendNumber
+
+    def received(self, data):
+        if len(data) != INJECT_REPORT_LENGTH or self.stopped:
+            return
+
+        frameId, status, freePlaces, nextId, sfdTime = struct.unpack('>HBBHI', bytes(data))
+        self.lastReport = time.time()
+        if status == INJECT_STATUS_UNAVAILABLE:
+            print('ERROR: The OpenMote can not inject frames while it hops between channels, follows a TSCH network or surveys')
+            self.stopped = True
+            return
+
+        index = self.index(frameId)
+        accepted = self.index(nextId)
+        if accepted >= self.accepted:
+            self.accepted = accepted
+            self.freePlaces = freePlaces
+            for sent in [sent for sent in self.sendNumbers if sent < accepted]:
+                del self.sendNumbers[sent]
+        if self.next < self.accepted:
+            self.next = self.accepted
+
+        if status in (INJECT_STATUS_SENT, INJECT_STATUS_BUSY) and index >= self.finished:
+            if status == INJECT_STATUS_SENT:
+                self.sentCount += 1
+                self.measureTiming(index, sfdTime)
+            else:
+                self.busyCount += 1
+            self.finished = index + 1
+            if self.finished == len(self.frames):
+                self.printSummary()
+
+        elif status == INJECT_STATUS_REJECTED and self.sendNumbers.get(index, -1) >= self.rewindNumber:
+            self.goBack()
+
+        self.send()
+
+    def poll(self):
+        # A lost message or report would otherwise stop the injection, the frame that is send again gives a new report
+        if self.stopped or self.finished >= len(self.frames) or time.time() - self.lastReport < INJECT_RETRY_TIMEOUT:
+            return
+
+        self.lastReport = time.time()
+        self.goBack()
+        self.send(True)
+
+    def measureTiming(self, index, sfdTime):
+        # With the timeline every frame is compared with the first one, otherwise with the frame in front of it. Frames without
+        # a delay are send as soon as possible, they have no time to be compared with. The MAC timer wraps around after 71 minutes.
+        if self.flags & INJECT_FLAG_TIMELINE:
+            if self.anchor == None:
+                self.anchor = (index, sfdTime)
+            elif self.offsets[index] != self.offsets[index - 1]:
+                expected = self.anchor[1] + self.offsets[index] - self.offsets[self.anchor[0]]
+                self.deviations.append((sfdTime - expected + (1 << 31)) % (1 << 32) - (1 << 31))
+        elif self.previousSent != None and self.previousSent[0] == index - 1 and self.frames[index][0] > 0:
+            expected = self.previousSent[1] + self.frames[index][0]
+            self.deviations.append((sfdTime - expected + (1 << 31)) % (1 << 32) - (1 << 31))
+
+        self.previousSent = (index, sfdTime)
+
+    def printSummary(self):
+        unknown = self.finished - self.sentCount - self.busyCount
+        text = 'Injected ' + str(self.finished) + ' of ' + str(len(self.frames)) + ' frames: ' + str(self.sentCount) + ' transmitted'
+        if self.flags & INJECT_FLAG_CCA:
+            text += ', ' + str(self.busyCount) + ' not transmitted because the channel was busy'
+        if unknown > 0:
+            text += ', ' + str(unknown) + ' without a report'
+        print(text)
+
+        if len(self.deviations) > 0:
+            deviations = sorted(abs(deviation) for deviation in self.deviations)
+            print('Timing compared with the file: p50 %d us, p99 %d us, max %d us off, %d frames were late by more than 1 ms'
+                  % (deviations[len(deviations) // 2], deviations[int(round(0.99 * (len(deviations) - 1)))], deviations[-1],
+                     sum(1 for deviation in self.deviations if deviation > 1000)))
+
+
+def serialWriteInject():
+    if injector != None and moteSupports(CAPABILITY_INJECT, '--inject'):
+        injector.restart()
+
+
+def serialWriteStatsInterval():
+    if statsInterval > 0:
+        serialWrite(SerialDataType.Stats, [(statsInterval >> 8) & 0xff, statsInterval & 0xff])
+
+
+def serialWriteRtosTrace():
+    if rtosTrace != None and moteSupports(CAPABILITY_TRACE, '--rtos-trace'):
+        serialWrite(SerialDataType.Trace, [1])
+
+
+def serialWriteTelemetry():
+    if telemetryInterval > 0 and moteSupports(CAPABILITY_TELEMETRY, '--telemetry'):
+        serialWrite(SerialDataType.Telemetry, [(telemetryInterval >> 8) & 0xff, telemetryInterval & 0xff])
+
+
+def serialWritePps():
+    if ppsInput and moteSupports(CAPABILITY_PPS, '--pps'):
+        serialWrite(SerialDataType.Pps, [1])
+
+
+def serialWriteTimebase():
+    # The records with the full time are always requested, without them a capture that is silent for 71 minutes loses the wraps
+    if moteSupports(CAPABILITY_TIMEBASE):
+        serialWrite(SerialDataType.Timebase, [1])
+
+
+def serialWriteBatching():
+    if batching != 'latency' and moteSupports(CAPABILITY_BATCHING, '--batching ' + batching):
+        serialWriteControl(SerialDataType.Batching, [BATCHING_MODES[batching], (batchThreshold >> 8) & 0xff, batchThreshold & 0xff,
+                                                    (batchHoldTime >> 8) & 0xff, batchHoldTime & 0xff], 'the batching mode')
+
+
+def serialWriteLanes():
+    if bondPort != None and moteSupports(CAPABILITY_LANES, '--bond-port'):
+        serialWriteControl(SerialDataType.Lanes, [2], 'the second lane')
+
+
+def serialWriteFec():
+    if fecGroupSize > 0 and moteSupports(CAPABILITY_FEC, '--fec'):
+        serialWrite(SerialDataType.Fec, [fecGroupSize])
+
+
+def serialWriteFlashLog():
+    if flashLog:
+        serialWrite(SerialDataType.FlashLog, [FLASH_LOG_ENABLE])
+
+
+def serialWriteAutostart():
+    # The OpenMote stores the messages that configured the capture since the RESET, so this has to come after all of them
+    if saveAutostart and moteSupports(CAPABILITY_AUTOSTART, '--autostart'):
+        if serialWriteControl(SerialDataType.Autostart, [AUTOSTART_SAVE], 'the autostart configuration') != False:
+            print('The OpenMote will start capturing with this configuration after booting')
+
+
+def requestRecords(dataType, request, timeout, description):
+    # Sends a request and collects the records of the messages of the same type that follow, until the empty one that marks the end
+    ser.flushInput()
+    serialWrite(dataType, request)
+
+    data = bytearray()
+    msg = None
+    lostMessages = 0
+    begin = time.time()
+    while time.time() - begin < timeout:
+        c = ser.read(1)
+        if len(c) == 0:
+            continue
+
+        c = bytearray(c)[0]
+        if c != HDLC_FLAG:
+            if msg != None:
+                msg.append(c)
+        elif msg == None or len(msg) == 0:
+            msg = bytearray()
+        else:
+            msg = decode(msg)
+            if len(msg) == 0:
+                lostMessages += 1
+            elif msg[0] == dataType:
+                if len(msg) == 2:
+                    if lostMessages > 0:
+                        print('WARNING: ' + str(lostMessages) + ' parts of ' + description + ' were corrupted and have been skipped')
+                    return data
+
+                data.extend(msg[2:])
+                begin = time.time()
+            msg = bytearray()
+
+    return None
+
+
+def requestFlashLog(command, timeout):
+    data = requestRecords(SerialDataType.FlashLog, [command], timeout, 'the flash log')
+    if data == None:
+        print('ERROR: No response from OpenMote while reading the flash log')
+    return data
+
+
+def outputRecords(data, discardPacketsWithBadCRC, replaceFCS, description):
+    # The data contains buffer records, which get the same layout as a message of type Packet
+    packetProcessor = PacketProcessor(discardPacketsWithBadCRC, replaceFCS)
+    pos = 0
+    count = 0
+    while pos < len(data):
+        recordLen = data[pos]
+        if recordLen < DATA_OFFSET or pos + recordLen > len(data):
+            print('WARNING: A record in ' + description + ' has an incorrect length')
+            break
+
+        record = bytearray([SerialDataType.Packet, recordLen + 1])
+        record.extend(data[pos+1:pos+recordLen])
+        if moteSupports(CAPABILITY_ALIGNED_RECORDS):
+            record = removeRecordPadding(record)
+            if record == None:
+                print('WARNING: A record in ' + description + ' has incorrect padding')
+                break
+
+        packetProcessor.outputRecord(record)
+        pos += recordLen
+        count += 1
+
+    return count
+
+
+def dumpFlashLog(discardPacketsWithBadCRC, replaceFCS):
+    data = requestFlashLog(FLASH_LOG_DUMP, FLASH_LOG_TIMEOUT)
+    if data == None:
+        return False
+
+    count = outputRecords(data, discardPacketsWithBadCRC, replaceFCS, 'the flash log')
+    print(str(count) + ' frames were read from the flash log')
+    return True
+
+
+def requestRecovery():
+    # The OpenMote only keeps the records from before a crash until the next RESET, so they are asked for before the first one
+    global recoveredRecords
+    data = requestRecords(SerialDataType.Recovery, [], RECOVERY_TIMEOUT, 'the recovered records')
+    if data:
+        recoveredRecords = data
+        print('WARNING: The OpenMote was reset during the previous capture, the frames that had not arrived were recovered')
+
+
+def outputRecoveredRecords(discardPacketsWithBadCRC, replaceFCS):
+    # The timestamps of the recovered frames start at the time of writing them, like the frames of the flash log
+    global recoveredRecords
+    count = outputRecords(recoveredRecords, discardPacketsWithBadCRC, replaceFCS, 'the recovered records')
+    recoveredRecords = None
+    print(str(count) + ' frames from before the reset of the OpenMote were written')
+
+
+def eraseFlashLog():
+    if requestFlashLog(FLASH_LOG_ERASE, FLASH_LOG_ERASE_TIMEOUT) == None:
+        return False
+
+    print('Flash log erased')
+    return True
+
+
+def clearAutostart():
+    if not moteSupports(CAPABILITY_AUTOSTART, '--clear-autostart'):
+        return False
+
+    serialWrite(SerialDataType.Autostart, [AUTOSTART_CLEAR])
+    print('The OpenMote will wait for the host again after booting')
+    return True
+
+
+def requestBaudrate(rate):
+    # Returns the baudrate from the answer of the OpenMote, or None when no valid answer arrived
+    ser.flushInput()
+    serialWrite(SerialDataType.Baudrate, [(rate >> 24) & 0xff, (rate >> 16) & 0xff, (rate >> 8) & 0xff, rate & 0xff] + BAUDRATE_PATTERN)
+
+    msg = None
+    begin = time.time()
+    while time.time() - begin < BAUDRATE_VERIFY_TIMEOUT / 2.0:
+        c = ser.read(1)
+        if len(c) == 0:
+            continue
+
+        c = bytearray(c)[0]
+        if c != HDLC_FLAG:
+            if msg != None:
+                msg.append(c)
+        elif msg == None or len(msg) == 0:
+            msg = bytearray()
+        else:
+            # Packets that arrive in the meantime are skipped, they will be retransmitted as they don't get acknowledged
+            msg = decode(msg, quiet=True)
+            if len(msg) == 10 and msg[0] == SerialDataType.Baudrate and list(msg[6:10]) == BAUDRATE_PATTERN:
+                return (msg[2] << 24) + (msg[3] << 16) + (msg[4] << 8) + msg[5]
+            msg = bytearray()
+
+    return None
+
+
+def negotiateBaudrate():
+    if not moteSupports(CAPABILITY_BAUDRATE, '--baudrate'):
+        return
+
+    # The OpenMote answers at the old baudrate, the request is then repeated at the new baudrate to confirm that it works.
+    # Rates above the limit of the OpenMote aren't even tried, so the fastest one that both sides can use is found quickly.
+    for rate in requestedBaudrates:
+        if moteMaxBaudrate != None and rate > moteMaxBaudrate:
+            continue
+
+        answer = requestBaudrate(rate)
+        if answer == rate:
+            ser.flush()
+            ser.baudrate = rate
+            if requestBaudrate(rate) == rate:
+                print('Using baudrate ' + str(rate))
+                return
+
+            ser.baudrate = BAUDRATE
+        elif answer != None:
+            continue  # The OpenMote can't make this baudrate with its UART divisor
+
+        # The OpenMote might have changed its baudrate, give it time to return to the default one
+        time.sleep(BAUDRATE_VERIFY_TIMEOUT)
+
+    print('WARNING: No faster baudrate could be used, staying at ' + str(BAUDRATE))
+
+
+def lookupMacAddress(ip):
+    # Returns the MAC address to which the packets for the IP address have to be send, or None when it is unknown
+    if ip == '255.255.255.255':
+        return b'\xff' * 6
+
+    # An address of this pc can only be reached when it belongs to the interface to which the OpenMote is connected
+    try:
+        s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        s.bind((ip, 0))
+        s.close()
+        return ser.address
+    except socket.error:
+        pass
+
+    # Let the kernel resolve the address, then find it in its ARP table
+    s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    s.sendto(b'', (ip, ZEP_PORT))
+    s.close()
+    time.sleep(0.5)
+    with open('/proc/net/arp') as arpTable:
+        for line in arpTable.readlines()[1:]:
+            fields = line.split()
+            if len(fields) >= 4 and fields[0] == ip and fields[3] != '00:00:00:00:00:00':
+                return bytes(bytearray(int(x, 16) for x in fields[3].split(':')))
+    return None
+
+
+def requestZep(destination, port, source):
+    # The OpenMote echoes the message when it starts sending the frames as ZEP packets, returns whether it did so
+    macAddress = lookupMacAddress(destination)
+    if macAddress == None:
+        print('ERROR: Could not find the MAC address of ' + destination)
+        return False
+
+    data = list(bytearray(macAddress)) + list(bytearray(socket.inet_aton(source))) \
+         + list(bytearray(socket.inet_aton(destination))) + [(port >> 8) & 0xff, port & 0xff]
+    for i in range(3):
+        serialWrite(SerialDataType.Zep, data)
+
+        msg = None
+        begin = time.time()
+        while time.time() - begin < 1:
+            c = ser.read(1)
+            if len(c) == 0:
+                continue
+
+            c = bytearray(c)[0]
+            if c != HDLC_FLAG:
+                if msg != None:
+                    msg.append(c)
+            elif msg == None or len(msg) == 0:
+                msg = bytearray()
+            else:
+                # Packets that were already underway are skipped, the OpenMote sends the following ones as ZEP packets
+                msg = decode(msg, quiet=True)
+                if len(msg) == len(data) + 2 and msg[0] == SerialDataType.Zep and list(msg[2:]) == data:
+                    return True
+                msg = bytearray()
+
+    return False
+
+
+def startSyncBeacon(channels, intervalMs):
+    # The OpenMote answers with its MAC time, which is matched with the time of the pc halfway the question and the answer.
+    # Returns the time of the pc and of the beacon (in microseconds), or None when the OpenMote didn't start transmitting.
+    interval = (intervalMs * 1000 + HOP_TIME_UNIT // 2) // HOP_TIME_UNIT
+    mask = 0
+    for channel in channels:
+        mask |= 1 << (channel - 11)
+
+    data = [(interval >> 8) & 0xff, interval & 0xff, (mask >> 8) & 0xff, mask & 0xff]
+    for i in range(3):
+        ser.flushInput()
+        sendTime = time.time()
+        serialWrite(SerialDataType.Sync, data)
+
+        msg = None
+        while time.time() - sendTime < 1:
+            c = ser.read(1)
+            if len(c) == 0:
+                continue
+
+            c = bytearray(c)[0]
+            if c != HDLC_FLAG:
+                if msg != None:
+                    msg.append(c)
+            elif msg == None or len(msg) == 0:
+                msg = bytearray()
+            else:
+                receiveTime = time.time()
+                msg = decode(msg, quiet=True)
+                if len(msg) == 8 and msg[0] == SerialDataType.Sync:
+                    beaconTime = (msg[2] << 24) + (msg[3] << 16) + (msg[4] << 8) + msg[5]
+                    return (int((sendTime + receiveTime) / 2 * 1000000), beaconTime)
+                msg = bytearray()
+
+    return None
+
+
+def serialWriteSnapLength():
+    if snapLength > 0:
+        serialWrite(SerialDataType.SnapLength, [snapLength])
+
+
+def serialWriteOverflowPolicy():
+    if overflowPolicy == OVERFLOW_POLICY_ADAPTIVE and not moteSupports(CAPABILITY_ADAPTIVE_OVERFLOW, '--overflow adaptive'):
+        return
+    if overflowPolicy != 0 and moteSupports(CAPABILITY_OVERFLOW_POLICY, '--overflow'):
+        serialWrite(SerialDataType.Overflow, [overflowPolicy])
+
+
+def serialWriteFcsFilter():
+    if moteFcsFilter and moteSupports(CAPABILITY_FCS_FILTER, '--mote-fcs-filter'):
+        serialWrite(SerialDataType.FcsFilter, [1])
+
+
+def serialWriteDuplicates():
+    if duplicates != 'send' and moteSupports(CAPABILITY_DUPLICATES, '--duplicates'):
+        serialWrite(SerialDataType.Duplicates, [1])
+
+
+def serialWriteCompression():
+    if compressHeaders and moteSupports(CAPABILITY_COMPRESSION, '--compress-headers'):
+        serialWrite(SerialDataType.Compression, [1])
+
+
+def serialWriteDescriptors():
+    if frameDescriptors and moteSupports(CAPABILITY_DESCRIPTOR, '--descriptors'):
+        serialWrite(SerialDataType.Descriptor, [1])
+
+
+def serialWriteTrigger():
+    if triggerRule != None and moteSupports(CAPABILITY_TRIGGER, '--trigger'):
+        serialWrite(SerialDataType.Trigger, triggerRule)
+
+
+def parseDescriptor(data):
+    return FrameDescriptor(data[0] & 0x07, (data[0] >> 3) & 1, (data[0] >> 4) & 3, (data[0] >> 6) & 3,
+                           data[1] & 0x1f, (data[1] >> 5) & 3, data[1] >> 7)
+
+
+def serialWriteFraming():
+    global cobsFraming
+    if framing != 'hdlc' and moteSupports(CAPABILITY_COBS, '--framing ' + framing):
+        serialWrite(SerialDataType.Framing, [FRAMINGS[framing]])
+        cobsFraming = True
+
+
+def parseAddress(text):
+    # Short addresses are given as a 16-bit number, extended addresses as 8 bytes separated by colons or as 16 hex digits
+    text = text.lower()
+    if ':' in text:
+        addr = [int(byte, 16) for byte in text.split(':')]
+    elif len(text.replace('0x', '')) == 16:
+        value = int(text, 16)
+        addr = [(value >> (8 * (7 - i))) & 0xff for i in range(8)]
+    else:
+        value = int(text, 0)
+        addr = [(value >> 8) & 0xff, value & 0xff]
+
+    if len(addr) == 2:
+        return 2, addr + [0]*6
+    elif len(addr) == 8:
+        return 3, addr
+    else:
+        raise ValueError('Address "' + text + '" is neither a short nor an extended address')
+
+
+def parseFilterRule(text):
+    fields = 0
+    frameType = 0
+    dstPan = 0
+    srcPan = 0
+    addrMode = 0
+    addr = [0]*8
+    for part in text.split(','):
+        if '=' not in part:
+            raise ValueError('Expected key=value but found "' + part + '"')
+
+        key, value = part.split('=', 1)
+        key = key.strip().lower()
+        value = value.strip()
+        if key == 'type':
+            fields |= FILTER_MATCH_FRAME_TYPE
+            frameType = FRAME_TYPES[value.lower()] if value.lower() in FRAME_TYPES else int(value, 0)
+        elif key == 'dstpan':
+            fields |= FILTER_MATCH_DST_PAN
+            dstPan = int(value, 0)
+        elif key == 'srcpan':
+            fields |= FILTER_MATCH_SRC_PAN
+            srcPan = int(value, 0)
+        elif key == 'dst' or key == 'src':
+            if fields & (FILTER_MATCH_DST_ADDR | FILTER_MATCH_SRC_ADDR):
+                raise ValueError('A filter rule can only contain one address')
+            fields |= FILTER_MATCH_DST_ADDR if key == 'dst' else FILTER_MATCH_SRC_ADDR
+            addrMode, addr = parseAddress(value)
+        else:
+            raise ValueError('Unknown filter field "' + key + '"')
+
+    if frameType < 0 or frameType > 7 or dstPan < 0 or dstPan > 0xffff or srcPan < 0 or srcPan > 0xffff:
+        raise ValueError('Value out of range in filter "' + text + '"')
+
+    return [fields, frameType, (dstPan >> 8) & 0xff, dstPan & 0xff, (srcPan >> 8) & 0xff, srcPan & 0xff, addrMode] + addr
+
+
+def parseTriggerRule(text, preFrames, postFrames):
+    fields = 0
+    frameType = 0
+    addrMode = 0
+    addr = [0]*8
+    patternOffset = 0
+    pattern = []
+    for part in text.split(','):
+        if '=' not in part:
+            raise ValueError('Expected key=value but found "' + part + '"')
+
+        key, value = part.split('=', 1)
+        key = key.strip().lower()
+        value = value.strip()
+        if key == 'type':
+            fields |= TRIGGER_MATCH_FRAME_TYPE
+            frameType = FRAME_TYPES[value.lower()] if value.lower() in FRAME_TYPES else int(value, 0)
+        elif key == 'dst' or key == 'src':
+            if fields & (TRIGGER_MATCH_DST_ADDR | TRIGGER_MATCH_SRC_ADDR):
+                raise ValueError('A trigger can only contain one address')
+            fields |= TRIGGER_MATCH_DST_ADDR if key == 'dst' else TRIGGER_MATCH_SRC_ADDR
+            addrMode, addr = parseAddress(value)
+        elif key == 'bytes':
+            if ':' not in value:
+                raise ValueError('Expected bytes=OFFSET:HEX but found "' + part + '"')
+            fields |= TRIGGER_MATCH_PATTERN
+            offset, data = value.split(':', 1)
+            patternOffset = int(offset, 0)
+            pattern = list(bytearray.fromhex(data))
+        else:
+            raise ValueError('Unknown trigger field "' + key + '"')
+
+    if frameType < 0 or frameType > 7:
+        raise ValueError('Value out of range in trigger "' + text + '"')
+    if (fields & TRIGGER_MATCH_PATTERN) and (len(pattern) == 0 or len(pattern) > TRIGGER_MAX_PATTERN_LEN
+                                              or patternOffset < 0 or patternOffset + len(pattern) > 125):
+        raise ValueError('The bytes should be 1 to ' + str(TRIGGER_MAX_PATTERN_LEN) + ' bytes within the first 125 bytes of the frame')
+
+    return ([fields, frameType, addrMode] + addr + [patternOffset, len(pattern)] + pattern + [0]*(TRIGGER_MAX_PATTERN_LEN - len(pattern))
+            + [(preFrames >> 8) & 0xff, preFrames & 0xff, (postFrames >> 8) & 0xff, postFrames & 0xff])
+
+
+def filterPayloadOffset(frame):
+    # Start of the MAC payload, found in the same way as the OpenMote does it for a --filter-program
+    frameControl = frame[0] | (frame[1] << 8) if len(frame) >= 2 else 0
+    dstAddrMode = (frameControl >> 10) & 0x03
+    srcAddrMode = (frameControl >> 14) & 0x03
+    pos = 3
+    if dstAddrMode >= 2:
+        pos += 2 + (2 if dstAddrMode == 2 else 8)
+    if srcAddrMode >= 2:
+        if not (frameControl >> 6) & 0x01:
+            pos += 2
+        pos += 2 if srcAddrMode == 2 else 8
+    if ((frameControl >> 3) & 0x01) and pos < len(frame):
+        pos += 5 + [0, 1, 5, 9][(frame[pos] >> 3) & 0x03]
+    return pos
+
+
+def runFilterProgram(program, frame):
+    # Runs a program of compileFilterProgram on a frame without its FCS, as the OpenMote does
+    frame = bytearray(frame)
+    payloadPos = None
+    accumulator = 0
+    pc = 0
+    while pc * 5 < len(program):
+        opcode, onTrue, onFalse, operandHigh, operandLow = program[pc*5:pc*5+5]
+        operand = (operandHigh << 8) | operandLow
+        pc += 1
+        if opcode == FILTER_OP_RET:
+            return operand != 0
+        elif opcode & ~FILTER_OP_PAYLOAD <= FILTER_OP_LD_HALF_LE:
+            if opcode & FILTER_OP_PAYLOAD and payloadPos == None:
+                payloadPos = filterPayloadOffset(frame)
+            offset = operand + (payloadPos if opcode & FILTER_OP_PAYLOAD else 0)
+            opcode &= ~FILTER_OP_PAYLOAD
+            if offset + (1 if opcode == FILTER_OP_LD_BYTE else 2) > len(frame):
+                return False
+            if opcode == FILTER_OP_LD_BYTE:
+                accumulator = frame[offset]
+            elif opcode == FILTER_OP_LD_HALF:
+                accumulator = (frame[offset] << 8) | frame[offset+1]
+            else:
+                accumulator = frame[offset] | (frame[offset+1] << 8)
+        elif opcode == FILTER_OP_LD_LENGTH:
+            accumulator = len(frame)
+        elif opcode == FILTER_OP_AND:
+            accumulator &= operand
+        else:
+            if opcode == FILTER_OP_JEQ:
+                condition = accumulator == operand
+            elif opcode == FILTER_OP_JGT:
+                condition = accumulator > operand
+            elif opcode == FILTER_OP_JGE:
+                condition = accumulator >= operand
+            else:
+                condition = (accumulator & operand) != 0
+            pc += onTrue if condition else onFalse
+    return False
+
+
+def compileFilterProgram(text):
+    # Expressions like "type == data and byte[payload] & 0xe0 == 0x60" become a program that only jumps forward: every
+    # comparison loads its value and jumps to where the expression continues once its outcome is known
+    tokens = re.findall(r'0x[0-9a-fA-F]+|\d+|[A-Za-z_]\w*|==|!=|>=|<=|\S', text)
+    position = [0]
+
+    def peek():
+        return tokens[position[0]].lower() if position[0] < len(tokens) else None
+
+    def take(expected=None):
+        token = peek()
+        if token == None or (expected != None and token != expected):
+            raise ValueError('Expected ' + (('"' + expected + '"') if expected != None else 'more') + ' in "' + text + '"'
+                             + ((' but found "' + token + '"') if token != None else ''))
+        position[0] += 1
+        return token
+
+    def number(limit):
+        token = take()
+        value = FRAME_TYPES[token] if token in FRAME_TYPES else int(token, 0) if token[0].isdigit() else None
+        if value == None or value > limit:
+            raise ValueError('Expected a number up to ' + str(limit) + ' but found "' + token + '"')
+        return value
+
+    def comparison():
+        name = take()
+        if name == 'len':
+            load = [FILTER_OP_LD_LENGTH, 0]
+            mask = None
+        elif name == 'type':
+            load = [FILTER_OP_LD_BYTE, 0]
+            mask = 0x07
+        elif name in ('byte', 'be16', 'le16'):
+            opcode = {'byte': FILTER_OP_LD_BYTE, 'be16': FILTER_OP_LD_HALF, 'le16': FILTER_OP_LD_HALF_LE}[name]
+            take('[')
+            if peek() == 'payload':
+                take()
+                opcode |= FILTER_OP_PAYLOAD
+                offset = 0
+                if peek() == '+':
+                    take()
+                    offset = number(125)
+            else:
+                offset = number(125)
+            take(']')
+            load = [opcode, offset]
+            mask = None
+        else:
+            raise ValueError('Unknown value "' + name + '", expected len, type, byte[...], be16[...] or le16[...]')
+
+        if peek() == '&':
+            take()
+            mask = number(0xffff) & (mask if mask != None else 0xffff)
+
+        if peek() in ('==', '!=', '>', '>=', '<', '<='):
+            return ('compare', load, mask, take(), number(0xffff))
+        return ('compare', load, mask, '&', None)  # True when any bit of the (masked) value is set
+
+    def unary():
+        if peek() == 'not':
+            take()
+            return ('not', unary())
+        if peek() == '(':
+            take()
+            node = disjunction()
+            take(')')
+            return node
+        return comparison()
+
+    def conjunction():
+        node = unary()
+        while peek() == 'and':
+            take()
+            node = ('and', node, unary())
+        return node
+
+    def disjunction():
+        node = conjunction()
+        while peek() == 'or':
+            take()
+            node = ('or', node, conjunction())
+        return node
+
+    tree = disjunction()
+    if peek() != None:
+        raise ValueError('Unexpected "' + peek() + '" in "' + text + '"')
+
+    # Jump targets are lists that get the index of their instruction once it is known
+    code = []
+    def generate(node, onTrue, onFalse):
+        if node[0] in ('and', 'or'):
+            middle = [None]
+            generate(node[1], middle if node[0] == 'and' else onTrue, onFalse if node[0] == 'and' else middle)
+            middle[0] = len(code)
+            generate(node[2], onTrue, onFalse)
+        elif node[0] == 'not':
+            generate(node[1], onFalse, onTrue)
+        else:
+            _, load, mask, operator, value = node
+            code.append([load[0], None, None, load[1]])
+            if operator == '&':
+                code.append([FILTER_OP_JSET, onTrue, onFalse, mask if mask != None else 0xffff])
+                return
+            if mask != None:
+                code.append([FILTER_OP_AND, None, None, mask])
+            opcode, swapped = {'==': (FILTER_OP_JEQ, False), '!=': (FILTER_OP_JEQ, True), '>': (FILTER_OP_JGT, False),
+                               '>=': (FILTER_OP_JGE, False), '<': (FILTER_OP_JGE, True), '<=': (FILTER_OP_JGT, True)}[operator]
+            code.append([opcode, onFalse if swapped else onTrue, onTrue if swapped else onFalse, value])
+
+    accept = [None]
+    reject = [None]
+    generate(tree, accept, reject)
+    accept[0] = len(code)
+    code.append([FILTER_OP_RET, None, None, 1])
+    reject[0] = len(code)
+    code.append([FILTER_OP_RET, None, None, 0])
+    if len(code) > FILTER_PROGRAM_MAX_INSTRUCTIONS:
+        raise ValueError('The expression needs ' + str(len(code)) + ' instructions, at most '
+                         + str(FILTER_PROGRAM_MAX_INSTRUCTIONS) + ' are possible')
+
+    program = []
+    for i, (opcode, onTrue, onFalse, operand) in enumerate(code):
+        program += [opcode, onTrue[0] - i - 1 if onTrue != None else 0, onFalse[0] - i - 1 if onFalse != None else 0,
+                    (operand >> 8) & 0xff, operand & 0xff]
+    return program
+
+
+def parseDecryptionKey(text):
+    parts = text.split(',')
+    key = bytearray.fromhex(parts[0].replace(':', ''))
+    if len(key) != 16:
+        raise ValueError('The key "' + parts[0] + '" is not 16 bytes long')
+
+    fields = 0
+    pan = 0
+    shortAddr = [0]*2
+    extAddr = [0]*8
+    extGiven = False
+    for part in parts[1:]:
+        if '=' not in part:
+            raise ValueError('Expected key=value but found "' + part + '"')
+
+        name, value = part.split('=', 1)
+        name = name.strip().lower()
+        value = value.strip()
+        if name == 'pan':
+            fields |= DECRYPTION_MATCH_PAN
+            pan = int(value, 0)
+            if pan < 0 or pan > 0xffff:
+                raise ValueError('PAN out of range in key "' + text + '"')
+        elif name == 'src':
+            addrMode, addr = parseAddress(value)
+            if addrMode == 2:
+                fields |= DECRYPTION_MATCH_SHORT_ADDR
+                shortAddr = addr[:2]
+            else:
+                fields |= DECRYPTION_MATCH_EXT_ADDR
+                extAddr = addr
+        elif name == 'ext':
+            addrMode, extAddr = parseAddress(value)
+            extGiven = True
+            if addrMode != 3:
+                raise ValueError('"' + value + '" is not an extended address')
+        else:
+            raise ValueError('Unknown key field "' + name + '"')
+
+    if fields == 0:
+        raise ValueError('The key "' + text + '" needs a pan or a src')
+    if (fields & DECRYPTION_MATCH_SHORT_ADDR) and not extGiven:
+        raise ValueError('A key for a short source address also needs the extended address of the source (ext=ADDR)')
+
+    return [fields, (pan >> 8) & 0xff, pan & 0xff] + shortAddr + extAddr + list(key)
+
+
+def removeSecurityHeader(frame, descriptor=None):
+    # The OpenMote leaves the auxiliary security header and the MIC in a decrypted frame, without them
+    # the frame looks like an unsecured one and Wireshark doesn't try to decrypt it again
+    if descriptor != None and descriptor.headerLength > 0:
+        pos = descriptor.headerLength
+    else:
+        frameControl = frame[0] + (frame[1] << 8)
+        dstAddrMode = (frameControl >> 10) & 3
+        srcAddrMode = (frameControl >> 14) & 3
+        pos = 3
+        if dstAddrMode >= 2:
+            pos += 2 + (2 if dstAddrMode == 2 else 8)
+        if not frameControl & (1 << 6):
+            pos += 2
+        pos += 2 if srcAddrMode == 2 else 8
+
+    securityControl = frame[pos]
+    auxLength = 5 + [0, 1, 5, 9][(securityControl >> 3) & 3]
+    micLength = 2 << (securityControl & 3)
+    frame[0] &= ~(1 << 3)
+    return frame[:pos] + frame[pos+auxLength:len(frame)-micLength]
+
+
+def serialWriteStop():
+    try:
+        serialWrite(SerialDataType.Stop, [])
+
+        # The OpenMote returns to the default baudrate when it stops
+        if ser.baudrate != BAUDRATE:
+            ser.flush()
+            ser.baudrate = BAUDRATE
+    except:
+        pass
+
+
+def loadHostLibrary():
+    # The library is only used when it was build with the Makefile in src/host, otherwise the bytes are processed here
+    for name in HOST_LIBRARY_NAMES:
+        path = os.path.join(HOST_LIBRARY_DIR, name)
+        if not os.path.exists(path):
+            continue
+
+        try:
+            library = ctypes.CDLL(path)
+        except OSError as e:
+            print('WARNING: Failed to load ' + path + ', processing the received bytes in python. Error: ' + str(e))
+            continue
+
+        library.snifferHostCreate.argtypes = [ctypes.c_int]
+        library.snifferHostCreate.restype = ctypes.c_void_p
+        library.snifferHostDestroy.argtypes = [ctypes.c_void_p]
+        library.snifferHostReset.argtypes = [ctypes.c_void_p]
+        library.snifferHostResume.argtypes = [ctypes.c_void_p]
+        library.snifferHostExpectTrigger.argtypes = [ctypes.c_void_p]
+        library.snifferHostSetAckThreshold.argtypes = [ctypes.c_void_p, ctypes.c_uint]
+        library.snifferHostSetAckOnRequest.argtypes = [ctypes.c_void_p, ctypes.c_int]
+        library.snifferHostSetCumulativeAck.argtypes = [ctypes.c_void_p, ctypes.c_int]
+        library.snifferHostSetAlignedRecords.argtypes = [ctypes.c_void_p, ctypes.c_int]
+        library.snifferHostSetFraming.argtypes = [ctypes.c_void_p, ctypes.c_int]
+        library.snifferHostFeed.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_size_t]
+        library.snifferHostNextEvent.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_size_t, ctypes.POINTER(ctypes.c_size_t)]
+        library.snifferHostNextEvent.restype = ctypes.c_int
+        library.snifferHostTakeOutput.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_size_t]
+        library.snifferHostTakeOutput.restype = ctypes.c_size_t
+        library.snifferHostIsReceiving.argtypes = [ctypes.c_void_p]
+        library.snifferHostIsReceiving.restype = ctypes.c_int
+        library.snifferHostSerialTimeout.argtypes = [ctypes.c_void_p]
+        library.snifferHostAckDelayed.argtypes = [ctypes.c_void_p]
+        library.snifferHostUnackedBytes.argtypes = [ctypes.c_void_p]
+        library.snifferHostUnackedBytes.restype = ctypes.c_uint
+        library.snifferHostCalculateCrc.argtypes = [ctypes.c_int, ctypes.c_char_p, ctypes.c_size_t, ctypes.c_uint16]
+        library.snifferHostCalculateCrc.restype = ctypes.c_uint16
+        library.snifferHostCalculateRadioCrc.argtypes = [ctypes.c_char_p, ctypes.c_size_t]
+        library.snifferHostCalculateRadioCrc.restype = ctypes.c_uint16
+
+        # A library that was build before the 6LoWPAN decoder still works for the rest
+        if hasattr(library, 'snifferLowpanCreate'):
+            library.snifferLowpanCreate.argtypes = [ctypes.c_size_t, ctypes.c_int64]
+            library.snifferLowpanCreate.restype = ctypes.c_void_p
+            library.snifferLowpanDestroy.argtypes = [ctypes.c_void_p]
+            library.snifferLowpanSetContext.argtypes = [ctypes.c_void_p, ctypes.c_uint, ctypes.c_char_p, ctypes.c_uint]
+            library.snifferLowpanFeed.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_size_t, ctypes.c_int64]
+            library.snifferLowpanNextPacket.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_size_t,
+                                                        ctypes.POINTER(ctypes.c_size_t), ctypes.POINTER(ctypes.c_int64)]
+            library.snifferLowpanNextPacket.restype = ctypes.c_int
+            library.snifferLowpanCounter.argtypes = [ctypes.c_void_p, ctypes.c_int]
+            library.snifferLowpanCounter.restype = ctypes.c_uint
+        return library
+
+    return None
+
+
+class HostReceiver:
+    # Does the same as the framing loop of snifferThread and the sequence number checks of PacketProcessor, in the native library.
+    # Records come out in order, other messages are still given to PacketProcessor.processPacket.
+    def __init__(self):
+        self.receiver = hostLibrary.snifferHostCreate(1 if hardwareCRC else 0)
+        self.eventBuffer = ctypes.create_string_buffer(HOST_EVENT_MAX_LEN)
+        self.eventLength = ctypes.c_size_t()
+        self.outputBuffer = ctypes.create_string_buffer(4096)
+        self.reset()
+
+    def __del__(self):
+        hostLibrary.snifferHostDestroy(self.receiver)
+
+    def reset(self):
+        hostLibrary.snifferHostReset(self.receiver)
+        hostLibrary.snifferHostSetAckThreshold(self.receiver, ackThreshold)
+        hostLibrary.snifferHostSetAckOnRequest(self.receiver, 1 if ackOnRequest else 0)
+        hostLibrary.snifferHostSetCumulativeAck(self.receiver, 1 if moteSupports(CAPABILITY_CUMULATIVE_ACK) else 0)
+        hostLibrary.snifferHostSetAlignedRecords(self.receiver, 1 if moteSupports(CAPABILITY_ALIGNED_RECORDS) else 0)
+        hostLibrary.snifferHostSetFraming(self.receiver, FRAMINGS['cobs' if cobsFraming else 'hdlc'])
+        if (triggerRule != None and moteSupports(CAPABILITY_TRIGGER)) or attachedCapture:
+            hostLibrary.snifferHostExpectTrigger(self.receiver)
+
+    def resume(self):
+        hostLibrary.snifferHostResume(self.receiver)
+        self.writeOutput()
+
+    def feed(self, data):
+        data = bytes(data)
+        hostLibrary.snifferHostFeed(self.receiver, data, len(data))
+
+    def nextEvent(self):
+        event = hostLibrary.snifferHostNextEvent(self.receiver, self.eventBuffer, HOST_EVENT_MAX_LEN, ctypes.byref(self.eventLength))
+        return event, bytearray(self.eventBuffer.raw[:self.eventLength.value])
+
+    def serialTimeout(self):
+        hostLibrary.snifferHostSerialTimeout(self.receiver)
+
+    def ackDelayed(self):
+        hostLibrary.snifferHostAckDelayed(self.receiver)
+
+    def unackedBytes(self):
+        return hostLibrary.snifferHostUnackedBytes(self.receiver)
+
+    def writeOutput(self):
+        # The ACK and NACK messages are already encoded
+        while True:
+            length = hostLibrary.snifferHostTakeOutput(self.receiver, self.outputBuffer, len(self.outputBuffer))
+            if length == 0:
+                break
+            ser.write(self.outputBuffer.raw[:length])
+
+
+class AckTimer:
+    # Makes sure that received bytes are acknowledged within ackDelay, also when too little arrives to reach the ACK threshold.
+    # While bytes are waiting for their ACK the serial port is only read until that moment, a SERIAL_TIMEOUT of silence is
+    # still what tells the receiver that something got lost.
+    def __init__(self):
+        self.deadline = None
+        self.lastReceiveTime = time.time()
+
+    def received(self, byteCount):
+        if byteCount > 0:
+            self.lastReceiveTime = time.time()
+
+    def silent(self):
+        # Called when a read returned nothing, which with the short timeout doesn't mean that the line was quiet for long
+        if ser.timeout == SERIAL_TIMEOUT or time.time() - self.lastReceiveTime >= SERIAL_TIMEOUT:
+            self.lastReceiveTime = time.time()
+            return True
+        return False
+
+    def due(self):
+        return self.deadline != None and time.time() >= self.deadline
+
+    def update(self, unackedByteCount):
+        # The delay starts at the first byte that isn't acknowledged, so a steady trickle of frames can't postpone the ACK.
+        # When the OpenMote asks for the ACKs that it needs, the timer only keeps the bytes from staying unacknowledged.
+        delay = max(ackDelay, ACK_REQUEST_DELAY) if ackOnRequest else ackDelay
+        if unackedByteCount == 0:
+            self.deadline = None
+        elif self.deadline == None:
+            self.deadline = time.time() + delay
+
+        timeout = SERIAL_TIMEOUT if self.deadline == None else delay
+        if ser.timeout != timeout:
+            ser.timeout = timeout
+
+    def stop(self):
+        # Connecting to the OpenMote again starts without unacknowledged bytes
+        self.deadline = None
+        self.lastReceiveTime = time.time()
+        if ser.timeout != SERIAL_TIMEOUT:
+            ser.timeout = SERIAL_TIMEOUT
+
+
+class RoundTripProbe:
+    # Measures the time between writing a message and receiving the answer of the OpenMote, which is the delay that an ACK
+    # has before the OpenMote can free its buffer. The filter statistics are asked for, as the OpenMote answers them in every
+    # state without changing anything. The answer waits behind the records that are already queued, like the ACK would.
+    def __init__(self):
+        self.samples = []
+        self.sendTime = None
+        self.nextProbe = time.time()
+
+    def poll(self):
+        now = time.time()
+        if self.sendTime != None and now - self.sendTime >= ROUND_TRIP_PROBE_TIMEOUT:
+            self.sendTime = None  # E.g. the OpenMote was reset, the next measurement starts over
+        if self.sendTime == None and now >= self.nextProbe:
+            self.sendTime = now
+            self.nextProbe = now + ROUND_TRIP_PROBE_INTERVAL
+            serialWrite(SerialDataType.FilterStats, [])
+
+    def answered(self):
+        # Returns False when the answer wasn't to a measurement, but to filter statistics that were asked for
+        if self.sendTime == None:
+            return False
+        self.samples.append(time.time() - self.sendTime)
+        self.sendTime = None
+        return True
+
+    def printPercentiles(self):
+        if len(self.samples) == 0:
+            print('No round-trip time was measured')
+            return
+        samples = sorted(self.samples)
+        values = ['p' + str(p) + ' %.1f ms' % (samples[min(len(samples) - 1, len(samples) * p // 100)] * 1000)
+                  for p in ROUND_TRIP_PERCENTILES]
+        print('ACK round-trip time: ' + ', '.join(values) + ', max %.1f ms' % (samples[-1] * 1000)
+              + ' (' + str(len(samples)) + ' measurements)')
+
+
+class OutputPause:
+    # When the output falls behind, the OpenMote is asked to pause sending frames instead of dropping them here. They wait in
+    # its buffer, where the overflow policy decides what is kept once it fills up, and the link isn't spend on retransmissions.
+    # The pause is repeated while the output is behind, so the OpenMote continues by itself when the sniffer stops.
+    def __init__(self):
+        self.paused = False
+        self.lastRequest = 0
+        self.pauses = 0
+
+    def poll(self):
+        if outputWriter == None or not moteCapabilities & CAPABILITY_PAUSE:
+            return
+
+        queuedBytes = outputWriter.queuedBytes
+        if self.paused and queuedBytes < OUTPUT_RESUME_BYTES:
+            self.paused = False
+            serialWrite(SerialDataType.Pause, [0])
+            if enableWarnings:
+                print('Output caught up, the OpenMote continues sending frames')
+        elif (self.paused or queuedBytes >= OUTPUT_PAUSE_BYTES) and time.time() - self.lastRequest >= PAUSE_REPEAT_INTERVAL:
+            if not self.paused:
+                if self.pauses == 0 or enableWarnings:
+                    print('WARNING: Output is too slow, pausing the OpenMote until it catches up')
+                self.pauses += 1
+            self.paused = True
+            self.lastRequest = time.time()
+            serialWrite(SerialDataType.Pause, [1])
+
+    def stop(self):
+        if self.pauses > 0:
+            print('The OpenMote was paused ' + str(self.pauses) + ' times because the output was too slow')
+
+
+class LinkMonitor:
+    # Estimates how close the serial link is to losing frames. The utilisation follows from the bytes that arrive, escapes and
+    # framing included, compared to what the baudrate can carry. The OpenMote timestamps the frames when the radio receives
+    # them, so once the link can't keep up the frames that arrive within a second cover less than a second of radio time:
+    # the ratio between the two is the load that the radio offers, and what exceeds the capacity piles up in the buffer.
+    def __init__(self):
+        self.utilisation = 0.0
+        self.offeredLoad = 0.0  # Also relative to the capacity of the link, above 1 the buffer is filling up
+        self.bufferEstimate = 0
+        self.timeToOverflow = None
+        self.warned = False
+        self.reset(time.time())
+
+    def reset(self, now):
+        self.windowStart = now
+        self.serialBytes = 0
+        self.firstTimestamp = None
+        self.lastTimestamp = None
+
+    def received(self, byteCount):
+        self.serialBytes += byteCount
+
+    def frame(self, timestamp):
+        if self.firstTimestamp == None:
+            self.firstTimestamp = timestamp
+        self.lastTimestamp = timestamp
+
+    def poll(self):
+        now = time.time()
+        elapsed = now - self.windowStart
+        baudrate = getattr(ser, 'linkBaudrate', None) or getattr(ser, 'baudrate', None)
+        if elapsed < LINK_MONITOR_INTERVAL or not baudrate:
+            return
+
+        # Every byte takes a start and a stop bit on the UART, the second lane with --bond-port carries as much again
+        capacity = baudrate / 10.0
+        if bondPort != None and moteSupports(CAPABILITY_LANES):
+            capacity *= 2
+        self.utilisation = self.serialBytes / elapsed / capacity
+        self.offeredLoad = self.utilisation
+        self.bufferEstimate = 0
+        self.timeToOverflow = None
+        if self.utilisation >= LINK_SATURATED and self.lastTimestamp != None:
+            radioTime = (self.lastTimestamp - self.firstTimestamp) / 1e6
+            if radioTime > 0:
+                self.offeredLoad = self.utilisation * elapsed / radioTime
+
+            # The newest frame waited behind what is still in the buffer
+            lag = max(0, now - self.lastTimestamp / 1e6)
+            self.bufferEstimate = int(min(moteBufferSize, lag * capacity))
+            if self.offeredLoad > 1:
+                self.timeToOverflow = (moteBufferSize - self.bufferEstimate) / ((self.offeredLoad - 1) * capacity)
+
+        if self.timeToOverflow != None and self.timeToOverflow < LINK_WARNING_TIME:
+            if not self.warned:
+                self.warned = True
+                print('WARNING: The channel offers ' + '%.0f' % (self.offeredLoad * 100) + '% of what the serial link can carry, '
+                      + 'the buffer of the OpenMote is estimated to be full in ' + '%.0f' % self.timeToOverflow + ' seconds. '
+                      + 'A faster --baudrate, --snaplen or --filter keeps the capture lossless.')
+        elif self.offeredLoad < LINK_SATURATED:
+            self.warned = False
+
+        self.reset(now)
+
+
+class SyncClock:
+    # Converts the time of this OpenMote to the time of the OpenMote that transmits the sync frames, and from there to the
+    # time of the pc with the reference that the aggregating sniffer got when it started the beacon. All sniffers with the
+    # same reference give the same timestamp to frames that were received at the same moment, whatever their own drift.
+    def __init__(self, hostReference, beaconReference):
+        self.hostReference = hostReference
+        self.beaconReference = beaconReference
+        self.lastBeaconTime = beaconReference  # The times in the frames wrap around, they are unwrapped near the previous one
+        self.waitingFrames = collections.OrderedDict()  # Time at which each sync frame was received, by counter
+        self.points = collections.deque(maxlen=SYNC_FIT_POINTS)  # Time of the OpenMote and of the beacon for the same frame
+        self.localCenter = None
+        self.beaconCenter = 0
+        self.slope = 1.0
+
+    @staticmethod
+    def isSyncFrame(frame):
+        return (len(frame) == SYNC_FRAME_LENGTH
+                and frame[SYNC_FRAME_MAGIC_OFFSET:SYNC_FRAME_MAGIC_OFFSET+len(SYNC_FRAME_MAGIC)] == SYNC_FRAME_MAGIC)
+
+    def addFrame(self, localTime, frame):
+        counter, previousCounter, previousTime = struct.unpack_from('>III', bytes(frame), SYNC_FRAME_COUNTER_OFFSET)
+        self.waitingFrames[counter] = localTime
+        while len(self.waitingFrames) > SYNC_MAX_WAITING:
+            self.waitingFrames.popitem(last=False)
+
+        # The frame tells when the beacon transmitted the previous frame on this channel
+        if previousCounter not in self.waitingFrames:
+            return
+
+        beaconTime = previousTime + (self.lastBeaconTime & ~0xffffffff)
+        if beaconTime < self.lastBeaconTime - 0x80000000:
+            beaconTime += 0x100000000
+        elif beaconTime > self.lastBeaconTime + 0x80000000:
+            beaconTime -= 0x100000000
+        self.lastBeaconTime = beaconTime
+
+        self.points.append((self.waitingFrames.pop(previousCounter), beaconTime))
+        self.fit()
+
+    def fit(self):
+        # Least squares fit of the beacon time against the local time, around the mean to keep the precision of the floats
+        self.localCenter = sum(point[0] for point in self.points) / float(len(self.points))
+        self.beaconCenter = sum(point[1] for point in self.points) / float(len(self.points))
+        squares = sum((point[0] - self.localCenter) ** 2 for point in self.points)
+        if squares > 0:
+            self.slope = sum((point[0] - self.localCenter) * (point[1] - self.beaconCenter) for point in self.points) / squares
+
+    def convert(self, localTime):
+        # Returns None until the time of a sync frame is known
+        if self.localCenter == None:
+            return None
+        beaconTime = self.beaconCenter + self.slope * (localTime - self.localCenter)
+        return self.hostReference + int(round(beaconTime - self.beaconReference))
+
+
+class PpsClock(SyncClock):
+    # Converts the time of the OpenMote to absolute time with the pulses that a GPS receiver or a clock that follows NTP gives
+    # on its PPS input at the start of every second. Only the first pulse is numbered with the clock of the pc, which needs to be
+    # within half a second, the next ones count on by the time between them. The accuracy is then that of the pulses.
+    def __init__(self):
+        SyncClock.__init__(self, 0, 0)
+        self.points = collections.deque(maxlen=PPS_FIT_POINTS)  # Time of the OpenMote and absolute time of the pulses
+        self.slope = 1000000.0 / timestampTickRate
+        self.lastPulse = None  # Time of the OpenMote and second of the last pulse that was accepted
+
+    def addPulse(self, localTime, hostTime):
+        # Returns False when the pulse was too far from a whole second after the previous one
+        if self.lastPulse == None:
+            second = int(round(hostTime / 1000000.0))
+        else:
+            elapsed = (localTime - self.lastPulse[0]) / float(timestampTickRate)
+            second = self.lastPulse[1] + int(round(elapsed))
+            if abs(self.convert(localTime) - second * 1000000) > PPS_MAX_DEVIATION + elapsed * PPS_MAX_DRIFT:
+                return False
+
+        self.lastPulse = (localTime, second)
+        self.points.append((localTime, second * 1000000))
+        self.fit()
+        return True
+
+
+class HostClock(SyncClock):
+    # Converts the time of the OpenMote to the clock of the pc without the jitter of the USB transfers. A record can't arrive
+    # before the OpenMote received its frame and the serial port carried the escaped message, so every record gives a time of
+    # the pc that is too late by the time it waited and the USB latency. The record of every window that was the least late
+    # lies close to the real offset, the drift and offset are fitted through those.
+    def __init__(self):
+        SyncClock.__init__(self, 0, 0)
+        self.points = collections.deque(maxlen=DEJITTER_FIT_POINTS)  # Time of the OpenMote and of the pc for the best record
+        self.slope = 1000000.0 / timestampTickRate
+        self.windowStart = None
+        self.windowPoint = None  # Record of the current window that arrived the soonest after its frame
+
+    def addRecord(self, localTime, arrivalTime, serialBytes):
+        # The arrival time in seconds is when the last byte of the message reached the pc
+        hostTime = arrivalTime * 1000000 - serialBytes * 10000000.0 / ser.baudrate
+        if self.windowStart == None or localTime - self.windowStart >= DEJITTER_WINDOW * timestampTickRate:
+            if self.windowPoint != None:
+                self.points.append(self.windowPoint)
+                self.fit()
+            self.windowStart = localTime
+            self.windowPoint = None
+
+        offset = hostTime - localTime * 1000000.0 / timestampTickRate
+        if self.windowPoint == None or offset < self.windowPoint[1] - self.windowPoint[0] * 1000000.0 / timestampTickRate:
+            self.windowPoint = (localTime, hostTime)
+
+    def fit(self):
+        # A drift fitted over a few seconds would be further off than that of the crystal
+        slope = self.slope
+        SyncClock.fit(self)
+        if len(self.points) < DEJITTER_MIN_POINTS:
+            self.slope = slope
+
+    def convert(self, localTime):
+        # Until the first window is complete, the best record so far gives the offset
+        if self.localCenter == None:
+            if self.windowPoint == None:
+                return None
+            return int(round(self.windowPoint[1] + (localTime - self.windowPoint[0]) * self.slope))
+        return SyncClock.convert(self, localTime)
+
+
+class PacketProcessor:
+    def __init__(self, discardPacketsWithBadCRC, replaceFCS):
+        self.discardPacketsWithBadCRC = discardPacketsWithBadCRC
+        self.replaceFCS = replaceFCS
+        self.channel = None  # Channel to connect to again after a reset, follows the channel markers
+        self.resetVariables()
+
+        # Functions that handle the records without a frame, by record type. A channel marker has the new channel as its type.
+        self.recordHandlers = {RECORD_TYPE_TELEMETRY: lambda msg, timestamp: outputTelemetry(msg[DATA_OFFSET:], timestamp),
+                               RECORD_TYPE_PPS: self.receivedPulse, RECORD_TYPE_TIMEBASE: self.receivedTimebase}
+        for channel in range(RECORD_TYPE_FIRST_CHANNEL, RECORD_TYPE_LAST_CHANNEL + 1):
+            self.recordHandlers[channel] = self.switchChannel
+
+    def resetVariables(self):
+        self.unackedByteCount = 0
+        self.ackRequested = False  # A record asked for an ACK, or a timer wants the unacknowledged bytes to be acknowledged
+        self.lastIndex = 0
+        self.lastSeqNr = 0
+        self.expectedSeqNr = 0
+        self.retransmission = False
+        self.hostTimeAnchor = None
+        self.moteTimeAnchor = 0
+        self.lastMoteTime = 0
+        self.outOfOrderPackets = {}
+        self.repeatEndSeqNr = 0  # First kept packet after the range that the selective NACK asked for
+        self.selectiveNackPending = False
+        self.invalidMessageReceived = False
+        self.integrityNextSeqNr = None  # Sequence number of the next record in the chain, None until the first checkpoint
+        self.integrityHash = bytes(bytearray(32))
+        self.integrityCount = 0
+        self.integrityHistory = {}  # Hash after each of the last records in the chain, by amount of records
+        self.pendingCheckpoints = {}  # Hash of the checkpoints for records that didn't arrive yet, by amount of records
+        self.recentFrames = {}  # The last records with a frame by sequence number, for the references to duplicates
+        self.lastDescriptor = None  # Descriptor that the OpenMote added to the record that is being output
+        # Records in front of the trigger window may be skipped, and the first record of an attached capture may be any record
+        self.triggerPending = (triggerRule != None and moteSupports(CAPABILITY_TRIGGER)) or attachedCapture
+        self.triggerSeqNr = None  # Sequence number of the frame that matched the trigger, once the TRIGGER report arrived
+        self.triggerFramesLeft = 0  # Frames after the trigger that still have to arrive before the capture is complete
+        self.epoch = moteEpoch  # Epoch from the last READY or EPOCH message, the sequence numbers restart in every epoch
+        self.fecDecoder = FecDecoder() if fecGroupSize > 0 and moteSupports(CAPABILITY_FEC) else None
+        self.fecNackDeferred = False  # A packet went missing, but the FEC message of its group may still give it back
+        self.extendedSeqNr = None  # Full 32-bit sequence number of the last accepted record, None until the first record
+        self.ppsClock = PpsClock() if ppsInput else None  # The time of the OpenMote starts again with every reset
+        self.hostClock = HostClock() if dejitter else None
+        self.messageArrival = None  # Time at which the message that is being processed arrived and its escaped size
+        self.lastPulseNumber = None
+        self.timebaseOffset = None  # Full time of the OpenMote minus the unwrapped time here, from the first TIMEBASE record
+        self.encryptedSession = False  # A session block was written for the epoch of the encrypted records
+
+    def outputRecoveredRecords(self):
+        # Written after connecting again, in front of the frames that were captured since the reset
+        if recoveredRecords:
+            outputRecoveredRecords(self.discardPacketsWithBadCRC, self.replaceFCS)
+
+    def convertTimestamp(self, moteTime):
+        # The time of the first packet is used to synchronize the time on the OpenMote with the time on the pc
+        if self.hostTimeAnchor == None:
+            self.hostTimeAnchor = int(time.time() * 1000000)
+            self.moteTimeAnchor = moteTime
+            self.lastMoteTime = moteTime
+
+        # The timestamp from the OpenMote is in microseconds (unless READY said otherwise) and wraps around after 2^32 ticks
+        moteTime += self.lastMoteTime & ~0xffffffff
+        if moteTime < self.lastMoteTime:
+            moteTime += 0x100000000
+        self.lastMoteTime = moteTime
+
+        # Records that are send again were waiting for the NACK, they would only make the fit worse
+        if self.hostClock != None and self.messageArrival != None and not self.retransmission:
+            self.hostClock.addRecord(moteTime, self.messageArrival[0], self.messageArrival[1])
+
+        # With a sync beacon, all sniffers use the clock of the beacon instead of their own
+        if syncClock != None:
+            syncedTime = syncClock.convert(moteTime)
+            if syncedTime != None:
+                return syncedTime
+
+        # With pulses on the PPS input, the records that arrive before the first one keep the time of the pc
+        if self.ppsClock != None:
+            absoluteTime = self.ppsClock.convert(moteTime)
+            if absoluteTime != None:
+                return absoluteTime
+
+        if self.hostClock != None:
+            return self.hostClock.convert(moteTime)
+
+        return self.hostTimeAnchor + (moteTime - self.moteTimeAnchor) * 1000000 // timestampTickRate
+
+    def serialWriteAck(self):
+        # When the OpenMote asks for ACKs, the threshold only keeps them apart while it is asking
+        if self.unackedByteCount >= ackThreshold and (self.ackRequested or not ackOnRequest):
+            self.unackedByteCount = 0
+            self.ackRequested = False
+            serialWriteAck(self.lastIndex, self.lastSeqNr)
+
+    def ackUnackedBytes(self):
+        if self.unackedByteCount > 0:
+            self.unackedByteCount = ackThreshold
+            self.ackRequested = True
+            self.serialWriteAck()
+
+    def serialTimeout(self):
+        # When the missing packets didn't arrive then just let the OpenMote resend everything
+        if self.selectiveNackPending or self.invalidMessageReceived or self.fecNackDeferred:
+            self.invalidMessageReceived = False
+            self.fecNackDeferred = False
+            self.dropOutOfOrderPackets()
+            serialWriteNack(self.lastIndex, self.lastSeqNr)
+        else:
+            self.ackUnackedBytes()
+
+    def ackDelayed(self):
+        # A pending NACK tells the OpenMote from where it has to send again, the in-order bytes are acknowledged along with it
+        if not self.selectiveNackPending and not self.invalidMessageReceived and not self.fecNackDeferred:
+            self.ackUnackedBytes()
+
+    def resume(self):
+        # The bytes that were received since the last record are gone, the OpenMote sends everything after it again
+        self.unackedByteCount = 0
+        self.retransmission = False
+        self.dropOutOfOrderPackets()
+        self.invalidMessageReceived = False
+        serialWriteResume(self.lastIndex, self.lastSeqNr)
+
+    def dropOutOfOrderPackets(self):
+        self.outOfOrderPackets = {}
+        self.selectiveNackPending = False
+
+    def processPacket(self, msg):
+        global recoveryRequested
+
+        # When the message was invalid (e.g. wrong serial CRC) then the next packet will tell which one went missing,
+        # the OpenMote is only asked to resend everything when no other packet arrives.
+        if len(msg) == 0:
+            self.invalidMessageReceived = True
+            return True
+
+        # The packets are kept as they arrived, the parity was calculated before the ACK flag was taken off
+        if self.fecDecoder != None:
+            self.fecDecoder.add(msg)
+
+        # The records are handled in the layout that they always had
+        if msg[0] & ACK_REQUESTED:
+            msg[0] &= ~ACK_REQUESTED
+            self.ackRequested = True
+
+        if msg[0] == SerialDataType.Ready:
+            # The records that weren't acknowledged might have survived the reset, they are asked for when connecting again
+            print('WARNING: Sniffer reset detected, restarting')
+            recoveryRequested = False
+            return False
+
+        # A late answer to a RESUME or IDENTIFY that was send again
+        if msg[0] in (SerialDataType.Resume, SerialDataType.Identify):
+            return True
+
+        if msg[0] == SerialDataType.FilterStats:
+            if roundTripProbe != None and roundTripProbe.answered():
+                return True
+            counters = [(msg[i] << 24) + (msg[i+1] << 16) + (msg[i+2] << 8) + msg[i+3] for i in range(2, len(msg) - 3, 4)]
+            for i in range(min(len(filterRules), len(counters) - 1)):
+                print('Filter rule ' + str(i) + ' matched ' + str(counters[i]) + ' frames')
+            print(str(counters[-1]) + ' frames were rejected by the filter')
+            return True
+
+        if msg[0] in (SerialDataType.FlashLog, SerialDataType.Baudrate, SerialDataType.Recovery):
+            return True # Only expected as an answer to a request made while connecting
+
+        if msg[0] == SerialDataType.Stats:
+            counters = [(msg[i] << 24) + (msg[i+1] << 16) + (msg[i+2] << 8) + msg[i+3] for i in range(2, len(msg) - 3, 4)]
+            if metrics != None:
+                metrics.moteStats = counters[:len(STATS_NAMES)]
+            if statsPrinted:
+                print('Stats: ' + ', '.join(str(counters[i]) + ' ' + STATS_NAMES[i] for i in range(min(len(counters), len(STATS_NAMES)))))
+                if linkMonitor != None:
+                    print('Serial link: ' + '%.0f' % (linkMonitor.utilisation * 100) + '% used, radio offers '
+                          + '%.0f' % (linkMonitor.offeredLoad * 100) + '%, about ' + str(linkMonitor.bufferEstimate)
+                          + ' of ' + str(moteBufferSize) + ' buffer bytes waiting')
+                printProfilingReport(msg[2 + 4 * len(STATS_NAMES):])
+            if pcapngOutput:
+                outputPcapngStats(msg[2:])
+            return True
+
+        if msg[0] == SerialDataType.Latency:
+            if statsPrinted:
+                print('Latency after the end of the frame:')
+                printLatencyReport(msg[2:])
+            return True
+
+        if msg[0] == SerialDataType.Integrity:
+            self.receivedCheckpoint(msg[2:])
+            return True
+
+        if msg[0] == SerialDataType.Summary:
+            addSummary(msg[2:-2])
+            return True
+
+        if msg[0] == SerialDataType.TopTalkers:
+            addTopTalkers(msg[2:-2])
+            return True
+
+        if msg[0] == SerialDataType.Trigger:
+            self.receivedTrigger(msg[2:2+TRIGGER_REPORT_LENGTH])
+            return True
+
+        if msg[0] == SerialDataType.Epoch:
+            self.receivedEpoch(msg[2:2+EPOCH_REPORT_LENGTH])
+            return True
+
+        if msg[0] == SerialDataType.Tsch:
+            receivedTsch(msg[2:2+TSCH_REPORT_LENGTH])
+            return True
+
+        if msg[0] == SerialDataType.Superframe:
+            receivedSuperframe(msg[2:2+SUPERFRAME_REPORT_LENGTH])
+            return True
+
+        if msg[0] == SerialDataType.AdaptiveHop:
+            receivedAdaptiveHop(msg[2:])
+            return True
+
+        if msg[0] == SerialDataType.Trace:
+            if rtosTrace != None:
+                rtosTrace.received(msg[2:])
+            return True
+
+        if msg[0] == SerialDataType.Fec:
+            self.receivedParity(msg)
+            return True
+
+        if msg[0] == SerialDataType.Degradation:
+            receivedDegradation(msg[2:2+DEGRADATION_REPORT_LENGTH])
+            return True
+
+        # A late answer to a chunk that was send again while connecting
+        if msg[0] == SerialDataType.Control:
+            return True
+
+        if msg[0] == SerialDataType.Inject:
+            if injector != None:
+                injector.received(msg[2:2+INJECT_REPORT_LENGTH])
+            return True
+
+        if msg[0] == SerialDataType.PacketBatch:
+            # Split the batch in its packets, each one starts with a length byte that includes the length byte itself
+            packets = []
+            pos = 2
+            while pos < len(msg):
+                packetLen = msg[pos]
+                if packetLen < DATA_OFFSET + 1 or pos + packetLen > len(msg):
+                    if enableWarnings:
+                        print('WARNING: Received batch with incorrect packet length')
+                    serialWriteNack(self.lastIndex, self.lastSeqNr)
+                    return True
+
+                # Give each packet the same layout as a message of type Packet
+                packet = bytearray([SerialDataType.Packet, packetLen + 1])
+                packet.extend(msg[pos+1:pos+packetLen])
+                if moteSupports(CAPABILITY_ALIGNED_RECORDS) and encryptionKey == None:
+                    packet = removeRecordPadding(packet)
+                    if packet == None:
+                        if enableWarnings:
+                            print('WARNING: Received batch with incorrect packet padding')
+                        serialWriteNack(self.lastIndex, self.lastSeqNr)
+                        return True
+
+                packets.append(packet)
+                pos += packetLen
+
+            # Every packet in the batch is acknowledged on its own, as if they were send separately
+            for packet in packets:
+                self.processSinglePacket(packet)
+        else:
+            self.processSinglePacket(msg)
+
+        return True
+
+    def receivedTrigger(self, data):
+        if len(data) != TRIGGER_REPORT_LENGTH:
+            return
+
+        ackedIndex, ackedSeqNr, self.triggerSeqNr, windowFrames = [(data[i] << 8) + data[i+1] for i in range(0, 8, 2)]
+        discarded = (data[8] << 24) + (data[9] << 16) + (data[10] << 8) + data[11]
+        self.triggerFramesLeft = triggerPostFrames
+        print('Trigger matched, ' + str(windowFrames) + ' frames before it are kept and ' + str(discarded) + ' records were discarded')
+
+        # The OpenMote continues after the record that it treated as acknowledged, the discarded ones never arrive
+        self.triggerPending = False
+        if discarded > 0:
+            self.lastIndex = ackedIndex
+            self.lastSeqNr = ackedSeqNr
+            self.expectedSeqNr = (ackedSeqNr + 1) & 0xffff
+            self.retransmission = False
+            self.unackedByteCount = 0
+            self.dropOutOfOrderPackets()
+
+    def receivedEpoch(self, data):
+        if len(data) != EPOCH_REPORT_LENGTH:
+            return
+
+        epoch, fullSeqNr = struct.unpack('>II', bytes(data))
+        if epoch != self.epoch:
+            if self.epoch != None:
+                print('WARNING: Epoch changed from 0x%08x to 0x%08x without a reset, the sequence numbers restarted' % (self.epoch, epoch))
+            self.epoch = epoch
+            self.extendedSeqNr = None
+            self.encryptedSession = False
+
+        # The record may have arrived already or may still be on its way, it lies less than half the 16-bit range away
+        if self.extendedSeqNr == None:
+            self.extendedSeqNr = (fullSeqNr - 1) & 0xffffffff
+        else:
+            self.extendedSeqNr = (self.extendedSeqNr + fullSeqNr - self.extendSeqNr(fullSeqNr & 0xffff)) & 0xffffffff
+
+    def extendSeqNr(self, seqNr):
+        # Records arrive in order, so the next one is closer to the last one than half of the 16-bit range
+        if self.extendedSeqNr == None:
+            return seqNr
+        distance = (seqNr - self.extendedSeqNr) & 0xffff
+        if distance >= 0x8000:
+            distance -= 0x10000
+        return (self.extendedSeqNr + distance) & 0xffffffff
+
+    def processSinglePacket(self, msg):
+        self.invalidMessageReceived = False
+
+        # Ignore the packet if it had a wrong sequence number
         receivedSeqNr = (msg[SEQ_NR_OFFSET] << 8) + msg[SEQ_NR_OFFSET+1]
+
+        # When the TRIGGER message got lost, the first record that doesn't follow the previous one starts the window.
+        # The same happens with the first record of a capture that the OpenMote started by itself.
+        if self.triggerPending and self.expectedSeqNr != receivedSeqNr:
+            self.triggerPending = False
+            self.expectedSeqNr = receivedSeqNr
+            self.dropOutOfOrderPackets()
         if self.expectedSeqNr == receivedSeqNr:
-            if self.expectedSeqNr == 0xffff:
-                self.expectedSeqNr = 0
+            self.outOfOrderPackets.pop(receivedSeqNr, None)
+            self.acceptPacket(msg)
+
+            # Packets that arrived while waiting for the missing ones can now be processed as well
+            while self.expectedSeqNr in self.outOfOrderPackets:
+                self.acceptPacket(self.outOfOrderPackets.pop(self.expectedSeqNr))
+
+            if len(self.outOfOrderPackets) == 0:
+                self.selectiveNackPending = False
+            elif self.selectiveNackPending and self.repeatEndSeqNr not in self.outOfOrderPackets:
+                # The requested range is complete but another one went missing further on, ask for that one next
+                self.requestMissingPackets()
+
+        else:
+            # If the sequence number is higher than expected then tell the sniffer that we are missing something
+            # The sequence numbers wrap around, so a packet is newer when it lies less than half the range ahead
+            if (receivedSeqNr - self.expectedSeqNr) & 0xffff < 0x8000:
+                self.receivedPacketOutOfOrder(msg, receivedSeqNr)
+            else:
+                # The OpenMote is retransmitting stuff that we already have, so send an ACK to inform it about this
+                if self.retransmission:
+                    # If we already noticed it then only send an ACK every few packets
+                    self.unackedByteCount += len(msg)
+                    self.serialWriteAck()
+                else:
+                    # If this is the first retransmitted packet then immediately send an ACK
+                    self.retransmission = True
+                    self.unackedByteCount = ackThreshold
+                    self.ackRequested = True
+                    self.serialWriteAck()
+
+    def receivedParity(self, msg):
+        repaired = self.fecDecoder.repair(msg) if self.fecDecoder != None and len(msg) > 4 else None
+        if repaired != None:
+            # The rebuilt packet isn't part of the next group
+            fecDecoder = self.fecDecoder
+            self.fecDecoder = None
+            self.processPacket(repaired)
+            self.fecDecoder = fecDecoder
+
+        # Whatever is still missing has to be send again
+        if self.fecNackDeferred:
+            self.fecNackDeferred = False
+            if len(self.outOfOrderPackets) > 0 and not self.selectiveNackPending:
+                self.selectiveNackPending = True
+                self.requestMissingPackets()
+
+    def receivedPacketOutOfOrder(self, msg, receivedSeqNr):
+        if self.fecDecoder != None and not self.selectiveNackPending and len(self.outOfOrderPackets) < MAX_OUT_OF_ORDER_PACKETS:
+            # The FEC message at the end of the group may still give back the missing packet, the NACK waits for it
+            self.outOfOrderPackets[receivedSeqNr] = msg
+            self.fecNackDeferred = True
+        elif not self.selectiveNackPending:
+            # Keep the packet and only ask the OpenMote for the ones that are missing
+            self.outOfOrderPackets[receivedSeqNr] = msg
+            self.selectiveNackPending = True
+            self.requestMissingPackets()
+        elif receivedSeqNr in self.outOfOrderPackets:
+            pass # We already have this packet
+        elif (receivedSeqNr - self.expectedSeqNr) & 0xffff > (self.repeatEndSeqNr - self.expectedSeqNr) & 0xffff \
+         and len(self.outOfOrderPackets) < MAX_OUT_OF_ORDER_PACKETS:
+            # The packets after the missing ones keep arriving while the OpenMote didn't receive our request yet. When there
+            # is another gap between them, it is only requested once the current range was resend, as the OpenMote can only
+            # resend one range at a time.
+            self.outOfOrderPackets[receivedSeqNr] = msg
+        else:
+            # One of the resend packets went missing as well or too much is waiting, let the OpenMote resend everything after
+            # the last received packet
+            self.dropOutOfOrderPackets()
+            serialWriteNack(self.lastIndex, self.lastSeqNr)
+
+    def requestMissingPackets(self):
+        distance = min((seqNr - self.expectedSeqNr) & 0xffff for seqNr in self.outOfOrderPackets)
+        if not moteSupports(CAPABILITY_CUMULATIVE_ACK) or distance > CUMULATIVE_ACK_MISSING_RANGE:
+            self.repeatEndSeqNr = (self.expectedSeqNr + distance) & 0xffff
+            serialWriteSelectiveNack(self.lastIndex, self.lastSeqNr, distance)
+            return
+
+        # Every gap in front of the farthest kept packet that the bitmap still reaches is requested in one go
+        missing = 0
+        missingInFront = 0
+        repeatEnd = distance
+        for offset in range(CUMULATIVE_ACK_MISSING_RANGE + 1):
+            if (self.expectedSeqNr + offset) & 0xffff in self.outOfOrderPackets:
+                repeatEnd = offset
+                missing = missingInFront
+            elif offset < CUMULATIVE_ACK_MISSING_RANGE:
+                missingInFront |= 1 << offset
+
+        # The in-order bytes are acknowledged by the same message
+        self.repeatEndSeqNr = (self.expectedSeqNr + repeatEnd) & 0xffff
+        self.unackedByteCount = 0
+        serialWriteCumulativeAck(self.lastIndex, self.lastSeqNr, missing)
+
+    def acceptPacket(self, msg):
+        if self.expectedSeqNr == 0xffff:
+            self.expectedSeqNr = 0
+        else:
+            self.expectedSeqNr += 1
+
+        self.retransmission = False
+
+        # Remember the index and sequence number of this packet in case the next one is corrupted
+        self.lastIndex = (msg[INDEX_OFFSET] << 8) + msg[INDEX_OFFSET+1]
+        self.lastSeqNr = (msg[SEQ_NR_OFFSET] << 8) + msg[SEQ_NR_OFFSET+1]
+
+        self.recordAccepted(msg)
+
+        # Send an ACK after enough bytes have been received
+        self.unackedByteCount += len(msg)
+        self.serialWriteAck()
+
+    def recordAccepted(self, msg):
+        # The record is hashed as it was received, before the FCS is replaced in it
+        if self.integrityNextSeqNr == (msg[SEQ_NR_OFFSET] << 8) + msg[SEQ_NR_OFFSET+1]:
+            self.hashRecord(msg)
+
+        self.extendedSeqNr = self.extendSeqNr((msg[SEQ_NR_OFFSET] << 8) + msg[SEQ_NR_OFFSET+1])
+
+        # Encrypted records are stored as they arrived, only the holder of the key turns them into a capture
+        if encryptionKey != None:
+            self.outputEncryptedRecord(msg)
+            return
+
+        self.outputRecord(msg)
+
+        # The capture is complete once the frames after the trigger arrived, the OpenMote doesn't store any further frames
+        if self.triggerFramesLeft > 0 and msg[0] == SerialDataType.Packet and msg[ORIGINAL_LENGTH_OFFSET] != 0:
+            distance = ((msg[SEQ_NR_OFFSET] << 8) + msg[SEQ_NR_OFFSET+1] - self.triggerSeqNr) & 0xffff
+            if 0 < distance < 0x8000:
+                self.triggerFramesLeft -= 1
+                if self.triggerFramesLeft == 0:
+                    print('Trigger capture complete')
+
+    def outputEncryptedRecord(self, msg):
+        # The session block tells how the records behind it were encrypted, the nonce contains the epoch
+        if not self.encryptedSession:
+            self.encryptedSession = True
+            flags = ENCRYPTED_SESSION_ALIGNED if moteSupports(CAPABILITY_ALIGNED_RECORDS) else 0
+            session = ENCRYPTED_SESSION.pack(encryptionNonce, self.epoch if self.epoch != None else 0, int(time.time() * 1000000),
+                                             timestampTickRate, flags)
+            writeOutput(ENCRYPTED_BLOCK.pack(ENCRYPTED_BLOCK_SESSION, len(session)) + session)
+
+        writeOutput(ENCRYPTED_BLOCK.pack(ENCRYPTED_BLOCK_RECORD, 4 + len(msg) - 2) + struct.pack('<I', self.extendedSeqNr)
+                    + bytes(msg[2:]))
+
+    def hashRecord(self, msg):
+        self.integrityHash = hashlib.sha256(self.integrityHash + bytes(msg[2:])).digest()
+        self.integrityCount += 1
+        self.integrityNextSeqNr = (self.integrityNextSeqNr + 1) & 0xffff
+
+        self.integrityHistory[self.integrityCount] = self.integrityHash
+        self.integrityHistory.pop(self.integrityCount - INTEGRITY_HISTORY_LEN, None)
+        if self.integrityCount in self.pendingCheckpoints:
+            self.verifyCheckpoint(self.integrityCount, self.pendingCheckpoints.pop(self.integrityCount))
+
+    def receivedCheckpoint(self, data):
+        if len(data) != 6 + 2 * 32:
+            return
+
+        # A checkpoint that doesn't come from someone who knows the key proves nothing
+        if integrityKey == None or not hmac.compare_digest(hmac.new(integrityKey, bytes(data[:38]), hashlib.sha256).digest(),
+                                                           bytes(data[38:])):
+            print('ERROR: Integrity checkpoint with an invalid HMAC')
+            return
+
+        seqNr, count = struct.unpack('>HI', bytes(data[:6]))
+        chainHash = bytes(data[6:38])
+
+        # The first checkpoint tells with which record the chain starts
+        if count == 0:
+            self.integrityNextSeqNr = (seqNr + 1) & 0xffff
+            self.integrityHash = chainHash
+            self.integrityCount = 0
+            self.integrityHistory = {}
+            self.pendingCheckpoints = {}
+        elif count > self.integrityCount:
+            self.pendingCheckpoints[count] = chainHash
+        elif count in self.integrityHistory:
+            self.verifyCheckpoint(count, chainHash)
+        else:
+            print('WARNING: Integrity checkpoint after ' + str(count) + ' records arrived too late to verify it')
+
+    def verifyCheckpoint(self, count, chainHash):
+        if hmac.compare_digest(self.integrityHistory[count], chainHash):
+            if enableWarnings:
+                print('Integrity checkpoint verified after ' + str(count) + ' records')
+        else:
+            print('ERROR: Integrity checkpoint after ' + str(count) + ' records does not match the received records')
+
+    def resolveReferences(self, msg):
+        seqNr = (msg[SEQ_NR_OFFSET] << 8) + msg[SEQ_NR_OFFSET+1]
+
+        # A retry gets a copy of the earlier frame with its own time, RSSI and LQI, it is never referred to itself
+        if msg[CHANNEL_OFFSET] & CHANNEL_DUPLICATE:
+            if duplicates == 'drop':
+                return None
+
+            original = self.recentFrames.get((msg[DATA_OFFSET] << 8) + msg[DATA_OFFSET+1])
+            if original == None:
+                if enableWarnings:
+                    print('WARNING: Duplicate of a frame that was not received')
+                return None
+
+            msg = msg[:DATA_OFFSET] + original[DATA_OFFSET:-2] + msg[DATA_OFFSET+2:DATA_OFFSET+4]
+            msg[CHANNEL_OFFSET] = (msg[CHANNEL_OFFSET] & ~CHANNEL_DUPLICATE) | (original[CHANNEL_OFFSET] & CHANNEL_DECRYPTED)
+            msg[ORIGINAL_LENGTH_OFFSET] = original[ORIGINAL_LENGTH_OFFSET]
+            return msg
+
+        # A compressed header lists the bytes that differ from the header of the earlier record
+        if msg[CHANNEL_OFFSET] & CHANNEL_COMPRESSED:
+            original = self.recentFrames.get((seqNr - msg[DATA_OFFSET]) & 0xffff)
+            if original == None:
+                if enableWarnings:
+                    print('WARNING: Compressed header refers to a frame that was not received')
+                return None
+
+            headerLength = msg[DATA_OFFSET+1]
+            bitmap = msg[DATA_OFFSET+2:DATA_OFFSET+2+(headerLength+7)//8]
+            pos = DATA_OFFSET + 2 + len(bitmap)
+            header = original[DATA_OFFSET:DATA_OFFSET+headerLength]
+            for i in range(headerLength):
+                if bitmap[i // 8] & (1 << (i % 8)):
+                    header[i] = msg[pos]
+                    pos += 1
+
+            msg = msg[:DATA_OFFSET] + header + msg[pos:]
+            msg[CHANNEL_OFFSET] &= ~CHANNEL_COMPRESSED
+
+        self.recentFrames[seqNr] = bytearray(msg)
+        self.recentFrames.pop((seqNr - DUPLICATE_MAX_DISTANCE) & 0xffff, None)
+        return msg
+
+    def switchChannel(self, msg, timestamp):
+        # The OpenMote switched to another channel, the frames before this record were received on the old one
+        self.channel = msg[CHANNEL_OFFSET]
+        if enableWarnings:
+            print('Switched from channel ' + str(msg[DATA_OFFSET]) + ' to channel ' + str(self.channel))
+
+    def receivedTimebase(self, msg, timestamp):
+        # The timestamps are unwrapped by comparing them with the previous one, which misses the wraps when nothing arrived for
+        # longer than the 32-bit time lasts. The full time in this record corrects the count without moving the earlier records.
+        if len(msg) < DATA_OFFSET + TIMEBASE_RECORD_LENGTH:
+            return
+
+        fullTime = struct.unpack_from('>Q', bytes(msg), DATA_OFFSET)[0]
+        if self.timebaseOffset == None:
+            self.timebaseOffset = fullTime - self.lastMoteTime
+        elif fullTime - self.timebaseOffset != self.lastMoteTime:
+            if enableWarnings:
+                print('WARNING: The timestamps wrapped around while no records arrived, they were corrected by '
+                      + str((fullTime - self.timebaseOffset - self.lastMoteTime) >> 32) + ' wraps')
+            self.lastMoteTime = fullTime - self.timebaseOffset
+
+    def receivedPulse(self, msg, timestamp):
+        # The OpenMote numbers the pulses, a gap means that a record didn't fit in its buffer
+        if self.ppsClock == None or len(msg) < DATA_OFFSET + PPS_RECORD_LENGTH:
+            return
+
+        pulseNumber = struct.unpack_from('>I', bytes(msg), DATA_OFFSET)[0]
+        if enableWarnings and self.lastPulseNumber != None and pulseNumber != self.lastPulseNumber + 1:
+            print('WARNING: ' + str(pulseNumber - self.lastPulseNumber - 1) + ' pulses of the PPS input were not stored')
+        self.lastPulseNumber = pulseNumber
+
+        locked = self.ppsClock.lastPulse != None
+        if not self.ppsClock.addPulse(self.lastMoteTime, timestamp):
+            if enableWarnings:
+                print('WARNING: Ignored a pulse on the PPS input that did not come at a whole second')
+        elif not locked:
+            print('The timestamps follow the PPS input from now on')
+
+    def outputRecord(self, msg):
+        # Timestamps have to be unwrapped in order, even for packets that are discarded
+        timestamp = self.convertTimestamp((msg[TIMESTAMP_OFFSET] << 24) + (msg[TIMESTAMP_OFFSET+1] << 16)
+                                          + (msg[TIMESTAMP_OFFSET+2] << 8) + msg[TIMESTAMP_OFFSET+3])
+
+        # A record without a frame is handled by the function of its type, types of a newer firmware are skipped
+        if msg[0] == SerialDataType.Packet and msg[ORIGINAL_LENGTH_OFFSET] == 0:
+            handler = self.recordHandlers.get(msg[CHANNEL_OFFSET])
+            if handler != None:
+                handler(msg, timestamp)
+            return
+
+        # The descriptor is taken off, after that the record looks like one of an OpenMote that doesn't add them
+        self.lastDescriptor = None
+        if msg[0] == SerialDataType.Packet and msg[ORIGINAL_LENGTH_OFFSET] & ORIGINAL_LENGTH_DESCRIPTOR:
+            self.lastDescriptor = parseDescriptor(msg[-DESCRIPTOR_LENGTH:])
+            msg = msg[:-DESCRIPTOR_LENGTH]
+            msg[ORIGINAL_LENGTH_OFFSET] &= ~ORIGINAL_LENGTH_DESCRIPTOR
+            msg[1] -= DESCRIPTOR_LENGTH
+
+        # Records that refer to earlier records get the frame or header back from them
+        if msg[0] != SerialDataType.Survey and (duplicates != 'send' or compressHeaders):
+            msg = self.resolveReferences(msg)
+            if msg == None:
+                return
+
+        # The unwrapped time at which a sync frame was received is needed to fit the clock of the beacon
+        if syncClock != None and msg[-1] & 128 != 0 and SyncClock.isSyncFrame(msg[DATA_OFFSET:]):
+            syncClock.addFrame(self.lastMoteTime, msg[DATA_OFFSET:])
+
+        # Blocks of RSSI samples are not written to the output, they are only added to the statistics
+        if msg[0] == SerialDataType.Survey:
+            addSurveySamples(msg[CHANNEL_OFFSET], msg[DATA_OFFSET:])
+
+        # Discard packets with a bad CRC when requested
+        elif not self.discardPacketsWithBadCRC or msg[-1] & 128 != 0:
+
+            # A truncated frame doesn't contain its FCS, so the RSSI and LQI bytes behind it are dropped
+            originalLength = msg[ORIGINAL_LENGTH_OFFSET]
+            channel = msg[CHANNEL_OFFSET] & ~CHANNEL_DECRYPTED
+            if msg[CHANNEL_OFFSET] & CHANNEL_DECRYPTED:
+                # Decrypted frames are never truncated, only their length changes by removing the security fields
+                msg = msg[:DATA_OFFSET] + removeSecurityHeader(msg[DATA_OFFSET:-2], self.lastDescriptor) + msg[-2:]
+                originalLength = len(msg) - DATA_OFFSET
+
+            # The RSSI (in dBm) and correlation value of the frame, which a pcapng file stores separately
+            rssi = msg[-2] - 256 if msg[-2] >= 128 else msg[-2]
+            lqi = msg[-1] & 0x7f
+            crcValid = msg[-1] & 128 != 0
+
+            truncated = len(msg) - DATA_OFFSET < originalLength
+            if truncated:
+                packet = msg[DATA_OFFSET:-2]
+            else:
+                # Recalculate the CRC unless the alternative FCS was requested or the CRC was invalid
+                if (not self.replaceFCS or pcapngOutput) and crcValid:
+                    crc = calcRadioCRC(msg[DATA_OFFSET:-2])
+                    msg[-2] = crc & 0xff
+                    msg[-1] = (crc >> 8) & 0xff
+
+                packet = msg[DATA_OFFSET:]
+
+            # Write Record Header and the packet to output
+            # The epoch and full sequence number identify the frame, even across several captures of the same OpenMote
+            packetId = (self.epoch << 32) | self.extendedSeqNr if self.epoch != None else None
+            outputPacket(packet, timestamp, originalLength, channel, rssi, lqi, not truncated, not crcValid, packetId)
+
+
+def waitForMessage(types, timeout):
+    # Returns the first valid message of one of the types that arrives before the timeout, or None. Whatever arrived is read at
+    # once and everything else is discarded, the records among it are send again as they don't get acknowledged.
+    msg = None
+    begin = time.time()
+    while time.time() - begin < timeout:
+        available = ser.inWaiting()
+        if available == 0:
+            time.sleep(CONNECT_POLL_INTERVAL)
+            continue
+
+        parts = bytes(ser.read(available)).split(HDLC_FLAG_BYTE)
+        if msg != None:
+            msg.extend(parts[0])
+
+        # Every flag ends the message that was being received, if any, and starts the next one
+        for part in parts[1:]:
+            if msg != None and len(msg) > 0:
+                msg = decode(msg, quiet=True)
+                if len(msg) > 0 and msg[0] in types:
+                    return msg
+            msg = bytearray(part)
+
+    return None
+
+
+def readReady(msg, quiet):
+    global ackThreshold
+    global ackOnRequest
+    global moteCapabilities
+    global moteMaxBaudrate
+    global moteBufferSize
+    global moteEpoch
+    global timestampTickRate
+    global cobsFraming
+    global summaryNextInterval
+
+    # A READY message means that the OpenMote was reset, which brings it back to HDLC framing and restarts the summary intervals
+    cobsFraming = False
+    summaryNextInterval = None
+    summaryCurrent['interval'] = None
+
+    # Newer firmware tells which window size and ACK interval it is using
+    if len(msg) >= 6:
+        window = (msg[2] << 8) + msg[3]
+        ackThreshold = ((msg[4] << 8) + msg[5]) & ~ACK_INTERVAL_ON_REQUEST
+        ackOnRequest = (msg[4] << 8) & ACK_INTERVAL_ON_REQUEST != 0
+        if enableWarnings and not quiet:
+            print('Window size ' + str(window) + ', ACK interval ' + str(ackThreshold) + (' on request' if ackOnRequest else ''))
+    else:
+        ackThreshold = ACK_THRESHOLD
+        ackOnRequest = False
+
+    # Since version 1 it also tells what it can do, a later version only adds fields behind these
+    if len(msg) >= READY_EXTENDED_LENGTH and msg[6] >= 1:
+        version = msg[6]
+        moteCapabilities, bufferSize, moteMaxBaudrate, timestampTickRate = struct.unpack_from('>IHII', bytes(msg), 7)
+        moteBufferSize = bufferSize
+        moteEpoch = None
+        if moteCapabilities & CAPABILITY_EPOCH and len(msg) >= READY_EPOCH_OFFSET + 4 + 2:
+            moteEpoch = struct.unpack_from('>I', bytes(msg), READY_EPOCH_OFFSET)[0]
+            if enableWarnings and not quiet:
+                print('Epoch 0x%08x' % moteEpoch)
+        if len(msg) >= READY_MORE_CAPABILITIES_OFFSET + 4 + 2:
+            moteCapabilities |= struct.unpack_from('>I', bytes(msg), READY_MORE_CAPABILITIES_OFFSET)[0] << 32
+        if enableWarnings and not quiet:
+            print('Firmware version ' + str(version) + ', capabilities 0x' + '%08x' % moteCapabilities + ', buffer of '
+                  + str(bufferSize) + ' bytes, baudrate up to ' + str(moteMaxBaudrate))
+    else:
+        moteCapabilities = LEGACY_CAPABILITIES
+        moteMaxBaudrate = None
+        moteBufferSize = DEFAULT_MOTE_BUFFER_SIZE
+        moteEpoch = None
+        timestampTickRate = TIMESTAMP_TICK_RATE
+
+
+def moteSupports(capability, option=None):
+    # Options that the OpenMote doesn't understand are left out instead of sending messages that it would reject
+    if moteCapabilities & capability:
+        return True
+    if option != None:
+        images = [image for image, capabilities in CAPTURE_IMAGES if capabilities & capability]
+        hint = ' (flash ' + images[0] + ' for it)' if images else ''
+        print('WARNING: The firmware of the OpenMote does not support ' + option + hint + ', continuing without it')
+    return False
+
+
+def connectToOpenMote(channel, quiet = False):
+    global recoveryRequested
+    global attachedCapture
+
+    ser.flushInput()
+    ser.flushOutput()
+
+    try:
+        # Keep sending RESET packet and discard all bytes until the READY packet arrives
+        if not quiet:
+            print('Connecting to OpenMote...')
+
+        # The recovered records would reach the output in the clear
+        if not recoveryRequested and encryptionKey == None:
+            recoveryRequested = True
+            requestRecovery()
+
+        # The connection test doesn't know yet what the OpenMote can do, its frames are never written anywhere
+        if not quiet and not serialWriteEncryption():
+            return False
+
+        # The capabilities are known from an earlier READY, e.g. the one of the connection test
+        ackInterval = requestedAckInterval
+        if ackMode == 'request' and moteCapabilities & CAPABILITY_ACK_REQUEST:
+            ackInterval |= ACK_INTERVAL_ON_REQUEST
+
+        for i in range(CONNECT_ATTEMPTS):
+            # When the OpenMote was reset, it no longer uses the baudrate that was negotiated earlier
+            if i > 0 and ser.baudrate != BAUDRATE:
+                ser.baudrate = BAUDRATE
+
+            if surveySampleInterval > 0:
+                serialWrite(SerialDataType.Survey, [(requestedWindow >> 8) & 0xff, requestedWindow & 0xff,
+                                                    (ackInterval >> 8) & 0xff, ackInterval & 0xff,
+                                                    (surveySampleInterval >> 8) & 0xff, surveySampleInterval & 0xff])
+            elif summaryInterval > 0:
+                serialWrite(SerialDataType.Summary, [channel, (summaryInterval >> 8) & 0xff, summaryInterval & 0xff])
+            else:
+                serialWrite(SerialDataType.Reset, [channel,
+                                                   (requestedWindow >> 8) & 0xff, requestedWindow & 0xff,
+                                                   (ackInterval >> 8) & 0xff, ackInterval & 0xff])
+
+            msg = waitForMessage([SerialDataType.Ready], CONNECT_RETRY_INTERVAL)
+            if msg == None:
+                continue
+
+            # The RESET that was send before this one might still be answered, its READY must not look like a reset later on
+            while i > 0:
+                laterMsg = waitForMessage([SerialDataType.Ready], CONNECT_RETRY_INTERVAL)
+                if laterMsg == None:
+                    break
+                msg = laterMsg
+
+            readReady(msg, quiet)
+
+            # With --hotplug the OpenMote is recognized by its EUI when it comes back on another serial port
+            if hotplug and moteSupports(CAPABILITY_IDENTIFY, '--hotplug'):
+                identifyConnectedMote(quiet)
+
+            # Only the real connection switches to a faster baudrate, not the test of the connection
+            if requestedBaudrates and not quiet and ser.baudrate == BAUDRATE:
+                negotiateBaudrate()
+
+            serialWriteFraming()
+
+            # Filtering, truncating and hopping only make sense when capturing frames, a summary only counts what the filter accepts
+            if surveySampleInterval == 0:
+                serialWriteFilterRules()
+            if surveySampleInterval == 0 and summaryInterval == 0:
+                serialWriteDecryptionKeys()
+                serialWriteIntegrity()
+                serialWriteSnapLength()
+                serialWriteOverflowPolicy()
+                serialWriteFcsFilter()
+                serialWriteDuplicates()
+                serialWriteCompression()
+                serialWriteDescriptors()
+                serialWriteHopSchedule()
+                serialWriteTsch()
+                serialWriteSuperframe()
+                serialWriteTrigger()
+                serialWriteInject()
+                serialWriteTelemetry()
+                serialWritePps()
+                serialWriteTimebase()
+                serialWriteBatching()
+                serialWriteLanes()
+
+            serialWriteStatsInterval()
+            serialWriteRtosTrace()
+            serialWriteFec()
+            serialWriteFlashLog()
+            if not quiet:
+                serialWriteAutostart()
+
+            attachedCapture = False
+            if metrics != None and not quiet:
+                metrics.connects += 1
+            if not quiet:
+                print('Connected to OpenMote')
+            return True
+
+    except serial.serialutil.SerialException as e:
+        print('ERROR: Serial error. PySerial error: ' + str(e))
+
+    print('ERROR: Failed to connect to OpenMote')
+    return False
+
+
+def attachToOpenMote():
+    # The OpenMote that started capturing by itself after booting answers with a READY message followed by a RESUME answer,
+    # without an earlier RESET of this program. Without such a capture it only sends a RESUME answer that didn't resume.
+    global attachedCapture
+    print('Attaching to the capture of the OpenMote...')
+    try:
+        ser.flushInput()
+        for i in range(RESUME_ATTEMPTS):
+            serialWrite(SerialDataType.Autostart, [AUTOSTART_ATTACH])
+            msg = waitForMessage([SerialDataType.Ready, SerialDataType.Resume], CONNECT_RETRY_INTERVAL)
+            if msg == None:
+                continue
+            if msg[0] == SerialDataType.Resume:
+                break
+
+            # The READY message is only send when attaching worked, the RESUME answer behind it may get lost
+            readReady(msg, False)
+            waitForMessage([SerialDataType.Resume], CONNECT_RETRY_INTERVAL)
+            serialWriteFraming()
+            serialWriteStatsInterval()
+            attachedCapture = True
+            print('Attached to the capture of the OpenMote')
+            return True
+
+    except serial.serialutil.SerialException as e:
+        print('ERROR: Serial error. PySerial error: ' + str(e))
+        return False
+
+    print('WARNING: The OpenMote has no capture to attach to, starting a new one')
+    return False
+
+
+def identifyOpenMote():
+    # Returns the EUI-48 of the OpenMote on the serial port, or None when nothing answered the IDENTIFY message. An OpenMote
+    # that was reset in the meantime went back to the baudrate at which it starts.
+    for i in range(RESUME_ATTEMPTS + 1):
+        if i == RESUME_ATTEMPTS:
+            if ser.baudrate == BAUDRATE:
+                break
+            ser.baudrate = BAUDRATE
+
+        serialWrite(SerialDataType.Identify, [])
+        msg = waitForMessage([SerialDataType.Identify], CONNECT_RETRY_INTERVAL)
+        if msg != None and len(msg) >= IDENTIFY_ANSWER_LENGTH:
+            return bytes(msg[IDENTIFY_EUI_OFFSET:IDENTIFY_EUI_OFFSET + 6])
+
+    return None
+
+
+def identifyConnectedMote(quiet):
+    # Only the first OpenMote is remembered, a different one on the same port later on is not taken for it
+    global moteEui
+    eui = identifyOpenMote()
+    if eui == None:
+        print('WARNING: The OpenMote did not tell its EUI, it can only be found again on the same serial port')
+    elif moteEui != None and eui != moteEui:
+        print('WARNING: The serial port now has another OpenMote than the one that the capture started with')
+    else:
+        moteEui = eui
+        if enableWarnings and not quiet:
+            print('EUI-48 ' + ':'.join('%02x' % b for b in bytearray(eui)))
+
+
+def findOpenMote():
+    # Waits until the OpenMote with moteEui shows up on a serial port, which can get another name when the USB device is
+    # enumerated again. The port that it had is tried on every look, a new port is asked until it answers or until an
+    # OpenMote had the time to boot. A port with another OpenMote is left alone until it disappears.
+    originalPort = serialDevice.port
+    firstSeen = {}
+    while not stopSniffingThread:
+        ports = getSerialPortList()
+        for port in [originalPort] + sorted(set(ports) - set([originalPort])):
+            now = time.time()
+            if port != originalPort and now - firstSeen.setdefault(port, now) > HOTPLUG_BOOT_TIME:
+                continue
+
+            eui = None
+            try:
+                serialDevice.close()
+                serialDevice.port = port
+                serialDevice.open()
+                ser.flushInput()
+                eui = identifyOpenMote()
+            except serial.serialutil.SerialException:
+                continue  # Not there (yet), or udev didn't give it its permissions yet
+
+            if eui != None and eui == moteEui:
+                if port != originalPort:
+                    print('Found OpenMote again on ' + port)
+                return True
+            if eui != None:
+                firstSeen[port] = 0
+
+        # A port that disappears and comes back is asked again
+        for port in list(firstSeen):
+            if port not in ports:
+                del firstSeen[port]
+        time.sleep(HOTPLUG_POLL_INTERVAL)
+
+    return False
+
+
+def reattachToOpenMote(packetProcessor, receiver):
+    # After a USB hiccup the OpenMote still has the records that weren't acknowledged. These are send again after a RESUME
+    # message, which continues the sequence numbers, the buffer is only cleared with a RESET when the OpenMote no longer has them.
+    # With --hotplug the OpenMote is waited for without a timeout, on whichever serial port it reappears.
+    global recoveryRequested
+    if hotplug and moteEui != None:
+        if not findOpenMote():
+            return False
+    else:
+        begin = time.time()
+        while True:
+            try:
+                ser.close()
+                ser.open()
+                break
+            except serial.serialutil.SerialException:
+                if stopSniffingThread or (not hotplug and time.time() - begin >= REOPEN_TIMEOUT):
+                    return False
+                time.sleep(CONNECT_RETRY_INTERVAL)
+
+    try:
+        ser.flushInput()
+        for i in range(RESUME_ATTEMPTS if moteSupports(CAPABILITY_RESUME) else 0):
+            if receiver != None:
+                receiver.resume()
             else:
-                self.expectedSeqNr += 1
+                packetProcessor.resume()
 
-            self.retransmission = False
+            msg = waitForMessage([SerialDataType.Resume, SerialDataType.Ready], CONNECT_RETRY_INTERVAL)
+            if msg == None:
+                continue
+            if msg[0] == SerialDataType.Resume and msg[2] != 0:
+                print('Reattached to OpenMote')
+                return True
+            break
+    except serial.serialutil.SerialException:
+        return False
+
+    # The records were lost, which also happens when the OpenMote was reset in the meantime
+    print('WARNING: OpenMote could not continue where it was, restarting')
+    recoveryRequested = False
+    if not connectToOpenMote(packetProcessor.channel):
+        return False
+
+    packetProcessor.resetVariables()
+    if receiver != None:
+        receiver.reset()
+    packetProcessor.outputRecoveredRecords()
+    return True
+
+
+def receiveWithHostLibrary(packetProcessor, receiver, ackTimer):
+    while not stopSniffingThread:
+        if ackTimer.due():
+            receiver.ackDelayed()
+            receiver.writeOutput()
+        ackTimer.update(receiver.unackedBytes())
+
+        # When nothing arrives before the timeout, the receiver decides whether a NACK or an ACK has to be send
+        receivedBytes = ser.read(max(1, ser.inWaiting()))
+        ackTimer.received(len(receivedBytes))
+        if len(receivedBytes) == 0:
+            if ackTimer.silent():
+                receiver.serialTimeout()
+        else:
+            receiver.feed(receivedBytes)
+        if metrics != None:
+            metrics.serialBytes += len(receivedBytes)
+        if linkMonitor != None:
+            linkMonitor.received(len(receivedBytes))
+        if injector != None:
+            injector.poll()
+        if roundTripProbe != None:
+            roundTripProbe.poll()
+        if linkMonitor != None:
+            linkMonitor.poll()
+        if nodeStatistics != None:
+            nodeStatistics.poll()
+        if outputPause != None:
+            outputPause.poll()
+
+        while True:
+            event, data = receiver.nextEvent()
+            receiver.writeOutput()
+            if event == 0:
+                break
+
+            if event == HOST_EVENT_RECORD:
+                packetProcessor.recordAccepted(data)
+            elif event == HOST_EVENT_WARNING:
+                if enableWarnings:
+                    print(HOST_WARNINGS.get(data[0], 'WARNING: Unknown warning ' + str(data[0])))
+            elif not packetProcessor.processPacket(data):
+                # Something happened with the OpenMote, try to connect again
+                ackTimer.stop()
+                if not connectToOpenMote(packetProcessor.channel):
+                    return  # Connection to OpenMote lost, terminate sniffer
+
+                packetProcessor.resetVariables()
+                receiver.reset()
+                packetProcessor.outputRecoveredRecords()
+                break
+
+
+def receiveWithPython(packetProcessor, ackTimer):
+    msg = bytearray()
+    receiving = False
+    while not stopSniffingThread:
+        if injector != None:
+            injector.poll()
+        if roundTripProbe != None:
+            roundTripProbe.poll()
+        if linkMonitor != None:
+            linkMonitor.poll()
+        if nodeStatistics != None:
+            nodeStatistics.poll()
+        if outputPause != None:
+            outputPause.poll()
+        if ackTimer.due():
+            packetProcessor.ackDelayed()
+        ackTimer.update(packetProcessor.unackedByteCount)
+
+        if ser.inWaiting() > 0:
+            receivedBytes = ser.read(ser.inWaiting())
+            readTime = time.time()
+            ackTimer.received(len(receivedBytes))
+        else:
+            # The serial buffer is empty, wait for next byte
+            receivedBytes = bytearray()
+            while len(receivedBytes) == 0 and not stopSniffingThread:
+                receivedBytes = ser.read(1)
+                readTime = time.time()
+                ackTimer.received(len(receivedBytes))
+
+                # Check if timeout was reached
+                if len(receivedBytes) == 0:
+                    if not ackTimer.silent():
+                        # Only the ACK delay passed, the bytes that arrived in order are acknowledged without waiting longer
+                        if ackTimer.due():
+                            packetProcessor.ackDelayed()
+                    elif receiving:
+                        receiving = False
+                        if enableWarnings:
+                            print('WARNING: expected another byte, assuming out of sync')
+                        serialWriteNack(packetProcessor.lastIndex, packetProcessor.lastSeqNr)
+                    else:
+                        # We haven't received any new packets for a moment, if there are still unacknowledged bytes, acknowledge them now
+                        packetProcessor.serialTimeout()
+                    ackTimer.update(packetProcessor.unackedByteCount)
+                if injector != None:
+                    injector.poll()
+                if outputPause != None:
+                    outputPause.poll()
+
+        # Whole runs of bytes between the flags are copied at once instead of looking at every byte
+        receivedBytes = bytes(receivedBytes)
+        if metrics != None:
+            metrics.serialBytes += len(receivedBytes)
+        if linkMonitor != None:
+            linkMonitor.received(len(receivedBytes))
+        pos = 0
+        while pos < len(receivedBytes):
+            if not receiving:
+                receiving = True
+                msg = bytearray()
+
+                if receivedBytes[pos:pos + 1] != HDLC_FLAG_BYTE:
+                    if enableWarnings:
+                        print('WARNING: encountered unexpected byte, assuming out of sync')
+                else:
+                    pos += 1
+                    continue
+
+            # The frame continues in the next read when its closing flag didn't arrive yet
+            end = receivedBytes.find(HDLC_FLAG_BYTE, pos)
+            if end < 0:
+                msg.extend(receivedBytes[pos:])
+                break
+
+            msg.extend(receivedBytes[pos:end])
+            pos = end + 1
+            if len(msg) == 0:
+                if enableWarnings:
+                    print('WARNING: out of sync detected')
+            else:
+                receiving = False
+
+                # The bytes behind the message in the same read arrived after it, at the speed of the serial port
+                if dejitter:
+                    packetProcessor.messageArrival = (readTime - (len(receivedBytes) - pos) * 10.0 / ser.baudrate, len(msg) + 2)
+                if not packetProcessor.processPacket(decode(msg)):
+                    # Something happened with the OpenMote, try to connect again
+                    ackTimer.stop()
+                    if not connectToOpenMote(packetProcessor.channel):
+                        return  # Connection to OpenMote lost, terminate sniffer
+
+                    msg = bytearray()
+                    receiving = False
+                    packetProcessor.resetVariables()
+                    packetProcessor.outputRecoveredRecords()
+                    continue
+
+
+def snifferThread(channel, discardPacketsWithBadCRC, replaceFCS):
+    global snifferThreadTerminated
+
+    packetProcessor = PacketProcessor(discardPacketsWithBadCRC, replaceFCS)
+    packetProcessor.channel = channel
+    receiver = HostReceiver() if hostLibrary != None else None
+    ackTimer = AckTimer()
+    if lowLatency:
+        prioritizeSnifferThread()
+
+    try:
+        while True:
+            try:
+                if receiver != None:
+                    receiveWithHostLibrary(packetProcessor, receiver, ackTimer)
+                else:
+                    receiveWithPython(packetProcessor, ackTimer)
+                return
+
+            except serial.serialutil.SerialException as e:
+                # The serial port can disappear for a moment when the USB connection has a hiccup
+                if stopSniffingThread:
+                    raise
+                print('WARNING: Serial error, reattaching to OpenMote. PySerial error: ' + str(e))
+                ackTimer.stop()
+                if not reattachToOpenMote(packetProcessor, receiver):
+                    raise
+
+    except serial.serialutil.SerialException as e:
+        serialWriteStop()
+        snifferThreadTerminated = True
+        print('ERROR: Serial error, assuming OpenMote disconnected. PySerial error: ' + str(e))
+
+    except IOError as e:
+        serialWriteStop()
+        snifferThreadTerminated = True
+        if e.errno == errno.EPIPE:
+            print('ERROR: Pipe to wireshark is broken')
+        else:
+            print('ERROR: Unknown error. IOError: ' + str(e))
+
+    except Exception as e:
+        serialWriteStop()
+        snifferThreadTerminated = True
+        print('ERROR: Unknown exception thrown, assuming wireshark stopped. Exception: ' + str(e))
+
+
+def configureLowLatency(port):
+    # Linux lets the serial driver pass on every byte immediately, an FTDI chip in addition waits its latency timer before
+    # sending what it received over USB. Both need to be shortened for the ACKs to reach the OpenMote quickly.
+    if hasattr(ser, 'set_low_latency_mode'):
+        try:
+            ser.set_low_latency_mode(True)
+        except (IOError, OSError, ValueError) as e:
+            print('WARNING: Could not set the low latency flag of the serial port. Error: ' + str(e))
+
+    if sys.platform.startswith('linux'):
+        timerFile = '/sys/bus/usb-serial/devices/' + os.path.basename(os.path.realpath(port)) + '/latency_timer'
+        if os.path.exists(timerFile):
+            try:
+                with open(timerFile, 'w') as f:
+                    f.write(str(LOW_LATENCY_TIMER))
+            except (IOError, OSError) as e:
+                print('WARNING: Could not shorten the latency timer in ' + timerFile + ' (root is required). Error: ' + str(e))
+
+
+def prioritizeSnifferThread():
+    # The calling thread is given a real-time priority and keeps running on the last CPU, so that the other threads and
+    # programs don't delay reading the serial port and sending the ACKs. On other systems than Linux nothing changes.
+    if hasattr(os, 'sched_setscheduler'):
+        try:
+            os.sched_setscheduler(0, os.SCHED_FIFO, os.sched_param(LOW_LATENCY_PRIORITY))
+        except (OSError, AttributeError) as e:
+            print('WARNING: Could not give the sniffer thread a real-time priority (root or CAP_SYS_NICE is required). Error: ' + str(e))
+    if hasattr(os, 'sched_setaffinity'):
+        try:
+            os.sched_setaffinity(0, [max(os.sched_getaffinity(0))])
+        except OSError as e:
+            print('WARNING: Could not pin the sniffer thread to a CPU. Error: ' + str(e))
+
+
+def parseAggregateMotes(text):
+    # Every OpenMote is given as "PORT:CHANNEL", separated by commas
+    motes = []
+    for item in text.split(','):
+        port, separator, channel = item.strip().rpartition(':')
+        if not separator or not port:
+            raise ValueError('"' + item + '" should be PORT:CHANNEL')
+        channel = int(channel)
+        if channel < 11 or channel > 26:
+            raise ValueError('channel ' + str(channel) + ' is not between 11 and 26')
+        motes.append((port, channel))
+
+    if len(motes) > AGGREGATE_MAX_MOTES:
+        raise ValueError('at most ' + str(AGGREGATE_MAX_MOTES) + ' OpenMotes are supported')
+    return motes
+
+
+class AggregateStream:
+    # Reads the pcapng that a sniffer for a single OpenMote writes to its stdout. The packet blocks are kept in the order
+    # in which they arrive, which is also the order of their timestamps as each sniffer converts the time of its OpenMote
+    # to the time of this pc. With channelInterfaces the interface follows from the channel of the frame instead, for a
+    # sniffer that hops, and the frames per channel and the statistics of the OpenMote are kept for the fleet.
+    def __init__(self, process, interface, condition, channelInterfaces=None):
+        self.process = process
+        self.interface = interface
+        self.condition = condition
+        self.channelInterfaces = channelInterfaces
+        self.blocks = collections.deque()  # (timestamp in microseconds, packet block)
+        self.channelFrames = collections.Counter()
+        self.statsTime = None  # When the last statistics of the OpenMote arrived
+        self.finished = False
+        self.thread = threading.Thread(target=self.run)
+        self.thread.daemon = True
+        self.thread.start()
+
+    def run(self):
+        stream = self.process.stdout
+        try:
+            while True:
+                header = stream.read(8)
+                if len(header) < 8:
+                    break
+
+                blockType, blockLength = struct.unpack('>II', header)
+                body = stream.read(blockLength - 8)
+                if len(body) < blockLength - 8:
+                    break
+
+                # Only the frames are merged, there is a new header for the merged capture. A degradation report is the
+                # only other custom block of the sniffer (behind the PEN), the statistics are always longer.
+                if (blockType == PCAPNG_CUSTOM_BLOCK and self.channelInterfaces != None
+                        and len(body) - 8 > (1 + DEGRADATION_REPORT_LENGTH + 3) & ~3):
+                    self.statsTime = time.time()
+                if blockType != 0x00000006:
+                    continue
+
+                block = bytearray(header + body)
+                if self.channelInterfaces != None:
+                    channel = TAP_HEADER.unpack_from(block, PCAPNG_EPB_HEADER.size)[11]
+                    if channel not in self.channelInterfaces:
+                        continue
+                    self.channelFrames[channel] += 1
+                    struct.pack_into('>I', block, 8, self.channelInterfaces[channel])
+                else:
+                    struct.pack_into('>I', block, 8, self.interface)
+                timestampHigh, timestampLow = struct.unpack_from('>II', block, 12)
+                with self.condition:
+                    self.blocks.append((((timestampHigh << 32) | timestampLow) // 1000, bytes(block)))
+                    self.condition.notify()
+        except (IOError, OSError):
+            pass
+
+        with self.condition:
+            self.finished = True
+            self.condition.notify()
+
+
+def aggregateReception(block):
+    # Channel and frame (the part of the packet block behind the TAP header) to recognize the same frame, with the RSSI and LQI
+    tap = TAP_HEADER.unpack_from(block, PCAPNG_EPB_HEADER.size)
+    capturedLength = struct.unpack_from('>I', block, 20)[0]
+    return (tap[11], block[PCAPNG_EPB_HEADER.size + TAP_HEADER.size:PCAPNG_EPB_HEADER.size + capturedLength]), int(round(tap[8])), tap[15]
+
+
+def mergeAggregateDuplicates(block, timestamp, streams, window):
+    # Removes the copies of the frame that the other OpenMotes received within the window, and adds every OpenMote that
+    # received it to the packet block
+    key, rssi, lqi = aggregateReception(block)
+    receivers = [(struct.unpack_from('>I', block, 8)[0], rssi, lqi, timestamp)]
+    for stream in streams:
+        closest = None
+        for i, (otherTimestamp, otherBlock) in enumerate(stream.blocks):
+            if otherTimestamp > timestamp + window:
+                break
+            otherKey, otherRssi, otherLqi = aggregateReception(otherBlock)
+            if otherKey == key and (closest == None or otherTimestamp < closest[1]):
+                closest = (i, otherTimestamp, otherRssi, otherLqi)
+        if closest != None:
+            del stream.blocks[closest[0]]
+            receivers.append((stream.interface, closest[2], closest[3], closest[1]))
+
+    if len(receivers) == 1:
+        return block, 0
+    return pcapngAddReceivers(block, receivers), len(receivers) - 1
+
+
+def pcapngAddReceivers(block, receivers):
+    # The options of the sniffer are kept, the option with the interface, RSSI, LQI and timestamp of every receiver goes in
+    # front of the opt_endofopt
+    blockLength, capturedLength = struct.unpack_from('>I', block, 4)[0], struct.unpack_from('>I', block, 20)[0]
+    optionsStart = PCAPNG_EPB_HEADER.size + capturedLength + (4 - capturedLength % 4) % 4
+    optionsEnd = optionsStart
+    while optionsEnd + 4 <= blockLength - 4:
+        code, length = struct.unpack_from('>HH', block, optionsEnd)
+        if code == 0:
+            break
+        optionsEnd += 4 + length + (4 - length % 4) % 4
+    options = block[optionsStart:min(optionsEnd, blockLength - 4)]
+    data = struct.pack('>I', PCAPNG_CUSTOM_PEN) + b''.join(AGGREGATE_RECEIVER.pack(*receiver) for receiver in receivers)
+    options += struct.pack('>HH', PCAPNG_OPT_CUSTOM_BINARY, len(data)) + data + struct.pack('>HH', 0, 0)
+    merged = bytearray(block[:optionsStart]) + options + struct.pack('>I', optionsStart + len(options) + 4)
+    struct.pack_into('>I', merged, 4, len(merged))
+    return bytes(merged)
+
+
+def mergeAggregateStreams(streams, condition, stopping, mergeWindow):
+    # A frame is written when every other OpenMote has a later frame waiting, when it waited long enough for frames
+    # from quiet OpenMotes, or when too many frames are waiting. Until then an earlier frame might still arrive. When
+    # duplicates are merged, the other OpenMotes need a frame later than the window, as a copy could still arrive before it.
+    merged = 0
+    while True:
+        with condition:
+            condition.wait(0.05)
+            now = int(time.time() * 1000000)
+            while True:
+                waiting = [stream for stream in streams if len(stream.blocks) > 0]
+                if len(waiting) == 0:
+                    break
+
+                oldest = min(waiting, key=lambda stream: stream.blocks[0][0])
+                timestamp = oldest.blocks[0][0]
+                complete = all(stream is oldest or stream.finished
+                               or (len(stream.blocks) > 0 and stream.blocks[-1][0] >= timestamp + mergeWindow) for stream in streams)
+                if (not complete and timestamp > now - AGGREGATE_MERGE_DELAY * 1000000
+                        and max(len(stream.blocks) for stream in waiting) <= AGGREGATE_MAX_PENDING):
+                    break
+
+                block = oldest.blocks.popleft()[1]
+                if mergeWindow > 0:
+                    block, duplicates = mergeAggregateDuplicates(block, timestamp, [stream for stream in streams if stream is not oldest],
+                                                                 mergeWindow)
+                    merged += duplicates
+                try:
+                    writeOutput(block, timestamp)
+                except IOError as e:
+                    print('ERROR: Failed to write the merged capture. IOError: ' + str(e))
+                    return
+
+            if all(stream.finished for stream in streams) and stopping.is_set():
+                if mergeWindow > 0:
+                    print('Merged ' + str(merged) + ' copies of frames that several OpenMotes received')
+                return
+
+
+def aggregateCommand(args, channels):
+    # Command of the sniffer process of every OpenMote, without its port and channel. Returns None when the sync beacon
+    # didn't start.
+    command = [sys.executable, os.path.abspath(__file__), '-o', '-', '--pcapng']
+    for option, value in [('--baudrate', args.baudrate), ('--snaplen', args.snaplen), ('--overflow', args.overflow),
+                          ('--duplicates', args.duplicates), ('--framing', args.framing), ('--trigger', args.trigger),
+                          ('--pre-trigger', args.pre_trigger), ('--post-trigger', args.post_trigger),
+                          ('--batching', args.batching), ('--batch-threshold', args.batch_threshold),
+                          ('--batch-hold-time', args.batch_hold_time)]:
+        if value:
+            command += [option, str(value)]
+    for rule in args.filter:
+        command += ['--filter', rule]
+    for key in args.key:
+        command += ['--key', key]
+    for option, enabled in [('--keep-bad-fcs', args.keep_bad_fcs), ('--python-receiver', args.python_receiver),
+                            ('--compress-headers', args.compress_headers), ('--descriptors', args.descriptors),
+                            ('--mote-fcs-filter', args.mote_fcs_filter), ('--low-latency', args.low_latency),
+                            ('--hotplug', args.hotplug), ('--enable-warnings', args.enable_warnings)]:
+        if enabled:
+            command.append(option)
+
+    # The beacon is started first, so that every sniffer can be given the same reference for its time
+    if args.sync_beacon != None:
+        print('Starting sync beacon on ' + args.sync_beacon + '...')
+        reference = startSyncBeacon(channels, args.sync_interval)
+        if reference == None:
+            print('ERROR: The OpenMote on ' + args.sync_beacon + ' did not start sending sync frames')
+            return None
+        command += ['--sync-reference', str(reference[0]) + ':' + str(reference[1])]
+    return command
+
+
+def aggregateSniffers(args):
+    # Every OpenMote gets its own sniffer process that writes a pcapng to its stdout, the frames of all of them are
+    # merged here into a single capture with an interface per OpenMote
+    command = aggregateCommand(args, set(channel for port, channel in aggregateMotes))
+    if command == None:
+        return
+
+    condition = threading.Condition()
+    stopping = threading.Event()
+    streams = []
+    for interface, (port, channel) in enumerate(aggregateMotes):
+        print('Starting sniffer for ' + port + ' on channel ' + str(channel) + '...')
+        process = subprocess.Popen(command + ['-p', port, '-c', str(channel)], stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+        streams.append(AggregateStream(process, interface, condition))
+
+    merger = threading.Thread(target=mergeAggregateStreams, args=[streams, condition, stopping, args.merge_duplicates])
+    merger.start()
+
+    try:
+        INPUT('Press return key to stop the sniffers\n')
+    except (KeyboardInterrupt, EOFError, SystemExit):
+        pass
+
+    # Closing stdin pauses each sniffer, which then quits as no channel can be chosen
+    for stream in streams:
+        try:
+            stream.process.stdin.close()
+        except (IOError, OSError):
+            pass
+    for stream in streams:
+        stream.process.wait()
+
+    stopping.set()
+    merger.join()
+
+
+class FleetMote:
+    # The sniffer process of a single OpenMote of the fleet, listening on one channel or hopping over several. It counts as
+    # alive while its process runs and the statistics that it requests every second keep arriving.
+    def __init__(self, port, channels, command, condition, channelInterfaces, dwell):
+        self.port = port
+        self.channels = channels
+        self.started = time.time()
+        if len(channels) == 1:
+            command = command + ['-c', str(channels[0])]
+        else:
+            command = command + ['--hop', ','.join(str(channel) for channel in channels), '--dwell', str(dwell)]
+        self.process = subprocess.Popen(command + ['-p', port, '--stats-pcapng'],
+                                        stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+        self.stream = AggregateStream(self.process, None, condition, channelInterfaces)
+        self.messages = threading.Thread(target=self.forwardMessages)
+        self.messages.daemon = True
+        self.messages.start()
+
+    def forwardMessages(self):
+        # The messages of the sniffer are printed with its port in front, except for the statistics of every second
+        try:
+            for line in iter(self.process.stderr.readline, b''):
+                line = line.decode('utf-8', 'replace').rstrip()
+                if line != '' and not line.startswith('Stats: ') and not line.startswith('Serial link: '):
+                    print(self.port + ': ' + line)
+        except (IOError, OSError, ValueError):
+            pass
+
+    def alive(self):
+        if self.process.poll() != None:
+            return False
+        if self.stream.statsTime == None:
+            return time.time() - self.started < FLEET_START_TIMEOUT
+        return time.time() - self.stream.statsTime < FLEET_STATS_TIMEOUT
+
+    def stop(self):
+        # Closing stdin pauses the sniffer, which then quits. One that hangs on a missing port is killed.
+        try:
+            self.process.stdin.close()
+        except (IOError, OSError):
+            pass
+        deadline = time.time() + FLEET_STOP_TIMEOUT
+        while self.process.poll() == None and time.time() < deadline:
+            time.sleep(0.1)
+        if self.process.poll() == None:
+            self.process.kill()
+            self.process.wait()
+
+
+class Fleet:
+    # Starts a sniffer for every OpenMote that is plugged in and divides the channels over them. A busy channel gets an
+    # OpenMote of its own, quiet channels share one that hops between them. When an OpenMote stops working its channels
+    # are moved to a spare OpenMote, or added to the hop set of the least busy one; an OpenMote that is plugged in lets the
+    # channels be divided again. The frames per second of every channel are measured from the frames of the sniffers,
+    # counted for the full dwell time of a channel that is only listened to part of the time.
+    def __init__(self, args, channels, command, streams, condition):
+        self.args = args
+        self.channels = channels
+        self.command = command
+        self.streams = streams
+        self.condition = condition
+        self.channelInterfaces = dict((channel, interface) for interface, channel in enumerate(channels))
+        self.exclude = set(port.strip() for port in args.fleet_exclude.split(',')) if args.fleet_exclude != None else set()
+        if args.sync_beacon != None:
+            self.exclude.add(args.sync_beacon)
+        self.motes = {}  # Running sniffers by port
+        self.spares = []  # Ports of OpenMotes that weren't needed
+        self.failed = {}  # Port to when its sniffer failed
+        self.load = dict((channel, 0.0) for channel in channels)
+        self.lastMeasurement = time.time()
+        self.lastRebalance = time.time()
+        self.stopping = threading.Event()
+        self.thread = threading.Thread(target=self.run)
+        self.thread.start()
+
+    def measureLoad(self):
+        now = time.time()
+        interval = max(now - self.lastMeasurement, 0.001)
+        self.lastMeasurement = now
+        with self.condition:
+            for mote in self.motes.values():
+                for channel in mote.channels:
+                    rate = mote.stream.channelFrames[channel] * len(mote.channels) / interval
+                    self.load[channel] += FLEET_LOAD_SMOOTHING * (rate - self.load[channel])
+                mote.stream.channelFrames.clear()
+
+    def divide(self, ports):
+        # The busiest channel goes first to the OpenMote with the least load, so a busy channel ends up on its own
+        sets = dict((port, []) for port in ports)
+        for channel in sorted(self.channels, key=lambda channel: (-self.load[channel], channel)):
+            port = min(ports, key=lambda port: (sum(self.load[c] for c in sets[port]), len(sets[port]), port))
+            sets[port].append(channel)
+        return dict((port, sorted(channels)) for port, channels in sets.items() if len(channels) > 0)
+
+    def maxLoad(self, sets):
+        return max([sum(self.load[channel] for channel in channels) for channels in sets] + [0])
+
+    def start(self, port, channels):
+        if port in self.motes:
+            if self.motes[port].channels == channels:
+                return
+            self.motes.pop(port).stop()
+        print('Fleet: ' + port + (' on channel ' if len(channels) == 1 else ' hopping over channels ')
+              + ','.join(str(channel) for channel in channels))
+        mote = FleetMote(port, channels, self.command, self.condition, self.channelInterfaces, self.args.dwell)
+        with self.condition:
+            self.streams.append(mote.stream)
+        self.motes[port] = mote
+
+    def apply(self, sets, ports):
+        # Only the OpenMotes of which the channels change are restarted, the ports without channels are kept as spares
+        for port in list(self.motes.keys()):
+            if port not in sets:
+                self.motes.pop(port).stop()
+        self.spares = [port for port in ports if port not in sets]
+        for port, channels in sorted(sets.items()):
+            self.start(port, channels)
+        self.lastRebalance = time.time()
+
+    def failover(self, port):
+        # The channels of the OpenMote that died go to a spare one, or are divided over the hop sets of the others
+        mote = self.motes.pop(port)
+        mote.stop()
+        channels = mote.channels
+        self.failed[port] = time.time()
+        print('WARNING: Fleet: the OpenMote on ' + port + ' stopped working, moving channel(s) '
+              + ','.join(str(channel) for channel in channels))
+        if len(self.spares) > 0:
+            self.start(self.spares.pop(0), channels)
+        elif len(self.motes) > 0:
+            sets = dict((other, list(mote.channels)) for other, mote in self.motes.items())
+            for channel in sorted(channels, key=lambda channel: -self.load[channel]):
+                other = min(sets, key=lambda other: (sum(self.load[c] for c in sets[other]), len(sets[other]), other))
+                sets[other] = sorted(sets[other] + [channel])
+            self.apply(sets, list(sets.keys()))
+        else:
+            print('WARNING: Fleet: no OpenMote is left, waiting for one to be plugged in')
+
+    def scan(self):
+        now = time.time()
+        for port in [port for port, mote in self.motes.items() if not mote.alive()]:
+            self.failover(port)
+
+        # A port that disappeared is forgotten, so an OpenMote that is plugged in again on it is used right away
+        present = set(port for port in getSerialPortList() if port not in self.exclude)
+        for port in list(self.failed.keys()):
+            if port not in present or now - self.failed[port] > FLEET_RETRY_INTERVAL:
+                del self.failed[port]
+        self.spares = [port for port in self.spares if port in present]
+        newPorts = sorted(port for port in present if port not in self.motes and port not in self.spares and port not in self.failed)
+
+        ports = sorted(list(self.motes.keys()) + self.spares + newPorts)
+        if len(newPorts) > 0:
+            print('Fleet: found ' + ', '.join(newPorts))
+            self.apply(self.divide(ports), ports)
+        elif len(ports) > 0 and now - self.lastRebalance > FLEET_REBALANCE_INTERVAL:
+            # The channels are only divided again when that clearly helps, every change restarts sniffers
+            sets = self.divide(ports)
+            if self.maxLoad(sets.values()) < FLEET_REBALANCE_GAIN * self.maxLoad(mote.channels for mote in self.motes.values()):
+                print('Fleet: dividing the channels again by their load')
+                self.apply(sets, ports)
+            self.lastRebalance = now
+
+        # The streams of stopped sniffers are left out of the merge once all their frames were written
+        with self.condition:
+            self.streams[:] = [stream for stream in self.streams if not stream.finished or len(stream.blocks) > 0]
+
+    def run(self):
+        while not self.stopping.is_set():
+            self.measureLoad()
+            try:
+                self.scan()
+            except (IOError, OSError) as e:
+                print('ERROR: Fleet: failed to start a sniffer. Exception: ' + str(e))
+            self.stopping.wait(FLEET_SCAN_INTERVAL)
+
+        for mote in self.motes.values():
+            mote.stop()
+
+    def stop(self):
+        self.stopping.set()
+        self.thread.join()
+
+
+def runFleet(args):
+    # Like --aggregate, but the OpenMotes are found and given their channels automatically
+    command = aggregateCommand(args, set(fleetChannels))
+    if command == None:
+        return
+
+    condition = threading.Condition()
+    stopping = threading.Event()
+    streams = []
+    merger = threading.Thread(target=mergeAggregateStreams, args=[streams, condition, stopping, args.merge_duplicates])
+    merger.start()
+    fleet = Fleet(args, fleetChannels, command, streams, condition)
+
+    try:
+        INPUT('Press return key to stop the sniffers\n')
+    except (KeyboardInterrupt, EOFError, SystemExit):
+        pass
+
+    fleet.stop()
+    stopping.set()
+    merger.join()
+
+
+def parseArguments():
+    parser = argparse.ArgumentParser(description='IEEE 802.15.4 Sniffer')
+    parser.add_argument('-c', '--channel', dest='channel', type=int,
+                        help='Channel on which the sniffer should start listening (11-26)')
+    parser.add_argument('-p', '--port', dest='port',
+                        help='Full name of serial port to use. On linux this is e.g. "/dev/ttyUSB0"')
+    parser.add_argument('-w', '--wireshark', dest='wireshark_executable', default='wireshark',
+                        help='Filename of the wireshark executable (if not just "wireshark" or capturing to file)')
+    parser.add_argument('-t', '--pipe', dest='pipe_name', default='fifopipe',
+                        help='Name of the temporary pipe to wireshark (when not capturing to file)')
+    parser.add_argument('--aggregate', dest='aggregate_motes',
+                        help='Run a sniffer for every OpenMote in "PORT:CHANNEL,PORT:CHANNEL,..." and merge their frames '
+                             'into a single pcapng with an interface per OpenMote')
+    parser.add_argument('--fleet', metavar='CHANNELS',
+                        help='Run a sniffer for every OpenMote that is plugged in (also later on) and divide these channels over them by '
+                             'their load, e.g. 11-26. A channel of an OpenMote that stops working is moved to another one. Writes a pcapng '
+                             'with an interface per channel')
+    parser.add_argument('--fleet-exclude', metavar='PORTS',
+                        help='Comma separated serial ports that --fleet should leave alone')
+    parser.add_argument('--merge-duplicates', type=int, nargs='?', const=AGGREGATE_DUPLICATE_WINDOW, default=0, metavar='MICROSECONDS',
+                        help='Write a frame that several OpenMotes of --aggregate received on the same channel within MICROSECONDS '
+                             '(default: %d) only once, with the RSSI, LQI and timestamp of every OpenMote' % AGGREGATE_DUPLICATE_WINDOW)
+    parser.add_argument('--sync-beacon',
+                        help='Serial port of an extra OpenMote that transmits sync frames on the channels of --aggregate, '
+                             'the timestamps of all OpenMotes are then aligned to its clock')
+    parser.add_argument('--sync-interval', type=int, default=DEFAULT_SYNC_INTERVAL,
+                        help='Milliseconds between two sync frames of the sync beacon')
+    parser.add_argument('--sync-reference', help='Time of the pc and of the sync beacon as HOST:BEACON, passed by --aggregate')
+    parser.add_argument('-o', '--output', dest='pcap_file',
+                        help='Filename of .pcap file to output, or - for stdout. The existence of this parameter decides whether real-time capturing with wireshark is used or whether the sniffer just outputs to a pcap file')
+    parser.add_argument('--live-view', action='store_true',
+                        help='Also start Wireshark while writing to the file of -o, it shows a part of the frames while the file gets all of them')
+    parser.add_argument('--live-rate', type=int, default=LIVE_VIEW_MAX_RATE,
+                        help='Frames per second that the live view shows at most, 0 for no limit (default: %d)' % LIVE_VIEW_MAX_RATE)
+    parser.add_argument('--live-sample', type=int, default=1, metavar='N',
+                        help='Only pass every Nth frame to the live view (default: 1)')
+    parser.add_argument('-f', '--force', action='store_true',
+                        help='Overwrite pcap file or pipe when it already exists')
+    parser.add_argument('--replace-fcs', action='store_true',
+                        help='Replace the normal radio FCS by the TI CC24XX FCS which contains the RSSI and LQI')
+    parser.add_argument('--keep-bad-fcs', action='store_true',
+                        help="Don't discard packets that have a bad checksum")
+    parser.add_argument('--mote-fcs-filter', action='store_true',
+                        help='Let the OpenMote discard the packets that have a bad checksum instead of sending them, '
+                             'only their amount is shown by --stats')
+    parser.add_argument('--window', type=int, default=0,
+                        help='Amount of unacknowledged bytes after which the OpenMote retransmits (default: adapt to the round-trip time)')
+    parser.add_argument('--ack-interval', type=int, default=ACK_THRESHOLD,
+                        help='Amount of received bytes after which an ACK is send (default: ' + str(ACK_THRESHOLD) + ')')
+    parser.add_argument('--ack-delay', type=float, default=ACK_DELAY * 1000, metavar='MS',
+                        help='Milliseconds after which received bytes are acknowledged when the ACK interval was not reached '
+                             '(default: ' + str(int(ACK_DELAY * 1000)) + ', at least ' + str(int(ACK_REQUEST_DELAY * 1000))
+                             + ' when the ACKs are send on request)')
+    parser.add_argument('--acks', choices=['request', 'interval'], default='request',
+                        help='Only send an ACK after the ACK interval when the OpenMote asks for it because its buffer is '
+                             'filling up, or after every interval as older firmware needs (default: request)')
+    parser.add_argument('--batching', choices=sorted(BATCHING_MODES.keys()),
+                        help='Let the OpenMote send every record at once (latency, the default) or hold the records back until '
+                             '--batch-threshold bytes are waiting or the oldest one waited --batch-hold-time, so that they fill '
+                             'whole batches (throughput). The STATS message reports the latency that this adds')
+    parser.add_argument('--batch-threshold', type=int, default=BATCH_THRESHOLD, metavar='BYTES',
+                        help='Bytes that the records wait for in throughput mode (default: ' + str(BATCH_THRESHOLD) + ')')
+    parser.add_argument('--batch-hold-time', type=int, default=BATCH_HOLD_TIME, metavar='MS',
+                        help='Milliseconds that a record waits at most in throughput mode, rounded up to the 10 ms ticks of '
+                             'the OpenMote (default: ' + str(BATCH_HOLD_TIME) + ')')
+    parser.add_argument('--filter', action='append', default=[],
+                        help='Only capture frames matching this rule, can be given up to ' + str(FILTER_MAX_RULES) + ' times. '
+                             'Format: comma separated list of type=beacon|data|ack|cmd, dstpan=PAN, srcpan=PAN, dst=ADDR or src=ADDR. '
+                             'When all rules have the same dstpan and at most one short and one extended dst, the radio already '
+                             'drops the other frames and they are not counted as rejected')
+    parser.add_argument('--filter-program',
+                        help='Only capture frames that also match this expression, which the OpenMote checks on every frame. '
+                             'Comparisons of len, type, byte[N], be16[N] or le16[N] (N or payload+N, counted from the start of '
+                             'the frame or of the MAC payload) with an optional "& MASK" and ==, !=, <, <=, > or >= NUMBER, '
+                             'combined with and, or, not and parentheses. Example: "type == data and byte[payload] & 0xe0 == 0x60"')
+    parser.add_argument('--key', action='append', default=[],
+                        help='Let the OpenMote decrypt the secured frames with this key, can be given up to ' + str(DECRYPTION_MAX_KEYS) + ' times. '
+                             'Format: 16 bytes in hex followed by pan=PAN and/or src=ADDR, a short src also needs ext=ADDR for the nonce')
+    parser.add_argument('--snaplen', type=int, default=0,
+                        help='Only capture the first bytes of each frame, e.g. 9 for headers with short addresses (default: capture entire frames)')
+    parser.add_argument('--overflow', choices=sorted(OVERFLOW_POLICIES.keys()),
+                        help='What the OpenMote does with new frames while its buffer is almost full: drop them once they no longer fit '
+                             '(drop-new, default), only keep their MAC header (keep-headers), drop data and ACK frames to keep room for '
+                             'beacons and MAC commands (prefer-control) or already start keeping only headers and dropping ACKs '
+                             'while the buffer fills up and go back to entire frames once it drained (adaptive)')
+    parser.add_argument('--duplicates', choices=['send', 'reference', 'drop'],
+                        help='Let the OpenMote send MAC retries (frames with the same contents as a frame shortly before) as a short '
+                             'reference to that frame: write a copy of it for every retry (reference) or only write unique frames (drop). '
+                             'By default every frame is send in full (send)')
+    parser.add_argument('--compress-headers', action='store_true',
+                        help='Let the OpenMote send the MAC header of each frame as the bytes in which it differs from a recent header, '
+                             'which leaves more of the serial link for the frames on a busy channel')
+    parser.add_argument('--descriptors', action='store_true',
+                        help='Let the OpenMote parse the frame control field of every frame and send the frame type, address modes '
+                             'and header length with it, for scripts that route or filter the frames without parsing them')
+    parser.add_argument('--trigger',
+                        help='Let the OpenMote hold back the frames until one matches this rule and only capture a window of frames '
+                             'around it. Format: comma separated list of type=beacon|data|ack|cmd, dst=ADDR or src=ADDR and '
+                             'bytes=OFFSET:HEX (up to ' + str(TRIGGER_MAX_PATTERN_LEN) + ' bytes at this offset in the frame)')
+    parser.add_argument('--pre-trigger', type=int, default=100,
+                        help='Amount of frames before the trigger that are kept, as far as they fit in half the buffer (default: 100)')
+    parser.add_argument('--post-trigger', type=int, default=100,
+                        help='Amount of frames after the trigger that are captured (default: 100)')
+    parser.add_argument('--framing', choices=sorted(FRAMINGS.keys()),
+                        help='Let the OpenMote frame the records with COBS, which adds at most one byte per 254 instead of escaping the '
+                             'flag and escape bytes (up to twice the length for encrypted payloads). By default HDLC is used (hdlc)')
+    parser.add_argument('--hop', dest='hop_channels',
+                        help='Hop between these channels instead of listening on a single one and write a pcapng with an interface per channel. '
+                             'Format: comma separated list of channels or ranges, e.g. 11-26 or 15,20,25')
+    parser.add_argument('--dwell', type=int, default=100,
+                        help='Time in milliseconds to listen on each channel when hopping (default: 100)')
+    parser.add_argument('--adaptive-dwell', type=int, metavar='MILLISECONDS',
+                        help='Let the OpenMote divide the time of a cycle through the channels when hopping by their frames per second '
+                             'and energy, instead of staying the same time on each of them. Every channel is still visited once per '
+                             'cycle for at least this amount of milliseconds, so that new activity is found')
+    parser.add_argument('--tsch', nargs='?', const='beacon', metavar='CHANNEL_OFFSET',
+                        help='Follow the channel hopping of a TSCH network: wait for an enhanced beacon on the channel and then tune to '
+                             'the channel of every timeslot. Only the cells with one channel offset are captured, by default the one '
+                             'of the beacon (the minimal cell)')
+    parser.add_argument('--tsch-pan',
+                        help='Only follow the TSCH network with this PAN ID, by default the first network that is heard')
+    parser.add_argument('--tsch-sequence',
+                        help='Hopping sequence of the TSCH network, for beacons that only give its ID. Format: comma separated list '
+                             'of channels. By default the sequence from the beacon or the default one of IEEE 802.15.4 is used')
+    parser.add_argument('--superframe', nargs='?', const='any', metavar='PAN',
+                        help='Only listen during the active portion of the superframes of a beacon-enabled PAN, which saves energy when '
+                             'they have an inactive period. The radio waits for a beacon and then follows the superframes of its '
+                             'coordinator, by default of the first PAN that is heard')
+    parser.add_argument('--superframe-guard', type=int, default=DEFAULT_SUPERFRAME_GUARD_TIME, metavar='MICROSECONDS',
+                        help='Time that the radio is turned on before a beacon is due and left on after the active portion '
+                             '(default: ' + str(DEFAULT_SUPERFRAME_GUARD_TIME) + ')')
+    parser.add_argument('--inject', metavar='FILE',
+                        help='Let the OpenMote transmit the frames of this pcap or pcapng file on the channel while it keeps capturing, '
+                             'with the same time between the frames as in the file. The OpenMote adds the FCS')
+    parser.add_argument('--inject-back-to-back', action='store_true',
+                        help='Transmit the injected frames right after each other instead of keeping the time between them')
+    parser.add_argument('--inject-timeline', action='store_true',
+                        help='Keep the injected frames on the timeline of the file: a frame that had to wait for the channel or for '
+                             'a frame that was being received doesn\'t delay the frames behind it, which then catch up')
+    parser.add_argument('--inject-repeat', type=int, default=1, metavar='COUNT',
+                        help='Transmit the frames of the file this many times after each other (default: 1)')
+    parser.add_argument('--inject-cca', action='store_true',
+                        help='Only transmit an injected frame when the channel is clear, frames are not transmitted when it is busy')
+    parser.add_argument('--telemetry', type=int, default=0, metavar='SECONDS',
+                        help='Read the temperature, humidity, light and acceleration sensors of the OpenMote every SECONDS seconds '
+                             'and store the readings between the frames, as custom blocks in a pcapng file or printed otherwise')
+    parser.add_argument('--pps', action='store_true',
+                        help='Take the time from a GPS receiver or NTP clock that gives a pulse every second on PA6 of the OpenMote, '
+                             'the timestamps are then absolute instead of relative to when the pc received the first frame')
+    parser.add_argument('--dejitter', action='store_true',
+                        help='Fit the clock of the OpenMote to that of the pc over all records instead of only the first one, '
+                             'so the timestamps no longer follow the delays of the USB transfers')
+    parser.add_argument('--survey', action='store_true',
+                        help='Measure the energy on channels 11-26 instead of capturing frames and print how busy each channel is')
+    parser.add_argument('--sample-interval', type=int, default=2,
+                        help='Time in milliseconds between RSSI samples when surveying, each sample is taken on the next channel (default: 2)')
+    parser.add_argument('--summary', type=float,
+                        help='Let the OpenMote count the frames per link instead of capturing them and print a summary every SUMMARY '
+                             'seconds, followed by a table of all links and a histogram of the frame rate when stopping')
+    parser.add_argument('--stats', type=float, default=0,
+                        help='Print statistics of the OpenMote (drops, FIFO flushes, retransmissions, ...) every STATS seconds')
+    parser.add_argument('--rtos-trace', metavar='FILE',
+                        help='Let a firmware build with TRACE=TRUE record when the serial task runs and when the radio and UART '
+                             'interrupts interrupt it, and write the events to FILE for rtos-trace.py')
+    parser.add_argument('--fec', type=int, default=0, metavar='PACKETS',
+                        help='Let the OpenMote send the XOR of every PACKETS packets (at most %d), so that a single damaged or missing '
+                             'packet of the group is rebuilt instead of send again' % FEC_MAX_GROUP_SIZE)
+    parser.add_argument('--pcapng', action='store_true',
+                        help='Write a pcapng file that stores the channel, RSSI and LQI of every frame next to its FCS (IEEE 802.15.4 TAP)')
+    parser.add_argument('--stats-pcapng', action='store_true',
+                        help='Write a pcapng file and store the statistics in it as custom blocks')
+    parser.add_argument('--arrow', metavar='FILE',
+                        help='Also write the frames to this file as an Arrow IPC stream, with columns for the timestamp, channel, RSSI, LQI, '
+                             'FCS, frame type, PANs and addresses next to the bytes of the frame, for analytics tools')
+    parser.add_argument('--arrow-batch', type=int, default=64,
+                        help='Thousands of frames per record batch of the Arrow stream (default: 64)')
+    parser.add_argument('--ipv6', metavar='FILE',
+                        help='Also write the IPv6 packets of the 6LoWPAN frames to this pcapng file, with the fragments reassembled and '
+                             'the headers decompressed by the native library in src/host')
+    parser.add_argument('--ipv6-context', action='append', default=[], metavar='ID=PREFIX/LENGTH',
+                        help='Prefix of a context of stateful 6LoWPAN address compression, e.g. 0=2001:db8::/64 (can be repeated)')
+    parser.add_argument('--ipv6-datagrams', type=int, default=LOWPAN_DATAGRAMS,
+                        help='Fragmented datagrams that are reassembled at the same time, the oldest is dropped when a new one needs '
+                             'room (default: %d)' % LOWPAN_DATAGRAMS)
+    parser.add_argument('--ipv6-timeout', type=float, default=LOWPAN_TIMEOUT, metavar='SECONDS',
+                        help='Drop a datagram of which a fragment is still missing after this time (default: %d)' % LOWPAN_TIMEOUT)
+    parser.add_argument('--shared-ring', metavar='FILE',
+                        help='Also publish the frames in this memory-mapped ring file, which any number of local programs can follow at '
+                             'the same time (see follow-ring.py), e.g. in /dev/shm on Linux')
+    parser.add_argument('--shared-ring-size', type=int, default=16,
+                        help='Size of the shared ring in MB, readers that fall further behind lose the oldest frames (default: 16)')
+    parser.add_argument('--flight-recorder', type=float, metavar='MINUTES',
+                        help='Only keep the frames of the last minutes in memory and write them to a pcapng (named after -o with the time '
+                             'behind it) when SIGUSR1 is received, /trigger is requested on the --metrics address or a frame matches '
+                             '--flight-recorder-match. Nothing else is written to disk')
+    parser.add_argument('--flight-recorder-size', type=int, default=FLIGHT_RECORDER_SIZE, metavar='MB',
+                        help='Memory that the flight recorder uses, the oldest frames go first when the minutes don\'t fit (default: %d)'
+                             % FLIGHT_RECORDER_SIZE)
+    parser.add_argument('--flight-recorder-after', type=float, default=FLIGHT_RECORDER_AFTER, metavar='SECONDS',
+                        help='Seconds of frames after the trigger that are also written (default: %d)' % FLIGHT_RECORDER_AFTER)
+    parser.add_argument('--flight-recorder-match', metavar='EXPRESSION',
+                        help='Trigger the flight recorder on a frame that matches this expression, in the form of --filter-program')
+    parser.add_argument('--remote', metavar='HOST[:PORT]',
+                        help='Also stream the frames over TCP to collector.py on this host (port %d by default), which resumes after a '
+                             'lost connection without missing frames. Without -o nothing is written locally.' % REMOTE_PORT)
+    parser.add_argument('--site', default=None,
+                        help='Name under which the collector stores the frames of this sniffer (default: the name of this computer)')
+    parser.add_argument('--remote-compress', action='store_true',
+                        help='Compress the frames that are streamed to the collector with zlib, for a slow link')
+    parser.add_argument('--metrics', metavar='[HOST:]PORT',
+                        help='Serve counters of the capture and the statistics of the OpenMote for Prometheus on http://HOST:PORT/metrics, '
+                             'on all interfaces when only a port is given')
+    parser.add_argument('--node-stats', type=float, nargs='?', const=NODE_STATS_WINDOW, metavar='SECONDS',
+                        help='Print the busiest source addresses every SECONDS (%d by default) with their frames and bytes per second, '
+                             'average RSSI, retry ratio and when they were last seen. The metrics endpoint always shows them.'
+                             % NODE_STATS_WINDOW)
+    parser.add_argument('--integrity-key',
+                        help='Let the OpenMote keep a SHA-256 chain over the frames and authenticate checkpoints of it with this HMAC key '
+                             '(32 bytes in hex), the checkpoints are verified while capturing')
+    parser.add_argument('--encrypt-key',
+                        help='Let the OpenMote encrypt the frames with AES under this key (16 bytes in hex) and write them to the output '
+                             'file without decrypting them, decrypt-capture.py turns the file into a pcap with the key')
+    parser.add_argument('--checkpoint-interval', type=int, default=DEFAULT_CHECKPOINT_INTERVAL,
+                        help='Amount of frames between the integrity checkpoints (default: ' + str(DEFAULT_CHECKPOINT_INTERVAL) + ')')
+    parser.add_argument('--flash-log', action='store_true',
+                        help='Let the OpenMote store the frames in its flash when this program stops acknowledging them, e.g. when the pc is disconnected')
+    parser.add_argument('--dump-flash-log', action='store_true',
+                        help='Write the frames that are stored in the flash of the OpenMote to the output file instead of sniffing')
+    parser.add_argument('--erase-flash-log', action='store_true',
+                        help='Erase the frames that are stored in the flash of the OpenMote (after dumping them when combined with --dump-flash-log)')
+    parser.add_argument('--autostart', action='store_true',
+                        help='Let the OpenMote store the configuration of this capture in its flash and start capturing with it right after '
+                             'booting, without waiting for this program (together with --flash-log the frames are kept until it attaches)')
+    parser.add_argument('--clear-autostart', action='store_true',
+                        help='Remove the configuration stored with --autostart, the OpenMote waits for this program again after booting')
+    parser.add_argument('--attach', action='store_true',
+                        help='Continue the capture that the OpenMote started by itself after booting (see --autostart) instead of resetting it, '
+                             'a new capture is started when there is none')
+    parser.add_argument('--hardware-crc', action='store_true',
+                        help='Use the serial CRC of the CC2538 CRC engine, required when the firmware was build with SERIAL_HARDWARE_CRC')
+    parser.add_argument('--baudrate',
+                        help='Switch to a faster baudrate after connecting, either a number or "max" to try the fastest ones that the OpenMote supports')
+    parser.add_argument('--low-latency', action='store_true',
+                        help='Shorten the delay of the ACKs: set the low latency flag and FTDI latency timer of the serial port '
+                             'and a real-time priority for the sniffer thread (Linux), and measure the round-trip time')
+    parser.add_argument('--hotplug', action='store_true',
+                        help='Wait for the OpenMote without a timeout when its serial port disappears and find it by its EUI '
+                             'on any serial port that appears, to continue the capture where it stopped')
+    parser.add_argument('--ethernet', dest='ethernet_interface',
+                        help='Network interface to which the OpenMote is connected, when the firmware was build with SNIFFER_ETHERNET (Linux only)')
+    parser.add_argument('--spi', dest='spi_device',
+                        help='SPI device (e.g. /dev/spidev0.0) to which the OpenMote is connected as slave, when the firmware was '
+                             'build with SNIFFER_SPI_SLAVE (Linux only, requires the spidev module)')
+    parser.add_argument('--spi-ready-gpio', type=int,
+                        help='Number of the sysfs GPIO that is connected to the data ready pin of the OpenMote with --spi, '
+                             'without it the bursts are clocked continuously')
+    parser.add_argument('--bond-port',
+                        help='Serial port that receives the second lane of an OpenMote build with SNIFFER_UART_BONDING, which '
+                             'carries part of the records to reach almost twice the throughput')
+    parser.add_argument('--zep', dest='zep_destination',
+                        help='Let the OpenMote send the frames as ZEP packets over UDP to "IP[:PORT]" and exit, requires --ethernet')
+    parser.add_argument('--zep-source',
+                        help='IP address that the OpenMote uses as source of the ZEP packets, required with --zep')
+    parser.add_argument('--rotate-size', type=float, default=0,
+                        help='Start a new numbered output file each time the file reaches this size in MB (requires -o)')
+    parser.add_argument('--rotate-time', type=float, default=0,
+                        help='Start a new numbered output file after this many seconds (requires -o)')
+    parser.add_argument('--max-files', type=int, default=0,
+                        help='Remove the oldest numbered output file when there would be more files than this')
+    parser.add_argument('--block-writes', type=int, nargs='?', const=BLOCK_WRITE_SIZE, metavar='KB',
+                        help='Write the output file in large aligned blocks (default: %d KB) from a second buffer, reserve its space '
+                             'ahead and sync it every %d seconds, for SD cards and flash' % (BLOCK_WRITE_SIZE, BLOCK_WRITE_SYNC_INTERVAL))
+    parser.add_argument('--compress', choices=['gzip', 'zstd', 'lz4'],
+                        help='Compress the output file in frames that can be decompressed on their own, with an index of '
+                             'them next to the file (zstd requires the zstandard module, lz4 the lz4 module)')
+    parser.add_argument('--record-stream',
+                        help='Write the bytes that the sniffer thread reads from the serial port to this file, with their arrival times, for replay-stream.py')
+    parser.add_argument('--python-receiver', action='store_true',
+                        help='Process the received bytes in python even when the native library in src/host was build')
+    parser.add_argument('--extcap-interfaces', action='store_true', help='List the interfaces for Wireshark (extcap)')
+    parser.add_argument('--extcap-interface', help='Interface chosen in Wireshark (extcap)')
+    parser.add_argument('--extcap-dlts', action='store_true', help='List the link types for Wireshark (extcap)')
+    parser.add_argument('--extcap-config', action='store_true', help='List the settings for Wireshark (extcap)')
+    parser.add_argument('--extcap-version', help='Version of Wireshark (extcap)')
+    parser.add_argument('--extcap-capture-filter', help='Not supported, the --filter option filters on the OpenMote instead')
+    parser.add_argument('--extcap-control-in', help='Pipe on which Wireshark sends the channel selected in its toolbar (extcap)')
+    parser.add_argument('--extcap-control-out', help='Pipe on which the sniffer sends messages to Wireshark (extcap)')
+    parser.add_argument('--capture', action='store_true', help='Start capturing for Wireshark (extcap)')
+    parser.add_argument('--fifo', help='Pipe created by Wireshark to which the frames are written (extcap)')
+    parser.add_argument('--enable-warnings', action='store_true', help='Enable some warnings that are only useful for debugging')
+    return parser.parse_args()
+
+
+def main():
+    global ser
+    global output
+    global outputIsFile
+    global outputPipe
+    global stopSniffingThread
+    global snifferThreadTerminated
+    global enableWarnings
+    global requestedWindow
+    global requestedAckInterval
+    global ackDelay
+    global ackMode
+    global batching
+    global batchThreshold
+    global batchHoldTime
+    global snapLength
+    global overflowPolicy
+    global duplicates
+    global compressHeaders
+    global moteFcsFilter
+    global frameDescriptors
+    global filterProgram
+    global triggerRule
+    global triggerPostFrames
+    global framing
+    global hopSchedule
+    global adaptiveMinDwellTime
+    global tschRequest
+    global superframeRequest
+    global injector
+    global rtosTrace
+    global fecGroupSize
+    global surveySampleInterval
+    global summaryInterval
+    global statsInterval
+    global telemetryInterval
+    global ppsInput
+    global dejitter
+    global pcapngOutput
+    global flashLog
+    global saveAutostart
+    global hardwareCRC
+    global lowLatency
+    global hotplug
+    global serialDevice
+    global roundTripProbe
+    global linkMonitor
+    global flightRecorder
+    global outputPause
+    global integrityKey
+    global checkpointInterval
+    global encryptionKey
+    global encryptionNonce
+    global requestedBaudrates
+    global hostLibrary
+    global outputWriter
+    global liveView
+    global outputSinks
+    global metrics
+    global nodeStatistics
+    global writeLatency
+    global statsPrinted
+    global extcapControl
+    global aggregateMotes
+    global fleetChannels
+    global bondPort
+    global syncClock
+
+    args = parseArguments()
+
+    # The capture is written to stdout instead of a file, so all messages have to go elsewhere
+    standardOutput = None
+    if args.pcap_file == '-':
+        standardOutput = os.fdopen(sys.stdout.fileno(), 'wb', 0)
+        sys.stdout = sys.stderr
+
+    # Wireshark first asks which interfaces, link types and settings there are before it starts the capture
+    if args.extcap_interfaces:
+        extcapListInterfaces()
+        return
+    if args.extcap_dlts:
+        extcapListDlts()
+        return
+    if args.extcap_config:
+        extcapListConfig()
+        return
+
+    # Wireshark only shows what is written to stderr, and stops the capture by terminating the process
+    extcap = args.capture
+    if extcap:
+        if args.fifo == None:
+            print('Wireshark did not pass the --fifo argument')
+            return
+        sys.stdout = sys.stderr
+        signal.signal(signal.SIGTERM, lambda signum, frame: sys.exit(0))
+        if args.channel == None:
+            args.channel = 11
+        if args.port == None and args.ethernet_interface == None and args.spi_device == None:
+            ports = getSerialPortList()
+            if len(ports) != 1:
+                print('Select the serial port of the OpenMote in the interface options')
+                return
+            args.port = ports[0]
+
+    enableWarnings = args.enable_warnings
+
+    if args.window < 0 or args.window > 0xffff:
+        print('Window size should be between 0 and 65535')
+        return
+
+    if args.ack_interval < 1 or args.ack_interval >= ACK_INTERVAL_ON_REQUEST:
+        print('ACK interval should be between 1 and ' + str(ACK_INTERVAL_ON_REQUEST - 1))
+        return
+
+    requestedWindow = args.window
+    requestedAckInterval = args.ack_interval
+
+    if args.ack_delay <= 0 or args.ack_delay >= SERIAL_TIMEOUT * 1000:
+        print('ACK delay should be more than 0 and less than ' + str(int(SERIAL_TIMEOUT * 1000)) + ' ms')
+        return
+
+    ackDelay = args.ack_delay / 1000.0
+    ackMode = args.acks
+
+    if args.batch_threshold < 1 or args.batch_threshold > BATCH_MAX_THRESHOLD:
+        print('Batch threshold should be between 1 and ' + str(BATCH_MAX_THRESHOLD) + ' bytes')
+        return
+    if args.batch_hold_time < 1 or args.batch_hold_time > BATCH_MAX_HOLD_TIME:
+        print('Batch hold time should be between 1 and ' + str(BATCH_MAX_HOLD_TIME) + ' ms')
+        return
+
+    if args.batching != None:
+        batching = args.batching
+    batchThreshold = args.batch_threshold
+    batchHoldTime = args.batch_hold_time
+
+    if args.snaplen < 0 or args.snaplen > 125:
+        print('Snap length should be between 0 and 125')
+        return
+
+    snapLength = args.snaplen
+    if args.overflow != None:
+        overflowPolicy = OVERFLOW_POLICIES[args.overflow]
+    if args.duplicates != None:
+        duplicates = args.duplicates
+    compressHeaders = args.compress_headers
+    moteFcsFilter = args.mote_fcs_filter
+    if moteFcsFilter and args.keep_bad_fcs:
+        print('--mote-fcs-filter can not be combined with --keep-bad-fcs')
+        return
+    frameDescriptors = args.descriptors
+    if args.framing != None:
+        framing = args.framing
+
+    if len(args.filter) > FILTER_MAX_RULES:
+        print('At most ' + str(FILTER_MAX_RULES) + ' filter rules are supported')
+        return
+
+    try:
+        for rule in args.filter:
+            filterRules.append(parseFilterRule(rule))
+    except (ValueError, KeyError) as e:
+        print('Invalid filter rule: ' + str(e))
+        return
+
+    if args.filter_program != None:
+        try:
+            filterProgram = compileFilterProgram(args.filter_program)
+        except ValueError as e:
+            print('Invalid filter program: ' + str(e))
+            return
+
+    if args.trigger != None:
+        if args.pre_trigger < 0 or args.pre_trigger > 0xffff or args.post_trigger < 0 or args.post_trigger > 0xffff:
+            print('The amount of frames before and after the trigger should be between 0 and 65535')
+            return
+
+        if args.survey or args.flash_log:
+            print('A trigger can not be combined with a survey or the flash log')
+            return
+
+        # The discarded records would leave gaps in the hash chain and in the records that later ones refer to
+        if args.duplicates == 'reference' or args.compress_headers or args.integrity_key != None:
+            print('A trigger can not be combined with --duplicates reference, compressed headers or an integrity key')
+            return
+
+        try:
+            triggerRule = parseTriggerRule(args.trigger, args.pre_trigger, args.post_trigger)
+        except (ValueError, KeyError) as e:
+            print('Invalid trigger: ' + str(e))
+            return
+        triggerPostFrames = args.post_trigger
+
+    if len(args.key) > DECRYPTION_MAX_KEYS:
+        print('At most ' + str(DECRYPTION_MAX_KEYS) + ' keys are supported')
+        return
+
+    try:
+        for key in args.key:
+            decryptionKeys.append(parseDecryptionKey(key))
+    except ValueError as e:
+        print('Invalid key: ' + str(e))
+        return
+
+    statsInterval = int(args.stats * 1000)
+    if statsInterval < 0 or statsInterval > 0xffff:
+        print('Statistics interval should be between 0 and 65 seconds')
+        return
+    if args.stats_pcapng and statsInterval == 0:
+        statsInterval = 1000
+
+    # The metrics include the statistics of the OpenMote, which are then not printed unless they were asked for
+    if args.metrics != None:
+        if args.aggregate_motes != None or args.fleet != None:
+            print('The metrics endpoint can not be combined with several OpenMotes')
+            return
+        if statsInterval == 0:
+            statsInterval = 1000
+            statsPrinted = False
+
+        metrics = Metrics()
+        try:
+            startMetricsServer(args.metrics)
+        except (ValueError, OverflowError, socket.error) as e:
+            print('Could not serve the metrics on ' + args.metrics + ': ' + str(e))
+            return
+
+    if args.baudrate == 'max':
+        requestedBaudrates = BAUDRATE_CANDIDATES
+    elif args.baudrate != None:
+        try:
+            requestedBaudrates = [int(args.baudrate)]
+        except ValueError:
+            print('Baudrate should be a number or "max"')
+            return
+
+    if args.dump_flash_log and args.pcap_file == None:
+        print('An output file is required to dump the flash log')
+        return
+
+    # Neither a survey nor a summary of the traffic writes frames to an output, their results are printed instead
+    summarizing = args.summary != None
+    printOnly = args.survey or summarizing
+
+    rotating = (args.rotate_size > 0 or args.rotate_time > 0)
+    if args.rotate_size < 0 or args.rotate_time < 0 or args.max_files < 0:
+        print('Rotation size, rotation time and maximum amount of files can not be negative')
+        return
+    if extcap and (printOnly or args.pcap_file != None or args.dump_flash_log or args.erase_flash_log or args.zep_destination != None):
+        print('A capture from Wireshark can not be combined with a survey, a summary, an output file, the flash log or ZEP')
+        return
+    if (rotating or args.max_files > 0) and (args.pcap_file == None or args.pcap_file == '-' or printOnly):
+        print('Rotating the output requires an output file')
+        return
+    if args.max_files > 0 and not rotating:
+        print('A maximum amount of files requires --rotate-size or --rotate-time')
+        return
+    if args.compress != None and (args.pcap_file == None or args.pcap_file == '-' or printOnly):
+        print('Compressing the output requires an output file')
+        return
+    if args.block_writes != None and (args.pcap_file == None or args.pcap_file == '-' or printOnly):
+        print('Block writes require an output file')
+        return
+    if args.block_writes != None and (args.block_writes < 4 or args.block_writes % 4 != 0):
+        print('The size of the block writes should be a multiple of 4 KB')
+        return
+    if args.compress != None:
+        try:
+            loadCompressor(args.compress)
+        except ImportError:
+            module = 'zstandard' if args.compress == 'zstd' else 'lz4'
+            print('ERROR: ' + args.compress + ' compression requires the ' + module + ' module (pip install ' + module + ')')
+            return
+    if args.live_view and (args.pcap_file == None or args.pcap_file == '-' or printOnly or extcap):
+        print('A live view requires an output file, it can not be combined with a survey, a summary or a capture from Wireshark')
+        return
+    if args.live_rate < 0 or args.live_sample < 1:
+        print('The rate of the live view can not be negative and it should show at least every so many frames')
+        return
 
-            # Remember the index and sequence number of this packet in case the next one is corrupted
-            self.lastIndex = (msg[INDEX_OFFSET] << 8) + msg[INDEX_OFFSET+1]
-            self.lastSeqNr = (msg[SEQ_NR_OFFSET] << 8) + msg[SEQ_NR_OFFSET+1]
+    aggregating = args.aggregate_motes != None or args.fleet != None
+    if aggregating:
+        try:
+            if args.fleet == None:
+                aggregateMotes = parseAggregateMotes(args.aggregate_motes)
+            elif args.aggregate_motes == None:
+                fleetChannels = [channel for channel, dwellTime in parseHopSchedule(args.fleet, args.dwell)]
+            else:
+                raise ValueError('--aggregate and --fleet can not be combined')
+        except ValueError as e:
+            print(('Invalid channels of the fleet: ' if args.fleet != None else 'Invalid list of OpenMotes: ') + str(e))
+            return
+        if (printOnly or extcap or args.hop_channels != None or args.dump_flash_log or args.erase_flash_log or args.flash_log
+                or args.zep_destination != None or args.ethernet_interface != None or args.integrity_key != None):
+            print('Merging several OpenMotes can not be combined with a survey, a summary, hopping, the flash log, ZEP, Ethernet or checkpoints')
+            return
+    if args.record_stream != None and (aggregating or args.dump_flash_log or args.zep_destination != None):
+        print('Recording the serial stream can not be combined with --aggregate, dumping the flash log or ZEP')
+        return
+    if args.bond_port != None and (aggregating or args.ethernet_interface != None or args.spi_device != None):
+        print('A second lane can not be combined with --aggregate, Ethernet or SPI')
+        return
+    if args.spi_device != None and (aggregating or args.ethernet_interface != None):
+        print('SPI can not be combined with --aggregate or Ethernet')
+        return
+    if args.hotplug and (args.bond_port != None or args.ethernet_interface != None or args.spi_device != None):
+        print('The --hotplug option can not be combined with a second lane, Ethernet or SPI')
+        return
+    if args.fec < 0 or args.fec > FEC_MAX_GROUP_SIZE:
+        print('The FEC group should be between 1 and ' + str(FEC_MAX_GROUP_SIZE) + ' packets')
+        return
+    if args.fec > 0 and (aggregating or args.bond_port != None or args.ethernet_interface != None or args.spi_device != None):
+        print('The --fec option can not be combined with --aggregate, a second lane, Ethernet or SPI')
+        return
+    dejitter = args.dejitter
+    if dejitter and (aggregating or args.bond_port != None or args.ethernet_interface != None or args.spi_device != None):
+        print('The --dejitter option can only be used with a single serial port, not with --aggregate, a second lane, Ethernet or SPI')
+        return
+    if args.fleet_exclude != None and args.fleet == None:
+        print('--fleet-exclude only works together with --fleet')
+        return
+    if args.merge_duplicates != 0 and (not aggregating or args.merge_duplicates < 0 or args.merge_duplicates > AGGREGATE_MERGE_DELAY * 1000000):
+        print('Merging duplicates requires --aggregate and a window of at most ' + str(int(AGGREGATE_MERGE_DELAY * 1000000)) + ' microseconds')
+        return
+    if args.sync_beacon != None and (not aggregating or args.sync_interval < 5 or args.sync_interval > 60000):
+        print('A sync beacon requires --aggregate and an interval between 5 and 60000 milliseconds')
+        return
 
-            # Discard packets with a bad CRC when requested
-            if not self.discardPacketsWithBadCRC or msg[-1] & 128 != 0:
+    if args.sync_reference != None:
+        try:
+            hostReference, beaconReference = args.sync_reference.split(':')
+            syncClock = SyncClock(int(hostReference), int(beaconReference))
+        except ValueError:
+            print('The sync reference should be HOST:BEACON')
+            return
 
-                # Recalculate the CRC unless the alternative FCS was requested or the CRC was invalid
-                if not self.replaceFCS and msg[-1] & 128 != 0:
-                    crc = calcRadioCRC(msg[DATA_OFFSET:-2])
-                    msg[-2] = crc & 0xff
-                    msg[-1] = (crc >> 8) & 0xff
+    flashLog = args.flash_log
+    saveAutostart = args.autostart
+    hardwareCRC = args.hardware_crc
+    lowLatency = args.low_latency
+    hotplug = args.hotplug
 
-                # Write Record Header and the packet to output
-                outputPacket(msg[DATA_OFFSET:])
+    # The native library doesn't rebuild the packets and doesn't know when each message arrived, those are handled in python
+    fecGroupSize = args.fec
+    if not args.python_receiver and fecGroupSize == 0 and not dejitter and args.encrypt_key == None:
+        hostLibrary = loadHostLibrary()
+        if hostLibrary != None and enableWarnings:
+            print('Processing the received bytes with the native library in ' + HOST_LIBRARY_DIR)
 
-            # Send an ACK after enough bytes have been received
-            self.unackedByteCount += len(msg)
-            self.serialWriteAck()
+    if args.integrity_key != None:
+        try:
+            integrityKey = bytes(bytearray.fromhex(args.integrity_key.replace(':', '')))
+        except ValueError:
+            integrityKey = b''
+        if len(integrityKey) != INTEGRITY_KEY_LEN:
+            print('The integrity key should be ' + str(INTEGRITY_KEY_LEN) + ' bytes in hex')
+            return
+        if args.checkpoint_interval < 1 or args.checkpoint_interval > 0xffff:
+            print('Checkpoint interval should be between 1 and 65535 frames')
+            return
+        if printOnly or flashLog or args.dump_flash_log:
+            print('The integrity checkpoints can not be combined with a survey, a summary or the flash log')
+            return
 
-        else:
-            # If the sequence number is higher than expected then tell the sniffer that we are missing something
-            if receivedSeqNr > self.expectedSeqNr:
-                serialWriteNack(self.lastIndex, self.lastSeqNr)
-            else:
-                # The OpenMote is retransmitting stuff that we already have, so send an ACK to inform it about this
-                if self.retransmission:
-                    # If we already noticed it then only send an ACK every few packets
-                    self.unackedByteCount += len(msg)
-                    self.serialWriteAck()
-                else:
-                    # If this is the first retransmitted packet then immediately send an ACK
-                    self.retransmission = True
-                    self.unackedByteCount = ACK_THRESHOLD
-                    self.serialWriteAck()
+        checkpointInterval = args.checkpoint_interval
 
-        return True
+    if args.encrypt_key != None:
+        try:
+            encryptionKey = bytes(bytearray.fromhex(args.encrypt_key.replace(':', '')))
+        except ValueError:
+            encryptionKey = b''
+        if len(encryptionKey) != ENCRYPTION_KEY_LEN:
+            print('The encryption key should be ' + str(ENCRYPTION_KEY_LEN) + ' bytes in hex')
+            return
+        if (printOnly or flashLog or args.dump_flash_log or args.erase_flash_log or aggregating or args.attach or args.autostart
+                or args.zep_destination != None or integrityKey != None or fecGroupSize > 0 or args.trigger != None):
+            print('Encrypting the frames can not be combined with a survey, a summary, the flash log, merging several OpenMotes, '
+                  'attaching, autostart, ZEP, checkpoints, FEC or a trigger')
+            return
+        if (args.pcap_file == None or rotating or args.compress != None or args.live_view or args.remote != None
+                or args.flight_recorder != None or args.arrow != None or args.ipv6 != None or args.shared_ring != None):
+            print('The encrypted frames can only be written to a single uncompressed output file, not to Wireshark or other outputs')
+            return
+        if len(args.key) > ENCRYPTION_KEY_AREA:
+            print('At most ' + str(ENCRYPTION_KEY_AREA) + ' decryption keys can be combined with --encrypt-key, the encryption key '
+                  'takes the last area of the key store')
+            return
 
+        encryptionNonce = os.urandom(ENCRYPTION_NONCE_LEN)
 
-def connectToOpenMote(channel, quiet = False):
-    ser.flushInput()
-    ser.flushOutput()
+    # The metrics include the statistics per node, which are then not printed unless they were asked for
+    if args.node_stats != None:
+        if printOnly or aggregating or encryptionKey != None:
+            print('The statistics per node can not be combined with a survey, a summary, several OpenMotes or encrypted frames')
+            return
+        if args.node_stats < 1 or args.node_stats > 3600:
+            print('The window of the statistics per node should be between 1 and 3600 seconds')
+            return
+        nodeStatistics = NodeStatistics(args.node_stats)
+        NodeStatisticsView(nodeStatistics)
+    elif metrics != None and not printOnly and encryptionKey == None:
+        nodeStatistics = NodeStatistics(NODE_STATS_WINDOW)
+
+    if args.survey:
+        if args.hop_channels != None:
+            print('Channel hopping can not be combined with a survey')
+            return
 
-    try:
-        # Keep sending RESET packet and discard all bytes until the READY packet arrives
-        receiving = False
-        for i in range(3):
-            if not quiet:
-                print('Connecting to OpenMote...')
-
-            serialWrite(SerialDataType.Reset, [channel])
-            begin = time.time()
-            while time.time() - begin < 1:
-                c = ser.read(1)
-                if len(c) > 0:
-                    c = bytearray(c)[0]  # c is always a single byte, but it was returned as an array
-                    if not receiving:
-                        if c == HDLC_FLAG:
-                            receiving = True
-                            msg = bytearray()
-                    else:
-                        if c == HDLC_FLAG:
-                            if len(msg) != 0:
-                                receiving = False
-                                msg = decode(msg, quiet=True)
-                                if len(msg) > 0 and msg[0] == SerialDataType.Ready:
-                                    if not quiet:
-                                        print('Connected to OpenMote')
-                                    return True
-                        else:
-                            msg.append(c)
+        surveySampleInterval = (args.sample_interval * 1000 + HOP_TIME_UNIT // 2) // HOP_TIME_UNIT
+        if surveySampleInterval < 2 or surveySampleInterval > 0xffff:
+            print('Sample interval should be between 2 and 67000 milliseconds')
+            return
 
-    except serial.serialutil.SerialException as e:
-        print('ERROR: Serial error. PySerial error: ' + str(e))
+        # The channel in the RESET message is not used, but it is still needed to test the connection
+        args.channel = 11
 
-    print('ERROR: Failed to connect to OpenMote')
-    return False
+    if summarizing:
+        if args.survey or args.hop_channels != None or flashLog or args.dump_flash_log or args.erase_flash_log or args.trigger != None:
+            print('A summary of the traffic can not be combined with a survey, channel hopping, the flash log or a trigger')
+            return
 
+        summaryInterval = int(round(args.summary * 1000))
+        if summaryInterval < 1 or summaryInterval > SUMMARY_MAX_INTERVAL:
+            print('Summary interval should be between 0.001 and ' + str(SUMMARY_MAX_INTERVAL // 1000) + ' seconds')
+            return
 
-def snifferThread(channel, discardPacketsWithBadCRC, replaceFCS):
-    global snifferThreadTerminated
+    if args.tsch != None:
+        if args.survey or args.hop_channels != None:
+            print('Following a TSCH network can not be combined with a survey or channel hopping')
+            return
 
-    msg = bytearray()
-    receiving = False
-    packetProcessor = PacketProcessor(discardPacketsWithBadCRC, replaceFCS)
+        try:
+            tschRequest = parseTschRequest(args.tsch, args.tsch_pan, args.tsch_sequence)
+        except ValueError as e:
+            print('Invalid TSCH options: ' + str(e))
+            return
 
-    try:
-        while not stopSniffingThread:
-            if ser.inWaiting() > 0:
-                receivedBytes = ser.read(ser.inWaiting())
-            else:
-                # The serial buffer is empty, wait for next byte
-                receivedBytes = bytearray()
-                while len(receivedBytes) == 0 and not stopSniffingThread:
-                    receivedBytes = ser.read(1)
-
-                    # Check if timeout was reached
-                    if len(receivedBytes) == 0:
-                        if receiving:
-                            receiving = False
-                            if enableWarnings:
-                                print('WARNING: expected another byte, assuming out of sync')
-                            serialWriteNack(packetProcessor.lastIndex, packetProcessor.lastSeqNr)
-                        else:
-                            # We haven't received any new packets for a moment, if there are still unacknowledged bytes, acknowledge them now
-                            packetProcessor.ackUnackedBytes()
-
-            for c in bytearray(receivedBytes):
-                if not receiving:
-                    receiving = True
-                    msg = bytearray()
+    if args.superframe != None:
+        if args.survey or args.hop_channels != None or args.tsch != None:
+            print('Following superframes can not be combined with a survey, channel hopping or a TSCH network')
+            return
 
-                    if c != HDLC_FLAG:
-                        if enableWarnings:
-                            print('WARNING: encountered unexpected byte, assuming out of sync')
-                        msg.append(c)
-                else:
-                    if c == HDLC_FLAG:
-                        if len(msg) == 0:
-                            if enableWarnings:
-                                print('WARNING: out of sync detected')
-                        else:
-                            receiving = False
-                            if not packetProcessor.processPacket(decode(msg)):
-                                # Something happened with the OpenMote, try to connect again
-                                if not connectToOpenMote(channel):
-                                    return  # Connection to OpenMote lost, terminate sniffer
-
-                                msg = bytearray()
-                                receiving = False
-                                packetProcessor.resetVariables()
-                                continue
-
-                    else: # Not the closing byte
-                        msg.append(c)
+        try:
+            superframeRequest = parseSuperframeRequest(args.superframe, args.superframe_guard)
+        except ValueError as e:
+            print('Invalid superframe options: ' + str(e))
+            return
 
-    except serial.serialutil.SerialException as e:
-        serialWriteStop()
-        snifferThreadTerminated = True
-        print('ERROR: Serial error, assuming OpenMote disconnected. PySerial error: ' + str(e))
+    injectFrames = None
+    if args.inject != None:
+        if args.survey or summarizing or args.hop_channels != None or args.tsch != None or args.superframe != None or aggregating \
+         or args.dump_flash_log or args.zep_destination != None:
+            print('Injecting frames can not be combined with a survey, a summary, channel hopping, a TSCH network, superframes, '
+                  'multiple OpenMotes, the flash log or ZEP output')
+            return
 
-    except IOError as e:
-        serialWriteStop()
-        snifferThreadTerminated = True
-        if e.errno == errno.EPIPE:
-            print('ERROR: Pipe to wireshark is broken')
-        else:
-            print('ERROR: Unknown error. IOError: ' + str(e))
+        if args.inject_timeline and args.inject_back_to_back:
+            print('The injected frames can either keep the timeline of the file or be transmitted back-to-back')
+            return
+        if args.inject_repeat < 1:
+            print('The frames have to be injected at least once')
+            return
 
-    except Exception as e:
-        serialWriteStop()
-        snifferThreadTerminated = True
-        print('ERROR: Unknown exception thrown, assuming wireshark stopped. Exception: ' + str(e))
+        try:
+            injectFrames = readInjectFrames(args.inject, args.inject_back_to_back)
+        except (IOError, OSError, ValueError, struct.error) as e:
+            print('Could not read the frames to inject from ' + args.inject + ': ' + str(e))
+            return
 
+    telemetryInterval = args.telemetry
+    if telemetryInterval < 0 or telemetryInterval > TELEMETRY_MAX_INTERVAL:
+        print('Telemetry interval should be between 0 and ' + str(TELEMETRY_MAX_INTERVAL) + ' seconds')
+        return
+    if telemetryInterval > 0 and (args.survey or summarizing or aggregating or args.zep_destination != None):
+        print('Telemetry can not be combined with a survey, a summary, multiple OpenMotes or ZEP output')
+        return
 
-def parseArguments():
-    parser = argparse.ArgumentParser(description='IEEE 802.15.4 Sniffer')
-    parser.add_argument('-c', '--channel', dest='channel', type=int,
-                        help='Channel on which the sniffer should start listening (11-26)')
-    parser.add_argument('-p', '--port', dest='port',
-                        help='Full name of serial port to use. On linux this is e.g. "/dev/ttyUSB0"')
-    parser.add_argument('-w', '--wireshark', dest='wireshark_executable', default='wireshark',
-                        help='Filename of the wireshark executable (if not just "wireshark" or capturing to file)')
-    parser.add_argument('-t', '--pipe', dest='pipe_name', default='fifopipe',
-                        help='Name of the temporary pipe to wireshark (when not capturing to file)')
-    parser.add_argument('-o', '--output', dest='pcap_file',
-                        help='Filename of .pcap file to output. The existence of this parameter decides whether real-time capturing with wireshark is used or whether the sniffer just outputs to a pcap file')
-    parser.add_argument('-f', '--force', action='store_true',
-                        help='Overwrite pcap file or pipe when it already exists')
-    parser.add_argument('--replace-fcs', action='store_true',
-                        help='Replace the normal radio FCS by the TI CC24XX FCS which contains the RSSI and LQI')
-    parser.add_argument('--keep-bad-fcs', action='store_true',
-                        help="Don't discard packets that have a bad checksum")
-    parser.add_argument('--enable-warnings', action='store_true', help='Enable some warnings that are only useful for debugging')
-    return parser.parse_args()
+    ppsInput = args.pps
+    if ppsInput and (args.survey or summarizing or aggregating or args.zep_destination != None or syncClock != None):
+        print('The --pps option can not be combined with a survey, a summary, multiple OpenMotes, ZEP output or a sync beacon')
+        return
+    if dejitter and (ppsInput or syncClock != None):
+        print('The --dejitter option can not be combined with --pps or a sync beacon, which give the timestamps a better clock')
+        return
 
+    if args.rtos_trace != None:
+        if args.survey or summarizing or aggregating:
+            print('The --rtos-trace option can not be combined with a survey, a summary or multiple OpenMotes')
+            return
+        try:
+            rtosTrace = RtosTraceWriter(args.rtos_trace)
+        except (IOError, OSError) as e:
+            print('Could not open ' + args.rtos_trace + ': ' + str(e))
+            return
 
-def main():
-    global ser
-    global output
-    global outputIsFile
-    global stopSniffingThread
-    global snifferThreadTerminated
-    global enableWarnings
+    if args.hop_channels != None:
+        try:
+            hopSchedule = parseHopSchedule(args.hop_channels, args.dwell)
+        except ValueError as e:
+            print('Invalid hop schedule: ' + str(e))
+            return
 
-    args = parseArguments()
+        # The OpenMote starts on the first channel of the schedule
+        args.channel = hopSchedule[0][0]
 
-    enableWarnings = args.enable_warnings
+        if args.adaptive_dwell != None:
+            try:
+                adaptiveMinDwellTime = parseAdaptiveDwellTime(args.adaptive_dwell)
+            except ValueError as e:
+                print('Invalid adaptive dwell time: ' + str(e))
+                return
+    elif args.adaptive_dwell != None:
+        print('Adaptive dwell times are only used when hopping between channels with --hop')
+        return
 
     if args.channel != None and (args.channel < 11 or args.channel > 26):
         print('Channel should be between 11 and 26')
         return
 
+    zepPort = ZEP_PORT
+    if args.zep_destination != None:
+        if args.ethernet_interface == None or args.zep_source == None:
+            print('ZEP output requires --ethernet and --zep-source')
+            return
+        if printOnly or args.pcap_file != None or args.dump_flash_log or args.erase_flash_log or args.duplicates not in (None, 'send') \
+         or args.compress_headers or args.descriptors or args.trigger != None:
+            print('ZEP output can not be combined with a survey, a summary, an output file, the flash log, duplicates, compression, '
+                  'descriptors or a trigger')
+            return
+
+        try:
+            if ':' in args.zep_destination:
+                args.zep_destination, zepPort = args.zep_destination.split(':')
+                zepPort = int(zepPort)
+            socket.inet_aton(args.zep_destination)
+            socket.inet_aton(args.zep_source)
+        except (ValueError, socket.error):
+            print('ZEP destination should be "IP[:PORT]" and the source an IP address')
+            return
+
+    if args.arrow != None:
+        if printOnly or aggregating or args.zep_destination != None:
+            print('The Arrow stream can not be combined with a survey, a summary, several OpenMotes or ZEP output')
+            return
+        if args.arrow_batch < 1 or args.arrow_batch > 1000:
+            print('The Arrow record batches should have between 1 and 1000 thousand frames')
+            return
+
+    if args.shared_ring != None:
+        if printOnly or aggregating or args.zep_destination != None:
+            print('The shared ring can not be combined with a survey, a summary, several OpenMotes or ZEP output')
+            return
+
+    lowpanContexts = []
+    lowpanLibrary = None
+    if args.ipv6 != None:
+        if printOnly or aggregating or args.zep_destination != None:
+            print('The IPv6 output can not be combined with a survey, a summary, several OpenMotes or ZEP output')
+            return
+        if args.ipv6_datagrams < 1 or args.ipv6_timeout <= 0:
+            print('At least one datagram should be reassembled at a time, with a timeout that is positive')
+            return
+        try:
+            lowpanContexts = [parseLowpanContext(context) for context in args.ipv6_context]
+        except (ValueError, socket.error) as e:
+            print('Invalid --ipv6-context: ' + str(e))
+            return
+
+        # Also when the received bytes are processed in python
+        lowpanLibrary = hostLibrary if hostLibrary != None else loadHostLibrary()
+        if lowpanLibrary == None or not hasattr(lowpanLibrary, 'snifferLowpanCreate'):
+            print('ERROR: The IPv6 output needs the native library, build it with "make" in ' + HOST_LIBRARY_DIR)
+            return
+    elif len(args.ipv6_context) > 0:
+        print('--ipv6-context only works together with --ipv6')
+        return
+        if args.shared_ring_size < 1 or args.shared_ring_size > 4096:
+            print('The shared ring should be between 1 and 4096 MB')
+            return
+
+    localOutput = True
+    flightRecorderProgram = None
+    if args.flight_recorder != None:
+        if printOnly or aggregating or extcap or args.zep_destination != None or args.live_view:
+            print('The flight recorder can not be combined with a survey, a summary, several OpenMotes, extcap, ZEP or a live view')
+            return
+        if rotating or args.compress != None or args.block_writes != None or args.pcap_file == '-':
+            print('The flight recorder writes no continuous output, which could be rotated, compressed, written in blocks or to stdout')
+            return
+        if args.flight_recorder <= 0 or args.flight_recorder_size < 1 or args.flight_recorder_after < 0:
+            print('The minutes and size of the flight recorder should be positive, and the seconds after a trigger not negative')
+            return
+        if args.flight_recorder_match != None:
+            try:
+                flightRecorderProgram = compileFilterProgram(args.flight_recorder_match)
+            except (ValueError, IndexError) as e:
+                print('Invalid expression of --flight-recorder-match: ' + str(e))
+                return
+
+        # The name of the output is only used for the files of the triggers
+        flightRecorderFileName = args.pcap_file if args.pcap_file != None else 'flight-recorder.pcapng'
+        args.pcap_file = os.devnull
+        localOutput = False
+    elif args.flight_recorder_match != None:
+        print('--flight-recorder-match only works together with --flight-recorder')
+        return
+
+    if args.remote != None:
+        if printOnly or aggregating or extcap or args.zep_destination != None:
+            print('Streaming to a collector can not be combined with a survey, a summary, several OpenMotes, extcap or ZEP output')
+            return
+        remoteHost, _, remotePort = args.remote.rpartition(':') if ':' in args.remote else (args.remote, None, str(REMOTE_PORT))
+        if not remotePort.isdigit() or int(remotePort) < 1 or int(remotePort) > 65535 or remoteHost == '':
+            print('The collector should be given as "HOST[:PORT]"')
+            return
+        if args.site == None:
+            args.site = socket.gethostname()
+        if len(args.site.encode('utf-8')) == 0 or len(args.site.encode('utf-8')) > 255:
+            print('The name of the site should be between 1 and 255 bytes')
+            return
+
+        # A sniffer at a remote site usually has nobody looking at it, so there is only a local capture when asked for
+        if args.pcap_file == None:
+            args.pcap_file = os.devnull
+            localOutput = False
+    elif args.site != None or args.remote_compress:
+        print('--site and --remote-compress only work together with --remote')
+        return
+
+    if args.ethernet_interface != None:
+        if platform != 'Linux':
+            print('Ethernet is only supported on Linux')
+            return
+        if requestedBaudrates:
+            print('The baudrate can not be changed over Ethernet')
+            return
+
     # If no serial port was provided as parameter, find one now
-    if args.port == None:
+    if args.spi_device != None:
+        if platform != 'Linux':
+            print('SPI is only supported on Linux')
+            return
+        if requestedBaudrates:
+            print('The baudrate can not be changed over SPI')
+            return
+
+    if args.port == None and args.ethernet_interface == None and args.spi_device == None and not aggregating:
         args.port = pickSerialPort()
         if args.port == None:
             return
 
-    # Setup the serial connection
+    # Setup the serial connection, or the raw socket that takes its place
     try:
-        ser = serial.Serial(port     = args.port,
-                            baudrate = BAUDRATE,
-                            parity   = serial.PARITY_NONE,
-                            stopbits = serial.STOPBITS_ONE,
-                            bytesize = serial.EIGHTBITS,
-                            xonxoff  = False,
-                            rtscts   = False,
-                            dsrdtr   = False,
-                            timeout  = SERIAL_TIMEOUT)
+        if aggregating:
+            # Each sniffer opens its own serial port, only the port of the sync beacon is used here
+            if args.sync_beacon != None:
+                ser = serial.Serial(port=args.sync_beacon, baudrate=BAUDRATE, timeout=SERIAL_TIMEOUT)
+        elif args.ethernet_interface != None:
+            ser = EthernetPort(args.ethernet_interface, SERIAL_TIMEOUT)
+        elif args.spi_device != None:
+            ser = SpiPort(args.spi_device, args.spi_ready_gpio, SERIAL_TIMEOUT)
+        else:
+            ser = serial.Serial(port     = args.port,
+                                baudrate = BAUDRATE,
+                                parity   = serial.PARITY_NONE,
+                                stopbits = serial.STOPBITS_ONE,
+                                bytesize = serial.EIGHTBITS,
+                                xonxoff  = False,
+                                rtscts   = False,  # The RTS and DTR lines of the OpenBase are wired to the boot loader and reset
+                                dsrdtr   = False,
+                                timeout  = SERIAL_TIMEOUT)
+            serialDevice = ser
+
+            # Without hardware flow control a full driver buffer loses bytes, which costs a retransmission of every packet
+            # after them. Only the Windows driver has a receive buffer of a configurable size, Linux buffers the tty on its own.
+            if hasattr(ser, 'set_buffer_size'):
+                try:
+                    ser.set_buffer_size(rx_size=SERIAL_RX_BUFFER_SIZE)
+                except (IOError, OSError, ValueError) as e:
+                    print('WARNING: Could not enlarge the receive buffer of the serial port. Error: ' + str(e))
+            if lowLatency:
+                configureLowLatency(args.port)
+
+            # The second lane only carries records to the host, the messages to the OpenMote all go over the first port
+            if args.bond_port != None:
+                bondPort = serial.Serial(port=args.bond_port, baudrate=BAUDRATE, rtscts=False, dsrdtr=False, timeout=SERIAL_TIMEOUT)
+                if hasattr(bondPort, 'set_buffer_size'):
+                    try:
+                        bondPort.set_buffer_size(rx_size=SERIAL_RX_BUFFER_SIZE)
+                    except (IOError, OSError, ValueError) as e:
+                        print('WARNING: Could not enlarge the receive buffer of the second serial port. Error: ' + str(e))
+                ser = BondedPort(ser, bondPort, SERIAL_TIMEOUT)
     except serial.serialutil.SerialException as e:
         print('ERROR: Could not connect to serial port. PySerial error: ' + str(e))
         return
+    except socket.error as e:
+        if args.spi_device != None:
+            print('ERROR: Could not open the SPI device. Error: ' + str(e))
+        else:
+            print('ERROR: Could not open network interface (root is required). Error: ' + str(e))
+        return
+    except ValueError as e:
+        print('ERROR: Could not open the SPI device. Error: ' + str(e))
+        return
+    except ImportError:
+        print('ERROR: SPI requires the spidev module (pip install spidev)')
+        return
+
+    if args.record_stream != None:
+        try:
+            ser = StreamRecorder(ser, args.record_stream)
+        except (IOError, OSError) as e:
+            print('ERROR: Could not create ' + args.record_stream + '. Exception: ' + str(e))
+            return
 
     # If no channel was provided as parameter, ask the user on which channel to listen
-    if args.channel == None:
+    if args.channel == None and not aggregating:
         args.channel = pickRadioChannel()
         if args.channel == None:
             return
 
-    # Test our serial connection before starting wireshark
-    print('Testing serial connection...')
-    if not connectToOpenMote(args.channel, quiet=True):
+    # Test our serial connection before starting wireshark, except when the capture of the OpenMote has to continue
+    if not aggregating and not args.attach:
+        print('Testing serial connection...')
+        if not connectToOpenMote(args.channel, quiet=True):
+            return
+        serialWriteStop()
+
+    if args.clear_autostart:
+        clearAutostart()
+        return
+
+    # The OpenMote keeps sending the frames to the ZEP destination by itself, nothing is needed from us anymore
+    if args.zep_destination != None:
+        if connectToOpenMote(args.channel) and requestZep(args.zep_destination, zepPort, args.zep_source):
+            print('The OpenMote now sends the frames to ' + args.zep_destination + ':' + str(zepPort))
+        else:
+            print('ERROR: The OpenMote did not switch to ZEP output')
+        return
+
+    # Erasing the flash log doesn't require any output
+    if args.erase_flash_log and not args.dump_flash_log:
+        eraseFlashLog()
         return
-    serialWriteStop()
 
     # Start wireshark when needed
     wiresharkProcess = None
-    if args.pcap_file == None:
+    livePipe = None
+    if args.live_view:
+        # Wireshark is started first, the file takes the place of its pipe as the output
+        print('Creating pipe for the live view...')
+        if not createPipe(args.pipe_name, args.force):
+            return
+
+        print('Starting wireshark...')
+        try:
+            wiresharkProcess = startWireshark(args.wireshark_executable, args.pipe_name)
+
+            print('Waiting for wireshark to be ready...')
+            if platform != 'Windows':
+                livePipe = open(args.pipe_name, 'wb', buffering=0)
+            else:
+                livePipe = OverlappedPipe(output)
+                output = None
+                livePipe.connect()
+            print('Connected to wireshark')
+
+        except (KeyboardInterrupt, EOFError, SystemExit):
+            removePipe(args.pipe_name)
+            return
+
+    rotation = None
+    blockSize = args.block_writes * 1024 if args.block_writes != None else 0
+    if blockSize > 0:
+        writeLatency = WriteLatency()
+    if printOnly:
+        pass # Nothing is written to wireshark or to a file, the results of the survey or summary are printed instead
+
+    elif extcap:
+        # Wireshark created the pipes and already waits for the capture, in the order of its extcap example
+        try:
+            extcapControl = ExtcapControl(args.extcap_control_in, args.extcap_control_out, args.channel)
+            output = open(args.fifo, 'wb', 0)
+            outputIsFile = True
+        except (IOError, OSError) as e:
+            print('ERROR: Failed to open the pipes of Wireshark. Exception: ' + str(e))
+            return
+
+    elif args.pcap_file == None:
         print('Creating pipe...')
         if not createPipe(args.pipe_name, args.force):
             return
@@ -620,7 +8169,8 @@ def main():
                 output = open(args.pipe_name, 'wb', buffering=0)
                 outputIsFile = True
             else:
-                win32pipe.ConnectNamedPipe(output, None)
+                outputPipe = OverlappedPipe(output)
+                outputPipe.connect()
                 outputIsFile = False
             print('Connected to wireshark')
 
@@ -628,69 +8178,236 @@ def main():
             removePipe(args.pipe_name)
             return
 
+    elif standardOutput != None:
+        output = standardOutput
+        outputIsFile = True
+
+    elif rotating:
+        print('Creating first pcap file...')
+        try:
+            rotation = FileRotation(args.pcap_file, int(args.rotate_size * 1000000), args.rotate_time, args.max_files,
+                                    compression=args.compress, blockSize=blockSize)
+        except (IOError, OSError) as e:
+            print('Failed to create output file. Exception: ' + str(e))
+            return
+
     else: # Write data to pcap file instead of real-time monitoring with wireshark
         print('Creating pcap file...')
-        if os.path.exists(args.pcap_file):
+        fileName = args.pcap_file
+        if args.compress != None and not fileName.endswith(COMPRESSION_EXTENSIONS[args.compress]):
+            fileName += COMPRESSION_EXTENSIONS[args.compress]
+        if os.path.exists(fileName) and fileName != os.devnull:
             if not args.force:
                 try:
-                    response = str(INPUT('File ' + args.pcap_file + ' already exists. Delete it and continue? [y/N] '))
+                    response = str(INPUT('File ' + fileName + ' already exists. Delete it and continue? [y/N] '))
                     if response == 'y' or response == 'Y':
-                        os.remove(args.pcap_file)
+                        os.remove(fileName)
                     else:
                         return
                 except (KeyboardInterrupt, EOFError, SystemExit):
                     return
             else:
-                os.remove(args.pcap_file)
+                os.remove(fileName)
 
-        output = open(args.pcap_file, 'wb')
-        outputIsFile = True
+        if args.compress != None or blockSize > 0:
+            # A compressed file or one with block writes is written as a rotation that never rotates, which also gives it an index
+            rotation = FileRotation(fileName, 0, 0, 0, compression=args.compress, numbered=False, blockSize=blockSize)
+        else:
+            output = open(fileName, 'wb')
+            outputIsFile = True
 
     # Write the global header to the output
-    outputGlobalHeader()
+    if not printOnly:
+        outputWriter = OutputWriter(rotation)
+    if livePipe != None:
+        liveView = LiveView(livePipe.write, args.live_rate, args.live_sample)
+    pcapngOutput = (len(hopSchedule) > 0 or args.stats_pcapng or args.pcapng or aggregating) and not printOnly
+    if not printOnly:
+        outputGlobalHeader()
+        outputWriter.headerWritten()
 
     # Define a function that should be called if anything goes wrong from this point onwards or when the sniffer quits
     def cleanup():
-        serialWriteStop()
+        if not aggregating or args.sync_beacon != None:
+            serialWriteStop()
+        if args.record_stream != None:
+            ser.stopRecording()
+        for sink in outputSinks:
+            sink.close()
+        outputSinks = []
+        if rtosTrace != None:
+            rtosTrace.close()
+        if fecRepairedPackets > 0 and enableWarnings:
+            print('Rebuilt ' + str(fecRepairedPackets) + ' packets from the FEC messages')
+
+        if printOnly:
+            return
 
+        outputWriter.stop()
+        if writeLatency != None:
+            print(writeLatency.summary())
+        if outputPause != None:
+            outputPause.stop()
+        if liveView != None:
+            liveView.stop()
+            try:
+                if platform != 'Windows':
+                    livePipe.close()
+                    os.remove(args.pipe_name)
+                else:
+                    livePipe.wait()
+                    win32pipe.DisconnectNamedPipe(livePipe.handle)
+                    livePipe.handle.close()
+            except (KeyboardInterrupt, SystemExit):
+                pass
+            except Exception as e:
+                print('ERROR: Failed to close the pipe of the live view. Exception: ' + str(e))
+        if output == None:
+            return
         try:
             if outputIsFile:
                 output.close()
             else:
+                outputPipe.wait()
                 win32pipe.DisconnectNamedPipe(output)
         except (KeyboardInterrupt, SystemExit):
             pass
         except Exception as e:
             print('ERROR: Failed to close pipe. Exception: ' + str(e))
 
-        if args.pcap_file == None:
+        if args.pcap_file == None and not extcap:
             removePipe(args.pipe_name)
 
+    # The shared ring is only a copy in memory, the Arrow stream parses every frame and writes a file, so it gets its own thread
+    if not printOnly and localOutput:
+        outputSinks.append(CaptureSink())
+    if args.remote != None:
+        outputSinks.append(RemoteSink(remoteHost, int(remotePort), args.site, args.remote_compress))
+    if args.flight_recorder != None:
+        flightRecorder = FlightRecorder(flightRecorderFileName, args.flight_recorder * 60, args.flight_recorder_size * 1024 * 1024,
+                                        args.flight_recorder_after, flightRecorderProgram)
+        outputSinks.append(flightRecorder)
+        if hasattr(signal, 'SIGUSR1'):
+            signal.signal(signal.SIGUSR1, lambda signum, frame: flightRecorder.trigger('SIGUSR1'))
+    if args.arrow != None:
+        try:
+            outputSinks.append(SinkWorker(ArrowStreamWriter(args.arrow, args.arrow_batch * 1000)))
+        except (IOError, OSError) as e:
+            print('Failed to create ' + args.arrow + '. Exception: ' + str(e))
+            cleanup()
+            return
+    if args.ipv6 != None:
+        try:
+            outputSinks.append(SinkWorker(Ipv6Writer(args.ipv6, lowpanLibrary, args.ipv6_datagrams, args.ipv6_timeout, lowpanContexts)))
+        except (IOError, OSError) as e:
+            print('Failed to create ' + args.ipv6 + '. Exception: ' + str(e))
+            cleanup()
+            return
+    if args.shared_ring != None:
+        try:
+            outputSinks.append(SharedRing(args.shared_ring, args.shared_ring_size * 1024 * 1024))
+        except (IOError, OSError, mmap.error) as e:
+            print('Failed to create ' + args.shared_ring + '. Exception: ' + str(e))
+            cleanup()
+            return
+
+    # The frames from the flash are written to the output file, no live capture happens in this case
+    if args.dump_flash_log:
+        if dumpFlashLog(not args.keep_bad_fcs, args.replace_fcs) and args.erase_flash_log:
+            eraseFlashLog()
+        cleanup()
+        return
+
+    if aggregating:
+        if len(fleetChannels) > 0:
+            runFleet(args)
+        else:
+            aggregateSniffers(args)
+        cleanup()
+        return
+
+    # Only the real connection lets the OpenMote transmit the frames, not the test of the connection
+    if injectFrames != None:
+        injector = FrameInjector(injectFrames, args.inject_cca, args.inject_timeline, args.inject_repeat)
+    if lowLatency:
+        roundTripProbe = RoundTripProbe()
+    linkMonitor = LinkMonitor()
+    outputPause = OutputPause()
+
+    attachPending = args.attach
     try:
         while True:
-            if not connectToOpenMote(args.channel):
+            # Only the first connection attaches, after that the OpenMote would have nothing left to attach to
+            if attachPending:
+                attachPending = False
+                if not attachToOpenMote() and not connectToOpenMote(args.channel):
+                    break
+            elif not connectToOpenMote(args.channel):
                 break
 
+            # The frames that the OpenMote recovered after it was reset come before the frames of the new capture
+            if recoveredRecords and not printOnly:
+                outputRecoveredRecords(not args.keep_bad_fcs, args.replace_fcs)
+
             stopSniffingThread = False
+            if args.record_stream != None:
+                ser.recording = True
             sniffingThread = threading.Thread(target=snifferThread, args=[args.channel, not args.keep_bad_fcs, args.replace_fcs])
             sniffingThread.start()
 
+            if extcapControl != None:
+                extcapControl.setStatus('Listening on channel ' + str(args.channel))
+
             try:
-                INPUT('Press return key to pause sniffer (and to choose a different channel)\n')
+                if extcap:
+                    # Another channel selected in the toolbar of Wireshark is switched to without interrupting the capture,
+                    # only the hopping schedule and the survey need the capture to be restarted
+                    extcapControl.waitForChanges(args.channel)
+                    while len(hopSchedule) == 0 and not args.survey and tschRequest == None and superframeRequest == None \
+                     and injector == None \
+                     and moteSupports(CAPABILITY_SET_CHANNEL) \
+                     and not extcapControl.closed and not snifferThreadTerminated:
+                        args.channel = extcapControl.channel
+                        serialWriteChannel(args.channel)
+                        extcapControl.setStatus('Listening on channel ' + str(args.channel))
+                        extcapControl.waitForChanges(args.channel)
+                elif len(hopSchedule) > 0 or args.survey:
+                    INPUT('Press return key to pause sniffer\n')
+                else:
+                    INPUT('Press return key to pause sniffer (and to choose a different channel)\n')
             except EOFError:
                 # On windows when pressing CTRL+C there will be a KeyboardInterrupt after this EOFError.
                 # This KeyboardInterrupt should not arrive while we are already cleaning up.
                 # On Linux and Mac OS X the KeyboardInterrupt is just fired and this code isn't even executed.
                 time.sleep(0.1)
 
+            # Let the sniffer thread print how many frames were matched by each filter rule
+            if (len(filterRules) > 0 or filterProgram != None) and not snifferThreadTerminated:
+                try:
+                    serialWrite(SerialDataType.FilterStats, [])
+                    time.sleep(SERIAL_TIMEOUT)
+                except:
+                    pass
+
             stopSniffingThread = True
             sniffingThread.join()
-
-            if snifferThreadTerminated:
+            if args.record_stream != None:
+                ser.recording = False
+
+            if args.survey:
+                printSurveyHistograms()
+            elif summarizing:
+                printSummary()
+            elif injector != None and injector.finished < len(injector.frames):
+                injector.printSummary()
+            if roundTripProbe != None:
+                roundTripProbe.printPercentiles()
+
+            if snifferThreadTerminated or (extcap and extcapControl.closed):
                 break
 
-            # Stop the sniffer when wireshark was already closed
-            if wiresharkProcess != None and wiresharkProcess.poll() != None:
+            # Stop the sniffer when wireshark was already closed, unless it only showed the live view of the file
+            if wiresharkProcess != None and wiresharkProcess.poll() != None and liveView == None:
                 break
 
             try:
@@ -699,9 +8416,18 @@ def main():
                 print('ERROR: Failed to inform OpenMote about sniffer being paused')
                 break
 
-            args.channel = pickRadioChannel()
-            if args.channel == None:
-                break
+            # When hopping or surveying, the same channels are used again after the pause
+            if extcap:
+                args.channel = extcapControl.channel
+            elif len(hopSchedule) > 0 or args.survey:
+                try:
+                    INPUT('Press return key to resume sniffer\n')
+                except (KeyboardInterrupt, EOFError, SystemExit):
+                    break
+            else:
+                args.channel = pickRadioChannel()
+                if args.channel == None:
+                    break
 
     except (KeyboardInterrupt, SystemExit):
         stopSniffingThread = True
@@ -1,19 +1,36 @@
 #ifndef FREERTOS_CONFIG_H
 #define FREERTOS_CONFIG_H
 
-#define configUSE_TICKLESS_IDLE                 0
+// In a low-power build ("make LOW_POWER=TRUE") the tick comes from the sleep timer and is suppressed while the serial
+// task waits, see sniffer_low_power.cpp. Otherwise the idle hook sleeps until the next interrupt, which includes the tick.
+#ifdef SNIFFER_LOW_POWER
+    #define configUSE_TICKLESS_IDLE             1
+#else
+    #define configUSE_TICKLESS_IDLE             0
+#endif
 #define configCPU_CLOCK_HZ                      32000000
 #define configTICK_RATE_HZ                      ( ( TickType_t ) 100 )
 
 #define configPRE_STOP_PROCESSING(x)            ( )
 #define configPOST_STOP_PROCESSING(x)           ( )
 
+// The stack of the serial task is a static array in main.cpp, so heap_1 only has to hold the TCBs of the serial task
+// and the idle task, the stack of the idle task and the queues behind the mutexes of the UART and the I2C driver and
+// the semaphore of the serial task. The sizes are upper bounds of the TCB and Queue_t
+// structs with the alignment of every block, the queue of the binary semaphore adds an aligned byte for its storage and
+// heap_1 loses up to 8 bytes when aligning the start of the heap.
+// All other free SRAM is used for the buffer of received packets (BUFFER_LEN), so what isn't reserved here ends up there.
+#define configSNIFFER_TASKS                     2
+#define configSNIFFER_QUEUES                    4
+#define configSNIFFER_TCB_SIZE                  80
+#define configSNIFFER_QUEUE_SIZE                96
+
 #define configUSE_PREEMPTION                    0
-#define configUSE_IDLE_HOOK                     0
+#define configUSE_IDLE_HOOK                     ( configUSE_TICKLESS_IDLE == 0 )
 #define configUSE_TICK_HOOK                     0
 #define configMAX_PRIORITIES                    ( 5 )
 #define configMINIMAL_STACK_SIZE                ( ( unsigned short ) 64 )
-#define configTOTAL_HEAP_SIZE                   ( ( size_t ) ( 1920 ) )
+#define configTOTAL_HEAP_SIZE                   ( ( size_t ) ( configSNIFFER_TASKS * configSNIFFER_TCB_SIZE + configMINIMAL_STACK_SIZE * 4 + configSNIFFER_QUEUES * configSNIFFER_QUEUE_SIZE + 8 ) )
 #define configMAX_TASK_NAME_LEN                 ( 16 )
 #define configUSE_TRACE_FACILITY                0
 #define configUSE_16_BIT_TICKS                  0
@@ -71,4 +88,24 @@
 #define configTICK_LOWEST_INTERRUPT_PRIORITY            ( configLIBRARY_LOWEST_INTERRUPT_PRIORITY << (8 - configPRIO_BITS) )
 #define configMAX_SYSCALL_INTERRUPT_PRIORITY            ( configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY << (8 - configPRIO_BITS) )
 
+// In a trace build ("make TRACE=TRUE") the kernel tells the trace recorder of sniffer_trace.cpp when it switches tasks,
+// when a task blocks, at every tick and when an interrupt gives a semaphore
+#ifdef SNIFFER_TRACE
+    #ifdef __cplusplus
+    extern "C" {
+    #endif
+    void snifferTraceTaskSwitchedIn(void* task);
+    void snifferTraceTaskBlocked(void);
+    void snifferTraceTick(void);
+    void snifferTraceGivenFromIsr(void);
+    #ifdef __cplusplus
+    }
+    #endif
+
+    #define traceTASK_SWITCHED_IN()                     snifferTraceTaskSwitchedIn(pxCurrentTCB)
+    #define traceBLOCKING_ON_QUEUE_RECEIVE(pxQueue)     snifferTraceTaskBlocked()
+    #define traceTASK_INCREMENT_TICK(xTickCount)        snifferTraceTick()
+    #define traceQUEUE_SEND_FROM_ISR(pxQueue)           snifferTraceGivenFromIsr()
+#endif
+
 #endif // FREERTOS_CONFIG_H
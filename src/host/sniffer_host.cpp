@@ -0,0 +1,908 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_host.hpp"
+#include "sniffer_host_crc.hpp"
+#include "sniffer_host_hdlc.hpp"
+#include "sniffer_host_lowpan.hpp"
+
+#include <cstring>
+
+// The table is placed in RAM on the OpenMote, the host has no such section
+#define SNIFFER_RAM_DATA
+#include "../sniffer_precompiled_crc16_table.h"
+#include "../sniffer_precompiled_hdlc_table.h"
+
+namespace Sniffer
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    HostReceiver::HostReceiver(bool hardwareCrc) :
+        m_hardwareCrc(hardwareCrc),
+        m_ackThreshold(HOST_DEFAULT_ACK_INTERVAL),
+        m_ackOnRequest(false),
+        m_cumulativeAck(false),
+        m_alignedRecords(false)
+    {
+        reset();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void HostReceiver::reset()
+    {
+        m_input.clear();
+        m_inputPos = 0;
+        m_receiving = false;
+        m_message.clear();
+        m_escaping = false;
+        m_cobs = false;
+        m_messageCobs = false;
+        m_events.clear();
+        m_currentEvent.second.clear();
+        m_output.clear();
+
+        m_unackedByteCount = 0;
+        m_ackRequested = false;
+        m_lastIndex = 0;
+        m_lastSeqNr = 0;
+        m_expectedSeqNr = 0;
+        m_retransmission = false;
+        m_outOfOrderPackets.clear();
+        m_repeatEndSeqNr = 0;
+        m_selectiveNackPending = false;
+        m_invalidMessageReceived = false;
+        m_triggerPending = false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void HostReceiver::resume()
+    {
+        m_input.clear();
+        m_inputPos = 0;
+        m_receiving = false;
+        m_message.clear();
+        m_output.clear();
+
+        m_unackedByteCount = 0;
+        m_ackRequested = false;
+        m_retransmission = false;
+        m_outOfOrderPackets.clear();
+        m_repeatEndSeqNr = 0;
+        m_selectiveNackPending = false;
+        m_invalidMessageReceived = false;
+
+        writeIndexAndSeqNr(SerialDataType::Resume);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void HostReceiver::expectTrigger()
+    {
+        m_triggerPending = true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void HostReceiver::setAckThreshold(unsigned int threshold)
+    {
+        m_ackThreshold = threshold;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void HostReceiver::setAckOnRequest(bool ackOnRequest)
+    {
+        m_ackOnRequest = ackOnRequest;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void HostReceiver::setCumulativeAck(bool cumulativeAck)
+    {
+        m_cumulativeAck = cumulativeAck;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void HostReceiver::setAlignedRecords(bool alignedRecords)
+    {
+        m_alignedRecords = alignedRecords;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void HostReceiver::setCobsFraming(bool cobs)
+    {
+        m_cobs = cobs;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void HostReceiver::feed(const uint8_t* data, size_t length)
+    {
+        // Bytes that were already processed are removed first, so that the input doesn't keep growing
+        m_input.erase(m_input.begin(), m_input.begin() + m_inputPos);
+        m_inputPos = 0;
+        m_input.insert(m_input.end(), data, data + length);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    int HostReceiver::nextEvent(const uint8_t** data, size_t* length)
+    {
+        // Only the input up to the next event is processed: after a READY message sniffer.py connects again and the
+        // bytes behind it are thrown away, and a checkpoint has to be handled before the records that follow it
+        while (m_events.empty() && (m_inputPos < m_input.size()))
+        {
+            if (!m_receiving)
+            {
+                m_receiving = true;
+                m_message.clear();
+                m_escaping = false;
+                m_messageCobs = m_cobs;
+
+                if (m_input[m_inputPos] != HDLC_FLAG)
+                    pushWarning(HostWarning::UnexpectedByte);
+                else
+                {
+                    m_inputPos++;
+                    continue;
+                }
+            }
+
+            // Whole runs of bytes between the flags are copied at once, the message continues in the next bytes when its
+            // closing flag didn't arrive yet. HDLC messages are unescaped on the way, in the framing that the message
+            // started with (the OpenMote only switches between two messages).
+            const uint8_t* start = &m_input[m_inputPos];
+            const size_t available = m_input.size() - m_inputPos;
+            size_t used = available;
+            if (m_messageCobs)
+            {
+                const uint8_t* end = static_cast<const uint8_t*>(std::memchr(start, HDLC_FLAG, available));
+                if (end != nullptr)
+                    used = end - start;
+                m_message.insert(m_message.end(), start, start + used);
+            }
+            else
+                used = HostHdlc::decode(start, available, m_message, m_escaping);
+
+            if (used == available)
+            {
+                m_inputPos = m_input.size();
+                break;
+            }
+
+            m_inputPos += used + 1;
+            if (m_message.empty() && !m_escaping)
+                pushWarning(HostWarning::OutOfSync);
+            else
+            {
+                m_receiving = false;
+                messageReceived();
+            }
+        }
+
+        if (m_events.empty())
+            return HostEvent::None;
+
+        m_currentEvent = std::move(m_events.front());
+        m_events.pop_front();
+
+        *data = m_currentEvent.second.data();
+        *length = m_currentEvent.second.size();
+        return m_currentEvent.first;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    std::vector<uint8_t>& HostReceiver::getOutput()
+    {
+        return m_output;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool HostReceiver::isReceiving() const
+    {
+        return m_receiving;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void HostReceiver::serialTimeout()
+    {
+        if (m_receiving)
+        {
+            m_receiving = false;
+            pushWarning(HostWarning::MissingByte);
+            writeIndexAndSeqNr(SerialDataType::Nack);
+        }
+        else if (m_selectiveNackPending || m_invalidMessageReceived)
+        {
+            // When the missing packets didn't arrive then just let the OpenMote resend everything
+            m_invalidMessageReceived = false;
+            m_outOfOrderPackets.clear();
+            m_selectiveNackPending = false;
+            writeIndexAndSeqNr(SerialDataType::Nack);
+        }
+        else if (m_unackedByteCount > 0)
+        {
+            // We haven't received any new packets for a moment, so the unacknowledged bytes are acknowledged now
+            m_unackedByteCount = m_ackThreshold;
+            m_ackRequested = true;
+            writeAck();
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void HostReceiver::ackDelayed()
+    {
+        if (!m_selectiveNackPending && !m_invalidMessageReceived && (m_unackedByteCount > 0))
+        {
+            m_unackedByteCount = m_ackThreshold;
+            m_ackRequested = true;
+            writeAck();
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    unsigned int HostReceiver::getUnackedByteCount() const
+    {
+        return m_unackedByteCount;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint16_t HostReceiver::calculateCrc(const uint8_t* data, size_t length, uint16_t crc) const
+    {
+        return HostCrc::calculateSerial(data, length, crc, m_hardwareCrc);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void HostReceiver::write(uint8_t dataType, const uint8_t* data, uint8_t length)
+    {
+        uint8_t header[2] = {dataType, static_cast<uint8_t>(length + 2)};
+        uint16_t crc = calculateCrc(header, 2, CRC_INIT);
+        crc = calculateCrc(data, length, crc);
+
+        uint8_t message[2 + 255 + 2];
+        std::memcpy(message, header, 2);
+        std::memcpy(message + 2, data, length);
+        writeUint16(message, 2 + length, crc);
+
+        // Escaped with the same table as the OpenMote uses, every byte can become 2 bytes and there are 2 flags
+        uint8_t frame[2 * sizeof(message) + 2];
+        uint8_t* out = frame;
+        *out++ = HDLC_FLAG;
+        for (uint16_t i = 0; i < 2 + length + 2; ++i)
+            out = hdlcEscapeByte(out, message[i]);
+        *out++ = HDLC_FLAG;
+        m_output.insert(m_output.end(), frame, out);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void HostReceiver::messageReceived()
+    {
+        // The messages that the OpenMote sends itself and the records that it encoded before switching are still HDLC framed
+        int warning = 0;
+        if (m_messageCobs)
+        {
+            m_frame = m_message;
+            warning = decodeCobs() ? validateMessage() : HostWarning::IncorrectCrc;
+            if (warning != 0)
+            {
+                bool escaping = false;
+                m_message.clear();
+                HostHdlc::decode(m_frame.data(), m_frame.size(), m_message, escaping);
+                if (validateMessage() == 0)
+                    warning = 0;
+            }
+        }
+        else
+            warning = validateMessage();
+
+        if (warning != 0)
+        {
+            // The next packet will tell which one went missing, the OpenMote is only asked to resend everything when no other packet arrives
+            pushWarning(warning);
+            m_invalidMessageReceived = true;
+            return;
+        }
+
+        // The CRC isn't passed on
+        m_message.resize(m_message.size() - 2);
+        processPacket();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool HostReceiver::decodeCobs()
+    {
+        // Each code byte tells where the next zero was, except after a full block. The output never gets ahead of the input.
+        size_t length = 0;
+        size_t pos = 0;
+        while (pos < m_message.size())
+        {
+            const uint8_t code = m_message[pos] ^ COBS_XOR_MASK;
+            if ((code == 0) || (pos + code > m_message.size()))
+                return false;
+
+            for (size_t i = pos + 1; i < pos + code; ++i)
+                m_message[length++] = m_message[i] ^ COBS_XOR_MASK;
+
+            pos += code;
+            if ((code != COBS_MAX_BLOCK_LEN) && (pos < m_message.size()))
+                m_message[length++] = 0;
+        }
+
+        m_message.resize(length);
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    int HostReceiver::validateMessage()
+    {
+        const size_t length = m_message.size();
+        if (length < 4)
+            return HostWarning::TooShort;
+
+        if (calculateCrc(m_message.data(), length - 2, CRC_INIT) != readUint16(m_message.data(), length - 2))
+            return HostWarning::IncorrectCrc;
+
+        // Only the messages with records can ask for an ACK
+        const uint8_t recordType = m_message[0] & ~ACK_REQUESTED;
+        const bool records = (recordType == SerialDataType::Packet) || (recordType == SerialDataType::PacketBatch)
+                          || (recordType == SerialDataType::Survey);
+        const uint8_t dataType = records ? recordType : m_message[0];
+        if ((dataType != SerialDataType::Packet) && (dataType != SerialDataType::PacketBatch) && (dataType != SerialDataType::Ready)
+         && (dataType != SerialDataType::FilterStats) && (dataType != SerialDataType::Survey) && (dataType != SerialDataType::Stats)
+         && (dataType != SerialDataType::FlashLog) && (dataType != SerialDataType::Baudrate) && (dataType != SerialDataType::Zep)
+         && (dataType != SerialDataType::Integrity) && (dataType != SerialDataType::Resume) && (dataType != SerialDataType::Summary)
+         && (dataType != SerialDataType::TopTalkers) && (dataType != SerialDataType::Trigger)
+         && (dataType != SerialDataType::Epoch)
+         && (dataType != SerialDataType::Recovery)
+         && (dataType != SerialDataType::Tsch)
+         && (dataType != SerialDataType::Superframe)
+         && (dataType != SerialDataType::AdaptiveHop)
+         && (dataType != SerialDataType::Latency)
+         && (dataType != SerialDataType::Trace)
+         && (dataType != SerialDataType::Inject)
+         && (dataType != SerialDataType::Degradation)
+         && (dataType != SerialDataType::Control)
+         && (dataType != SerialDataType::Identify))
+            return HostWarning::InvalidType;
+
+        if (m_message[1] != length - 2)
+            return HostWarning::IncorrectLength;
+
+        if ((dataType == SerialDataType::Packet) && (length < HOST_DATA_OFFSET + 2))
+            return HostWarning::TooShortPacket;
+
+        if ((dataType == SerialDataType::Survey) && (length < HOST_DATA_OFFSET + 3))
+            return HostWarning::TooShortSurvey;
+
+        if ((dataType == SerialDataType::PacketBatch) && (length < HOST_DATA_OFFSET + 3))
+            return HostWarning::TooShortBatch;
+
+        return 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void HostReceiver::processPacket()
+    {
+        // The flag is taken off, the records are given out in the layout that they always had
+        if (m_message[0] & ACK_REQUESTED)
+        {
+            m_message[0] &= ~ACK_REQUESTED;
+            m_ackRequested = true;
+        }
+
+        const uint8_t dataType = m_message[0];
+        if ((dataType != SerialDataType::Packet) && (dataType != SerialDataType::PacketBatch) && (dataType != SerialDataType::Survey))
+        {
+            if ((dataType == SerialDataType::Trigger) && (m_message.size() == 2 + TRIGGER_REPORT_LENGTH))
+                receivedTrigger();
+
+            // Messages that don't contain records are handled by sniffer.py itself
+            pushEvent(HostEvent::Message, m_message);
+            return;
+        }
+
+        if (dataType != SerialDataType::PacketBatch)
+        {
+            if (m_alignedRecords && !removePadding(m_message))
+            {
+                pushWarning(HostWarning::IncorrectPadding);
+                return;
+            }
+
+            processSinglePacket(m_message);
+            return;
+        }
+
+        // Split the batch in its packets, each one starts with a length byte that includes the length byte itself
+        std::vector<std::vector<uint8_t>> packets;
+        size_t pos = 2;
+        while (pos < m_message.size())
+        {
+            const uint8_t packetLen = m_message[pos];
+            if ((packetLen < HOST_DATA_OFFSET + 1) || (pos + packetLen > m_message.size()))
+            {
+                pushWarning(HostWarning::IncorrectBatchLength);
+                writeIndexAndSeqNr(SerialDataType::Nack);
+                return;
+            }
+
+            // Give each packet the same layout as a message of type Packet
+            std::vector<uint8_t> packet;
+            packet.reserve(packetLen + 1);
+            packet.push_back(SerialDataType::Packet);
+            packet.push_back(packetLen + 1);
+            packet.insert(packet.end(), m_message.begin() + pos + 1, m_message.begin() + pos + packetLen);
+            if (m_alignedRecords && !removePadding(packet))
+            {
+                pushWarning(HostWarning::IncorrectPadding);
+                writeIndexAndSeqNr(SerialDataType::Nack);
+                return;
+            }
+
+            packets.push_back(std::move(packet));
+            pos += packetLen;
+        }
+
+        // Every packet in the batch is acknowledged on its own, as if they were send separately
+        for (const auto& packet : packets)
+            processSinglePacket(packet);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void HostReceiver::receivedTrigger()
+    {
+        // The records that the OpenMote discarded before the window are skipped, it continues after the record that it
+        // treated as acknowledged. Without discarded records the sequence numbers simply continue.
+        m_triggerPending = false;
+        if (readUint32(m_message.data(), 2 + 8) == 0)
+            return;
+
+        m_lastIndex = readUint16(m_message.data(), 2);
+        m_lastSeqNr = readUint16(m_message.data(), 2 + 2);
+        m_expectedSeqNr = m_lastSeqNr + 1;
+        m_retransmission = false;
+        m_outOfOrderPackets.clear();
+        m_selectiveNackPending = false;
+        m_unackedByteCount = 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool HostReceiver::removePadding(std::vector<uint8_t>& msg) const
+    {
+        // The byte in front of the data tells how many bytes behind the record only align it to whole words.
+        // Both are removed, so that the record gets the same layout as those of an OpenMote without aligned records.
+        const uint8_t padding = msg[HOST_PADDING_OFFSET];
+        if ((padding >= BUFFER_RECORD_ALIGNMENT) || (msg.size() < HOST_DATA_OFFSET + 2u + padding))
+            return false;
+
+        msg.resize(msg.size() - padding);
+        msg.erase(msg.begin() + HOST_PADDING_OFFSET);
+        msg[1] = static_cast<uint8_t>(msg.size());
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void HostReceiver::processSinglePacket(const std::vector<uint8_t>& msg)
+    {
+        m_invalidMessageReceived = false;
+
+        // Ignore the packet if it had a wrong sequence number
+        const uint16_t receivedSeqNr = readUint16(const_cast<uint8_t*>(msg.data()), HOST_SEQNR_OFFSET);
+
+        // When the TRIGGER message got lost, the first record that doesn't follow the previous one starts the window
+        if (m_triggerPending && (m_expectedSeqNr != receivedSeqNr))
+        {
+            m_triggerPending = false;
+            m_expectedSeqNr = receivedSeqNr;
+            m_outOfOrderPackets.clear();
+            m_selectiveNackPending = false;
+        }
+
+        if (m_expectedSeqNr == receivedSeqNr)
+        {
+            m_outOfOrderPackets.erase(receivedSeqNr);
+            acceptPacket(msg);
+
+            // Packets that arrived while waiting for the missing ones can now be processed as well
+            auto it = m_outOfOrderPackets.find(m_expectedSeqNr);
+            while (it != m_outOfOrderPackets.end())
+            {
+                const std::vector<uint8_t> packet = std::move(it->second);
+                m_outOfOrderPackets.erase(it);
+                acceptPacket(packet);
+                it = m_outOfOrderPackets.find(m_expectedSeqNr);
+            }
+
+            if (m_outOfOrderPackets.empty())
+                m_selectiveNackPending = false;
+            else if (m_selectiveNackPending && !m_outOfOrderPackets.count(m_repeatEndSeqNr))
+            {
+                // The requested range is complete but another one went missing further on, ask for that one next
+                requestMissingPackets();
+            }
+        }
+        else if (static_cast<int16_t>(receivedSeqNr - m_expectedSeqNr) > 0)
+        {
+            // If the sequence number is higher than expected then tell the sniffer that we are missing something.
+            // The sequence numbers wrap around, so a packet is newer when it lies less than half the range ahead.
+            receivedPacketOutOfOrder(msg, receivedSeqNr);
+        }
+        else
+        {
+            // The OpenMote is retransmitting stuff that we already have, so send an ACK to inform it about this.
+            // If this is the first retransmitted packet then the ACK is send immediately, otherwise only every few packets.
+            if (m_retransmission)
+                m_unackedByteCount += msg.size();
+            else
+            {
+                m_retransmission = true;
+                m_unackedByteCount = m_ackThreshold;
+                m_ackRequested = true;
+            }
+
+            writeAck();
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void HostReceiver::receivedPacketOutOfOrder(const std::vector<uint8_t>& msg, uint16_t receivedSeqNr)
+    {
+        if (!m_selectiveNackPending)
+        {
+            // Keep the packet and only ask the OpenMote for the ones that are missing
+            m_outOfOrderPackets[receivedSeqNr] = msg;
+            m_selectiveNackPending = true;
+            requestMissingPackets();
+        }
+        else if (m_outOfOrderPackets.count(receivedSeqNr))
+        {
+            // We already have this packet
+        }
+        else if ((static_cast<uint16_t>(receivedSeqNr - m_expectedSeqNr) > static_cast<uint16_t>(m_repeatEndSeqNr - m_expectedSeqNr))
+              && (m_outOfOrderPackets.size() < HOST_MAX_OUT_OF_ORDER))
+        {
+            // The packets after the missing ones keep arriving while the OpenMote didn't receive our request yet. When there
+            // is another gap between them, it is only requested once the current range was resend, as the OpenMote can only
+            // resend one range at a time.
+            m_outOfOrderPackets[receivedSeqNr] = msg;
+        }
+        else
+        {
+            // One of the resend packets went missing as well or too much is waiting, let the OpenMote resend everything
+            // after the last received packet
+            m_outOfOrderPackets.clear();
+            m_selectiveNackPending = false;
+            writeIndexAndSeqNr(SerialDataType::Nack);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void HostReceiver::acceptPacket(const std::vector<uint8_t>& msg)
+    {
+        m_expectedSeqNr++;
+        m_retransmission = false;
+
+        // Remember the index and sequence number of this packet in case the next one is corrupted
+        m_lastIndex = readUint16(const_cast<uint8_t*>(msg.data()), HOST_INDEX_OFFSET);
+        m_lastSeqNr = readUint16(const_cast<uint8_t*>(msg.data()), HOST_SEQNR_OFFSET);
+
+        pushEvent(HostEvent::Record, msg);
+
+        // Send an ACK after enough bytes have been received
+        m_unackedByteCount += msg.size();
+        writeAck();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void HostReceiver::writeAck()
+    {
+        // When the OpenMote asks for ACKs, the threshold only keeps them apart while it is asking
+        if ((m_unackedByteCount >= m_ackThreshold) && (m_ackRequested || !m_ackOnRequest))
+        {
+            m_unackedByteCount = 0;
+            m_ackRequested = false;
+            writeIndexAndSeqNr(SerialDataType::Ack);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void HostReceiver::writeIndexAndSeqNr(uint8_t dataType)
+    {
+        uint8_t data[4];
+        writeUint16(data, 0, m_lastIndex);
+        writeUint16(data, 2, m_lastSeqNr);
+        write(dataType, data, sizeof(data));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void HostReceiver::writeSelectiveNack(uint16_t count)
+    {
+        uint8_t data[6];
+        writeUint16(data, 0, m_lastIndex);
+        writeUint16(data, 2, m_lastSeqNr);
+        writeUint16(data, 4, count);
+        write(SerialDataType::SelectiveNack, data, sizeof(data));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void HostReceiver::requestMissingPackets()
+    {
+        // All kept packets lie ahead of the expected one, so the closest one follows it unless the numbers wrapped
+        auto it = m_outOfOrderPackets.lower_bound(m_expectedSeqNr);
+        if (it == m_outOfOrderPackets.end())
+            it = m_outOfOrderPackets.begin();
+
+        const uint16_t distance = static_cast<uint16_t>(it->first - m_expectedSeqNr);
+        if (!m_cumulativeAck || (distance > CUMULATIVE_ACK_MISSING_RANGE))
+        {
+            m_repeatEndSeqNr = it->first;
+            writeSelectiveNack(distance);
+            return;
+        }
+
+        // Every gap in front of the farthest kept packet that the bitmap still reaches is requested in one go
+        uint32_t missing = 0;
+        uint32_t missingInFront = 0;
+        uint16_t repeatEnd = distance;
+        for (uint16_t offset = 0; offset <= CUMULATIVE_ACK_MISSING_RANGE; ++offset)
+        {
+            if (m_outOfOrderPackets.count(static_cast<uint16_t>(m_expectedSeqNr + offset)))
+            {
+                repeatEnd = offset;
+                missing = missingInFront;
+            }
+            else if (offset < CUMULATIVE_ACK_MISSING_RANGE)
+                missingInFront |= UINT32_C(1) << offset;
+        }
+
+        // The in-order bytes are acknowledged by the same message
+        m_repeatEndSeqNr = static_cast<uint16_t>(m_expectedSeqNr + repeatEnd);
+        m_unackedByteCount = 0;
+
+        uint8_t data[8];
+        writeUint16(data, 0, m_lastIndex);
+        writeUint16(data, 2, m_lastSeqNr);
+        writeUint32(data, 4, missing);
+        write(SerialDataType::CumulativeAck, data, sizeof(data));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void HostReceiver::pushEvent(int type, const std::vector<uint8_t>& data)
+    {
+        m_events.emplace_back(type, data);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void HostReceiver::pushWarning(int warning)
+    {
+        m_events.emplace_back(HostEvent::Warning, std::vector<uint8_t>(1, static_cast<uint8_t>(warning)));
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+using Sniffer::HostReceiver;
+
+void* snifferHostCreate(int hardwareCrc)
+{
+    return new HostReceiver(hardwareCrc != 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void snifferHostDestroy(void* receiver)
+{
+    delete static_cast<HostReceiver*>(receiver);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void snifferHostReset(void* receiver)
+{
+    static_cast<HostReceiver*>(receiver)->reset();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void snifferHostResume(void* receiver)
+{
+    static_cast<HostReceiver*>(receiver)->resume();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void snifferHostExpectTrigger(void* receiver)
+{
+    static_cast<HostReceiver*>(receiver)->expectTrigger();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void snifferHostSetAckThreshold(void* receiver, unsigned int threshold)
+{
+    static_cast<HostReceiver*>(receiver)->setAckThreshold(threshold);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void snifferHostSetAckOnRequest(void* receiver, int ackOnRequest)
+{
+    static_cast<HostReceiver*>(receiver)->setAckOnRequest(ackOnRequest != 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void snifferHostSetCumulativeAck(void* receiver, int cumulativeAck)
+{
+    static_cast<HostReceiver*>(receiver)->setCumulativeAck(cumulativeAck != 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void snifferHostSetAlignedRecords(void* receiver, int alignedRecords)
+{
+    static_cast<HostReceiver*>(receiver)->setAlignedRecords(alignedRecords != 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void snifferHostSetFraming(void* receiver, int framing)
+{
+    static_cast<HostReceiver*>(receiver)->setCobsFraming(framing == FRAMING_COBS);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void snifferHostFeed(void* receiver, const uint8_t* data, size_t length)
+{
+    static_cast<HostReceiver*>(receiver)->feed(data, length);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int snifferHostNextEvent(void* receiver, uint8_t* data, size_t maxLength, size_t* length)
+{
+    const uint8_t* eventData = nullptr;
+    size_t eventLength = 0;
+    const int event = static_cast<HostReceiver*>(receiver)->nextEvent(&eventData, &eventLength);
+
+    // Messages are never longer than 257 bytes, so a buffer of that size always receives the whole event
+    *length = (eventLength < maxLength) ? eventLength : maxLength;
+    if (*length > 0)
+        std::memcpy(data, eventData, *length);
+
+    return event;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t snifferHostTakeOutput(void* receiver, uint8_t* data, size_t maxLength)
+{
+    std::vector<uint8_t>& output = static_cast<HostReceiver*>(receiver)->getOutput();
+    const size_t length = (output.size() < maxLength) ? output.size() : maxLength;
+    std::memcpy(data, output.data(), length);
+    output.erase(output.begin(), output.begin() + length);
+    return length;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int snifferHostIsReceiving(void* receiver)
+{
+    return static_cast<HostReceiver*>(receiver)->isReceiving() ? 1 : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void snifferHostSerialTimeout(void* receiver)
+{
+    static_cast<HostReceiver*>(receiver)->serialTimeout();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void snifferHostAckDelayed(void* receiver)
+{
+    static_cast<HostReceiver*>(receiver)->ackDelayed();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+unsigned int snifferHostUnackedBytes(void* receiver)
+{
+    return static_cast<HostReceiver*>(receiver)->getUnackedByteCount();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint16_t snifferHostCalculateCrc(int hardwareCrc, const uint8_t* data, size_t length, uint16_t crc)
+{
+    return Sniffer::HostCrc::calculateSerial(data, length, crc, hardwareCrc != 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint16_t snifferHostCalculateRadioCrc(const uint8_t* data, size_t length)
+{
+    return Sniffer::HostCrc::calculateRadio(data, length);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void* snifferLowpanCreate(size_t maxDatagrams, int64_t timeout)
+{
+    return new Sniffer::HostLowpan(maxDatagrams, timeout);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void snifferLowpanDestroy(void* lowpan)
+{
+    delete static_cast<Sniffer::HostLowpan*>(lowpan);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void snifferLowpanSetContext(void* lowpan, unsigned int id, const uint8_t* prefix, unsigned int prefixLength)
+{
+    static_cast<Sniffer::HostLowpan*>(lowpan)->setContext(id, prefix, prefixLength);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void snifferLowpanFeed(void* lowpan, const uint8_t* frame, size_t length, int64_t timestamp)
+{
+    static_cast<Sniffer::HostLowpan*>(lowpan)->feed(frame, length, timestamp);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int snifferLowpanNextPacket(void* lowpan, uint8_t* data, size_t maxLength, size_t* length, int64_t* timestamp)
+{
+    const uint8_t* packetData = nullptr;
+    size_t packetLength = 0;
+    if (!static_cast<Sniffer::HostLowpan*>(lowpan)->nextPacket(&packetData, &packetLength, timestamp))
+        return 0;
+
+    // The packets are never longer than the datagram size, 2047 bytes, plus the headers of an unfragmented frame
+    *length = (packetLength < maxLength) ? packetLength : maxLength;
+    std::memcpy(data, packetData, *length);
+    return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+unsigned int snifferLowpanCounter(void* lowpan, int counter)
+{
+    return static_cast<Sniffer::HostLowpan*>(lowpan)->getCounter(counter);
+}
@@ -0,0 +1,214 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_HOST_HPP
+#define SNIFFER_HOST_HPP
+
+#include "../sniffer_protocol.hpp"
+
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <vector>
+
+// Offsets in a message as the host sees it, which has the type and length bytes instead of the length byte of the record
+#define HOST_INDEX_OFFSET           (1 + BUFFER_INDEX_OFFSET)
+#define HOST_SEQNR_OFFSET           (1 + BUFFER_SEQNR_OFFSET)
+#define HOST_DATA_OFFSET            (1 + BUFFER_PADDING_OFFSET)  // Records are given out without the padding of CAPABILITY_ALIGNED_RECORDS
+#define HOST_PADDING_OFFSET         (1 + BUFFER_PADDING_OFFSET)
+#define HOST_MAX_OUT_OF_ORDER       500     // Packets that are kept while waiting for the ones that went missing
+#define HOST_DEFAULT_ACK_INTERVAL   300     // Amount of bytes after which an ACK is send until the READY message tells the value in use
+
+namespace Sniffer
+{
+    namespace HostEvent
+    {
+        enum HostEvents
+        {
+            None = 0,
+            Record = 1,  // A record that was accepted in order, in the layout of a Packet (or Survey) message
+            Message = 2, // Any other valid message, e.g. READY or STATS
+            Warning = 3  // Something was wrong with the received data, the data contains one of the HostWarning values
+        };
+    }
+
+    namespace HostWarning
+    {
+        enum HostWarnings
+        {
+            TooShort = 1,
+            IncorrectCrc = 2,
+            InvalidType = 3,
+            IncorrectLength = 4,
+            TooShortPacket = 5,
+            TooShortSurvey = 6,
+            TooShortBatch = 7,
+            IncorrectBatchLength = 8,
+            UnexpectedByte = 9,
+            OutOfSync = 10,
+            MissingByte = 11,
+            IncorrectPadding = 12
+        };
+    }
+
+    // The receiving side of the serial protocol for the host: splits the received bytes in messages, checks their CRC,
+    // puts the records back in order and decides when to send ACK and NACK messages. These are the same steps as the
+    // PacketProcessor of sniffer.py, which uses this class through the C functions at the bottom when it was compiled.
+    class HostReceiver
+    {
+    public:
+        explicit HostReceiver(bool hardwareCrc);
+
+        // Forget the sequence numbers, called when the connection to the OpenMote was made again
+        void reset();
+
+        // Drop what was received since the last record and ask the OpenMote to continue after it, called when the serial
+        // port was opened again. The sequence numbers are kept, the answer arrives as a RESUME message.
+        void resume();
+
+        // Decode the records as COBS frames after sending a FRAMING message, frames that fail the CRC are still tried as HDLC.
+        // A reset goes back to HDLC, as the OpenMote does.
+        void setCobsFraming(bool cobs);
+
+        // A TRIGGER message was send, the records in front of the window may be skipped. The TRIGGER report tells where
+        // the records continue, the first jump in the sequence numbers is taken as the start of the window when it got lost.
+        void expectTrigger();
+
+        // Amount of received bytes after which an ACK is send, as announced by the OpenMote in its READY message
+        void setAckThreshold(unsigned int threshold);
+
+        // Only send an ACK after the threshold when a record asked for it (or when a timer forces one), when the READY message
+        // of the OpenMote had ACK_INTERVAL_ON_REQUEST in its ACK interval
+        void setAckOnRequest(bool ackOnRequest);
+
+        // Ask for missing packets with a cumulative ACK instead of a selective NACK, when the OpenMote has CAPABILITY_CUMULATIVE_ACK
+        void setCumulativeAck(bool cumulativeAck);
+
+        // Remove the padding from the records, when the OpenMote has CAPABILITY_ALIGNED_RECORDS
+        void setAlignedRecords(bool alignedRecords);
+
+        // Store the bytes that were read from the serial port, they are processed by nextEvent
+        void feed(const uint8_t* data, size_t length);
+
+        // Process the received bytes until something has to be passed to sniffer.py, returns HostEvent::None when all
+        // bytes were processed. The data of the event stays valid until the next call.
+        int nextEvent(const uint8_t** data, size_t* length);
+
+        // Bytes that have to be written to the serial port (encoded ACK and NACK messages), the caller empties it
+        std::vector<uint8_t>& getOutput();
+
+        // Check whether a message was started but not yet finished
+        bool isReceiving() const;
+
+        // Nothing was received for a while: either the rest of a message got lost, the missing packets didn't arrive or
+        // it is time to acknowledge the last bytes
+        void serialTimeout();
+
+        // The longest time that received bytes may stay unacknowledged has passed: acknowledge the packets that arrived in
+        // order, unless a NACK is pending which will tell the OpenMote what it has to send again
+        void ackDelayed();
+
+        // Amount of bytes that were received in order but not yet acknowledged
+        unsigned int getUnackedByteCount() const;
+
+        // Crc over a message as the serial protocol calculates it, either the table version or the one of the CRC engine
+        uint16_t calculateCrc(const uint8_t* data, size_t length, uint16_t crc) const;
+
+        // Add an encoded message to the output
+        void write(uint8_t dataType, const uint8_t* data, uint8_t length);
+
+    private:
+        void messageReceived();
+        bool decodeCobs();
+        int validateMessage();
+        void processPacket();
+        void receivedTrigger();
+        bool removePadding(std::vector<uint8_t>& msg) const;
+        void processSinglePacket(const std::vector<uint8_t>& msg);
+        void receivedPacketOutOfOrder(const std::vector<uint8_t>& msg, uint16_t receivedSeqNr);
+        void acceptPacket(const std::vector<uint8_t>& msg);
+        void writeAck();
+        void writeIndexAndSeqNr(uint8_t dataType);
+        void writeSelectiveNack(uint16_t count);
+        void requestMissingPackets();
+        void pushEvent(int type, const std::vector<uint8_t>& data);
+        void pushWarning(int warning);
+
+    private:
+        bool m_hardwareCrc;
+        unsigned int m_ackThreshold;
+        bool m_ackOnRequest;
+        bool m_cumulativeAck;
+        bool m_alignedRecords;
+
+        // Deframing, the received message is unescaped while it arrives
+        std::vector<uint8_t> m_input;
+        size_t m_inputPos;
+        bool m_receiving;
+        std::vector<uint8_t> m_message;
+        bool m_escaping;     // The last received byte of the HDLC message was an escape byte
+        bool m_cobs;
+        bool m_messageCobs;  // Framing of the message that is being received, at the time that it started
+        std::vector<uint8_t> m_frame; // Copy of a COBS frame, in case it has to be decoded as HDLC after all
+
+        // Events that sniffer.py didn't pick up yet, and the one that it is looking at
+        std::deque<std::pair<int, std::vector<uint8_t>>> m_events;
+        std::pair<int, std::vector<uint8_t>> m_currentEvent;
+        std::vector<uint8_t> m_output;
+
+        // Sequence number tracking
+        unsigned int m_unackedByteCount;
+        bool m_ackRequested; // A record asked for an ACK, or a timer wants the unacknowledged bytes to be acknowledged
+        uint16_t m_lastIndex;
+        uint16_t m_lastSeqNr;
+        uint16_t m_expectedSeqNr;
+        bool m_retransmission;
+        std::map<uint16_t, std::vector<uint8_t>> m_outOfOrderPackets;
+        uint16_t m_repeatEndSeqNr; // First kept packet after the range that the selective NACK asked for
+        bool m_selectiveNackPending;
+        bool m_invalidMessageReceived;
+        bool m_triggerPending;
+    };
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Plain C functions around HostReceiver, so that sniffer.py can call them with ctypes without any extra dependency
+extern "C"
+{
+    void* snifferHostCreate(int hardwareCrc);
+    void snifferHostDestroy(void* receiver);
+    void snifferHostReset(void* receiver);
+    void snifferHostResume(void* receiver);
+    void snifferHostExpectTrigger(void* receiver);
+    void snifferHostSetAckThreshold(void* receiver, unsigned int threshold);
+    void snifferHostSetAckOnRequest(void* receiver, int ackOnRequest);
+    void snifferHostSetCumulativeAck(void* receiver, int cumulativeAck);
+    void snifferHostSetAlignedRecords(void* receiver, int alignedRecords);
+    void snifferHostSetFraming(void* receiver, int framing);
+    void snifferHostFeed(void* receiver, const uint8_t* data, size_t length);
+    int snifferHostNextEvent(void* receiver, uint8_t* data, size_t maxLength, size_t* length);
+    size_t snifferHostTakeOutput(void* receiver, uint8_t* data, size_t maxLength);
+    int snifferHostIsReceiving(void* receiver);
+    void snifferHostSerialTimeout(void* receiver);
+    void snifferHostAckDelayed(void* receiver);
+    unsigned int snifferHostUnackedBytes(void* receiver);
+
+    // The CRCs of HostCrc, for the messages that sniffer.py sends itself and for the FCS that it puts back in the frames
+    uint16_t snifferHostCalculateCrc(int hardwareCrc, const uint8_t* data, size_t length, uint16_t crc);
+    uint16_t snifferHostCalculateRadioCrc(const uint8_t* data, size_t length);
+
+    // The 6LoWPAN reassembly and decompression of HostLowpan, which runs next to the receiver on the captured frames
+    void* snifferLowpanCreate(size_t maxDatagrams, int64_t timeout);
+    void snifferLowpanDestroy(void* lowpan);
+    void snifferLowpanSetContext(void* lowpan, unsigned int id, const uint8_t* prefix, unsigned int prefixLength);
+    void snifferLowpanFeed(void* lowpan, const uint8_t* frame, size_t length, int64_t timestamp);
+    int snifferLowpanNextPacket(void* lowpan, uint8_t* data, size_t maxLength, size_t* length, int64_t* timestamp);
+    unsigned int snifferLowpanCounter(void* lowpan, int counter);
+}
+
+#endif // SNIFFER_HOST_HPP
@@ -0,0 +1,229 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Measures how many MB/s each CRC check reaches on this pc, byte at a time and with slicing-by-8, after checking that the
+// HDLC escape table gives the same frames as escaping byte by byte. The deframing of HostHdlc is measured in the same way,
+// over a stream of escaped frames. Build and run it with "make benchmark".
+
+#include "sniffer_host_crc.hpp"
+#include "sniffer_host_hdlc.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#define BENCHMARK_FRAME_LEN     127     // Longest radio frame, the serial messages are only a few bytes longer
+#define BENCHMARK_BYTES         (64 * 1024 * 1024)
+
+using namespace Sniffer;
+
+// Escaping as it is written in the protocol, the table has to give the same bytes
+size_t escapeBytewise(const uint8_t* data, size_t length, uint8_t* out)
+{
+    size_t outLength = 0;
+    for (size_t i = 0; i < length; ++i)
+    {
+        if ((data[i] == HDLC_FLAG) || (data[i] == HDLC_ESCAPE))
+        {
+            out[outLength++] = HDLC_ESCAPE;
+            out[outLength++] = data[i] ^ HDLC_ESCAPE_MASK;
+        }
+        else
+            out[outLength++] = data[i];
+    }
+    return outLength;
+}
+
+size_t escapeWithTable(const uint8_t* data, size_t length, uint8_t* out)
+{
+    uint8_t* end = out;
+    for (size_t i = 0; i < length; ++i)
+        end = hdlcEscapeByte(end, data[i]);
+    return end - out;
+}
+
+// Checks every byte value on its own and the frames in the data, which also have to come back after unescaping
+bool checkEscapeTable(const std::vector<uint8_t>& data)
+{
+    uint8_t expected[2 * BENCHMARK_FRAME_LEN + 1];
+    uint8_t escaped[2 * BENCHMARK_FRAME_LEN + 1];
+    for (unsigned int byte = 0; byte < 256; ++byte)
+    {
+        const uint8_t value = static_cast<uint8_t>(byte);
+        if ((escapeWithTable(&value, 1, escaped) != escapeBytewise(&value, 1, expected))
+         || (std::memcmp(escaped, expected, escapeBytewise(&value, 1, expected)) != 0))
+        {
+            std::printf("HDLC escape mismatch for byte %02x\n", byte);
+            return false;
+        }
+    }
+
+    for (size_t pos = 0; pos + BENCHMARK_FRAME_LEN <= data.size() && pos < 1024 * BENCHMARK_FRAME_LEN; pos += BENCHMARK_FRAME_LEN)
+    {
+        const size_t length = escapeWithTable(&data[pos], BENCHMARK_FRAME_LEN, escaped);
+        if ((length != escapeBytewise(&data[pos], BENCHMARK_FRAME_LEN, expected)) || (std::memcmp(escaped, expected, length) != 0))
+        {
+            std::printf("HDLC escape mismatch in frame at %u\n", static_cast<unsigned int>(pos));
+            return false;
+        }
+
+        size_t unescapedLength = 0;
+        for (size_t i = 0; i < length; ++i)
+        {
+            if (escaped[i] == HDLC_ESCAPE)
+                escaped[unescapedLength++] = escaped[++i] ^ HDLC_ESCAPE_MASK;
+            else
+                escaped[unescapedLength++] = escaped[i];
+        }
+        if ((unescapedLength != BENCHMARK_FRAME_LEN) || (std::memcmp(escaped, &data[pos], BENCHMARK_FRAME_LEN) != 0))
+        {
+            std::printf("HDLC unescape mismatch in frame at %u\n", static_cast<unsigned int>(pos));
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Splits the stream on the flags as HostReceiver does, the unescaped frames are added behind each other
+template <typename Function>
+std::vector<uint8_t> deframe(const std::vector<uint8_t>& stream, const Function& decode)
+{
+    std::vector<uint8_t> output;
+    output.reserve(stream.size());
+    size_t pos = 0;
+    while (pos < stream.size())
+    {
+        bool escaping = false;
+        pos += decode(&stream[pos], stream.size() - pos, output, escaping) + 1;
+    }
+    return output;
+}
+
+// Both decoders have to give the frames back from every position in the stream, which also puts the flags and escape
+// bytes at every offset within the vectors
+bool checkDeframing(const std::vector<uint8_t>& data, const std::vector<uint8_t>& stream)
+{
+    for (size_t start = 0; start < 64; ++start)
+    {
+        const uint8_t* part = &stream[start];
+        const size_t length = 4 * BENCHMARK_FRAME_LEN;
+        if (HostHdlc::find(part, length) != HostHdlc::findBytewise(part, length))
+        {
+            std::printf("HDLC flag search mismatch at %u\n", static_cast<unsigned int>(start));
+            return false;
+        }
+
+        for (size_t split = 0; split < length; split += 7)
+        {
+            std::vector<uint8_t> expected;
+            std::vector<uint8_t> output;
+            bool expectedEscaping = false;
+            bool escaping = false;
+            const size_t expectedUsed = HostHdlc::decodeBytewise(part, split, expected, expectedEscaping);
+            const size_t used = HostHdlc::decode(part, split, output, escaping);
+            if ((used != expectedUsed) || (escaping != expectedEscaping) || (output != expected))
+            {
+                std::printf("HDLC decode mismatch at %u with %u bytes\n", static_cast<unsigned int>(start), static_cast<unsigned int>(split));
+                return false;
+            }
+        }
+    }
+
+    if ((deframe(stream, HostHdlc::decode) != data) || (deframe(stream, HostHdlc::decodeBytewise) != data))
+    {
+        std::printf("HDLC deframing mismatch\n");
+        return false;
+    }
+
+    return true;
+}
+
+template <typename Function>
+void measureDeframing(const char* name, const std::vector<uint8_t>& stream, const Function& decode)
+{
+    const auto start = std::chrono::steady_clock::now();
+    const size_t length = deframe(stream, decode).size();
+    const auto end = std::chrono::steady_clock::now();
+
+    const double seconds = std::chrono::duration<double>(end - start).count();
+    std::printf("%-26s %8.1f MB/s  (%u)\n", name, stream.size() / seconds / 1e6, static_cast<unsigned int>(length));
+}
+
+template <typename Function>
+void measure(const char* name, const std::vector<uint8_t>& data, const Function& function)
+{
+    // The result is accumulated so that the compiler can't leave out the calculations
+    uint16_t result = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t pos = 0; pos + BENCHMARK_FRAME_LEN <= data.size(); pos += BENCHMARK_FRAME_LEN)
+        result ^= function(&data[pos], BENCHMARK_FRAME_LEN);
+    const auto end = std::chrono::steady_clock::now();
+
+    const double seconds = std::chrono::duration<double>(end - start).count();
+    std::printf("%-26s %8.1f MB/s  (%04x)\n", name, data.size() / seconds / 1e6, result);
+}
+
+int main()
+{
+    std::vector<uint8_t> data(BENCHMARK_BYTES);
+    std::srand(1);
+    for (auto& byte : data)
+        byte = std::rand() & 0xff;
+
+    // Both versions have to agree on every length before their speed means anything
+    for (size_t length = 0; length <= BENCHMARK_FRAME_LEN; ++length)
+    {
+        for (uint8_t hardwareCrc = 0; hardwareCrc < 2; ++hardwareCrc)
+        {
+            if (HostCrc::calculateSerial(&data[length], length, CRC_INIT, hardwareCrc != 0)
+             != HostCrc::calculateSerialBytewise(&data[length], length, CRC_INIT, hardwareCrc != 0))
+            {
+                std::printf("Serial CRC mismatch for length %u\n", static_cast<unsigned int>(length));
+                return 1;
+            }
+        }
+
+        if (HostCrc::calculateRadio(&data[length], length) != HostCrc::calculateRadioBytewise(&data[length], length))
+        {
+            std::printf("Radio CRC mismatch for length %u\n", static_cast<unsigned int>(length));
+            return 1;
+        }
+    }
+
+    if (!checkEscapeTable(data))
+        return 1;
+
+    // The frames are escaped as the OpenMote sends them, with a flag behind each one
+    std::vector<uint8_t> stream;
+    stream.reserve(2 * data.size());
+    uint8_t escaped[2 * BENCHMARK_FRAME_LEN + 1];
+    for (size_t pos = 0; pos + BENCHMARK_FRAME_LEN <= data.size(); pos += BENCHMARK_FRAME_LEN)
+    {
+        stream.insert(stream.end(), escaped, escaped + escapeWithTable(&data[pos], BENCHMARK_FRAME_LEN, escaped));
+        stream.push_back(HDLC_FLAG);
+    }
+    data.resize(data.size() - data.size() % BENCHMARK_FRAME_LEN);
+
+    if (!checkDeframing(data, stream))
+        return 1;
+
+    std::printf("CRC over %u byte frames\n", BENCHMARK_FRAME_LEN);
+    measure("serial, bytewise", data, [](const uint8_t* d, size_t l) { return HostCrc::calculateSerialBytewise(d, l, CRC_INIT, false); });
+    measure("serial, slicing-by-8", data, [](const uint8_t* d, size_t l) { return HostCrc::calculateSerial(d, l, CRC_INIT, false); });
+    measure("hardware, bytewise", data, [](const uint8_t* d, size_t l) { return HostCrc::calculateSerialBytewise(d, l, CRC_INIT, true); });
+    measure("hardware, slicing-by-8", data, [](const uint8_t* d, size_t l) { return HostCrc::calculateSerial(d, l, CRC_INIT, true); });
+    measure("radio FCS, bytewise", data, [](const uint8_t* d, size_t l) { return HostCrc::calculateRadioBytewise(d, l); });
+    measure("radio FCS, slicing-by-8", data, [](const uint8_t* d, size_t l) { return HostCrc::calculateRadio(d, l); });
+
+    std::printf("HDLC deframing of %u byte frames\n", BENCHMARK_FRAME_LEN);
+    measureDeframing("bytewise", stream, HostHdlc::decodeBytewise);
+    measureDeframing(HostHdlc::getKernelName(), stream, HostHdlc::decode);
+    return 0;
+}
@@ -0,0 +1,138 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_host_crc.hpp"
+
+namespace Sniffer
+{
+    // Table k contains the value of the CRC register after a byte followed by k zero bytes, starting from a register of 0.
+    // As the CRC is linear, the register after 8 bytes is the xor of the 8 table entries (after mixing the old register
+    // into the first two bytes). The serial CRCs shift to the left, the radio CRC shifts to the right.
+    struct HostCrcTables
+    {
+        uint16_t serial[HOST_CRC_SLICES][256];
+        uint16_t hardware[HOST_CRC_SLICES][256];
+        uint16_t radio[HOST_CRC_SLICES][256];
+
+        HostCrcTables()
+        {
+            for (uint16_t i = 0; i < 256; ++i)
+            {
+                uint16_t crc = i << 8;
+                for (uint8_t j = 0; j < 8; ++j)
+                    crc = (crc & 0x8000) ? ((crc << 1) ^ HOST_HARDWARE_CRC_POLYNOMIAL) : (crc << 1);
+
+                serial[0][i] = crc16_table[i];
+                hardware[0][i] = crc;
+                radio[0][i] = crc16_table[i];
+            }
+
+            for (uint8_t k = 1; k < HOST_CRC_SLICES; ++k)
+            {
+                for (uint16_t i = 0; i < 256; ++i)
+                {
+                    serial[k][i] = (serial[k-1][i] << 8) ^ serial[0][serial[k-1][i] >> 8];
+                    hardware[k][i] = (hardware[k-1][i] << 8) ^ hardware[0][hardware[k-1][i] >> 8];
+                    radio[k][i] = (radio[k-1][i] >> 8) ^ radio[0][radio[k-1][i] & 0xff];
+                }
+            }
+        }
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline const HostCrcTables& getCrcTables()
+    {
+        // Initialized on first use, which C++11 makes thread safe
+        static const HostCrcTables tables;
+        return tables;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline uint16_t shiftLeftSliced(const uint16_t tables[HOST_CRC_SLICES][256], const uint8_t* data, size_t length, uint16_t crc)
+    {
+        while (length >= HOST_CRC_SLICES)
+        {
+            crc = tables[7][data[0] ^ (crc >> 8)] ^ tables[6][data[1] ^ (crc & 0xff)]
+                ^ tables[5][data[2]] ^ tables[4][data[3]] ^ tables[3][data[4]]
+                ^ tables[2][data[5]] ^ tables[1][data[6]] ^ tables[0][data[7]];
+
+            data += HOST_CRC_SLICES;
+            length -= HOST_CRC_SLICES;
+        }
+
+        for (size_t i = 0; i < length; ++i)
+            crc = tables[0][data[i] ^ (crc >> 8)] ^ (crc << 8);
+
+        return crc;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint16_t HostCrc::calculateSerial(const uint8_t* data, size_t length, uint16_t crc, bool hardwareCrc)
+    {
+        const HostCrcTables& tables = getCrcTables();
+        return shiftLeftSliced(hardwareCrc ? tables.hardware : tables.serial, data, length, crc);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint16_t HostCrc::calculateRadio(const uint8_t* data, size_t length)
+    {
+        const uint16_t (*tables)[256] = getCrcTables().radio;
+
+        uint16_t crc = 0;
+        while (length >= HOST_CRC_SLICES)
+        {
+            crc = tables[7][data[0] ^ (crc & 0xff)] ^ tables[6][data[1] ^ (crc >> 8)]
+                ^ tables[5][data[2]] ^ tables[4][data[3]] ^ tables[3][data[4]]
+                ^ tables[2][data[5]] ^ tables[1][data[6]] ^ tables[0][data[7]];
+
+            data += HOST_CRC_SLICES;
+            length -= HOST_CRC_SLICES;
+        }
+
+        for (size_t i = 0; i < length; ++i)
+            crc = tables[0][(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+
+        return crc;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint16_t HostCrc::calculateSerialBytewise(const uint8_t* data, size_t length, uint16_t crc, bool hardwareCrc)
+    {
+        if (hardwareCrc)
+        {
+            for (size_t i = 0; i < length; ++i)
+            {
+                crc ^= data[i] << 8;
+                for (uint8_t j = 0; j < 8; ++j)
+                    crc = (crc & 0x8000) ? ((crc << 1) ^ HOST_HARDWARE_CRC_POLYNOMIAL) : (crc << 1);
+            }
+
+            return crc;
+        }
+
+        for (size_t i = 0; i < length; ++i)
+            crc = crcCalculationStep(data[i], crc);
+
+        return crc;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint16_t HostCrc::calculateRadioBytewise(const uint8_t* data, size_t length)
+    {
+        uint16_t crc = 0;
+        for (size_t i = 0; i < length; ++i)
+            crc = crc16_table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+
+        return crc;
+    }
+}
@@ -0,0 +1,38 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_HOST_CRC_HPP
+#define SNIFFER_HOST_CRC_HPP
+
+#include "../sniffer_protocol.hpp"
+
+#include <cstddef>
+
+#define HOST_CRC_SLICES                 8       // Bytes that are processed per step, with a table for each position
+#define HOST_HARDWARE_CRC_POLYNOMIAL    0x8005  // x^16 + x^15 + x^2 + 1, as used by the CRC engine of the CC2538
+
+namespace Sniffer
+{
+    // Slicing-by-8 versions of the CRCs that the host has to check: the serial CRC (with the table of the firmware or with
+    // the polynomial of the CRC engine) and the FCS of the radio frames. They give the same results as the loops that
+    // process a byte at a time, which are kept for comparison in the benchmark.
+    class HostCrc
+    {
+    public:
+        // CRC of a serial message, which the firmware calculates with crcCalculationStep or with the CRC engine
+        static uint16_t calculateSerial(const uint8_t* data, size_t length, uint16_t crc, bool hardwareCrc);
+
+        // FCS of a radio frame (CRC-16/KERMIT, least significant byte first in the frame)
+        static uint16_t calculateRadio(const uint8_t* data, size_t length);
+
+        // Byte at a time versions
+        static uint16_t calculateSerialBytewise(const uint8_t* data, size_t length, uint16_t crc, bool hardwareCrc);
+        static uint16_t calculateRadioBytewise(const uint8_t* data, size_t length);
+    };
+}
+
+#endif // SNIFFER_HOST_CRC_HPP
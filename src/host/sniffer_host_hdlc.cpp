@@ -0,0 +1,193 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_host_hdlc.hpp"
+
+// SSE2 is part of every x86-64 cpu, AVX2 is only used when the cpu has it so that the library still runs everywhere.
+// The kernels need the bit scan builtins of GCC and clang (also with MinGW), other compilers get the bytewise loop.
+#if defined(__GNUC__) && defined(__SSE2__)
+    #define HOST_HDLC_SSE2 1
+    #include <immintrin.h>
+#elif defined(__GNUC__) && (defined(__ARM_NEON) || defined(__ARM_NEON__)) && defined(__ORDER_LITTLE_ENDIAN__) \
+   && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+    #define HOST_HDLC_NEON 1
+    #include <arm_neon.h>
+#endif
+
+namespace Sniffer
+{
+#if HOST_HDLC_SSE2
+    inline size_t findSse2(const uint8_t* data, size_t length)
+    {
+        const __m128i flag = _mm_set1_epi8(HDLC_FLAG);
+        const __m128i escape = _mm_set1_epi8(HDLC_ESCAPE);
+
+        size_t pos = 0;
+        for (; pos + 16 <= length; pos += 16)
+        {
+            const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+            const unsigned int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(bytes, flag), _mm_cmpeq_epi8(bytes, escape)));
+            if (mask != 0)
+                return pos + __builtin_ctz(mask);
+        }
+
+        return pos + HostHdlc::findBytewise(data + pos, length - pos);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    __attribute__((target("avx2"))) size_t findAvx2(const uint8_t* data, size_t length)
+    {
+        const __m256i flag = _mm256_set1_epi8(HDLC_FLAG);
+        const __m256i escape = _mm256_set1_epi8(HDLC_ESCAPE);
+
+        size_t pos = 0;
+        for (; pos + 32 <= length; pos += 32)
+        {
+            const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+            const unsigned int mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(bytes, flag), _mm256_cmpeq_epi8(bytes, escape)));
+            if (mask != 0)
+                return pos + __builtin_ctz(mask);
+        }
+
+        return pos + findSse2(data + pos, length - pos);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    typedef size_t (*FindFunction)(const uint8_t*, size_t);
+
+    inline FindFunction selectFind()
+    {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") ? findAvx2 : findSse2;
+    }
+
+    inline FindFunction getFind()
+    {
+        // Decided on first use, which C++11 makes thread safe
+        static const FindFunction find = selectFind();
+        return find;
+    }
+#elif HOST_HDLC_NEON
+    inline size_t findNeon(const uint8_t* data, size_t length)
+    {
+        const uint8x16_t flag = vdupq_n_u8(HDLC_FLAG);
+        const uint8x16_t escape = vdupq_n_u8(HDLC_ESCAPE);
+
+        size_t pos = 0;
+        for (; pos + 16 <= length; pos += 16)
+        {
+            const uint8x16_t bytes = vld1q_u8(data + pos);
+            const uint8x16_t matches = vorrq_u8(vceqq_u8(bytes, flag), vceqq_u8(bytes, escape));
+
+            // NEON has no movemask, narrowing every 16-bit lane by 4 bits leaves a nibble per byte in 64 bits
+            const uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(matches), 4)), 0);
+            if (mask != 0)
+                return pos + (__builtin_ctzll(mask) >> 2);
+        }
+
+        return pos + HostHdlc::findBytewise(data + pos, length - pos);
+    }
+#endif
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    size_t HostHdlc::find(const uint8_t* data, size_t length)
+    {
+#if HOST_HDLC_SSE2
+        return getFind()(data, length);
+#elif HOST_HDLC_NEON
+        return findNeon(data, length);
+#else
+        return findBytewise(data, length);
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    size_t HostHdlc::decode(const uint8_t* data, size_t length, std::vector<uint8_t>& output, bool& escaping)
+    {
+        // Consecutive escape bytes leave nothing behind, only the byte behind the last one is escaped
+        size_t pos = 0;
+        while (pos < length)
+        {
+            if (escaping)
+            {
+                if (data[pos] == HDLC_FLAG)
+                    return pos;
+                if (data[pos] != HDLC_ESCAPE)
+                {
+                    output.push_back(data[pos] ^ HDLC_ESCAPE_MASK);
+                    escaping = false;
+                }
+                pos++;
+                continue;
+            }
+
+            const size_t end = pos + find(data + pos, length - pos);
+            output.insert(output.end(), data + pos, data + end);
+            if (end == length)
+                return length;
+            if (data[end] == HDLC_FLAG)
+                return end;
+
+            escaping = true;
+            pos = end + 1;
+        }
+
+        return length;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    size_t HostHdlc::findBytewise(const uint8_t* data, size_t length)
+    {
+        for (size_t i = 0; i < length; ++i)
+        {
+            if ((data[i] == HDLC_FLAG) || (data[i] == HDLC_ESCAPE))
+                return i;
+        }
+
+        return length;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    size_t HostHdlc::decodeBytewise(const uint8_t* data, size_t length, std::vector<uint8_t>& output, bool& escaping)
+    {
+        for (size_t i = 0; i < length; ++i)
+        {
+            if (data[i] == HDLC_FLAG)
+                return i;
+            else if (data[i] == HDLC_ESCAPE)
+                escaping = true;
+            else if (escaping)
+            {
+                output.push_back(data[i] ^ HDLC_ESCAPE_MASK);
+                escaping = false;
+            }
+            else
+                output.push_back(data[i]);
+        }
+
+        return length;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    const char* HostHdlc::getKernelName()
+    {
+#if HOST_HDLC_SSE2
+        return (getFind() == findAvx2) ? "AVX2" : "SSE2";
+#elif HOST_HDLC_NEON
+        return "NEON";
+#else
+        return "bytewise";
+#endif
+    }
+}
@@ -0,0 +1,41 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_HOST_HDLC_HPP
+#define SNIFFER_HOST_HDLC_HPP
+
+#include "../sniffer_protocol.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace Sniffer
+{
+    // Deframing of the HDLC messages at memory speed: the flags and escape bytes are looked for 16 or 32 bytes at a time
+    // (with SSE2 or AVX2 on x86, with NEON on ARM) and the bytes in between are copied at once. Other cpus and compilers
+    // use the loop that looks at a byte at a time, which is also kept for comparison in the benchmark.
+    class HostHdlc
+    {
+    public:
+        // Position of the first HDLC_FLAG or HDLC_ESCAPE byte, or the length when there is none
+        static size_t find(const uint8_t* data, size_t length);
+
+        // Add the unescaped bytes in front of the first flag to the output and return how many bytes were used (without
+        // the flag), which is the length when there was no flag. An escape byte at the end of the data is remembered in
+        // escaping, so that a message can be decoded in the parts in which it arrives.
+        static size_t decode(const uint8_t* data, size_t length, std::vector<uint8_t>& output, bool& escaping);
+
+        // Byte at a time versions
+        static size_t findBytewise(const uint8_t* data, size_t length);
+        static size_t decodeBytewise(const uint8_t* data, size_t length, std::vector<uint8_t>& output, bool& escaping);
+
+        // Instruction set that find uses on this cpu, for the benchmark
+        static const char* getKernelName();
+    };
+}
+
+#endif // SNIFFER_HOST_HDLC_HPP
@@ -0,0 +1,690 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_host_lowpan.hpp"
+
+#include <cstring>
+
+// Dispatch values of RFC 4944 and RFC 6282
+#define LOWPAN_DISPATCH_IPV6        0x41
+#define LOWPAN_DISPATCH_BC0         0x50
+#define LOWPAN_DISPATCH_IPHC        0x60    // 011xxxxx
+#define LOWPAN_DISPATCH_MESH        0x80    // 10xxxxxx
+#define LOWPAN_DISPATCH_FRAG1       0xC0    // 11000xxx
+#define LOWPAN_DISPATCH_FRAGN       0xE0    // 11100xxx
+#define LOWPAN_NHC_EXTENSION        0xE0    // 1110xxxx
+#define LOWPAN_NHC_UDP              0xF0    // 11110xxx
+
+#define IPV6_HEADER_LEN             40
+#define UDP_HEADER_LEN              8
+#define IPV6_NEXT_HEADER_UDP        17
+#define IPV6_NEXT_HEADER_IPV6       41
+#define LOWPAN_MAX_NESTING          2       // IPv6 headers in IPv6 headers, as RPL adds them on the way to the root
+
+namespace Sniffer
+{
+    namespace
+    {
+        // Next header value of every extension header ID of the NHC, 0xff for the reserved ones and IPv6 itself
+        const uint8_t extensionHeaders[8] = {0, 43, 44, 60, 135, 0xff, 0xff, 0xff};
+
+        void writeUint16(std::vector<uint8_t>& data, size_t pos, uint16_t value)
+        {
+            data[pos] = static_cast<uint8_t>(value >> 8);
+            data[pos + 1] = static_cast<uint8_t>(value & 0xff);
+        }
+
+        uint32_t checksumAdd(uint32_t sum, const uint8_t* data, size_t length)
+        {
+            for (size_t i = 0; i + 1 < length; i += 2)
+                sum += (static_cast<uint32_t>(data[i]) << 8) | data[i + 1];
+            if (length % 2)
+                sum += static_cast<uint32_t>(data[length - 1]) << 8;
+            return sum;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool HostLowpan::LinkAddress::operator==(const LinkAddress& other) const
+    {
+        return (mode == other.mode) && (std::memcmp(bytes, other.bytes, (mode == 3) ? 8 : 2) == 0);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    HostLowpan::HostLowpan(size_t maxDatagrams, int64_t timeout) :
+        m_maxDatagrams(maxDatagrams > 0 ? maxDatagrams : 1),
+        m_timeout(timeout)
+    {
+        std::memset(m_contexts, 0, sizeof(m_contexts));
+        std::memset(m_counters, 0, sizeof(m_counters));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void HostLowpan::setContext(unsigned int id, const uint8_t* prefix, unsigned int prefixLength)
+    {
+        if ((id >= LOWPAN_CONTEXTS) || (prefixLength > 128))
+            return;
+
+        // The bits behind the prefix are zero, so that the first 64 bits can be copied as they are
+        Context& context = m_contexts[id];
+        std::memset(context.prefix, 0, sizeof(context.prefix));
+        std::memcpy(context.prefix, prefix, (prefixLength + 7) / 8);
+        if (prefixLength % 8)
+            context.prefix[prefixLength / 8] &= static_cast<uint8_t>(0xff << (8 - prefixLength % 8));
+        context.prefixLength = prefixLength;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void HostLowpan::feed(const uint8_t* frame, size_t length, int64_t timestamp)
+    {
+        expire(timestamp);
+
+        size_t pos;
+        LinkAddress source;
+        LinkAddress destination;
+        if (!parseMacHeader(frame, length, pos, source, destination))
+            return;
+
+        while (pos < length)
+        {
+            const uint8_t dispatch = frame[pos];
+            if ((dispatch & 0xC0) == LOWPAN_DISPATCH_MESH)
+            {
+                // The originator and final destination take the place of the addresses of the hop
+                const size_t sourceLength = (dispatch & 0x20) ? 2 : 8;
+                const size_t destinationLength = (dispatch & 0x10) ? 2 : 8;
+                const size_t headerLength = 1 + (((dispatch & 0x0f) == 0x0f) ? 1 : 0) + sourceLength + destinationLength;
+                if (pos + headerLength > length)
+                {
+                    m_counters[LowpanCounter::Invalid]++;
+                    return;
+                }
+
+                pos += headerLength - sourceLength - destinationLength;
+                source.mode = (sourceLength == 2) ? 2 : 3;
+                std::memcpy(source.bytes, frame + pos, sourceLength);
+                destination.mode = (destinationLength == 2) ? 2 : 3;
+                std::memcpy(destination.bytes, frame + pos + sourceLength, destinationLength);
+                pos += sourceLength + destinationLength;
+            }
+            else if (dispatch == LOWPAN_DISPATCH_BC0)
+                pos += 2;
+            else if (((dispatch & 0xF8) == LOWPAN_DISPATCH_FRAG1) || ((dispatch & 0xF8) == LOWPAN_DISPATCH_FRAGN))
+            {
+                receivedFragment(frame, length, pos, source, destination, timestamp);
+                return;
+            }
+            else if ((dispatch == LOWPAN_DISPATCH_IPV6) || ((dispatch & 0xE0) == LOWPAN_DISPATCH_IPHC))
+            {
+                std::vector<uint8_t> packet;
+                std::vector<Patch> patches;
+                if (!decompress(frame, length, pos, source, destination, packet, patches))
+                {
+                    m_counters[LowpanCounter::Invalid]++;
+                    return;
+                }
+
+                packet.insert(packet.end(), frame + pos, frame + length);
+                finishPacket(packet, patches, timestamp);
+                return;
+            }
+            else // Not a 6LoWPAN frame (NALP) or a dispatch that isn't supported
+                return;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool HostLowpan::nextPacket(const uint8_t** data, size_t* length, int64_t* timestamp)
+    {
+        if (m_packets.empty())
+            return false;
+
+        m_currentPacket = std::move(m_packets.front());
+        m_packets.pop_front();
+
+        *data = m_currentPacket.second.data();
+        *length = m_currentPacket.second.size();
+        *timestamp = m_currentPacket.first;
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    unsigned int HostLowpan::getCounter(int counter) const
+    {
+        if ((counter < 0) || (counter >= LowpanCounter::Count))
+            return 0;
+
+        return m_counters[counter];
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool HostLowpan::parseMacHeader(const uint8_t* frame, size_t length, size_t& pos, LinkAddress& source, LinkAddress& destination) const
+    {
+        // Only data frames of the 2003 and 2006 versions of 802.15.4 without security, the payload of the others is either
+        // encrypted or behind information elements
+        if (length < 3)
+            return false;
+
+        const uint16_t frameControl = frame[0] | (frame[1] << 8);
+        const uint8_t frameType = frameControl & 0x07;
+        const bool securityEnabled = (frameControl >> 3) & 0x01;
+        const bool panIdCompression = (frameControl >> 6) & 0x01;
+        const uint8_t dstAddrMode = (frameControl >> 10) & 0x03;
+        const uint8_t frameVersion = (frameControl >> 12) & 0x03;
+        const uint8_t srcAddrMode = (frameControl >> 14) & 0x03;
+        if ((frameType != 1) || securityEnabled || (frameVersion > 1) || (dstAddrMode == 1) || (srcAddrMode == 1))
+            return false;
+
+        pos = 3;
+        destination.mode = dstAddrMode;
+        source.mode = srcAddrMode;
+        if (dstAddrMode != 0)
+        {
+            const size_t addrLength = (dstAddrMode == 2) ? 2 : 8;
+            if (pos + 2 + addrLength > length)
+                return false;
+
+            for (size_t i = 0; i < addrLength; ++i)
+                destination.bytes[i] = frame[pos + 2 + addrLength - 1 - i];
+            pos += 2 + addrLength;
+        }
+        if (srcAddrMode != 0)
+        {
+            const size_t addrLength = (srcAddrMode == 2) ? 2 : 8;
+            const size_t panLength = panIdCompression ? 0 : 2;
+            if (pos + panLength + addrLength > length)
+                return false;
+
+            for (size_t i = 0; i < addrLength; ++i)
+                source.bytes[i] = frame[pos + panLength + addrLength - 1 - i];
+            pos += panLength + addrLength;
+        }
+
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void HostLowpan::receivedFragment(const uint8_t* frame, size_t length, size_t pos, const LinkAddress& source,
+                                      const LinkAddress& destination, int64_t timestamp)
+    {
+        const bool first = (frame[pos] & 0xF8) == LOWPAN_DISPATCH_FRAG1;
+        const size_t headerLength = first ? 4 : 5;
+        if (pos + headerLength > length)
+        {
+            m_counters[LowpanCounter::Invalid]++;
+            return;
+        }
+
+        const uint16_t size = ((frame[pos] & 0x07) << 8) | frame[pos + 1];
+        const uint16_t tag = (frame[pos + 2] << 8) | frame[pos + 3];
+        const size_t offset = first ? 0 : frame[pos + 4] * 8;
+        pos += headerLength;
+        if (size < IPV6_HEADER_LEN)
+        {
+            m_counters[LowpanCounter::Invalid]++;
+            return;
+        }
+
+        // A datagram is known by the addresses, its size and its tag
+        auto it = m_datagrams.begin();
+        while ((it != m_datagrams.end())
+            && !((it->source == source) && (it->destination == destination) && (it->size == size) && (it->tag == tag)))
+            ++it;
+
+        if (it == m_datagrams.end())
+        {
+            if (m_datagrams.size() >= m_maxDatagrams)
+            {
+                m_datagrams.pop_front();
+                m_counters[LowpanCounter::Evicted]++;
+            }
+
+            m_datagrams.emplace_back();
+            it = m_datagrams.end() - 1;
+            it->source = source;
+            it->destination = destination;
+            it->size = size;
+            it->tag = tag;
+            it->firstTimestamp = timestamp;
+            it->data.resize(size);
+        }
+
+        // The offsets count in the uncompressed datagram, so the first fragment is decompressed before it is placed
+        std::vector<uint8_t> fragment;
+        if (first)
+        {
+            it->patches.clear();
+            if (!decompress(frame, length, pos, source, destination, fragment, it->patches))
+            {
+                m_datagrams.erase(it);
+                m_counters[LowpanCounter::Invalid]++;
+                return;
+            }
+        }
+        fragment.insert(fragment.end(), frame + pos, frame + length);
+
+        if (offset + fragment.size() > size)
+        {
+            m_datagrams.erase(it);
+            m_counters[LowpanCounter::Invalid]++;
+            return;
+        }
+
+        if (!fragment.empty())
+            std::memcpy(it->data.data() + offset, fragment.data(), fragment.size());
+        for (size_t unit = offset / 8; unit < (offset + fragment.size() + 7) / 8; ++unit)
+            it->received.set(unit);
+
+        for (size_t unit = 0; unit < (size + 7u) / 8; ++unit)
+        {
+            if (!it->received.test(unit))
+                return;
+        }
+
+        std::vector<uint8_t> packet = std::move(it->data);
+        const std::vector<Patch> patches = std::move(it->patches);
+        m_datagrams.erase(it);
+        m_counters[LowpanCounter::Reassembled]++;
+        finishPacket(packet, patches, timestamp);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool HostLowpan::decompress(const uint8_t* data, size_t length, size_t& pos, const LinkAddress& source,
+                                const LinkAddress& destination, std::vector<uint8_t>& output, std::vector<Patch>& patches) const
+    {
+        if (pos >= length)
+            return false;
+
+        // An uncompressed IPv6 header is simply behind the dispatch byte
+        if (data[pos] == LOWPAN_DISPATCH_IPV6)
+        {
+            pos++;
+            return true;
+        }
+        if ((data[pos] & 0xE0) == LOWPAN_DISPATCH_IPHC)
+            return decompressIphc(data, length, pos, source, destination, output, patches, 0);
+
+        return false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool HostLowpan::decompressIphc(const uint8_t* data, size_t length, size_t& pos, const LinkAddress& source,
+                                    const LinkAddress& destination, std::vector<uint8_t>& output, std::vector<Patch>& patches,
+                                    unsigned int depth) const
+    {
+        if ((depth > LOWPAN_MAX_NESTING) || (pos + 2 > length) || ((data[pos] & 0xE0) != LOWPAN_DISPATCH_IPHC))
+            return false;
+
+        const uint8_t trafficFlow = (data[pos] >> 3) & 0x03;
+        const bool nextHeaderCompressed = (data[pos] >> 2) & 0x01;
+        const uint8_t hopLimitMode = data[pos] & 0x03;
+        const bool contextIdentifier = (data[pos + 1] >> 7) & 0x01;
+        const bool sourceStateful = (data[pos + 1] >> 6) & 0x01;
+        const uint8_t sourceMode = (data[pos + 1] >> 4) & 0x03;
+        const bool multicast = (data[pos + 1] >> 3) & 0x01;
+        const bool destinationStateful = (data[pos + 1] >> 2) & 0x01;
+        const uint8_t destinationMode = data[pos + 1] & 0x03;
+        pos += 2;
+
+        unsigned int sourceContext = 0;
+        unsigned int destinationContext = 0;
+        if (contextIdentifier)
+        {
+            if (pos + 1 > length)
+                return false;
+            sourceContext = data[pos] >> 4;
+            destinationContext = data[pos] & 0x0f;
+            pos++;
+        }
+
+        // The ECN bits come in front of the DSCP, unlike in the traffic class of IPv6
+        const size_t trafficFlowLengths[4] = {4, 3, 1, 0};
+        if (pos + trafficFlowLengths[trafficFlow] > length)
+            return false;
+
+        uint8_t ecn = 0;
+        uint8_t dscp = 0;
+        uint32_t flowLabel = 0;
+        if (trafficFlow != 3)
+            ecn = data[pos] >> 6;
+        if ((trafficFlow == 0) || (trafficFlow == 2))
+            dscp = data[pos] & 0x3f;
+        if (trafficFlow == 0)
+            flowLabel = ((data[pos + 1] & 0x0f) << 16) | (data[pos + 2] << 8) | data[pos + 3];
+        else if (trafficFlow == 1)
+            flowLabel = ((data[pos] & 0x0f) << 16) | (data[pos + 1] << 8) | data[pos + 2];
+        pos += trafficFlowLengths[trafficFlow];
+
+        uint8_t header[IPV6_HEADER_LEN] = {};
+        const uint8_t trafficClass = static_cast<uint8_t>((dscp << 2) | ecn);
+        header[0] = 0x60 | (trafficClass >> 4);
+        header[1] = static_cast<uint8_t>((trafficClass << 4) | ((flowLabel >> 16) & 0x0f));
+        header[2] = (flowLabel >> 8) & 0xff;
+        header[3] = flowLabel & 0xff;
+
+        if (!nextHeaderCompressed)
+        {
+            if (pos + 1 > length)
+                return false;
+            header[6] = data[pos++];
+        }
+
+        if (hopLimitMode == 0)
+        {
+            if (pos + 1 > length)
+                return false;
+            header[7] = data[pos++];
+        }
+        else
+            header[7] = (hopLimitMode == 1) ? 1 : ((hopLimitMode == 2) ? 64 : 255);
+
+        if (!decompressAddress(data, length, pos, sourceStateful, sourceMode, sourceContext, source, header + 8))
+            return false;
+
+        if (multicast)
+        {
+            if (!decompressMulticast(data, length, pos, destinationStateful, destinationMode, destinationContext, header + 24))
+                return false;
+        }
+        else
+        {
+            // Only the source can be the unspecified address
+            if ((destinationStateful && (destinationMode == 0))
+             || !decompressAddress(data, length, pos, destinationStateful, destinationMode, destinationContext, destination, header + 24))
+                return false;
+        }
+
+        const size_t ipv6Offset = output.size();
+        output.insert(output.end(), header, header + IPV6_HEADER_LEN);
+        patches.push_back({Patch::PayloadLength, ipv6Offset, ipv6Offset});
+        if (!nextHeaderCompressed)
+            return true;
+
+        // The compressed next headers, where each one can say that the one behind it is compressed as well
+        size_t nextHeaderPos = ipv6Offset + 6;
+        while (pos < length)
+        {
+            const uint8_t nhc = data[pos];
+            if ((nhc & 0xF8) == LOWPAN_NHC_UDP)
+            {
+                const size_t portLengths[4] = {4, 3, 3, 1};
+                const bool checksumElided = (nhc >> 2) & 0x01;
+                pos++;
+                if (pos + portLengths[nhc & 0x03] + (checksumElided ? 0 : 2) > length)
+                    return false;
+
+                uint16_t sourcePort;
+                uint16_t destinationPort;
+                switch (nhc & 0x03)
+                {
+                case 0:
+                    sourcePort = (data[pos] << 8) | data[pos + 1];
+                    destinationPort = (data[pos + 2] << 8) | data[pos + 3];
+                    break;
+                case 1:
+                    sourcePort = (data[pos] << 8) | data[pos + 1];
+                    destinationPort = 0xF000 | data[pos + 2];
+                    break;
+                case 2:
+                    sourcePort = 0xF000 | data[pos];
+                    destinationPort = (data[pos + 1] << 8) | data[pos + 2];
+                    break;
+                default:
+                    sourcePort = 0xF0B0 | (data[pos] >> 4);
+                    destinationPort = 0xF0B0 | (data[pos] & 0x0f);
+                    break;
+                }
+                pos += portLengths[nhc & 0x03];
+
+                output[nextHeaderPos] = IPV6_NEXT_HEADER_UDP;
+                const size_t udpOffset = output.size();
+                output.resize(udpOffset + UDP_HEADER_LEN);
+                writeUint16(output, udpOffset, sourcePort);
+                writeUint16(output, udpOffset + 2, destinationPort);
+                patches.push_back({Patch::UdpLength, udpOffset, ipv6Offset});
+                if (checksumElided)
+                    patches.push_back({Patch::UdpChecksum, udpOffset, ipv6Offset});
+                else
+                {
+                    output[udpOffset + 6] = data[pos];
+                    output[udpOffset + 7] = data[pos + 1];
+                    pos += 2;
+                }
+                return true;
+            }
+            else if ((nhc & 0xF0) == LOWPAN_NHC_EXTENSION)
+            {
+                const uint8_t extensionId = (nhc >> 1) & 0x07;
+                const bool nextCompressed = nhc & 0x01;
+                pos++;
+                if (extensionId == 7)
+                {
+                    output[nextHeaderPos] = IPV6_NEXT_HEADER_IPV6;
+                    return decompressIphc(data, length, pos, source, destination, output, patches, depth + 1);
+                }
+                if (extensionHeaders[extensionId] == 0xff)
+                    return false;
+
+                output[nextHeaderPos] = extensionHeaders[extensionId];
+                uint8_t nextHeader = 0;
+                if (!nextCompressed)
+                {
+                    if (pos + 1 > length)
+                        return false;
+                    nextHeader = data[pos++];
+                }
+                if ((pos + 1 > length) || (pos + 1 + data[pos] > length))
+                    return false;
+
+                // The padding of the options was left out and is added again as a Pad1 or PadN option
+                const size_t headerLength = data[pos];
+                const size_t extensionOffset = output.size();
+                output.push_back(nextHeader);
+                output.push_back(0);
+                output.insert(output.end(), data + pos + 1, data + pos + 1 + headerLength);
+                pos += 1 + headerLength;
+
+                const size_t padding = (8 - (2 + headerLength) % 8) % 8;
+                if ((padding == 1) || ((padding > 1) && (extensionId != 0) && (extensionId != 3)))
+                    output.insert(output.end(), padding, 0);
+                else if (padding > 1)
+                {
+                    output.push_back(1);
+                    output.push_back(static_cast<uint8_t>(padding - 2));
+                    output.insert(output.end(), padding - 2, 0);
+                }
+
+                // The length field of the fragment header is reserved
+                if (extensionHeaders[extensionId] != 44)
+                    output[extensionOffset + 1] = static_cast<uint8_t>((output.size() - extensionOffset) / 8 - 1);
+
+                if (!nextCompressed)
+                    return true;
+                nextHeaderPos = extensionOffset;
+            }
+            else
+                return false;
+        }
+
+        return false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool HostLowpan::decompressAddress(const uint8_t* data, size_t length, size_t& pos, bool stateful, uint8_t mode,
+                                       unsigned int contextId, const LinkAddress& link, uint8_t* address) const
+    {
+        const size_t inlineLengths[4] = {16, 8, 2, 0};
+        std::memset(address, 0, 16);
+        if (stateful && (mode == 0))
+            return true; // The unspecified address
+        if (pos + inlineLengths[mode] > length)
+            return false;
+
+        if (mode == 0)
+        {
+            std::memcpy(address, data + pos, 16);
+            pos += 16;
+            return true;
+        }
+
+        const Context& context = m_contexts[contextId];
+        if (stateful)
+            std::memcpy(address, context.prefix, 8);
+        else
+        {
+            address[0] = 0xfe;
+            address[1] = 0x80;
+        }
+
+        if (mode == 1)
+            std::memcpy(address + 8, data + pos, 8);
+        else if (mode == 2)
+        {
+            address[11] = 0xff;
+            address[12] = 0xfe;
+            address[14] = data[pos];
+            address[15] = data[pos + 1];
+        }
+        else if (link.mode == 3) // The interface identifier with the universal/local bit inverted
+        {
+            std::memcpy(address + 8, link.bytes, 8);
+            address[8] ^= 0x02;
+        }
+        else if (link.mode == 2)
+        {
+            address[11] = 0xff;
+            address[12] = 0xfe;
+            address[14] = link.bytes[0];
+            address[15] = link.bytes[1];
+        }
+        else
+            return false;
+        pos += inlineLengths[mode];
+
+        // A prefix that is longer than 64 bits replaces the start of the interface identifier
+        if (stateful)
+        {
+            for (unsigned int bit = 64; bit < context.prefixLength; ++bit)
+            {
+                const uint8_t mask = static_cast<uint8_t>(0x80 >> (bit % 8));
+                address[bit / 8] = (address[bit / 8] & ~mask) | (context.prefix[bit / 8] & mask);
+            }
+        }
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool HostLowpan::decompressMulticast(const uint8_t* data, size_t length, size_t& pos, bool stateful, uint8_t mode,
+                                         unsigned int contextId, uint8_t* address) const
+    {
+        const size_t inlineLengths[4] = {16, 6, 4, 1};
+        std::memset(address, 0, 16);
+        if ((stateful && (mode != 0)) || (pos + (stateful ? 6 : inlineLengths[mode]) > length))
+            return false;
+
+        address[0] = 0xff;
+        if (stateful) // ffXX:XXLL:PPPP:PPPP:PPPP:PPPP:XXXX:XXXX, an address based on a unicast prefix
+        {
+            const Context& context = m_contexts[contextId];
+            address[1] = data[pos];
+            address[2] = data[pos + 1];
+            address[3] = static_cast<uint8_t>(context.prefixLength < 64 ? context.prefixLength : 64);
+            std::memcpy(address + 4, context.prefix, 8);
+            std::memcpy(address + 12, data + pos + 2, 4);
+            pos += 6;
+            return true;
+        }
+
+        switch (mode)
+        {
+        case 0:
+            std::memcpy(address, data + pos, 16);
+            break;
+        case 1: // ffXX::00XX:XXXX:XXXX
+            address[1] = data[pos];
+            std::memcpy(address + 11, data + pos + 1, 5);
+            break;
+        case 2: // ffXX::00XX:XXXX
+            address[1] = data[pos];
+            std::memcpy(address + 13, data + pos + 1, 3);
+            break;
+        default: // ff02::00XX
+            address[1] = 0x02;
+            address[15] = data[pos];
+            break;
+        }
+        pos += inlineLengths[mode];
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void HostLowpan::finishPacket(std::vector<uint8_t>& packet, const std::vector<Patch>& patches, int64_t timestamp)
+    {
+        // The lengths that were elided follow from the size of the datagram, the checksum needs them
+        for (const Patch& patch : patches)
+        {
+            const size_t headerLength = (patch.type == Patch::PayloadLength) ? IPV6_HEADER_LEN : UDP_HEADER_LEN;
+            if ((packet.size() < patch.offset + headerLength) || (packet.size() - patch.offset > 0xffff))
+            {
+                m_counters[LowpanCounter::Invalid]++;
+                return;
+            }
+
+            if (patch.type == Patch::PayloadLength)
+                writeUint16(packet, patch.offset + 4, static_cast<uint16_t>(packet.size() - patch.offset - IPV6_HEADER_LEN));
+            else if (patch.type == Patch::UdpLength)
+                writeUint16(packet, patch.offset + 4, static_cast<uint16_t>(packet.size() - patch.offset));
+            else
+            {
+                // Pseudo header of the addresses, the upper layer length and the next header
+                const uint32_t udpLength = static_cast<uint32_t>(packet.size() - patch.offset);
+                uint32_t sum = checksumAdd(0, packet.data() + patch.ipv6Offset + 8, 32);
+                sum += udpLength + IPV6_NEXT_HEADER_UDP;
+                writeUint16(packet, patch.offset + 6, 0);
+                sum = checksumAdd(sum, packet.data() + patch.offset, udpLength);
+                while (sum >> 16)
+                    sum = (sum & 0xffff) + (sum >> 16);
+
+                const uint16_t checksum = static_cast<uint16_t>(~sum);
+                writeUint16(packet, patch.offset + 6, (checksum != 0) ? checksum : 0xffff);
+            }
+        }
+
+        m_packets.emplace_back(timestamp, std::move(packet));
+        m_counters[LowpanCounter::Packets]++;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void HostLowpan::expire(int64_t timestamp)
+    {
+        // The frames of several OpenMotes don't always arrive in the order of their timestamps, so all datagrams are checked
+        for (auto it = m_datagrams.begin(); it != m_datagrams.end();)
+        {
+            if (timestamp - it->firstTimestamp > m_timeout)
+            {
+                it = m_datagrams.erase(it);
+                m_counters[LowpanCounter::TimedOut]++;
+            }
+            else
+                ++it;
+        }
+    }
+}
@@ -0,0 +1,123 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_HOST_LOWPAN_HPP
+#define SNIFFER_HOST_LOWPAN_HPP
+
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#define LOWPAN_MAX_DATAGRAM_SIZE    2047        // The datagram size of a fragment header has 11 bits
+#define LOWPAN_DEFAULT_DATAGRAMS    16          // Datagrams that are reassembled at the same time by default
+#define LOWPAN_DEFAULT_TIMEOUT      60000000    // Microseconds after which an incomplete datagram is dropped (RFC 4944)
+#define LOWPAN_CONTEXTS             16          // Contexts of stateful address compression, the CID has 4 bits
+
+namespace Sniffer
+{
+    namespace LowpanCounter
+    {
+        enum LowpanCounters
+        {
+            Packets = 0,      // IPv6 packets that were given out, reassembled or not
+            Reassembled = 1,  // Of which were in several fragments
+            TimedOut = 2,     // Datagrams of which fragments were still missing after the timeout
+            Evicted = 3,      // Datagrams that were dropped to make room for a new one
+            Invalid = 4,      // Frames with a 6LoWPAN header that couldn't be decoded, or fragments that didn't fit
+            Count = 5
+        };
+    }
+
+    // Turns the 6LoWPAN frames of the capture back into the IPv6 packets that they carry, while the frames arrive: the
+    // fragments (RFC 4944) of a datagram are collected until it is complete and the IPHC and NHC headers (RFC 6282) are
+    // decompressed, so that tools at the IPv6, UDP or CoAP level don't have to do it again. Only a limited number of
+    // datagrams is reassembled at a time, the oldest is dropped when a new one doesn't fit, and a datagram of which a
+    // fragment is missing is dropped after the timeout in capture time.
+    class HostLowpan
+    {
+    public:
+        HostLowpan(size_t maxDatagrams, int64_t timeout);
+
+        // Prefix of a context for stateful compression, which the routers announce in the 6LoWPAN context option of their
+        // router advertisements. Addresses of an unknown context get a prefix of zeros.
+        void setContext(unsigned int id, const uint8_t* prefix, unsigned int prefixLength);
+
+        // Decode a received 802.15.4 frame without its FCS, the timestamp is in microseconds. Frames that carry no
+        // 6LoWPAN, or that are encrypted, are ignored.
+        void feed(const uint8_t* frame, size_t length, int64_t timestamp);
+
+        // Take the next IPv6 packet, returns false when there is none. The data stays valid until the next call.
+        bool nextPacket(const uint8_t** data, size_t* length, int64_t* timestamp);
+
+        // One of the LowpanCounter values
+        unsigned int getCounter(int counter) const;
+
+    private:
+        struct LinkAddress
+        {
+            uint8_t mode;        // 2 for a short address, 3 for an extended one, as in the frame control field
+            uint8_t bytes[8];    // In the order of the IPv6 address, not of the frame
+
+            bool operator==(const LinkAddress& other) const;
+        };
+
+        // Fields that still have to be calculated when the whole datagram is known
+        struct Patch
+        {
+            enum Type { PayloadLength, UdpLength, UdpChecksum };
+            Type type;
+            size_t offset;       // Of the header that is patched
+            size_t ipv6Offset;   // Of the IPv6 header in front of the UDP header, for the checksum
+        };
+
+        struct Datagram
+        {
+            LinkAddress source;
+            LinkAddress destination;
+            uint16_t size;
+            uint16_t tag;
+            int64_t firstTimestamp;
+            std::vector<uint8_t> data;
+            std::bitset<(LOWPAN_MAX_DATAGRAM_SIZE + 7) / 8> received;  // Every 8 bytes that a fragment filled
+            std::vector<Patch> patches;
+        };
+
+        struct Context
+        {
+            uint8_t prefix[16];
+            unsigned int prefixLength;
+        };
+
+        bool parseMacHeader(const uint8_t* frame, size_t length, size_t& pos, LinkAddress& source, LinkAddress& destination) const;
+        void receivedFragment(const uint8_t* frame, size_t length, size_t pos, const LinkAddress& source,
+                              const LinkAddress& destination, int64_t timestamp);
+        bool decompress(const uint8_t* data, size_t length, size_t& pos, const LinkAddress& source,
+                        const LinkAddress& destination, std::vector<uint8_t>& output, std::vector<Patch>& patches) const;
+        bool decompressIphc(const uint8_t* data, size_t length, size_t& pos, const LinkAddress& source,
+                            const LinkAddress& destination, std::vector<uint8_t>& output, std::vector<Patch>& patches,
+                            unsigned int depth) const;
+        bool decompressAddress(const uint8_t* data, size_t length, size_t& pos, bool stateful, uint8_t mode,
+                               unsigned int contextId, const LinkAddress& link, uint8_t* address) const;
+        bool decompressMulticast(const uint8_t* data, size_t length, size_t& pos, bool stateful, uint8_t mode,
+                                 unsigned int contextId, uint8_t* address) const;
+        void finishPacket(std::vector<uint8_t>& packet, const std::vector<Patch>& patches, int64_t timestamp);
+        void expire(int64_t timestamp);
+
+    private:
+        size_t m_maxDatagrams;
+        int64_t m_timeout;
+        Context m_contexts[LOWPAN_CONTEXTS];
+        std::deque<Datagram> m_datagrams;  // Oldest first
+        std::deque<std::pair<int64_t, std::vector<uint8_t>>> m_packets;
+        std::pair<int64_t, std::vector<uint8_t>> m_currentPacket;
+        unsigned int m_counters[LowpanCounter::Count];
+    };
+}
+
+#endif // SNIFFER_HOST_LOWPAN_HPP
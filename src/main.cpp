@@ -6,7 +6,34 @@
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 #include "sniffer_serial.hpp"
+#include "sniffer_recovery.hpp"
 #include "sniffer_radio.hpp"
+#include "sniffer_epoch.hpp"
+#include "sniffer_profiling.hpp"
+#include "sniffer_flash_log.hpp"
+#include "sniffer_decryption.hpp"
+#include "sniffer_autostart.hpp"
+#include "sniffer_trace.hpp"
+
+#include "libcc2538_sys_ctrl.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define SERIAL_TASK_STACK_SIZE  128   // Words on the stack of the serial task
+
+// The stack of the serial task isn't taken from the FreeRTOS heap, so that its size is already known when linking
+static StackType_t serialTaskStack[SERIAL_TASK_STACK_SIZE] __attribute__((aligned(portBYTE_ALIGNMENT)));
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#if !configUSE_TICKLESS_IDLE
+// Called by FreeRTOS when the serial task is waiting. The processor sleeps until the next interrupt,
+// all peripherals keep running so nothing is missed.
+extern "C" void vApplicationIdleHook()
+{
+    SysCtrlSleep();
+}
+#endif
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -15,14 +42,32 @@ int main()
     // Enable erasing the flash with the user button
     board.enableFlashErase();
 
-    // Initialize uDMA, radio and UART
+    // Keep the records that survived the reset before anything else could touch the buffer
+    Sniffer::Recovery::initialize();
+
+    // Initialize uDMA, radio, the epochs (from radio noise), UART and the AES engine (which also calculates the hashes),
+    // and find where the flash log ends
+    Sniffer::Profiling::initialize();
     Sniffer::Radio::initialize();
+    Sniffer::Epoch::initialize();
     Sniffer::Serial::initialize();
+    Sniffer::FlashLog::initialize();
+    Sniffer::Decryption::initialize();
+
+    // With a configuration in the flash the radio starts capturing right away, the records wait for a host to attach
+    Sniffer::Autostart::start();
 
     // Create the sole task which will send the received packets to the pc (receiving on radio is done through interrupts)
-    xTaskCreate(Sniffer::Serial::serialTask, "Serial", 128, NULL, tskIDLE_PRIORITY+1, NULL);
+    // The heap is only large enough for the objects that are created at startup (see FreeRTOSConfig.h)
+    TaskHandle_t serialTask;
+    if (xTaskGenericCreate(Sniffer::Serial::serialTask, "Serial", SERIAL_TASK_STACK_SIZE, NULL, tskIDLE_PRIORITY+1, &serialTask, serialTaskStack, NULL) != pdPASS)
+        while (true);
+
+    Sniffer::Trace::setSerialTask(serialTask);
+
+    // The serial task has to come by regularly from now on, otherwise the watchdog resets the OpenMote
+    watchdog.init();
 
-    // Set up interrupts and call our serial task
-    portDISABLE_INTERRUPTS();
-    xPortStartScheduler();
+    // Create the idle task, which runs while the serial task waits, then set up interrupts and call our serial task
+    vTaskStartScheduler();
 }
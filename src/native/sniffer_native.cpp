@@ -0,0 +1,930 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_native.hpp"
+#include "sniffer_serial.hpp"
+#include "sniffer_profiling.hpp"
+
+#include <deque>
+#include <map>
+#include <random>
+#include <vector>
+
+namespace Sniffer
+{
+    // A frame that still has to arrive on the air
+    struct NativeFrame
+    {
+        uint64_t time;
+        uint8_t channel;
+        std::vector<uint8_t> bytes; // Length byte followed by the frame, as the radio puts them in the RX FIFO
+    };
+
+    // Bytes on the serial link, they are handed over together when the last one was send
+    struct NativeChunk
+    {
+        uint64_t time;
+        std::vector<uint8_t> bytes;
+    };
+
+    struct NativeInterrupt
+    {
+        void (*handler)();
+        bool enabled;
+        bool pending;
+        uint8_t priority;
+    };
+
+    uint64_t nativeTime = 0;
+    bool nativeStopped = false;
+    std::mt19937 nativeRandom;
+
+    NativeInterrupt nativeInterrupts[NUM_INTERRUPTS];
+    bool nativeInterruptsMasked = false;
+    uint32_t nativePriorityMask = 0; // BASEPRI, interrupts with a priority value of at least this are masked when not 0
+    bool nativeInInterrupt = false;
+
+    // Registers without side effects keep the value that was last written to them
+    std::map<uintptr_t, uint32_t> nativeRegisters;
+
+    // The radio receives the first frame of the queue in stages: the SFD, the FIFOP threshold and the end of the frame
+    std::deque<NativeFrame> nativeFrames;
+    std::deque<uint8_t> nativeRxFifo;
+    uint8_t nativeRxFirst = 0; // Position in the FIFO memory of the first byte, RXFIRST_PTR
+    uint8_t nativeRadioChannel = 0;
+    bool nativeRxOn = false;
+    uint8_t nativeFrameStage = 0;
+    uint8_t nativeFrameBytesInFifo = 0;
+    uint32_t nativeRfIrqFlags = 0;
+    uint64_t nativeRadioInterruptLatency = 0;
+    uint64_t nativeRadioInterruptTime = NATIVE_TIME_FOREVER; // When the delayed radio interrupt is raised
+    uint64_t nativeSfdTime = 0;
+    uint32_t nativeMissedFrames = 0;
+    NativeHardware::FrameScheduleHandler nativeFrameSchedule = nullptr;
+
+    uint32_t nativeTimerCompare = 0;
+    bool nativeTimerCompareArmed = false;
+
+    volatile tDMAControlTable* nativeDmaTable = nullptr;
+    uint32_t nativeDmaEnabled = 0;
+    uint32_t nativeDmaInterruptStatus = 0;
+
+    // The link keeps track of when it has send the bytes that it was given, in both directions.
+    // Towards the host every lane is a link of its own, the host only sends over the first one.
+    std::deque<NativeChunk> nativeToHost[NATIVE_LANES];
+    std::deque<NativeChunk> nativeToSniffer;
+    uint64_t nativeToHostFree[NATIVE_LANES] = {};
+    uint64_t nativeToSnifferFree = 0;
+    uint64_t nativeTransmitEnd[NATIVE_LANES] = {};
+    bool nativeTransmitNotify[NATIVE_LANES] = {};
+    uint32_t nativeBaudrate = BAUDRATE;
+    double nativeLinkErrorRate = 0;
+    uint64_t nativeBytesToHost = 0;
+    uint64_t nativeBytesToSniffer = 0;
+
+    NativeHardware::HostReceiveHandler nativeHostReceive = nullptr;
+    NativeHardware::HostTimeoutHandler nativeHostTimeout = nullptr;
+    uint64_t nativeHostTimeoutPeriod = 0;
+    uint64_t nativeHostTimeoutTime = NATIVE_TIME_FOREVER;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Nanoseconds that the link needs for the bytes, with 10 bits per byte
+    inline uint64_t nativeLinkDuration(size_t length)
+    {
+        return length * 10000000000ULL / nativeBaudrate;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Copy of the bytes as they come out of the link, some bytes may be lost or have a flipped bit
+    inline std::vector<uint8_t> nativeCorrupt(const std::vector<uint8_t>& bytes)
+    {
+        if (nativeLinkErrorRate <= 0)
+            return bytes;
+
+        std::uniform_real_distribution<double> chance(0, 1);
+        std::vector<uint8_t> result;
+        result.reserve(bytes.size());
+        for (const uint8_t byte : bytes)
+        {
+            if (chance(nativeRandom) >= nativeLinkErrorRate)
+                result.push_back(byte);
+            else if (nativeRandom() & 1)
+                result.push_back(byte ^ (1 << (nativeRandom() % 8)));
+        }
+
+        return result;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Take the pending interrupts that are enabled, the one with the lowest priority value first
+    inline void nativeDispatchInterrupts()
+    {
+        if (nativeInInterrupt || nativeInterruptsMasked)
+            return;
+
+        nativeInInterrupt = true;
+        while (true)
+        {
+            NativeInterrupt* next = nullptr;
+            for (NativeInterrupt& interrupt : nativeInterrupts)
+            {
+                if (interrupt.pending && interrupt.enabled && interrupt.handler
+                 && ((nativePriorityMask == 0) || (interrupt.priority < nativePriorityMask))
+                 && ((next == nullptr) || (interrupt.priority < next->priority)))
+                {
+                    next = &interrupt;
+                }
+            }
+
+            if (next == nullptr)
+                break;
+
+            next->pending = false;
+            next->handler();
+        }
+        nativeInInterrupt = false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void nativeRaiseInterrupt(uint32_t interrupt)
+    {
+        nativeInterrupts[interrupt].pending = true;
+        nativeDispatchInterrupts();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Set flags in RFIRQF0, RFIRQM0 decides whether they lead to an interrupt
+    inline void nativeRadioFlags(uint32_t flags)
+    {
+        nativeRfIrqFlags |= flags;
+        if (flags & nativeRegisters[RFCORE_XREG_RFIRQM0])
+        {
+            // With a latency, the flags of everything that happens in the meantime are handled by the same interrupt
+            if (nativeRadioInterruptLatency == 0)
+                nativeRaiseInterrupt(INT_RFCORERTX);
+            else if (nativeRadioInterruptTime == NATIVE_TIME_FOREVER)
+                nativeRadioInterruptTime = nativeTime + nativeRadioInterruptLatency;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline uint8_t nativeFifopThreshold()
+    {
+        const auto it = nativeRegisters.find(RFCORE_XREG_FIFOPCTRL);
+        return (it != nativeRegisters.end()) ? it->second : NATIVE_FIFOP_DEFAULT;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // The frame that is being received is lost when the RX FIFO is flushed or the radio is turned off
+    inline void nativeAbortFrame()
+    {
+        if (nativeFrameStage == 0)
+            return;
+
+        nativeFrames.pop_front();
+        nativeFrameStage = 0;
+        nativeFrameBytesInFifo = 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline uint64_t nativeRadioEventTime()
+    {
+        if (nativeFrames.empty())
+            return NATIVE_TIME_FOREVER;
+
+        const NativeFrame& frame = nativeFrames.front();
+        if (nativeFrameStage == 0)
+            return frame.time;
+        else if (nativeFrameStage == 1)
+            return frame.time + nativeFifopThreshold() * NATIVE_AIR_BYTE_TIME;
+        else
+            return frame.time + frame.bytes.size() * NATIVE_AIR_BYTE_TIME;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void nativeRadioEvent()
+    {
+        const NativeFrame& frame = nativeFrames.front();
+        if (nativeFrameStage == 0)
+        {
+            if (!nativeRxOn || (frame.channel != nativeRadioChannel) || (nativeRxFifo.size() + frame.bytes.size() > NATIVE_FIFO_SIZE))
+            {
+                nativeMissedFrames++;
+                nativeFrames.pop_front();
+                return;
+            }
+
+            // Long frames reach the FIFOP threshold before they are completely received
+            nativeSfdTime = frame.time;
+            nativeFrameStage = (frame.bytes.size() > nativeFifopThreshold()) ? 1 : 2;
+            nativeRadioFlags(RFCORE_SFR_RFIRQF0_SFD);
+        }
+        else if (nativeFrameStage == 1)
+        {
+            nativeFrameBytesInFifo = nativeFifopThreshold();
+            nativeRxFifo.insert(nativeRxFifo.end(), frame.bytes.begin(), frame.bytes.begin() + nativeFrameBytesInFifo);
+            nativeFrameStage = 2;
+            nativeRadioFlags(RFCORE_SFR_RFIRQF0_FIFOP);
+        }
+        else
+        {
+            nativeRxFifo.insert(nativeRxFifo.end(), frame.bytes.begin() + nativeFrameBytesInFifo, frame.bytes.end());
+            nativeFrames.pop_front();
+            nativeFrameStage = 0;
+            nativeFrameBytesInFifo = 0;
+            nativeRadioFlags(RFCORE_SFR_RFIRQF0_RXPKTDONE | RFCORE_SFR_RFIRQF0_FIFOP);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Moment at which the overflow counter of the MAC timer reaches the compare value
+    inline uint64_t nativeTimerEventTime()
+    {
+        if (!nativeTimerCompareArmed)
+            return NATIVE_TIME_FOREVER;
+
+        const uint64_t overflows = nativeTime / 1024000;
+        const uint32_t delta = (nativeTimerCompare - static_cast<uint32_t>(overflows)) & 0xFFFFFF;
+        return (overflows + ((delta == 0) ? 0x1000000 : delta)) * 1024000;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void nativeTimerEvent()
+    {
+        nativeTimerCompareArmed = false;
+        nativeRegisters[RFCORE_SFR_MTIRQF] |= RFCORE_SFR_MTIRQF_MACTIMER_OVF_COMPARE1F;
+        if (nativeRegisters[RFCORE_SFR_MTIRQM] & RFCORE_SFR_MTIRQM_MACTIMER_OVF_COMPARE1M)
+            nativeRaiseInterrupt(INT_MACTIMR);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Position of the byte of the 24-bit overflow counter that the register holds
+    inline uint32_t nativeOverflowShift(uintptr_t address)
+    {
+        if (address == RFCORE_SFR_MTMOVF2)
+            return 16;
+        else if (address == RFCORE_SFR_MTMOVF1)
+            return 8;
+        else
+            return 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // The MAC timer counts in 1/32 microseconds and overflows every 1024 microseconds, MTMSEL decides what is read
+    inline uint32_t nativeReadTimer(uintptr_t address)
+    {
+        const uint32_t select = nativeRegisters[RFCORE_SFR_MTMSEL];
+        const bool overflowRegister = (address != RFCORE_SFR_MTM0) && (address != RFCORE_SFR_MTM1);
+        const uint32_t source = overflowRegister ? ((select & RFCORE_SFR_MTMSEL_MTMOVFSEL_M) >> RFCORE_SFR_MTMSEL_MTMOVFSEL_S)
+                                                 : ((select & RFCORE_SFR_MTMSEL_MTMSEL_M) >> RFCORE_SFR_MTMSEL_MTMSEL_S);
+
+        uint64_t microseconds;
+        if (source == 0)
+            microseconds = nativeTime / 1000;
+        else if (source == 1)
+            microseconds = nativeSfdTime / 1000;
+        else if (overflowRegister && (source == 3))
+            return (nativeTimerCompare >> nativeOverflowShift(address)) & 0xff;
+        else
+            return nativeRegisters[address];
+
+        const uint32_t ticks = (microseconds % 1024) * 32;
+        const uint32_t overflows = (microseconds / 1024) & 0xFFFFFF;
+        if (address == RFCORE_SFR_MTM0)
+            return ticks & 0xff;
+        else if (address == RFCORE_SFR_MTM1)
+            return ticks >> 8;
+        else
+            return (overflows >> nativeOverflowShift(address)) & 0xff;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void nativeWriteTimer(uintptr_t address, uint32_t value)
+    {
+        const uint32_t select = nativeRegisters[RFCORE_SFR_MTMSEL];
+        if ((select & RFCORE_SFR_MTMSEL_MTMOVFSEL_M) >> RFCORE_SFR_MTMSEL_MTMOVFSEL_S != 3)
+        {
+            nativeRegisters[address] = value;
+            return;
+        }
+
+        // The compare value takes effect when its highest byte is written
+        const uint32_t shift = nativeOverflowShift(address);
+        nativeTimerCompare = (nativeTimerCompare & ~(0xff << shift)) | ((value & 0xff) << shift);
+        if (address == RFCORE_SFR_MTMOVF2)
+            nativeTimerCompareArmed = true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Perform the transfer of a uDMA channel at once, only 8-bit transfers are supported
+    inline void nativeDmaTransfer(uint8_t channel)
+    {
+        volatile tDMAControlTable& entry = nativeDmaTable[channel];
+        const uint32_t control = entry.ui32Control;
+        if ((control & UDMACHCTL_CHCTL_XFERMODE_M) != UDMA_MODE_STOP)
+        {
+            const uint32_t count = ((control & UDMACHCTL_CHCTL_XFERSIZE_M) >> UDMACHCTL_CHCTL_XFERSIZE_S) + 1;
+            const uintptr_t source = reinterpret_cast<uintptr_t>(entry.pvSrcEndAddr);
+            const uintptr_t destination = reinterpret_cast<uintptr_t>(entry.pvDstEndAddr);
+            const bool sourceFixed = ((control & UDMACHCTL_CHCTL_SRCINC_M) == UDMA_SRC_INC_NONE);
+            const bool destinationFixed = ((control & UDMACHCTL_CHCTL_DSTINC_M) == UDMA_DST_INC_NONE);
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                const uint8_t byte = sourceFixed ? NativeRegisters::read(source)
+                                                 : *reinterpret_cast<volatile uint8_t*>(source - (count - 1) + i);
+                if (destinationFixed)
+                    NativeRegisters::write(destination, byte);
+                else
+                    *reinterpret_cast<volatile uint8_t*>(destination - (count - 1) + i) = byte;
+            }
+
+            entry.ui32Control = control & ~(UDMACHCTL_CHCTL_XFERSIZE_M | UDMACHCTL_CHCTL_XFERMODE_M);
+        }
+
+        // A software channel signals that it is done with the uDMA interrupt
+        nativeDmaEnabled &= ~(1 << channel);
+        nativeDmaInterruptStatus |= (1 << channel);
+        nativeRaiseInterrupt(INT_UDMA);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void nativeRadioCommand(uint32_t command)
+    {
+        if (command == CC2538_RF_CSP_OP_ISRXON)
+        {
+            // Restarting a receiver that was already on loses the frame of which the SFD was just found
+            if (nativeRxOn && (nativeFrameStage != 0))
+            {
+                nativeMissedFrames++;
+                nativeAbortFrame();
+            }
+
+            nativeRxOn = true;
+        }
+        else if (command == CC2538_RF_CSP_OP_ISRFOFF)
+        {
+            nativeRxOn = false;
+            nativeAbortFrame();
+        }
+        else if (command == CC2538_RF_CSP_OP_ISFLUSHRX)
+        {
+            nativeRxFifo.clear();
+            nativeRxFirst = 0;
+            nativeAbortFrame();
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // The bytes from the host are stored in the RX buffer, as the uDMA and the UART interrupt do it on the OpenMote
+    inline void nativeDeliverToSniffer()
+    {
+        const std::vector<uint8_t> bytes = nativeCorrupt(nativeToSniffer.front().bytes);
+        nativeToSniffer.pop_front();
+
+        for (const uint8_t byte : bytes)
+        {
+            rxBuffer[rxBufferIndexWrite] = byte;
+            rxBufferIndexWrite = (rxBufferIndexWrite + 1) % SERIAL_RX_BUFFER_LEN;
+        }
+
+        Serial::notifyFromInterrupt();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void nativeDeliverToHost(uint8_t lane)
+    {
+        const std::vector<uint8_t> bytes = nativeCorrupt(nativeToHost[lane].front().bytes);
+        nativeToHost[lane].pop_front();
+
+        nativeHostTimeoutTime = nativeTime + nativeHostTimeoutPeriod;
+        if (nativeHostReceive && !bytes.empty())
+            nativeHostReceive(lane, bytes.data(), bytes.size());
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Lane with the first chunk that reaches the host, or with the first packet of which the transport has to report the end
+    inline uint8_t nativeFirstLane(bool transmitted)
+    {
+        uint8_t first = 0;
+        uint64_t firstTime = NATIVE_TIME_FOREVER;
+        for (uint8_t lane = 0; lane < NATIVE_LANES; ++lane)
+        {
+            uint64_t time;
+            if (transmitted)
+                time = nativeTransmitNotify[lane] ? nativeTransmitEnd[lane] : NATIVE_TIME_FOREVER;
+            else
+                time = nativeToHost[lane].empty() ? NATIVE_TIME_FOREVER : nativeToHost[lane].front().time;
+
+            if (time < firstTime)
+            {
+                first = lane;
+                firstTime = time;
+            }
+        }
+
+        return first;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Handle the first thing that happens, returns false when that is after the given time
+    inline bool nativeProcessEvent(uint64_t until)
+    {
+        const uint64_t toSniffer = nativeToSniffer.empty() ? NATIVE_TIME_FOREVER : nativeToSniffer.front().time;
+        const uint64_t radio = nativeRadioEventTime();
+        const uint8_t transmittedLane = nativeFirstLane(true);
+        const uint8_t toHostLane = nativeFirstLane(false);
+        const uint64_t transmitted = nativeTransmitNotify[transmittedLane] ? nativeTransmitEnd[transmittedLane] : NATIVE_TIME_FOREVER;
+        const uint64_t toHost = nativeToHost[toHostLane].empty() ? NATIVE_TIME_FOREVER : nativeToHost[toHostLane].front().time;
+        const uint64_t timer = nativeTimerEventTime();
+        const uint64_t hostTimeout = nativeHostTimeout ? nativeHostTimeoutTime : NATIVE_TIME_FOREVER;
+        const uint64_t radioInterrupt = nativeRadioInterruptTime;
+
+        uint64_t next = toSniffer;
+        for (const uint64_t time : {radio, transmitted, toHost, timer, hostTimeout, radioInterrupt})
+        {
+            if (time < next)
+                next = time;
+        }
+
+        if ((next == NATIVE_TIME_FOREVER) || (next > until))
+            return false;
+
+        if (next > nativeTime)
+            nativeTime = next;
+
+        if (next == toSniffer)
+            nativeDeliverToSniffer();
+        else if (next == radio)
+        {
+            nativeRadioEvent();
+            if (nativeFrames.empty() && nativeFrameSchedule)
+                nativeFrameSchedule();
+        }
+        else if (next == transmitted)
+        {
+            // Same moment at which the UART interrupt reports that the uDMA handed the last byte to the UART
+            nativeTransmitNotify[transmittedLane] = false;
+            Serial::notifyFromInterrupt();
+        }
+        else if (next == toHost)
+            nativeDeliverToHost(toHostLane);
+        else if (next == timer)
+            nativeTimerEvent();
+        else if (next == radioInterrupt)
+        {
+            nativeRadioInterruptTime = NATIVE_TIME_FOREVER;
+            nativeRaiseInterrupt(INT_RFCORERTX);
+        }
+        else
+        {
+            nativeHostTimeoutTime = nativeTime + nativeHostTimeoutPeriod;
+            nativeHostTimeout();
+        }
+
+        nativeDispatchInterrupts();
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint32_t NativeRegisters::read(uintptr_t address)
+    {
+        switch (address)
+        {
+        case RFCORE_SFR_RFDATA:
+        {
+            if (nativeRxFifo.empty())
+                return 0;
+
+            const uint8_t byte = nativeRxFifo.front();
+            nativeRxFifo.pop_front();
+            nativeRxFirst = (nativeRxFirst + 1) % NATIVE_FIFO_SIZE;
+            return byte;
+        }
+        case RFCORE_XREG_RXFIFOCNT:
+            return nativeRxFifo.size();
+        case RFCORE_XREG_RXFIRST_PTR:
+            return nativeRxFirst;
+        case RFCORE_SFR_RFIRQF0:
+            return nativeRfIrqFlags;
+        case RFCORE_XREG_FSMSTAT1:
+            return (nativeFrameStage != 0) ? RFCORE_XREG_FSMSTAT1_SFD : 0;
+        case RFCORE_XREG_RSSISTAT:
+            return RFCORE_XREG_RSSISTAT_RSSI_VALID;
+        case RFCORE_XREG_RSSI:
+            return static_cast<uint8_t>(-100 + CC2538_RF_RSSI_OFFSET);
+        case RFCORE_SFR_MTM0:
+        case RFCORE_SFR_MTM1:
+        case RFCORE_SFR_MTMOVF0:
+        case RFCORE_SFR_MTMOVF1:
+        case RFCORE_SFR_MTMOVF2:
+            return nativeReadTimer(address);
+        case RFCORE_SFR_MTCTRL:
+            return nativeRegisters[address] | RFCORE_SFR_MTCTRL_STATE;
+        case UDMA_ENASET:
+            return nativeDmaEnabled;
+        case UDMA_CHIS:
+            return nativeDmaInterruptStatus;
+        case DWT_CYCCNT:
+            return static_cast<uint32_t>(nativeTime * 32 / 1000);
+        default:
+            // The RX FIFO memory, in which the firmware can look at the bytes without taking them out
+            if ((address >= RFCORE_RAM_BASE) && (address < RFCORE_RAM_BASE + NATIVE_FIFO_SIZE * 4))
+            {
+                const size_t position = ((address - RFCORE_RAM_BASE) / 4 + NATIVE_FIFO_SIZE - nativeRxFirst) % NATIVE_FIFO_SIZE;
+                return (position < nativeRxFifo.size()) ? nativeRxFifo[position] : 0;
+            }
+
+            return nativeRegisters[address];
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void NativeRegisters::write(uintptr_t address, uint32_t value)
+    {
+        switch (address)
+        {
+        case RFCORE_SFR_RFIRQF0:
+            nativeRfIrqFlags = value;
+            break;
+        case RFCORE_SFR_RFST:
+            nativeRadioCommand(value);
+            break;
+        case RFCORE_SFR_MTMOVF0:
+        case RFCORE_SFR_MTMOVF1:
+        case RFCORE_SFR_MTMOVF2:
+            nativeWriteTimer(address, value);
+            break;
+        case UDMA_ENASET:
+            nativeDmaEnabled |= value;
+            break;
+        case UDMA_ENACLR:
+            nativeDmaEnabled &= ~value;
+            break;
+        case UDMA_SWREQ:
+            for (uint8_t channel = 0; channel < UDMA_CHANNEL_COUNT; ++channel)
+            {
+                if ((value & nativeDmaEnabled) & (1 << channel))
+                    nativeDmaTransfer(channel);
+            }
+            break;
+        case UDMA_CHIS:
+            nativeDmaInterruptStatus &= ~value;
+            break;
+        default:
+            nativeRegisters[address] = value;
+            break;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void NativeHardware::setSeed(uint32_t seed)
+    {
+        nativeRandom.seed(seed);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint64_t NativeHardware::getTime()
+    {
+        return nativeTime;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void NativeHardware::scheduleFrame(uint64_t time, uint8_t channel, const uint8_t* data, uint8_t length)
+    {
+        NativeFrame frame;
+        frame.time = time;
+        frame.channel = channel;
+        frame.bytes.reserve(1 + length);
+        frame.bytes.push_back(length);
+        frame.bytes.insert(frame.bytes.end(), data, data + length);
+
+        // The radio checks the FCS itself and puts the RSSI and the CRC_OK bit in its place
+        if (length >= 2)
+        {
+            frame.bytes[length - 1] = static_cast<uint8_t>(NATIVE_FRAME_RSSI + CC2538_RF_RSSI_OFFSET);
+            frame.bytes[length] = 0x80 | NATIVE_FRAME_LQI;
+        }
+
+        nativeFrames.push_back(frame);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool NativeHardware::hasScheduledFrames()
+    {
+        return !nativeFrames.empty();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void NativeHardware::setFrameScheduleHandler(FrameScheduleHandler handler)
+    {
+        nativeFrameSchedule = handler;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void NativeHardware::setRadioInterruptLatency(uint64_t nanoseconds)
+    {
+        nativeRadioInterruptLatency = nanoseconds;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint32_t NativeHardware::getMissedFrames()
+    {
+        return nativeMissedFrames;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void NativeHardware::setLinkErrorRate(double rate)
+    {
+        nativeLinkErrorRate = rate;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint64_t NativeHardware::getBytesToHost()
+    {
+        return nativeBytesToHost;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint64_t NativeHardware::getBytesToSniffer()
+    {
+        return nativeBytesToSniffer;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void NativeHardware::setHost(HostReceiveHandler receiveHandler, HostTimeoutHandler timeoutHandler, uint64_t timeout)
+    {
+        nativeHostReceive = receiveHandler;
+        nativeHostTimeout = timeoutHandler;
+        nativeHostTimeoutPeriod = timeout;
+        nativeHostTimeoutTime = nativeTime + timeout;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void NativeHardware::sendFromHost(const uint8_t* data, size_t length)
+    {
+        if (length == 0)
+            return;
+
+        const uint64_t start = (nativeToSnifferFree > nativeTime) ? nativeToSnifferFree : nativeTime;
+        nativeToSnifferFree = start + nativeLinkDuration(length);
+        nativeToSniffer.push_back({nativeToSnifferFree, std::vector<uint8_t>(data, data + length)});
+        nativeBytesToSniffer += length;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void NativeHardware::stop()
+    {
+        nativeStopped = true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void NativeHardware::run(uint64_t until, const bool* woken)
+    {
+        while (true)
+        {
+            if (nativeStopped)
+                throw NativeStopped();
+            if (woken && *woken)
+                return;
+
+            if (!nativeProcessEvent(until))
+            {
+                if (until == NATIVE_TIME_FOREVER)
+                    throw NativeStopped();
+
+                if (until > nativeTime)
+                    nativeTime = until;
+                return;
+            }
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void NativeHardware::registerInterrupt(uint32_t interrupt, void (*handler)())
+    {
+        nativeInterrupts[interrupt].handler = handler;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void NativeHardware::enableInterrupt(uint32_t interrupt, bool enable)
+    {
+        nativeInterrupts[interrupt].enabled = enable;
+        if (enable)
+            nativeDispatchInterrupts();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void NativeHardware::setInterruptPending(uint32_t interrupt, bool pending)
+    {
+        if (pending)
+            nativeRaiseInterrupt(interrupt);
+        else
+            nativeInterrupts[interrupt].pending = false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void NativeHardware::setInterruptPriority(uint32_t interrupt, uint8_t priority)
+    {
+        nativeInterrupts[interrupt].priority = priority;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool NativeHardware::setInterruptsMasked(bool masked)
+    {
+        const bool wasMasked = nativeInterruptsMasked;
+        nativeInterruptsMasked = masked;
+        if (!masked)
+            nativeDispatchInterrupts();
+
+        return wasMasked;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void NativeHardware::setInterruptPriorityMask(uint32_t mask)
+    {
+        const uint32_t previousMask = nativePriorityMask;
+        nativePriorityMask = mask;
+        if ((mask == 0) || ((previousMask != 0) && (mask > previousMask)))
+            nativeDispatchInterrupts();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint32_t NativeHardware::getInterruptPriorityMask()
+    {
+        return nativePriorityMask;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void NativeHardware::setDmaControlTable(volatile tDMAControlTable* table)
+    {
+        nativeDmaTable = table;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void NativeHardware::setRadioChannel(uint8_t channel)
+    {
+        nativeRadioChannel = channel;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void NativeTransport::initialize()
+    {
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void NativeTransport::poll()
+    {
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool NativeTransport::isTransmitting()
+    {
+        for (uint8_t lane = 0; lane < NATIVE_LANES; ++lane)
+        {
+            if (nativeTransmitEnd[lane] > nativeTime)
+                NativeHardware::run(nativeTransmitEnd[lane], nullptr);
+        }
+
+        return false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool NativeTransport::isLaneTransmitting(uint8_t lane)
+    {
+        // With a single lane the hardware runs until the packet has left, as for isTransmitting. The lanes of a bonded link
+        // have to keep sending at the same time, so there the serial task waits for the end of the packet instead.
+        if (NATIVE_LANES == 1)
+            return isTransmitting();
+
+        return nativeTransmitEnd[lane] > nativeTime;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void NativeTransport::transmit(uint8_t lane, const uint8_t* data, uint16_t length)
+    {
+        const uint64_t start = (nativeToHostFree[lane] > nativeTime) ? nativeToHostFree[lane] : nativeTime;
+        nativeToHostFree[lane] = start + nativeLinkDuration(length);
+        nativeToHost[lane].push_back({nativeToHostFree[lane], std::vector<uint8_t>(data, data + length)});
+        nativeBytesToHost += length;
+
+        nativeTransmitEnd[lane] = nativeToHostFree[lane];
+        nativeTransmitNotify[lane] = true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void NativeTransport::writeByte(uint8_t byte)
+    {
+        // The bytes that are still in the FIFO of the UART are added to the last chunk on the link
+        // These bytes always go over the first lane.
+        const uint64_t fifoTime = nativeLinkDuration(NATIVE_UART_FIFO_SIZE);
+        if (nativeToHostFree[0] > nativeTime + fifoTime)
+            NativeHardware::run(nativeToHostFree[0] - fifoTime, nullptr);
+
+        const uint64_t start = (nativeToHostFree[0] > nativeTime) ? nativeToHostFree[0] : nativeTime;
+        nativeToHostFree[0] = start + nativeLinkDuration(1);
+        if (nativeToHost[0].empty())
+            nativeToHost[0].push_back({nativeToHostFree[0], std::vector<uint8_t>()});
+
+        nativeToHost[0].back().time = nativeToHostFree[0];
+        nativeToHost[0].back().bytes.push_back(byte);
+        nativeBytesToHost++;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void NativeTransport::flush()
+    {
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint32_t NativeTransport::getDefaultBaudrate()
+    {
+        return BAUDRATE;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool NativeTransport::isBaudrateSupported(uint32_t rate)
+    {
+        return rate >= BAUDRATE;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint32_t NativeTransport::getMaxBaudrate()
+    {
+        return UINT32_MAX;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void NativeTransport::setBaudrate(uint32_t rate)
+    {
+        for (uint8_t lane = 0; lane < NATIVE_LANES; ++lane)
+        {
+            if (nativeToHostFree[lane] > nativeTime)
+                NativeHardware::run(nativeToHostFree[lane], nullptr);
+        }
+
+        nativeBaudrate = rate;
+    }
+}
@@ -0,0 +1,140 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_NATIVE_HPP
+#define SNIFFER_NATIVE_HPP
+
+#include "sniffer_global.hpp"
+
+#include <cstddef>
+
+#define NATIVE_TIME_FOREVER     0xFFFFFFFFFFFFFFFFULL   // Waiting until this time only ends when the serial task is woken up
+#define NATIVE_FIFO_SIZE        128     // Size of the RX FIFO of the radio
+#define NATIVE_FIFOP_DEFAULT    64      // FIFOP threshold of the radio after reset
+#define NATIVE_UART_FIFO_SIZE   16      // Bytes that writeByte can put on the link before it has to wait
+#define NATIVE_AIR_BYTE_TIME    32000   // Nanoseconds that a byte takes on the air at 250 kbit/s
+#define NATIVE_FRAME_RSSI       (-40)   // RSSI of the emulated frames, in dBm
+#define NATIVE_FRAME_LQI        108     // Correlation value of the emulated frames, stored behind the CRC_OK bit
+
+namespace Sniffer
+{
+    // Transport of the native build, the bytes go over the serial link that NativeHardware emulates
+    class NativeTransport
+    {
+    public:
+        // Nothing to set up, the link starts at BAUDRATE
+        static void initialize();
+
+        // Nothing to do, the emulated UART already stores the received bytes in the RX buffer
+        static void poll();
+
+        // Lets the emulated hardware run until the previous packets have left, since the processor is infinitely fast
+        static bool isTransmitting();
+
+        // Check whether the lane is still sending its packet, only waits for it when there is a single lane
+        static bool isLaneTransmitting(uint8_t lane);
+
+        // Put an encoded packet on the link of the lane, Serial::notifyFromInterrupt is called when its last byte was send
+        static void transmit(uint8_t lane, const uint8_t* data, uint16_t length);
+
+        // Put a byte on the link of the first lane, waiting while the emulated UART FIFO is full
+        static void writeByte(uint8_t byte);
+
+        // Nothing to do, every byte was already put on the link
+        static void flush();
+
+        // The baudrate at which the host and the OpenMote start
+        static uint32_t getDefaultBaudrate();
+
+        // Any rate that isn't slower than the default is possible on the emulated link
+        static bool isBaudrateSupported(uint32_t rate);
+
+        // There is no upper limit on the emulated link
+        static uint32_t getMaxBaudrate();
+
+        // Change the rate of the link once the bytes that are being send have left
+        static void setBaudrate(uint32_t rate);
+    };
+
+    // Thrown out of the serial task when it waits after the simulation was stopped, so that the test driver gets control back
+    struct NativeStopped
+    {
+    };
+
+    // The parts of the CC2538 and the OpenBase that the sniffer uses, emulated on the pc: the RX FIFO and the interrupts
+    // of the radio, the uDMA, the MAC timer and the serial link to the host. Time only passes while the firmware waits,
+    // in the semaphore of the serial task or for the link, so the processor is infinitely fast. The interrupts of the
+    // emulated peripherals run at those moments, in order of their priority.
+    class NativeHardware
+    {
+    public:
+        // Functions of the test driver, which plays the role of the host
+        typedef void (*HostReceiveHandler)(uint8_t lane, const uint8_t* data, size_t length);
+        typedef void (*HostTimeoutHandler)();
+        typedef void (*FrameScheduleHandler)();
+
+        // Seed of the errors on the link, which is otherwise deterministic
+        static void setSeed(uint32_t seed);
+
+        // Simulated time in nanoseconds since the OpenMote started
+        static uint64_t getTime();
+
+        // Let a frame arrive on the air with its SFD at the given time. The length includes the FCS, which the radio replaces
+        // by the RSSI and the CRC_OK bit with the correlation value. Frames have to be scheduled in order and may not overlap.
+        static void scheduleFrame(uint64_t time, uint8_t channel, const uint8_t* data, uint8_t length);
+
+        // Check whether frames are still waiting to be received
+        static bool hasScheduledFrames();
+
+        // Called when the last scheduled frame went by, so that the test driver doesn't have to schedule all frames at once
+        static void setFrameScheduleHandler(FrameScheduleHandler handler);
+
+        // Delay between setting a radio interrupt flag and the interrupt being handled, so that several frames can be
+        // waiting in the RX FIFO when the firmware gets to them (0 by default)
+        static void setRadioInterruptLatency(uint64_t nanoseconds);
+
+        // Frames that didn't reach the RX FIFO because the radio was off, on another channel or its FIFO was full
+        static uint32_t getMissedFrames();
+
+        // Probability that a byte on the link is lost or has a flipped bit, in both directions
+        static void setLinkErrorRate(double rate);
+
+        // Bytes that were put on the link in each direction, including the corrupted ones (on all lanes together)
+        static uint64_t getBytesToHost();
+        static uint64_t getBytesToSniffer();
+
+        // Connect the test driver, the timeout handler is called every time nothing was received for the given time
+        static void setHost(HostReceiveHandler receiveHandler, HostTimeoutHandler timeoutHandler, uint64_t timeout);
+
+        // Send bytes from the host to the sniffer, they end up in the RX buffer at the rate of the link
+        static void sendFromHost(const uint8_t* data, size_t length);
+
+        // Let the serial task throw NativeStopped the next time that it waits
+        static void stop();
+
+        // Run the emulated hardware until the given time, or until woken becomes true when it is given.
+        // Throws NativeStopped when the simulation was stopped or when nothing would ever happen again.
+        static void run(uint64_t until, const bool* woken);
+
+        // Interrupts as the CC2538 library handles them, they are only taken when run lets the hardware do something
+        static void registerInterrupt(uint32_t interrupt, void (*handler)());
+        static void enableInterrupt(uint32_t interrupt, bool enable);
+        static void setInterruptPending(uint32_t interrupt, bool pending);
+        static void setInterruptPriority(uint32_t interrupt, uint8_t priority);
+        static bool setInterruptsMasked(bool masked);
+        static void setInterruptPriorityMask(uint32_t mask);
+        static uint32_t getInterruptPriorityMask();
+
+        // The uDMA reads its transfers from the table that was given to uDMAControlBaseSet
+        static void setDmaControlTable(volatile tDMAControlTable* table);
+
+        // The antenna of the emulated radio, set through the Radio class of the OpenMote
+        static void setRadioChannel(uint8_t channel);
+    };
+}
+
+#endif // SNIFFER_NATIVE_HPP
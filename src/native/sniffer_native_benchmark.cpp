@@ -0,0 +1,765 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Runs the sniffer on the emulated hardware of sniffer_native.cpp, with the HostReceiver of the host library on the
+// other side of the serial link. Frames arrive on the air as a constant stream, as a poisson process or in bursts, and
+// the link can lose bytes or flip bits in both directions. Every frame that the host accepts is compared with the frame
+// that was send, and every frame that isn't accepted has to be counted as dropped by the sniffer or missed by the radio.
+// With more than one lane (after building with LANES=2) the frames of the lanes are merged in the order of their sequence
+// numbers before the HostReceiver gets them, as sniffer.py does with --bond-port.
+
+#include "sniffer_native.hpp"
+#include "sniffer_radio.hpp"
+#include "sniffer_epoch.hpp"
+#include "sniffer_recovery.hpp"
+#include "sniffer_serial.hpp"
+#include "sniffer_serial_send.hpp"
+#include "sniffer_profiling.hpp"
+#include "sniffer_statistics.hpp"
+#include "../host/sniffer_host.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <string>
+
+#define BENCHMARK_CHANNEL           26
+#define BENCHMARK_START_TIME        50000000ULL     // Nanoseconds before the first frame, the host connects in the meantime
+#define BENCHMARK_HOST_TIMEOUT      300000000ULL    // Silence after which the host calls serialTimeout, as sniffer.py does
+#define BENCHMARK_DRAIN_TIME        30000000000ULL  // Nanoseconds after the last frame in which every frame has to be accounted for
+#define BENCHMARK_PREAMBLE_TIME     (5 * NATIVE_AIR_BYTE_TIME)  // Preamble and SFD in front of every frame
+#define BENCHMARK_IFS               192000          // Shortest time between two frames on the air, 12 symbols
+#define BENCHMARK_SCHEDULE_AHEAD    64              // Frames that are given to the emulated radio at once
+#define BENCHMARK_MIN_LENGTH        6               // Index of the frame and the FCS
+
+namespace
+{
+    enum class Arrivals
+    {
+        Constant,
+        Poisson,
+        Burst
+    };
+
+    struct Options
+    {
+        uint32_t frames = 100000;
+        uint8_t length = 0;         // Length of the frames including the FCS, or 0 for random lengths
+        Arrivals arrivals = Arrivals::Constant;
+        double rate = 0;            // Frames per second, or 0 to send them back-to-back
+        uint32_t burstSize = 16;
+        double errorRate = 0;       // Probability that a byte on the link is lost or corrupted
+        uint16_t faultRate = 0;     // Encoded packets out of every 10000 that SerialSend corrupts, drops or duplicates
+        uint32_t baudrate = 0;      // Baudrate to switch to after READY, or 0 to stay at BAUDRATE
+        uint8_t framing = FRAMING_HDLC;
+        uint32_t radioLatency = 0;  // Microseconds before the radio interrupt is handled
+        bool ackOnRequest = false;  // Only acknowledge when the records ask for it
+        uint8_t batching = BATCHING_LATENCY;
+        uint16_t batchThreshold = 512;  // Bytes and milliseconds that the records wait at most in throughput mode
+        uint16_t batchHoldTime = 20;
+        uint32_t pauseEvery = 0;    // Frames after which the host pauses the records until its next timeout, or 0 to never pause
+        uint8_t lanes = 1;          // Lanes over which the sniffer spreads the records, at most NATIVE_LANES
+        uint32_t seed = 1;
+    };
+
+    Options options;
+    std::mt19937 arrivalRandom;
+
+    Sniffer::HostReceiver host(false);
+    bool hostConnected = false;
+    bool baudrateConfirmed = false;
+
+    // Frames that were scheduled but not yet verified, starting at frame verifyIndex
+    std::deque<uint64_t> sfdTimes;
+    uint32_t verifyIndex = 0;
+    uint32_t scheduledFrames = 0;
+    uint64_t nextFrameTime = BENCHMARK_START_TIME;
+    uint64_t lastFrameTime = BENCHMARK_START_TIME;
+
+    uint32_t receivedFrames = 0;
+    uint32_t wrongFrames = 0;
+    uint32_t laterTimestamps = 0;
+    uint32_t hostWarnings = 0;
+    uint64_t totalLatency = 0;  // Nanoseconds from the SFD of the frames until the host accepted them
+    uint64_t maxLatency = 0;
+    uint32_t pauses = 0;
+    bool paused = false;
+    uint64_t completionTime = 0;
+    bool complete = false;
+
+    // A frame of one lane that lies ahead of the records that were passed to the host, see mergeFrame
+    struct HeldFrame
+    {
+        uint16_t firstSeqNr;
+        uint32_t lanesHeard;    // Bit of every lane that delivered a frame since this one was held
+        std::vector<uint8_t> bytes;
+    };
+
+    std::vector<uint8_t> laneFrames[NATIVE_LANES];  // Bytes of the frame that each lane is receiving
+    std::deque<HeldFrame> heldFrames;               // Sorted on their sequence numbers
+    bool mergeSeqNrKnown = false;
+    uint16_t mergeSeqNr = 0;                        // Sequence number of the record that the host expects next
+    uint32_t reorderedFrames = 0;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Contents of the frames follow from their index, so that they don't have to be stored until they are verified
+    uint32_t mix(uint32_t value)
+    {
+        value ^= value >> 16;
+        value *= 0x7feb352d;
+        value ^= value >> 15;
+        value *= 0x846ca68b;
+        value ^= value >> 16;
+        return value;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint8_t frameLength(uint32_t index)
+    {
+        if (options.length != 0)
+            return options.length;
+
+        return BENCHMARK_MIN_LENGTH + mix(index) % (127 - BENCHMARK_MIN_LENGTH + 1);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint8_t frameByte(uint32_t index, uint8_t position)
+    {
+        if (position < 4)
+            return (index >> (24 - 8 * position)) & 0xff;
+
+        return mix(index * 131 + position) & 0xff;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Shortest time from the SFD of a frame to the SFD of the next one: the frame, the IFS and the next preamble
+    uint64_t airTime(uint8_t length)
+    {
+        return (1 + length) * NATIVE_AIR_BYTE_TIME + BENCHMARK_IFS + BENCHMARK_PREAMBLE_TIME;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Time between the SFD of a frame and the SFD of the next one, which never lets two frames overlap
+    uint64_t nextInterval(uint32_t index)
+    {
+        const uint64_t minimum = airTime(frameLength(index));
+        if (options.rate <= 0)
+            return minimum;
+
+        double interval = 1e9 / options.rate;
+        if (options.arrivals == Arrivals::Poisson)
+            interval = std::exponential_distribution<double>(options.rate)(arrivalRandom) * 1e9;
+        else if (options.arrivals == Arrivals::Burst)
+        {
+            // Frames within a burst follow each other directly, the pause keeps the average rate
+            if ((index + 1) % options.burstSize != 0)
+                return minimum;
+
+            interval = interval * options.burstSize;
+            for (uint32_t i = index + 1 - options.burstSize; i < index; ++i)
+                interval -= airTime(frameLength(i));
+        }
+
+        return (interval > minimum) ? static_cast<uint64_t>(interval) : minimum;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void scheduleFrames()
+    {
+        uint8_t frame[127];
+        for (uint32_t i = 0; (i < BENCHMARK_SCHEDULE_AHEAD) && (scheduledFrames < options.frames); ++i)
+        {
+            const uint32_t index = scheduledFrames++;
+            const uint8_t length = frameLength(index);
+            for (uint8_t pos = 0; pos < length; ++pos)
+                frame[pos] = frameByte(index, pos);
+
+            Sniffer::NativeHardware::scheduleFrame(nextFrameTime, BENCHMARK_CHANNEL, frame, length);
+            sfdTimes.push_back(nextFrameTime);
+            lastFrameTime = nextFrameTime;
+            nextFrameTime += nextInterval(index);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Frames that the host will never see anymore
+    uint32_t lostFrames()
+    {
+        return Sniffer::statistics.framesDropped + Sniffer::statistics.invalidLengths + Sniffer::NativeHardware::getMissedFrames();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void checkCompletion()
+    {
+        if ((scheduledFrames == options.frames) && !Sniffer::NativeHardware::hasScheduledFrames()
+         && (receivedFrames + lostFrames() >= options.frames))
+        {
+            complete = (receivedFrames + lostFrames() == options.frames);
+            completionTime = Sniffer::NativeHardware::getTime();
+            Sniffer::NativeHardware::stop();
+        }
+        else if (Sniffer::NativeHardware::getTime() > lastFrameTime + BENCHMARK_DRAIN_TIME)
+        {
+            completionTime = Sniffer::NativeHardware::getTime();
+            Sniffer::NativeHardware::stop();
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void sendHostOutput()
+    {
+        std::vector<uint8_t>& output = host.getOutput();
+        Sniffer::NativeHardware::sendFromHost(output.data(), output.size());
+        output.clear();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void sendReset()
+    {
+        // Let the sniffer choose its window and ACK interval
+        uint8_t data[RESET_EXTENDED_MESSAGE_LENGTH - 2] = {};
+        data[RESET_CHANNEL_OFFSET - 2] = BENCHMARK_CHANNEL;
+        if (options.ackOnRequest)
+            Sniffer::writeUint16(data, RESET_ACK_INTERVAL_OFFSET - 2, ACK_INTERVAL_ON_REQUEST);
+        host.write(Sniffer::SerialDataType::Reset, data, sizeof(data));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void sendBaudrate()
+    {
+        uint8_t data[BAUDRATE_MESSAGE_LENGTH - 2];
+        Sniffer::writeUint32(data, BAUDRATE_RATE_OFFSET - 2, options.baudrate);
+        Sniffer::writeUint32(data, BAUDRATE_PATTERN_OFFSET - 2, BAUDRATE_PATTERN);
+        host.write(Sniffer::SerialDataType::Baudrate, data, sizeof(data));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void sendBatching()
+    {
+        uint8_t data[BATCHING_MESSAGE_LENGTH - 2];
+        data[BATCHING_MODE_OFFSET - 2] = options.batching;
+        Sniffer::writeUint16(data, BATCHING_THRESHOLD_OFFSET - 2, options.batchThreshold);
+        Sniffer::writeUint16(data, BATCHING_HOLD_TIME_OFFSET - 2, options.batchHoldTime);
+        host.write(Sniffer::SerialDataType::Batching, data, sizeof(data));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void sendPause(bool pause)
+    {
+        const uint8_t data[PAUSE_MESSAGE_LENGTH - 2] = {static_cast<uint8_t>(pause ? 1 : 0)};
+        host.write(Sniffer::SerialDataType::Pause, data, sizeof(data));
+        paused = pause;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void sendLanes()
+    {
+        const uint8_t data[LANES_MESSAGE_LENGTH - 2] = {options.lanes};
+        host.write(Sniffer::SerialDataType::Lanes, data, sizeof(data));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void sendFraming()
+    {
+        // Records that were encoded before the OpenMote switched are still decoded, the host tries HDLC when COBS fails
+        const uint8_t data[FRAMING_MESSAGE_LENGTH - 2] = {options.framing};
+        host.write(Sniffer::SerialDataType::Framing, data, sizeof(data));
+        host.setCobsFraming(options.framing == FRAMING_COBS);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void verifyRecord(const uint8_t* data, size_t size)
+    {
+        receivedFrames++;
+        if (size < HOST_DATA_OFFSET + BENCHMARK_MIN_LENGTH)
+        {
+            wrongFrames++;
+            return;
+        }
+
+        const uint8_t* frame = data + HOST_DATA_OFFSET;
+        const uint8_t length = static_cast<uint8_t>(size - HOST_DATA_OFFSET);
+        const uint32_t index = (frame[0] << 24) | (frame[1] << 16) | (frame[2] << 8) | frame[3];
+
+        // The frames have to arrive in order, every frame that was skipped must have been lost
+        if ((index < verifyIndex) || (index >= scheduledFrames))
+        {
+            wrongFrames++;
+            return;
+        }
+
+        sfdTimes.erase(sfdTimes.begin(), sfdTimes.begin() + (index - verifyIndex));
+        verifyIndex = index;
+
+        // Frames that waited in the RX FIFO behind others are timestamped as if they followed each other as closely as possible,
+        // which can only place them later than they really were
+        const uint32_t timestamp = Sniffer::readUint32(const_cast<uint8_t*>(data), 1 + BUFFER_TIMESTAMP_OFFSET);
+        const int32_t timestampError = static_cast<int32_t>(timestamp - static_cast<uint32_t>(sfdTimes.front() / 1000));
+        if ((timestampError > 0) && (options.radioLatency != 0))
+            laterTimestamps++;
+
+        bool correct = (length == frameLength(index))
+                    && ((timestampError == 0) || ((timestampError > 0) && (options.radioLatency != 0)))
+                    && (frame[length - 2] == static_cast<uint8_t>(NATIVE_FRAME_RSSI))
+                    && (frame[length - 1] == (0x80 | NATIVE_FRAME_LQI));
+        for (uint8_t pos = 4; correct && (pos < length - 2); ++pos)
+            correct = (frame[pos] == frameByte(index, pos));
+
+        if (!correct)
+            wrongFrames++;
+
+        const uint64_t latency = Sniffer::NativeHardware::getTime() - sfdTimes.front();
+        totalLatency += latency;
+        if (latency > maxLatency)
+            maxLatency = latency;
+
+        sfdTimes.pop_front();
+        verifyIndex++;
+
+        // A host with a slow output pauses the records, the silence that follows lets hostTimeout continue them
+        if ((options.pauseEvery != 0) && (receivedFrames % options.pauseEvery == 0) && !paused)
+        {
+            sendPause(true);
+            pauses++;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Undo the framing of the bytes between the flags and check the CRC, trying HDLC when the frame isn't valid COBS
+    bool decodeFrame(const std::vector<uint8_t>& frame, std::vector<uint8_t>& message)
+    {
+        message.clear();
+        if (options.framing == FRAMING_COBS)
+        {
+            size_t pos = 0;
+            bool valid = true;
+            while (valid && (pos < frame.size()))
+            {
+                const uint8_t code = frame[pos] ^ COBS_XOR_MASK;
+                valid = (code != 0) && (pos + code <= frame.size());
+                for (size_t i = pos + 1; valid && (i < pos + code); ++i)
+                    message.push_back(frame[i] ^ COBS_XOR_MASK);
+
+                pos += code;
+                if (valid && (code != COBS_MAX_BLOCK_LEN) && (pos < frame.size()))
+                    message.push_back(0);
+            }
+
+            if (valid && (message.size() >= 4)
+             && (Sniffer::crcCalculate(message.data(), message.size() - 2, CRC_INIT) == Sniffer::readUint16(message.data(), message.size() - 2)))
+                return true;
+
+            message.clear();
+        }
+
+        for (size_t i = 0; i < frame.size(); ++i)
+        {
+            if ((frame[i] == HDLC_ESCAPE) && (i + 1 < frame.size()))
+                message.push_back(frame[++i] ^ HDLC_ESCAPE_MASK);
+            else
+                message.push_back(frame[i]);
+        }
+
+        return (message.size() >= 4)
+            && (Sniffer::crcCalculate(message.data(), message.size() - 2, CRC_INIT) == Sniffer::readUint16(message.data(), message.size() - 2));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void releaseFrame(const std::vector<uint8_t>& bytes)
+    {
+        host.feed(bytes.data(), bytes.size());
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // The held frames that the host expects now, or all of them
+    void releaseHeldFrames(bool all)
+    {
+        while (!heldFrames.empty() && (all || !mergeSeqNrKnown || (heldFrames.front().firstSeqNr == mergeSeqNr)
+                                          || (static_cast<int16_t>(heldFrames.front().firstSeqNr - mergeSeqNr) < 0)))
+        {
+            std::vector<uint8_t> message;
+            decodeFrame(std::vector<uint8_t>(heldFrames.front().bytes.begin() + 1, heldFrames.front().bytes.end() - 1), message);
+            releaseFrame(heldFrames.front().bytes);
+            heldFrames.pop_front();
+
+            // The sequence number of the last record in the frame tells which one follows
+            uint16_t lastSeqNr = Sniffer::readUint16(message.data(), HOST_SEQNR_OFFSET);
+            if ((message[0] & ~ACK_REQUESTED) == Sniffer::SerialDataType::PacketBatch)
+            {
+                const size_t end = message.size() - 2;
+                for (size_t pos = 2; (pos + BUFFER_SEQNR_OFFSET + 2 <= end) && (message[pos] != 0); pos += message[pos])
+                    lastSeqNr = Sniffer::readUint16(message.data(), pos + BUFFER_SEQNR_OFFSET);
+            }
+
+            mergeSeqNrKnown = true;
+            mergeSeqNr = lastSeqNr + 1;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // A packet that was started later on one lane can arrive before an earlier one on another lane. The records that lie
+    // ahead are held until the host expects them, or until every other lane delivered a frame since then (the missing
+    // one was lost, the HostReceiver asks for it) or the host timed out. Everything else goes to the host right away.
+    void mergeFrame(uint8_t lane, const std::vector<uint8_t>& bytes)
+    {
+        std::vector<uint8_t> message;
+        const bool valid = decodeFrame(std::vector<uint8_t>(bytes.begin() + 1, bytes.end() - 1), message);
+        const uint8_t recordType = valid ? (message[0] & ~ACK_REQUESTED) : 0;
+        const bool record = valid && (message.size() >= HOST_SEQNR_OFFSET + 4)
+                         && ((recordType == Sniffer::SerialDataType::Packet) || (recordType == Sniffer::SerialDataType::PacketBatch)
+                          || (recordType == Sniffer::SerialDataType::Survey));
+
+        if (!record)
+        {
+            if (valid && (message[0] == Sniffer::SerialDataType::Ready))
+            {
+                releaseHeldFrames(true);
+                mergeSeqNrKnown = false;
+            }
+
+            releaseFrame(bytes);
+        }
+        else
+        {
+            const uint16_t firstSeqNr = Sniffer::readUint16(message.data(), (recordType == Sniffer::SerialDataType::PacketBatch)
+                                                                             ? 2 + BUFFER_SEQNR_OFFSET : HOST_SEQNR_OFFSET);
+            std::deque<HeldFrame>::iterator it = heldFrames.begin();
+            while ((it != heldFrames.end()) && (static_cast<int16_t>(it->firstSeqNr - firstSeqNr) < 0))
+                ++it;
+
+            heldFrames.insert(it, {firstSeqNr, 0, bytes});
+            if (mergeSeqNrKnown && (static_cast<int16_t>(firstSeqNr - mergeSeqNr) > 0))
+                reorderedFrames++;
+
+            releaseHeldFrames(false);
+        }
+
+        // Each lane sends its packets in order, so what is still missing in front of a frame that every lane has passed is lost
+        const uint32_t allLanes = (1u << options.lanes) - 1;
+        for (HeldFrame& held : heldFrames)
+            held.lanesHeard |= (1u << lane);
+        while (!heldFrames.empty() && (heldFrames.front().lanesHeard == allLanes))
+        {
+            mergeSeqNrKnown = false;
+            releaseHeldFrames(false);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Split the bytes of each lane in frames, every frame starts and ends with a flag
+    void laneReceive(uint8_t lane, const uint8_t* data, size_t length)
+    {
+        std::vector<uint8_t>& frame = laneFrames[lane];
+        for (size_t i = 0; i < length; ++i)
+        {
+            if (frame.empty() && (data[i] != HDLC_FLAG))
+            {
+                const uint8_t byte = data[i];
+                releaseFrame(std::vector<uint8_t>(1, byte));
+                continue;
+            }
+
+            frame.push_back(data[i]);
+            if ((data[i] == HDLC_FLAG) && (frame.size() > 1))
+            {
+                if (frame.size() > 2)
+                    mergeFrame(lane, frame);
+                frame.assign(1, HDLC_FLAG);
+            }
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void processHostEvents()
+    {
+        const uint8_t* event;
+        size_t eventLength;
+        int type;
+        while ((type = host.nextEvent(&event, &eventLength)) != Sniffer::HostEvent::None)
+        {
+            if (type == Sniffer::HostEvent::Record)
+                verifyRecord(event, eventLength);
+            else if (type == Sniffer::HostEvent::Warning)
+                hostWarnings++;
+            else if ((event[0] == Sniffer::SerialDataType::Ready) && (event[1] == READY_MESSAGE_LENGTH))
+            {
+                hostConnected = true;
+                const uint16_t ackInterval = Sniffer::readUint16(const_cast<uint8_t*>(event), READY_ACK_INTERVAL_OFFSET);
+                host.setAckThreshold(ackInterval & ~ACK_INTERVAL_ON_REQUEST);
+                host.setAckOnRequest(ackInterval & ACK_INTERVAL_ON_REQUEST);
+                host.setCumulativeAck(Sniffer::readUint32(const_cast<uint8_t*>(event), READY_CAPABILITIES_OFFSET) & CAPABILITY_CUMULATIVE_ACK);
+                host.setAlignedRecords(Sniffer::readUint32(const_cast<uint8_t*>(event), READY_CAPABILITIES_OFFSET) & CAPABILITY_ALIGNED_RECORDS);
+                if (options.framing != FRAMING_HDLC)
+                    sendFraming();
+                if (options.batching != BATCHING_LATENCY)
+                    sendBatching();
+                if (options.lanes > 1)
+                    sendLanes();
+                if (options.baudrate != 0)
+                    sendBaudrate();
+            }
+            else if ((event[0] == Sniffer::SerialDataType::Baudrate) && (event[1] == BAUDRATE_MESSAGE_LENGTH) && !baudrateConfirmed)
+            {
+                // Repeat the request at the new baudrate to confirm it
+                if (Sniffer::readUint32(const_cast<uint8_t*>(event), BAUDRATE_RATE_OFFSET) == options.baudrate)
+                {
+                    baudrateConfirmed = true;
+                    sendBaudrate();
+                }
+            }
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void hostReceive(uint8_t lane, const uint8_t* data, size_t length)
+    {
+        if (options.lanes > 1)
+            laneReceive(lane, data, length);
+        else
+            host.feed(data, length);
+
+        processHostEvents();
+        sendHostOutput();
+        checkCompletion();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void hostTimeout()
+    {
+        // The RESET or the BAUDRATE message may have been corrupted on the link
+        if (!hostConnected)
+            sendReset();
+        else if ((options.baudrate != 0) && !baudrateConfirmed)
+            sendBaudrate();
+        if (paused)
+            sendPause(false);
+
+        // The frames that were missing in front of the held ones aren't coming anymore
+        if (!heldFrames.empty())
+        {
+            releaseHeldFrames(true);
+            processHostEvents();
+        }
+
+        host.serialTimeout();
+        sendHostOutput();
+        checkCompletion();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool parseOptions(int argc, char* argv[])
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string option = argv[i];
+            if (i + 1 >= argc)
+                return false;
+
+            const char* value = argv[++i];
+            if (option == "--frames")
+                options.frames = std::strtoul(value, nullptr, 10);
+            else if (option == "--length")
+                options.length = static_cast<uint8_t>(std::strtoul(value, nullptr, 10));
+            else if (option == "--rate")
+                options.rate = std::strtod(value, nullptr);
+            else if (option == "--burst")
+                options.burstSize = std::strtoul(value, nullptr, 10);
+            else if (option == "--errors")
+                options.errorRate = std::strtod(value, nullptr);
+            else if (option == "--faults")
+                options.faultRate = static_cast<uint16_t>(std::strtoul(value, nullptr, 10));
+            else if (option == "--baudrate")
+                options.baudrate = std::strtoul(value, nullptr, 10);
+            else if (option == "--radio-latency")
+                options.radioLatency = std::strtoul(value, nullptr, 10);
+            else if (option == "--seed")
+                options.seed = std::strtoul(value, nullptr, 10);
+            else if ((option == "--arrivals") && (std::strcmp(value, "constant") == 0))
+                options.arrivals = Arrivals::Constant;
+            else if ((option == "--arrivals") && (std::strcmp(value, "poisson") == 0))
+                options.arrivals = Arrivals::Poisson;
+            else if ((option == "--arrivals") && (std::strcmp(value, "burst") == 0))
+                options.arrivals = Arrivals::Burst;
+            else if ((option == "--framing") && (std::strcmp(value, "hdlc") == 0))
+                options.framing = FRAMING_HDLC;
+            else if ((option == "--framing") && (std::strcmp(value, "cobs") == 0))
+                options.framing = FRAMING_COBS;
+            else if ((option == "--acks") && (std::strcmp(value, "interval") == 0))
+                options.ackOnRequest = false;
+            else if ((option == "--acks") && (std::strcmp(value, "request") == 0))
+                options.ackOnRequest = true;
+            else if ((option == "--batching") && (std::strcmp(value, "latency") == 0))
+                options.batching = BATCHING_LATENCY;
+            else if ((option == "--batching") && (std::strcmp(value, "throughput") == 0))
+                options.batching = BATCHING_THROUGHPUT;
+            else if (option == "--batch-threshold")
+                options.batchThreshold = static_cast<uint16_t>(std::strtoul(value, nullptr, 10));
+            else if (option == "--batch-hold-time")
+                options.batchHoldTime = static_cast<uint16_t>(std::strtoul(value, nullptr, 10));
+            else if (option == "--pause-every")
+                options.pauseEvery = std::strtoul(value, nullptr, 10);
+            else if (option == "--lanes")
+                options.lanes = static_cast<uint8_t>(std::strtoul(value, nullptr, 10));
+            else
+                return false;
+        }
+
+        if ((options.length != 0) && ((options.length < BENCHMARK_MIN_LENGTH) || (options.length > 127)))
+            return false;
+        if ((options.burstSize == 0) || (options.errorRate < 0) || (options.errorRate >= 1))
+            return false;
+        if ((options.baudrate != 0) && (options.baudrate < BAUDRATE))
+            return false;
+        if (options.faultRate > 10000)
+            return false;
+        if ((options.lanes == 0) || (options.lanes > NATIVE_LANES))
+            return false;
+        if ((options.batchThreshold == 0) || (options.batchThreshold > BATCHING_MAX_THRESHOLD)
+         || (options.batchHoldTime == 0) || (options.batchHoldTime > BATCHING_MAX_HOLD_TIME))
+            return false;
+
+        return true;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+    if (!parseOptions(argc, argv))
+    {
+        std::printf("Usage: %s [--frames N] [--length 6-127, random by default] [--arrivals constant|poisson|burst]\n"
+                    "       [--rate frames/s, back-to-back by default] [--burst frames] [--errors byte error rate]\n"
+                    "       [--faults packets per 10000] [--baudrate rate] [--framing hdlc|cobs] [--radio-latency microseconds]\n"
+                    "       [--acks interval|request] [--batching latency|throughput] [--batch-threshold bytes]\n"
+                    "       [--batch-hold-time milliseconds] [--pause-every frames] [--lanes 1-%u] [--seed N]\n",
+                    argv[0], static_cast<unsigned int>(NATIVE_LANES));
+        return 2;
+    }
+
+    arrivalRandom.seed(options.seed);
+    Sniffer::NativeHardware::setSeed(options.seed);
+    Sniffer::NativeHardware::setLinkErrorRate(options.errorRate);
+    Sniffer::NativeHardware::setRadioInterruptLatency(options.radioLatency * 1000ULL);
+    Sniffer::serialFaultRate = options.faultRate;
+    Sniffer::NativeHardware::setHost(hostReceive, hostTimeout, BENCHMARK_HOST_TIMEOUT);
+    Sniffer::NativeHardware::setFrameScheduleHandler(scheduleFrames);
+    scheduleFrames();
+
+    // The decryption and the flash log are left out, the crypto engine and the flash aren't emulated
+    Sniffer::Recovery::initialize();
+    Sniffer::Profiling::initialize();
+    Sniffer::Radio::initialize();
+    Sniffer::Epoch::initialize();
+    Sniffer::Serial::initialize();
+
+    sendReset();
+    sendHostOutput();
+
+    const auto wallStart = std::chrono::steady_clock::now();
+    try
+    {
+        Sniffer::Serial::serialTask(nullptr);
+    }
+    catch (Sniffer::NativeStopped&)
+    {
+    }
+    const double wallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+
+    const double simulatedTime = ((completionTime != 0) ? completionTime : Sniffer::NativeHardware::getTime()) / 1e9;
+    const double offeredTime = (lastFrameTime - BENCHMARK_START_TIME) / 1e9;
+    const uint32_t baudrate = (options.baudrate != 0) ? options.baudrate : BAUDRATE;
+    const char* arrivals[] = {"constant", "poisson", "burst"};
+
+    std::printf("Frames offered:       %u (%s", options.frames, arrivals[static_cast<int>(options.arrivals)]);
+    if (options.rate > 0)
+        std::printf(", %.0f frames/s", options.rate);
+    else
+        std::printf(", back-to-back");
+    if (options.length != 0)
+        std::printf(", %u bytes)\n", options.length);
+    else
+        std::printf(", random lengths)\n");
+    std::printf("Link:                 %u baud, %s framing, byte error rate %g\n", baudrate,
+                (options.framing == FRAMING_COBS) ? "COBS" : "HDLC", options.errorRate);
+    if (options.lanes > 1)
+        std::printf("Lanes:                %u (%u frames arrived ahead of an earlier one)\n", options.lanes, reorderedFrames);
+    if (options.faultRate != 0)
+    {
+        std::printf("Injected faults:      %u per 10000 packets (%u corrupted, %u dropped, %u duplicated)\n", options.faultRate,
+                    Sniffer::serialFaults.corrupted, Sniffer::serialFaults.dropped, Sniffer::serialFaults.duplicated);
+    }
+    std::printf("Received by host:     %u (%u incorrect)\n", receivedFrames, wrongFrames);
+    std::printf("Dropped by sniffer:   %u (+ %u invalid lengths)\n", Sniffer::statistics.framesDropped, Sniffer::statistics.invalidLengths);
+    std::printf("Missed by radio:      %u\n", Sniffer::NativeHardware::getMissedFrames());
+    if (options.radioLatency != 0)
+        std::printf("Radio latency:        %u us (%u frames timestamped later than their SFD)\n", options.radioLatency, laterTimestamps);
+    std::printf("NACKs:                %u (%u bytes retransmitted, %u host warnings)\n",
+                Sniffer::statistics.nacksReceived, Sniffer::statistics.retransmittedBytes, hostWarnings);
+    std::printf("Buffer peak:          %u of %u bytes\n", Sniffer::statistics.bufferPeak, static_cast<unsigned int>(NATIVE_BUFFER_LEN));
+    if (options.pauseEvery != 0)
+        std::printf("Pauses:               %u, until the host timed out after %u ms\n", pauses, static_cast<unsigned int>(BENCHMARK_HOST_TIMEOUT / 1000000));
+    std::printf("Unused at buffer end: %u bytes\n", Sniffer::statistics.bufferWrapBytes);
+    if (receivedFrames > 0)
+    {
+        std::printf("Delivery latency:     %.2f ms average, %.2f ms at most (%s)\n", totalLatency / 1e6 / receivedFrames,
+                    maxLatency / 1e6, (options.batching == BATCHING_THROUGHPUT) ? "throughput mode" : "latency mode");
+    }
+    if (Sniffer::statistics.batchesHeld > 0)
+    {
+        std::printf("Held back:            %u times, %.2f ms average, %.2f ms at most\n", Sniffer::statistics.batchesHeld,
+                    Sniffer::statistics.batchHoldTime / 1e3 / Sniffer::statistics.batchesHeld, Sniffer::statistics.batchHoldPeak / 1e3);
+    }
+    if (offeredTime > 0)
+        std::printf("Offered rate:         %.0f frames/s\n", options.frames / offeredTime);
+    if (simulatedTime > 0)
+    {
+        std::printf("Delivered rate:       %.0f frames/s over %.2f simulated seconds\n", receivedFrames / simulatedTime, simulatedTime);
+        std::printf("Link utilisation:     %.1f%% to the host, %.2f%% to the sniffer (%s)\n",
+                    Sniffer::NativeHardware::getBytesToHost() * 1000.0 / baudrate / options.lanes / simulatedTime,
+                    Sniffer::NativeHardware::getBytesToSniffer() * 1000.0 / baudrate / simulatedTime,
+                    options.ackOnRequest ? "ACKs on request" : "ACK every interval");
+    }
+    std::printf("Simulation speed:     %.0f frames/s (%.2f seconds)\n", options.frames / wallTime, wallTime);
+
+    if (!complete || (wrongFrames != 0))
+    {
+        std::printf("FAILED: %s\n", (wrongFrames != 0) ? "the host received incorrect frames" : "not every frame was accounted for");
+        return 1;
+    }
+
+    return 0;
+}
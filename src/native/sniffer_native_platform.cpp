@@ -0,0 +1,362 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Stand-ins for the parts of the CC2538 library, the OpenMote board and FreeRTOS that the sniffer links against.
+// The interrupts and the uDMA are passed to the emulated hardware of sniffer_native.cpp. The crypto engine and the
+// flash aren't emulated, decrypting frames, the integrity checkpoints and the flash log thus don't work natively.
+
+#include "sniffer_native.hpp"
+
+#include "Semaphore.h"
+#include "openmote-cc2538.h"
+#include "libcc2538_aes.h"
+#include "libcc2538_ccm.h"
+#include "libcc2538_flash.h"
+#include "libcc2538_sha256.h"
+#include "libcc2538_sys_ctrl.h"
+
+// The buffer takes the place of the free SRAM, the Makefile gives _free_sram_size the same value as NATIVE_BUFFER_LEN.
+// It is word-aligned like the free SRAM in the linker script.
+extern "C" uint8_t _free_sram_start[NATIVE_BUFFER_LEN];
+alignas(4) uint8_t _free_sram_start[NATIVE_BUFFER_LEN];
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool IntMasterEnable()
+{
+    return Sniffer::NativeHardware::setInterruptsMasked(false);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool IntMasterDisable()
+{
+    return Sniffer::NativeHardware::setInterruptsMasked(true);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void IntRegister(uint32_t ui32Interrupt, void (*pfnHandler)(void))
+{
+    Sniffer::NativeHardware::registerInterrupt(ui32Interrupt, pfnHandler);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void IntPrioritySet(uint32_t ui32Interrupt, uint8_t ui8Priority)
+{
+    Sniffer::NativeHardware::setInterruptPriority(ui32Interrupt, ui8Priority);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void IntPriorityMaskSet(uint32_t ui32PriorityMask)
+{
+    Sniffer::NativeHardware::setInterruptPriorityMask(ui32PriorityMask);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t IntPriorityMaskGet()
+{
+    return Sniffer::NativeHardware::getInterruptPriorityMask();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void IntEnable(uint32_t ui32Interrupt)
+{
+    Sniffer::NativeHardware::enableInterrupt(ui32Interrupt, true);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void IntDisable(uint32_t ui32Interrupt)
+{
+    Sniffer::NativeHardware::enableInterrupt(ui32Interrupt, false);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void IntPendClear(uint32_t ui32Interrupt)
+{
+    Sniffer::NativeHardware::setInterruptPending(ui32Interrupt, false);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void uDMAEnable()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void uDMAControlBaseSet(void* pControlTable)
+{
+    Sniffer::NativeHardware::setDmaControlTable(static_cast<volatile tDMAControlTable*>(pControlTable));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void uDMAChannelAttributeEnable(uint32_t, uint32_t)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void uDMAChannelControlSet(uint32_t ui32ChannelStructIndex, uint32_t ui32Control)
+{
+    // Same fields as in the CC2538 library, the transfer size and mode are set separately
+    volatile tDMAControlTable& entry = Sniffer::uDMAChannelControlTable[ui32ChannelStructIndex & 0x3f];
+    entry.ui32Control = (entry.ui32Control & ~(UDMACHCTL_CHCTL_DSTINC_M | UDMACHCTL_CHCTL_DSTSIZE_M | UDMACHCTL_CHCTL_SRCINC_M
+                                                | UDMACHCTL_CHCTL_SRCSIZE_M | UDMACHCTL_CHCTL_ARBSIZE_M | UDMACHCTL_CHCTL_NXTUSEBURST))
+                      | ui32Control;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SysCtrlPeripheralEnable(uint32_t)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int32_t FlashMainPageErase(uint32_t)
+{
+    return -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int32_t FlashMainPageProgram(uint32_t*, uint32_t, uint32_t)
+{
+    return -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint8_t AESLoadKey(uint8_t*, uint8_t)
+{
+    return AES_KEYSTORE_WRITE_ERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint8_t CCMInvAuthDecryptStart(bool, uint8_t, uint8_t*, uint8_t*, uint16_t, uint8_t*, uint16_t, uint8_t, uint8_t*, uint8_t, uint8_t)
+{
+    return AES_KEYSTORE_READ_ERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint8_t CCMInvAuthDecryptCheckResult()
+{
+    return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint8_t CCMInvAuthDecryptGetResult(uint8_t, uint8_t*, uint16_t, uint8_t*)
+{
+    return AES_KEYSTORE_READ_ERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint8_t CCMAuthEncryptStart(bool, uint8_t, uint8_t*, uint8_t*, uint16_t, uint8_t*, uint16_t, uint8_t, uint8_t*, uint8_t, uint8_t)
+{
+    return AES_KEYSTORE_READ_ERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint8_t CCMAuthEncryptCheckResult()
+{
+    return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint8_t CCMAuthEncryptGetResult(uint8_t, uint16_t, uint8_t*)
+{
+    return AES_KEYSTORE_READ_ERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint8_t SHA256Init(tSHA256State*)
+{
+    return AES_KEYSTORE_READ_ERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint8_t SHA256Process(tSHA256State*, uint8_t*, uint32_t)
+{
+    return AES_KEYSTORE_READ_ERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint8_t SHA256Done(tSHA256State*, uint8_t*)
+{
+    return AES_KEYSTORE_READ_ERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// A flag takes the place of the FreeRTOS semaphore, the emulated hardware runs while the serial task waits for it
+SemaphoreBinary::SemaphoreBinary()
+{
+    semaphore_ = reinterpret_cast<SemaphoreHandle_t>(new bool(false));
+    priorityTaskWoken_ = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+SemaphoreBinary::~SemaphoreBinary()
+{
+    delete reinterpret_cast<bool*>(semaphore_);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SemaphoreBinary::take()
+{
+    bool& given = *reinterpret_cast<bool*>(semaphore_);
+    Sniffer::NativeHardware::run(NATIVE_TIME_FOREVER, &given);
+    given = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SemaphoreBinary::take(uint32_t milliseconds)
+{
+    bool& given = *reinterpret_cast<bool*>(semaphore_);
+    Sniffer::NativeHardware::run(Sniffer::NativeHardware::getTime() + milliseconds * 1000000ULL, &given);
+    given = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SemaphoreBinary::give()
+{
+    *reinterpret_cast<bool*>(semaphore_) = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SemaphoreBinary::giveFromInterrupt()
+{
+    *reinterpret_cast<bool*>(semaphore_) = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+Gpio::Gpio(uint32_t port, uint8_t pin) :
+    port_(port),
+    pin_(pin)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+GpioOut::GpioOut(uint32_t port, uint8_t pin) :
+    Gpio(port, pin)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void GpioOut::on()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void GpioOut::off()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void GpioOut::toggle()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+Radio::Radio() :
+    radioState_(RadioState_Off),
+    rxInit_(nullptr),
+    rxDone_(nullptr),
+    txInit_(nullptr),
+    txDone_(nullptr)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Radio::enable()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Radio::setChannel(uint8_t channel)
+{
+    Sniffer::NativeHardware::setRadioChannel(channel);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// There is no watchdog, the simulation never hangs for long enough to need it
+
+Watchdog::Watchdog(uint32_t interval) :
+    interval_(interval)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Watchdog::init()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Watchdog::walk()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+Board::Board() :
+    flashEraseCallback_(nullptr)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Every emulated OpenMote has the same EUI-48, with the organisation of Texas Instruments like the real chip
+
+void Board::getEUI48(uint8_t* address)
+{
+    const uint8_t eui[6] = {0x00, 0x12, 0x4B, 0x00, 0x00, 0x01};
+    for (uint8_t i = 0; i < 6; ++i)
+        address[i] = eui[i];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+Board board;
+Radio radio;
+Watchdog watchdog(WATCHDOG_INTERVAL);
+GpioOut led_green(LED_GREEN_PORT, LED_GREEN_PIN);
+GpioOut led_orange(LED_ORANGE_PORT, LED_ORANGE_PIN);
+GpioOut led_red(LED_RED_PORT, LED_RED_PIN);
+GpioOut led_yellow(LED_YELLOW_PORT, LED_YELLOW_PIN);
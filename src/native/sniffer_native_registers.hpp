@@ -0,0 +1,54 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_NATIVE_REGISTERS_HPP
+#define SNIFFER_NATIVE_REGISTERS_HPP
+
+// The Makefile includes this file in front of every source file of the native build. It takes the place of hw_types.h
+// of the CC2538 library (whose include guard it defines), so that HWREG no longer dereferences the address but passes
+// the access to the emulated hardware in sniffer_native.cpp. Reading RFDATA then takes a byte from the emulated
+// RX FIFO and writing SWREQ performs the uDMA transfer, just like on the chip.
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define __HW_TYPES_H__
+
+typedef unsigned char tBoolean;
+
+namespace Sniffer
+{
+    namespace NativeRegisters
+    {
+        uint32_t read(uintptr_t address);
+        void write(uintptr_t address, uint32_t value);
+
+        // Stands for the register while the firmware reads or writes it, every access is a call to the emulated hardware
+        class Register
+        {
+        public:
+            explicit Register(uintptr_t address) : m_address(address) {}
+
+            operator uint32_t() const { return read(m_address); }
+
+            Register& operator=(uint32_t value) { write(m_address, value); return *this; }
+            Register& operator=(const Register& other) { write(m_address, other); return *this; }
+            Register& operator|=(uint32_t value) { write(m_address, read(m_address) | value); return *this; }
+            Register& operator&=(uint32_t value) { write(m_address, read(m_address) & value); return *this; }
+            Register& operator^=(uint32_t value) { write(m_address, read(m_address) ^ value); return *this; }
+
+        private:
+            uintptr_t m_address;
+        };
+    }
+}
+
+#define HWREG(x)    Sniffer::NativeRegisters::Register(x)
+#define HWREGH(x)   Sniffer::NativeRegisters::Register(x)
+#define HWREGB(x)   Sniffer::NativeRegisters::Register(x)
+
+#endif // SNIFFER_NATIVE_REGISTERS_HPP
@@ -0,0 +1,163 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_autostart.hpp"
+#include "sniffer_serial_receive.hpp"
+#include "sniffer_serial_send.hpp"
+#include "sniffer_flash_log.hpp"
+
+#include "libcc2538_flash.h"
+
+#define AUTOSTART_MAGIC     0x4F4D4153  // "OMAS"
+
+namespace Sniffer
+{
+    // Layout of the page in the flash, the messages are stored exactly as the host sent them (including their crc)
+    struct AutostartConfig
+    {
+        uint32_t magic;
+        uint16_t length; // Amount of bytes of messages
+        uint16_t crc;    // Checksum over the messages
+        uint8_t  messages[AUTOSTART_CONFIG_LEN];
+    };
+
+    // The configuration of the current capture, programmed into the flash as it is
+    AutostartConfig autostartConfig __attribute__((aligned(4)));
+    bool autostartConfigOverflow = false; // Set when a message of the current capture didn't fit
+    bool autostartAttachPending = false;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Only the messages that change how the frames are captured belong to the configuration, not e.g. the decryption keys
+    inline bool autostartIsConfigMessage(const uint8_t* msg)
+    {
+        if (msg[0] == SerialDataType::FlashLog)
+            return (msg[FLASH_LOG_COMMAND_OFFSET] == FlashLogCommand::Enable) || (msg[FLASH_LOG_COMMAND_OFFSET] == FlashLogCommand::Disable);
+
+        return (msg[0] == SerialDataType::Reset) || (msg[0] == SerialDataType::Survey) || (msg[0] == SerialDataType::Summary)
+            || (msg[0] == SerialDataType::Filter) || (msg[0] == SerialDataType::FilterProgram)
+            || (msg[0] == SerialDataType::SnapLength) || (msg[0] == SerialDataType::Overflow)
+            || (msg[0] == SerialDataType::FcsFilter) || (msg[0] == SerialDataType::Hop) || (msg[0] == SerialDataType::AdaptiveHop)
+            || (msg[0] == SerialDataType::Superframe);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Autostart::start()
+    {
+        // Erased flash or a configuration of which the programming was interrupted is ignored
+        const AutostartConfig* stored = reinterpret_cast<const AutostartConfig*>(AUTOSTART_PAGE_ADDRESS);
+        if ((stored->magic != AUTOSTART_MAGIC) || (stored->length > AUTOSTART_CONFIG_LEN)
+         || (crcCalculate(stored->messages, stored->length, CRC_INIT) != stored->crc))
+            return;
+
+        // The messages are handled as if the host just sent them, they are only read so they stay in the flash. Starting
+        // the capture forgets the configuration, which is why every message is added back once it was accepted.
+        uint16_t offset = 0;
+        captureStarted();
+        while ((offset + 2 <= stored->length) && (offset + stored->messages[offset + 1] + 2 <= stored->length))
+        {
+            const uint8_t* storedMessage = &stored->messages[offset];
+            if (SerialReceive::replay(storedMessage))
+                record(storedMessage);
+
+            offset += storedMessage[1] + 2;
+        }
+
+        // Nothing is send to the UART before a host is there to acknowledge it
+        autostartAttachPending = hostSessionActive;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Autostart::command(uint8_t cmd)
+    {
+        if (cmd == AutostartCommand::Clear)
+            FlashMainPageErase(AUTOSTART_PAGE_ADDRESS);
+        else if (cmd == AutostartCommand::Save)
+            return save();
+        else if (cmd == AutostartCommand::Attach)
+            attach();
+        else
+            return false;
+
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Autostart::captureStarted()
+    {
+        autostartConfig.length = 0;
+        autostartConfigOverflow = false;
+        autostartAttachPending = false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Autostart::record(const uint8_t* msg)
+    {
+        // Nothing is configured before a capture started, and the messages that start one always come first
+        if (!autostartIsConfigMessage(msg))
+            return;
+        if ((autostartConfig.length == 0) && (msg[0] != SerialDataType::Reset)
+         && (msg[0] != SerialDataType::Survey) && (msg[0] != SerialDataType::Summary))
+            return;
+
+        const uint16_t messageLength = msg[1] + 2;
+        if (autostartConfig.length + messageLength > AUTOSTART_CONFIG_LEN)
+        {
+            autostartConfigOverflow = true;
+            return;
+        }
+
+        for (uint16_t i = 0; i < messageLength; ++i)
+            autostartConfig.messages[autostartConfig.length + i] = msg[i];
+        autostartConfig.length += messageLength;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Autostart::isAttachPending()
+    {
+        return autostartAttachPending;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Autostart::save()
+    {
+        // A configuration that is missing messages would start a different capture
+        if ((autostartConfig.length == 0) || autostartConfigOverflow)
+            return false;
+
+        autostartConfig.magic = AUTOSTART_MAGIC;
+        autostartConfig.crc = crcCalculate(autostartConfig.messages, autostartConfig.length, CRC_INIT);
+
+        // The processor stalls while the page is being erased and programmed, which takes about 20 milliseconds
+        const uint32_t programLength = (8 + autostartConfig.length + 3) & ~3;
+        return (FlashMainPageErase(AUTOSTART_PAGE_ADDRESS) == 0)
+            && (FlashMainPageProgram(reinterpret_cast<uint32_t*>(&autostartConfig), AUTOSTART_PAGE_ADDRESS, programLength) == 0);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Autostart::attach()
+    {
+        if (!autostartAttachPending)
+        {
+            SerialSend::sendResumePacket(false);
+            return;
+        }
+
+        // The READY message tells the host everything that it would otherwise have learned when it started the capture
+        autostartAttachPending = false;
+        FlashLog::hostActive();
+        SerialSend::sendReadyPacket();
+        SerialSend::sendResumePacket(true);
+    }
+}
@@ -0,0 +1,58 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_AUTOSTART_HPP
+#define SNIFFER_AUTOSTART_HPP
+
+#include "sniffer_global.hpp"
+
+// The configuration has its own page between the flash log and the page that contains the CCA
+#define AUTOSTART_PAGE_ADDRESS  0x0027F000
+
+namespace Sniffer
+{
+    namespace AutostartCommand
+    {
+        enum AutostartCommand
+        {
+            Clear  = 0, // Remove the configuration from the flash, the OpenMote waits for a host again after booting
+            Save   = 1, // Store the configuration of the current capture, which is started with it after booting
+            Attach = 2  // Let the host take over the capture that was started after booting
+        };
+    }
+
+    // The messages that configured the current capture are kept, so that they can be stored in the flash and handled again
+    // after booting. The capture then runs without a host, the records stay in the buffer (or go to the flash log when it
+    // was enabled) until a host attaches to it.
+    class Autostart
+    {
+    public:
+        // Start capturing with the configuration that was stored in the flash, called at startup before the serial task runs
+        static void start();
+
+        // Execute a command of an AUTOSTART message, returns false when the command is unknown or the configuration wasn't stored
+        static bool command(uint8_t cmd);
+
+        // Forget the configuration of the previous capture, called when a RESET, SURVEY or SUMMARY message starts a new one
+        static void captureStarted();
+
+        // Add a message that the host sent to the configuration, when it is one that configures the capture
+        static void record(const uint8_t* msg);
+
+        // Check whether the capture started by itself and no host attached to it yet, the records are held back until then
+        static bool isAttachPending();
+
+    private:
+        // Write the configuration to its page in the flash
+        static bool save();
+
+        // Answer an ATTACH message and let the records go to the host
+        static void attach();
+    };
+}
+
+#endif // SNIFFER_AUTOSTART_HPP
@@ -0,0 +1,289 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_channel_hopping.hpp"
+#include "sniffer_radio.hpp"
+#include "sniffer_inject.hpp"
+#include "sniffer_survey.hpp"
+#include "sniffer_tsch.hpp"
+#include "sniffer_superframe.hpp"
+#include "sniffer_serial_send.hpp"
+
+namespace Sniffer
+{
+    uint8_t  hopChannels[HOP_MAX_CHANNELS];
+    uint16_t hopDwellTimes[HOP_MAX_CHANNELS];
+    uint16_t hopReceivedEntries = 0; // Bit for every entry of the schedule that was received
+    uint8_t  hopEntryCount = 0;
+    uint8_t  hopCurrentEntry = 0;
+    uint8_t  hopSwitchChannel = 0; // Channel of the SET_CHANNEL message that is waiting for the end of a frame
+
+    // Adaptive dwell times, only used when the minimum dwell time isn't 0
+    uint16_t hopMinDwellTime = 0;
+    uint32_t hopCycleTime;                        // Sum of the dwell times of the HOP messages
+    uint16_t hopFrameRates[HOP_MAX_CHANNELS];     // Average frames per second in steps of 1/16
+    int8_t   hopEnergy[HOP_MAX_CHANNELS];         // Average RSSI in dBm when leaving the channel
+    volatile uint16_t hopFrameCount;              // Frames received since the radio was tuned to the current entry
+    uint32_t hopTuneTime;                         // Time at which the radio was tuned to the current entry
+    uint32_t hopLastReportTime;
+    uint8_t  hopReport[ADAPTIVE_HOP_REPORT_LENGTH];
+    bool     hopReportPending = false;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool ChannelHopping::setEntry(const uint8_t* data)
+    {
+        const uint8_t entry = data[HOP_ENTRY_OFFSET];
+        const uint8_t entryCount = data[HOP_ENTRY_COUNT_OFFSET];
+        const uint8_t channel = data[HOP_CHANNEL_OFFSET];
+        const uint16_t dwellTime = readUint16((uint8_t*)data, HOP_DWELL_TIME_OFFSET);
+        if ((entryCount == 0) || (entryCount > HOP_MAX_CHANNELS) || (entry >= entryCount)
+         || (channel < 11) || (channel > 26) || (dwellTime < HOP_MIN_DWELL_TIME))
+            return false;
+
+        // The injected frames are send on the current channel and use the timer interrupt
+        if (Inject::isActive())
+            return false;
+
+        // A schedule with another length replaces the one that was being received or used
+        if (entryCount != hopEntryCount)
+        {
+            stop();
+            hopEntryCount = entryCount;
+        }
+
+        hopChannels[entry] = channel;
+        hopDwellTimes[entry] = dwellTime;
+        hopReceivedEntries |= (1 << entry);
+
+        // Start hopping once the whole schedule is known
+        if ((entry == entryCount - 1) && (hopReceivedEntries == (1 << entryCount) - 1))
+        {
+            Radio::disableTimerInterrupt();
+            hopMinDwellTime = 0;
+            hopCurrentEntry = 0;
+            tuneToCurrentEntry();
+            Radio::enableTimerInterrupt(ChannelHopping::timerInterruptHandler);
+        }
+
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool ChannelHopping::setAdaptive(const uint8_t* message)
+    {
+        // The schedule has to be complete, so that its cycle time is known and all entries are visited at least once per cycle
+        const uint16_t minDwellTime = readUint16((uint8_t*)message, ADAPTIVE_HOP_MIN_DWELL_OFFSET);
+        if ((hopEntryCount == 0) || (hopReceivedEntries != (1 << hopEntryCount) - 1) || (minDwellTime < HOP_MIN_DWELL_TIME))
+            return false;
+
+        uint32_t cycleTime = 0;
+        for (uint8_t i = 0; i < hopEntryCount; ++i)
+            cycleTime += hopDwellTimes[i];
+        if (static_cast<uint32_t>(minDwellTime) * hopEntryCount > cycleTime)
+            return false;
+
+        // The timer interrupt uses the averages, which start as if the channels were idle
+        const uint32_t interruptMask = enterCriticalSection();
+        for (uint8_t i = 0; i < hopEntryCount; ++i)
+        {
+            hopFrameRates[i] = 0;
+            hopEnergy[i] = HOP_ADAPTIVE_ENERGY_THRESHOLD;
+        }
+        hopCycleTime = cycleTime;
+        hopMinDwellTime = minDwellTime;
+        hopLastReportTime = Radio::getCurrentTime();
+        leaveCriticalSection(interruptMask);
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION void ChannelHopping::frameReceived()
+    {
+        hopFrameCount++;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void ChannelHopping::sendPeriodically()
+    {
+        uint8_t report[ADAPTIVE_HOP_REPORT_LENGTH];
+        uint8_t reportLength = 0;
+        const uint32_t interruptMask = enterCriticalSection();
+        if (hopReportPending)
+        {
+            reportLength = 1 + hopReport[0] * ADAPTIVE_HOP_ENTRY_LENGTH;
+            for (uint8_t i = 0; i < reportLength; ++i)
+                report[i] = hopReport[i];
+            hopReportPending = false;
+        }
+        leaveCriticalSection(interruptMask);
+
+        if (reportLength > 0)
+            SerialSend::sendMessage(SerialDataType::AdaptiveHop, report, reportLength);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void ChannelHopping::stop()
+    {
+        Radio::disableTimerInterrupt();
+        Tsch::stop();
+        Superframe::stop();
+
+        hopReceivedEntries = 0;
+        hopEntryCount = 0;
+        hopCurrentEntry = 0;
+        hopMinDwellTime = 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool ChannelHopping::switchChannel(const uint8_t* message)
+    {
+        // The survey changes the channel itself and also uses the timer interrupt, just like injecting frames
+        const uint8_t channel = message[SET_CHANNEL_OFFSET];
+        if ((channel < 11) || (channel > 26) || Survey::isRunning() || Inject::isActive())
+            return false;
+
+        // The channel is changed from the timer interrupt, which can't occur in the middle of the radio interrupt
+        stop();
+        hopSwitchChannel = channel;
+        Radio::enableTimerInterrupt(ChannelHopping::switchInterruptHandler);
+        Radio::scheduleTimerInterrupt(MAC_TIMER_MIN_COMPARE_DELAY);
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void ChannelHopping::switchInterruptHandler()
+    {
+        // Never switch channel in the middle of a packet, the records that were already captured are not affected
+        if (Radio::isReceiving())
+        {
+            Radio::scheduleTimerInterrupt(HOP_MIN_DWELL_TIME);
+            return;
+        }
+
+        Radio::disableTimerInterrupt();
+        IntPendClear(INT_MACTIMR);
+        HWREG(RFCORE_SFR_MTIRQF) = 0;
+
+        const uint8_t previousChannel = Radio::getChannel();
+        tune(hopSwitchChannel);
+        Radio::storeChannelMarker(previousChannel);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void ChannelHopping::timerInterruptHandler()
+    {
+        // Never switch channel in the middle of a packet, try again a bit later instead
+        if (Radio::isReceiving())
+        {
+            Radio::scheduleTimerInterrupt(HOP_MIN_DWELL_TIME);
+            return;
+        }
+
+        if (hopMinDwellTime > 0)
+            observeCurrentEntry();
+
+        hopCurrentEntry++;
+        if (hopCurrentEntry >= hopEntryCount)
+        {
+            hopCurrentEntry = 0;
+            if (hopMinDwellTime > 0)
+                updateDwellTimes();
+        }
+
+        tuneToCurrentEntry();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void ChannelHopping::tuneToCurrentEntry()
+    {
+        tune(hopChannels[hopCurrentEntry]);
+        Radio::scheduleTimerInterrupt(hopDwellTimes[hopCurrentEntry]);
+
+        hopFrameCount = 0;
+        hopTuneTime = Radio::getCurrentTime();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void ChannelHopping::observeCurrentEntry()
+    {
+        // The time on the channel is measured, as a hop is delayed while a frame is being received
+        const uint32_t elapsed = Radio::getCurrentTime() - hopTuneTime;
+        if (elapsed > 0)
+        {
+            uint32_t rate = static_cast<uint32_t>((static_cast<uint64_t>(hopFrameCount) * 16000000) / elapsed);
+            rate = (3 * static_cast<uint32_t>(hopFrameRates[hopCurrentEntry]) + rate) / 4;
+            hopFrameRates[hopCurrentEntry] = (rate > 0xFFFF) ? 0xFFFF : rate;
+        }
+
+        // No frame is being received, so the RSSI is the energy of whatever else uses the channel
+        if (HWREG(RFCORE_XREG_RSSISTAT) & RFCORE_XREG_RSSISTAT_RSSI_VALID)
+        {
+            const int16_t rssi = ((int8_t)HWREG(RFCORE_XREG_RSSI)) - CC2538_RF_RSSI_OFFSET;
+            hopEnergy[hopCurrentEntry] = (3 * hopEnergy[hopCurrentEntry] + rssi) / 4;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void ChannelHopping::updateDwellTimes()
+    {
+        uint32_t weights[HOP_MAX_CHANNELS];
+        uint32_t totalWeight = 0;
+        for (uint8_t i = 0; i < hopEntryCount; ++i)
+        {
+            weights[i] = HOP_ADAPTIVE_IDLE_WEIGHT + hopFrameRates[i];
+            if (hopEnergy[i] > HOP_ADAPTIVE_ENERGY_THRESHOLD)
+                weights[i] += (hopEnergy[i] - HOP_ADAPTIVE_ENERGY_THRESHOLD) * 16;
+            totalWeight += weights[i];
+        }
+
+        // Every entry keeps the minimum dwell time, the rest of the cycle goes to the entries with activity
+        const uint32_t spareTime = hopCycleTime - static_cast<uint32_t>(hopMinDwellTime) * hopEntryCount;
+        for (uint8_t i = 0; i < hopEntryCount; ++i)
+        {
+            const uint32_t dwellTime = hopMinDwellTime + static_cast<uint32_t>((static_cast<uint64_t>(spareTime) * weights[i]) / totalWeight);
+            hopDwellTimes[i] = (dwellTime > 0xFFFF) ? 0xFFFF : dwellTime;
+        }
+
+        const uint32_t now = Radio::getCurrentTime();
+        if (now - hopLastReportTime < HOP_ADAPTIVE_REPORT_INTERVAL)
+            return;
+
+        hopLastReportTime = now;
+        hopReport[0] = hopEntryCount;
+        for (uint8_t i = 0; i < hopEntryCount; ++i)
+        {
+            uint8_t* entry = &hopReport[1 + i * ADAPTIVE_HOP_ENTRY_LENGTH];
+            entry[0] = hopChannels[i];
+            writeUint16(entry, 1, hopDwellTimes[i]);
+            writeUint16(entry, 3, hopFrameRates[i]);
+            entry[5] = static_cast<uint8_t>(hopEnergy[i]);
+        }
+        hopReportPending = true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void ChannelHopping::tune(uint8_t channel)
+    {
+        // The new frequency only takes effect after the radio recalibrates when it is turned on again
+        Radio::setChannel(channel);
+        CC2538_RF_CSP_ISRFOFF();
+        CC2538_RF_CSP_ISFLUSHRX();
+        CC2538_RF_CSP_ISRXON();
+    }
+}
@@ -0,0 +1,57 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_CHANNEL_HOPPING_HPP
+#define SNIFFER_CHANNEL_HOPPING_HPP
+
+#include "sniffer_global.hpp"
+
+namespace Sniffer
+{
+    class ChannelHopping
+    {
+    public:
+        // Store an entry of the schedule that was received from the host (in the format of the HOP message)
+        static bool setEntry(const uint8_t* data);
+
+        // Divide the time of the schedule over its channels by their activity, with the minimum dwell time of the ADAPTIVE_HOP message
+        static bool setAdaptive(const uint8_t* message);
+
+        // Count a frame that was received on the current channel, called from the radio interrupt
+        static void frameReceived();
+
+        // Send the dwell times and the activity of the channels to the host when they are due, called from the serial task
+        static void sendPeriodically();
+
+        // Stop hopping and forget the schedule, also when following a TSCH network. The radio stays on the current channel.
+        static void stop();
+
+        // Stop hopping and move to the channel from a SET_CHANNEL message as soon as no frame is being received
+        static bool switchChannel(const uint8_t* message);
+
+        // Function called when the MAC timer overflow counter reaches the compare value
+        static void timerInterruptHandler();
+
+        // Function called by the MAC timer compare interrupt while waiting for the end of a frame to switch the channel
+        static void switchInterruptHandler();
+
+    private:
+        // Tune the radio to the current entry of the schedule and set the time at which the next hop should occur
+        static void tuneToCurrentEntry();
+
+        // Average the frames and the energy that were seen during the dwell time of the current entry
+        static void observeCurrentEntry();
+
+        // Divide the time of the next cycle over the entries, called when the schedule starts again at its first entry
+        static void updateDwellTimes();
+
+        // Recalibrate the radio on a new channel, the RX FIFO is flushed
+        static void tune(uint8_t channel);
+    };
+}
+
+#endif // SNIFFER_CHANNEL_HOPPING_HPP
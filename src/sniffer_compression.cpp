@@ -0,0 +1,181 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_compression.hpp"
+#include "sniffer_statistics.hpp"
+#include "sniffer_decryption.hpp"
+#include "sniffer_survey.hpp"
+#include "sniffer_zep.hpp"
+
+#define COMPRESSION_BITMAP_LEN  ((COMPRESSION_MAX_HEADER_LEN + 7) / 8)
+
+namespace Sniffer
+{
+    struct CompressionContext
+    {
+        uint8_t  header[COMPRESSION_MAX_HEADER_LEN];
+        uint16_t seqNr;     // Sequence number of the record that contains the header
+        uint8_t  length;    // Length of the header, 0 when the context is unused
+    };
+
+    bool compressionEnabled = false;
+    uint8_t compressionNextContext = 0; // Contexts are replaced in a round robin
+    CompressionContext compressionContexts[COMPRESSION_CONTEXTS];
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void compressionClear()
+    {
+        for (uint8_t i = 0; i < COMPRESSION_CONTEXTS; ++i)
+            compressionContexts[i].length = 0;
+
+        compressionNextContext = 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Length of the frame control field, sequence number and addressing fields, 0 for frames that aren't compressed.
+    // The auxiliary security header and the header IEs of newer frame versions count as payload.
+    inline uint8_t compressionHeaderLength(const uint8_t* frame, uint8_t frameLength)
+    {
+        if (frameLength < 3)
+            return 0;
+
+        const uint16_t frameControl = frame[0] | (frame[1] << 8);
+        const bool panIdCompression = (frameControl >> 6) & 0x01;
+        const uint8_t dstAddrMode = (frameControl >> 10) & 0x03;
+        const uint8_t frameVersion = (frameControl >> 12) & 0x03;
+        const uint8_t srcAddrMode = (frameControl >> 14) & 0x03;
+        if ((frameVersion > 1) || (dstAddrMode == 1) || (srcAddrMode == 1))
+            return 0;
+
+        uint8_t length = 3;
+        if (dstAddrMode >= 2)
+            length += 2 + ((dstAddrMode == 2) ? 2 : 8);
+        if (srcAddrMode >= 2)
+            length += (panIdCompression ? 0 : 2) + ((srcAddrMode == 2) ? 2 : 8);
+
+        return (length <= frameLength) ? length : 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Compression::enable(const uint8_t* message)
+    {
+        // ZEP packets and survey samples always contain the whole frame
+        if (Zep::isEnabled() || Survey::isRunning())
+            return false;
+
+        // The radio interrupt uses the contexts
+        const uint32_t interruptMask = enterCriticalSection();
+        compressionClear();
+        compressionEnabled = (message[COMPRESSION_ENABLED_OFFSET] != 0);
+        leaveCriticalSection(interruptMask);
+
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Compression::disable()
+    {
+        compressionEnabled = false;
+        compressionClear();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Compression::isEnabled()
+    {
+        return compressionEnabled;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION uint8_t Compression::processRecord(uint8_t fullPacketLength)
+    {
+        if (!compressionEnabled)
+            return fullPacketLength;
+
+        // The frame might have been truncated, only a header that was kept completely can be compressed
+        uint8_t* record = &buffer[bufferIndexRadio];
+        uint8_t* frame = &record[BUFFER_EXTRA_BYTES];
+        const uint8_t frameLength = fullPacketLength - BUFFER_EXTRA_BYTES - 2;
+        const uint8_t headerLength = compressionHeaderLength(frame, frameLength);
+        if (headerLength == 0)
+            return fullPacketLength;
+
+        // Find the recent header with the same length that differs in the least bytes
+        const uint16_t recordSeqNr = readUint16(record, BUFFER_SEQNR_OFFSET);
+        uint8_t bestContext = COMPRESSION_CONTEXTS;
+        uint8_t bestDifferences = headerLength;
+        for (uint8_t i = 0; i < COMPRESSION_CONTEXTS; ++i)
+        {
+            const CompressionContext& context = compressionContexts[i];
+            const uint16_t distance = recordSeqNr - context.seqNr;
+            if ((context.length != headerLength) || (distance == 0) || (distance >= DUPLICATE_MAX_DISTANCE))
+                continue;
+
+            uint8_t differences = 0;
+            for (uint8_t j = 0; j < headerLength; ++j)
+                differences += (frame[j] != context.header[j]);
+
+            if (differences < bestDifferences)
+            {
+                bestContext = i;
+                bestDifferences = differences;
+            }
+        }
+
+        // Build the compressed header before the context that it refers to could be replaced by this header.
+        // Secured frames are left alone when they still have to be decrypted, which needs the whole frame.
+        uint8_t encoded[2 + COMPRESSION_BITMAP_LEN + COMPRESSION_MAX_HEADER_LEN];
+        const uint8_t bitmapLength = (headerLength + 7) / 8;
+        uint8_t encodedLength = 0;
+        if ((bestContext != COMPRESSION_CONTEXTS) && (2 + bitmapLength + bestDifferences < headerLength)
+         && !((frame[0] & 0x08) && Decryption::isEnabled()))
+        {
+            const CompressionContext& context = compressionContexts[bestContext];
+            encoded[0] = static_cast<uint8_t>(recordSeqNr - context.seqNr);
+            encoded[1] = headerLength;
+            for (uint8_t i = 0; i < bitmapLength; ++i)
+                encoded[2 + i] = 0;
+
+            encodedLength = 2 + bitmapLength;
+            for (uint8_t i = 0; i < headerLength; ++i)
+            {
+                if (frame[i] != context.header[i])
+                {
+                    encoded[2 + i / 8] |= 1 << (i % 8);
+                    encoded[encodedLength++] = frame[i];
+                }
+            }
+        }
+
+        CompressionContext& context = compressionContexts[compressionNextContext];
+        for (uint8_t i = 0; i < headerLength; ++i)
+            context.header[i] = frame[i];
+        context.seqNr = recordSeqNr;
+        context.length = headerLength;
+        compressionNextContext = (compressionNextContext + 1) % COMPRESSION_CONTEXTS;
+
+        if (encodedLength == 0)
+            return fullPacketLength;
+
+        // Put the compressed header in front of the payload, which moves back together with the RSSI and CRC/LQI bytes
+        const uint8_t removedBytes = headerLength - encodedLength;
+        for (uint8_t i = 0; i < encodedLength; ++i)
+            frame[i] = encoded[i];
+        for (uint8_t i = headerLength; i < frameLength + 2; ++i)
+            frame[i - removedBytes] = frame[i];
+
+        record[0] = fullPacketLength - removedBytes;
+        record[BUFFER_CHANNEL_OFFSET] |= BUFFER_CHANNEL_COMPRESSED;
+        statistics.compressedBytes += removedBytes;
+        return fullPacketLength - removedBytes;
+    }
+}
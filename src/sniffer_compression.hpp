@@ -0,0 +1,36 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_COMPRESSION_HPP
+#define SNIFFER_COMPRESSION_HPP
+
+#include "sniffer_global.hpp"
+
+namespace Sniffer
+{
+    // Keeps the MAC headers of the last COMPRESSION_CONTEXTS frames, so that the header of a new frame can be send as the
+    // bytes in which it differs from the most similar one. The host finds the same header in the record with the sequence
+    // number that the compressed record refers to, which stays valid when records are send again.
+    class Compression
+    {
+    public:
+        // Start or stop compressing the headers as requested in the COMPRESSION message, returns false when not possible
+        static bool enable(const uint8_t* message);
+
+        // Stop compressing and forget the headers, called when the buffer is reset
+        static void disable();
+
+        // Check whether the headers are being compressed
+        static bool isEnabled();
+
+        // Called from the radio interrupt for the record at the radio index once it has its final contents.
+        // Replaces the header by its difference with an earlier one when that is shorter, returns the new record length.
+        static uint8_t processRecord(uint8_t fullPacketLength);
+    };
+}
+
+#endif // SNIFFER_COMPRESSION_HPP
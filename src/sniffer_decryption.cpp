@@ -0,0 +1,258 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_decryption.hpp"
+#include "sniffer_encryption.hpp"
+
+#include "libcc2538_sys_ctrl.h"
+#include "libcc2538_aes.h"
+#include "libcc2538_ccm.h"
+
+#define DECRYPTION_NONCE_LEN    13  // Extended source address + 4 bytes frame counter + security level
+#define DECRYPTION_CCM_L        2   // Length of the length field in CCM*, 15 - DECRYPTION_NONCE_LEN
+
+namespace Sniffer
+{
+    struct DecryptionKey
+    {
+        uint8_t  fields; // Which fields have to match (DECRYPTION_MATCH_* flags), 0 when the key is unused
+        uint16_t pan;
+        uint8_t  shortAddr[2]; // Big endian
+        uint8_t  extAddr[8]; // Big endian, used in the nonce of frames with a short source address
+    };
+
+    DecryptionKey decryptionKeys[DECRYPTION_MAX_KEYS];
+    bool          decryptionEnabled = false;
+
+    // The engine writes the plaintext over the ciphertext, which is first copied here so that the record
+    // still contains the original frame when the MIC turns out to be wrong
+    uint8_t decryptionData[CC2538_RF_MAX_PACKET_LEN];
+    uint8_t decryptionNonce[DECRYPTION_NONCE_LEN];
+    uint8_t decryptionMic[16];
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Decryption::initialize()
+    {
+        SysCtrlPeripheralEnable(SYS_CTRL_PERIPH_AES);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Decryption::clear()
+    {
+        for (uint8_t i = 0; i < DECRYPTION_MAX_KEYS; ++i)
+            decryptionKeys[i].fields = 0;
+
+        decryptionEnabled = false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Decryption::setKey(const uint8_t* data)
+    {
+        const uint8_t slot = data[KEY_SLOT_OFFSET];
+        if ((slot >= DECRYPTION_MAX_KEYS) || ((slot == ENCRYPTION_KEY_AREA) && Encryption::isEnabled()))
+            return false;
+
+        // A short source address can't be used in the nonce, the extended address from the key replaces it then
+        const uint8_t fields = data[KEY_FIELDS_OFFSET];
+        if ((fields & DECRYPTION_MATCH_SHORT_ADDR) && (fields & DECRYPTION_MATCH_EXT_ADDR))
+            return false;
+
+        if (AESLoadKey((uint8_t*)&data[KEY_KEY_OFFSET], slot) != AES_SUCCESS)
+            return false;
+
+        DecryptionKey& key = decryptionKeys[slot];
+        key.fields = fields;
+        key.pan = readUint16((uint8_t*)data, KEY_PAN_OFFSET);
+        for (uint8_t i = 0; i < 2; ++i)
+            key.shortAddr[i] = data[KEY_SHORT_ADDR_OFFSET + i];
+        for (uint8_t i = 0; i < 8; ++i)
+            key.extAddr[i] = data[KEY_EXT_ADDR_OFFSET + i];
+
+        updateEnabled();
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Decryption::removeKey(uint8_t slot)
+    {
+        decryptionKeys[slot].fields = 0;
+        updateEnabled();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Decryption::updateEnabled()
+    {
+        decryptionEnabled = false;
+        for (uint8_t i = 0; i < DECRYPTION_MAX_KEYS; ++i)
+        {
+            if (decryptionKeys[i].fields != 0)
+                decryptionEnabled = true;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Decryption::isEnabled()
+    {
+        return decryptionEnabled;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Decryption::decryptRecord(uint16_t index)
+    {
+        if (buffer[index + BUFFER_CHANNEL_OFFSET] & BUFFER_CHANNEL_DECRYPTED)
+            return;
+
+        // The whole frame is needed for the MIC, and a frame with a wrong FCS won't match it anyway.
+        // A descriptor behind the frame isn't part of it.
+        const uint8_t originalLength = buffer[index + BUFFER_ORIGINAL_LENGTH_OFFSET];
+        const uint8_t dataLength = bufferRecordDataLength(index)
+                                 - ((originalLength & BUFFER_ORIGINAL_LENGTH_DESCRIPTOR) ? DESCRIPTOR_LENGTH : 0);
+        if ((dataLength != (originalLength & ~BUFFER_ORIGINAL_LENGTH_DESCRIPTOR))
+         || !(buffer[index + BUFFER_EXTRA_BYTES + dataLength - 1] & 0x80))
+            return;
+
+        // The last two bytes are the RSSI and CRC bytes that replaced the FCS
+        uint8_t* frame = &buffer[index + BUFFER_EXTRA_BYTES];
+        const uint8_t frameLength = dataLength - 2;
+        if (frameLength < 3)
+            return;
+
+        // Only data and command frames with the security of 802.15.4-2006 (frame version 1) are decrypted
+        const uint16_t frameControl = frame[0] | (frame[1] << 8);
+        const uint8_t frameType = frameControl & 0x07;
+        const bool securityEnabled = (frameControl >> 3) & 0x01;
+        const bool panIdCompression = (frameControl >> 6) & 0x01;
+        const uint8_t dstAddrMode = (frameControl >> 10) & 0x03;
+        const uint8_t frameVersion = (frameControl >> 12) & 0x03;
+        const uint8_t srcAddrMode = (frameControl >> 14) & 0x03;
+        if (!securityEnabled || (frameVersion != 1) || ((frameType != 1) && (frameType != 3)) || (srcAddrMode < 2))
+            return;
+
+        uint8_t pos = 3; // Frame control field and sequence number
+        uint16_t dstPan = 0;
+        if (dstAddrMode >= 2)
+        {
+            if (pos + 2 > frameLength)
+                return;
+
+            dstPan = frame[pos] | (frame[pos+1] << 8);
+            pos += 2 + ((dstAddrMode == 2) ? 2 : 8);
+        }
+
+        uint16_t srcPan = dstPan;
+        if (!panIdCompression)
+        {
+            if (pos + 2 > frameLength)
+                return;
+
+            srcPan = frame[pos] | (frame[pos+1] << 8);
+            pos += 2;
+        }
+
+        const uint8_t srcAddrLen = (srcAddrMode == 2) ? 2 : 8;
+        const uint8_t* srcAddr = &frame[pos];
+        pos += srcAddrLen;
+
+        // Auxiliary security header: security control, frame counter and the key identifier
+        if (pos + 5 > frameLength)
+            return;
+
+        const uint8_t securityLevel = frame[pos] & 0x07;
+        const uint8_t keyIdMode = (frame[pos] >> 3) & 0x03;
+        const uint8_t* frameCounter = &frame[pos + 1];
+        pos += 5 + ((keyIdMode == 0) ? 0 : (keyIdMode == 1) ? 1 : (keyIdMode == 2) ? 5 : 9);
+
+        // The command frame identifier is part of the authenticated header, only the command payload is encrypted.
+        // Frames without encryption don't need anything from us, and the engine can't check a MIC of 0 bytes.
+        if (frameType == 3)
+            pos++;
+
+        const uint8_t micLength = 2 << (securityLevel & 0x03);
+        if ((securityLevel < 5) || (pos + micLength > frameLength))
+            return;
+
+        const uint8_t slot = findKey(srcPan, srcAddrLen, srcAddr);
+        if (slot == DECRYPTION_MAX_KEYS)
+            return;
+
+        // Nonce: extended source address (big endian), frame counter (big endian) and the security level
+        for (uint8_t i = 0; i < 8; ++i)
+            decryptionNonce[i] = (srcAddrLen == 8) ? srcAddr[7 - i] : decryptionKeys[slot].extAddr[i];
+        for (uint8_t i = 0; i < 4; ++i)
+            decryptionNonce[8 + i] = frameCounter[3 - i];
+        decryptionNonce[12] = securityLevel;
+
+        const uint8_t encryptedLength = frameLength - pos;
+        for (uint8_t i = 0; i < encryptedLength; ++i)
+            decryptionData[i] = frame[pos + i];
+
+        // The engine reads the header and the ciphertext with its own DMA, the UART is meanwhile still sending the previous packet
+        if (CCMInvAuthDecryptStart(true, micLength, decryptionNonce, decryptionData, encryptedLength,
+                                   frame, pos, slot, decryptionMic, DECRYPTION_CCM_L, false) != AES_SUCCESS)
+            return;
+
+        while (!CCMInvAuthDecryptCheckResult())
+            ;
+
+        if (CCMInvAuthDecryptGetResult(micLength, decryptionData, encryptedLength, decryptionMic) != AES_SUCCESS)
+            return;
+
+        // The MIC stays in the frame so that the length of the record doesn't change, the host removes it
+        for (uint8_t i = 0; i < encryptedLength - micLength; ++i)
+            frame[pos + i] = decryptionData[i];
+
+        buffer[index + BUFFER_CHANNEL_OFFSET] |= BUFFER_CHANNEL_DECRYPTED;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint8_t Decryption::findKey(uint16_t srcPan, uint8_t srcAddrLen, const uint8_t* srcAddr)
+    {
+        for (uint8_t i = 0; i < DECRYPTION_MAX_KEYS; ++i)
+        {
+            const DecryptionKey& key = decryptionKeys[i];
+            if (key.fields == 0)
+                continue;
+
+            if ((key.fields & DECRYPTION_MATCH_PAN) && (srcPan != key.pan))
+                continue;
+
+            // Without an extended source address in the frame, only a key with the extended address of that source will do
+            if (key.fields & DECRYPTION_MATCH_SHORT_ADDR)
+            {
+                if ((srcAddrLen != 2) || (srcAddr[1] != key.shortAddr[0]) || (srcAddr[0] != key.shortAddr[1]))
+                    continue;
+            }
+            else if (srcAddrLen != 8)
+                continue;
+
+            if (key.fields & DECRYPTION_MATCH_EXT_ADDR)
+            {
+                bool match = true;
+                for (uint8_t j = 0; j < 8; ++j)
+                {
+                    if (srcAddr[7 - j] != key.extAddr[j])
+                        match = false;
+                }
+
+                if (!match)
+                    continue;
+            }
+
+            return i;
+        }
+
+        return DECRYPTION_MAX_KEYS;
+    }
+}
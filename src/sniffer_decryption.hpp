@@ -0,0 +1,48 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_DECRYPTION_HPP
+#define SNIFFER_DECRYPTION_HPP
+
+#include "sniffer_global.hpp"
+
+namespace Sniffer
+{
+    // Decrypts the secured frames (802.15.4-2006 security, levels ENC-MIC-32 to ENC-MIC-128) with the AES engine
+    // before they are send to the host. Each key is stored in its own area of the key store of the engine.
+    class Decryption
+    {
+    public:
+        // Enable the clock of the AES engine
+        static void initialize();
+
+        // Remove all keys, which means that no frame is decrypted anymore
+        static void clear();
+
+        // Store the key that was received from the host (in the format of the KEY message)
+        static bool setKey(const uint8_t* data);
+
+        // Stop using the key in the area, which then holds the key with which the records are encrypted
+        static void removeKey(uint8_t slot);
+
+        // Check whether there are any keys, so that the serial task doesn't have to look at the frames otherwise
+        static bool isEnabled();
+
+        // Decrypt the frame in the buffer record in place and mark the record as decrypted. Nothing changes when there is
+        // no matching key, when the frame was truncated or when the MIC is wrong. Decrypted records are skipped.
+        static void decryptRecord(uint16_t index);
+
+    private:
+        // Decryption is only active while there is at least one key
+        static void updateEnabled();
+
+        // Find the key for the source of the frame, returns DECRYPTION_MAX_KEYS when there is none
+        static uint8_t findKey(uint16_t srcPan, uint8_t srcAddrLen, const uint8_t* srcAddr);
+    };
+}
+
+#endif // SNIFFER_DECRYPTION_HPP
@@ -0,0 +1,88 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_descriptor.hpp"
+#include "sniffer_zep.hpp"
+
+namespace Sniffer
+{
+    bool descriptorEnabled = false;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Descriptor::enable(const uint8_t* message)
+    {
+        // ZEP packets contain nothing but the frame
+        if (Zep::isEnabled())
+            return false;
+
+        descriptorEnabled = (message[DESCRIPTOR_ENABLED_OFFSET] != 0);
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Descriptor::disable()
+    {
+        descriptorEnabled = false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Descriptor::isEnabled()
+    {
+        return descriptorEnabled;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION uint16_t Descriptor::parseFrame(const uint8_t* frame, uint8_t length)
+    {
+        if (!descriptorEnabled)
+            return 0;
+
+        // The last two bytes are the RSSI and CRC/LQI, a frame needs at least its frame control field to be described
+        if (length < 4)
+            return 0x0007; // Reserved frame type, header length 0
+
+        const uint16_t frameControl = frame[0] | (frame[1] << 8);
+        const uint8_t frameType = frameControl & 0x07;
+        const bool securityEnabled = (frameControl >> 3) & 0x01;
+        const bool panIdCompression = (frameControl >> 6) & 0x01;
+        const uint8_t dstAddrMode = (frameControl >> 10) & 0x03;
+        const uint8_t frameVersion = (frameControl >> 12) & 0x03;
+        const uint8_t srcAddrMode = (frameControl >> 14) & 0x03;
+
+        // Frames of 802.15.4-2015 leave out PAN identifiers in other combinations, their header isn't measured here
+        uint8_t headerLength = 3;
+        if (dstAddrMode >= 2)
+            headerLength += 2 + ((dstAddrMode == 2) ? 2 : 8);
+        if (srcAddrMode >= 2)
+            headerLength += (panIdCompression ? 0 : 2) + ((srcAddrMode == 2) ? 2 : 8);
+        if ((frameVersion > 1) || (dstAddrMode == 1) || (srcAddrMode == 1) || (headerLength > length - 2))
+            headerLength = 0;
+
+        const uint8_t firstByte = frameType | (securityEnabled << 3) | (dstAddrMode << 4) | (srcAddrMode << 6);
+        const uint8_t secondByte = headerLength | (frameVersion << 5) | (panIdCompression << 7);
+        return (firstByte << 8) | secondByte;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION uint8_t Descriptor::processRecord(uint8_t fullPacketLength, uint16_t descriptor)
+    {
+        if (descriptor == 0)
+            return fullPacketLength;
+
+        // The radio always reserves room for a descriptor behind a frame, it might have been enabled while the frame was copied
+        uint8_t* record = &buffer[bufferIndexRadio];
+        writeUint16(record, fullPacketLength, descriptor);
+        record[0] = fullPacketLength + DESCRIPTOR_LENGTH;
+        record[BUFFER_ORIGINAL_LENGTH_OFFSET] |= BUFFER_ORIGINAL_LENGTH_DESCRIPTOR;
+        return fullPacketLength + DESCRIPTOR_LENGTH;
+    }
+}
@@ -0,0 +1,39 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_DESCRIPTOR_HPP
+#define SNIFFER_DESCRIPTOR_HPP
+
+#include "sniffer_global.hpp"
+
+namespace Sniffer
+{
+    // Parses the frame control field once on the OpenMote, so that the host can look at the frame type, the address modes
+    // and the header length of a record without parsing the frame itself.
+    class Descriptor
+    {
+    public:
+        // Start or stop adding descriptors as requested in the DESCRIPTOR message, returns false when not possible
+        static bool enable(const uint8_t* message);
+
+        // Stop adding descriptors, called when the buffer is reset
+        static void disable();
+
+        // Check whether the records get a descriptor
+        static bool isEnabled();
+
+        // Called from the radio interrupt before the record is processed any further, the length includes the RSSI and
+        // CRC/LQI bytes. Returns the descriptor of the frame, or 0 when the records don't get one.
+        static uint16_t parseFrame(const uint8_t* frame, uint8_t length);
+
+        // Called from the radio interrupt for the record at the radio index once it has its final contents.
+        // Appends the descriptor that parseFrame returned, returns the new record length.
+        static uint8_t processRecord(uint8_t fullPacketLength, uint16_t descriptor);
+    };
+}
+
+#endif // SNIFFER_DESCRIPTOR_HPP
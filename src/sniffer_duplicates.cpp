@@ -0,0 +1,124 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_duplicates.hpp"
+#include "sniffer_statistics.hpp"
+#include "sniffer_survey.hpp"
+#include "sniffer_zep.hpp"
+
+#define DUPLICATE_FNV_OFFSET    2166136261u
+#define DUPLICATE_FNV_PRIME     16777619u
+
+namespace Sniffer
+{
+    struct DuplicateEntry
+    {
+        uint32_t hash;      // FNV-1a hash over the frame without the RSSI and CRC/LQI bytes
+        uint32_t timestamp; // Time of the SFD of the frame
+        uint16_t seqNr;     // Sequence number of the record that contains the frame
+        uint8_t  length;    // Length of the frame, 0 when the entry is unused
+    };
+
+    bool duplicatesEnabled = false;
+    uint8_t duplicatesNextEntry = 0; // Entries are replaced in a round robin
+    DuplicateEntry duplicateEntries[DUPLICATE_TABLE_SIZE];
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void duplicatesClear()
+    {
+        for (uint8_t i = 0; i < DUPLICATE_TABLE_SIZE; ++i)
+            duplicateEntries[i].length = 0;
+
+        duplicatesNextEntry = 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Duplicates::enable(const uint8_t* message)
+    {
+        // ZEP packets and survey samples are never references to other records
+        if (Zep::isEnabled() || Survey::isRunning())
+            return false;
+
+        // The radio interrupt uses the table
+        const uint32_t interruptMask = enterCriticalSection();
+        duplicatesClear();
+        duplicatesEnabled = (message[DUPLICATES_ENABLED_OFFSET] != 0);
+        leaveCriticalSection(interruptMask);
+
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Duplicates::disable()
+    {
+        duplicatesEnabled = false;
+        duplicatesClear();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Duplicates::isEnabled()
+    {
+        return duplicatesEnabled;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION uint8_t Duplicates::processRecord(uint8_t fullPacketLength)
+    {
+        if (!duplicatesEnabled)
+            return fullPacketLength;
+
+        // A frame with a wrong CRC might not be what was send, it is neither replaced nor remembered.
+        // The reference may not be longer than the record, the space for it was already reserved.
+        uint8_t* record = &buffer[bufferIndexRadio];
+        if (!(record[fullPacketLength - 1] & 0x80) || (fullPacketLength <= BUFFER_EXTRA_BYTES + DUPLICATE_MARKER_LEN))
+            return fullPacketLength;
+
+        const uint8_t* frame = &record[BUFFER_EXTRA_BYTES];
+        const uint8_t frameLength = fullPacketLength - BUFFER_EXTRA_BYTES - 2;
+        uint32_t hash = DUPLICATE_FNV_OFFSET;
+        for (uint8_t i = 0; i < frameLength; ++i)
+            hash = (hash ^ frame[i]) * DUPLICATE_FNV_PRIME;
+
+        const uint32_t timestamp = readUint32(record, BUFFER_TIMESTAMP_OFFSET);
+        const uint16_t recordSeqNr = readUint16(record, BUFFER_SEQNR_OFFSET);
+        for (uint8_t i = 0; i < DUPLICATE_TABLE_SIZE; ++i)
+        {
+            const DuplicateEntry& entry = duplicateEntries[i];
+            if ((entry.length != frameLength) || (entry.hash != hash))
+                continue;
+
+            // The host only remembers the last frames, and frames that come back much later aren't retries
+            if ((static_cast<uint16_t>(recordSeqNr - entry.seqNr) >= DUPLICATE_MAX_DISTANCE)
+             || (timestamp - entry.timestamp >= DUPLICATE_MAX_AGE))
+                continue;
+
+            // Keep the RSSI and CRC/LQI bytes of the retry behind the sequence number of the original.
+            // The original length stays, it is the length of the frame that the reference stands for.
+            record[BUFFER_EXTRA_BYTES + 2] = record[fullPacketLength - 2];
+            record[BUFFER_EXTRA_BYTES + 3] = record[fullPacketLength - 1];
+            writeUint16(record, BUFFER_EXTRA_BYTES, entry.seqNr);
+            record[BUFFER_CHANNEL_OFFSET] |= BUFFER_CHANNEL_DUPLICATE;
+            record[0] = BUFFER_EXTRA_BYTES + DUPLICATE_MARKER_LEN;
+
+            statistics.duplicatesReplaced++;
+            return BUFFER_EXTRA_BYTES + DUPLICATE_MARKER_LEN;
+        }
+
+        DuplicateEntry& entry = duplicateEntries[duplicatesNextEntry];
+        entry.hash = hash;
+        entry.timestamp = timestamp;
+        entry.seqNr = recordSeqNr;
+        entry.length = frameLength;
+        duplicatesNextEntry = (duplicatesNextEntry + 1) % DUPLICATE_TABLE_SIZE;
+        return fullPacketLength;
+    }
+}
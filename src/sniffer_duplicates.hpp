@@ -0,0 +1,36 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_DUPLICATES_HPP
+#define SNIFFER_DUPLICATES_HPP
+
+#include "sniffer_global.hpp"
+
+namespace Sniffer
+{
+    // Remembers a hash of the last DUPLICATE_TABLE_SIZE frames, so that MAC retries can be send to the host as a reference
+    // to the frame that they repeat. The source address and sequence number are part of the hashed MAC header, the FCS
+    // isn't: the radio replaces it by the RSSI and CRC/LQI bytes, which differ between the retries.
+    class Duplicates
+    {
+    public:
+        // Start or stop replacing duplicates as requested in the DUPLICATES message, returns false when not possible
+        static bool enable(const uint8_t* message);
+
+        // Stop replacing duplicates and forget the frames, called when the buffer is reset
+        static void disable();
+
+        // Check whether duplicates are being replaced
+        static bool isEnabled();
+
+        // Called from the radio interrupt for the record at the radio index after it passed the filter. A retry is replaced
+        // by a reference to the earlier record, other frames with a valid CRC are remembered. Returns the new record length.
+        static uint8_t processRecord(uint8_t fullPacketLength);
+    };
+}
+
+#endif // SNIFFER_DUPLICATES_HPP
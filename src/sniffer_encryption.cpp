@@ -0,0 +1,97 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_encryption.hpp"
+#include "sniffer_decryption.hpp"
+#include "sniffer_epoch.hpp"
+
+#include "libcc2538_aes.h"
+#include "libcc2538_ccm.h"
+
+#define ENCRYPTION_CCM_NONCE_LEN    13  // Nonce of the host + epoch + full sequence number + 0
+#define ENCRYPTION_CCM_L            2   // Length of the length field in CCM*, 15 - ENCRYPTION_CCM_NONCE_LEN
+
+namespace Sniffer
+{
+    bool encryptionEnabled = false;
+
+    // The engine reads and writes the records with DMA, so the copy is kept word aligned
+    uint8_t encryptionData[SERIAL_BATCH_MAX_DATA_LEN] __attribute__((aligned(4)));
+    uint8_t encryptionNonce[ENCRYPTION_CCM_NONCE_LEN];
+    uint8_t encryptionTag[16]; // Not part of the records, CCM* without a MIC only needs room for it
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Encryption::enable(const uint8_t* message)
+    {
+        encryptionEnabled = false;
+        if (message[ENCRYPTION_ENABLE_OFFSET] == 0)
+            return true;
+
+        // The key area can't hold a decryption key at the same time, the host gives those the other areas
+        Decryption::removeKey(ENCRYPTION_KEY_AREA);
+        if (AESLoadKey((uint8_t*)&message[ENCRYPTION_KEY_OFFSET], ENCRYPTION_KEY_AREA) != AES_SUCCESS)
+            return false;
+
+        for (uint8_t i = 0; i < ENCRYPTION_NONCE_LEN; ++i)
+            encryptionNonce[i] = message[ENCRYPTION_NONCE_OFFSET + i];
+        encryptionNonce[ENCRYPTION_CCM_NONCE_LEN - 1] = 0;
+
+        encryptionEnabled = true;
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Encryption::isEnabled()
+    {
+        return encryptionEnabled;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION const uint8_t* Encryption::encryptRecords(uint16_t index, uint8_t length)
+    {
+        for (uint8_t i = 0; i < length; ++i)
+            encryptionData[i] = buffer[index + i];
+
+        // The epoch changes with every reset, which restarts the sequence numbers
+        writeUint32(encryptionNonce, ENCRYPTION_NONCE_LEN, Epoch::getId());
+
+        uint8_t pos = 0;
+        while (pos < length)
+        {
+            uint8_t* record = &encryptionData[pos];
+            const uint8_t recordLength = record[0];
+            writeUint32(encryptionNonce, ENCRYPTION_NONCE_LEN + 4, Epoch::extendSeqNr(readUint16(record, BUFFER_SEQNR_OFFSET)));
+
+            // The engine encrypts the copy in place while the UART is still sending the previous packet.
+            // A record that the engine failed to encrypt is send as zeros, it must never leave in the clear.
+            uint8_t* data = record + BUFFER_TIMESTAMP_OFFSET;
+            const uint8_t dataLength = recordLength - BUFFER_TIMESTAMP_OFFSET;
+            bool encrypted = false;
+            if (CCMAuthEncryptStart(true, 0, encryptionNonce, data, dataLength, nullptr, 0,
+                                    ENCRYPTION_KEY_AREA, encryptionTag, ENCRYPTION_CCM_L, false) == AES_SUCCESS)
+            {
+                while (!CCMAuthEncryptCheckResult())
+                    ;
+
+                encrypted = (CCMAuthEncryptGetResult(0, dataLength, encryptionTag) == AES_SUCCESS);
+            }
+
+            if (!encrypted)
+            {
+                for (uint8_t i = 0; i < dataLength; ++i)
+                    data[i] = 0;
+            }
+
+            pos += recordLength;
+        }
+
+        return encryptionData;
+    }
+}
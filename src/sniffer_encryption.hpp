@@ -0,0 +1,31 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_ENCRYPTION_HPP
+#define SNIFFER_ENCRYPTION_HPP
+
+#include "sniffer_global.hpp"
+
+namespace Sniffer
+{
+    // Encrypts the records with the AES engine right before they are encoded, so that the host only ever receives and stores
+    // the ciphertext. The records in the buffer stay in the clear, a packet that is send again is encrypted in the same way.
+    class Encryption
+    {
+    public:
+        // Load the key from the ENCRYPTION message into the key store and start encrypting, or stop when the message says so
+        static bool enable(const uint8_t* message);
+
+        // Check whether the records have to be encrypted
+        static bool isEnabled();
+
+        // Copy the records of a packet and encrypt the copy, the returned data stays valid until the next packet is encrypted
+        static const uint8_t* encryptRecords(uint16_t index, uint8_t length);
+    };
+}
+
+#endif // SNIFFER_ENCRYPTION_HPP
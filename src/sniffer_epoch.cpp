@@ -0,0 +1,94 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_epoch.hpp"
+#include "sniffer_serial_send.hpp"
+#include "sniffer_radio.hpp"
+
+namespace Sniffer
+{
+    uint32_t epochId = 0;
+    uint32_t epochState = 0x2545F491; // State of the xorshift generator, every epoch is the next value
+    uint32_t epochNextSyncSeqNr = 0; // The first record of an epoch and the first one of every interval are reported
+    uint32_t epochSyncSeqNr = 0;
+    bool     epochSyncPending = false;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Epoch::initialize()
+    {
+        // Every read of the register gives two random bits from the I and Q channels of the receiver.
+        // The time since startup is mixed in as well, the noise is only random while the radio is receiving.
+        uint32_t seed = Radio::getCurrentTime();
+        for (uint8_t i = 0; i < 16; ++i)
+            seed = (seed << 2) ^ (seed >> 30) ^ (HWREG(RFCORE_XREG_RFRND) & 0x03);
+
+        // Xorshift never leaves 0, and all non-zero states are reached before one repeats
+        epochState ^= seed;
+        if (epochState == 0)
+            epochState = 0x2545F491;
+
+        restart();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Epoch::restart()
+    {
+        epochState ^= epochState << 13;
+        epochState ^= epochState >> 17;
+        epochState ^= epochState << 5;
+        epochId = epochState;
+
+        epochNextSyncSeqNr = 0;
+        epochSyncPending = false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint32_t Epoch::getId()
+    {
+        return epochId;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint32_t Epoch::extendSeqNr(uint16_t recordSeqNr)
+    {
+        // The record was stored less than 65536 records ago, since the buffer can't hold that many
+        const uint32_t nextSeqNr = seqNr;
+        return nextSeqNr - static_cast<uint16_t>(nextSeqNr - recordSeqNr);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION void Epoch::recordSent(uint16_t recordSeqNr)
+    {
+        // Records that are send again lie before the next interval, a jump over discarded records lies beyond it
+        const uint32_t fullSeqNr = extendSeqNr(recordSeqNr);
+        if (static_cast<int32_t>(fullSeqNr - epochNextSyncSeqNr) < 0)
+            return;
+
+        epochSyncSeqNr = fullSeqNr;
+        epochSyncPending = true;
+        epochNextSyncSeqNr = (fullSeqNr & ~static_cast<uint32_t>(EPOCH_SYNC_INTERVAL - 1)) + EPOCH_SYNC_INTERVAL;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Epoch::sendPeriodically()
+    {
+        if (!epochSyncPending)
+            return;
+
+        uint8_t data[EPOCH_REPORT_LENGTH];
+        writeUint32(data, 0, epochId);
+        writeUint32(data, 4, epochSyncSeqNr);
+        SerialSend::sendMessage(SerialDataType::Epoch, data, sizeof(data));
+        epochSyncPending = false;
+    }
+}
@@ -0,0 +1,40 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_EPOCH_HPP
+#define SNIFFER_EPOCH_HPP
+
+#include "sniffer_global.hpp"
+
+namespace Sniffer
+{
+    // Identifies the session with the host and the full 32-bit sequence numbers of its records. Every reset starts a new
+    // epoch with sequence number 0, so that the host can tell the records of different sessions apart in long captures.
+    class Epoch
+    {
+    public:
+        // Seed the epochs with noise from the radio, called once at startup while the radio is receiving
+        static void initialize();
+
+        // Start a new epoch, called when the buffer is reset
+        static void restart();
+
+        // Epoch of the current session, send in the READY message
+        static uint32_t getId();
+
+        // Full sequence number of a record that is still in the buffer, from the lower 16 bits that are stored in it
+        static uint32_t extendSeqNr(uint16_t recordSeqNr);
+
+        // Called by SerialSend for the last record of every packet, remembers when the full sequence number has to be send
+        static void recordSent(uint16_t recordSeqNr);
+
+        // Send the EPOCH message when the sequence numbers passed the next interval, called from the serial task
+        static void sendPeriodically();
+    };
+}
+
+#endif // SNIFFER_EPOCH_HPP
@@ -0,0 +1,203 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_ethernet.hpp"
+#include "sniffer_serial.hpp"
+
+#include "openmote-cc2538.h"
+
+#define ETHERNET_SOURCE_OFFSET      6
+#define ETHERNET_ETHERTYPE_OFFSET   12
+#define ETHERNET_LENGTH_OFFSET      14
+#define ETHERNET_ADDRESS_LEN        6
+
+namespace Sniffer
+{
+    // Frames are send to broadcast until the host was heard, afterwards to the address of the host. Only the header is kept
+    // here, the packets are written from their TX buffers straight into the frame in the ENC28J60.
+    uint8_t  ethernetTxFrame[ETHERNET_HEADER_LEN];
+    uint16_t ethernetTxDataLen = 0;
+
+    // Single bytes are collected before they are written, as every write to the ENC28J60 takes a whole SPI transaction
+    uint8_t  ethernetTxBytes[ETHERNET_TX_BYTES_LEN];
+    uint8_t  ethernetTxBytesLen = 0;
+    uint8_t  ethernetRxFrame[ETHERNET_RX_FRAME_LEN];
+
+    volatile bool ethernetFrameReceived = false;
+    PlainCallback ethernetCallback(&EthernetTransport::interruptHandler);
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void EthernetTransport::initialize()
+    {
+        for (uint8_t i = 0; i < ETHERNET_ADDRESS_LEN; ++i)
+            ethernetTxFrame[i] = 0xff;
+
+        board.getEUI48(ethernetTxFrame + ETHERNET_SOURCE_OFFSET);
+        writeUint16(ethernetTxFrame, ETHERNET_ETHERTYPE_OFFSET, ETHERNET_ETHERTYPE);
+
+        // The frame data moves over the SPI bus with the uDMA, the radio already enabled it with the control table
+        spi.enable(SPI_MODE, SPI_PROTOCOL, SPI_DATAWIDTH, SPI_BAUDRATE);
+        spi.enableDma();
+        enc28j60.init(ethernetTxFrame + ETHERNET_SOURCE_OFFSET);
+        enc28j60.setReceiveFilter(ETHERNET_ETHERTYPE);
+        enc28j60.setCallback(&ethernetCallback);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void EthernetTransport::interruptHandler()
+    {
+        ethernetFrameReceived = true;
+        Serial::notifyFromInterrupt();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void EthernetTransport::poll()
+    {
+        if (!ethernetFrameReceived)
+            return;
+
+        // The interrupt line stays low until all frames were read, so there won't be another edge before that
+        ethernetFrameReceived = false;
+        while (true)
+        {
+            uint32_t length = sizeof(ethernetRxFrame);
+            const bool valid = (enc28j60.receiveFrame(ethernetRxFrame, &length) == ResultSuccess);
+            if (length == 0)
+                break;
+
+            // Other traffic on the network (e.g. broadcasts) was already dropped by the ENC28J60 after reading its header
+            if (!valid || (length < ETHERNET_HEADER_LEN))
+                continue;
+
+            const uint16_t dataLen = readUint16(ethernetRxFrame, ETHERNET_LENGTH_OFFSET);
+            if (static_cast<uint32_t>(ETHERNET_HEADER_LEN + dataLen) > length)
+                continue;
+
+            // Answer to the host that we heard last
+            for (uint8_t i = 0; i < ETHERNET_ADDRESS_LEN; ++i)
+                ethernetTxFrame[i] = ethernetRxFrame[ETHERNET_SOURCE_OFFSET + i];
+
+            for (uint16_t i = 0; i < dataLen; ++i)
+            {
+                rxBuffer[rxBufferIndexWrite] = ethernetRxFrame[ETHERNET_HEADER_LEN + i];
+                rxBufferIndexWrite = rxBufferIndexWrite + 1;
+            }
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool EthernetTransport::isTransmitting()
+    {
+        return false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool EthernetTransport::isLaneTransmitting(uint8_t)
+    {
+        return false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void EthernetTransport::transmit(uint8_t, const uint8_t* data, uint16_t length)
+    {
+        if (ethernetTxDataLen + ethernetTxBytesLen + length > ETHERNET_MAX_DATA_LEN)
+            flush();
+
+        appendData(ethernetTxBytes, ethernetTxBytesLen);
+        ethernetTxBytesLen = 0;
+        appendData(data, length);
+
+        // The TX buffer of the packet is already free, the serial task has to pass on to the next one
+        Serial::notifyFromInterrupt();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void EthernetTransport::writeByte(uint8_t byte)
+    {
+        if (ethernetTxDataLen + ethernetTxBytesLen == ETHERNET_MAX_DATA_LEN)
+            flush();
+        else if (ethernetTxBytesLen == ETHERNET_TX_BYTES_LEN)
+        {
+            appendData(ethernetTxBytes, ethernetTxBytesLen);
+            ethernetTxBytesLen = 0;
+        }
+
+        ethernetTxBytes[ethernetTxBytesLen] = byte;
+        ethernetTxBytesLen++;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void EthernetTransport::flush()
+    {
+        appendData(ethernetTxBytes, ethernetTxBytesLen);
+        ethernetTxBytesLen = 0;
+
+        if (ethernetTxDataLen == 0)
+            return;
+
+        // The ENC28J60 pads short frames and adds the CRC, the frame is loaded while the previous one is still on the wire.
+        // The length of the data is only known now, it is filled in behind the header that was already written.
+        uint8_t dataLen[2];
+        writeUint16(dataLen, 0, ethernetTxDataLen);
+        enc28j60.updateFrame(ETHERNET_LENGTH_OFFSET, dataLen, sizeof(dataLen));
+        enc28j60.endFrame();
+        ethernetTxDataLen = 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void EthernetTransport::appendData(const uint8_t* data, uint16_t length)
+    {
+        if (length == 0)
+            return;
+
+        // The frame is started in the free TX buffer of the ENC28J60 with the first data
+        if (ethernetTxDataLen == 0)
+        {
+            enc28j60.beginFrame();
+            enc28j60.appendFrame(ethernetTxFrame, ETHERNET_HEADER_LEN);
+        }
+
+        enc28j60.appendFrame(data, length);
+        ethernetTxDataLen += length;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint32_t EthernetTransport::getDefaultBaudrate()
+    {
+        return ETHERNET_EQUIVALENT_BAUDRATE;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool EthernetTransport::isBaudrateSupported(uint32_t)
+    {
+        return false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint32_t EthernetTransport::getMaxBaudrate()
+    {
+        return getDefaultBaudrate();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void EthernetTransport::setBaudrate(uint32_t)
+    {
+    }
+}
@@ -0,0 +1,67 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_ETHERNET_HPP
+#define SNIFFER_ETHERNET_HPP
+
+#include "sniffer_global.hpp"
+
+// The encoded messages are carried in raw Ethernet frames, as many as fit in a frame.
+// After the EtherType comes the length of the data, as frames shorter than 60 bytes are padded.
+#define ETHERNET_ETHERTYPE              0x809A  // Same EtherType as the old sniffer from the OpenMote firmware library
+#define ETHERNET_HEADER_LEN             16      // Destination and source address, EtherType and length of the data
+#define ETHERNET_MAX_DATA_LEN           1498    // The length of the data takes 2 bytes of the 1500 byte MTU
+#define ETHERNET_TX_BYTES_LEN           64      // Single bytes (e.g. of an ACK) that are collected before they are written to the ENC28J60
+#define ETHERNET_RX_FRAME_LEN           256     // Frames from the host are small, longer frames are cut off
+#define ETHERNET_EQUIVALENT_BAUDRATE    8000000 // Rate at which the uDMA moves the bytes to the ENC28J60 over SPI (with 10 bits per byte), used for the adaptive window
+
+namespace Sniffer
+{
+    // Transport over an ENC28J60 Ethernet controller on the SPI bus, which is only accessed from the serial task
+    class EthernetTransport
+    {
+    public:
+        // Enable the SPI bus and the ENC28J60, the MAC address of the OpenMote is its EUI-48
+        static void initialize();
+
+        // Called when the ENC28J60 received a frame, which is only read by the serial task to not share the SPI bus
+        static void interruptHandler();
+
+        // Copy the frames that the ENC28J60 received from the host to the RX buffer
+        static void poll();
+
+        // The data is copied to the frame immediately, so there is never a packet being transmitted
+        static bool isTransmitting();
+
+        // Same as isTransmitting, as there is only the first lane
+        static bool isLaneTransmitting(uint8_t lane);
+
+        // Write an encoded packet to the frame in the ENC28J60, a full frame is send first when the packet doesn't fit in it
+        // anymore. There is only one lane, so the lane is ignored.
+        static void transmit(uint8_t lane, const uint8_t* data, uint16_t length);
+
+        // Add a single byte to the frame
+        static void writeByte(uint8_t byte);
+
+        // Send the frame when it contains any data, called before the serial task goes to sleep
+        static void flush();
+
+        // Rate at which the bytes reach the ENC28J60, used for the adaptive window
+        static uint32_t getDefaultBaudrate();
+
+        // Ethernet has no baudrate to change
+        static bool isBaudrateSupported(uint32_t rate);
+        static uint32_t getMaxBaudrate();
+        static void setBaudrate(uint32_t rate);
+
+    private:
+        // Write data behind the frame in the ENC28J60, starting the frame when it is the first data
+        static void appendData(const uint8_t* data, uint16_t length);
+    };
+}
+
+#endif // SNIFFER_ETHERNET_HPP
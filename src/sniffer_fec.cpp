@@ -0,0 +1,91 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_fec.hpp"
+#include "sniffer_serial_send.hpp"
+#include "sniffer_transport.hpp"
+
+namespace Sniffer
+{
+    // XOR of the packets as the host decodes them (type, length, data and crc), each padded with zeros to the longest one
+    uint8_t fecParity[FEC_MAX_PARITY_LEN];
+    uint8_t fecParityLen = 0;
+    uint8_t fecCount = 0;       // Packets in the parity
+    uint8_t fecGroupSize = 0;   // 0 when the host didn't ask for the parity
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Fec::setGroupSize(uint8_t groupSize)
+    {
+        // With several lanes the packets of the next group could arrive before the parity of the previous one
+        if ((groupSize > FEC_MAX_GROUP_SIZE) || ((groupSize > 0) && (SerialSend::getLanes() > 1)))
+            return false;
+
+        for (uint8_t i = 0; i < fecParityLen; ++i)
+            fecParity[i] = 0;
+
+        fecParityLen = 0;
+        fecCount = 0;
+        fecGroupSize = groupSize;
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION void Fec::packetSent(uint8_t dataType, uint16_t index, uint8_t dataLength, uint16_t crc)
+    {
+        if (fecGroupSize == 0)
+            return;
+
+        fecParity[0] ^= dataType;
+        fecParity[1] ^= dataLength + 2;
+        for (uint8_t i = 0; i < dataLength; ++i)
+            fecParity[2 + i] ^= buffer[index + i];
+        fecParity[2 + dataLength] ^= (crc >> 8) & 0xFF;
+        fecParity[3 + dataLength] ^= crc & 0xFF;
+
+        if (fecParityLen < dataLength + 4)
+            fecParityLen = dataLength + 4;
+        fecCount++;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Fec::isGroupComplete()
+    {
+        return (fecGroupSize != 0) && (fecCount >= fecGroupSize);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Fec::sendParity()
+    {
+        if (fecCount == 0)
+            return;
+
+        uint8_t data[1 + FEC_MAX_PARITY_LEN];
+        data[FEC_COUNT_OFFSET - 2] = fecCount;
+        for (uint8_t i = 0; i < fecParityLen; ++i)
+        {
+            data[FEC_PARITY_OFFSET - 2 + i] = fecParity[i];
+            fecParity[i] = 0;
+        }
+
+        SerialSend::sendMessage(SerialDataType::Fec, data, 1 + fecParityLen);
+        fecParityLen = 0;
+        fecCount = 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Fec::sendPeriodically()
+    {
+        // The last packets before a pause would otherwise only be protected once the traffic continues
+        if ((fecCount > 0) && (bufferIndexSerialSend == bufferIndexRadio) && !Transport::isTransmitting())
+            sendParity();
+    }
+}
@@ -0,0 +1,38 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_FEC_HPP
+#define SNIFFER_FEC_HPP
+
+#include "sniffer_global.hpp"
+
+namespace Sniffer
+{
+    // Sends a FEC message with the XOR of every group of packets with records, so that the host can rebuild a single packet of
+    // the group that arrived damaged or not at all without asking for a retransmission. Only used with a single lane, the
+    // parity has to arrive behind the packets of its group and in front of the next ones.
+    class Fec
+    {
+    public:
+        // Protect groups of this many packets with the FEC message, or stop when it is 0. Returns false for invalid values.
+        static bool setGroupSize(uint8_t groupSize);
+
+        // Add a packet that is given to the transport to the parity of the group, with the serial CRC that it was encoded with
+        static void packetSent(uint8_t dataType, uint16_t index, uint8_t dataLength, uint16_t crc);
+
+        // Check whether the group is complete, its parity has to be send before the next packet
+        static bool isGroupComplete();
+
+        // Send the parity of the packets that were added since the last one, when there are any
+        static void sendParity();
+
+        // Send the parity of an incomplete group once there are no more records to send, called from the serial task
+        static void sendPeriodically();
+    };
+}
+
+#endif // SNIFFER_FEC_HPP
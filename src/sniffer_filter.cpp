@@ -0,0 +1,402 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_filter.hpp"
+#include "sniffer_serial_send.hpp"
+#include "sniffer_radio.hpp"
+#include "sniffer_tsch.hpp"
+#include "sniffer_superframe.hpp"
+
+namespace Sniffer
+{
+    struct FilterRule
+    {
+        uint8_t  fields; // Which fields have to match (FILTER_MATCH_* flags), 0 when the rule is unused
+        uint8_t  frameType;
+        uint16_t dstPan;
+        uint16_t srcPan;
+        uint8_t  addrMode; // 2 for a short address, 3 for an extended address (like in the frame control field)
+        uint8_t  addr[8]; // Big endian, short addresses only use the first 2 bytes
+    };
+
+    FilterRule filterRules[FILTER_MAX_RULES];
+    uint32_t   filterHits[FILTER_MAX_RULES];
+    uint32_t   filterRejected = 0;
+    bool       filterEnabled = false;
+
+    uint8_t filterProgram[FILTER_PROGRAM_MAX_INSTRUCTIONS * FILTER_PROGRAM_INSTRUCTION_LENGTH];
+    uint8_t filterProgramLength = 0; // Amount of instructions, 0 when there is no program
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Filter::clear()
+    {
+        for (uint8_t i = 0; i < FILTER_MAX_RULES; ++i)
+        {
+            filterRules[i].fields = 0;
+            filterHits[i] = 0;
+        }
+
+        filterRejected = 0;
+        filterEnabled = false;
+        filterProgramLength = 0;
+        updateRadioFilter();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Filter::setRule(const uint8_t* data)
+    {
+        const uint8_t rule = data[FILTER_RULE_OFFSET];
+        if (rule >= FILTER_MAX_RULES)
+            return false;
+
+        const uint8_t addrMode = data[FILTER_ADDR_MODE_OFFSET];
+        const uint8_t fields = data[FILTER_FIELDS_OFFSET];
+        if ((fields & (FILTER_MATCH_DST_ADDR | FILTER_MATCH_SRC_ADDR)) && (addrMode != 2) && (addrMode != 3))
+            return false;
+
+        FilterRule& filterRule = filterRules[rule];
+        filterRule.fields = fields;
+        filterRule.frameType = data[FILTER_FRAME_TYPE_OFFSET];
+        filterRule.dstPan = readUint16((uint8_t*)data, FILTER_DST_PAN_OFFSET);
+        filterRule.srcPan = readUint16((uint8_t*)data, FILTER_SRC_PAN_OFFSET);
+        filterRule.addrMode = addrMode;
+        for (uint8_t i = 0; i < 8; ++i)
+            filterRule.addr[i] = data[FILTER_ADDR_OFFSET + i];
+
+        filterHits[rule] = 0;
+
+        // The filter is only active while there is at least one rule
+        filterEnabled = false;
+        for (uint8_t i = 0; i < FILTER_MAX_RULES; ++i)
+        {
+            if (filterRules[i].fields != 0)
+                filterEnabled = true;
+        }
+
+        updateRadioFilter();
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Filter::setProgram(const uint8_t* message)
+    {
+        const uint8_t programLength = message[1] - FILTER_PROGRAM_MESSAGE_LENGTH;
+        if ((programLength % FILTER_PROGRAM_INSTRUCTION_LENGTH != 0)
+         || (programLength > FILTER_PROGRAM_MAX_INSTRUCTIONS * FILTER_PROGRAM_INSTRUCTION_LENGTH))
+            return false;
+
+        // Check the program once here so that the radio interrupt doesn't have to, a jump may land right behind the last instruction
+        const uint8_t instructions = programLength / FILTER_PROGRAM_INSTRUCTION_LENGTH;
+        for (uint8_t i = 0; i < instructions; ++i)
+        {
+            const uint8_t* instruction = &message[FILTER_PROGRAM_OFFSET + i * FILTER_PROGRAM_INSTRUCTION_LENGTH];
+            const uint8_t opcode = instruction[0] & ~FILTER_OP_PAYLOAD;
+            if ((opcode > FILTER_OP_JSET) || ((instruction[0] & FILTER_OP_PAYLOAD) && (opcode > FILTER_OP_LD_HALF_LE)))
+                return false;
+
+            if ((opcode >= FILTER_OP_JEQ) && ((i + 1 + instruction[1] > instructions) || (i + 1 + instruction[2] > instructions)))
+                return false;
+        }
+
+        // The radio interrupt may be running the old program
+        const uint32_t interruptMask = enterCriticalSection();
+        for (uint8_t i = 0; i < programLength; ++i)
+            filterProgram[i] = message[FILTER_PROGRAM_OFFSET + i];
+
+        filterProgramLength = instructions;
+        leaveCriticalSection(interruptMask);
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Filter::accept(const uint8_t* frame, uint8_t length)
+    {
+        if (!filterEnabled && (filterProgramLength == 0))
+            return true;
+
+        // The last two bytes are the FCS
+        const uint8_t headerLength = length - 2;
+
+        // Parse the frame control field and the addressing fields
+        uint16_t frameControl = frame[0] | (frame[1] << 8);
+        const uint8_t frameType = frameControl & 0x07;
+        const bool panIdCompression = (frameControl >> 6) & 0x01;
+        const uint8_t dstAddrMode = (frameControl >> 10) & 0x03;
+        const uint8_t srcAddrMode = (frameControl >> 14) & 0x03;
+
+        uint16_t dstPan = 0;
+        uint16_t srcPan = 0;
+        uint8_t dstAddrLen = 0;
+        uint8_t srcAddrLen = 0;
+        const uint8_t* dstAddr = 0;
+        const uint8_t* srcAddr = 0;
+
+        uint8_t pos = 3; // Frame control field and sequence number
+        if (dstAddrMode >= 2)
+        {
+            dstAddrLen = (dstAddrMode == 2) ? 2 : 8;
+            if (pos + 2 + dstAddrLen <= headerLength)
+            {
+                dstPan = frame[pos] | (frame[pos+1] << 8);
+                dstAddr = &frame[pos + 2];
+            }
+            else
+                dstAddrLen = 0;
+
+            pos += 2 + dstAddrLen;
+        }
+
+        if (srcAddrMode >= 2)
+        {
+            srcAddrLen = (srcAddrMode == 2) ? 2 : 8;
+            if (panIdCompression)
+            {
+                srcPan = dstPan;
+            }
+            else
+            {
+                if (pos + 2 <= headerLength)
+                    srcPan = frame[pos] | (frame[pos+1] << 8);
+                pos += 2;
+            }
+
+            if (pos + srcAddrLen <= headerLength)
+                srcAddr = &frame[pos];
+            else
+                srcAddrLen = 0;
+
+            pos += (srcAddrMode == 2) ? 2 : 8;
+        }
+
+        // The payload of a secured frame starts behind the security control, the frame counter and the key identifier
+        if (((frameControl >> 3) & 0x01) && (pos < headerLength))
+        {
+            static const uint8_t keyIdentifierLengths[4] = {0, 1, 5, 9};
+            pos += 5 + keyIdentifierLengths[(frame[pos] >> 3) & 0x03];
+        }
+
+        // Accept the frame when any of the rules match
+        bool accepted = !filterEnabled;
+        for (uint8_t i = 0; i < FILTER_MAX_RULES; ++i)
+        {
+            if (filterRules[i].fields == 0)
+                continue;
+
+            if (matchRule(i, frameType, dstPan, srcPan, dstAddrLen, dstAddr, srcAddrLen, srcAddr))
+            {
+                filterHits[i]++;
+                accepted = true;
+            }
+        }
+
+        if (accepted && (filterProgramLength != 0))
+            accepted = runProgram(frame, length, pos);
+
+        if (!accepted)
+            filterRejected++;
+
+        return accepted;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Filter::sendStats()
+    {
+        uint8_t data[(FILTER_MAX_RULES + 1) * 4];
+        for (uint8_t i = 0; i < FILTER_MAX_RULES; ++i)
+            writeUint32(data, 4 * i, filterHits[i]);
+
+        writeUint32(data, 4 * FILTER_MAX_RULES, filterRejected);
+        SerialSend::sendMessage(SerialDataType::FilterStats, data, sizeof(data));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Filter::updateRadioFilter()
+    {
+#if RADIO_FRAME_FILTER
+        // The radio only knows one PAN ID, one short and one extended address, so its filtering can only be used when every
+        // rule matches on a destination within the same PAN. The frames that it lets through (e.g. broadcasts) are still
+        // checked against the rules, so the radio only has to drop the frames that none of the rules would accept.
+        bool usable = filterEnabled;
+#if CAPTURE_MODES
+        if (Tsch::isRunning() || Superframe::isRunning())
+            usable = false; // The beacons of the network are needed to follow it, whatever their destination
+#endif
+
+        bool havePan = false;
+        uint16_t panId = 0;
+        bool haveShortAddr = false;
+        uint16_t shortAddr = 0xfffe; // Not a valid short address, frames have to be send to the extended address
+        bool haveExtAddr = false;
+        uint8_t extAddr[8] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+        bool dataFrames = false;
+        bool commandFrames = false;
+        for (uint8_t i = 0; usable && (i < FILTER_MAX_RULES); ++i)
+        {
+            const FilterRule& filterRule = filterRules[i];
+            if (filterRule.fields == 0)
+                continue;
+
+            const uint8_t required = FILTER_MATCH_DST_PAN | FILTER_MATCH_DST_ADDR;
+            if (((filterRule.fields & required) != required) || (havePan && (filterRule.dstPan != panId)))
+            {
+                usable = false;
+                break;
+            }
+
+            // Beacons and acknowledgements have no destination address, so only the data and command frames can match
+            if (filterRule.fields & FILTER_MATCH_FRAME_TYPE)
+            {
+                if (filterRule.frameType == 1)
+                    dataFrames = true;
+                else if (filterRule.frameType == 3)
+                    commandFrames = true;
+                else
+                    usable = false;
+            }
+            else
+            {
+                dataFrames = true;
+                commandFrames = true;
+            }
+
+            havePan = true;
+            panId = filterRule.dstPan;
+
+            if (filterRule.addrMode == 2)
+            {
+                const uint16_t addr = (filterRule.addr[0] << 8) | filterRule.addr[1];
+                if (haveShortAddr && (addr != shortAddr))
+                    usable = false;
+
+                haveShortAddr = true;
+                shortAddr = addr;
+            }
+            else
+            {
+                for (uint8_t j = 0; j < 8; ++j)
+                {
+                    if (haveExtAddr && (filterRule.addr[j] != extAddr[j]))
+                        usable = false;
+
+                    extAddr[j] = filterRule.addr[j];
+                }
+
+                haveExtAddr = true;
+            }
+        }
+
+        if (usable)
+            Radio::enableFrameFilter(panId, shortAddr, extAddr, dataFrames, commandFrames);
+        else
+            Radio::disableFrameFilter();
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline bool Filter::matchRule(uint8_t rule, uint8_t frameType, uint16_t dstPan, uint16_t srcPan,
+                                  uint8_t dstAddrLen, const uint8_t* dstAddr, uint8_t srcAddrLen, const uint8_t* srcAddr)
+    {
+        const FilterRule& filterRule = filterRules[rule];
+
+        if ((filterRule.fields & FILTER_MATCH_FRAME_TYPE) && (frameType != filterRule.frameType))
+            return false;
+
+        if ((filterRule.fields & FILTER_MATCH_DST_PAN) && ((dstAddrLen == 0) || (dstPan != filterRule.dstPan)))
+            return false;
+
+        if ((filterRule.fields & FILTER_MATCH_SRC_PAN) && ((srcAddrLen == 0) || (srcPan != filterRule.srcPan)))
+            return false;
+
+        if ((filterRule.fields & FILTER_MATCH_DST_ADDR) && !matchAddress(rule, dstAddrLen, dstAddr))
+            return false;
+
+        if ((filterRule.fields & FILTER_MATCH_SRC_ADDR) && !matchAddress(rule, srcAddrLen, srcAddr))
+            return false;
+
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline bool Filter::matchAddress(uint8_t rule, uint8_t addrLen, const uint8_t* addr)
+    {
+        const FilterRule& filterRule = filterRules[rule];
+
+        const uint8_t ruleAddrLen = (filterRule.addrMode == 2) ? 2 : 8;
+        if (addrLen != ruleAddrLen)
+            return false;
+
+        for (uint8_t i = 0; i < addrLen; ++i)
+        {
+            if (addr[addrLen - 1 - i] != filterRule.addr[i])
+                return false;
+        }
+
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline bool Filter::runProgram(const uint8_t* frame, uint8_t length, uint8_t payloadPos)
+    {
+        // The last two bytes are the FCS
+        const uint8_t frameLength = length - 2;
+
+        uint16_t accumulator = 0;
+        uint8_t pc = 0;
+        while (pc < filterProgramLength)
+        {
+            const uint8_t* instruction = &filterProgram[pc * FILTER_PROGRAM_INSTRUCTION_LENGTH];
+            const uint8_t opcode = instruction[0] & ~FILTER_OP_PAYLOAD;
+            const uint16_t operand = (instruction[3] << 8) | instruction[4];
+            pc++;
+
+            if (opcode == FILTER_OP_RET)
+                return (operand != 0);
+            else if (opcode <= FILTER_OP_LD_HALF_LE)
+            {
+                const uint32_t offset = operand + ((instruction[0] & FILTER_OP_PAYLOAD) ? payloadPos : 0);
+                if (offset + ((opcode == FILTER_OP_LD_BYTE) ? 1 : 2) > frameLength)
+                    return false;
+
+                if (opcode == FILTER_OP_LD_BYTE)
+                    accumulator = frame[offset];
+                else if (opcode == FILTER_OP_LD_HALF)
+                    accumulator = (frame[offset] << 8) | frame[offset + 1];
+                else
+                    accumulator = frame[offset] | (frame[offset + 1] << 8);
+            }
+            else if (opcode == FILTER_OP_LD_LENGTH)
+                accumulator = frameLength;
+            else if (opcode == FILTER_OP_AND)
+                accumulator &= operand;
+            else // One of the jumps, setProgram only accepted known opcodes
+            {
+                bool condition;
+                if (opcode == FILTER_OP_JEQ)
+                    condition = (accumulator == operand);
+                else if (opcode == FILTER_OP_JGT)
+                    condition = (accumulator > operand);
+                else if (opcode == FILTER_OP_JGE)
+                    condition = (accumulator >= operand);
+                else
+                    condition = ((accumulator & operand) != 0);
+
+                pc += condition ? instruction[1] : instruction[2];
+            }
+        }
+
+        return false;
+    }
+}
@@ -0,0 +1,52 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_FILTER_HPP
+#define SNIFFER_FILTER_HPP
+
+#include "sniffer_global.hpp"
+
+namespace Sniffer
+{
+    class Filter
+    {
+    public:
+        // Remove all rules, which means that every frame is accepted again
+        static void clear();
+
+        // Store the rule that was received from the host (in the format of the FILTER message)
+        static bool setRule(const uint8_t* data);
+
+        // Store the program that was received from the host (in the format of the FILTER_PROGRAM message), returns false when
+        // it contains an unknown opcode or a jump beyond its end
+        static bool setProgram(const uint8_t* message);
+
+        // Check if the frame has to be passed to the host, which is the case when it matches any rule (or when there are no rules)
+        // and the program accepts it (or when there is no program)
+        static bool accept(const uint8_t* frame, uint8_t length);
+
+        // Send the amount of frames that matched each rule and the amount of rejected frames to the host
+        static void sendStats();
+
+        // Let the radio already drop the frames that can't match any rule, or let it pass all frames when the rules (or
+        // following a TSCH network) need more than the frame filtering of the radio can do. Called when the rules change.
+        static void updateRadioFilter();
+
+    private:
+        // Check whether the frame matches the rule on all fields that the rule contains
+        static bool matchRule(uint8_t rule, uint8_t frameType, uint16_t dstPan, uint16_t srcPan,
+                              uint8_t dstAddrLen, const uint8_t* dstAddr, uint8_t srcAddrLen, const uint8_t* srcAddr);
+
+        // Compare an address from the frame (little endian) with the address from the rule (big endian)
+        static bool matchAddress(uint8_t rule, uint8_t addrLen, const uint8_t* addr);
+
+        // Execute the program on a frame of which the MAC payload starts at the given position
+        static bool runProgram(const uint8_t* frame, uint8_t length, uint8_t payloadPos);
+    };
+}
+
+#endif // SNIFFER_FILTER_HPP
@@ -0,0 +1,257 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_flash_log.hpp"
+#include "sniffer_serial_send.hpp"
+#include "sniffer_radio.hpp"
+#include "sniffer_spi_flash_log.hpp"
+#include "sniffer_autostart.hpp"
+
+#include "libcc2538_flash.h"
+
+namespace Sniffer
+{
+    bool     flashLogEnabled = false;
+    bool     flashLogSpilling = false;
+    bool     flashLogFull = false; // Set when the log reached the end of its flash region or when the region wasn't erased
+    uint32_t flashLogWriteAddress = FLASH_LOG_START;
+    uint32_t flashLogWaitStart = 0; // Time at which the host was last heard from, or when the buffer was last empty
+
+    // Records are padded to a multiple of 4 bytes, as the flash is programmed one word at a time
+    uint32_t flashLogRecord[(SERIAL_BATCH_MAX_DATA_LEN + 3) / 4];
+    uint8_t  flashLogChunk[FLASH_LOG_DUMP_CHUNK_LEN];
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline uint16_t flashLogPaddedLength(uint8_t length)
+    {
+        return (length + 3) & ~3;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // The log is a list of buffer records, the erased flash behind the last one reads as END_OF_BUFFER_BYTE
+    inline bool flashLogValidRecord(uint32_t address)
+    {
+        const uint8_t length = *reinterpret_cast<const uint8_t*>(address);
+        return (length >= BUFFER_EXTRA_BYTES) && (length <= SERIAL_BATCH_MAX_DATA_LEN)
+            && (address + flashLogPaddedLength(length) <= FLASH_LOG_END);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void FlashLog::initialize()
+    {
+#if SNIFFER_SPI_FLASH_LOG
+        // Without a SPI flash there is nowhere to move the records to
+        flashLogFull = !SpiFlashLog::initialize();
+#else
+        uint32_t address = FLASH_LOG_START;
+        while ((address < FLASH_LOG_END) && flashLogValidRecord(address))
+            address += flashLogPaddedLength(*reinterpret_cast<const uint8_t*>(address));
+
+        // Anything other than erased flash after the last record can't be overwritten until the log is erased
+        flashLogWriteAddress = address;
+        flashLogFull = (address >= FLASH_LOG_END) || (*reinterpret_cast<const uint32_t*>(address) != 0xFFFFFFFF);
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool FlashLog::command(uint8_t cmd)
+    {
+        if (cmd == FlashLogCommand::Disable)
+            disable();
+        else if (cmd == FlashLogCommand::Enable)
+        {
+            flashLogEnabled = true;
+            flashLogWaitStart = Radio::getCurrentTime();
+        }
+        else if (cmd == FlashLogCommand::Dump)
+            dump();
+        else if (cmd == FlashLogCommand::Erase)
+            erase();
+        else
+            return false;
+
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void FlashLog::disable()
+    {
+#if SNIFFER_SPI_FLASH_LOG
+        SpiFlashLog::finish();
+#endif
+        flashLogEnabled = false;
+        flashLogSpilling = false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void FlashLog::hostActive()
+    {
+#if SNIFFER_SPI_FLASH_LOG
+        // The records that are still being programmed are acknowledged before the host can continue after them
+        if (flashLogSpilling)
+            SpiFlashLog::finish();
+#endif
+        flashLogSpilling = false;
+        flashLogWaitStart = Radio::getCurrentTime();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool FlashLog::isHostGone()
+    {
+        if (!flashLogEnabled || flashLogFull)
+            return false;
+
+        if (flashLogSpilling)
+            return true;
+
+        // The record at the acked index might already be acknowledged, so the host is only waited for when there is more
+        const uint32_t now = Radio::getCurrentTime();
+        if (bufferDistance(bufferIndexAcked, bufferIndexRadio) <= SERIAL_BATCH_MAX_DATA_LEN)
+        {
+            flashLogWaitStart = now;
+            return false;
+        }
+
+        if (now - flashLogWaitStart < FLASH_LOG_HOST_TIMEOUT)
+            return false;
+
+        // Everything that the host didn't acknowledge goes to the flash, starting with the oldest record. Nothing was send yet
+        // in a capture that started by itself, its oldest record is the next one to send.
+        flashLogSpilling = true;
+        if (!Autostart::isAttachPending())
+            bufferIndexSerialSend = bufferIndexAcked + buffer[bufferIndexAcked];
+        selectiveRepeatRemaining = 0;
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool FlashLog::spill()
+    {
+#if SNIFFER_SPI_FLASH_LOG
+        return SpiFlashLog::spill();
+#else
+        if (bufferIndexSerialSend == bufferIndexRadio)
+            return false;
+
+        // Start at the beginning of the buffer when we have reached the end
+        bufferIndexSerialSend = bufferSkipUnusedEnd(bufferIndexSerialSend, bufferIndexRadio);
+        if (bufferIndexSerialSend == bufferIndexRadio)
+            return false;
+
+        const uint8_t length = buffer[bufferIndexSerialSend];
+        const uint16_t paddedLength = flashLogPaddedLength(length);
+        if (flashLogWriteAddress + paddedLength > FLASH_LOG_END)
+        {
+            // The records stay in the buffer, which will overflow when the host doesn't come back
+            flashLogFull = true;
+            flashLogSpilling = false;
+            return false;
+        }
+
+        // Padding bytes are left erased, they are never read
+        flashLogRecord[paddedLength / 4 - 1] = 0xFFFFFFFF;
+        uint8_t* record = reinterpret_cast<uint8_t*>(flashLogRecord);
+        for (uint8_t i = 0; i < length; ++i)
+            record[i] = buffer[bufferIndexSerialSend + i];
+
+        FlashMainPageProgram(flashLogRecord, flashLogWriteAddress, paddedLength);
+        flashLogWriteAddress += paddedLength;
+
+        // The record is safe now, so it is treated as if the host acknowledged it
+        bufferIndexAcked = bufferIndexSerialSend;
+        bufferIndexSerialSend += length;
+        return true;
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint32_t FlashLog::getTimeUntilHostTimeout()
+    {
+#if SNIFFER_SPI_FLASH_LOG
+        // The serial task keeps polling the SPI flash while it is programming or erasing for the spilled records
+        if (flashLogSpilling && SpiFlashLog::isBusy())
+            return 1;
+#endif
+
+        // Only the radio interrupt can make the host look gone, and it wakes up the serial task anyway
+        if (!flashLogEnabled || flashLogFull || flashLogSpilling
+         || (bufferDistance(bufferIndexAcked, bufferIndexRadio) <= SERIAL_BATCH_MAX_DATA_LEN))
+            return TIMEOUT_NONE;
+
+        const uint32_t elapsed = Radio::getCurrentTime() - flashLogWaitStart;
+        if (elapsed >= FLASH_LOG_HOST_TIMEOUT)
+            return 0;
+
+        return (FLASH_LOG_HOST_TIMEOUT - elapsed + 999) / 1000;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void FlashLog::dump()
+    {
+#if SNIFFER_SPI_FLASH_LOG
+        SpiFlashLog::dump();
+#else
+        // Multiple records are send per message, but a record is never split so that a corrupted message only loses whole records
+        uint8_t chunkLength = 0;
+        for (uint32_t address = FLASH_LOG_START; address < flashLogWriteAddress; )
+        {
+            const uint8_t length = *reinterpret_cast<const uint8_t*>(address);
+            if (chunkLength + length > FLASH_LOG_DUMP_CHUNK_LEN)
+            {
+                SerialSend::sendMessage(SerialDataType::FlashLog, flashLogChunk, chunkLength);
+                chunkLength = 0;
+            }
+
+            for (uint8_t i = 0; i < length; ++i)
+                flashLogChunk[chunkLength++] = reinterpret_cast<const uint8_t*>(address)[i];
+
+            // Sending the whole log takes several seconds
+            watchdog.walk();
+
+            address += flashLogPaddedLength(length);
+        }
+
+        if (chunkLength > 0)
+            SerialSend::sendMessage(SerialDataType::FlashLog, flashLogChunk, chunkLength);
+#endif
+
+        SerialSend::sendMessage(SerialDataType::FlashLog, flashLogChunk, 0);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void FlashLog::erase()
+    {
+#if SNIFFER_SPI_FLASH_LOG
+        SpiFlashLog::erase();
+        flashLogFull = !SpiFlashLog::isAvailable();
+#else
+        // The processor stalls while a page is being erased, so the radio shouldn't be capturing at this time
+        for (uint32_t address = FLASH_LOG_START; address < FLASH_LOG_END; address += FLASH_LOG_PAGE_SIZE)
+        {
+            FlashMainPageErase(address);
+            watchdog.walk();
+        }
+
+        flashLogWriteAddress = FLASH_LOG_START;
+        flashLogFull = false;
+#endif
+        flashLogSpilling = false;
+
+        SerialSend::sendMessage(SerialDataType::FlashLog, flashLogChunk, 0);
+    }
+}
@@ -0,0 +1,65 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_FLASH_LOG_HPP
+#define SNIFFER_FLASH_LOG_HPP
+
+#include "sniffer_global.hpp"
+
+// The log uses the upper half of the flash, far above the firmware, up to the page with the autostart configuration
+// which lies just below the page that contains the CCA
+#define FLASH_LOG_START         0x00240000
+#define FLASH_LOG_END           0x0027F000
+#define FLASH_LOG_PAGE_SIZE     2048
+
+namespace Sniffer
+{
+    namespace FlashLogCommand
+    {
+        enum FlashLogCommand
+        {
+            Disable = 0, // Stop moving records to the flash when the host is gone
+            Enable  = 1, // Move the records that the host doesn't acknowledge to the flash
+            Dump    = 2, // Send the whole log to the host
+            Erase   = 3  // Remove everything from the log
+        };
+    }
+
+    class FlashLog
+    {
+    public:
+        // Find the end of the log that was left in the flash, it survives a reset of the OpenMote
+        static void initialize();
+
+        // Execute a command of a FLASH_LOG message, returns false when the command is unknown
+        static bool command(uint8_t cmd);
+
+        // Stop moving records to the flash, called when the host connects again
+        static void disable();
+
+        // Called for every valid message from the host, which is apparently still there
+        static void hostActive();
+
+        // Check whether the records have to go to the flash instead of over the UART
+        static bool isHostGone();
+
+        // Move the oldest unsend record from the buffer to the flash, returns false when there was nothing to move
+        static bool spill();
+
+        // Milliseconds until the host is considered gone, or TIMEOUT_NONE when the serial task doesn't have to wake up for it
+        static uint32_t getTimeUntilHostTimeout();
+
+    private:
+        // Send all records in the log, followed by an empty FLASH_LOG message to mark the end
+        static void dump();
+
+        // Erase all pages of the log, an empty FLASH_LOG message is send when done
+        static void erase();
+    };
+}
+
+#endif // SNIFFER_FLASH_LOG_HPP
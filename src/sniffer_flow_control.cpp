@@ -0,0 +1,175 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_flow_control.hpp"
+#include "sniffer_radio.hpp"
+#include "sniffer_serial.hpp"
+#include "sniffer_serial_send.hpp"
+
+namespace Sniffer
+{
+    uint16_t retransmitThreshold = RETRANSMIT_THRESHOLD;
+    uint16_t ackInterval = DEFAULT_ACK_INTERVAL;
+    bool     adaptiveWindow = true;
+    bool     ackOnRequest = false;
+    uint16_t ackRequestThreshold = RETRANSMIT_THRESHOLD * ACK_REQUEST_PERCENTAGE / 100;
+    bool     outputPaused = false;
+    uint32_t pauseTime = 0; // When the last PAUSE message arrived
+
+    bool     measuringRoundTripTime = false;
+    uint16_t measuredSeqNr = 0;
+    uint32_t measurementStartTime = 0;
+    uint32_t smoothedRoundTripTime = 0; // In microseconds, 0 when nothing has been measured yet
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void FlowControl::configure(uint16_t window, uint16_t newAckInterval)
+    {
+        ackOnRequest = (newAckInterval & ACK_INTERVAL_ON_REQUEST) != 0;
+        newAckInterval &= ~ACK_INTERVAL_ON_REQUEST;
+        if (newAckInterval != 0)
+            ackInterval = newAckInterval;
+        else
+            ackInterval = DEFAULT_ACK_INTERVAL;
+
+        measuringRoundTripTime = false;
+        smoothedRoundTripTime = 0;
+        outputPaused = false;
+
+        if (window != 0)
+        {
+            adaptiveWindow = false;
+            retransmitThreshold = window;
+            if (retransmitThreshold < RETRANSMIT_THRESHOLD_MIN)
+                retransmitThreshold = RETRANSMIT_THRESHOLD_MIN;
+            else if (retransmitThreshold > RETRANSMIT_THRESHOLD_MAX)
+                retransmitThreshold = RETRANSMIT_THRESHOLD_MAX;
+        }
+        else
+        {
+            adaptiveWindow = true;
+            retransmitThreshold = RETRANSMIT_THRESHOLD;
+        }
+
+        ackRequestThreshold = retransmitThreshold * ACK_REQUEST_PERCENTAGE / 100;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void FlowControl::packetSent(uint16_t packetSeqNr)
+    {
+        if (!adaptiveWindow || measuringRoundTripTime)
+            return;
+
+        measuringRoundTripTime = true;
+        measuredSeqNr = packetSeqNr;
+        measurementStartTime = Radio::getCurrentTime();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void FlowControl::ackReceived(uint16_t ackSeqNr)
+    {
+        // The ACK must be for the measured packet or a later one (taking the wrap around of the sequence number into account)
+        if (!measuringRoundTripTime || ((uint16_t)(ackSeqNr - measuredSeqNr) >= 0x8000))
+            return;
+
+        measuringRoundTripTime = false;
+
+        uint32_t roundTripTime = Radio::getCurrentTime() - measurementStartTime;
+        if (roundTripTime > MAX_ROUND_TRIP_TIME)
+            roundTripTime = MAX_ROUND_TRIP_TIME;
+
+        // Smooth the measurements in the same way as TCP does
+        if (smoothedRoundTripTime == 0)
+            smoothedRoundTripTime = roundTripTime;
+        else
+            smoothedRoundTripTime = (7 * smoothedRoundTripTime + roundTripTime) / 8;
+
+        updateRetransmitThreshold();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void FlowControl::cancelMeasurement()
+    {
+        measuringRoundTripTime = false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint16_t FlowControl::getRetransmitThreshold()
+    {
+        return retransmitThreshold;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint16_t FlowControl::getAckInterval()
+    {
+        return ackOnRequest ? (ackInterval | ACK_INTERVAL_ON_REQUEST) : ackInterval;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION bool FlowControl::isAckRequested(uint16_t unackedBytes)
+    {
+        return ackOnRequest && (unackedBytes >= ackRequestThreshold);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void FlowControl::setPaused(bool paused)
+    {
+        outputPaused = paused;
+        pauseTime = Radio::getCurrentTime();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool FlowControl::isPaused()
+    {
+        if (outputPaused && (Radio::getCurrentTime() - pauseTime >= FLOW_PAUSE_TIMEOUT))
+            outputPaused = false;
+
+        return outputPaused;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint32_t FlowControl::getTimeUntilPauseTimeout()
+    {
+        if (!outputPaused)
+            return TIMEOUT_NONE;
+
+        const uint32_t elapsed = Radio::getCurrentTime() - pauseTime;
+        if (elapsed >= FLOW_PAUSE_TIMEOUT)
+            return 0;
+
+        return (FLOW_PAUSE_TIMEOUT - elapsed + 999) / 1000;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void FlowControl::updateRetransmitThreshold()
+    {
+        // The amount of bytes that can be send before the ACK arrives (the UART sends 10 bits per byte, on every lane).
+        // The host only sends an ACK every few bytes, so that amount has to be added as well.
+        // Twice this value is used to have some margin for variations in the round-trip time.
+        const uint32_t bytesPerRoundTrip = (smoothedRoundTripTime * (Serial::getBaudrate() / 10 / 1000)) / 1000
+                                         * SerialSend::getLanes();
+        uint32_t threshold = 2 * (bytesPerRoundTrip + ackInterval);
+
+        if (threshold < RETRANSMIT_THRESHOLD_MIN)
+            threshold = RETRANSMIT_THRESHOLD_MIN;
+        else if (threshold > RETRANSMIT_THRESHOLD_MAX)
+            threshold = RETRANSMIT_THRESHOLD_MAX;
+
+        retransmitThreshold = threshold;
+        ackRequestThreshold = threshold * ACK_REQUEST_PERCENTAGE / 100;
+    }
+}
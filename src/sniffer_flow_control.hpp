@@ -0,0 +1,54 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_FLOW_CONTROL_HPP
+#define SNIFFER_FLOW_CONTROL_HPP
+
+#include "sniffer_global.hpp"
+
+namespace Sniffer
+{
+    class FlowControl
+    {
+    public:
+        // Use the window size and ACK interval requested by the host (a window of 0 means that it is adapted to the link)
+        static void configure(uint16_t window, uint16_t ackInterval);
+
+        // Start measuring the round-trip time when no measurement is ongoing yet
+        static void packetSent(uint16_t packetSeqNr);
+
+        // Finish the round-trip time measurement when the host acknowledged the measured packet
+        static void ackReceived(uint16_t ackSeqNr);
+
+        // A retransmission makes the ongoing measurement unreliable, as we no longer know which transmission is acknowledged
+        static void cancelMeasurement();
+
+        // After how many unacknowledged bytes we will retransmit the buffer contents to the pc
+        static uint16_t getRetransmitThreshold();
+
+        // How many bytes the host receives before sending an ACK, with ACK_INTERVAL_ON_REQUEST when it only does so on request
+        static uint16_t getAckInterval();
+
+        // Check whether the host has to be asked for an ACK, when it only sends them on request
+        static bool isAckRequested(uint16_t unackedBytes);
+
+        // Pause or continue sending the records, as asked by the PAUSE message from the host
+        static void setPaused(bool paused);
+
+        // Check whether the host paused the records, a pause ends by itself when the host stopped repeating it
+        static bool isPaused();
+
+        // Milliseconds until the pause ends by itself, or TIMEOUT_NONE when not paused
+        static uint32_t getTimeUntilPauseTimeout();
+
+    private:
+        // Recalculate the retransmit threshold from the smoothed round-trip time
+        static void updateRetransmitThreshold();
+    };
+}
+
+#endif // SNIFFER_FLOW_CONTROL_HPP
@@ -6,33 +6,95 @@
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 #include "sniffer_global.hpp"
+#include "sniffer_radio.hpp"
+#include "sniffer_channel_hopping.hpp"
+#include "sniffer_survey.hpp"
+#include "sniffer_summary.hpp"
+#include "sniffer_descriptor.hpp"
+#include "sniffer_trigger.hpp"
+#include "sniffer_epoch.hpp"
+#include "sniffer_recovery.hpp"
+#include "sniffer_statistics.hpp"
+#include "sniffer_zep.hpp"
+#include "sniffer_integrity.hpp"
+#include "sniffer_duplicates.hpp"
+#include "sniffer_compression.hpp"
+#include "sniffer_sync.hpp"
+#include "sniffer_inject.hpp"
+#include "sniffer_telemetry.hpp"
+#include "sniffer_status_leds.hpp"
+#include "sniffer_serial_send.hpp"
+#include "sniffer_trace.hpp"
+#include "sniffer_pps.hpp"
+#include "sniffer_timebase.hpp"
+#include "sniffer_fec.hpp"
+#include "sniffer_precompiled_crc16_table.h"
+#include "sniffer_precompiled_hdlc_table.h"
 
 namespace Sniffer
 {
-    uint8_t  buffer[BUFFER_LEN];
-    volatile uint16_t bufferIndexRadio = 0;
+    // uDMA Channel Control Table must be 1024-bytes aligned, we thus place it at the beginnging of the memory
+    volatile tDMAControlTable uDMAChannelControlTable[UDMA_CHANNEL_COUNT] __attribute__((section(".udma_channel_control_table")));
+
+    // The radio and acked indexes survive a reset, they are initialized by Recovery::initialize()
+    SNIFFER_NOINIT volatile uint16_t bufferIndexRadio;
     uint16_t bufferIndexSerialSend = 0;
-    uint16_t bufferIndexAcked = 0;
-    uint16_t seqNr = 0;
+    SNIFFER_NOINIT uint16_t bufferIndexAcked;
+    uint16_t bufferIndexSerialResume = 0; // Where to continue sending after the packets requested by a selective NACK were resend
+    uint16_t selectiveRepeatRemaining = 0; // Amount of packets that still have to be resend for a selective NACK
+    uint32_t seqNr = 0;
+    bool hostSessionActive = false;
+
+    volatile uint8_t rxBuffer[SERIAL_RX_BUFFER_LEN];
+    volatile uint8_t rxBufferIndexWrite = 0;
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////
 
     void reset()
     {
-        // Disable radio interrupts and clear the radio buffer
+        // Disable radio interrupts and clear the radio buffer, the radio stays on the channel it was on when hopping
         IntDisable(INT_RFCORERTX);
+        ChannelHopping::stop();
+        Survey::stop();
+        Summary::stop();
+        Zep::disable();
+        Integrity::disable();
+        Duplicates::disable();
+        Compression::disable();
+        Descriptor::disable();
+        Trigger::disarm();
+        SyncBeacon::stop();
+        Inject::reset();
+        Telemetry::stop();
+        Pps::enable(false);
+        Timebase::enable(false);
+        Fec::setGroupSize(0);
+        Trace::enable(false);
+        SerialSend::setFraming(FRAMING_HDLC);
+        SerialSend::reset();
+
+        // A packet might still be copied out of the radio, which will move the radio index when finished
+        while (HWREG(UDMA_ENASET) & (1 << UDMA_RADIO_CHANNEL))
+            ;
+
         CC2538_RF_CSP_ISFLUSHRX();
+        Radio::reset();
 
         // Turn off all leds
         led_green.off();
-        led_yellow.off();
         led_orange.off();
-        led_red.off();
+        StatusLeds::reset();
 
         // Empty buffer and reset sequence number
         bufferIndexRadio = 0;
         bufferIndexSerialSend = 0;
         bufferIndexAcked = 0;
+        bufferIndexSerialResume = 0;
+        selectiveRepeatRemaining = 0;
         seqNr = 0;
+        hostSessionActive = false;
+        Statistics::restartSequenceNumbers();
+        Epoch::restart();
+        Recovery::startCapture();
     }
 }
@@ -8,129 +8,432 @@
 #ifndef SNIFFER_GLOBAL_HPP
 #define SNIFFER_GLOBAL_HPP
 
+#include "sniffer_protocol.hpp"
+
 #include "Board.h"
 #include "Radio.h"
 #include "Uart.h"
+#include "Watchdog.h"
 #include "hw_ints.h"
+#include "hw_memmap.h"
 #include "hw_rfcore_sfr.h"
 #include "hw_rfcore_xreg.h"
+#include "hw_uart.h"
 #include "hw_udma.h"
 #include "hw_udmachctl.h"
+#include "hw_soc_adc.h"
 #include "libcc2538_udma.h"
 #include "libcc2538_uart.h"
 #include "libcc2538_interrupt.h"
 
-#include "sniffer_precompiled_crc16_table.h"
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// In a release build the code and data that are used for every byte of every packet are placed in SRAM, which
+// has no wait states unlike the flash. The linker adds veneers for the calls between flash and SRAM.
+#ifdef SNIFFER_RELEASE
+    #define SNIFFER_RAM_FUNCTION    __attribute__((section(".ramfunc")))
+    #define SNIFFER_RAM_DATA        __attribute__((section(".data.ramdata")))
+#else
+    #define SNIFFER_RAM_FUNCTION
+    #define SNIFFER_RAM_DATA
+#endif
+
+// Features of the capture path in the radio interrupt. An image that is built with fewer of them ("make CAPTURE=filter" or
+// "make CAPTURE=basic") has no code or checks for the others in finishPacket, and its READY message doesn't announce their
+// capabilities, so the host knows that the full image has to be flashed for them.
+#if defined(SNIFFER_CAPTURE_BASIC)
+    #define CAPTURE_FILTER          0
+    #define CAPTURE_RECORD_CODING   0
+    #define CAPTURE_MODES           0
+#elif defined(SNIFFER_CAPTURE_FILTER)
+    #define CAPTURE_FILTER          1
+    #define CAPTURE_RECORD_CODING   0
+    #define CAPTURE_MODES           0
+#else
+    #define CAPTURE_FILTER          1   // Filter rules, FCS filter, snap length and overflow policy
+    #define CAPTURE_RECORD_CODING   1   // Duplicate references, header compression and frame descriptors
+    #define CAPTURE_MODES           1   // Summaries, triggers and following a TSCH network
+#endif
+
+// A build with "make TRACE=TRUE" records when the serial task runs and when the interrupts interrupt it, which the host can
+// show as a timeline (see sniffer_trace.hpp). The hooks are in FreeRTOSConfig.h, which is why this isn't a setting below.
+#ifdef SNIFFER_TRACE
+    #define TRACE_RECORDER          1
+#else
+    #define TRACE_RECORDER          0
+#endif
+
+// Variables that keep their value when the OpenMote is reset without losing power, the startup code doesn't clear them
+#define SNIFFER_NOINIT  __attribute__((section(".noinit")))
+
+// Exported by the linker script, the addresses of these symbols are the start and the size of the SRAM that isn't
+// used by any variable. The whole region is used as the buffer for the received packets.
+extern "C" uint8_t _free_sram_start[];
+extern "C" uint8_t _free_sram_size[];
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-#define BUFFER_LEN                  24000   // Size of buffer in which packets are stored that have been received on the radio
-#define RETRANSMIT_THRESHOLD        10000   // After how many unacknowledged bytes we will retransmit the buffer contents to the pc
+#define BUFFER_LEN                  ((uint16_t)(uintptr_t)_free_sram_size)  // Size of buffer in which packets are stored that have been received on the radio (all free SRAM)
+#define RETRANSMIT_THRESHOLD        (BUFFER_LEN * 5 / 12)   // After how many unacknowledged bytes we will retransmit the buffer contents to the pc (initial value)
+#define RETRANSMIT_THRESHOLD_MIN    1000                    // Lowest retransmit threshold, either requested by the host or adapted to the round-trip time
+#define RETRANSMIT_THRESHOLD_MAX    (BUFFER_LEN * 2 / 3)    // Highest retransmit threshold, either requested by the host or adapted to the round-trip time
+#define BUFFER_OVERFLOW_RESERVE     (BUFFER_LEN / 8)        // Free bytes in the buffer below which the overflow policy of the host is applied
+#define ADAPTIVE_OVERFLOW_START     (BUFFER_LEN / 2)        // Bytes in the buffer at which the adaptive overflow policy starts keeping only headers
+#define ADAPTIVE_OVERFLOW_STEP      (BUFFER_LEN / 8)        // Bytes in the buffer between the degradation levels of the adaptive overflow policy
+#define DEFAULT_ACK_INTERVAL        300     // After how many bytes the host sends an ACK, unless the host requested something else
+#define ACK_REQUEST_PERCENTAGE      50      // Part of the retransmit threshold that is unacknowledged before the records ask for an ACK
+#define MAX_ROUND_TRIP_TIME         1000000 // Round-trip times of the ACKs are capped to this value (in microseconds)
+#define FLOW_PAUSE_TIMEOUT          1000000 // Microseconds after the last PAUSE message from the host after which the records are send again
 #define SERIAL_RX_BUFFER_LEN        256     // How big is the buffer for incoming serial messages
-#define SERIAL_RX_MAX_MESSAGE_LEN   8       // The maximum length of an incoming serial message
-#define BAUDRATE                    921600  // The baudrate for the UART to communicate with the pc
+#define SERIAL_RX_MAX_MESSAGE_LEN   136     // The maximum length of an incoming serial message (an INJECT message with the longest frame)
+#define BAUDRATE                    921600  // The baudrate for the UART to communicate with the pc, until the host negotiates a faster one
+#define BAUDRATE_MAX_ERROR          20      // Highest deviation (in 1/1000) between a requested baudrate and what the UART divisor can make of it
+#define BAUDRATE_VERIFY_TIMEOUT     1000000 // Microseconds that the host gets to confirm a new baudrate before we return to BAUDRATE
+#define TIMESTAMP_TICK_RATE         1000000 // Rate at which the timestamps of the records count, they are in microseconds
+#define SERIAL_TX_BUFFER_COUNT      (SERIAL_TX_LANES + 1)   // Amount of encoded packets that can be waiting to be send, one more than the transport sends at once
+#define SERIAL_TX_CACHE_COUNT       4       // Amount of encoded packets that are kept after they were send, to retransmit them without encoding
+#define RADIO_DMA_INTERRUPT         1       // Finish copying radio packets in the uDMA interrupt instead of waiting in the radio interrupt
+#define RADIO_CUT_THROUGH           1       // Already start copying long packets from the radio before they are completely received
+#define RADIO_FIFOP_THRESHOLD       64      // Amount of bytes in the RX FIFO after which the first part of a packet is copied
+#define RADIO_CONTINUOUS_RX         1       // Leave the receiver running after each frame and only flush the RX FIFO when it overflowed
+#define RADIO_FRAME_FILTER          1       // Let the radio already drop the frames that no filter rule can match when the rules allow it
+#define BUFFER_ALIGNED_RECORDS      0       // Pad the records in the buffer to whole words, so that the frames start word-aligned (requires a host that knows CAPABILITY_ALIGNED_RECORDS)
+#define SERIAL_HARDWARE_CRC         0       // Calculate the serial CRC with the CRC engine of the random number generator (requires --hardware-crc on the host)
+#define SNIFFER_USB                 0       // Talk to the pc over the native USB port of the CC2538 (as a CDC-ACM serial port) instead of over UART0
+#define SNIFFER_ETHERNET            0       // Talk to the pc over an ENC28J60 Ethernet controller on the SPI bus instead of over UART0
+#define SNIFFER_SPI_SLAVE           0       // Talk to a single-board computer as a SPI slave on SSI0 instead of over UART0 (requires --spi on the host)
+#define SNIFFER_UART_BONDING        0       // Also send records over UART1 (TX on PD2) to a second USB-serial bridge, which doubles the link rate (requires --bond-port on the host)
+#define SNIFFER_SPI_FLASH_LOG       0       // Keep the flash log in a SPI NOR flash on the SPI bus instead of in the internal flash (not together with SNIFFER_ETHERNET)
+#define PROFILING                   0       // Measure the cycles spent in the hot paths with the DWT cycle counter and add them to the STATS message
+#define TRACE_RING_EVENTS           128     // Events that the trace recorder (TRACE_RECORDER) holds until the serial task sends them, each takes 8 bytes
+#define SERIAL_FAULT_INJECTION      0       // Debug option: corrupt, drop or duplicate some encoded packets to exercise the NACKs and retransmissions
+#define SERIAL_FAULT_RATE           100     // Packets out of every 10000 that are affected when SERIAL_FAULT_INJECTION is enabled
+#define FLASH_LOG_HOST_TIMEOUT      2000000 // Microseconds without hearing from the host before the unacknowledged records are moved to the flash log
+#define FLASH_LOG_DUMP_CHUNK_LEN    240     // Maximum amount of bytes of records in a single FLASH_LOG message when dumping the log
+#define RECOVERY_DUMP_CHUNK_LEN     240     // Maximum amount of bytes of records in a single RECOVERY message
+#define AUTOSTART_CONFIG_LEN        512     // Maximum amount of bytes of configuration messages that are stored for starting the capture after booting
+#define WATCHDOG_KICK_INTERVAL      500     // Milliseconds that the serial task sleeps at most, the watchdog resets the OpenMote after 1 second
+#define HOP_MAX_CHANNELS            16      // Maximum amount of entries in the channel hopping schedule
+#define HOP_MIN_DWELL_TIME          2       // Shortest time to stay on a channel, also used to retry a hop that had to wait for a packet
+#define HOP_ADAPTIVE_IDLE_WEIGHT    16      // Weight of a channel without frames or energy when dividing the dwell times, equal to 1 frame per second
+#define HOP_ADAPTIVE_ENERGY_THRESHOLD (-90) // dBm above which the energy on a channel counts as activity, every dB weighs as much as 1 frame per second
+#define HOP_ADAPTIVE_REPORT_INTERVAL 10000000 // Microseconds between the reports of the adaptive dwell times
+#define TSCH_DEFAULT_TIMESLOT_LENGTH 10000  // Microseconds per timeslot of timeslot template 0, used when a beacon doesn't give the full template
+#define TSCH_DEFAULT_TX_OFFSET      2120    // Microseconds between the start of a timeslot and the start of its frame, in timeslot template 0
+#define TSCH_DEFAULT_RX_WAIT        2200    // Microseconds around the TX offset in which a frame can start, in timeslot template 0
+#define TSCH_MIN_TIMESLOT_LENGTH    5000    // Shorter timeslots can't be followed with the overflow counter of the MAC timer
+#define TSCH_SYNC_TIMEOUT           30000000    // Microseconds without a frame at the TX offset after which the network is searched again
+#define TSCH_ADJUST_DIVISOR         4       // Part of the deviation of a frame that the timeslots move by, beacons set them exactly
+#define SUPERFRAME_BASE_DURATION    15360   // Microseconds of a superframe with order 0 (aBaseSuperframeDuration of 960 symbols)
+#define SUPERFRAME_SFD_OFFSET       160     // Microseconds between the start of a beacon and the timestamp of its SFD (preamble and SFD)
+#define SUPERFRAME_MIN_INACTIVE     5000    // Inactive periods that are shorter than this after the guard times are captured with the radio on
+#define SUPERFRAME_MAX_MISSED_BEACONS 4     // Beacons in a row that may be missed before the radio stays on to search for the next one
+#define INJECT_QUEUE_LEN            8       // Frames from the host that can wait to be transmitted (power of 2)
+#define INJECT_SCHEDULE_MIN_DELAY   20      // Microseconds ahead that a frame is scheduled at least, a frame that starts sooner is send at once
+#define INJECT_RETRY_DELAY          200     // Microseconds that a frame waits when it would start while a frame is being received
+#define SYNC_MIN_INTERVAL           4       // Shortest time between two sync frames, a frame takes about 1 millisecond on the air
+#define DUPLICATE_TABLE_SIZE        16      // Amount of recently captured frames that new frames are compared with when suppressing duplicates
+#define DUPLICATE_MAX_AGE           500000  // Microseconds after which a frame with the same contents is no longer considered a retry
+#define COMPRESSION_CONTEXTS        8       // Amount of recent MAC headers that the header of a new frame is compared with when compressing
+#define SURVEY_BLOCK_SAMPLES        64      // Amount of RSSI samples that are stored together in the buffer in survey mode
+#define SUMMARY_TABLE_SIZE          64      // Amount of links that can be counted per interval in summary mode (power of 2)
+#define SUMMARY_TABLE_OFFSET        256     // The tables are kept in the buffer behind the frame that is being copied from the radio
+#define SUMMARY_MAX_PROBES          8       // Entries of the table that are tried before a frame is counted as untracked
+#define SUMMARY_SKETCH_DEPTH        4       // Rows of the count-min sketch that estimates the frames per source in summary mode
+#define SUMMARY_SKETCH_WIDTH        256     // Counters per row of the sketch (power of 2)
+#define SUMMARY_TOP_TALKERS         8       // Sources with the highest estimates that are send every interval
+#define TRIGGER_MAX_WINDOW_LEN      (BUFFER_LEN / 2)    // Bytes of records kept before the trigger, the rest of the buffer is for the frames after it
+#define RECORD_INDEX_LEN            512     // Amount of recent records of which the position in the buffer is remembered (power of 2)
+#define TELEMETRY_MAX_BUFFER_USE    (BUFFER_LEN / 4)    // Unacknowledged bytes above which a telemetry sample waits
+#define BATCHING_MAX_THRESHOLD      2048    // Most bytes that wait for each other in throughput mode, enough to fill an Ethernet frame
+#define BATCHING_MAX_HOLD_TIME      250     // Milliseconds that a record waits at most in throughput mode, the host times out after 300
+#define STATUS_LED_ACTIVITY_TIME    50000   // Microseconds that the yellow led stays on after the last received frame
+#define TIMEBASE_SYNC_INTERVAL      60000000    // Microseconds between two records with the full 64-bit time, when the host asked for them
+#define PPS_PORT                    GPIO_A_BASE // Pin of the pulse-per-second input (PA6, ADC6 on the header), which no peripheral of the board uses
+#define PPS_PIN                     GPIO_PIN_6
+#define PPS_INTERRUPT               INT_GPIOA
+
+// Interrupt priorities, a lower value preempts a higher one and only the upper 3 bits are used. The transport interrupt
+// comes first, so that it empties the UART RX FIFO even while the radio interrupt copies a long frame and no ACKs from
+// the host are lost. The radio, MAC timer and uDMA interrupts share the next level, which enterCriticalSection masks.
+// The other peripherals keep the lowest level. They all notify the serial task, so none of them may be more important
+// than configMAX_SYSCALL_INTERRUPT_PRIORITY.
+#define INTERRUPT_PRIORITY_TRANSPORT    (5 << 5)    // UART0 or native USB
+#define INTERRUPT_PRIORITY_RADIO        (6 << 5)
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-#define HDLC_FLAG           0x7E
-#define HDLC_ESCAPE         0x7D
-#define HDLC_ESCAPE_MASK    0x20
-
 #define CC2538_RF_MIN_PACKET_LEN    3
 #define CC2538_RF_MAX_PACKET_LEN    127
 #define CC2538_RF_RSSI_OFFSET       73
+#define CC2538_RF_TX_TURNAROUND_TIME 192    // Microseconds between the TX strobe and the start of the preamble
+#define CC2538_RF_BYTE_TIME         32      // Microseconds to send a single byte
+#define CC2538_RF_TX_OVERHEAD_BYTES 8       // Preamble, SFD, length byte and FCS
+#define CC2538_RF_TX_SFD_TIME       (CC2538_RF_TX_TURNAROUND_TIME + (5 * CC2538_RF_BYTE_TIME)) // Microseconds between the TX strobe and the end of the SFD
+#define CC2538_RF_MIN_FRAME_GAP_TIME CC2538_RF_TX_SFD_TIME // Shortest time between the end of a frame and the SFD of the next one (e.g. its ACK)
+#define CC2538_RF_RX_FIFO_ADDRESS(position) (RFCORE_RAM_BASE + (((position) & 0x7F) * 4)) // The RX FIFO can be read directly, one byte per word
 #define CC2538_RF_CSP_OP_ISRXON     0xE3
 #define CC2538_RF_CSP_OP_ISFLUSHRX  0xED
+#define CC2538_RF_CSP_OP_ISRFOFF    0xEF
+#define CC2538_RF_CSP_OP_ISTXON     0xE9
+#define CC2538_RF_CSP_OP_ISTXONCCA  0xEA
+#define CC2538_RF_CSP_OP_ISFLUSHTX  0xEE
 
 #define CC2538_RF_CSP_ISRXON()    \
   do { HWREG(RFCORE_SFR_RFST) = CC2538_RF_CSP_OP_ISRXON; } while(0)
 
+#define CC2538_RF_CSP_ISRFOFF()   \
+  do { HWREG(RFCORE_SFR_RFST) = CC2538_RF_CSP_OP_ISRFOFF; } while(0)
+
 #define CC2538_RF_CSP_ISFLUSHRX()  do { \
   HWREG(RFCORE_SFR_RFST) = CC2538_RF_CSP_OP_ISFLUSHRX; \
   HWREG(RFCORE_SFR_RFST) = CC2538_RF_CSP_OP_ISFLUSHRX; \
 } while(0)
 
+#define CC2538_RF_CSP_ISTXON()    \
+  do { HWREG(RFCORE_SFR_RFST) = CC2538_RF_CSP_OP_ISTXON; } while(0)
 
-#define CRC_INIT                0xffff
-#define END_OF_BUFFER_BYTE      0xff
-#define DEFAULT_RADIO_PORT      26
+#define CC2538_RF_CSP_ISFLUSHTX()  do { \
+  HWREG(RFCORE_SFR_RFST) = CC2538_RF_CSP_OP_ISFLUSHTX; \
+  HWREG(RFCORE_SFR_RFST) = CC2538_RF_CSP_OP_ISFLUSHTX; \
+} while(0)
 
-#define ACK_MESSAGE_LENGTH      6   // Length = 2 bytes index + 2 bytes sequence number + 2 bytes crc
-#define ACK_INDEX_OFFSET        2
-#define ACK_SEQNR_OFFSET        4
 
-#define NACK_MESSAGE_LENGTH     6   // Length = 2 bytes index + 2 bytes sequence number + 2 bytes crc
-#define NACK_INDEX_OFFSET       2
-#define NACK_SEQNR_OFFSET       4
+#define UDMA_RADIO_CHANNEL      0   // Software channel used for copying the packets out of the RX FIFO
+#define UDMA_INJECT_CHANNEL     1   // Software channel used for copying the injected frames into the TX FIFO
+#define UDMA_UART_RX_CHANNEL    8   // UART0 RX channel used for storing the messages from the pc in the UART RX buffer
+#define UDMA_UART_TX_CHANNEL    9   // UART0 TX channel used for sending the encoded packets to the pc
+#define UDMA_SSI_RX_CHANNEL     10  // SSI0 RX channel, only used directly by SNIFFER_SPI_SLAVE for the bursts of the host
+#define UDMA_SSI_TX_CHANNEL     11  // SSI0 TX channel, the SPI bus uses channel 10 and 11 for the frames of the ENC28J60 or the pages of the SPI flash
+#define UDMA_UART1_TX_CHANNEL   23  // UART1 TX channel used for the packets that SNIFFER_UART_BONDING sends over the second bridge
+#if SNIFFER_UART_BONDING
+    #define UDMA_CHANNEL_COUNT  (UDMA_UART1_TX_CHANNEL + 1)
+#elif SNIFFER_ETHERNET || SNIFFER_SPI_FLASH_LOG || SNIFFER_SPI_SLAVE
+    #define UDMA_CHANNEL_COUNT  (UDMA_SSI_TX_CHANNEL + 1)
+#else
+    #define UDMA_CHANNEL_COUNT  (UDMA_UART_TX_CHANNEL + 1)
+#endif
+
+// The ENC28J60 driver blocks on the SPI bus, it can't share it with the transactions of the SPI flash
+#if SNIFFER_ETHERNET && SNIFFER_SPI_FLASH_LOG
+    #error "SNIFFER_SPI_FLASH_LOG can't be combined with SNIFFER_ETHERNET"
+#endif
+
+// As a slave the SSI belongs to the host, it can't be the master of the ENC28J60 or the SPI flash at the same time
+#if SNIFFER_SPI_SLAVE && (SNIFFER_USB || SNIFFER_ETHERNET || SNIFFER_SPI_FLASH_LOG || SNIFFER_UART_BONDING)
+    #error "SNIFFER_SPI_SLAVE can't be combined with SNIFFER_USB, SNIFFER_ETHERNET, SNIFFER_SPI_FLASH_LOG or SNIFFER_UART_BONDING"
+#endif
+
+// The second UART only exists next to UART0, the other transports have a single connection to the pc
+#if SNIFFER_UART_BONDING && (SNIFFER_USB || SNIFFER_ETHERNET)
+    #error "SNIFFER_UART_BONDING can't be combined with SNIFFER_USB or SNIFFER_ETHERNET"
+#endif
+
+// Packets that the transport can send at the same time, the host enables the extra lanes with the LANES message.
+// NATIVE_LANES is set by the Makefile in native/, where the emulated link can have any number of them.
+#if SNIFFER_NATIVE
+    #define SERIAL_TX_LANES     NATIVE_LANES
+#elif SNIFFER_UART_BONDING
+    #define SERIAL_TX_LANES     2
+#else
+    #define SERIAL_TX_LANES     1
+#endif
 
-#define RESET_MESSAGE_LENGTH    3   // Length = radio channel + 2 bytes crc
-#define RESET_CHANNEL_OFFSET    2
+#define END_OF_BUFFER_BYTE      0xff
 
-#define STOP_MESSAGE_LENGTH     2   // Length = 2 bytes crc
+// The word-aligned records have a padding byte in their header and at most 3 padding bytes behind the packet
+#if BUFFER_ALIGNED_RECORDS
+    #undef BUFFER_EXTRA_BYTES
+    #define BUFFER_EXTRA_BYTES      BUFFER_ALIGNED_EXTRA_BYTES
+    #define BUFFER_MAX_PADDING      (BUFFER_RECORD_ALIGNMENT - 1)
+#else
+    #define BUFFER_MAX_PADDING      0
+#endif
+#define TIMEOUT_NONE            0xFFFFFFFF  // Returned by the functions that tell the serial task when to wake up, when it doesn't have to
+#define DEFAULT_RADIO_PORT      26
 
-// There are 5 extra bytes stored in front of the radio packet: 1 byte length, 2 byte index and 2 byte sequence number
-#define BUFFER_EXTRA_BYTES      5
-#define BUFFER_INDEX_OFFSET     1
-#define BUFFER_SEQNR_OFFSET     3
+// The MAC timer runs at 32MHz, overflowing every 32768 ticks makes the overflow counter count in steps of 1024 microseconds
+// The compare interrupt is always set at least 2 overflows ahead so that the compare value can't already have passed
+#define MAC_TIMER_PERIOD            32768
+#define MAC_TIMER_MIN_COMPARE_DELAY 2
 
 // The size of the TX buffer is defined by what is needed to pass the largest possible radio packet.
-// Together with the radio packet, 4 extra bytes (2 byte index and 2 byte sequence number) are send.
+// Together with the radio packet, 10 extra bytes (2 byte index, 2 byte sequence number, 4 byte timestamp, original length and channel) are send,
+// and the padding of the record when BUFFER_ALIGNED_RECORDS is enabled.
 // There are 2 bytes in front of this which are the type and length bytes. At the end a 2 bytes serial CRC is added.
 // This whole thing has to be multiplied by 2 as we need twice as much space in case each character would have to be escaped.
+// COBS framing never needs more than this, it only adds one byte per 254.
 // Finally one start and one end byte is added around this data.
-#define SERIAL_TX_BUFFER_EXTRA_BYTES   4
-#define SERIAL_TX_BUFFER_SIZE          (1 + ((2 + (CC2538_RF_MAX_PACKET_LEN + SERIAL_TX_BUFFER_EXTRA_BYTES) + 2) * 2) + 1)
+// When multiple small packets are batched together, their buffer records are send including the length bytes.
+// A batch can never contain more data than the largest buffer record, which is one byte more than a single packet
+// (and the descriptor behind the frame, when the host asked for it).
+// There are SERIAL_TX_BUFFER_COUNT of these buffers so that one can be filled while the uDMA is sending the others,
+// and SERIAL_TX_CACHE_COUNT more that hold packets which were already send, for when they have to be send again.
+#define SERIAL_TX_BUFFER_EXTRA_BYTES   10
+#define SERIAL_BATCH_MAX_DATA_LEN      (CC2538_RF_MAX_PACKET_LEN + BUFFER_EXTRA_BYTES + DESCRIPTOR_LENGTH + BUFFER_MAX_PADDING)
+#define SERIAL_TX_BUFFER_SIZE          (1 + ((2 + SERIAL_BATCH_MAX_DATA_LEN + 2) * 2) + 1)
+#define SERIAL_TX_SLOT_COUNT           (SERIAL_TX_BUFFER_COUNT + SERIAL_TX_CACHE_COUNT)
+#define FEC_MAX_PARITY_LEN             (2 + SERIAL_BATCH_MAX_DATA_LEN + 2)   // A packet as the host decodes it, with its type, length and crc
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 namespace Sniffer
 {
-    extern uint8_t  buffer[BUFFER_LEN];
+    extern volatile tDMAControlTable uDMAChannelControlTable[UDMA_CHANNEL_COUNT];
+
+    // The buffer is a ring of variable-length records. The radio interrupt is the only writer and moves bufferIndexRadio,
+    // the serial task reads from bufferIndexSerialSend and frees the records up to bufferIndexAcked when the host acknowledges them.
+    // A record is always stored contiguously, when it doesn't fit behind the last one then END_OF_BUFFER_BYTE is written
+    // instead of its length byte and the record is placed at the start of the buffer.
+    // The inline buffer* functions below contain all index calculations on this ring.
+    constexpr uint8_t* buffer = _free_sram_start;
     extern volatile uint16_t bufferIndexRadio;
     extern uint16_t bufferIndexSerialSend;
     extern uint16_t bufferIndexAcked;
-    extern uint16_t seqNr;
+    extern uint16_t bufferIndexSerialResume;
+    extern uint16_t selectiveRepeatRemaining;
+    extern uint32_t seqNr; // Sequence number of the next record, the records only contain the lower 16 bits
+
+    // Set once a RESET or SURVEY started sending records to the host, until reset() is called
+    extern bool hostSessionActive;
+
+    // Bytes received from the host. The transport writes them in its interrupt and then moves the write index,
+    // the serial task processes them up to that index. Both indexes wrap around by themselves.
+    extern volatile uint8_t rxBuffer[SERIAL_RX_BUFFER_LEN];
+    extern volatile uint8_t rxBufferIndexWrite;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Disable radio interrupts, reset global variables and turn off all leds
+    void reset();
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    namespace SerialDataType
+    // Protect state that is shared with the radio interrupt or a less important one. BASEPRI masks the interrupts up to
+    // INTERRUPT_PRIORITY_RADIO, so the transport interrupt can still run. The sections may be nested and used inside an
+    // interrupt, the returned mask has to be given to leaveCriticalSection. No FreeRTOS function may be called inside,
+    // leaving a critical section of the kernel clears BASEPRI.
+    inline uint32_t enterCriticalSection()
     {
-        enum SerialDataTypes
-        {
-            Packet = 1,
-            Ack    = 2,
-            Nack   = 3,
-            Reset  = 4,
-            Ready  = 5,
-            Stop   = 6
-        };
+        const uint32_t previousMask = IntPriorityMaskGet();
+        if ((previousMask == 0) || (previousMask > INTERRUPT_PRIORITY_RADIO))
+            IntPriorityMaskSet(INTERRUPT_PRIORITY_RADIO);
+
+        return previousMask;
+    }
+
+    inline void leaveCriticalSection(uint32_t previousMask)
+    {
+        IntPriorityMaskSet(previousMask);
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    // Disable radio interrupts, reset global variables and turn off all leds
-    void reset();
+    // The Cortex-M3 can load and store words at any address, this type tells the compiler that it may do so
+    typedef uint32_t __attribute__((aligned(1), may_alias)) unaligned_uint32_t;
+
+    // Check whether one of the 4 bytes in the word could be HDLC_FLAG or HDLC_ESCAPE. Setting the lowest 2 bits maps both
+    // of them (and 0x7C and 0x7F) on 0x7F, after which a byte that became zero by the XOR is found with the usual bit trick.
+    inline bool hdlcWordNeedsEscaping(uint32_t word)
+    {
+        const uint32_t x = (word | 0x03030303) ^ 0x7F7F7F7F;
+        return ((x - 0x01010101) & ~x & 0x80808080) != 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Check whether one of the 4 bytes in the word is zero, these end a block when COBS framing is used
+    inline bool cobsWordContainsZero(uint32_t word)
+    {
+        return ((word - 0x01010101) & ~word & 0x80808080) != 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Continue the serial CRC over a block of bytes
+    inline uint16_t crcCalculate(const uint8_t* data, uint16_t length, uint16_t crc)
+    {
+#if SERIAL_HARDWARE_CRC
+        // Writing RNDL twice loads the CRC register, every byte written to RNDH is then processed by the hardware.
+        // The engine uses the CRC-16 polynomial x^16 + x^15 + x^2 + 1, so the checksum differs from the table version.
+        HWREG(SOC_ADC_RNDL) = (crc >> 8) & 0xFF;
+        HWREG(SOC_ADC_RNDL) = crc & 0xFF;
+        for (uint16_t i = 0; i < length; ++i)
+            HWREG(SOC_ADC_RNDH) = data[i];
+
+        return (HWREG(SOC_ADC_RNDH) << 8) | HWREG(SOC_ADC_RNDL);
+#else
+        for (uint16_t i = 0; i < length; ++i)
+            crc = crcCalculationStep(data[i], crc);
+
+        return crc;
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Amount of bytes between two indices in the buffer, going forward from fromIndex
+    inline uint16_t bufferDistance(uint16_t fromIndex, uint16_t toIndex)
+    {
+        if (toIndex >= fromIndex)
+            return toIndex - fromIndex;
+        else
+            return BUFFER_LEN - fromIndex + toIndex;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Check whether a record that starts at the index ends before the end of the buffer, so that it doesn't have to wrap
+    inline bool bufferRecordFits(uint16_t index, uint16_t length)
+    {
+        return index + length < BUFFER_LEN;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Index of the record that follows when the reader reached the index, which is the start of the buffer when the rest of
+    // the buffer was marked with END_OF_BUFFER_BYTE. Nothing was written yet at writeIndex, so that index is never moved.
+    inline uint16_t bufferSkipUnusedEnd(uint16_t index, uint16_t writeIndex)
+    {
+        if ((index != writeIndex) && (buffer[index] == END_OF_BUFFER_BYTE))
+            return 0;
+        else
+            return index;
+    }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    inline uint16_t crcCalculationStep(uint8_t byte, uint16_t crc)
+    // Amount of bytes behind the header of the record at the index, without the padding behind them
+    inline uint8_t bufferRecordDataLength(uint16_t index)
     {
-        return crc16_table[byte ^ (uint8_t)(crc >> 8)] ^ (crc << 8);
+#if BUFFER_ALIGNED_RECORDS
+        return buffer[index] - BUFFER_EXTRA_BYTES - buffer[index + BUFFER_PADDING_OFFSET];
+#else
+        return buffer[index] - BUFFER_EXTRA_BYTES;
+#endif
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    inline uint16_t readUint16(uint8_t buf[], uint16_t index)
+    // Check whether the index lies between fromIndex and toIndex (both inclusive), going forward through the ring
+    inline bool bufferContains(uint16_t fromIndex, uint16_t toIndex, uint16_t index)
     {
-        return (buf[index] << 8) + buf[index+1];
+        if (fromIndex <= toIndex)
+            return (index >= fromIndex) && (index <= toIndex);
+        else
+            return (index >= fromIndex) || (index <= toIndex);
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    inline void writeUint16(uint8_t buf[], uint16_t index, uint16_t value)
+    // Check whether a record can be stored at writeIndex, or at the start of the buffer when it doesn't fit behind it,
+    // without reaching readIndex. The writer may never reach the reader, the buffer would look empty again.
+    inline bool bufferHasSpace(uint16_t writeIndex, uint16_t readIndex, uint16_t length)
     {
-        buf[index] = (value >> 8) & 0xff;
-        buf[index+1] = value & 0xff;
+        if (bufferRecordFits(writeIndex, length))
+            return (readIndex <= writeIndex) || (readIndex > writeIndex + length);
+        else
+            return (readIndex <= writeIndex) && (readIndex > length);
     }
 }
 
@@ -139,6 +442,7 @@ namespace Sniffer
 extern Board board;
 extern Uart uart;
 extern Radio radio;
+extern Watchdog watchdog;
 extern GpioOut led_green;
 extern GpioOut led_orange;
 extern GpioOut led_red;
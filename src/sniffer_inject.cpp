@@ -0,0 +1,374 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_inject.hpp"
+#include "sniffer_radio.hpp"
+#include "sniffer_serial.hpp"
+#include "sniffer_serial_send.hpp"
+#include "sniffer_survey.hpp"
+#include "sniffer_tsch.hpp"
+#include "sniffer_superframe.hpp"
+
+namespace Sniffer
+{
+    namespace InjectState
+    {
+        enum InjectState
+        {
+            Idle         = 0, // The queue is empty and the timer interrupt isn't used
+            Waiting      = 1, // The compare interrupt occurs when the frame at the front of the queue has to start
+            Transmitting = 2  // The compare interrupt occurs when the frame at the front of the queue is no longer on the air
+        };
+    }
+
+    struct InjectFrame
+    {
+        uint16_t id;
+        uint8_t  flags;
+        uint8_t  length;     // Length of the frame without the FCS
+        uint32_t time;       // Time of the SFD, or the time after the SFD of the previous frame (INJECT_FLAG_ABSOLUTE)
+        uint8_t  status;     // Outcome of the transmission, filled in when the frame is done
+        uint32_t resultTime; // Time of the SFD, or when it would have been if the channel was free
+        uint8_t  data[CC2538_RF_MAX_PACKET_LEN - 2];
+    };
+
+    // The serial task adds frames at the tail and reports them once the timer interrupt moved the head past them.
+    // A place in the queue is only reused after its frame was reported. The counters wrap around at a multiple of the length.
+    InjectFrame injectQueue[INJECT_QUEUE_LEN];
+    volatile uint8_t injectTail = 0;
+    volatile uint8_t injectHead = 0;
+    uint8_t  injectReported = 0;
+    uint16_t injectNextId = 0; // Id of the frame that the host has to send next
+
+    // The timer interrupt has the same priority as the radio interrupt, the serial task only changes the state when idle
+    volatile uint8_t injectState = InjectState::Idle;
+
+    uint32_t injectCompareTime;      // Time at which the compare interrupt has to occur
+    uint32_t injectPreviousTime;     // SFD of the last frame that was done, relative times are counted from it
+    uint32_t injectPlannedTime;      // When the SFD of the frame at the front of the queue should be send
+    uint32_t injectPreviousPlanned;  // When the SFD of the last frame that was done should have been send, for INJECT_FLAG_TIMELINE
+    bool     injectPreviousValid = false;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Inject::queue(const uint8_t* message)
+    {
+        const uint8_t length = message[1] - INJECT_MESSAGE_LENGTH;
+        if ((message[1] < INJECT_MESSAGE_LENGTH) || (length < CC2538_RF_MIN_PACKET_LEN - 2) || (length > CC2538_RF_MAX_PACKET_LEN - 2))
+            return false;
+
+        // Hopping, following a TSCH network and the survey change the channel between frames, and they use the timer interrupt.
+        // Following the superframes of a beacon-enabled PAN turns the radio off between them.
+        const uint16_t id = readUint16((uint8_t*)message, INJECT_ID_OFFSET);
+        if ((injectState == InjectState::Idle)
+         && (Survey::isRunning() || Tsch::isRunning() || Superframe::isRunning() || Radio::isTimerInterruptEnabled()))
+        {
+            sendReport(id, INJECT_STATUS_UNAVAILABLE, 0);
+            return true;
+        }
+
+        // After a lost message, the frames behind it are rejected until the host sends them again starting from the expected id
+        if ((id != injectNextId) || (static_cast<uint8_t>(injectTail - injectReported) >= INJECT_QUEUE_LEN))
+        {
+            sendReport(id, INJECT_STATUS_REJECTED, 0);
+            return true;
+        }
+
+        InjectFrame& frame = injectQueue[injectTail % INJECT_QUEUE_LEN];
+        frame.id = id;
+        frame.flags = message[INJECT_FLAGS_OFFSET];
+        frame.length = length;
+        frame.time = readUint32((uint8_t*)message, INJECT_TIME_OFFSET);
+        for (uint8_t i = 0; i < length; ++i)
+            frame.data[i] = message[INJECT_FRAME_OFFSET + i];
+
+        // The timer interrupt sees the new tail before it decides that the queue is empty, otherwise it is started here
+        injectNextId++;
+        injectTail++;
+        const uint32_t interruptMask = enterCriticalSection();
+        if (injectState == InjectState::Idle)
+        {
+            Radio::enableTimerInterrupt(Inject::timerInterruptHandler);
+            scheduleNextFrame();
+        }
+
+        leaveCriticalSection(interruptMask);
+
+        sendReport(id, INJECT_STATUS_QUEUED, 0);
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Inject::reset()
+    {
+        const uint32_t interruptMask = enterCriticalSection();
+        if (injectState == InjectState::Transmitting)
+            CC2538_RF_CSP_ISRFOFF();
+        if (injectState != InjectState::Idle)
+            stopTimer();
+
+        injectState = InjectState::Idle;
+        leaveCriticalSection(interruptMask);
+
+        // The TX FIFO may only be flushed once the uDMA stopped writing the last frame into it
+        while (HWREG(UDMA_ENASET) & (1 << UDMA_INJECT_CHANNEL))
+            ;
+
+        CC2538_RF_CSP_ISFLUSHTX();
+        injectTail = 0;
+        injectHead = 0;
+        injectReported = 0;
+        injectNextId = 0;
+        injectPreviousValid = false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Inject::isActive()
+    {
+        return (injectState != InjectState::Idle);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Inject::sendPeriodically()
+    {
+        const uint8_t head = injectHead;
+        while (injectReported != head)
+        {
+            // The place is free again before the report is send, so that the report counts it
+            const InjectFrame& frame = injectQueue[injectReported % INJECT_QUEUE_LEN];
+            const uint16_t id = frame.id;
+            const uint8_t status = frame.status;
+            const uint32_t time = frame.resultTime;
+            injectReported++;
+
+            sendReport(id, status, time);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Inject::timerInterruptHandler()
+    {
+        IntPendClear(INT_MACTIMR);
+        const uint32_t flags = HWREG(RFCORE_SFR_MTIRQF) & HWREG(RFCORE_SFR_MTIRQM);
+        HWREG(RFCORE_SFR_MTIRQF) = 0;
+
+        // The overflow period in which the compare time lies has begun, the timer compare gives the exact moment.
+        // The timer compare only triggers when the timer passes it, which may already have happened when the interrupt was late.
+        if (flags & RFCORE_SFR_MTIRQM_MACTIMER_OVF_COMPARE1M)
+        {
+            armTickCompare();
+
+            uint32_t overflows;
+            if (static_cast<int32_t>(readTimer(overflows) - injectCompareTime) >= 0)
+                compareReached();
+        }
+        else if (flags & RFCORE_SFR_MTIRQM_MACTIMER_COMPARE1M)
+            compareReached();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void Inject::sendReport(uint16_t id, uint8_t status, uint32_t time)
+    {
+        uint8_t data[INJECT_REPORT_LENGTH];
+        writeUint16(data, 0, id);
+        data[2] = status;
+        data[3] = INJECT_QUEUE_LEN - static_cast<uint8_t>(injectTail - injectReported);
+        writeUint16(data, 4, injectNextId);
+        writeUint32(data, 6, time);
+        SerialSend::sendMessage(SerialDataType::Inject, data, sizeof(data));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Inject::scheduleNextFrame()
+    {
+        if (injectHead == injectTail)
+        {
+            injectState = InjectState::Idle;
+            stopTimer();
+            return;
+        }
+
+        // A relative time counts from the previous frame, the first frame after a reset is send at once
+        const InjectFrame& frame = injectQueue[injectHead % INJECT_QUEUE_LEN];
+        uint32_t sfdTime;
+        if (frame.flags & INJECT_FLAG_ABSOLUTE)
+            sfdTime = frame.time;
+        else if (injectPreviousValid)
+            sfdTime = ((frame.flags & INJECT_FLAG_TIMELINE) ? injectPreviousPlanned : injectPreviousTime) + frame.time;
+        else
+            sfdTime = Radio::getCurrentTime();
+
+        injectPlannedTime = sfdTime;
+        injectState = InjectState::Waiting;
+        scheduleAt(sfdTime - CC2538_RF_TX_SFD_TIME);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Inject::scheduleAt(uint32_t time)
+    {
+        // A frame that is late starts as soon as possible
+        uint32_t overflows;
+        const uint32_t now = readTimer(overflows);
+        const int32_t delay = static_cast<int32_t>(time - now);
+        if (delay < INJECT_SCHEDULE_MIN_DELAY)
+        {
+            compareReached();
+            return;
+        }
+
+        // The overflow counter and its compare register are both 24 bits wide and wrap around together
+        injectCompareTime = time;
+        const uint32_t periodsAhead = ((now & 1023) + delay) >> 10;
+        if (periodsAhead == 0)
+        {
+            armTickCompare();
+            if (static_cast<int32_t>(readTimer(overflows) - injectCompareTime) >= 0)
+                compareReached();
+
+            return;
+        }
+
+        const uint32_t compare = overflows + periodsAhead;
+        HWREG(RFCORE_SFR_MTMSEL) = (0x03 << RFCORE_SFR_MTMSEL_MTMOVFSEL_S);
+        HWREG(RFCORE_SFR_MTMOVF0) = (compare >> 0) & 0xff;
+        HWREG(RFCORE_SFR_MTMOVF1) = (compare >> 8) & 0xff;
+        HWREG(RFCORE_SFR_MTMOVF2) = (compare >> 16) & 0xff;
+        HWREG(RFCORE_SFR_MTIRQF) = 0;
+        HWREG(RFCORE_SFR_MTIRQM) = (HWREG(RFCORE_SFR_MTIRQM) & ~RFCORE_SFR_MTIRQM_MACTIMER_COMPARE1M)
+                                 | RFCORE_SFR_MTIRQM_MACTIMER_OVF_COMPARE1M;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void Inject::armTickCompare()
+    {
+        // The timer counts 32 ticks per microsecond and the compare matches in every overflow period, so the
+        // overflow compare is disabled at the same time. The flag would trigger the interrupt at once if it wasn't cleared.
+        const uint32_t ticks = (injectCompareTime & 1023) << 5;
+        HWREG(RFCORE_SFR_MTMSEL) = (0x03 << RFCORE_SFR_MTMSEL_MTMSEL_S);
+        HWREG(RFCORE_SFR_MTM0) = (ticks >> 0) & 0xff;
+        HWREG(RFCORE_SFR_MTM1) = (ticks >> 8) & 0xff;
+        HWREG(RFCORE_SFR_MTIRQF) = 0;
+        HWREG(RFCORE_SFR_MTIRQM) = (HWREG(RFCORE_SFR_MTIRQM) & ~RFCORE_SFR_MTIRQM_MACTIMER_OVF_COMPARE1M)
+                                 | RFCORE_SFR_MTIRQM_MACTIMER_COMPARE1M;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Inject::compareReached()
+    {
+        // The timer compare has to be disabled first, it also matches in every following overflow period
+        HWREG(RFCORE_SFR_MTIRQM) &= ~RFCORE_SFR_MTIRQM_MACTIMER_COMPARE1M;
+
+        if (injectState == InjectState::Waiting)
+            transmitFrame();
+        else if (injectState == InjectState::Transmitting)
+        {
+            // The end of the frame was calculated from the TX strobe, the turnaround time can be slightly longer
+            while (HWREG(RFCORE_XREG_FSMSTAT1) & RFCORE_XREG_FSMSTAT1_TX_ACTIVE)
+                ;
+
+            // The radio listens again until the next frame, the SFD of the transmission was captured by the MAC timer
+            CC2538_RF_CSP_ISRXON();
+            finishFrame(INJECT_STATUS_SENT, Radio::getSfdTime());
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Inject::transmitFrame()
+    {
+        // A frame that is being received would be aborted, the injected frame waits for it instead
+        if (Radio::isReceiving())
+        {
+            scheduleAt(Radio::getCurrentTime() + INJECT_RETRY_DELAY);
+            return;
+        }
+
+        // The previous frame may have been rejected by the CCA right after the uDMA was started
+        while (HWREG(UDMA_ENASET) & (1 << UDMA_INJECT_CHANNEL))
+            ;
+
+        InjectFrame& frame = injectQueue[injectHead % INJECT_QUEUE_LEN];
+        volatile tDMAControlTable& entry = uDMAChannelControlTable[UDMA_INJECT_CHANNEL];
+        entry.pvSrcEndAddr = (void*)&frame.data[frame.length - 1];
+        entry.ui32Control = (entry.ui32Control & ~(UDMACHCTL_CHCTL_XFERSIZE_M | UDMACHCTL_CHCTL_XFERMODE_M))
+                          | UDMA_MODE_AUTO | ((frame.length - 1) << UDMACHCTL_CHCTL_XFERSIZE_S);
+
+        // The radio only needs the length byte once the preamble and SFD were send, the uDMA fills the TX FIFO long before that.
+        // The FCS is added by the radio.
+        const bool cca = (frame.flags & INJECT_FLAG_CCA);
+        const uint32_t strobeTime = Radio::getCurrentTime();
+        CC2538_RF_CSP_ISFLUSHTX();
+        HWREG(RFCORE_SFR_RFST) = cca ? CC2538_RF_CSP_OP_ISTXONCCA : CC2538_RF_CSP_OP_ISTXON;
+        HWREG(RFCORE_SFR_RFDATA) = frame.length + 2;
+        HWREG(UDMA_ENASET) = (1 << UDMA_INJECT_CHANNEL);
+        HWREG(UDMA_SWREQ) = (1 << UDMA_INJECT_CHANNEL);
+
+        // The clear channel assessment is sampled by the strobe, the radio stays in RX when the channel was busy
+        if (cca && !(HWREG(RFCORE_XREG_FSMSTAT1) & RFCORE_XREG_FSMSTAT1_SAMPLED_CCA))
+        {
+            finishFrame(INJECT_STATUS_BUSY, strobeTime + CC2538_RF_TX_SFD_TIME);
+            return;
+        }
+
+        injectState = InjectState::Transmitting;
+        scheduleAt(strobeTime + CC2538_RF_TX_TURNAROUND_TIME + ((frame.length + CC2538_RF_TX_OVERHEAD_BYTES) * CC2538_RF_BYTE_TIME));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Inject::finishFrame(uint8_t status, uint32_t time)
+    {
+        InjectFrame& frame = injectQueue[injectHead % INJECT_QUEUE_LEN];
+        frame.status = status;
+        frame.resultTime = time;
+
+        // The serial task may report the frame as soon as the head moved past it
+        injectPreviousTime = time;
+        injectPreviousPlanned = injectPlannedTime;
+        injectPreviousValid = true;
+        injectHead++;
+        Serial::notifyFromInterrupt();
+
+        scheduleNextFrame();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void Inject::stopTimer()
+    {
+        Radio::disableTimerInterrupt();
+        HWREG(RFCORE_SFR_MTIRQM) &= ~RFCORE_SFR_MTIRQM_MACTIMER_COMPARE1M;
+        IntPendClear(INT_MACTIMR);
+        HWREG(RFCORE_SFR_MTIRQF) = 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline uint32_t Inject::readTimer(uint32_t& overflows)
+    {
+        // Reading MTM0 latches both the timer and the overflow counter
+        HWREG(RFCORE_SFR_MTMSEL) = (0x00 << RFCORE_SFR_MTMSEL_MTMSEL_S) | (0x00 << RFCORE_SFR_MTMSEL_MTMOVFSEL_S);
+
+        uint32_t ticks = HWREG(RFCORE_SFR_MTM0);
+        ticks |= HWREG(RFCORE_SFR_MTM1) << 8;
+
+        overflows = HWREG(RFCORE_SFR_MTMOVF0);
+        overflows |= HWREG(RFCORE_SFR_MTMOVF1) << 8;
+        overflows |= HWREG(RFCORE_SFR_MTMOVF2) << 16;
+
+        return (overflows << 10) | (ticks >> 5);
+    }
+}
@@ -0,0 +1,66 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_INJECT_HPP
+#define SNIFFER_INJECT_HPP
+
+#include "sniffer_global.hpp"
+
+namespace Sniffer
+{
+    // Transmits the frames that the host queues with INJECT messages, while the frames on the channel are still being captured.
+    // The uDMA loads each frame into the TX FIFO right after the TX strobe, the MAC timer compare interrupt gives the exact
+    // moment at which the frame starts and at which its transmission ends. The radio listens again between the frames.
+    class Inject
+    {
+    public:
+        // Queue the frame of an INJECT message and tell the host whether it was accepted, returns false for an invalid frame length
+        static bool queue(const uint8_t* message);
+
+        // Forget the queued frames and stop transmitting, called when the buffer is reset
+        static void reset();
+
+        // Check whether frames are being transmitted, the channel may not change and the timer interrupt is in use meanwhile
+        static bool isActive();
+
+        // Tell the host which frames were transmitted, called from the serial task
+        static void sendPeriodically();
+
+        // Function called when the MAC timer overflow counter or the MAC timer reaches its compare value
+        static void timerInterruptHandler();
+
+    private:
+        // Send an INJECT message about a frame to the host
+        static void sendReport(uint16_t id, uint8_t status, uint32_t time);
+
+        // Let the frame at the front of the queue start at its time, or stop the timer interrupt when the queue is empty
+        static void scheduleNextFrame();
+
+        // Let the compare interrupt occur at the given time, the compare is handled immediately when the time is too close
+        static void scheduleAt(uint32_t time);
+
+        // Let the compare interrupt occur when the MAC timer reaches the ticks of injectCompareTime in the current overflow period
+        static void armTickCompare();
+
+        // Transmit the frame or end its transmission, depending on what the compare interrupt was waiting for
+        static void compareReached();
+
+        // Start transmitting the frame at the front of the queue
+        static void transmitFrame();
+
+        // Store the outcome of the frame at the front of the queue and continue with the next frame
+        static void finishFrame(uint8_t status, uint32_t time);
+
+        // Stop the compare interrupts of both the overflow counter and the timer
+        static void stopTimer();
+
+        // Read the MAC timer in microseconds together with the full overflow counter, interrupts have to be disabled
+        static uint32_t readTimer(uint32_t& overflows);
+    };
+}
+
+#endif // SNIFFER_INJECT_HPP
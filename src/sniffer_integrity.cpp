@@ -0,0 +1,149 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_integrity.hpp"
+#include "sniffer_serial_send.hpp"
+
+#include "libcc2538_sha256.h"
+
+#define INTEGRITY_SEQNR_OFFSET  0
+#define INTEGRITY_COUNT_OFFSET  2
+#define INTEGRITY_HASH_OFFSET   6
+#define INTEGRITY_HMAC_OFFSET   (INTEGRITY_HASH_OFFSET + SHA256_OUTPUT_LEN)
+
+namespace Sniffer
+{
+    bool     integrityEnabled = false;
+    uint16_t integrityInterval = 0;
+    uint16_t integrityNextSeqNr = 0; // Sequence number of the record that will be added to the chain next
+    uint32_t integrityCount = 0; // Amount of records in the chain
+    bool     integrityCheckpointPending = false;
+
+    // The hash engine reads and writes its data with DMA, so the buffers are kept word aligned
+    tSHA256State integritySha;
+    uint8_t integrityKey[SHA256_BLOCK_SIZE] __attribute__((aligned(4)));
+    uint8_t integrityHash[SHA256_OUTPUT_LEN] __attribute__((aligned(4)));
+    uint8_t integrityCheckpoint[INTEGRITY_CHECKPOINT_LEN] __attribute__((aligned(4)));
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Authenticate the sequence number, count and hash of the checkpoint: SHA-256(key ^ opad, SHA-256(key ^ ipad, data))
+    inline void integrityHmac(uint8_t* checkpoint)
+    {
+        uint8_t pad[SHA256_BLOCK_SIZE] __attribute__((aligned(4)));
+        uint8_t innerHash[SHA256_OUTPUT_LEN] __attribute__((aligned(4)));
+
+        for (uint8_t i = 0; i < SHA256_BLOCK_SIZE; ++i)
+            pad[i] = integrityKey[i] ^ 0x36;
+
+        SHA256Init(&integritySha);
+        SHA256Process(&integritySha, pad, sizeof(pad));
+        SHA256Process(&integritySha, checkpoint, INTEGRITY_HMAC_OFFSET);
+        SHA256Done(&integritySha, innerHash);
+
+        for (uint8_t i = 0; i < SHA256_BLOCK_SIZE; ++i)
+            pad[i] = integrityKey[i] ^ 0x5c;
+
+        SHA256Init(&integritySha);
+        SHA256Process(&integritySha, pad, sizeof(pad));
+        SHA256Process(&integritySha, innerHash, sizeof(innerHash));
+        SHA256Done(&integritySha, checkpoint + INTEGRITY_HMAC_OFFSET);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Copy the current state of the chain into the checkpoint, it is authenticated when it gets send
+    inline void integrityTakeCheckpoint()
+    {
+        writeUint16(integrityCheckpoint, INTEGRITY_SEQNR_OFFSET, integrityNextSeqNr - 1);
+        writeUint32(integrityCheckpoint, INTEGRITY_COUNT_OFFSET, integrityCount);
+        for (uint8_t i = 0; i < SHA256_OUTPUT_LEN; ++i)
+            integrityCheckpoint[INTEGRITY_HASH_OFFSET + i] = integrityHash[i];
+
+        integrityCheckpointPending = true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Integrity::enable(const uint8_t* message)
+    {
+        const uint16_t interval = readUint16((uint8_t*)message, INTEGRITY_INTERVAL_OFFSET);
+        if (interval == 0)
+        {
+            disable();
+            return true;
+        }
+
+        for (uint8_t i = 0; i < INTEGRITY_KEY_LEN; ++i)
+            integrityKey[i] = message[INTEGRITY_KEY_OFFSET + i];
+        for (uint8_t i = INTEGRITY_KEY_LEN; i < SHA256_BLOCK_SIZE; ++i)
+            integrityKey[i] = 0;
+        for (uint8_t i = 0; i < SHA256_OUTPUT_LEN; ++i)
+            integrityHash[i] = 0;
+
+        // The chain starts at the next frame that the radio stores, the first checkpoint tells the host which one that is
+        integrityInterval = interval;
+        integrityNextSeqNr = seqNr;
+        integrityCount = 0;
+        integrityEnabled = true;
+
+        integrityTakeCheckpoint();
+        sendCheckpoint();
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Integrity::disable()
+    {
+        integrityEnabled = false;
+        integrityCheckpointPending = false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Integrity::isEnabled()
+    {
+        return integrityEnabled;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Integrity::hashRecord(uint16_t index)
+    {
+        if (readUint16(buffer, index + BUFFER_SEQNR_OFFSET) != integrityNextSeqNr)
+            return;
+
+        SHA256Init(&integritySha);
+        SHA256Process(&integritySha, integrityHash, sizeof(integrityHash));
+#if BUFFER_ALIGNED_RECORDS
+        // The hash covers the record in the layout without padding, the host removes the padding before checking it
+        SHA256Process(&integritySha, &buffer[index + 1], BUFFER_PADDING_OFFSET - 1);
+        SHA256Process(&integritySha, &buffer[index + BUFFER_EXTRA_BYTES], bufferRecordDataLength(index));
+#else
+        SHA256Process(&integritySha, &buffer[index + 1], buffer[index] - 1);
+#endif
+        SHA256Done(&integritySha, integrityHash);
+
+        integrityNextSeqNr++;
+        integrityCount++;
+        if (integrityCount % integrityInterval == 0)
+            integrityTakeCheckpoint();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Integrity::sendCheckpoint()
+    {
+        if (!integrityCheckpointPending)
+            return;
+
+        integrityHmac(integrityCheckpoint);
+        SerialSend::sendMessage(SerialDataType::Integrity, integrityCheckpoint, sizeof(integrityCheckpoint));
+        integrityCheckpointPending = false;
+    }
+}
@@ -0,0 +1,38 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_INTEGRITY_HPP
+#define SNIFFER_INTEGRITY_HPP
+
+#include "sniffer_global.hpp"
+
+namespace Sniffer
+{
+    // Keeps a SHA-256 chain over the records that are send to the host, calculated by the hash engine of the CC2538.
+    // Every hash covers the previous hash and the record (as it is send, without its length byte). Checkpoints with the
+    // current hash are authenticated with HMAC-SHA-256, so that the host can prove that it didn't change the records.
+    class Integrity
+    {
+    public:
+        // Start a new chain with the key and checkpoint interval from the INTEGRITY message, answered with a first checkpoint
+        static bool enable(const uint8_t* message);
+
+        // Stop hashing the records, called when the buffer is reset
+        static void disable();
+
+        // Check whether the records have to be hashed
+        static bool isEnabled();
+
+        // Add the record to the chain when it is the next one, records that are send again were already added before
+        static void hashRecord(uint16_t index);
+
+        // Send the checkpoint that was taken after the last interval to the host, called from the serial task
+        static void sendCheckpoint();
+    };
+}
+
+#endif // SNIFFER_INTEGRITY_HPP
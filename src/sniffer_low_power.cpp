@@ -0,0 +1,125 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Tickless idle for the low-power build, based on the port of projects/freertos-tickless-cc2538. The tick comes from the
+// sleep timer instead of the SysTick, so that the processor isn't woken 100 times per second while the channel is idle.
+// Unlike that port this one never goes below PM0: PM1 and deeper turn off the 32 MHz crystal oscillator, which stops the
+// radio, the MAC timer of the timestamps and the UART. In PM0 only the processor sleeps, and every enabled interrupt
+// (the radio, the uDMA, the UART and the sleep timer) wakes it up without missing a frame.
+
+#ifdef SNIFFER_LOW_POWER
+
+#include "sniffer_global.hpp"
+
+#include "task.h"
+#include "hw_sys_ctrl.h"
+#include "libcc2538_sleepmode.h"
+#include "libcc2538_sys_ctrl.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define LOW_POWER_CLOCK_HZ      32768UL
+#define LOW_POWER_MIN_COMPARE   3       // Counts that a compare value has to lie in the future for the sleep timer to catch it
+
+// Sleep timer counts per tick, and the longest time that the tick can be suppressed before the counter wraps
+static const uint32_t countsPerTick = LOW_POWER_CLOCK_HZ / configTICK_RATE_HZ;
+static const TickType_t maxSuppressedTicks = 0x7FFFFFFFUL / countsPerTick;
+
+// Sleep timer value of the last tick that was counted, the next tick is due one tick period later
+static uint32_t lastTickCount = 0;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The sleep timer only interrupts when its value equals the compare value, when that moment already passed
+// the interrupt is pended directly instead of waiting for the counter to wrap
+static void setSleepTimerCompare(uint32_t compare)
+{
+    SleepModeTimerCompareSet(compare);
+    if (static_cast<int32_t>(compare - SleepModeTimerCountGet()) < LOW_POWER_MIN_COMPARE)
+        IntPendSet(INT_SMTIM);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void sleepTimerHandler()
+{
+    IntPendClear(INT_SMTIM);
+
+    // Ticks that were suppressed are added by vPortSuppressTicksAndSleep, this is always the next single tick
+    lastTickCount += countsPerTick;
+    setSleepTimerCompare(lastTickCount + countsPerTick);
+
+    const UBaseType_t mask = portSET_INTERRUPT_MASK_FROM_ISR();
+    portEND_SWITCHING_ISR(xTaskIncrementTick());
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Replaces the weak version of the port, which starts the SysTick
+extern "C" void vPortSetupTimerInterrupt()
+{
+    // The 32 kHz oscillator has to be stable before the sleep timer can be used
+    while (HWREG(SYS_CTRL_CLOCK_STA) & SYS_CTRL_CLOCK_STA_OSC32K);
+
+    IntRegister(INT_SMTIM, sleepTimerHandler);
+    IntPendClear(INT_SMTIM);
+
+    // The tick interrupt must have the lowest priority, like the SysTick that it replaces
+    IntPrioritySet(INT_SMTIM, configTICK_LOWEST_INTERRUPT_PRIORITY);
+
+    lastTickCount = SleepModeTimerCountGet();
+    setSleepTimerCompare(lastTickCount + countsPerTick);
+    IntEnable(INT_SMTIM);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Called by the idle task with the scheduler suspended, when the serial task waits for at least two ticks
+extern "C" void vPortSuppressTicksAndSleep(TickType_t expectedIdleTicks)
+{
+    if (expectedIdleTicks > maxSuppressedTicks)
+        expectedIdleTicks = maxSuppressedTicks;
+
+    // Interrupts are masked with cpsid instead of taskENTER_CRITICAL, which would keep them from waking the processor.
+    // A pending interrupt still ends the sleep, it is handled once they are unmasked again.
+    __asm volatile ("cpsid i");
+    __asm volatile ("dsb");
+    __asm volatile ("isb");
+
+    // An interrupt may have made the serial task ready after the idle task decided to sleep
+    if (eTaskConfirmSleepModeStatus() == eAbortSleep)
+    {
+        __asm volatile ("cpsie i");
+        return;
+    }
+
+    // Wake up at the tick that ends the expected idle time, unless another interrupt comes first
+    IntPendClear(INT_SMTIM);
+    setSleepTimerCompare(lastTickCount + countsPerTick * expectedIdleTicks);
+
+    // PM0: the processor sleeps until the next interrupt while all clocks and peripherals keep running
+    SysCtrlPowerModeSet(SYS_CTRL_PM_NOACTION);
+    SysCtrlSleep();
+
+    // Step over the ticks that passed completely. The last tick of the idle time is left to the sleep timer interrupt,
+    // because only a tick that is counted by the interrupt wakes up the serial task when its timeout expires.
+    TickType_t completeTicks = (SleepModeTimerCountGet() - lastTickCount) / countsPerTick;
+    if (completeTicks >= expectedIdleTicks)
+        completeTicks = expectedIdleTicks - 1;
+
+    lastTickCount += countsPerTick * completeTicks;
+    IntPendClear(INT_SMTIM);
+    setSleepTimerCompare(lastTickCount + countsPerTick);
+    vTaskStepTick(completeTicks);
+
+    __asm volatile ("cpsie i");
+    __asm volatile ("dsb");
+    __asm volatile ("isb");
+}
+
+#endif // SNIFFER_LOW_POWER
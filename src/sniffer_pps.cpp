@@ -0,0 +1,83 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_pps.hpp"
+#include "sniffer_radio.hpp"
+#include "sniffer_serial.hpp"
+
+#include "openmote-cc2538.h"
+
+namespace Sniffer
+{
+    bool     ppsEnabled = false;
+    uint32_t ppsPulseCount = 0;     // Pulses since the input was enabled, the host notices the ones that weren't stored
+
+    // Latched by the interrupt until the serial task stores the record
+    volatile bool ppsPulseLatched = false;
+    uint32_t ppsLatchedPulse;
+    uint32_t ppsLatchedTime;
+
+#if !SNIFFER_NATIVE // The native build has no GPIO pins, the input never sees a pulse there
+    GpioIn ppsInput(PPS_PORT, PPS_PIN, GPIO_RISING_EDGE);
+    PlainCallback ppsCallback(&Pps::edgeInterrupt);
+#endif
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Pps::enable(bool enabled)
+    {
+        ppsPulseCount = 0;
+        ppsPulseLatched = false;
+        ppsEnabled = enabled;
+
+#if !SNIFFER_NATIVE
+        if (enabled)
+        {
+            // The callback registration gives the port the lowest priority, which would let every other interrupt delay the time
+            ppsInput.setCallback(&ppsCallback);
+            IntPrioritySet(PPS_INTERRUPT, INTERRUPT_PRIORITY_RADIO);
+            ppsInput.enableInterrupts();
+        }
+        else
+            ppsInput.disableInterrupts();
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Pps::edgeInterrupt()
+    {
+        // The time is read before anything else, what the interrupt does afterwards doesn't change it
+        const uint32_t edgeTime = Radio::getCurrentTime();
+        if (!ppsEnabled)
+            return;
+
+        // The interrupt can occur while a frame is being copied into the buffer, so the record is stored by the serial task.
+        // A pulse that replaces one that wasn't stored yet leaves a gap in the numbers, which the host notices.
+        ppsLatchedPulse = ppsPulseCount++;
+        ppsLatchedTime = edgeTime;
+        ppsPulseLatched = true;
+        Serial::notifyFromInterrupt();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Pps::storePulse()
+    {
+        if (!ppsPulseLatched)
+            return;
+
+        // The record is tried again the next time that the task runs when a frame is still being copied
+        const uint32_t interruptMask = enterCriticalSection();
+        uint8_t data[PPS_RECORD_LENGTH];
+        writeUint32(data, PPS_PULSE_OFFSET, ppsLatchedPulse);
+        if (Radio::storeRecord(RECORD_TYPE_PPS, data, PPS_RECORD_LENGTH, ppsLatchedTime))
+            ppsPulseLatched = false;
+
+        leaveCriticalSection(interruptMask);
+    }
+}
@@ -0,0 +1,33 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_PPS_HPP
+#define SNIFFER_PPS_HPP
+
+#include "sniffer_global.hpp"
+
+namespace Sniffer
+{
+    // Stores a record with the time of every rising edge on the pulse-per-second input (PPS_PORT and PPS_PIN), so that
+    // the host can turn the timestamps into absolute time with a GPS receiver or a clock that follows NTP.
+    // The time is read in the GPIO interrupt, which has the priority of the radio interrupt, and the record is stored by the
+    // serial task.
+    class Pps
+    {
+    public:
+        // Start or stop storing the pulses of the PPS message, the pulses are counted from 0 again
+        static void enable(bool enabled);
+
+        // Function called from the GPIO interrupt on a rising edge of the input
+        static void edgeInterrupt();
+
+        // Store the record of the last pulse when there is one, called from the serial task
+        static void storePulse();
+    };
+}
+
+#endif // SNIFFER_PPS_HPP
@@ -0,0 +1,235 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_profiling.hpp"
+
+namespace Sniffer
+{
+#if PROFILING
+    struct ProfilingMeasurements
+    {
+        uint32_t count;
+        uint32_t min;
+        uint32_t max;
+        uint64_t total;
+        uint16_t histogram[PROFILING_HISTOGRAM_BINS];
+    };
+
+    ProfilingMeasurements profilingMeasurements[ProfilingSection::Count];
+
+    struct LatencyMeasurements
+    {
+        uint16_t max;
+        uint32_t total;
+        uint16_t histogram[LATENCY_HISTOGRAM_BINS];
+    };
+
+    struct LatencyClass
+    {
+        uint32_t frames;
+        LatencyMeasurements points[LatencyPoint::Count];
+    };
+
+    LatencyClass latencyClasses[LATENCY_LENGTH_CLASSES];
+    uint32_t latencyInterruptTime = 0;
+    uint32_t latencyFrameEnd = 0;     // Time at which the last byte of the frame that is being handled arrived
+    uint8_t  latencyFrameClass = LATENCY_LENGTH_CLASSES; // Length class of that frame, or LATENCY_LENGTH_CLASSES when there is none
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Bin of the histogram from the amount of significant bits in the value
+    inline uint8_t histogramBin(uint32_t value, uint8_t firstBinBits, uint8_t bins)
+    {
+        const uint8_t bits = (value == 0) ? 0 : (32 - __builtin_clz(value));
+        const uint8_t bin = (bits > firstBinBits) ? (bits - firstBinBits) : 0;
+        return (bin < bins) ? bin : (bins - 1);
+    }
+#endif
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Profiling::initialize()
+    {
+        // The trace recorder also timestamps its events with the cycle counter
+#if PROFILING || TRACE_RECORDER
+        HWREG(DEMCR) |= DEMCR_TRCENA;
+        HWREG(DWT_CYCCNT) = 0;
+        HWREG(DWT_CTRL) |= DWT_CTRL_CYCCNTENA;
+#endif
+#if PROFILING
+        clear();
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Profiling::clear()
+    {
+#if PROFILING
+        // Sections are also measured inside the radio interrupt
+        const uint32_t interruptMask = enterCriticalSection();
+
+        for (uint8_t section = 0; section < ProfilingSection::Count; ++section)
+        {
+            ProfilingMeasurements& measurements = profilingMeasurements[section];
+            measurements.count = 0;
+            measurements.min = 0xffffffff;
+            measurements.max = 0;
+            measurements.total = 0;
+            for (uint8_t i = 0; i < PROFILING_HISTOGRAM_BINS; ++i)
+                measurements.histogram[i] = 0;
+        }
+
+        for (uint8_t lengthClass = 0; lengthClass < LATENCY_LENGTH_CLASSES; ++lengthClass)
+        {
+            latencyClasses[lengthClass].frames = 0;
+            for (uint8_t point = 0; point < LatencyPoint::Count; ++point)
+            {
+                LatencyMeasurements& measurements = latencyClasses[lengthClass].points[point];
+                measurements.max = 0;
+                measurements.total = 0;
+                for (uint8_t i = 0; i < LATENCY_HISTOGRAM_BINS; ++i)
+                    measurements.histogram[i] = 0;
+            }
+        }
+        latencyFrameClass = LATENCY_LENGTH_CLASSES;
+
+        leaveCriticalSection(interruptMask);
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint8_t Profiling::writeReport(uint8_t* data)
+    {
+#if PROFILING
+        // The caller has already disabled interrupts so that the measurements can't change while copying them
+        for (uint8_t section = 0; section < ProfilingSection::Count; ++section)
+        {
+            const ProfilingMeasurements& measurements = profilingMeasurements[section];
+            const uint16_t offset = section * PROFILING_REPORT_SECTION_LEN;
+            writeUint32(data, offset + 0, measurements.count);
+            writeUint32(data, offset + 4, (measurements.count > 0) ? measurements.min : 0);
+            writeUint32(data, offset + 8, measurements.max);
+            writeUint32(data, offset + 12, (uint32_t)(measurements.total >> 32));
+            writeUint32(data, offset + 16, (uint32_t)measurements.total);
+            for (uint8_t i = 0; i < PROFILING_HISTOGRAM_BINS; ++i)
+                writeUint16(data, offset + 20 + 2 * i, measurements.histogram[i]);
+        }
+
+        return ProfilingSection::Count * PROFILING_REPORT_SECTION_LEN;
+#else
+        (void)data;
+        return 0;
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint8_t Profiling::writeLatencyReport(uint8_t* data)
+    {
+#if PROFILING
+        // The caller has already disabled interrupts, like for writeReport
+        for (uint8_t lengthClass = 0; lengthClass < LATENCY_LENGTH_CLASSES; ++lengthClass)
+        {
+            uint16_t offset = lengthClass * LATENCY_REPORT_CLASS_LEN;
+            writeUint32(data, offset, latencyClasses[lengthClass].frames);
+            offset += 4;
+
+            for (uint8_t point = 0; point < LatencyPoint::Count; ++point)
+            {
+                const LatencyMeasurements& measurements = latencyClasses[lengthClass].points[point];
+                writeUint16(data, offset + 0, measurements.max);
+                writeUint32(data, offset + 2, measurements.total);
+                for (uint8_t i = 0; i < LATENCY_HISTOGRAM_BINS; ++i)
+                    writeUint16(data, offset + 6 + 2 * i, measurements.histogram[i]);
+
+                offset += LATENCY_REPORT_POINT_LEN;
+            }
+        }
+
+        return LATENCY_LENGTH_CLASSES * LATENCY_REPORT_CLASS_LEN;
+#else
+        (void)data;
+        return 0;
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#if PROFILING
+    SNIFFER_RAM_FUNCTION void Profiling::interruptEntered(uint32_t now)
+    {
+        latencyInterruptTime = now;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION void Profiling::frameCopied(uint32_t sfdTime, uint8_t length, uint32_t now)
+    {
+        // The SFD is captured at its end, the length byte and the frame follow it
+        latencyFrameEnd = sfdTime + (1 + length) * CC2538_RF_BYTE_TIME;
+        latencyFrameClass = (length & 0x7f) >> 5;
+        latencyClasses[latencyFrameClass].frames++;
+
+        // A frame that arrived while the interrupt was already running wasn't late at all
+        addLatency(LatencyPoint::InterruptEntry, latencyInterruptTime - latencyFrameEnd);
+        addLatency(LatencyPoint::CopyDone, now - latencyFrameEnd);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION void Profiling::frameHandled(uint32_t now)
+    {
+        if (latencyFrameClass >= LATENCY_LENGTH_CLASSES)
+            return;
+
+        addLatency(LatencyPoint::ReceiverReady, now - latencyFrameEnd);
+        latencyFrameClass = LATENCY_LENGTH_CLASSES;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION void Profiling::addLatency(uint8_t point, uint32_t time)
+    {
+        // Only called from the radio and uDMA interrupts, which don't interrupt each other
+        if (static_cast<int32_t>(time) < 0)
+            time = 0;
+
+        LatencyMeasurements& measurements = latencyClasses[latencyFrameClass].points[point];
+        measurements.total += time;
+        if (time > measurements.max)
+            measurements.max = (time < 0xffff) ? time : 0xffff;
+
+        uint16_t& bin = measurements.histogram[histogramBin(time, LATENCY_FIRST_BIN_BITS, LATENCY_HISTOGRAM_BINS)];
+        if (bin < 0xffff)
+            bin++;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Profiling::addMeasurement(uint8_t section, uint32_t cycles)
+    {
+        // Measurements from the serial task must not be interrupted halfway by one from the radio interrupt
+        const uint32_t interruptMask = enterCriticalSection();
+
+        ProfilingMeasurements& measurements = profilingMeasurements[section];
+        measurements.count++;
+        measurements.total += cycles;
+        if (cycles < measurements.min)
+            measurements.min = cycles;
+        if (cycles > measurements.max)
+            measurements.max = cycles;
+
+        const uint8_t bin = histogramBin(cycles, PROFILING_FIRST_BIN_BITS, PROFILING_HISTOGRAM_BINS);
+        if (measurements.histogram[bin] < 0xffff)
+            measurements.histogram[bin]++;
+
+        leaveCriticalSection(interruptMask);
+    }
+#endif
+}
@@ -0,0 +1,118 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_PROFILING_HPP
+#define SNIFFER_PROFILING_HPP
+
+#include "sniffer_global.hpp"
+
+// Registers of the Cortex-M3 debug unit that contain the cycle counter
+#define DWT_CTRL                0xE0001000
+#define DWT_CTRL_CYCCNTENA      (1 << 0)
+#define DWT_CYCCNT              0xE0001004
+#define DEMCR                   0xE000EDFC
+#define DEMCR_TRCENA            (1 << 24)
+
+// Each section keeps a histogram where bin i counts the measurements below 2^(PROFILING_FIRST_BIN_BITS + i) cycles,
+// the last bin counts everything that is longer
+#define PROFILING_HISTOGRAM_BINS    8
+#define PROFILING_FIRST_BIN_BITS    6
+
+// Bytes per section in the STATS message: count, min and max (4 bytes each), the 8 byte total followed by the histogram
+// (2 bytes per bin). The host calculates the mean, the 64-bit division isn't available as libgcc isn't linked.
+#define PROFILING_REPORT_SECTION_LEN    (20 + 2 * PROFILING_HISTOGRAM_BINS)
+
+// Every frame is also timed with the MAC timer, from the moment its last byte arrived until the radio interrupt started, until
+// its copy to the buffer was finished and until the receiver was ready for the next frame. The measurements are kept per class
+// of frame lengths, with a histogram in microseconds where bin i counts the times below 2^(LATENCY_FIRST_BIN_BITS + i).
+#define LATENCY_LENGTH_CLASSES          4   // Frames of up to 31, 63, 95 and 127 bytes
+#define LATENCY_HISTOGRAM_BINS          6
+#define LATENCY_FIRST_BIN_BITS          4
+
+// Bytes per length class in the LATENCY message: the frame count (4 bytes), followed for every point by its maximum (2 bytes),
+// the total (4 bytes) and the histogram (2 bytes per bin)
+#define LATENCY_REPORT_POINT_LEN        (6 + 2 * LATENCY_HISTOGRAM_BINS)
+#define LATENCY_REPORT_CLASS_LEN        (4 + LatencyPoint::Count * LATENCY_REPORT_POINT_LEN)
+
+namespace Sniffer
+{
+    namespace ProfilingSection
+    {
+        enum ProfilingSection
+        {
+            RadioInterrupt,
+            HdlcEncode,
+            SerialReceive,
+            Count
+        };
+    }
+
+    namespace LatencyPoint
+    {
+        enum LatencyPoint
+        {
+            InterruptEntry, // The radio interrupt started handling the frame
+            CopyDone,       // The frame was copied to the buffer
+            ReceiverReady,  // The frame was handled and the receiver was turned on again (without RADIO_CONTINUOUS_RX)
+            Count
+        };
+    }
+
+    class Profiling
+    {
+    public:
+        // Enable the cycle counter
+        static void initialize();
+
+        // Forget all measurements
+        static void clear();
+
+        // Write the measurements of all sections in the format of the STATS message, returns the amount of bytes written
+        static uint8_t writeReport(uint8_t* data);
+
+        // Write the frame timing of all length classes in the format of the LATENCY message, returns the amount of bytes written
+        static uint8_t writeLatencyReport(uint8_t* data);
+
+        // Remember the MAC timer at the start of the radio interrupt, only called when PROFILING is set
+        static void interruptEntered(uint32_t now);
+
+        // Measure how late the frame with this SFD time and length (including the RSSI and CRC/LQI bytes) was taken from the
+        // FIFO and copied, called when its copy was done. Only called when PROFILING is set.
+        static void frameCopied(uint32_t sfdTime, uint8_t length, uint32_t now);
+
+        // Measure how long the receiver was unable to take the next frame, called once the copied frame was handled
+        static void frameHandled(uint32_t now);
+
+        // Read the cycle counter at the beginning of the section
+        static inline uint32_t start()
+        {
+#if PROFILING
+            return HWREG(DWT_CYCCNT);
+#else
+            return 0;
+#endif
+        }
+
+        // Add the amount of cycles since the start of the section to the measurements
+        static inline void stop(uint8_t section, uint32_t startCycles)
+        {
+#if PROFILING
+            addMeasurement(section, HWREG(DWT_CYCCNT) - startCycles);
+#else
+            (void)section;
+            (void)startCycles;
+#endif
+        }
+
+    private:
+        static void addMeasurement(uint8_t section, uint32_t cycles);
+
+        static void addLatency(uint8_t point, uint32_t time);
+    };
+}
+
+#endif // SNIFFER_PROFILING_HPP
@@ -0,0 +1,764 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_PROTOCOL_HPP
+#define SNIFFER_PROTOCOL_HPP
+
+// Everything that the OpenMote and the host have to agree on: the framing, the messages and the layout of the records.
+// This header doesn't depend on the firmware, the native host library in the host directory includes it as well.
+
+#include <stdint.h>
+
+// Defined in sniffer_precompiled_crc16_table.h, which is only included in sniffer_global.cpp (and in the host library) to have a single copy
+extern const uint16_t crc16_table[256];
+
+// Defined in sniffer_precompiled_hdlc_table.h in the same way. The entry of HDLC_FLAG and HDLC_ESCAPE holds HDLC_ESCAPE in
+// the lower byte and the escaped byte in the upper byte, every other byte maps on itself.
+extern const uint16_t hdlc_escape_table[256];
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define HDLC_FLAG           0x7E
+#define HDLC_ESCAPE         0x7D
+#define HDLC_ESCAPE_MASK    0x20
+
+// Instead of escaping, the records can be framed with Consistent Overhead Byte Stuffing, which adds at most one byte per 254.
+// The encoded bytes are XORed with COBS_XOR_MASK, COBS removes every zero so that HDLC_FLAG never appears between the flags.
+// Only the frames towards the host change: the messages that the host sends, and those that the OpenMote sends itself, stay HDLC.
+#define COBS_XOR_MASK       HDLC_FLAG
+#define COBS_MAX_BLOCK_LEN  0xFF    // Code byte of a block of 254 non-zero bytes that isn't followed by a zero
+
+#define CRC_INIT                0xffff
+
+#define ACK_MESSAGE_LENGTH      6   // Length = 2 bytes index + 2 bytes sequence number + 2 bytes crc
+#define ACK_INDEX_OFFSET        2
+#define ACK_SEQNR_OFFSET        4
+
+#define NACK_MESSAGE_LENGTH     6   // Length = 2 bytes index + 2 bytes sequence number + 2 bytes crc
+#define NACK_INDEX_OFFSET       2
+#define NACK_SEQNR_OFFSET       4
+
+#define SELECTIVE_NACK_MESSAGE_LENGTH   8   // Length = 2 bytes index + 2 bytes sequence number + 2 bytes packet count + 2 bytes crc
+#define SELECTIVE_NACK_INDEX_OFFSET     2
+#define SELECTIVE_NACK_SEQNR_OFFSET     4
+#define SELECTIVE_NACK_COUNT_OFFSET     6
+
+// A cumulative ACK acknowledges everything up to the record, as an ACK, and has a bit for each of the records behind it that
+// the host is still missing (bit 0 is the record directly behind it). The OpenMote resends the range up to the last missing one.
+#define CUMULATIVE_ACK_MESSAGE_LENGTH   10  // Length = 2 bytes index + 2 bytes sequence number + 4 bytes missing bitmap + 2 bytes crc
+#define CUMULATIVE_ACK_INDEX_OFFSET     2
+#define CUMULATIVE_ACK_SEQNR_OFFSET     4
+#define CUMULATIVE_ACK_MISSING_OFFSET   6
+#define CUMULATIVE_ACK_MISSING_RANGE    32  // Amount of records behind the acknowledged one that the bitmap covers
+
+// With CAPABILITY_RECORD_INDEX the host may send this instead of the index in an ACK, NACK, selective NACK or RESUME.
+// The OpenMote then looks up the record by its sequence number, which only works for the last RECORD_INDEX_LEN records.
+#define RECORD_INDEX_UNKNOWN            0xFFFF
+
+#define RESET_MESSAGE_LENGTH    3   // Length = radio channel + 2 bytes crc
+#define RESET_CHANNEL_OFFSET    2
+
+#define RESET_EXTENDED_MESSAGE_LENGTH   7   // Length = radio channel + 2 bytes window size + 2 bytes ACK interval + 2 bytes crc
+#define RESET_WINDOW_OFFSET             3
+#define RESET_ACK_INTERVAL_OFFSET       5
+
+// With CAPABILITY2_ACK_REQUEST the host may set this bit in the ACK interval of a RESET or SURVEY message. It then only sends an
+// ACK after the interval when a record asked for it, and otherwise only after a longer delay. The OpenMote sets ACK_REQUESTED in
+// the type of the Packet, PacketBatch and Survey messages while more than ACK_REQUEST_PERCENTAGE of its window is unacknowledged.
+// The READY message has the bit in its ACK interval as well when the OpenMote does this.
+#define ACK_INTERVAL_ON_REQUEST         0x8000
+#define ACK_REQUESTED                   0x80
+
+#define FILTER_MESSAGE_LENGTH       18  // Length = rule + fields + frame type + 2 bytes dst pan + 2 bytes src pan + address mode + 8 bytes address + 2 bytes crc
+#define FILTER_RULE_OFFSET          2
+#define FILTER_FIELDS_OFFSET        3
+#define FILTER_FRAME_TYPE_OFFSET    4
+#define FILTER_DST_PAN_OFFSET       5
+#define FILTER_SRC_PAN_OFFSET       7
+#define FILTER_ADDR_MODE_OFFSET     9
+#define FILTER_ADDR_OFFSET          10
+
+#define FILTER_STATS_MESSAGE_LENGTH 2   // Length = 2 bytes crc
+
+#define FILTER_MAX_RULES            8
+#define FILTER_MATCH_FRAME_TYPE     (1 << 0)
+#define FILTER_MATCH_DST_PAN        (1 << 1)
+#define FILTER_MATCH_SRC_PAN        (1 << 2)
+#define FILTER_MATCH_DST_ADDR       (1 << 3)
+#define FILTER_MATCH_SRC_ADDR       (1 << 4)
+
+// Next to the rules, the host can upload a small program that also has to accept a frame before it is stored. Every instruction
+// consists of the opcode, the amount of instructions to skip when the condition is true and when it is false, and a 2 byte
+// operand. The loads put a byte, a big endian or a little endian halfword of the frame in the accumulator, at the offset in the
+// operand from the start of the frame or, with FILTER_OP_PAYLOAD, from the start of the MAC payload (behind the addressing fields
+// and the auxiliary security header). A load beyond the end of the frame rejects it. Jumps only go forward, so no instruction is
+// executed twice, and running past the last instruction rejects the frame. A message without instructions removes the program.
+#define FILTER_PROGRAM_MESSAGE_LENGTH       2   // Length = instructions + 2 bytes crc
+#define FILTER_PROGRAM_OFFSET               2
+#define FILTER_PROGRAM_INSTRUCTION_LENGTH   5
+#define FILTER_PROGRAM_MAX_INSTRUCTIONS     48  // Longer programs than SERIAL_RX_MAX_MESSAGE_LEN allows have to be send with CONTROL
+#define FILTER_OP_RET                       0   // Accept the frame when the operand isn't 0, reject it otherwise
+#define FILTER_OP_LD_BYTE                   1
+#define FILTER_OP_LD_HALF                   2   // Big endian, like the headers of the upper layers
+#define FILTER_OP_LD_HALF_LE                3   // Little endian, like the fields of the MAC header
+#define FILTER_OP_LD_LENGTH                 4   // Length of the frame without the FCS
+#define FILTER_OP_AND                       5
+#define FILTER_OP_JEQ                       6
+#define FILTER_OP_JGT                       7
+#define FILTER_OP_JGE                       8
+#define FILTER_OP_JSET                      9   // Condition is true when the accumulator has any of the bits of the operand
+#define FILTER_OP_PAYLOAD                   0x80
+
+#define SNAP_LENGTH_MESSAGE_LENGTH  3   // Length = snap length + 2 bytes crc
+#define SNAP_LENGTH_OFFSET          2
+
+// While less than BUFFER_OVERFLOW_RESERVE bytes of the buffer are free, the host can let the OpenMote sacrifice some frames to keep
+// room for others instead of dropping whatever arrives once the buffer is full. Frames are dropped or truncated after having been
+// copied, so the sequence numbers don't show them as lost, the STATS message counts them instead.
+#define OVERFLOW_MESSAGE_LENGTH         3   // Length = policy + 2 bytes crc
+#define OVERFLOW_POLICY_OFFSET          2
+#define OVERFLOW_POLICY_DROP_NEW        0   // Only drop the frames that no longer fit (default)
+#define OVERFLOW_POLICY_KEEP_HEADERS    1   // Only keep the MAC header, RSSI and LQI of the frames
+#define OVERFLOW_POLICY_PREFER_CONTROL  2   // Drop data and ACK frames, keep the beacons and MAC commands
+#define OVERFLOW_POLICY_ADAPTIVE        3   // Step down through the degradation levels below as the buffer fills up (CAPABILITY_ADAPTIVE_OVERFLOW)
+#define OVERFLOW_HEADER_LENGTH          23  // Longest MAC header without security and IEs (both PANs and extended addresses)
+
+// With the adaptive policy the OpenMote already gives up some fidelity while the buffer is still filling up, so that every frame
+// keeps at least its header instead of whole frames being lost once the buffer is full. Each level starts at ADAPTIVE_OVERFLOW_START
+// bytes in the buffer plus one ADAPTIVE_OVERFLOW_STEP per level and is only left once the buffer drained a full step below that.
+// Every change of level is reported in a DEGRADATION message with the new level, the sequence number of the first record to which
+// it applies and the amount of bytes in the buffer at that moment.
+#define DEGRADATION_LEVEL_FULL          0   // Entire frames (up to the snap length)
+#define DEGRADATION_LEVEL_HEADERS       1   // Only the MAC header, RSSI and LQI of the frames
+#define DEGRADATION_LEVEL_NO_ACKS       2   // Only the MAC headers, ACK frames are dropped
+#define DEGRADATION_LEVEL_MINIMAL       3   // Only the frame control and sequence number, ACK frames are dropped
+#define DEGRADATION_MINIMAL_LENGTH      3
+#define DEGRADATION_REPORT_LENGTH       5
+
+// Frames of which the radio found the FCS to be wrong (CRC_OK bit cleared in the LQI byte) can be discarded right after they were
+// copied instead of being send to the host, which would discard them anyway. The STATS message counts them.
+#define FCS_FILTER_MESSAGE_LENGTH       3   // Length = drop bad FCS (0 or 1) + 2 bytes crc
+#define FCS_FILTER_DROP_OFFSET          2
+
+// Frames that were dropped are counted per frame type in the STATS message, types above 3 are counted together
+#define OVERFLOW_FRAME_TYPE_COUNT       5
+
+// The host can let the OpenMote replace MAC retries, frames with exactly the same contents as a frame that was captured shortly
+// before, by a record that only contains the sequence number of that earlier record followed by the RSSI and CRC/LQI bytes.
+// The channel byte of such a record has BUFFER_CHANNEL_DUPLICATE set. The earlier record is never more than
+// DUPLICATE_MAX_DISTANCE sequence numbers back, so that the host only has to remember the last frames.
+#define DUPLICATES_MESSAGE_LENGTH   3   // Length = enabled + 2 bytes crc
+#define DUPLICATES_ENABLED_OFFSET   2
+#define DUPLICATE_MARKER_LEN        4   // 2 bytes sequence number of the original + RSSI + CRC/LQI
+#define DUPLICATE_MAX_DISTANCE      64
+
+// The host can let the OpenMote send the MAC header of a frame as the difference with the header of an earlier record of the same
+// length, the payload stays as it is. Such a record starts with how many sequence numbers that earlier record lies back (less than
+// DUPLICATE_MAX_DISTANCE, so the host needs the same records as for the duplicates), the header length and a bitmap with a bit for
+// every header byte (lowest bit first), followed by the header bytes that differ. Its channel byte has BUFFER_CHANNEL_COMPRESSED set.
+#define COMPRESSION_MESSAGE_LENGTH  3   // Length = enabled + 2 bytes crc
+#define COMPRESSION_ENABLED_OFFSET  2
+#define COMPRESSION_MAX_HEADER_LEN  OVERFLOW_HEADER_LENGTH
+
+// The host can let the OpenMote parse the frame control field of every frame once and add a descriptor at the end of the record,
+// behind the RSSI and CRC/LQI bytes. The original length byte of such a record has BUFFER_ORIGINAL_LENGTH_DESCRIPTOR set.
+// The descriptor describes the frame as it was received, before it was truncated, compressed or replaced by a reference.
+// The first byte has the frame type (bits 0-2), security enabled (bit 3), the destination address mode (bits 4-5) and the source
+// address mode (bits 6-7). The second byte has the length of the MAC header up to and including the addressing fields (bits 0-4),
+// the frame version (bits 5-6) and PAN ID compression (bit 7). The header length is 0 when the frame is too short for its header
+// or when it is a frame version that isn't parsed.
+#define DESCRIPTOR_MESSAGE_LENGTH   3   // Length = enabled + 2 bytes crc
+#define DESCRIPTOR_ENABLED_OFFSET   2
+#define DESCRIPTOR_LENGTH           2
+
+// Dwell times are expressed in steps of the MAC timer overflow counter, which are 1024 microseconds.
+// The schedule is send as one message per entry, hopping starts when the last entry was received.
+#define HOP_MESSAGE_LENGTH          7   // Length = entry + entry count + channel + 2 bytes dwell time + 2 bytes crc
+#define HOP_ENTRY_OFFSET            2
+#define HOP_ENTRY_COUNT_OFFSET      3
+#define HOP_CHANNEL_OFFSET          4
+#define HOP_DWELL_TIME_OFFSET       5
+
+// Lets the OpenMote divide the time of the hopping schedule that is being used over its channels by their activity, until a new
+// schedule is received. A cycle through the schedule keeps the length of the dwell times of the HOP messages, and every channel is
+// still visited once per cycle for at least the minimum dwell time of the message, so new activity is found within a cycle. The rest
+// of the cycle is divided in proportion to the frames per second and the energy above HOP_ADAPTIVE_ENERGY_THRESHOLD of every channel,
+// which are averaged over the cycles. Every HOP_ADAPTIVE_REPORT_INTERVAL the OpenMote sends an ADAPTIVE_HOP message with the amount
+// of entries, followed by the channel, the 2 byte dwell time, the 2 byte frames per second (in steps of 1/16) and the RSSI in dBm of
+// every entry. The fraction of the cycle that the radio spends on a channel is the chance that a frame on it is captured.
+#define ADAPTIVE_HOP_MESSAGE_LENGTH     4   // Length = 2 bytes minimum dwell time + 2 bytes crc
+#define ADAPTIVE_HOP_MIN_DWELL_OFFSET   2
+#define ADAPTIVE_HOP_ENTRY_LENGTH       6
+#define ADAPTIVE_HOP_REPORT_LENGTH      (1 + HOP_MAX_CHANNELS * ADAPTIVE_HOP_ENTRY_LENGTH)
+
+// Tunes the radio to another channel between two frames, without clearing the buffer or restarting the sequence numbers.
+// Any hopping schedule is stopped. The first record after the switch is a marker: its original length is 0 and instead of a
+// frame it contains the previous channel and a zero byte, the channel byte of the record has the new channel.
+#define SET_CHANNEL_MESSAGE_LENGTH  3   // Length = channel + 2 bytes crc
+#define SET_CHANNEL_OFFSET          2
+#define CHANNEL_MARKER_LENGTH       2
+
+// Follows the channel hopping of a TSCH network instead of staying on one channel, until the next reset. The OpenMote listens on the
+// current channel until it receives an enhanced beacon with a TSCH synchronization IE and from then on it tunes to the channel of
+// every timeslot: the entry (ASN + channel offset) % length of the hopping sequence. The message has the channel offset that is
+// followed (TSCH_CHANNEL_OFFSET_FROM_BEACON for the one of the beacon), the PAN (TSCH_ANY_PAN for the first network that is heard)
+// and a hopping sequence of up to 16 channels (length 0 for the one in the beacon, or the default one when the beacon only has its ID).
+// The timeslots come from the beacon. Whenever the OpenMote locks onto the network or loses it, it sends a TSCH message with whether
+// it is locked, the 5 byte ASN of the timeslot that started at the 4 byte time, the channel offset, the length of the hopping
+// sequence and the 2 byte timeslot length in microseconds. Any hopping schedule is stopped, a HOP or SET_CHANNEL message stops following.
+#define TSCH_MESSAGE_LENGTH             22  // Length = channel offset + 2 bytes PAN + sequence length + 16 channels + 2 bytes crc
+#define TSCH_CHANNEL_OFFSET_OFFSET      2
+#define TSCH_PAN_OFFSET                 3
+#define TSCH_SEQUENCE_LENGTH_OFFSET     5
+#define TSCH_SEQUENCE_OFFSET            6
+#define TSCH_MAX_SEQUENCE_LEN           16
+#define TSCH_CHANNEL_OFFSET_FROM_BEACON 0xFF
+#define TSCH_ANY_PAN                    0xFFFF
+#define TSCH_REPORT_LENGTH              14
+
+// Only listens during the active portion of the superframes of a beacon-enabled PAN, until the next reset. The OpenMote listens on
+// the current channel until it receives a beacon with a beacon order below 15 and a superframe order below it, from the PAN of the
+// message (SUPERFRAME_ANY_PAN for the first one that is heard). From then on it follows the superframes of the coordinator that sent
+// the beacon: the radio is turned on the guard time (in microseconds) before the next beacon is due and turned off again the guard
+// time after the active portion ended. Every beacon aligns the superframes again. After SUPERFRAME_MAX_MISSED_BEACONS missed beacons
+// in a row, or a beacon without an inactive period, the radio stays on and waits for the next beacon. Whenever the OpenMote locks
+// onto the superframes, loses them or their orders change, it sends a SUPERFRAME message with whether it is locked, the beacon order,
+// the superframe order, the 2 byte PAN and the 4 byte start time of the superframe. Any hopping schedule is stopped, as is following a
+// TSCH network, and a HOP, SET_CHANNEL or TSCH message stops following the superframes.
+#define SUPERFRAME_MESSAGE_LENGTH       6   // Length = 2 bytes PAN + 2 bytes guard time + 2 bytes crc
+#define SUPERFRAME_PAN_OFFSET           2
+#define SUPERFRAME_GUARD_TIME_OFFSET    4
+#define SUPERFRAME_ANY_PAN              0xFFFF
+#define SUPERFRAME_REPORT_LENGTH        9
+
+// Queues a frame that the OpenMote transmits on its channel while it keeps capturing, until the next reset. The message has a 2 byte id,
+// a 4 byte time, flags and the frame without its FCS, which the radio adds. The ids count up from 0 after a reset and a frame is only
+// queued when it has the next id, so that the frames behind a message that got lost are rejected until the host sends that one again.
+// With INJECT_FLAG_ABSOLUTE the time is when the SFD of the frame should be send, in microseconds of the MAC timer like the timestamps
+// of the records, otherwise it is the time between the SFD of the previous frame and that of this one (0 sends it right behind the
+// previous one). A frame that is late, or that would start while a frame is being received, is send as soon as the radio is free.
+// With INJECT_FLAG_TIMELINE a relative time counts from when the previous frame should have started instead of when it did, so that
+// a frame that was late doesn't delay all frames behind it and the frames keep the timing of the capture that they were taken from.
+// With INJECT_FLAG_CCA a frame isn't send when the channel is busy. An INJECT message is send back when a frame was queued or rejected
+// and when it was done, with the id, the status, the free places in the queue, the id that is expected next and the 4 byte time of
+// the SFD (0 when the frame wasn't done yet). Frames can't be injected while hopping, following a TSCH network or superframes, or surveying.
+#define INJECT_MESSAGE_LENGTH       9   // Length = 2 bytes id + 4 bytes time + flags + 2 bytes crc, the frame lies in front of the crc
+#define INJECT_ID_OFFSET            2
+#define INJECT_TIME_OFFSET          4
+#define INJECT_FLAGS_OFFSET         8
+#define INJECT_FRAME_OFFSET         9
+#define INJECT_FLAG_ABSOLUTE        0x01
+#define INJECT_FLAG_CCA             0x02
+#define INJECT_FLAG_TIMELINE        0x04
+#define INJECT_STATUS_QUEUED        0
+#define INJECT_STATUS_SENT          1
+#define INJECT_STATUS_BUSY          2   // The channel was busy, the frame wasn't send
+#define INJECT_STATUS_REJECTED      3   // Not the id that was expected, or the queue is full
+#define INJECT_STATUS_UNAVAILABLE   4   // Hopping, following a TSCH network or superframes, or surveying
+#define INJECT_REPORT_LENGTH        10
+
+// Samples the sensors of the board every interval seconds, until the next reset (an interval of 0 stops it). Every sample is a
+// record in the buffer between the frames, so it is send and acknowledged like them. It is a marker like the one of SET_CHANNEL
+// (original length 0), but its record type is RECORD_TYPE_TELEMETRY. The record has a byte with a bit for every sensor that
+// answered, followed by the raw SHT21 temperature and humidity, the raw MAX44009 light (exponent and mantissa) and the raw ADXL346
+// X, Y and Z acceleration, 2 bytes each. The readings of a sensor that didn't answer are 0. A sample is skipped while the buffer
+// is filling up, so the frames never have to wait for it.
+#define TELEMETRY_MESSAGE_LENGTH    4   // Length = 2 bytes interval in seconds + 2 bytes crc
+#define TELEMETRY_INTERVAL_OFFSET   2
+#define TELEMETRY_RECORD_LENGTH     13
+#define TELEMETRY_SENSORS_OFFSET    0
+#define TELEMETRY_TEMPERATURE_OFFSET 1
+#define TELEMETRY_HUMIDITY_OFFSET   3
+#define TELEMETRY_LIGHT_OFFSET      5
+#define TELEMETRY_ACCELERATION_OFFSET 7
+#define TELEMETRY_SENSOR_SHT21      0x01
+#define TELEMETRY_SENSOR_MAX44009   0x02
+#define TELEMETRY_SENSOR_ADXL346    0x04
+
+// Chooses how the records are framed, until the next reset. The host should decode a frame that fails the CRC the other way,
+// the records that were already encoded when the message arrived are still send with the old framing.
+#define FRAMING_MESSAGE_LENGTH      3   // Length = framing + 2 bytes crc
+#define FRAMING_MODE_OFFSET         2
+#define FRAMING_HDLC                0   // Byte stuffing with HDLC_ESCAPE (default), up to twice as long
+#define FRAMING_COBS                1
+
+// Chooses when the records are send, until the next reset. In latency mode (the default) a record is encoded as soon as a TX
+// buffer is free, batched only with the records that arrived in the meantime. In throughput mode the records wait until the given
+// amount of bytes is waiting or until the hold time passed since the first of them could have been send, so that they fill whole
+// batches. Retransmissions and the blocks of survey samples are never held back. The STATS message counts how long they waited.
+#define BATCHING_MESSAGE_LENGTH     7   // Length = mode + 2 bytes threshold in bytes + 2 bytes hold time in milliseconds + 2 bytes crc
+#define BATCHING_MODE_OFFSET        2
+#define BATCHING_THRESHOLD_OFFSET   3
+#define BATCHING_HOLD_TIME_OFFSET   5
+#define BATCHING_LATENCY            0
+#define BATCHING_THROUGHPUT         1
+
+// A host that can't keep up with writing the frames asks the OpenMote to pause sending them. The records that arrive in the
+// meantime stay in the buffer, where the overflow policy decides what happens once it fills up, and nothing is retransmitted.
+// The host repeats the message while it is behind. It ends the pause with a message of which the paused byte is 0; when it stops
+// asking for FLOW_PAUSE_TIMEOUT, the OpenMote also continues by itself. RESET and SURVEY end the pause as well.
+#define PAUSE_MESSAGE_LENGTH        3   // Length = paused + 2 bytes crc
+#define PAUSE_PAUSED_OFFSET         2
+
+// With CAPABILITY2_LANES the records can be spread over several connections to the host, until the next reset. Every packet goes
+// over the first lane that is free, so a short packet may arrive before a longer one that was started earlier on another lane.
+// The host puts them back in order with the sequence numbers before processing them. Everything from the host and the messages
+// that the OpenMote sends itself stay on the first lane. More lanes than the firmware has are refused.
+#define LANES_MESSAGE_LENGTH        3   // Length = lanes + 2 bytes crc
+#define LANES_COUNT_OFFSET          2
+
+// With CAPABILITY2_AUTOSTART the OpenMote keeps the configuration of a capture in its flash and starts capturing with it right
+// after booting, without waiting for a host. The configuration is the RESET, SURVEY or SUMMARY message that started the current
+// capture together with the FILTER, FILTER_PROGRAM, SNAP_LENGTH, OVERFLOW, FCS_FILTER, HOP, ADAPTIVE_HOP, SUPERFRAME and FLASH_LOG (enable or disable)
+// messages that were accepted since then. SAVE stores it and is refused when it didn't fit, CLEAR removes it again. The records of a capture
+// that started by itself are held back until a host sends ATTACH, which is answered with a READY message followed by a RESUME answer.
+// The records then continue with the first one that wasn't moved to the flash log, so the host takes the sequence number of the
+// first record that it receives. ATTACH is answered with a RESUME answer that didn't resume when there is nothing to attach to.
+#define AUTOSTART_MESSAGE_LENGTH    3   // Length = command + 2 bytes crc
+#define AUTOSTART_COMMAND_OFFSET    2
+
+// The survey message replaces the RESET message when the host wants RSSI samples instead of packets.
+// Samples are taken on channels 11 to 26, one channel per sample interval (in steps of 1024 microseconds).
+#define SURVEY_MESSAGE_LENGTH               8   // Length = 2 bytes window size + 2 bytes ACK interval + 2 bytes sample interval + 2 bytes crc
+#define SURVEY_WINDOW_OFFSET                2
+#define SURVEY_ACK_INTERVAL_OFFSET          4
+#define SURVEY_SAMPLE_INTERVAL_OFFSET       6
+
+// The summary message replaces the RESET message when the host wants a summary of the traffic instead of the frames.
+// Frames that pass the filter are counted per link (frame type, addressing modes, PAN and both addresses) and every interval
+// (in milliseconds) the table is send in SUMMARY messages like the statistics, the frames themselves are never send.
+// Each SUMMARY message contains a header with a 2 byte interval number, the part and the amount of parts of the interval and
+// the 2 byte amount of frames that didn't fit in the table. The links follow it: the 19 byte key (type and modes, PAN,
+// destination address and source address as in the frame), 2 bytes frames, 4 bytes bytes, 2 bytes frames with an incorrect
+// FCS, the average RSSI and the average LQI.
+#define SUMMARY_MESSAGE_LENGTH      5   // Length = channel + 2 bytes interval + 2 bytes crc
+#define SUMMARY_CHANNEL_OFFSET      2
+#define SUMMARY_INTERVAL_OFFSET     3
+#define SUMMARY_MAX_INTERVAL        20000   // The 16-bit frame counters of a link can't overflow within this time
+#define SUMMARY_KEY_LENGTH          19
+#define SUMMARY_HEADER_LENGTH       6
+#define SUMMARY_LINK_LENGTH         29
+#define SUMMARY_LINKS_PER_MESSAGE   8
+
+// Behind the SUMMARY messages of an interval follows a TOP_TALKERS message with the sources that send the most frames, also
+// those that didn't fit in the table. It contains the 2 byte interval number and per source the 11 byte key (address mode, PAN
+// and address as in the frame) followed by the estimated amount of frames (2 bytes), which is never too low.
+#define TOP_TALKERS_KEY_LENGTH      11
+#define TOP_TALKERS_ENTRY_LENGTH    13
+
+// The host can let the OpenMote hold back the records until a frame matches a trigger, like a logic analyser. Until then only the
+// last pre-trigger frames are kept in the buffer and older records are discarded. The frame that matches, the frames before it
+// and the post-trigger frames behind it are send, later frames are no longer stored. The trigger matches on all given fields:
+// the frame type, the destination or source address (big endian as in the FILTER message) and a pattern of bytes at an offset
+// in the frame. Right before the records, the OpenMote sends a TRIGGER message with the index and 2 byte sequence number of the
+// last discarded record (for the ACKs and NACKs of the host), the sequence number of the frame that matched, the amount of
+// frames before it and the 4 byte amount of discarded records. The sequence numbers of the discarded records are never send.
+#define TRIGGER_MESSAGE_LENGTH          27  // Length = fields + frame type + address mode + 8 bytes address + pattern offset
+                                            //          + pattern length + 8 bytes pattern + 2 bytes pre-trigger frames
+                                            //          + 2 bytes post-trigger frames + 2 bytes crc
+#define TRIGGER_FIELDS_OFFSET           2
+#define TRIGGER_FRAME_TYPE_OFFSET       3
+#define TRIGGER_ADDR_MODE_OFFSET        4
+#define TRIGGER_ADDR_OFFSET             5
+#define TRIGGER_PATTERN_OFFSET_OFFSET   13
+#define TRIGGER_PATTERN_LENGTH_OFFSET   14
+#define TRIGGER_PATTERN_OFFSET          15
+#define TRIGGER_PRE_FRAMES_OFFSET       23
+#define TRIGGER_POST_FRAMES_OFFSET      25
+#define TRIGGER_MAX_PATTERN_LEN         8
+#define TRIGGER_MATCH_FRAME_TYPE        (1 << 0)
+#define TRIGGER_MATCH_DST_ADDR          (1 << 1)
+#define TRIGGER_MATCH_SRC_ADDR          (1 << 2)
+#define TRIGGER_MATCH_PATTERN           (1 << 3)
+#define TRIGGER_REPORT_LENGTH           12
+
+// The host tells how often it wants to receive statistics, an interval of 0 stops sending them
+#define STATS_MESSAGE_LENGTH        4   // Length = 2 bytes interval in milliseconds + 2 bytes crc
+#define STATS_INTERVAL_OFFSET       2
+
+// A firmware build with PROFILING follows every STATS message with a LATENCY message, which doesn't fit behind the counters.
+// It tells per class of frame lengths how long after the end of a frame the radio interrupt started, the frame was copied to
+// the buffer and the receiver was ready again (see LATENCY_REPORT_CLASS_LEN). The last time is when the sniffer was deaf.
+
+// With CAPABILITY2_TRACE the host can let the OpenMote record when the serial task is switched in and out and when the radio
+// and UART interrupts start and end, timestamped with the cycle counter. The events are send in TRACE messages when the records
+// are all send or when a message is full, so they only take the time of the link that the records leave. A TRACE message
+// contains the amount of events that were lost because the ring was full (2 bytes), followed by the 4 byte cycle counter, the event
+// and its argument of every event (see TraceEvent in sniffer_trace.hpp). The cycle counter wraps around every 134 seconds.
+#define TRACE_MESSAGE_LENGTH        3   // Length = enable + 2 bytes crc
+#define TRACE_ENABLE_OFFSET         2
+#define TRACE_EVENT_LENGTH          6
+#define TRACE_REPORT_MAX_EVENTS     40
+
+// With CAPABILITY2_PPS the host can let the OpenMote store a record for every rising edge on its pulse-per-second input (see
+// PPS_PIN), until the next reset. The timestamp of the record is the time of the edge, the data is the number of the pulse since
+// the input was enabled (4 bytes). A GPS receiver or a clock that follows NTP gives the pulses at the start of every second, so
+// the host can fit the timestamps of the OpenMote to absolute time.
+#define PPS_MESSAGE_LENGTH          3   // Length = enable + 2 bytes crc
+#define PPS_ENABLE_OFFSET           2
+#define PPS_RECORD_LENGTH           4
+#define PPS_PULSE_OFFSET            0
+
+// The 32-bit timestamps of the records wrap around every 71 minutes, a host that doesn't receive anything for that long can't
+// tell how often they wrapped. With CAPABILITY2_TIMEBASE the host can let the OpenMote store a record of type RECORD_TYPE_TIMEBASE
+// right away and every TIMEBASE_SYNC_INTERVAL, until the next reset. The data is the full 64-bit time since the OpenMote started,
+// of which the timestamp of the record is the lower half.
+#define TIMEBASE_MESSAGE_LENGTH     3   // Length = enable + 2 bytes crc
+#define TIMEBASE_ENABLE_OFFSET      2
+#define TIMEBASE_RECORD_LENGTH      8
+#define TIMEBASE_TIME_OFFSET        0
+
+// A host that sees bit errors on a long or cheap serial link can ask for a FEC message behind every group of packets with
+// records, with CAPABILITY2_FEC and a single lane. It contains the amount of packets in the group followed by the XOR of those
+// packets as the host decodes them (type, length, data and crc), each padded with zeros to the longest one. When one packet
+// of the group failed its crc or didn't arrive, the XOR of the others and the parity gives it back without a NACK. The
+// parity of a smaller group is send when there are no more records to send. A group size of 0 stops it.
+#define FEC_MESSAGE_LENGTH          3   // Length = group size + 2 bytes crc
+#define FEC_GROUP_SIZE_OFFSET       2
+#define FEC_MAX_GROUP_SIZE          16
+#define FEC_COUNT_OFFSET            2
+#define FEC_PARITY_OFFSET           3
+
+// With CAPABILITY2_IDENTIFY the host can ask which OpenMote it is talking to. The answer is an IDENTIFY message with the
+// EUI-48 of the board. Nothing else changes, so a host that lost its serial port can ask every port that appears until it
+// finds its own OpenMote again, before continuing the capture on it with a RESUME message.
+#define IDENTIFY_MESSAGE_LENGTH     2   // Length = 2 bytes crc
+#define IDENTIFY_ANSWER_LENGTH      8   // Length = 6 bytes EUI-48 + 2 bytes crc
+#define IDENTIFY_EUI_OFFSET         2
+
+// With CAPABILITY2_ENCRYPTION the host can let the OpenMote encrypt the records before they are send, so that the capture never
+// reaches the host in the clear. Each record is encrypted from its timestamp on with CCM* without a MIC (which is AES-CTR) under
+// the key of the message. The nonce is the nonce of the host, the epoch and the full sequence number of the record (big endian)
+// followed by a zero, so that the OpenMote never uses one twice with a key. The length, index and sequence number stay readable
+// for the ACKs, the RSSI samples of a survey are never encrypted. The message is send before the RESET and stays in effect for
+// the captures that follow, until it is send again with the enable byte set to 0. The key takes the last area of the key store.
+#define ENCRYPTION_MESSAGE_LENGTH   23  // Length = enable + 16 bytes key + 4 bytes nonce + 2 bytes crc
+#define ENCRYPTION_ENABLE_OFFSET    2
+#define ENCRYPTION_KEY_OFFSET       3
+#define ENCRYPTION_NONCE_OFFSET     19
+#define ENCRYPTION_NONCE_LEN        4
+#define ENCRYPTION_KEY_AREA         (DECRYPTION_MAX_KEYS - 1)
+
+// When enabled, the records that the host doesn't acknowledge are moved to the flash. The log can be dumped or erased later.
+#define FLASH_LOG_MESSAGE_LENGTH    3   // Length = command + 2 bytes crc
+#define FLASH_LOG_COMMAND_OFFSET    2
+
+// The records that the host didn't acknowledge before the OpenMote was reset (by the watchdog or anything other than a power-on)
+// are kept until the next capture starts. The host asks for them before sending a RESET, the answer is like a dump of the flash log.
+#define RECOVERY_MESSAGE_LENGTH     2   // Length = 2 bytes crc
+
+// After READY the host can ask for a faster baudrate. The answer is send at the old baudrate and contains the baudrate that
+// will be used, the host has to repeat the message at the new baudrate within BAUDRATE_VERIFY_TIMEOUT to confirm it.
+#define BAUDRATE_MESSAGE_LENGTH     10  // Length = 4 bytes baudrate + 4 bytes pattern + 2 bytes crc
+#define BAUDRATE_RATE_OFFSET        2
+#define BAUDRATE_PATTERN_OFFSET     6
+#define BAUDRATE_PATTERN            0x55AA7E7D  // Alternating bits, followed by the flag and escape bytes
+
+// Over Ethernet, the host can let the OpenMote send the captured frames as ZEP v2 packets over UDP to another address.
+// These frames aren't acknowledged or retransmitted. The message is echoed to confirm it, any RESET, SURVEY or STOP ends this mode.
+#define ZEP_MESSAGE_LENGTH      18  // Length = 6 bytes destination MAC address + 4 bytes source IP + 4 bytes destination IP + 2 bytes port + 2 bytes crc
+#define ZEP_MAC_OFFSET          2
+#define ZEP_SOURCE_IP_OFFSET    8
+#define ZEP_DEST_IP_OFFSET      12
+#define ZEP_PORT_OFFSET         16
+
+// The host can give keys to decrypt secured frames before they are send. A key is used for frames which match on all given
+// fields, frames with a short source address need a key that matches on that address, with the extended address for the nonce.
+#define KEY_MESSAGE_LENGTH          32  // Length = slot + fields + 2 bytes pan + 2 bytes short address + 8 bytes extended address + 16 bytes key + 2 bytes crc
+#define KEY_SLOT_OFFSET             2
+#define KEY_FIELDS_OFFSET           3
+#define KEY_PAN_OFFSET              4
+#define KEY_SHORT_ADDR_OFFSET       6
+#define KEY_EXT_ADDR_OFFSET         8
+#define KEY_KEY_OFFSET              16
+
+// The records only contain the lower 16 bits of the sequence number. The OpenMote counts them in 32 bits and sends an EPOCH
+// message with the epoch of the session (random, changes with every READY) and the full sequence number of a record that
+// it just sent, once per EPOCH_SYNC_INTERVAL records and whenever the sequence numbers jumped (e.g. after a trigger).
+#define EPOCH_REPORT_LENGTH     8   // 4 bytes epoch + 4 bytes sequence number
+#define EPOCH_SYNC_INTERVAL     4096
+
+#define DECRYPTION_MAX_KEYS         8   // The key store of the AES engine has room for 8 keys of 128 bits
+#define DECRYPTION_MATCH_PAN        (1 << 0)
+#define DECRYPTION_MATCH_SHORT_ADDR (1 << 1)
+#define DECRYPTION_MATCH_EXT_ADDR   (1 << 2)
+
+// The host can let the OpenMote keep a SHA-256 chain over the records, with a checkpoint after every interval records.
+// Checkpoints are send in an INTEGRITY message too: sequence number of the last record in the chain, 4 bytes amount of records,
+// the hash and an HMAC-SHA-256 over the previous fields. An interval of 0 stops hashing.
+#define INTEGRITY_MESSAGE_LENGTH    36  // Length = 2 bytes interval + 32 bytes HMAC key + 2 bytes crc
+#define INTEGRITY_INTERVAL_OFFSET   2
+#define INTEGRITY_KEY_OFFSET        4
+#define INTEGRITY_KEY_LEN           32
+#define INTEGRITY_CHECKPOINT_LEN    70  // 2 bytes sequence number + 4 bytes count + 32 bytes hash + 32 bytes HMAC
+
+// An OpenMote that doesn't capture can transmit sync frames instead, which the sniffers use to align their clocks to its clock.
+// The message contains the time between two frames (in steps of 1024 microseconds) and a bit for each of the channels 11 to 26
+// on which the frames are send in turn. The answer is a SYNC message with the current MAC time. RESET, SURVEY or STOP ends this mode.
+#define SYNC_MESSAGE_LENGTH         6   // Length = 2 bytes interval + 2 bytes channel mask + 2 bytes crc
+#define SYNC_INTERVAL_OFFSET        2
+#define SYNC_CHANNELS_OFFSET        4
+
+// The sync frame is a broadcast data frame. Each frame has a counter, and the counter and the time of the SFD (in microseconds)
+// of the previous frame on the same channel, as the time of a frame is only known after it was send.
+#define SYNC_FRAME_LENGTH                   25  // Length = 9 bytes header + 4 bytes magic + 3x 4 bytes + 2 bytes FCS
+#define SYNC_FRAME_MAGIC                    0x4F4D5359  // "OMSY"
+#define SYNC_FRAME_MAGIC_OFFSET             7
+#define SYNC_FRAME_COUNTER_OFFSET           11
+#define SYNC_FRAME_PREVIOUS_COUNTER_OFFSET  15
+#define SYNC_FRAME_PREVIOUS_TIME_OFFSET     19
+
+// Older firmware only sends the window size and ACK interval. Since version 1 the READY message also tells which optional
+// messages the firmware understands and the parameters of this build: the size of the buffer, the fastest baudrate that
+// the host could ask for and the rate at which the timestamps of the records count. The capabilities that no longer fitted
+// in the first word are in a second one behind the epoch.
+#define READY_MESSAGE_LENGTH            29  // Length = 2 bytes window size + 2 bytes ACK interval + version + 4 bytes capabilities
+                                            //          + 2 bytes buffer size + 4 bytes max baudrate + 4 bytes tick rate
+                                            //          + 4 bytes epoch + 4 bytes more capabilities + 2 bytes crc
+#define READY_LEGACY_MESSAGE_LENGTH     6
+#define READY_WINDOW_OFFSET             2
+#define READY_ACK_INTERVAL_OFFSET       4
+#define READY_VERSION_OFFSET            6
+#define READY_CAPABILITIES_OFFSET       7
+#define READY_BUFFER_SIZE_OFFSET        11
+#define READY_MAX_BAUDRATE_OFFSET       13
+#define READY_TICK_RATE_OFFSET          17
+#define READY_EPOCH_OFFSET              21  // Only with CAPABILITY_EPOCH
+#define READY_MORE_CAPABILITIES_OFFSET  25
+#define READY_PROTOCOL_VERSION          1
+
+#define CAPABILITY_FILTER           0x00000001
+#define CAPABILITY_SNAP_LENGTH      0x00000002
+#define CAPABILITY_HOPPING          0x00000004
+#define CAPABILITY_SURVEY           0x00000008
+#define CAPABILITY_STATS            0x00000010
+#define CAPABILITY_FLASH_LOG        0x00000020
+#define CAPABILITY_BAUDRATE         0x00000040  // Only when the transport can change its baudrate
+#define CAPABILITY_ZEP              0x00000080  // Only in the Ethernet build
+#define CAPABILITY_DECRYPTION       0x00000100
+#define CAPABILITY_INTEGRITY        0x00000200
+#define CAPABILITY_SYNC             0x00000400
+#define CAPABILITY_OVERFLOW_POLICY  0x00000800
+#define CAPABILITY_DUPLICATES       0x00001000
+#define CAPABILITY_COMPRESSION      0x00002000
+#define CAPABILITY_RESUME           0x00004000
+#define CAPABILITY_SET_CHANNEL      0x00008000
+#define CAPABILITY_HARDWARE_CRC     0x00010000  // The serial CRC is calculated by the CRC engine (SERIAL_HARDWARE_CRC)
+#define CAPABILITY_PROFILING        0x00020000  // The STATS message contains the profiling counters and is followed by LATENCY (PROFILING)
+#define CAPABILITY_COBS             0x00040000
+#define CAPABILITY_SUMMARY          0x00080000
+#define CAPABILITY_DESCRIPTOR       0x00100000
+#define CAPABILITY_TRIGGER          0x00200000
+#define CAPABILITY_EPOCH            0x00400000
+#define CAPABILITY_RECORD_INDEX     0x00800000
+#define CAPABILITY_RECOVERY         0x01000000
+#define CAPABILITY_TSCH             0x02000000
+#define CAPABILITY_INJECT           0x04000000
+#define CAPABILITY_TELEMETRY        0x08000000
+#define CAPABILITY_CUMULATIVE_ACK   0x10000000
+#define CAPABILITY_FCS_FILTER       0x20000000
+#define CAPABILITY_ADAPTIVE_OVERFLOW 0x40000000
+#define CAPABILITY_ALIGNED_RECORDS  0x80000000  // The records have the word-aligned layout (BUFFER_ALIGNED_RECORDS)
+
+// Bits of the second capabilities word
+#define CAPABILITY2_FILTER_PROGRAM  0x00000001
+#define CAPABILITY2_CONTROL         0x00000002
+#define CAPABILITY2_ACK_REQUEST     0x00000004
+#define CAPABILITY2_BATCHING        0x00000008
+#define CAPABILITY2_PAUSE           0x00000010
+#define CAPABILITY2_LANES           0x00000020
+#define CAPABILITY2_AUTOSTART       0x00000040
+#define CAPABILITY2_SUPERFRAME      0x00000080
+#define CAPABILITY2_ADAPTIVE_HOP    0x00000100
+#define CAPABILITY2_TRACE           0x00000200
+#define CAPABILITY2_PPS             0x00000400
+#define CAPABILITY2_TIMEBASE        0x00000800
+#define CAPABILITY2_FEC             0x00001000
+#define CAPABILITY2_IDENTIFY        0x00002000
+#define CAPABILITY2_ENCRYPTION      0x00004000
+
+// A host that lost its serial port for a moment continues with the records that it didn't acknowledge instead of sending a RESET.
+// The message contains the index and sequence number of the last record that it received, as in a NACK. The answer is a RESUME
+// message that tells whether that record was still in the buffer, together with the window size and ACK interval in use.
+// When it wasn't, the host has to start again with a RESET.
+#define RESUME_MESSAGE_LENGTH   6   // Length = 2 bytes index + 2 bytes sequence number + 2 bytes crc
+#define RESUME_INDEX_OFFSET     2
+#define RESUME_SEQNR_OFFSET     4
+#define RESUME_ANSWER_LENGTH    7   // Length = resumed + 2 bytes window size + 2 bytes ACK interval + 2 bytes crc
+
+#define STOP_MESSAGE_LENGTH     2   // Length = 2 bytes crc
+
+// The host can also send a message in chunks through CONTROL messages, when the message is longer than what fits in one
+// serial message or when the host wants to know whether it was accepted. Every chunk contains a command ID, its offset in
+// the complete message (type, length, data and crc, as it would otherwise be send) and its bytes. The OpenMote answers each
+// chunk with a CONTROL message containing the command ID, a status and the amount of bytes that it has of the message. Once all
+// bytes arrived, the message is handled like any other and the answer tells whether it was accepted. A chunk of the command that
+// was handled last is answered again without handling the message a second time, so the host can repeat a chunk of which the
+// answer got lost. A chunk that doesn't continue behind the received bytes is answered with CONTROL_STATUS_RESEND.
+#define CONTROL_MESSAGE_LENGTH          5   // Length = command ID + 2 bytes offset + 2 bytes crc, the chunk is in front of the crc
+#define CONTROL_COMMAND_OFFSET          2
+#define CONTROL_CHUNK_OFFSET_OFFSET     3
+#define CONTROL_CHUNK_OFFSET            5
+#define CONTROL_MAX_MESSAGE_LEN         257 // A message with the largest length byte
+#define CONTROL_ANSWER_LENGTH           6   // Length = command ID + status + 2 bytes received + 2 bytes crc
+#define CONTROL_STATUS_PENDING          0
+#define CONTROL_STATUS_ACCEPTED         1
+#define CONTROL_STATUS_REJECTED         2
+#define CONTROL_STATUS_RESEND           3
+
+// There are 11 extra bytes stored in front of the radio packet: 1 byte length, 2 byte index, 2 byte sequence number,
+// a 4 byte timestamp of the SFD in microseconds, the original length of the radio packet (before truncating it to the snap length)
+// and the channel on which the packet was received. The highest bit of the channel is set when the frame was decrypted,
+// the next bit when the record is only a reference to an earlier frame with the same contents and the bit after that when
+// the MAC header is compressed. The highest bit of the original length is set when a descriptor follows the frame.
+#define BUFFER_EXTRA_BYTES              11
+#define BUFFER_INDEX_OFFSET             1
+#define BUFFER_SEQNR_OFFSET             3
+#define BUFFER_TIMESTAMP_OFFSET         5
+#define BUFFER_ORIGINAL_LENGTH_OFFSET   9
+#define BUFFER_CHANNEL_OFFSET           10
+#define BUFFER_CHANNEL_DECRYPTED        0x80
+#define BUFFER_CHANNEL_DUPLICATE        0x40
+#define BUFFER_CHANNEL_COMPRESSED       0x20
+#define BUFFER_ORIGINAL_LENGTH_DESCRIPTOR   0x80
+
+// A record with original length 0 doesn't contain a frame. Its channel byte is then the type of the record, which tells what the
+// bytes behind the header contain. A channel marker has the new channel as its type, the other types lie outside the channels.
+// These records are send, batched and acknowledged like the frames, so a new type only needs a place where it is stored and one
+// where the host handles it. A host skips the types that it doesn't know, the length byte tells where the next record starts.
+// A type is only stored after the host asked for it, so the firmware never stores records that an older host can't skip.
+#define RECORD_TYPE_TELEMETRY           0
+#define RECORD_TYPE_PPS                 1
+#define RECORD_TYPE_TIMEBASE            2
+#define RECORD_TYPE_FIRST_CHANNEL       11
+#define RECORD_TYPE_LAST_CHANNEL        26
+
+// With CAPABILITY_ALIGNED_RECORDS a 12th byte follows the channel, it contains the amount of padding bytes behind the record.
+// The padding makes the length of every record a multiple of 4 (it is included in the length byte), so that the records
+// and the radio packets behind their headers all start on a word boundary. The fields in front keep their offsets.
+#define BUFFER_ALIGNED_EXTRA_BYTES      12
+#define BUFFER_PADDING_OFFSET           11
+#define BUFFER_RECORD_ALIGNMENT         4
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace Sniffer
+{
+    namespace SerialDataType
+    {
+        enum SerialDataTypes
+        {
+            Packet = 1,
+            Ack    = 2,
+            Nack   = 3,
+            Reset  = 4,
+            Ready  = 5,
+            Stop   = 6,
+            PacketBatch = 7,
+            SelectiveNack = 8,
+            Filter = 9,
+            FilterStats = 10,
+            SnapLength = 11,
+            Hop = 12,
+            Survey = 13,
+            Stats = 14,
+            FlashLog = 15,
+            Baudrate = 16,
+            Zep = 17,
+            Key = 18,
+            Integrity = 19,
+            Sync = 20,
+            Overflow = 21,
+            Duplicates = 22,
+            Compression = 23,
+            Resume = 24,
+            SetChannel = 25,
+            Framing = 26,
+            Summary = 27,
+            TopTalkers = 28,
+            Descriptor = 29,
+            Trigger = 30,
+            Epoch = 31,
+            Recovery = 32,
+            Tsch = 33,
+            Inject = 34,
+            Telemetry = 35,
+            CumulativeAck = 36,
+            FcsFilter = 37,
+            Degradation = 38,
+            FilterProgram = 39,
+            Control = 40,
+            Batching = 41,
+            Pause = 42,
+            Lanes = 43,
+            Autostart = 44,
+            Superframe = 45,
+            AdaptiveHop = 46,
+            Latency = 47,
+            Trace = 48,
+            Pps = 49,
+            Timebase = 50,
+            Fec = 51,
+            Identify = 52,
+            Encryption = 53
+        };
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline uint16_t crcCalculationStep(uint8_t byte, uint16_t crc)
+    {
+        return crc16_table[byte ^ (uint8_t)(crc >> 8)] ^ (crc << 8);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Store a byte of an HDLC frame, escaped when it is special, and return the position behind it. Both output bytes
+    // come from the table and the position moves by 1 or 2 without comparing the byte, so there is no branch. The byte
+    // behind the returned position is overwritten when the byte didn't need escaping.
+    inline uint8_t* hdlcEscapeByte(uint8_t* out, uint8_t byte)
+    {
+        const uint16_t entry = hdlc_escape_table[byte];
+        out[0] = entry & 0xFF;
+        out[1] = entry >> 8;
+        return out + 1 + (entry > 0xFF);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline uint16_t readUint16(uint8_t buf[], uint16_t index)
+    {
+        return (buf[index] << 8) + buf[index+1];
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline uint32_t readUint32(uint8_t buf[], uint16_t index)
+    {
+        return (static_cast<uint32_t>(readUint16(buf, index)) << 16) + readUint16(buf, index+2);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void writeUint16(uint8_t buf[], uint16_t index, uint16_t value)
+    {
+        buf[index] = (value >> 8) & 0xff;
+        buf[index+1] = value & 0xff;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void writeUint32(uint8_t buf[], uint16_t index, uint32_t value)
+    {
+        buf[index] = (value >> 24) & 0xff;
+        buf[index+1] = (value >> 16) & 0xff;
+        buf[index+2] = (value >> 8) & 0xff;
+        buf[index+3] = value & 0xff;
+    }
+}
+
+#endif // SNIFFER_PROTOCOL_HPP
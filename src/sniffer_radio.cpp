@@ -6,35 +6,117 @@
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 #include "sniffer_radio.hpp"
+#include "sniffer_serial.hpp"
+#include "sniffer_serial_send.hpp"
+#include "sniffer_filter.hpp"
+#include "sniffer_duplicates.hpp"
+#include "sniffer_compression.hpp"
+#include "sniffer_zep.hpp"
+#include "sniffer_statistics.hpp"
+#include "sniffer_summary.hpp"
+#include "sniffer_descriptor.hpp"
+#include "sniffer_trigger.hpp"
+#include "sniffer_record_index.hpp"
+#include "sniffer_tsch.hpp"
+#include "sniffer_superframe.hpp"
+#include "sniffer_channel_hopping.hpp"
+#include "sniffer_profiling.hpp"
+#include "sniffer_trace.hpp"
+
+#include "hw_rfcore_ffsm.h"
 
 namespace Sniffer
 {
-    // uDMA Channel Control Table must be 1024-bytes aligned, we thus place it at the beginnging of the memory
-    volatile tDMAControlTable uDMAChannelControlTable __attribute__((section(".udma_channel_control_table")));
+    // Full length of the packet that is still being copied by the uDMA (0 when no copy is ongoing)
+    volatile uint8_t dmaPacketLength = 0;
+
+    // Length of the radio packet of which the first part was already copied at FIFOP (0 when not receiving a packet)
+    uint8_t cutThroughPacketLength = 0;
+    uint8_t cutThroughBytesCopied = 0;
+
+    // Amount of bytes of each radio packet that are stored in front of the RSSI and LQI (0 to store everything)
+    uint8_t snapLength = 0;
+
+    // Channel on which the radio is listening, stored together with each packet
+    uint8_t radioChannel = DEFAULT_RADIO_PORT;
+
+    // What happens with the frames that arrive while the buffer is almost full (OVERFLOW_POLICY_*)
+    uint8_t overflowPolicy = OVERFLOW_POLICY_DROP_NEW;
+
+    // Degradation level of the adaptive overflow policy (DEGRADATION_LEVEL_*) and the DEGRADATION message about its last change
+    uint8_t degradationLevel = DEGRADATION_LEVEL_FULL;
+    uint8_t degradationReport[DEGRADATION_REPORT_LENGTH];
+    bool degradationReportPending = false;
+
+    // Whether frames with a bad FCS are only counted instead of being send to the host
+    bool dropBadFcs = false;
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////
 
     void Radio::initialize()
     {
         radio.enable();
-        radio.setChannel(DEFAULT_RADIO_PORT);
+        setChannel(DEFAULT_RADIO_PORT);
 
         // Set up radio interrupts but don't enable them yet until pc is connected
-        HWREG(RFCORE_XREG_RFIRQM0) = (1 << 6) | (1 << 2) | (1 << 1); // RXPKTDONE, SFD and FIFOP interrupts
+        HWREG(RFCORE_XREG_RFIRQM0) = (1 << 6) | (1 << 1); // RXPKTDONE and FIFOP interrupts, the SFD flag is still set
         IntRegister(INT_RFCORERTX, Radio::radioInterruptHandler);
-        IntPrioritySet(INT_RFCORERTX, (6 << 5)); // More important than UART interrupt, which has the default (7 << 5)
+        IntPrioritySet(INT_RFCORERTX, INTERRUPT_PRIORITY_RADIO); // Less important than the transport interrupt, which must never lose bytes from the host
+        IntPrioritySet(INT_MACTIMR, INTERRUPT_PRIORITY_RADIO); // Same priority as the radio interrupt so that the channel never changes while handling a packet
+
+#if RADIO_CUT_THROUGH
+        // Get a FIFOP interrupt while long packets are still being received so that we can start emptying the RX FIFO
+        HWREG(RFCORE_XREG_FIFOPCTRL) = RADIO_FIFOP_THRESHOLD;
+#endif
+
+#if RADIO_CONTINUOUS_RX
+        // The received frames go to the RX FIFO and the receiver keeps running behind them, also after an injected frame was send.
+        // Restarting it with ISRXON after every frame would lose any frame of which the SFD arrives during the restart.
+        HWREG(RFCORE_XREG_FRMCTRL0) &= ~RFCORE_XREG_FRMCTRL0_RX_MODE_M;
+        HWREG(RFCORE_XREG_FRMCTRL1) |= RFCORE_XREG_FRMCTRL1_SET_RXENMASK_ON_TX;
+#endif
 
         // Initialize uDMA
         uDMAEnable();
-        uDMAControlBaseSet((void*)&uDMAChannelControlTable);
-        uDMAChannelAttributeEnable(0, UDMA_ATTR_REQMASK | UDMA_ATTR_HIGH_PRIORITY);
-        uDMAChannelControlSet(0, UDMA_SIZE_8 | UDMA_SRC_INC_NONE | UDMA_DST_INC_8 | UDMA_ARB_128);
-        uDMAChannelControlTable.pvSrcEndAddr = (void*)RFCORE_SFR_RFDATA;
+        uDMAControlBaseSet((void*)uDMAChannelControlTable);
+        uDMAChannelAttributeEnable(UDMA_RADIO_CHANNEL, UDMA_ATTR_REQMASK | UDMA_ATTR_HIGH_PRIORITY);
+        uDMAChannelControlSet(UDMA_RADIO_CHANNEL, UDMA_SIZE_8 | UDMA_SRC_INC_NONE | UDMA_DST_INC_8 | UDMA_ARB_128);
+        uDMAChannelControlTable[UDMA_RADIO_CHANNEL].pvSrcEndAddr = (void*)RFCORE_SFR_RFDATA;
+        uDMAChannelAttributeEnable(UDMA_INJECT_CHANNEL, UDMA_ATTR_REQMASK);
+        uDMAChannelControlSet(UDMA_INJECT_CHANNEL, UDMA_SIZE_8 | UDMA_SRC_INC_8 | UDMA_DST_INC_NONE | UDMA_ARB_128);
+        uDMAChannelControlTable[UDMA_INJECT_CHANNEL].pvDstEndAddr = (void*)RFCORE_SFR_RFDATA;
+#if RADIO_DMA_INTERRUPT
+        IntRegister(INT_UDMA, Radio::dmaInterruptHandler);
+        IntPrioritySet(INT_UDMA, INTERRUPT_PRIORITY_RADIO); // Same priority as the radio interrupt so that they can't interrupt each other
+        IntEnable(INT_UDMA);
+#endif
+
+        // Start the MAC timer, which captures its value on every SFD so that packets can be timestamped
+        HWREG(RFCORE_SFR_MTMSEL) = (0x02 << RFCORE_SFR_MTMSEL_MTMSEL_S); // Select the timer period
+        HWREG(RFCORE_SFR_MTM0) = (MAC_TIMER_PERIOD >> 0) & 0xff;
+        HWREG(RFCORE_SFR_MTM1) = (MAC_TIMER_PERIOD >> 8) & 0xff;
+        HWREG(RFCORE_SFR_MTCTRL) = RFCORE_SFR_MTCTRL_RUN | RFCORE_SFR_MTCTRL_SYNC | RFCORE_SFR_MTCTRL_LATCH_MODE;
+        while (!(HWREG(RFCORE_SFR_MTCTRL) & RFCORE_SFR_MTCTRL_STATE))
+            ;
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    void Radio::radioInterruptHandler()
+    SNIFFER_RAM_FUNCTION void Radio::radioInterruptHandler()
+    {
+        Trace::record(TraceEvent::RadioIsrEnter);
+        const uint32_t startCycles = Profiling::start();
+#if PROFILING
+        Profiling::interruptEntered(getCurrentTime());
+#endif
+        handleRadioInterrupt();
+        Profiling::stop(ProfilingSection::RadioInterrupt, startCycles);
+        Trace::record(TraceEvent::RadioIsrExit);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION inline void Radio::handleRadioInterrupt()
     {
         // Read RFCORE_STATUS
         uint32_t irq_status0 = HWREG(RFCORE_SFR_RFIRQF0);
@@ -47,75 +129,567 @@ namespace Sniffer
         // We have to check for this one first in case both SFD and RXPKTDONE interrupts occur at once
         if ((irq_status0 & RFCORE_SFR_RFIRQF0_RXPKTDONE) == RFCORE_SFR_RFIRQF0_RXPKTDONE)
         {
-            // Make sure the packet length is valid
-            uint8_t packetLength = HWREG(RFCORE_SFR_RFDATA);
-            if ((packetLength > CC2538_RF_MAX_PACKET_LEN)
-             || (packetLength < CC2538_RF_MIN_PACKET_LEN)
-             || (packetLength != HWREG(RFCORE_XREG_RXFIFOCNT)))
+            waitForPendingCopy();
+
+#if RADIO_CUT_THROUGH
+            // The first part of the packet might already have been copied when the FIFOP threshold was reached
+            if (cutThroughPacketLength != 0)
             {
-                flushRadioRX();
-                return;
+                if (!packetCompleted())
+                    return;
+
+                waitForPendingCopy();
             }
+#endif
+
+            // Other frames may have been received behind it before the interrupt was handled
+            drainRxFifo();
+        }
 
-            packetReceived(packetLength);
+#if RADIO_CUT_THROUGH
+        // Check if the FIFOP threshold was reached while the packet is still being received
+        else if ((irq_status0 & RFCORE_SFR_RFIRQF0_FIFOP) == RFCORE_SFR_RFIRQF0_FIFOP)
+        {
+            waitForPendingCopy();
+            packetStarted();
         }
+#endif
 
-        // Check for start of frame interrupt
-        else if ((irq_status0 & RFCORE_SFR_RFIRQF0_SFD) == RFCORE_SFR_RFIRQF0_SFD)
+        // The start of a frame no longer interrupts (the status leds show the activity from the counters), but its flag
+        // can be set together with another one. Otherwise this should not happen (could be RFCORE_SFR_RFIRQF0_FIFOP which
+        // means packet can't be valid).
+        else if ((irq_status0 & RFCORE_SFR_RFIRQF0_SFD) == 0)
         {
-            led_yellow.on();
+            flushRadioRX();
+            return;
         }
-        else // This should not happen (could be RFCORE_SFR_RFIRQF0_FIFOP which means packet can't be valid)
+
+#if RADIO_CONTINUOUS_RX
+        // The receiver is never restarted after a frame, so an overflow is the only thing that can stop it. The frames that
+        // were complete before the overflow were taken out of the FIFO above, the one that didn't fit is lost.
+        if (isRxFifoOverflowed())
         {
+            waitForPendingCopy();
             flushRadioRX();
         }
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Radio::reset()
+    {
+        cutThroughPacketLength = 0;
+        cutThroughBytesCopied = 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Radio::setSnapLength(uint8_t length)
+    {
+        snapLength = length;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Radio::setOverflowPolicy(uint8_t policy)
+    {
+        if (policy > OVERFLOW_POLICY_ADAPTIVE)
+            return false;
+
+        const uint32_t interruptMask = enterCriticalSection();
+        overflowPolicy = policy;
+        degradationLevel = DEGRADATION_LEVEL_FULL;
+        degradationReportPending = false;
+        leaveCriticalSection(interruptMask);
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Radio::sendPeriodically()
+    {
+        if (overflowPolicy != OVERFLOW_POLICY_ADAPTIVE)
+            return;
+
+        // The buffer drains when the host acknowledges records, which the radio interrupt doesn't notice until the next frame
+        uint8_t report[DEGRADATION_REPORT_LENGTH];
+        const uint32_t interruptMask = enterCriticalSection();
+        updateDegradationLevel(seqNr);
+        const bool reportPending = degradationReportPending;
+        if (reportPending)
+        {
+            for (uint8_t i = 0; i < DEGRADATION_REPORT_LENGTH; ++i)
+                report[i] = degradationReport[i];
+            degradationReportPending = false;
+        }
+        leaveCriticalSection(interruptMask);
+
+        if (reportPending)
+            SerialSend::sendMessage(SerialDataType::Degradation, report, sizeof(report));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Radio::setFcsFilter(uint8_t drop)
+    {
+        if (drop > 1)
+            return false;
+
+        dropBadFcs = (drop != 0);
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Radio::enableFrameFilter(uint16_t panId, uint16_t shortAddr, const uint8_t* extAddr, bool dataFrames, bool commandFrames)
+    {
+        // The local address registers are one byte per word and little endian
+        HWREG(RFCORE_FFSM_PAN_ID0) = panId & 0xff;
+        HWREG(RFCORE_FFSM_PAN_ID1) = panId >> 8;
+        HWREG(RFCORE_FFSM_SHORT_ADDR0) = shortAddr & 0xff;
+        HWREG(RFCORE_FFSM_SHORT_ADDR1) = shortAddr >> 8;
+        for (uint8_t i = 0; i < 8; ++i)
+            HWREG(RFCORE_FFSM_EXT_ADDR0 + 4 * i) = extAddr[7 - i];
+
+        // The reserved frame types are filtered like the type without their highest bit, so that the multipurpose frames
+        // (type 5) are treated as data frames. Frames of every frame version are accepted and we are no PAN coordinator.
+        HWREG(RFCORE_XREG_FRMFILT1) = (dataFrames ? RFCORE_XREG_FRMFILT1_ACCEPT_FT_1_DATA : 0)
+                                    | (commandFrames ? RFCORE_XREG_FRMFILT1_ACCEPT_FT_3_MAC_CMD : 0)
+                                    | (2 << RFCORE_XREG_FRMFILT1_MODIFY_FT_FILTER_S);
+        HWREG(RFCORE_XREG_FRMFILT0) = RFCORE_XREG_FRMFILT0_MAX_FRAME_VERSION_M | RFCORE_XREG_FRMFILT0_FRAME_FILTER_EN;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Radio::disableFrameFilter()
+    {
+        HWREG(RFCORE_XREG_FRMFILT0) &= ~RFCORE_XREG_FRMFILT0_FRAME_FILTER_EN;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Radio::setChannel(uint8_t channel)
+    {
+        radioChannel = channel;
+        radio.setChannel(channel);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint8_t Radio::getChannel()
+    {
+        return radioChannel;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Radio::isReceiving()
+    {
+        return (dmaPacketLength != 0)
+            || (cutThroughPacketLength != 0)
+            || (HWREG(RFCORE_XREG_RXFIFOCNT) != 0)
+            || (HWREG(RFCORE_XREG_FSMSTAT1) & RFCORE_XREG_FSMSTAT1_SFD);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Radio::storeSamples(const int8_t* samples, uint8_t count, uint8_t firstChannel, uint32_t timestamp)
+    {
+        if (!reserveBufferSpace(count, timestamp, false))
+            return;
+
+        buffer[bufferIndexRadio + BUFFER_CHANNEL_OFFSET] = firstChannel;
+        for (uint8_t i = 0; i < count; ++i)
+            buffer[bufferIndexRadio + BUFFER_EXTRA_BYTES + i] = samples[i];
+
+        bufferIndexRadio += alignRecord(count + BUFFER_EXTRA_BYTES);
+        Statistics::updateBufferPeak();
+        Serial::notifyFromInterrupt();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Radio::storeRecord(uint8_t type, const uint8_t* data, uint8_t length, uint32_t timestamp)
+    {
+        // ZEP packets can only contain frames, and there are no records at all while summarizing the traffic. The record
+        // isn't wanted then, so there is nothing to try again.
+        if (Zep::isEnabled() || Summary::isRunning())
+            return true;
+
+        // The radio interrupt stores frames in the same buffer. A frame that is still being copied already owns the space at
+        // bufferIndexRadio, which only moves past it once the frame is finished, so the record has to wait until then.
+        const uint32_t interruptMask = enterCriticalSection();
+        if ((cutThroughPacketLength != 0) || (dmaPacketLength != 0))
+        {
+            leaveCriticalSection(interruptMask);
+            return false;
+        }
+
+        const bool stored = reserveBufferSpace(length, timestamp, false);
+        if (stored)
+        {
+            buffer[bufferIndexRadio + BUFFER_ORIGINAL_LENGTH_OFFSET] = 0;
+            buffer[bufferIndexRadio + BUFFER_CHANNEL_OFFSET] = type;
+            for (uint8_t i = 0; i < length; ++i)
+                buffer[bufferIndexRadio + BUFFER_EXTRA_BYTES + i] = data[i];
+
+            bufferIndexRadio += alignRecord(length + BUFFER_EXTRA_BYTES);
+            Statistics::updateBufferPeak();
+        }
+
+        leaveCriticalSection(interruptMask);
+        return stored;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Radio::storeChannelMarker(uint8_t previousChannel)
+    {
+        const uint8_t marker[CHANNEL_MARKER_LENGTH] = {previousChannel, 0};
+        if (storeRecord(radioChannel, marker, sizeof(marker), getCurrentTime()))
+            Serial::notifyFromInterrupt();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Radio::storeTelemetry(const uint8_t* data, uint32_t timestamp)
+    {
+        // The record is only stored when there is plenty of room, so it can never cause a frame to be dropped
+        const uint32_t interruptMask = enterCriticalSection();
+        const bool stored = (bufferDistance(bufferIndexAcked, bufferIndexRadio) < TELEMETRY_MAX_BUFFER_USE)
+                         && storeRecord(RECORD_TYPE_TELEMETRY, data, TELEMETRY_RECORD_LENGTH, timestamp);
+
+        leaveCriticalSection(interruptMask);
+        return stored;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Radio::enableTimerInterrupt(void (*handler)())
+    {
+        IntDisable(INT_MACTIMR);
+        IntRegister(INT_MACTIMR, handler);
+
+        HWREG(RFCORE_SFR_MTIRQF) = 0;
+        HWREG(RFCORE_SFR_MTIRQM) |= RFCORE_SFR_MTIRQM_MACTIMER_OVF_COMPARE1M;
+        IntPendClear(INT_MACTIMR);
+        IntEnable(INT_MACTIMR);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Radio::disableTimerInterrupt()
+    {
+        IntDisable(INT_MACTIMR);
+        HWREG(RFCORE_SFR_MTIRQM) &= ~RFCORE_SFR_MTIRQM_MACTIMER_OVF_COMPARE1M;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Radio::isTimerInterruptEnabled()
+    {
+        return (HWREG(RFCORE_SFR_MTIRQM) & (RFCORE_SFR_MTIRQM_MACTIMER_OVF_COMPARE1M | RFCORE_SFR_MTIRQM_MACTIMER_COMPARE1M)) != 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Radio::scheduleTimerInterrupt(uint16_t overflows)
+    {
+        // The interrupt flags have to be cleared by the handler, this is thus the right moment to do it
+        IntPendClear(INT_MACTIMR);
+        HWREG(RFCORE_SFR_MTIRQF) = 0;
+
+        // Reading MTM0 latches the overflow counter. Only the radio interrupt and the compare interrupt set MTMSEL
+        // and they have the same priority, while getCurrentTime disables interrupts while using it.
+        HWREG(RFCORE_SFR_MTMSEL) = (0x00 << RFCORE_SFR_MTMSEL_MTMSEL_S) | (0x00 << RFCORE_SFR_MTMSEL_MTMOVFSEL_S);
+        (void)HWREG(RFCORE_SFR_MTM0);
+
+        uint32_t compare = HWREG(RFCORE_SFR_MTMOVF0);
+        compare |= HWREG(RFCORE_SFR_MTMOVF1) << 8;
+        compare |= HWREG(RFCORE_SFR_MTMOVF2) << 16;
+
+        // The overflow counter is 24 bits wide, the compare register wraps around together with it
+        compare += (overflows < MAC_TIMER_MIN_COMPARE_DELAY) ? MAC_TIMER_MIN_COMPARE_DELAY : overflows;
+        HWREG(RFCORE_SFR_MTMSEL) = (0x03 << RFCORE_SFR_MTMSEL_MTMOVFSEL_S);
+        HWREG(RFCORE_SFR_MTMOVF0) = (compare >> 0) & 0xff;
+        HWREG(RFCORE_SFR_MTMOVF1) = (compare >> 8) & 0xff;
+        HWREG(RFCORE_SFR_MTMOVF2) = (compare >> 16) & 0xff;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint32_t Radio::getCurrentTime()
+    {
+        // The radio interrupt also uses MTMSEL, so it may not occur while reading the timer
+        const uint32_t interruptMask = enterCriticalSection();
+
+        // Reading MTM0 latches both the timer and the overflow counter
+        HWREG(RFCORE_SFR_MTMSEL) = (0x00 << RFCORE_SFR_MTMSEL_MTMSEL_S) | (0x00 << RFCORE_SFR_MTMSEL_MTMOVFSEL_S);
+
+        uint32_t ticks = HWREG(RFCORE_SFR_MTM0);
+        ticks |= HWREG(RFCORE_SFR_MTM1) << 8;
+
+        uint32_t overflows = HWREG(RFCORE_SFR_MTMOVF0);
+        overflows |= HWREG(RFCORE_SFR_MTMOVF1) << 8;
+        overflows |= HWREG(RFCORE_SFR_MTMOVF2) << 16;
+
+        leaveCriticalSection(interruptMask);
+
+        return (overflows << 10) | (ticks >> 5);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint32_t Radio::getSfdTime()
+    {
+        const uint32_t interruptMask = enterCriticalSection();
+        const uint32_t time = readSfdTimestamp();
+        leaveCriticalSection(interruptMask);
+
+        return time;
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////
 
     inline void Radio::flushRadioRX()
     {
+        statistics.radioFlushes++;
+        reset();
+
         CC2538_RF_CSP_ISFLUSHRX();
         CC2538_RF_CSP_ISRXON();
-        led_yellow.off();
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    inline void Radio::packetReceived(uint8_t packetLength)
+    SNIFFER_RAM_FUNCTION inline bool Radio::isRxFifoOverflowed()
     {
-        // Full length is the packet including FCS plus 5 extra bytes that we store (length byte + 2 byte index + 2 byte seq nr)
+        // FIFOP is set without any byte in the FIFO only after an overflow
+        const uint32_t status = HWREG(RFCORE_XREG_FSMSTAT1);
+        return (status & (RFCORE_XREG_FSMSTAT1_FIFOP | RFCORE_XREG_FSMSTAT1_FIFO)) == RFCORE_XREG_FSMSTAT1_FIFOP;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION inline uint32_t Radio::readSfdTimestamp()
+    {
+        // Select the captured timer and overflow values, the timer is latched when reading MTM0
+        HWREG(RFCORE_SFR_MTMSEL) = (0x01 << RFCORE_SFR_MTMSEL_MTMSEL_S) | (0x01 << RFCORE_SFR_MTMSEL_MTMOVFSEL_S);
+
+        uint32_t ticks = HWREG(RFCORE_SFR_MTM0);
+        ticks |= HWREG(RFCORE_SFR_MTM1) << 8;
+
+        uint32_t overflows = HWREG(RFCORE_SFR_MTMOVF0);
+        overflows |= HWREG(RFCORE_SFR_MTMOVF1) << 8;
+        overflows |= HWREG(RFCORE_SFR_MTMOVF2) << 16;
+
+        // Each overflow takes 1024 microseconds and there are 32 ticks in a microsecond.
+        // The result wraps around every 2^32 microseconds, the host is responsible for unwrapping it.
+        return (overflows << 10) | (ticks >> 5);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Microseconds from the SFD of a frame to the SFD of a frame that follows it as closely as possible
+    SNIFFER_RAM_FUNCTION inline uint32_t backToBackTime(uint8_t packetLength)
+    {
+        return (1 + packetLength) * CC2538_RF_BYTE_TIME + CC2538_RF_MIN_FRAME_GAP_TIME;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION inline void Radio::drainRxFifo()
+    {
+        const uint8_t bytesAvailable = HWREG(RFCORE_XREG_RXFIFOCNT);
+        const uint8_t firstPosition = HWREG(RFCORE_XREG_RXFIRST_PTR);
+        const bool frameArriving = (HWREG(RFCORE_XREG_FSMSTAT1) & RFCORE_XREG_FSMSTAT1_SFD) != 0;
+        const uint32_t capturedSfdTime = readSfdTimestamp();
+
+        // Walk over the length bytes without taking them out of the FIFO to find the frames that are complete.
+        // A frame that is still arriving stays in the FIFO until its own RXPKTDONE.
+        uint16_t bytesWalked = 0;
+        uint8_t framesComplete = 0;
+        uint8_t lastPacketLength = 0;
+        uint32_t timeBehind = 0; // Microseconds from the SFD of the first frame in the FIFO to the captured SFD
+        bool lengthsValid = true;
+        while (bytesWalked < bytesAvailable)
+        {
+            const uint8_t packetLength = HWREG(CC2538_RF_RX_FIFO_ADDRESS(firstPosition + bytesWalked));
+            if ((packetLength > CC2538_RF_MAX_PACKET_LEN) || (packetLength < CC2538_RF_MIN_PACKET_LEN))
+            {
+                lengthsValid = false;
+                break;
+            }
+
+            if (bytesWalked + 1 + packetLength > bytesAvailable)
+                break;
+
+            bytesWalked += 1 + packetLength;
+            framesComplete++;
+            lastPacketLength = packetLength;
+            timeBehind += backToBackTime(packetLength);
+        }
+
+        // The bytes behind the complete frames can only belong to a frame that is still being received
+        if ((bytesWalked < bytesAvailable) && !frameArriving)
+            lengthsValid = false;
+
+        // Only the SFD of the last frame that started was captured, it belongs to the last complete frame unless another
+        // one follows it. The frames in front of it are assumed to have followed each other as closely as possible,
+        // which is what happens when several frames are waiting in the FIFO (e.g. a frame and its ACK).
+        if ((framesComplete > 0) && (bytesWalked == bytesAvailable) && !frameArriving)
+            timeBehind -= backToBackTime(lastPacketLength);
+
+        for (uint8_t i = 0; i < framesComplete; ++i)
+        {
+            waitForPendingCopy();
+
+            const uint8_t packetLength = HWREG(RFCORE_SFR_RFDATA);
+            if (!packetReceived(packetLength, capturedSfdTime - timeBehind))
+                return; // The RX FIFO was flushed
+
+            timeBehind -= backToBackTime(packetLength);
+        }
+
+        if (!lengthsValid)
+        {
+            waitForPendingCopy();
+            statistics.invalidLengths++;
+            flushRadioRX();
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION inline bool Radio::packetReceived(uint8_t packetLength, uint32_t timestamp)
+    {
+        if (!reserveBufferSpace(packetLength, timestamp, true))
+        {
+#if RADIO_CONTINUOUS_RX
+            // Only this frame is lost, its bytes are read out of the FIFO so that the frames behind it get their chance
+            for (uint8_t i = 1; i < packetLength; ++i)
+                (void)HWREG(RFCORE_SFR_RFDATA);
+
+            return true;
+#else
+            flushRadioRX();
+            return false;
+#endif
+        }
+
+        // Copy the RX buffer to our buffer with Direct Memory Access
+        startCopy(bufferIndexRadio + BUFFER_EXTRA_BYTES, packetLength);
+        copyStarted(packetLength + BUFFER_EXTRA_BYTES);
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#if RADIO_CUT_THROUGH
+    SNIFFER_RAM_FUNCTION inline void Radio::packetStarted()
+    {
+        // Reserve space in the buffer when this is the first part of the packet
+        if (cutThroughPacketLength == 0)
+        {
+            // Make sure the packet length is valid
+            uint8_t packetLength = HWREG(CC2538_RF_RX_FIFO_ADDRESS(HWREG(RFCORE_XREG_RXFIRST_PTR)));
+            if ((packetLength > CC2538_RF_MAX_PACKET_LEN) || (packetLength < CC2538_RF_MIN_PACKET_LEN))
+            {
+                statistics.invalidLengths++;
+                flushRadioRX();
+                return;
+            }
+
+            // A frame that is already complete is left to the RXPKTDONE interrupt, together with the frames behind it
+            if (packetLength < HWREG(RFCORE_XREG_RXFIFOCNT))
+                return;
+
+            packetLength = HWREG(RFCORE_SFR_RFDATA); // Take the length byte out of the FIFO
+            if (!reserveBufferSpace(packetLength, readSfdTimestamp(), true))
+            {
+                // The rest of the frame is still arriving, so it can't be skipped like a complete one
+                flushRadioRX();
+                return;
+            }
+
+            cutThroughPacketLength = packetLength;
+            cutThroughBytesCopied = 0;
+        }
+
+        // Copy the bytes that already arrived, the rest of the packet is copied when RXPKTDONE occurs.
+        // The amount of bytes is always small enough that there is no reason to use the DMA interrupt here.
+        uint8_t bytesAvailable = HWREG(RFCORE_XREG_RXFIFOCNT);
+        if (bytesAvailable >= cutThroughPacketLength - cutThroughBytesCopied)
+            return; // The packet was completed in the meantime, packetCompleted will copy the rest
+
+        if (bytesAvailable > 0)
+        {
+            startCopy(bufferIndexRadio + BUFFER_EXTRA_BYTES + cutThroughBytesCopied, bytesAvailable);
+            while (HWREG(UDMA_ENASET) & (1 << UDMA_RADIO_CHANNEL))
+                ;
+
+            cutThroughBytesCopied += bytesAvailable;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION inline bool Radio::packetCompleted()
+    {
+        // The remaining bytes must all be in the RX FIFO, the bytes behind them belong to the next frames
+        const uint8_t bytesRemaining = cutThroughPacketLength - cutThroughBytesCopied;
+        if (bytesRemaining > HWREG(RFCORE_XREG_RXFIFOCNT))
+        {
+            statistics.invalidLengths++;
+            flushRadioRX();
+            return false;
+        }
+
+        const uint8_t fullPacketLength = cutThroughPacketLength + BUFFER_EXTRA_BYTES;
+        startCopy(bufferIndexRadio + BUFFER_EXTRA_BYTES + cutThroughBytesCopied, bytesRemaining);
+        reset();
+        copyStarted(fullPacketLength);
+        return true;
+    }
+#endif
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION inline bool Radio::reserveBufferSpace(uint8_t packetLength, uint32_t timestamp, bool frame)
+    {
+        // Full length is the packet including FCS plus 11 extra bytes that we store (length byte + 2 byte index + 2 byte seq nr + 4 byte timestamp + original length + channel)
         const uint8_t fullPacketLength = packetLength + BUFFER_EXTRA_BYTES;
 
+        // A frame might get a descriptor behind it, room for it is kept even when the host didn't ask for descriptors.
+        // The padding that aligns the record is only known when the record is finished, so room for the most padding is kept too.
+        const uint8_t reservedLength = ((frame && CAPTURE_RECORD_CODING) ? fullPacketLength + DESCRIPTOR_LENGTH : fullPacketLength)
+                                     + BUFFER_MAX_PADDING;
+
         // The radio index must never pass the ack index
-        if (((bufferIndexRadio + fullPacketLength >= sizeof(buffer))
-          && ((bufferIndexAcked > bufferIndexRadio) || (bufferIndexAcked <= fullPacketLength)))
-         || ((bufferIndexRadio + fullPacketLength < sizeof(buffer))
-          && (bufferIndexAcked > bufferIndexRadio)
-          && (bufferIndexAcked <= bufferIndexRadio + fullPacketLength)))
-        {
-            // Indicate that we are no longer lossless and discard this packet
-            led_red.on();
-            flushRadioRX();
-            return;
+        if (!bufferHasSpace(bufferIndexRadio, bufferIndexAcked, reservedLength))
+        {
+            // Count the lost packet, which lights the red led. The length byte was already read from the RX FIFO, so the
+            // next byte is the start of the frame control field.
+            // Only the callers of a frame decide whether the RX FIFO is flushed, the other records don't come from it.
+            if (frame)
+                Statistics::frameDropped(HWREG(RFCORE_SFR_RFDATA) & 0x07);
+            else
+                statistics.framesDropped++;
+
+            return false;
         }
 
         // Check if there is no more space behind the last packet
-        if (bufferIndexRadio + fullPacketLength >= sizeof(buffer))
+        if (!bufferRecordFits(bufferIndexRadio, reservedLength))
         {
             // Mark that the last part of the buffer as unused and start at the beginning
             // When the serial task reads this byte it will know that the next packet is found at the beginning of the buffer
+            statistics.bufferWrapBytes += BUFFER_LEN - bufferIndexRadio;
             buffer[bufferIndexRadio] = END_OF_BUFFER_BYTE;
             bufferIndexRadio = 0;
         }
 
-        // Copy the RX buffer to our buffer with Direct Memory Access
-        uDMAChannelControlTable.pvDstEndAddr = (void*)&buffer[bufferIndexRadio + fullPacketLength - 1];
-        uDMAChannelControlTable.ui32Control &= ~(UDMACHCTL_CHCTL_XFERSIZE_M | UDMACHCTL_CHCTL_XFERMODE_M);
-        uDMAChannelControlTable.ui32Control |= UDMA_MODE_AUTO | ((packetLength - 1) << 4);
-        HWREG(UDMA_ENASET) = 1; // uDMAChannelEnable
-        HWREG(UDMA_SWREQ) = 1; // uDMAChannelRequest
-
         // Put the amount of bytes that we will use (including this length byte) in the buffer
         buffer[bufferIndexRadio] = fullPacketLength;
 
@@ -124,22 +698,279 @@ namespace Sniffer
 
         // The next two bytes form the sequence number (for verifying if correct packet is still in buffer)
         writeUint16(buffer, bufferIndexRadio + BUFFER_SEQNR_OFFSET, seqNr);
+        RecordIndex::add(seqNr, bufferIndexRadio);
         seqNr++;
 
+        // The last four bytes before the radio packet contain the time at which the SFD was received
+        writeUint32(buffer, bufferIndexRadio + BUFFER_TIMESTAMP_OFFSET, timestamp);
+
+        // The radio packet might get truncated, so the original length is stored as well
+        buffer[bufferIndexRadio + BUFFER_ORIGINAL_LENGTH_OFFSET] = packetLength;
+
+        // When hopping, the host needs to know on which channel the packet was received
+        buffer[bufferIndexRadio + BUFFER_CHANNEL_OFFSET] = radioChannel;
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION inline void Radio::startCopy(uint16_t index, uint8_t length)
+    {
+        volatile tDMAControlTable& channel = uDMAChannelControlTable[UDMA_RADIO_CHANNEL];
+        channel.pvDstEndAddr = (void*)&buffer[index + length - 1];
+        channel.ui32Control &= ~(UDMACHCTL_CHCTL_XFERSIZE_M | UDMACHCTL_CHCTL_XFERMODE_M);
+        channel.ui32Control |= UDMA_MODE_AUTO | ((length - 1) << 4);
+        HWREG(UDMA_ENASET) = (1 << UDMA_RADIO_CHANNEL); // uDMAChannelEnable
+        HWREG(UDMA_SWREQ) = (1 << UDMA_RADIO_CHANNEL); // uDMAChannelRequest
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION inline void Radio::copyStarted(uint8_t fullPacketLength)
+    {
+#if RADIO_DMA_INTERRUPT
+        // The copy is finished in the uDMA interrupt, the radio is not turned back on until then
+        dmaPacketLength = fullPacketLength;
+#else
         // Wait for ongoing DMA to complete
-        // It is fast enough to wait inside this interrupt, so there is no reason to use DMA interrupts
-        while (HWREG(UDMA_ENASET) & 1)
+        while (HWREG(UDMA_ENASET) & (1 << UDMA_RADIO_CHANNEL))
             ;
 
+        finishPacket(fullPacketLength);
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION inline void Radio::waitForPendingCopy()
+    {
+#if RADIO_DMA_INTERRUPT
+        // The previous packet has to be completely copied before we can handle the next one
+        if (dmaPacketLength != 0)
+        {
+            while (HWREG(UDMA_ENASET) & (1 << UDMA_RADIO_CHANNEL))
+                ;
+
+            dmaInterruptHandler();
+        }
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION void Radio::dmaInterruptHandler()
+    {
+        // Clear the interrupt status of the channel that copies the radio packets. The channel that loads injected frames into
+        // the TX FIFO is a software channel as well, the end of its transfer isn't waited for here.
+        HWREG(UDMA_CHIS) = (1 << UDMA_RADIO_CHANNEL) | (1 << UDMA_INJECT_CHANNEL);
+
+        if (dmaPacketLength != 0)
+        {
+            const uint8_t fullPacketLength = dmaPacketLength;
+            dmaPacketLength = 0;
+            finishPacket(fullPacketLength);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION inline void Radio::finishPacket(uint8_t fullPacketLength)
+    {
         // Correct the RSSI byte (which is stored in the first of the 2 FCS bytes)
         uint8_t& rssi = buffer[bufferIndexRadio + fullPacketLength - 2];
         rssi = ((int8_t)rssi) - CC2538_RF_RSSI_OFFSET;
 
-        // Move the radio index forward
-        bufferIndexRadio += fullPacketLength;
+        // Move the radio index forward, unless the host isn't interested in this frame.
+        // The sequence number is given back in that case so that the host doesn't think a packet got lost.
+        const uint8_t packetLength = fullPacketLength - BUFFER_EXTRA_BYTES;
+        uint8_t* packet = &buffer[bufferIndexRadio + BUFFER_EXTRA_BYTES];
 
-        // Ready for next packet
-        CC2538_RF_CSP_ISRXON();
-        led_yellow.off();
+#if PROFILING
+        Profiling::frameCopied(readUint32(buffer, bufferIndexRadio + BUFFER_TIMESTAMP_OFFSET), packetLength, getCurrentTime());
+#endif
+
+        ChannelHopping::frameReceived();
+
+#if CAPTURE_MODES
+        // When following a TSCH network, every frame helps to stay aligned with its timeslots, also when it is filtered out
+        Tsch::processFrame(packet, packetLength, readUint32(buffer, bufferIndexRadio + BUFFER_TIMESTAMP_OFFSET));
+        Superframe::processFrame(packet, packetLength, readUint32(buffer, bufferIndexRadio + BUFFER_TIMESTAMP_OFFSET));
+
+        if (Summary::isRunning())
+        {
+            // The frame is only counted, the next one is copied to the same place in the buffer
+            if (Filter::accept(packet, packetLength))
+            {
+                Summary::addFrame(packet, packetLength);
+                statistics.framesReceived++;
+            }
+
+            seqNr--;
+        }
+        else
+#endif
+        if (acceptFrame(packet, packetLength))
+        {
+#if CAPTURE_RECORD_CODING
+            // The descriptor is parsed from the frame as it was received.
+            // A retry of a recent frame only refers to it, other frames are truncated when needed and their header is compressed.
+            const uint16_t descriptor = Descriptor::parseFrame(packet, packetLength);
+            const uint8_t recordLength = Duplicates::processRecord(fullPacketLength);
+            if (recordLength != fullPacketLength)
+                fullPacketLength = recordLength;
+            else
+                fullPacketLength = Compression::processRecord(truncatePacket(packet, packetLength));
+
+            fullPacketLength = Descriptor::processRecord(fullPacketLength, descriptor);
+#elif CAPTURE_FILTER
+            fullPacketLength = truncatePacket(packet, packetLength);
+#endif
+
+            bufferIndexRadio += alignRecord(fullPacketLength);
+            statistics.framesReceived++;
+            Statistics::updateBufferPeak();
+            Serial::notifyFromInterrupt();
+        }
+        else
+            seqNr--;
+
+#if !RADIO_CONTINUOUS_RX
+        // Ready for next packet, unless the next one is already being received
+        if (HWREG(RFCORE_XREG_RXFIFOCNT) == 0)
+            CC2538_RF_CSP_ISRXON();
+#endif
+
+#if PROFILING
+        Profiling::frameHandled(getCurrentTime());
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION inline uint8_t Radio::alignRecord(uint8_t fullPacketLength)
+    {
+#if BUFFER_ALIGNED_RECORDS
+        // The padding is cleared so that no stale bytes of an older record are send to the host
+        const uint8_t padding = (BUFFER_RECORD_ALIGNMENT - (fullPacketLength % BUFFER_RECORD_ALIGNMENT)) % BUFFER_RECORD_ALIGNMENT;
+        for (uint8_t i = 0; i < padding; ++i)
+            buffer[bufferIndexRadio + fullPacketLength + i] = 0;
+
+        buffer[bufferIndexRadio + BUFFER_PADDING_OFFSET] = padding;
+        buffer[bufferIndexRadio] = fullPacketLength + padding;
+        return fullPacketLength + padding;
+#else
+        return fullPacketLength;
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION inline bool Radio::acceptFrame(const uint8_t* packet, uint8_t packetLength)
+    {
+#if CAPTURE_FILTER
+        if (dropBadFcs && !(packet[packetLength - 1] & 0x80))
+        {
+            // The CRC_OK bit is cleared, the frame never leaves the OpenMote and the filter doesn't count it
+            statistics.badFcsDropped++;
+            return false;
+        }
+
+        if (!Filter::accept(packet, packetLength) || !applyOverflowPolicy(packet))
+            return false;
+#endif
+#if CAPTURE_MODES
+        if (!Trigger::accept(packet, packetLength))
+            return false;
+#endif
+
+        (void)packet;
+        (void)packetLength;
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION inline uint8_t Radio::truncatePacket(uint8_t* packet, uint8_t packetLength)
+    {
+        // Only keep the first part of the packet when requested, or only its header when the buffer is almost full or the adaptive
+        // policy degraded the capture. The RSSI and LQI are moved right behind it.
+        uint8_t keepLength = snapLength;
+        const uint8_t headerLength = (degradationLevel == DEGRADATION_LEVEL_MINIMAL) ? DEGRADATION_MINIMAL_LENGTH : OVERFLOW_HEADER_LENGTH;
+        const bool keepHeader = (degradationLevel != DEGRADATION_LEVEL_FULL)
+                             || ((overflowPolicy == OVERFLOW_POLICY_KEEP_HEADERS) && isBufferAlmostFull());
+        if (keepHeader && (packetLength - 2 > headerLength) && ((keepLength == 0) || (keepLength > headerLength)))
+        {
+            keepLength = headerLength;
+            statistics.framesTruncated++;
+        }
+
+        if ((keepLength == 0) || (packetLength - 2 <= keepLength))
+            return packetLength + BUFFER_EXTRA_BYTES;
+
+        packet[keepLength] = packet[packetLength - 2];
+        packet[keepLength + 1] = packet[packetLength - 1];
+
+        buffer[bufferIndexRadio] = keepLength + 2 + BUFFER_EXTRA_BYTES;
+        return keepLength + 2 + BUFFER_EXTRA_BYTES;
+    }
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION inline bool Radio::isBufferAlmostFull()
+    {
+        return BUFFER_LEN - bufferDistance(bufferIndexAcked, bufferIndexRadio) < BUFFER_OVERFLOW_RESERVE;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION void Radio::updateDegradationLevel(uint16_t firstSeqNr)
+    {
+        if (overflowPolicy != OVERFLOW_POLICY_ADAPTIVE)
+            return;
+
+        // A level is entered when the buffer reaches its start and only left once the buffer drained a full step below it,
+        // so that the level doesn't change back and forth with every frame that arrives or gets acknowledged
+        const uint16_t bytesUsed = bufferDistance(bufferIndexAcked, bufferIndexRadio);
+        uint8_t level = degradationLevel;
+        while ((level < DEGRADATION_LEVEL_MINIMAL) && (bytesUsed >= ADAPTIVE_OVERFLOW_START + level * ADAPTIVE_OVERFLOW_STEP))
+            level++;
+        while ((level > DEGRADATION_LEVEL_FULL) && (bytesUsed + ADAPTIVE_OVERFLOW_STEP < ADAPTIVE_OVERFLOW_START + (level - 1) * ADAPTIVE_OVERFLOW_STEP))
+            level--;
+
+        if (level == degradationLevel)
+            return;
+
+        // Only the last change is kept when the serial task didn't send the previous one yet, its sequence number tells the host
+        // from which record on the new level applies
+        degradationLevel = level;
+        degradationReport[0] = level;
+        writeUint16(degradationReport, 1, firstSeqNr);
+        writeUint16(degradationReport, 3, bytesUsed);
+        degradationReportPending = true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION inline bool Radio::applyOverflowPolicy(const uint8_t* packet)
+    {
+        // The record of this frame already took the current sequence number
+        updateDegradationLevel(seqNr - 1);
+
+        // From the second degradation level on the ACK frames make room for the headers of the other frames
+        const uint8_t frameType = packet[0] & 0x07;
+        if ((degradationLevel >= DEGRADATION_LEVEL_NO_ACKS) && (frameType == 2))
+        {
+            Statistics::frameDropped(frameType);
+            return false;
+        }
+
+        if ((overflowPolicy != OVERFLOW_POLICY_PREFER_CONTROL) || !isBufferAlmostFull())
+            return true;
+
+        // Beacons and MAC commands are kept, the reserve is meant for them. The copy of the frame is simply not used.
+        if ((frameType != 1) && (frameType != 2))
+            return true;
+
+        Statistics::frameDropped(frameType);
+        return false;
     }
 }
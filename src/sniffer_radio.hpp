@@ -14,6 +14,8 @@ namespace Sniffer
 {
     class Radio
     {
+        friend class Benchmark; // Measures the private functions in benchmark/main.cpp
+
     public:
         // Set up radio interrupts and DMA
         static void initialize();
@@ -21,12 +23,135 @@ namespace Sniffer
         // Function called when a radio interrupt (SFD or RXPKTDONE) occurs
         static void radioInterruptHandler();
 
+        // Function called when the uDMA has finished copying a packet out of the radio (only when RADIO_DMA_INTERRUPT is set)
+        static void dmaInterruptHandler();
+
+        // Forget about the packet that is currently being received
+        static void reset();
+
+        // Only store the first bytes of each radio packet (followed by the RSSI and LQI), 0 stores the entire packet
+        static void setSnapLength(uint8_t length);
+
+        // Choose what to do with the frames that arrive while the buffer is almost full, returns false for an unknown policy
+        static bool setOverflowPolicy(uint8_t policy);
+
+        // Follow the buffer with the degradation level of the adaptive overflow policy and send the DEGRADATION message about
+        // its last change, called from the serial task
+        static void sendPeriodically();
+
+        // Discard the frames with a bad FCS instead of sending them to the host, returns false for a value other than 0 or 1
+        static bool setFcsFilter(uint8_t drop);
+
+        // Let the radio drop every frame of which the destination isn't the PAN and one of the addresses (or a broadcast).
+        // Only data frames and MAC commands are let through when the flags are set, the extended address is big endian.
+        static void enableFrameFilter(uint16_t panId, uint16_t shortAddr, const uint8_t* extAddr, bool dataFrames, bool commandFrames);
+
+        // Pass all frames to the RX FIFO again
+        static void disableFrameFilter();
+
+        // Tune the radio to another channel, the radio has to be turned on again afterwards for the change to take effect
+        static void setChannel(uint8_t channel);
+
+        // Channel on which the radio is listening
+        static uint8_t getChannel();
+
+        // Check whether a packet is being received or is still waiting to be copied out of the RX FIFO
+        static bool isReceiving();
+
+        // Store a block of RSSI samples in the buffer as if it were a packet, the first sample was taken on the given channel
+        static void storeSamples(const int8_t* samples, uint8_t count, uint8_t firstChannel, uint32_t timestamp);
+
+        // Store a record of the given RECORD_TYPE_* between the frames. Returns false when there was no room for it or when a
+        // frame was still being copied into the buffer, the caller can then try again later. Returns true without storing
+        // anything in ZEP mode and while summarizing the traffic, which have no records.
+        static bool storeRecord(uint8_t type, const uint8_t* data, uint8_t length, uint32_t timestamp);
+
+        // Store the marker record that tells the host that the radio was tuned from the given channel to the current one
+        static void storeChannelMarker(uint8_t previousChannel);
+
+        // Store a telemetry record with the sensor readings, called from the serial task. Returns false when the record has to
+        // be tried again later, because the buffer is too full or a frame is being copied into it.
+        static bool storeTelemetry(const uint8_t* data, uint32_t timestamp);
+
+        // Call the handler when the MAC timer compare interrupt occurs, which has the same priority as the radio interrupt
+        static void enableTimerInterrupt(void (*handler)());
+
+        // Stop the MAC timer compare interrupt
+        static void disableTimerInterrupt();
+
+        // Check whether a module is using the MAC timer compare interrupt
+        static bool isTimerInterruptEnabled();
+
+        // Let the compare interrupt occur after the given amount of overflows of the MAC timer (at least MAC_TIMER_MIN_COMPARE_DELAY)
+        static void scheduleTimerInterrupt(uint16_t overflows);
+
+        // Read the current value of the MAC timer, in microseconds
+        static uint32_t getCurrentTime();
+
+        // Read the MAC timer value that was captured at the last SFD, which is also captured when transmitting a frame
+        static uint32_t getSfdTime();
+
     private:
+        // Handles the radio interrupt, split from radioInterruptHandler so that it can be measured when PROFILING is set
+        static void handleRadioInterrupt();
+
         // Flush the radio receive buffer, called when something went wrong (e.g. received bytes do not match with PHY header)
         static void flushRadioRX();
 
-        // Handles the received packet when RXPKTDONE interrupt occured
-        static void packetReceived(uint8_t packetLength);
+        // Handles the first part of the packet when the FIFOP threshold was reached (only when RADIO_CUT_THROUGH is set)
+        static void packetStarted();
+
+        // Copies the remaining part of a packet when RXPKTDONE occured after packetStarted was called,
+        // returns false when the RX FIFO had to be flushed
+        static bool packetCompleted();
+
+        // Read the MAC timer value that was captured at the last SFD, in microseconds
+        static uint32_t readSfdTimestamp();
+
+        // Takes every complete frame out of the RX FIFO when RXPKTDONE occured, a frame that is still arriving is left in it
+        static void drainRxFifo();
+
+        // Handles a received packet of which the length byte was read, returns false when it was dropped and the FIFO flushed
+        static bool packetReceived(uint8_t packetLength, uint32_t timestamp);
+
+        // Check whether the RX FIFO overflowed, which stops the receiver until the FIFO is flushed
+        static bool isRxFifoOverflowed();
+
+        // Check if there is room for the packet and write the extra bytes in front of it, returns false when packet was dropped.
+        // Frame is false for a block of samples, otherwise the type of a dropped frame is read from the RX FIFO and the caller
+        // has to remove the rest of the frame from it.
+        static bool reserveBufferSpace(uint8_t packetLength, uint32_t timestamp, bool frame);
+
+        // Start copying bytes from the RX FIFO into the buffer at the given index
+        static void startCopy(uint16_t index, uint8_t length);
+
+        // Wait for the copy of the packet to finish or leave it to the uDMA interrupt
+        static void copyStarted(uint8_t fullPacketLength);
+
+        // Finish the copy of the previous packet if the uDMA interrupt didn't occur yet
+        static void waitForPendingCopy();
+
+        // Fix the RSSI, move the radio index forward and turn the radio back on after a packet was copied into the buffer
+        static void finishPacket(uint8_t fullPacketLength);
+
+        // Pad the record that is being written to whole words when BUFFER_ALIGNED_RECORDS is enabled, returns its new length
+        static uint8_t alignRecord(uint8_t fullPacketLength);
+
+        // Check whether the copied frame is send to the host, only the checks of the features in this image are made
+        static bool acceptFrame(const uint8_t* packet, uint8_t packetLength);
+
+        // Cut the packet off at the snap length, or behind its header for the overflow policy, returns the new record length
+        static uint8_t truncatePacket(uint8_t* packet, uint8_t packetLength);
+
+        // Check whether less than BUFFER_OVERFLOW_RESERVE bytes are left in the buffer
+        static bool isBufferAlmostFull();
+
+        // Check whether the copied frame may stay in the buffer according to the overflow policy, the drop is counted when it may not
+        static bool applyOverflowPolicy(const uint8_t* packet);
+
+        // Change the degradation level of the adaptive overflow policy when the buffer passed a threshold, the change is reported
+        // as applying from the record with the given sequence number
+        static void updateDegradationLevel(uint16_t firstSeqNr);
     };
 }
 
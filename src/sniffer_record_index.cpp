@@ -0,0 +1,35 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_record_index.hpp"
+
+namespace Sniffer
+{
+    // Only written by the radio interrupt, a stale entry is harmless since find() verifies the record it points to
+    uint16_t recordIndexEntries[RECORD_INDEX_LEN];
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION void RecordIndex::add(uint16_t recordSeqNr, uint16_t index)
+    {
+        recordIndexEntries[recordSeqNr & (RECORD_INDEX_LEN - 1)] = index;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint16_t RecordIndex::find(uint16_t recordSeqNr)
+    {
+        // The radio index is cached for the same reason as in SerialReceive::checkReceivedIndexAndSeqNr
+        const uint16_t cachedBufferIndexRadio = bufferIndexRadio;
+        const uint16_t index = recordIndexEntries[recordSeqNr & (RECORD_INDEX_LEN - 1)];
+        if ((index >= BUFFER_LEN) || !bufferContains(bufferIndexAcked, cachedBufferIndexRadio, index)
+         || (buffer[index] == END_OF_BUFFER_BYTE) || (readUint16(buffer, index + BUFFER_SEQNR_OFFSET) != recordSeqNr))
+            return RECORD_INDEX_UNKNOWN;
+
+        return index;
+    }
+}
@@ -0,0 +1,30 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_RECORD_INDEX_HPP
+#define SNIFFER_RECORD_INDEX_HPP
+
+#include "sniffer_global.hpp"
+
+namespace Sniffer
+{
+    // Remembers where the last RECORD_INDEX_LEN records were stored in the buffer, by the lower bits of their sequence number,
+    // so that a record can be found without walking over the length bytes of all records in front of it.
+    // An entry is overwritten by a later record or points to a record that was freed, every lookup is checked against the buffer.
+    class RecordIndex
+    {
+    public:
+        // Called from the radio interrupt when a record with the sequence number was placed at the index
+        static void add(uint16_t recordSeqNr, uint16_t index);
+
+        // Find the record with the sequence number among the records that weren't acknowledged yet.
+        // Returns RECORD_INDEX_UNKNOWN when it is no longer in the buffer or when its entry was overwritten.
+        static uint16_t find(uint16_t recordSeqNr);
+    };
+}
+
+#endif // SNIFFER_RECORD_INDEX_HPP
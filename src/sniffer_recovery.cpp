@@ -0,0 +1,142 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_recovery.hpp"
+#include "sniffer_serial_send.hpp"
+
+#include "hw_sys_ctrl.h"
+
+#define RECOVERY_MAGIC  0x4F4D5242  // "OMRB"
+
+namespace Sniffer
+{
+    // Written when a capture starts, the indexes of the buffer are only valid together with a header of this build
+    struct RecoveryHeader
+    {
+        uint32_t magic;
+        uint16_t bufferLength;
+        uint16_t crc;
+    };
+
+    SNIFFER_NOINIT RecoveryHeader recoveryHeader;
+
+    // Recovered records, between the record at the start index (which the host already acknowledged) and the end index
+    uint16_t recoveryIndexStart = 0;
+    uint16_t recoveryIndexEnd = 0;
+    uint16_t recoveryRecords = 0;
+    uint8_t  recoveryChunk[RECOVERY_DUMP_CHUNK_LEN];
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Recovery::initialize()
+    {
+        // After a power-on the SRAM contains random data, which could still look like a valid header
+        const uint32_t resetCause = (HWREG(SYS_CTRL_CLOCK_STA) & SYS_CTRL_CLOCK_STA_RST_M) >> SYS_CTRL_CLOCK_STA_RST_S;
+        const uint16_t fromIndex = bufferIndexAcked;
+        const uint16_t toIndex = bufferIndexRadio;
+        if ((resetCause != 0) && (recoveryHeader.magic == RECOVERY_MAGIC) && (recoveryHeader.bufferLength == BUFFER_LEN)
+         && (recoveryHeader.crc == calculateHeaderCrc()) && (fromIndex < BUFFER_LEN) && (toIndex < BUFFER_LEN)
+         && validateRecords(fromIndex, toIndex))
+        {
+            recoveryIndexStart = fromIndex;
+            recoveryIndexEnd = toIndex;
+        }
+
+        // The recovered records stay in place, nothing is stored in the buffer before the next capture starts
+        recoveryHeader.magic = 0;
+        bufferIndexRadio = 0;
+        bufferIndexAcked = 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Recovery::startCapture()
+    {
+        recoveryIndexStart = 0;
+        recoveryIndexEnd = 0;
+        recoveryRecords = 0;
+
+        recoveryHeader.magic = RECOVERY_MAGIC;
+        recoveryHeader.bufferLength = BUFFER_LEN;
+        recoveryHeader.crc = calculateHeaderCrc();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Recovery::dump()
+    {
+        // Multiple records are send per message, like when dumping the flash log
+        uint8_t chunkLength = 0;
+        uint16_t index = recoveryIndexStart;
+        for (uint16_t i = 0; i < recoveryRecords; ++i)
+        {
+            index = bufferSkipUnusedEnd(index + buffer[index], recoveryIndexEnd);
+
+            const uint8_t length = buffer[index];
+            if (chunkLength + length > RECOVERY_DUMP_CHUNK_LEN)
+            {
+                SerialSend::sendMessage(SerialDataType::Recovery, recoveryChunk, chunkLength);
+                chunkLength = 0;
+            }
+
+            for (uint8_t j = 0; j < length; ++j)
+                recoveryChunk[chunkLength++] = buffer[index + j];
+        }
+
+        if (chunkLength > 0)
+            SerialSend::sendMessage(SerialDataType::Recovery, recoveryChunk, chunkLength);
+
+        SerialSend::sendMessage(SerialDataType::Recovery, recoveryChunk, 0);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Recovery::validateRecords(uint16_t fromIndex, uint16_t toIndex)
+    {
+        // Every record contains its own index and the radio index points right behind the last record that was stored.
+        // The record at the acked index was already acknowledged, only the records behind it are recovered.
+        if (fromIndex == toIndex)
+            return false;
+
+        uint16_t index = fromIndex;
+        uint16_t records = 0;
+        uint16_t expectedSeqNr = 0;
+        while (true)
+        {
+            const uint8_t length = buffer[index];
+            if ((length < BUFFER_EXTRA_BYTES) || (length > SERIAL_BATCH_MAX_DATA_LEN) || !bufferRecordFits(index, length)
+             || (readUint16(buffer, index + BUFFER_INDEX_OFFSET) != index))
+                return false;
+
+            const uint16_t recordSeqNr = readUint16(buffer, index + BUFFER_SEQNR_OFFSET);
+            if ((index != fromIndex) && (recordSeqNr != expectedSeqNr))
+                return false;
+
+            expectedSeqNr = recordSeqNr + 1;
+            index = bufferSkipUnusedEnd(index + length, toIndex);
+            if (index == toIndex)
+                break;
+
+            // Even a buffer full of the smallest records ends long before this, unless the chain goes round in circles
+            if (++records > BUFFER_LEN / BUFFER_EXTRA_BYTES)
+                return false;
+        }
+
+        recoveryRecords = records;
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint16_t Recovery::calculateHeaderCrc()
+    {
+        uint8_t data[6];
+        writeUint32(data, 0, recoveryHeader.magic);
+        writeUint16(data, 4, recoveryHeader.bufferLength);
+        return crcCalculate(data, sizeof(data), CRC_INIT);
+    }
+}
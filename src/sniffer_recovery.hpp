@@ -0,0 +1,41 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_RECOVERY_HPP
+#define SNIFFER_RECOVERY_HPP
+
+#include "sniffer_global.hpp"
+
+namespace Sniffer
+{
+    // The buffer and its radio and acked indexes aren't cleared by a reset, only by a loss of power. When the watchdog
+    // (or anything else but a power-on) resets the OpenMote, the records that the host didn't acknowledge are still there.
+    // They are checked and kept aside until the host asks for them with a RECOVERY message, or until it starts capturing.
+    class Recovery
+    {
+    public:
+        // Look for the records of the capture that was running before the reset, called first thing at startup.
+        // Also gives the indexes of the buffer, which aren't initialized by the startup code, their starting values.
+        static void initialize();
+
+        // Remember that the buffer belongs to a new capture, called when the buffer is reset.
+        // The records of the capture before the reset are lost from then on.
+        static void startCapture();
+
+        // Send the records that were recovered at startup, followed by an empty RECOVERY message to mark the end
+        static void dump();
+
+    private:
+        // Check whether the indexes of the buffer point to a chain of valid records with consecutive sequence numbers
+        static bool validateRecords(uint16_t fromIndex, uint16_t toIndex);
+
+        // Checksum over the header that describes the buffer
+        static uint16_t calculateHeaderCrc();
+    };
+}
+
+#endif // SNIFFER_RECOVERY_HPP
@@ -8,15 +8,135 @@
 #include "sniffer_serial.hpp"
 #include "sniffer_serial_send.hpp"
 #include "sniffer_serial_receive.hpp"
+#include "sniffer_statistics.hpp"
+#include "sniffer_summary.hpp"
+#include "sniffer_flash_log.hpp"
+#include "sniffer_zep.hpp"
+#include "sniffer_trigger.hpp"
+#include "sniffer_integrity.hpp"
+#include "sniffer_epoch.hpp"
+#include "sniffer_tsch.hpp"
+#include "sniffer_superframe.hpp"
+#include "sniffer_channel_hopping.hpp"
+#include "sniffer_inject.hpp"
+#include "sniffer_telemetry.hpp"
+#include "sniffer_status_leds.hpp"
+#include "sniffer_flow_control.hpp"
+#include "sniffer_radio.hpp"
+#include "sniffer_transport.hpp"
+#include "sniffer_autostart.hpp"
+#include "sniffer_trace.hpp"
+#include "sniffer_timebase.hpp"
+#include "sniffer_pps.hpp"
+#include "sniffer_fec.hpp"
+
+#include "Semaphore.h"
 
 namespace Sniffer
 {
+    // Given by the interrupts whenever there is something for the serial task to do
+    SemaphoreBinary serialTaskEvent;
+
+    uint32_t baudrate = 0; // Set to the default baudrate of the transport during initialization
+    bool     baudrateVerifying = false; // Set while waiting for the host to confirm a new baudrate
+    uint32_t baudrateChangeTime = 0;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Return to BAUDRATE when the host didn't confirm the new baudrate in time
+    inline void checkBaudrateVerification()
+    {
+        if (baudrateVerifying && (Radio::getCurrentTime() - baudrateChangeTime >= BAUDRATE_VERIFY_TIMEOUT))
+            Serial::resetBaudrate();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Milliseconds until the host has to confirm the new baudrate, or TIMEOUT_NONE when not waiting for it
+    inline uint32_t getTimeUntilBaudrateTimeout()
+    {
+        if (!baudrateVerifying)
+            return TIMEOUT_NONE;
+
+        const uint32_t elapsed = Radio::getCurrentTime() - baudrateChangeTime;
+        if (elapsed >= BAUDRATE_VERIFY_TIMEOUT)
+            return 0;
+
+        return (BAUDRATE_VERIFY_TIMEOUT - elapsed + 999) / 1000;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
     void Serial::initialize()
     {
-        uart.enable(BAUDRATE, UART_CONFIG_WLEN_8 | UART_CONFIG_STOP_ONE | UART_CONFIG_PAR_NONE, UART_TXINT_MODE_EOT);
+        Transport::initialize();
+        baudrate = Transport::getDefaultBaudrate();
 
         SerialSend::initialize();
-        SerialReceive::initialize();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Serial::notifyFromInterrupt()
+    {
+        serialTaskEvent.giveFromInterrupt();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Serial::receivedBaudrate(uint8_t message[])
+    {
+        // The pattern catches a host that is still using a different baudrate, in case the corrupted message had a valid crc
+        if (readUint32(message, BAUDRATE_PATTERN_OFFSET) != BAUDRATE_PATTERN)
+            return false;
+
+        // The host confirms the new baudrate by repeating the request after the change
+        const uint32_t requested = readUint32(message, BAUDRATE_RATE_OFFSET);
+        if (requested == baudrate)
+            baudrateVerifying = false;
+
+        // The answer contains the baudrate that we will use, which remains the old one when the requested one isn't possible
+        const uint32_t rate = Transport::isBaudrateSupported(requested) ? requested : baudrate;
+        uint8_t data[BAUDRATE_MESSAGE_LENGTH - 2];
+        writeUint32(data, BAUDRATE_RATE_OFFSET - 2, rate);
+        writeUint32(data, BAUDRATE_PATTERN_OFFSET - 2, BAUDRATE_PATTERN);
+        SerialSend::sendMessage(SerialDataType::Baudrate, data, sizeof(data));
+
+        if (rate != baudrate)
+        {
+            setBaudrate(rate);
+            baudrateVerifying = true;
+            baudrateChangeTime = Radio::getCurrentTime();
+        }
+
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Serial::resetBaudrate()
+    {
+        baudrateVerifying = false;
+        if (baudrate != Transport::getDefaultBaudrate())
+            setBaudrate(Transport::getDefaultBaudrate());
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint32_t Serial::getBaudrate()
+    {
+        return baudrate;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Serial::setBaudrate(uint32_t rate)
+    {
+        Transport::setBaudrate(rate);
+
+        // Bytes that were underway during the change make the round-trip time measurement unreliable
+        baudrate = rate;
+        FlowControl::cancelMeasurement();
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -25,13 +145,96 @@ namespace Sniffer
     {
         while (true)
         {
-            // Check if there are bytes the the UART RX buffer and process them
+            watchdog.walk();
+
+            // Check if there are bytes in the RX buffer and process them
+            Transport::poll();
             SerialReceive::receive();
 
-            // Check if there is a packet in the buffer that still has to be send to the pc
-            if ((bufferIndexSerialSend != bufferIndexRadio) && !UARTBusy(uart.getBase()))
+            // Pass the next encoded packet to the transport when the previous one is finished
+            SerialSend::transmit();
+
+            // A finished sample is stored before looking at the buffer, so that it is send without waiting for the next event
+            Telemetry::sendPeriodically();
+            Timebase::sendPeriodically();
+            Pps::storePulse();
+
+            // Check if there is a packet in the buffer that still has to be send to the pc.
+            // In ZEP mode they go to another address without being acknowledged, until a trigger matches they are held back
+            // and when the host stopped responding the packets are moved to the flash log instead.
+            // In throughput mode they also wait until there are enough of them to fill the batches, and while the host paused
+            // them they aren't send or retransmitted at all. A capture that started by itself keeps them until a host attaches.
+            bool packetEncoded = false;
+            bool batchHeld = false;
+            if (Zep::isEnabled())
+            {
+                packetEncoded = Zep::send();
+            }
+            else if (Trigger::isHoldingRecords())
+            {
+                packetEncoded = Trigger::process();
+            }
+            else if (FlashLog::isHostGone())
+            {
+                packetEncoded = FlashLog::spill();
+            }
+            else if ((bufferIndexSerialSend != bufferIndexRadio) && SerialSend::isTxBufferAvailable() && !FlowControl::isPaused()
+                  && !Autostart::isAttachPending())
             {
-                SerialSend::send();
+                batchHeld = !SerialSend::isBatchReady();
+                if (!batchHeld)
+                {
+                    SerialSend::send();
+                    packetEncoded = true;
+                }
+            }
+
+            // Let the host know how well the sniffer is keeping up, when it asked for it
+            Statistics::sendPeriodically();
+            Summary::sendPeriodically();
+            Integrity::sendCheckpoint();
+            Epoch::sendPeriodically();
+            Tsch::sendPeriodically();
+            Superframe::sendPeriodically();
+            ChannelHopping::sendPeriodically();
+            Inject::sendPeriodically();
+            Radio::sendPeriodically();
+            Trace::sendPeriodically();
+            Fec::sendPeriodically();
+            StatusLeds::update();
+
+            checkBaudrateVerification();
+
+            // Sleep until an interrupt wakes us up, unless there might be more packets waiting in the buffer.
+            // The semaphore remembers when it was given in the meantime, so no event can get lost.
+            if (!packetEncoded)
+            {
+                // Nothing more will be send for now, so the packets that the transport gathered have to leave
+                Transport::flush();
+
+                uint32_t timeout = Statistics::getTimeUntilNextSend();
+                if (Summary::getTimeUntilNextSend() < timeout)
+                    timeout = Summary::getTimeUntilNextSend();
+                if (Telemetry::getTimeUntilNextSample() < timeout)
+                    timeout = Telemetry::getTimeUntilNextSample();
+                if (Timebase::getTimeUntilNextSync() < timeout)
+                    timeout = Timebase::getTimeUntilNextSync();
+                if (FlashLog::getTimeUntilHostTimeout() < timeout)
+                    timeout = FlashLog::getTimeUntilHostTimeout();
+                if (getTimeUntilBaudrateTimeout() < timeout)
+                    timeout = getTimeUntilBaudrateTimeout();
+                if (StatusLeds::getTimeUntilNextUpdate() < timeout)
+                    timeout = StatusLeds::getTimeUntilNextUpdate();
+                if (batchHeld && (SerialSend::getTimeUntilBatchReady() < timeout))
+                    timeout = SerialSend::getTimeUntilBatchReady();
+                if (FlowControl::getTimeUntilPauseTimeout() < timeout)
+                    timeout = FlowControl::getTimeUntilPauseTimeout();
+
+                // The watchdog has to be cleared even when there is nothing to do
+                if (WATCHDOG_KICK_INTERVAL < timeout)
+                    timeout = WATCHDOG_KICK_INTERVAL;
+
+                serialTaskEvent.take(timeout + portTICK_RATE_MS - 1);
             }
         }
     }
@@ -15,11 +15,27 @@ namespace Sniffer
     class Serial
     {
     public:
-        // Enable UART interrupt and send READY message to host
+        // Set up the transport to the host and send READY message to host
         static void initialize();
 
-        // Task which handles sending and receiving over UART, which is run the whole time when no interrupts are being executed
+        // Wake up the serial task, called from the interrupts when a packet was stored or a UART transfer happened.
+        // The interrupts that call this function must not have a higher priority than configMAX_SYSCALL_INTERRUPT_PRIORITY.
+        static void notifyFromInterrupt();
+
+        // Handle a BAUDRATE message from the host, returns false when the message is invalid
+        static bool receivedBaudrate(uint8_t message[]);
+
+        // Return to the default baudrate, called when the host stops sniffing
+        static void resetBaudrate();
+
+        // The baudrate that the transport is currently using
+        static uint32_t getBaudrate();
+
+        // Task which handles sending and receiving over UART, it sleeps while there is nothing to do
         static void serialTask(void*);
+
+    private:
+        static void setBaudrate(uint32_t rate);
     };
 }
 
@@ -7,52 +7,82 @@
 
 #include "sniffer_serial_receive.hpp"
 #include "sniffer_serial_send.hpp"
+#include "sniffer_serial.hpp"
+#include "sniffer_flow_control.hpp"
+#include "sniffer_filter.hpp"
+#include "sniffer_radio.hpp"
+#include "sniffer_channel_hopping.hpp"
+#include "sniffer_tsch.hpp"
+#include "sniffer_superframe.hpp"
+#include "sniffer_inject.hpp"
+#include "sniffer_telemetry.hpp"
+#include "sniffer_survey.hpp"
+#include "sniffer_summary.hpp"
+#include "sniffer_descriptor.hpp"
+#include "sniffer_trigger.hpp"
+#include "sniffer_record_index.hpp"
+#include "sniffer_statistics.hpp"
+#include "sniffer_profiling.hpp"
+#include "sniffer_flash_log.hpp"
+#include "sniffer_recovery.hpp"
+#include "sniffer_zep.hpp"
+#include "sniffer_decryption.hpp"
+#include "sniffer_integrity.hpp"
+#include "sniffer_encryption.hpp"
+#include "sniffer_duplicates.hpp"
+#include "sniffer_compression.hpp"
+#include "sniffer_sync.hpp"
+#include "sniffer_autostart.hpp"
+#include "sniffer_trace.hpp"
+#include "sniffer_pps.hpp"
+#include "sniffer_timebase.hpp"
+#include "sniffer_fec.hpp"
 
 namespace Sniffer
 {
     bool     receivingStatus = false;
     bool     escaping = false;
-    uint16_t crc = CRC_INIT;
-    uint8_t  message[SERIAL_RX_MAX_MESSAGE_LEN];
+    uint8_t  rxMessage[SERIAL_RX_MAX_MESSAGE_LEN];
+    uint8_t* message = rxMessage; // Points to the message that is being handled, which may also come from CONTROL messages
     uint8_t  messageLen = 0;
 
-    volatile uint8_t uartRxBuffer[SERIAL_RX_BUFFER_LEN];
-    volatile uint8_t uartRxBufferIndexWrite = 0;
-    uint8_t uartRxBufferIndexRead = 0;
+    uint8_t  controlMessage[CONTROL_MAX_MESSAGE_LEN];
+    uint16_t controlLength = 0; // Bytes of the message of the current command that were received
+    uint8_t  controlCommand = 0;
+    uint8_t  controlStatus = CONTROL_STATUS_PENDING;
 
-    PlainCallback uartRxCallback(&SerialReceive::uartByteReceived);
+    uint8_t rxBufferIndexRead = 0;
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    void SerialReceive::initialize()
+    void SerialReceive::receive()
     {
-        uart.setRxCallback(&uartRxCallback);
-        uart.enableInterrupts();
-    }
+        // Only calls that have something to process are measured, otherwise the idle loop would dominate the results
+        if (rxBufferIndexRead == rxBufferIndexWrite)
+            return;
 
-    ////////////////////////////////////////////////////////////////////////////////////////////////////
+        const uint32_t startCycles = Profiling::start();
+        while (rxBufferIndexRead != rxBufferIndexWrite)
+        {
+            processByte(rxBuffer[rxBufferIndexRead]);
 
-    void SerialReceive::uartByteReceived()
-    {
-        uartRxBuffer[uartRxBufferIndexWrite] = uart.readByte();
+            rxBufferIndexRead++;
+            if (rxBufferIndexRead == sizeof(rxBuffer))
+                rxBufferIndexRead = 0;
+        }
 
-        uartRxBufferIndexWrite++;
-        if (uartRxBufferIndexWrite == sizeof(uartRxBuffer))
-            uartRxBufferIndexWrite = 0;
+        Profiling::stop(ProfilingSection::SerialReceive, startCycles);
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    void SerialReceive::receive()
+    bool SerialReceive::replay(const uint8_t* storedMessage)
     {
-        while (uartRxBufferIndexRead != uartRxBufferIndexWrite)
-        {
-            processByte(uartRxBuffer[uartRxBufferIndexRead]);
-
-            uartRxBufferIndexRead++;
-            if (uartRxBufferIndexRead == sizeof(uartRxBuffer))
-                uartRxBufferIndexRead = 0;
-        }
+        // The handlers only read the message, as they do with the messages that arrive in CONTROL messages
+        message = const_cast<uint8_t*>(storedMessage);
+        const bool accepted = decodeReceivedMessage();
+        message = rxMessage;
+        return accepted;
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -76,7 +106,7 @@ namespace Sniffer
             else
             {
                 // Something went wrong, start retransmitting
-                bufferIndexSerialSend = bufferIndexAcked + buffer[bufferIndexAcked];
+                retransmitUnackedPackets();
                 receivingStatus = false;
                 messageLen = 0;
             }
@@ -90,7 +120,6 @@ namespace Sniffer
         receivingStatus = true;
         escaping = false;
         messageLen = 0;
-        crc = CRC_INIT;
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -101,7 +130,7 @@ namespace Sniffer
         if (messageLen == 0)
         {
             receivedStartByte();
-            bufferIndexSerialSend = bufferIndexAcked + buffer[bufferIndexAcked];
+            retransmitUnackedPackets();
             return;
         }
 
@@ -109,20 +138,22 @@ namespace Sniffer
         bool validMessage = false;
         if (!escaping && (messageLen >= 4)) // minimum packet size = 1 byte type + 1 byte length + 2 byte crc
         {
-            if (crc == 0) // Calculating CRC of packet bytes + CRC bytes always results 0 for correct CRC
+            if (crcCalculate(message, messageLen, CRC_INIT) == 0) // Calculating CRC of packet bytes + CRC bytes always results 0 for correct CRC
             {
                 // Make sure the length byte is correct (value of length byte does not include type and length bytes)
                 if (messageLen == message[1] + 2)
                 {
                     // Find out what message we received and act acordingly
                     validMessage = decodeReceivedMessage();
+                    if (validMessage)
+                        Autostart::record(message);
                 }
             }
         }
 
         // Start retransmitting if there was something wrong with the message
         if (!validMessage)
-            bufferIndexSerialSend = bufferIndexAcked + buffer[bufferIndexAcked];
+            retransmitUnackedPackets();
 
         receivingStatus = false;
     }
@@ -139,7 +170,7 @@ namespace Sniffer
             }
             else // Something is wrong
             {
-                bufferIndexSerialSend = bufferIndexAcked + buffer[bufferIndexAcked];
+                retransmitUnackedPackets();
                 receivingStatus = false;
             }
         }
@@ -152,7 +183,6 @@ namespace Sniffer
             }
 
             message[messageLen++] = byte;
-            crc = crcCalculationStep(byte, crc);
         }
     }
 
@@ -164,16 +194,102 @@ namespace Sniffer
             receivedACK();
         else if ((message[0] == SerialDataType::Nack) && (message[1] == NACK_MESSAGE_LENGTH))
             receivedNACK();
-        else if ((message[0] == SerialDataType::Reset) && (message[1] == RESET_MESSAGE_LENGTH))
+        else if ((message[0] == SerialDataType::SelectiveNack) && (message[1] == SELECTIVE_NACK_MESSAGE_LENGTH))
+            receivedSelectiveNACK();
+        else if ((message[0] == SerialDataType::CumulativeAck) && (message[1] == CUMULATIVE_ACK_MESSAGE_LENGTH))
+            receivedCumulativeACK();
+        else if ((message[0] == SerialDataType::Reset)
+              && ((message[1] == RESET_MESSAGE_LENGTH) || (message[1] == RESET_EXTENDED_MESSAGE_LENGTH)))
             receivedRESET();
         else if ((message[0] == SerialDataType::Stop) && (message[1] == STOP_MESSAGE_LENGTH))
             receivedSTOP();
+        else if ((message[0] == SerialDataType::Resume) && (message[1] == RESUME_MESSAGE_LENGTH))
+            receivedRESUME();
+        else if ((message[0] == SerialDataType::Identify) && (message[1] == IDENTIFY_MESSAGE_LENGTH))
+            SerialSend::sendIdentifyPacket();
+        else if ((message[0] == SerialDataType::Control) && (message[1] > CONTROL_MESSAGE_LENGTH) && (message == rxMessage))
+            receivedCONTROL();
+        else if (CAPTURE_FILTER && (message[0] == SerialDataType::Filter) && (message[1] == FILTER_MESSAGE_LENGTH))
+            return Filter::setRule(message);
+        else if (CAPTURE_FILTER && (message[0] == SerialDataType::FilterProgram) && (message[1] >= FILTER_PROGRAM_MESSAGE_LENGTH))
+            return Filter::setProgram(message);
+        else if ((message[0] == SerialDataType::FilterStats) && (message[1] == FILTER_STATS_MESSAGE_LENGTH))
+            Filter::sendStats();
+        else if (CAPTURE_FILTER && (message[0] == SerialDataType::SnapLength) && (message[1] == SNAP_LENGTH_MESSAGE_LENGTH))
+            Radio::setSnapLength(message[SNAP_LENGTH_OFFSET]);
+        else if (CAPTURE_FILTER && (message[0] == SerialDataType::Overflow) && (message[1] == OVERFLOW_MESSAGE_LENGTH))
+            return Radio::setOverflowPolicy(message[OVERFLOW_POLICY_OFFSET]);
+        else if (CAPTURE_FILTER && (message[0] == SerialDataType::FcsFilter) && (message[1] == FCS_FILTER_MESSAGE_LENGTH))
+            return Radio::setFcsFilter(message[FCS_FILTER_DROP_OFFSET]);
+        else if (CAPTURE_RECORD_CODING && (message[0] == SerialDataType::Duplicates) && (message[1] == DUPLICATES_MESSAGE_LENGTH))
+            return Duplicates::enable(message);
+        else if (CAPTURE_RECORD_CODING && (message[0] == SerialDataType::Compression) && (message[1] == COMPRESSION_MESSAGE_LENGTH))
+            return Compression::enable(message);
+        else if (CAPTURE_RECORD_CODING && (message[0] == SerialDataType::Descriptor) && (message[1] == DESCRIPTOR_MESSAGE_LENGTH))
+            return Descriptor::enable(message);
+        else if (CAPTURE_MODES && (message[0] == SerialDataType::Trigger) && (message[1] == TRIGGER_MESSAGE_LENGTH))
+            return Trigger::arm(message);
+        else if ((message[0] == SerialDataType::Hop) && (message[1] == HOP_MESSAGE_LENGTH))
+            return ChannelHopping::setEntry(message);
+        else if ((message[0] == SerialDataType::AdaptiveHop) && (message[1] == ADAPTIVE_HOP_MESSAGE_LENGTH))
+            return ChannelHopping::setAdaptive(message);
+        else if ((message[0] == SerialDataType::SetChannel) && (message[1] == SET_CHANNEL_MESSAGE_LENGTH))
+            return hostSessionActive && ChannelHopping::switchChannel(message);
+        else if (CAPTURE_MODES && (message[0] == SerialDataType::Tsch) && (message[1] == TSCH_MESSAGE_LENGTH))
+            return hostSessionActive && Tsch::start(message);
+        else if (CAPTURE_MODES && (message[0] == SerialDataType::Superframe) && (message[1] == SUPERFRAME_MESSAGE_LENGTH))
+            return hostSessionActive && Superframe::start(message);
+        else if ((message[0] == SerialDataType::Inject) && (message[1] >= INJECT_MESSAGE_LENGTH))
+            return hostSessionActive && Inject::queue(message);
+        else if ((message[0] == SerialDataType::Telemetry) && (message[1] == TELEMETRY_MESSAGE_LENGTH))
+            return hostSessionActive && Telemetry::setInterval(message);
+        else if ((message[0] == SerialDataType::Pps) && (message[1] == PPS_MESSAGE_LENGTH) && hostSessionActive)
+            Pps::enable(message[PPS_ENABLE_OFFSET] != 0);
+        else if ((message[0] == SerialDataType::Timebase) && (message[1] == TIMEBASE_MESSAGE_LENGTH) && hostSessionActive)
+            Timebase::enable(message[TIMEBASE_ENABLE_OFFSET] != 0);
+        else if ((message[0] == SerialDataType::Fec) && (message[1] == FEC_MESSAGE_LENGTH))
+            return Fec::setGroupSize(message[FEC_GROUP_SIZE_OFFSET]);
+        else if ((message[0] == SerialDataType::Framing) && (message[1] == FRAMING_MESSAGE_LENGTH))
+            return SerialSend::setFraming(message[FRAMING_MODE_OFFSET]);
+        else if ((message[0] == SerialDataType::Batching) && (message[1] == BATCHING_MESSAGE_LENGTH))
+            return SerialSend::setBatching(message);
+        else if ((message[0] == SerialDataType::Pause) && (message[1] == PAUSE_MESSAGE_LENGTH))
+            FlowControl::setPaused(message[PAUSE_PAUSED_OFFSET] != 0);
+        else if ((message[0] == SerialDataType::Lanes) && (message[1] == LANES_MESSAGE_LENGTH))
+            return SerialSend::setLanes(message[LANES_COUNT_OFFSET]);
+        else if ((message[0] == SerialDataType::Autostart) && (message[1] == AUTOSTART_MESSAGE_LENGTH))
+            return Autostart::command(message[AUTOSTART_COMMAND_OFFSET]);
+        else if (TRACE_RECORDER && (message[0] == SerialDataType::Trace) && (message[1] == TRACE_MESSAGE_LENGTH))
+            Trace::enable(message[TRACE_ENABLE_OFFSET] != 0);
+        else if ((message[0] == SerialDataType::Survey) && (message[1] == SURVEY_MESSAGE_LENGTH))
+            receivedSURVEY();
+        else if (CAPTURE_MODES && (message[0] == SerialDataType::Summary) && (message[1] == SUMMARY_MESSAGE_LENGTH))
+            return receivedSUMMARY();
+        else if ((message[0] == SerialDataType::Stats) && (message[1] == STATS_MESSAGE_LENGTH))
+            Statistics::setInterval(readUint16(message, STATS_INTERVAL_OFFSET));
+        else if ((message[0] == SerialDataType::FlashLog) && (message[1] == FLASH_LOG_MESSAGE_LENGTH))
+            return FlashLog::command(message[FLASH_LOG_COMMAND_OFFSET]);
+        else if ((message[0] == SerialDataType::Recovery) && (message[1] == RECOVERY_MESSAGE_LENGTH))
+            Recovery::dump();
+        else if ((message[0] == SerialDataType::Baudrate) && (message[1] == BAUDRATE_MESSAGE_LENGTH))
+            return Serial::receivedBaudrate(message);
+        else if ((message[0] == SerialDataType::Zep) && (message[1] == ZEP_MESSAGE_LENGTH))
+            return Zep::enable(message);
+        else if ((message[0] == SerialDataType::Key) && (message[1] == KEY_MESSAGE_LENGTH))
+            return Decryption::setKey(message);
+        else if ((message[0] == SerialDataType::Integrity) && (message[1] == INTEGRITY_MESSAGE_LENGTH))
+            return Integrity::enable(message);
+        else if ((message[0] == SerialDataType::Encryption) && (message[1] == ENCRYPTION_MESSAGE_LENGTH))
+            return Encryption::enable(message);
+        else if ((message[0] == SerialDataType::Sync) && (message[1] == SYNC_MESSAGE_LENGTH))
+            return SyncBeacon::start(message);
         else
         {
             led_orange.on();
             return false;
         }
 
+        FlashLog::hostActive();
         return true;
     }
 
@@ -186,26 +302,47 @@ namespace Sniffer
 
         // Validate the received index which has to lie within the unacked area and verify the related sequence number
         if (checkReceivedIndexAndSeqNr(receivedIndex, receivedSeqNr))
-        {
-            // Move the acked index forward
-            // When passing the serial index we must move it forward as well
-            if (((receivedIndex < bufferIndexAcked)
-              && (bufferIndexSerialSend >= bufferIndexAcked || bufferIndexSerialSend < receivedIndex))
-             || ((receivedIndex > bufferIndexAcked)
-              && (bufferIndexSerialSend >= bufferIndexAcked && bufferIndexSerialSend < receivedIndex)))
-            {
-                bufferIndexSerialSend = receivedIndex + buffer[receivedIndex];
-            }
-            bufferIndexAcked = receivedIndex;
-        }
+            acknowledge(receivedIndex, receivedSeqNr);
         else
             receivedInvalidMessage();
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+    inline void SerialReceive::receivedCumulativeACK()
+    {
+        uint16_t receivedIndex = readUint16(message, CUMULATIVE_ACK_INDEX_OFFSET);
+        uint16_t receivedSeqNr = readUint16(message, CUMULATIVE_ACK_SEQNR_OFFSET);
+        uint32_t missing = readUint32(message, CUMULATIVE_ACK_MISSING_OFFSET);
+
+        // The index is validated only once for both the ACK and the resend request that it replaces
+        if (!checkReceivedIndexAndSeqNr(receivedIndex, receivedSeqNr))
+        {
+            receivedInvalidMessage();
+            return;
+        }
+
+        acknowledge(receivedIndex, receivedSeqNr);
+
+        // Only one range of packets can be resend at a time. While one is being resend the host is only acknowledging,
+        // it asks for what is still missing once that range arrived.
+        if ((missing != 0) && (selectiveRepeatRemaining == 0))
+        {
+            statistics.nacksReceived++;
+
+            // The records between the missing ones are resend as well, the host drops those that it already has
+            bufferIndexSerialResume = bufferIndexSerialSend;
+            bufferIndexSerialSend = receivedIndex + buffer[receivedIndex];
+            selectiveRepeatRemaining = 32 - __builtin_clz(missing);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
     inline void SerialReceive::receivedNACK()
     {
+        statistics.nacksReceived++;
+
         uint16_t receivedIndex = readUint16(message, NACK_INDEX_OFFSET);
         uint16_t receivedSeqNr = readUint16(message, NACK_SEQNR_OFFSET);
 
@@ -215,6 +352,36 @@ namespace Sniffer
             // Move the acked index forward and resend everything that the host hasn't received yet
             bufferIndexSerialSend = receivedIndex + buffer[receivedIndex];
             bufferIndexAcked = receivedIndex;
+            selectiveRepeatRemaining = 0;
+        }
+        else
+            receivedInvalidMessage();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void SerialReceive::receivedSelectiveNACK()
+    {
+        statistics.nacksReceived++;
+
+        uint16_t receivedIndex = readUint16(message, SELECTIVE_NACK_INDEX_OFFSET);
+        uint16_t receivedSeqNr = readUint16(message, SELECTIVE_NACK_SEQNR_OFFSET);
+        uint16_t receivedCount = readUint16(message, SELECTIVE_NACK_COUNT_OFFSET);
+
+        // Only one range of packets can be resend at a time, fall back to resending everything when another one is requested
+        if (selectiveRepeatRemaining > 0)
+        {
+            retransmitUnackedPackets();
+            return;
+        }
+
+        // The received index is the last packet that the host received before the missing ones
+        if (checkReceivedIndexAndSeqNr(receivedIndex, receivedSeqNr) && (receivedCount > 0))
+        {
+            // Resend the requested packets and continue where we were afterwards
+            bufferIndexSerialResume = bufferIndexSerialSend;
+            bufferIndexSerialSend = receivedIndex + buffer[receivedIndex];
+            selectiveRepeatRemaining = receivedCount;
         }
         else
             receivedInvalidMessage();
@@ -225,16 +392,32 @@ namespace Sniffer
     inline void SerialReceive::receivedRESET()
     {
         reset();
+        resetControl();
+        Autostart::captureStarted();
+        Filter::clear();
+        Decryption::clear();
+        Statistics::clear();
+        FlashLog::disable();
+        Radio::setSnapLength(0);
+        Radio::setOverflowPolicy(OVERFLOW_POLICY_DROP_NEW);
+        Radio::setFcsFilter(0);
 
         // Verify that the received channel is within the correct range
         uint8_t channel = message[RESET_CHANNEL_OFFSET];
         if (channel >= 11 && channel <= 26)
         {
             // Set the requested channel
-            radio.setChannel(channel);
+            Radio::setChannel(channel);
+
+            // Older hosts don't send the window size and ACK interval, let the window adapt itself in that case
+            if (message[1] == RESET_EXTENDED_MESSAGE_LENGTH)
+                FlowControl::configure(readUint16(message, RESET_WINDOW_OFFSET), readUint16(message, RESET_ACK_INTERVAL_OFFSET));
+            else
+                FlowControl::configure(0, 0);
 
             // Send the READY message
             SerialSend::sendReadyPacket();
+            hostSessionActive = true;
             led_green.on();
 
             // Allow new radio packets now
@@ -245,9 +428,164 @@ namespace Sniffer
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+    inline void SerialReceive::receivedCONTROL()
+    {
+        const uint8_t command = message[CONTROL_COMMAND_OFFSET];
+        const uint16_t offset = readUint16(message, CONTROL_CHUNK_OFFSET_OFFSET);
+        const uint8_t chunkLength = message[1] - CONTROL_MESSAGE_LENGTH;
+
+        // The answer to the last chunk of this command got lost
+        if ((command == controlCommand) && (controlStatus != CONTROL_STATUS_PENDING))
+        {
+            sendControlAnswer(command, controlStatus, controlLength);
+            return;
+        }
+
+        if (offset == 0)
+        {
+            controlCommand = command;
+            controlLength = 0;
+            controlStatus = CONTROL_STATUS_PENDING;
+        }
+
+        if ((command != controlCommand) || (offset != controlLength) || (offset + chunkLength > CONTROL_MAX_MESSAGE_LEN))
+        {
+            sendControlAnswer(command, CONTROL_STATUS_RESEND, (command == controlCommand) ? controlLength : 0);
+            return;
+        }
+
+        for (uint8_t i = 0; i < chunkLength; ++i)
+            controlMessage[controlLength + i] = message[CONTROL_CHUNK_OFFSET + i];
+        controlLength += chunkLength;
+
+        // Wait for the rest of the message
+        if ((controlLength < 2) || (controlLength < controlMessage[1] + 2))
+        {
+            sendControlAnswer(command, CONTROL_STATUS_PENDING, controlLength);
+            return;
+        }
+
+        // The message is handled as if it was received on its own, but any failure only leads to the answer
+        controlStatus = CONTROL_STATUS_REJECTED;
+        if ((controlLength == controlMessage[1] + 2) && (controlLength >= 4) && (crcCalculate(controlMessage, controlLength, CRC_INIT) == 0))
+        {
+            message = controlMessage;
+            if (decodeReceivedMessage())
+            {
+                controlStatus = CONTROL_STATUS_ACCEPTED;
+                Autostart::record(message);
+            }
+            message = rxMessage;
+        }
+
+        sendControlAnswer(command, controlStatus, controlLength);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void SerialReceive::resetControl()
+    {
+        controlLength = 0;
+        controlStatus = CONTROL_STATUS_PENDING;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void SerialReceive::sendControlAnswer(uint8_t command, uint8_t status, uint16_t received)
+    {
+        uint8_t data[CONTROL_ANSWER_LENGTH - 2];
+        data[0] = command;
+        data[1] = status;
+        writeUint16(data, 2, received);
+        SerialSend::sendMessage(SerialDataType::Control, data, sizeof(data));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
     inline void SerialReceive::receivedSTOP()
     {
         reset();
+
+        // The next host will start at the default baudrate
+        Serial::resetBaudrate();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void SerialReceive::receivedSURVEY()
+    {
+        reset();
+        resetControl();
+        Autostart::captureStarted();
+        Filter::clear();
+        Decryption::clear();
+        Statistics::clear();
+        FlashLog::disable();
+        Radio::setSnapLength(0);
+        Radio::setOverflowPolicy(OVERFLOW_POLICY_DROP_NEW);
+        Radio::setFcsFilter(0);
+
+        FlowControl::configure(readUint16(message, SURVEY_WINDOW_OFFSET), readUint16(message, SURVEY_ACK_INTERVAL_OFFSET));
+
+        // Send the READY message, the blocks of samples will follow it just like packets would after a RESET
+        SerialSend::sendReadyPacket();
+        hostSessionActive = true;
+        led_green.on();
+
+        // Radio interrupts remain disabled, the RX FIFO is flushed every time the channel changes
+        Survey::start(readUint16(message, SURVEY_SAMPLE_INTERVAL_OFFSET));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline bool SerialReceive::receivedSUMMARY()
+    {
+        reset();
+        resetControl();
+        Autostart::captureStarted();
+        Filter::clear();
+        Decryption::clear();
+        Statistics::clear();
+        FlashLog::disable();
+        Radio::setSnapLength(0);
+        Radio::setOverflowPolicy(OVERFLOW_POLICY_DROP_NEW);
+        Radio::setFcsFilter(0);
+
+        // The tables are set up before the radio is turned on, a frame received before that would be stored as a record
+        const uint8_t channel = message[SUMMARY_CHANNEL_OFFSET];
+        if ((channel < 11) || (channel > 26) || !Summary::start(readUint16(message, SUMMARY_INTERVAL_OFFSET)))
+            return false;
+
+        Radio::setChannel(channel);
+        FlowControl::configure(0, 0);
+
+        // Send the READY message, the SUMMARY messages will follow it instead of the records
+        SerialSend::sendReadyPacket();
+        hostSessionActive = true;
+        led_green.on();
+
+        IntEnable(INT_RFCORERTX);
+        CC2538_RF_CSP_ISRXON();
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void SerialReceive::receivedRESUME()
+    {
+        // There is nothing to continue with before the first RESET or SURVEY, and records send as ZEP packets are never acknowledged
+        uint16_t receivedIndex = readUint16(message, RESUME_INDEX_OFFSET);
+        const uint16_t receivedSeqNr = readUint16(message, RESUME_SEQNR_OFFSET);
+        const bool resumed = hostSessionActive && !Zep::isEnabled() && checkReceivedIndexAndSeqNr(receivedIndex, receivedSeqNr);
+        if (resumed)
+        {
+            // Everything after the last record that the new host has is send again, the sequence numbers just continue
+            bufferIndexSerialSend = receivedIndex + buffer[receivedIndex];
+            bufferIndexAcked = receivedIndex;
+            selectiveRepeatRemaining = 0;
+        }
+
+        SerialSend::sendResumePacket(resumed);
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -255,13 +593,49 @@ namespace Sniffer
     inline void SerialReceive::receivedInvalidMessage()
     {
         led_orange.on();
+        retransmitUnackedPackets();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void SerialReceive::acknowledge(uint16_t receivedIndex, uint16_t receivedSeqNr)
+    {
+        // Move the acked index forward
+        // When passing the serial index we must move it forward as well
+        if (((receivedIndex < bufferIndexAcked)
+          && (bufferIndexSerialSend >= bufferIndexAcked || bufferIndexSerialSend < receivedIndex))
+         || ((receivedIndex > bufferIndexAcked)
+          && (bufferIndexSerialSend >= bufferIndexAcked && bufferIndexSerialSend < receivedIndex)))
+        {
+            bufferIndexSerialSend = receivedIndex + buffer[receivedIndex];
+            selectiveRepeatRemaining = 0;
+        }
+        bufferIndexAcked = receivedIndex;
+
+        FlowControl::ackReceived(receivedSeqNr);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void SerialReceive::retransmitUnackedPackets()
+    {
         bufferIndexSerialSend = bufferIndexAcked + buffer[bufferIndexAcked];
+        selectiveRepeatRemaining = 0;
+        Trace::record(TraceEvent::Retransmit, 1);
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    inline bool SerialReceive::checkReceivedIndexAndSeqNr(uint16_t receivedIndex, uint16_t receivedSeqNr)
+    inline bool SerialReceive::checkReceivedIndexAndSeqNr(uint16_t& receivedIndex, uint16_t receivedSeqNr)
     {
+        // A host that doesn't know the index leaves it to us to find the record by its sequence number
+        if (receivedIndex == RECORD_INDEX_UNKNOWN)
+        {
+            receivedIndex = RecordIndex::find(receivedSeqNr);
+            if (receivedIndex == RECORD_INDEX_UNKNOWN)
+                return false;
+        }
+
         // Caching the radio buffer is required because we do two if checks directly after each other.
         // If a radio interrupt occurred exactly between these lines and it would move the radio index from
         // the end to the beginning of the buffer then the received index would be incorrectly discarted.
@@ -269,20 +643,10 @@ namespace Sniffer
         // The radio index can never pass the acked index so an up-to-date radio index is not relevant in these checks.
         uint16_t cachedBufferIndexRadio = bufferIndexRadio;
 
-        if (receivedIndex >= sizeof(buffer))
-        {
+        if (receivedIndex >= BUFFER_LEN)
+            return false;
+        if (!bufferContains(bufferIndexAcked, cachedBufferIndexRadio, receivedIndex))
             return false;
-        }
-        else if (bufferIndexAcked > cachedBufferIndexRadio) // around end and start of buffer
-        {
-            if ((receivedIndex < bufferIndexAcked) && (receivedIndex > cachedBufferIndexRadio))
-                return false;
-        }
-        else // if (bufferIndexAcked <= cachedBufferIndexRadio)
-        {
-            if ((receivedIndex < bufferIndexAcked) || (receivedIndex > cachedBufferIndexRadio))
-                return false;
-        }
 
         // Check to make sure that the sequence number in the buffer matches
         uint16_t seqNrInBuffer = readUint16(buffer, receivedIndex + BUFFER_SEQNR_OFFSET);
@@ -290,13 +654,7 @@ namespace Sniffer
             return false;
 
         // The index can never be too far away
-        uint16_t dist = 0;
-        if (receivedIndex > bufferIndexAcked)
-            dist = receivedIndex - bufferIndexAcked;
-        else if (receivedIndex < bufferIndexAcked)
-            dist = sizeof(buffer) - bufferIndexAcked + receivedIndex;
-
-        if (dist > RETRANSMIT_THRESHOLD + CC2538_RF_MAX_PACKET_LEN + BUFFER_EXTRA_BYTES)
+        if (bufferDistance(bufferIndexAcked, receivedIndex) > RETRANSMIT_THRESHOLD_MAX + SERIAL_BATCH_MAX_DATA_LEN)
             return false;
 
         return true;
@@ -14,16 +14,15 @@ namespace Sniffer
 {
     class SerialReceive
     {
-    public:
-        // Enable UART interrupt
-        static void initialize();
-
-        // Interrupt handler for UART
-        static void uartByteReceived();
+        friend class Benchmark; // Measures the private functions in benchmark/main.cpp
 
-        // Check if there are bytes the the UART RX buffer and process them
+    public:
+        // Check if there are bytes in the RX buffer and process them
         static void receive();
 
+        // Handle a message that was stored in the flash as if the host just sent it, returns false when it was refused
+        static bool replay(const uint8_t* storedMessage);
+
     private:
         static void processByte(uint8_t byte);
         static void receivedStartByte();
@@ -32,10 +31,20 @@ namespace Sniffer
         static bool decodeReceivedMessage();
         static void receivedACK();
         static void receivedNACK();
+        static void receivedSelectiveNACK();
+        static void receivedCumulativeACK();
         static void receivedRESET();
         static void receivedSTOP();
+        static void receivedRESUME();
+        static void receivedSURVEY();
+        static bool receivedSUMMARY();
+        static void receivedCONTROL();
+        static void resetControl();
+        static void sendControlAnswer(uint8_t command, uint8_t status, uint16_t received);
         static void receivedInvalidMessage();
-        static bool checkReceivedIndexAndSeqNr(uint16_t receivedIndex, uint16_t receivedSeqNr);
+        static void acknowledge(uint16_t receivedIndex, uint16_t receivedSeqNr);
+        static void retransmitUnackedPackets();
+        static bool checkReceivedIndexAndSeqNr(uint16_t& receivedIndex, uint16_t receivedSeqNr);
     };
 }
 
@@ -6,21 +6,116 @@
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 #include "sniffer_serial_send.hpp"
+#include "sniffer_serial.hpp"
+#include "sniffer_flow_control.hpp"
+#include "sniffer_survey.hpp"
+#include "sniffer_statistics.hpp"
+#include "sniffer_profiling.hpp"
+#include "sniffer_transport.hpp"
+#include "sniffer_decryption.hpp"
+#include "sniffer_integrity.hpp"
+#include "sniffer_encryption.hpp"
+#include "sniffer_epoch.hpp"
+#include "sniffer_radio.hpp"
+#include "sniffer_trace.hpp"
+#include "sniffer_fec.hpp"
+
+#define ENCODED_PACKET_SURVEY   (1 << 0)    // Flags of an encoded packet, the records are only the same when encoded in the same way
+#define ENCODED_PACKET_DECRYPT  (1 << 1)
+#define ENCODED_PACKET_COBS     (1 << 2)
+#define ENCODED_PACKET_ACK_REQUESTED    (1 << 3)
+#define ENCODED_PACKET_ENCRYPT  (1 << 4)
+
+#define TX_BUFFER_QUEUED        0           // States of a TX buffer that contains a packet
+#define TX_BUFFER_SENDING       1
+#define TX_BUFFER_SENT          2           // Send, but an older packet on another lane wasn't finished yet
 
 namespace Sniffer
 {
-    uint8_t  uartTxBuffer[SERIAL_TX_BUFFER_SIZE];
+    // Records that an encoded packet contains, so that it can be send again when a retransmission reaches the same records
+    struct EncodedPacket
+    {
+        uint16_t length;        // Length of the encoded packet in the slot, 0 when the slot contains nothing that can be reused
+        uint16_t startIndex;    // Index in the buffer of the first record in the packet
+        uint16_t lastIndex;     // Index in the buffer of the last record in the packet
+        uint16_t indexAfter;    // Index in the buffer behind the packet, at which the next packet continues
+        uint16_t firstSeqNr;    // Sequence number of the first record, which tells whether the record at startIndex is still the same
+        uint8_t  batchLength;   // Bytes of the records in the packet
+        uint8_t  batchCount;    // Amount of records in the packet
+        uint8_t  flags;         // ENCODED_PACKET_* with which the records were encoded
+        uint8_t  dataType;      // Type of the message, with ACK_REQUESTED when it asks for an ACK
+        uint16_t crc;           // Serial CRC of the message, for the parity of the FEC message
+        uint32_t lastUsed;      // Value of encodedPacketUses when the packet was last queued, the oldest slot is reused first
+    };
+
+    // The packets are encoded in slots of which SERIAL_TX_BUFFER_COUNT are queued for the transport at most. A slot keeps its
+    // packet after it was send, so that a retransmission of the same records only queues it again instead of encoding it.
+    uint8_t  uartTxBuffers[SERIAL_TX_SLOT_COUNT][SERIAL_TX_BUFFER_SIZE];
+    EncodedPacket encodedPackets[SERIAL_TX_SLOT_COUNT];
+    uint32_t encodedPacketUses = 0;
+    uint8_t  uartTxBufferSlots[SERIAL_TX_BUFFER_COUNT]; // Slot of the encoded packet in each TX buffer
+    uint16_t uartTxBufferLens[SERIAL_TX_BUFFER_COUNT]; // Length of the encoded packet in each buffer, 0 when the buffer is free
+    uint16_t uartTxBufferStartIndex[SERIAL_TX_BUFFER_COUNT]; // Index in the buffer of the first packet that was encoded
+    uint8_t  uartTxBufferStates[SERIAL_TX_BUFFER_COUNT]; // TX_BUFFER_* of each buffer with a packet
+    uint8_t  uartTxBufferFill = 0; // Buffer in which the next packet will be encoded
+    uint8_t  uartTxBufferSend = 0; // Oldest buffer with a packet, the buffers are freed in the order in which they were filled
+    uint8_t  uartTxBufferStart = 0; // Buffer that will be given to the next free lane
+
+    // The transport can send a packet on each lane at the same time, the host decides how many of them are used
+    uint8_t  uartTxLaneBuffers[SERIAL_TX_LANES]; // Buffer that each lane is sending, SERIAL_TX_BUFFER_COUNT when it is free
+    uint8_t  uartTxLanesBusy = 0;
+    uint8_t  txLanes = 1;
+
+    // Value of bufferIndexSerialSend after the last packet was encoded, if it changed then a retransmission was started
+    uint16_t bufferIndexSerialEncoded = 0;
+
+    // Buffer and length of the packet that is currently being encoded
+    uint8_t* uartTxBuffer = uartTxBuffers[0];
     uint16_t uartTxBufferLen = 0;
+    uint16_t uartTxBufferCrc = 0; // Serial CRC of the packet that was encoded last
+
+    uint8_t  serialFraming = FRAMING_HDLC;
+    uint16_t cobsCodeIndex = 0; // Position of the code byte of the COBS block that is being filled
+
+    // In throughput mode the records wait until batchThreshold bytes are waiting or batchHoldTime passed since batchHoldStart.
+    // Once released, everything that is waiting is send before the next records are held back again.
+    uint8_t  batchingMode = BATCHING_LATENCY;
+    uint16_t batchThreshold = 0;
+    uint32_t batchHoldTime = 0; // In microseconds
+    uint32_t batchHoldStart = 0;
+    bool     batchHolding = false;
+    bool     batchReleased = false;
+
+#if SERIAL_FAULT_INJECTION || SNIFFER_NATIVE
+#if SNIFFER_NATIVE
+    uint16_t serialFaultRate = 0;
+#else
+    uint16_t serialFaultRate = SERIAL_FAULT_RATE;
+#endif
+    SerialFaultCounters serialFaults;
+    uint32_t serialFaultRandom = 0x2545F491; // State of the xorshift generator, the same faults happen in every run
+    bool     uartTxRepeat[SERIAL_TX_LANES] = {}; // The packet that the lane is sending has to be send a second time
+#endif
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////
 
     void SerialSend::initialize()
     {
-        // The first byte in the transmit buffer is always the HDLC_FLAG
-        uartTxBuffer[0] = HDLC_FLAG;
+        for (uint8_t i = 0; i < SERIAL_TX_SLOT_COUNT; ++i)
+        {
+            // The first byte in the transmit buffer is always the HDLC_FLAG
+            uartTxBuffers[i][0] = HDLC_FLAG;
+            encodedPackets[i].length = 0;
+        }
+
+        for (uint8_t i = 0; i < SERIAL_TX_BUFFER_COUNT; ++i)
+        {
+            uartTxBufferSlots[i] = i;
+            uartTxBufferLens[i] = 0;
+        }
 
-        // The second byte in the transmit buffer is a fixed type indicating that we are sending a packet
-        uartTxBuffer[1] = SerialDataType::Packet;
+        for (uint8_t lane = 0; lane < SERIAL_TX_LANES; ++lane)
+            uartTxLaneBuffers[lane] = SERIAL_TX_BUFFER_COUNT;
 
         // Tell the host that we are ready to start sniffing
         sendReadyPacket();
@@ -28,15 +123,26 @@ namespace Sniffer
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    void SerialSend::send()
+    SNIFFER_RAM_FUNCTION void SerialSend::send()
     {
         // Start at the beginning of the buffer when we have reached the end
-        if (buffer[bufferIndexSerialSend] == END_OF_BUFFER_BYTE)
-            bufferIndexSerialSend = 0;
+        const uint16_t nextIndex = bufferSkipUnusedEnd(bufferIndexSerialSend, bufferIndexRadio);
+        if (nextIndex != bufferIndexSerialSend)
+        {
+            // This is not a retransmission, so the encoded packets that are still waiting remain valid
+            if (bufferIndexSerialEncoded == bufferIndexSerialSend)
+                bufferIndexSerialEncoded = nextIndex;
+
+            bufferIndexSerialSend = nextIndex;
+
+            // The radio might still be copying the first packet at the beginning of the buffer
+            if (bufferIndexSerialSend == bufferIndexRadio)
+                return;
+        }
 
         // Check if the length byte is valid
-        if ((buffer[bufferIndexSerialSend] > CC2538_RF_MAX_PACKET_LEN + BUFFER_EXTRA_BYTES)
-         || (bufferIndexSerialSend + buffer[bufferIndexSerialSend] >= sizeof(buffer)))
+        if ((buffer[bufferIndexSerialSend] > SERIAL_BATCH_MAX_DATA_LEN)
+         || !bufferRecordFits(bufferIndexSerialSend, buffer[bufferIndexSerialSend]))
         {
             // Something unknown went terribly wrong, reset the sniffer and continue sniffing
             reset(); // disable radio interrupts and reset global variables
@@ -47,83 +153,713 @@ namespace Sniffer
             return;
         }
 
-        // Fill the transmit buffer and send it over the UART
-        hdlcEncode();
-        for (uint16_t i = 0; i < uartTxBufferLen; ++i)
-            UARTCharPut(uart.getBase(), uartTxBuffer[i]);
+        // A retransmission sends the same packets again as long as they are still in their slots
+        const bool survey = Survey::isRunning();
+        const bool decrypt = !survey && Decryption::isEnabled();
+        const bool hash = !survey && Integrity::isEnabled();
+        const bool encrypt = !survey && Encryption::isEnabled();
+        const bool ackRequested = FlowControl::isAckRequested(bufferDistance(bufferIndexAcked, bufferIndexSerialSend));
+        const uint8_t flags = (survey ? ENCODED_PACKET_SURVEY : 0) | (decrypt ? ENCODED_PACKET_DECRYPT : 0)
+                            | ((serialFraming == FRAMING_COBS) ? ENCODED_PACKET_COBS : 0)
+                            | (ackRequested ? ENCODED_PACKET_ACK_REQUESTED : 0) | (encrypt ? ENCODED_PACKET_ENCRYPT : 0);
+        const uint8_t encodedSlot = findEncodedPacket(flags);
+        const uint8_t slot = (encodedSlot < SERIAL_TX_SLOT_COUNT) ? encodedSlot : freeSlot();
+        EncodedPacket& packet = encodedPackets[slot];
+        if (slot == encodedSlot)
+        {
+            // The chain of hashes may have been started after the packet was encoded, hashing a record twice does nothing
+            if (hash)
+            {
+                uint16_t index = packet.startIndex;
+                for (uint8_t i = 0; i < packet.batchCount; ++i)
+                {
+                    Integrity::hashRecord(index);
+                    index += buffer[index];
+                }
+            }
+        }
+        else
+        {
+            encodePacket(slot, survey, decrypt, hash, encrypt, ackRequested);
+            packet.flags = flags;
+        }
+
+        packet.lastUsed = ++encodedPacketUses;
+        uartTxBufferSlots[uartTxBufferFill] = slot;
+        uartTxBufferStartIndex[uartTxBufferFill] = bufferIndexSerialSend;
+        uint16_t indexAfterBatch = packet.indexAfter;
+        const uint8_t batchLength = packet.batchLength;
+        const uint8_t batchCount = packet.batchCount;
+
+        // Measure how long it takes before the host acknowledges this packet
+        const uint16_t lastSeqNrInBatch = readUint16(buffer, packet.lastIndex + BUFFER_SEQNR_OFFSET);
+        FlowControl::packetSent(lastSeqNrInBatch);
+        Statistics::packetSent(lastSeqNrInBatch, batchLength);
+        Epoch::recordSent(lastSeqNrInBatch);
+
+        // Continue where we were when all packets requested by a selective NACK were resend
+        if (selectiveRepeatRemaining > 0)
+        {
+            selectiveRepeatRemaining -= batchCount;
+            if (selectiveRepeatRemaining == 0)
+                indexAfterBatch = bufferIndexSerialResume;
+        }
 
         // Move the uart buffer index
-        bufferIndexSerialSend += buffer[bufferIndexSerialSend];
+        bufferIndexSerialSend = indexAfterBatch;
 
         // When we didn't receive an ACK for some time we must resend packets
-        uint16_t dist = 0;
-        if (bufferIndexSerialSend > bufferIndexAcked)
-            dist = bufferIndexSerialSend - bufferIndexAcked;
-        else if (bufferIndexSerialSend < bufferIndexAcked)
-            dist = sizeof(buffer) - bufferIndexAcked + bufferIndexSerialSend;
-
-        if (dist > RETRANSMIT_THRESHOLD)
+        if (bufferDistance(bufferIndexAcked, bufferIndexSerialSend) > FlowControl::getRetransmitThreshold())
+        {
             bufferIndexSerialSend = bufferIndexAcked;
+            selectiveRepeatRemaining = 0;
+            Trace::record(TraceEvent::Retransmit, 0);
+        }
+
+        // The records that were released in throughput mode have all been send
+        if (bufferSkipUnusedEnd(bufferIndexSerialSend, bufferIndexRadio) == bufferIndexRadio)
+            batchReleased = false;
+
+        bufferIndexSerialEncoded = bufferIndexSerialSend;
+        uartTxBufferLens[uartTxBufferFill] = packet.length;
+        uartTxBufferStates[uartTxBufferFill] = TX_BUFFER_QUEUED;
+        uartTxBufferFill = (uartTxBufferFill + 1) % SERIAL_TX_BUFFER_COUNT;
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+    SNIFFER_RAM_FUNCTION void SerialSend::encodePacket(uint8_t slot, bool survey, bool decrypt, bool hash, bool encrypt, bool ackRequested)
+    {
+        // Find out how many of the following packets can be send together with this one.
+        // Blocks of RSSI samples are always send on their own, they are already large enough.
+        // Secured frames are decrypted right before they are encoded, while the uDMA is still sending the previous buffer.
+        // The chain of hashes covers the records as they are send, so it is extended after decrypting them.
+        if (decrypt)
+            Decryption::decryptRecord(bufferIndexSerialSend);
+        if (hash)
+            Integrity::hashRecord(bufferIndexSerialSend);
+
+        uint16_t lastIndexInBatch = bufferIndexSerialSend;
+        uint16_t indexAfterBatch = bufferIndexSerialSend + buffer[bufferIndexSerialSend];
+        uint8_t batchLength = buffer[bufferIndexSerialSend];
+        uint8_t batchCount = 1;
+        while (!survey
+            && (indexAfterBatch != bufferIndexRadio)
+            && (buffer[indexAfterBatch] != END_OF_BUFFER_BYTE)
+            && (buffer[indexAfterBatch] >= CC2538_RF_MIN_PACKET_LEN + BUFFER_EXTRA_BYTES)
+            && (batchLength + buffer[indexAfterBatch] <= SERIAL_BATCH_MAX_DATA_LEN)
+            && bufferRecordFits(indexAfterBatch, buffer[indexAfterBatch])
+            && ((selectiveRepeatRemaining == 0) || (batchCount < selectiveRepeatRemaining)))
+        {
+            if (decrypt)
+                Decryption::decryptRecord(indexAfterBatch);
+            if (hash)
+                Integrity::hashRecord(indexAfterBatch);
+
+            batchLength += buffer[indexAfterBatch];
+            lastIndexInBatch = indexAfterBatch;
+            indexAfterBatch += buffer[indexAfterBatch];
+            batchCount++;
+        }
+
+        // Fill the slot, the uDMA will send it over the UART when the previous packet is finished.
+        // A single packet is send without its length byte, in a batch the length bytes are needed to split the packets again.
+        uartTxBuffer = uartTxBuffers[slot];
+        const uint8_t typeFlags = ackRequested ? ACK_REQUESTED : 0;
+        uint8_t dataType;
+        if (survey)
+            dataType = SerialDataType::Survey | typeFlags;
+        else if (batchCount == 1)
+            dataType = SerialDataType::Packet | typeFlags;
+        else
+            dataType = SerialDataType::PacketBatch | typeFlags;
+
+        // The records are encrypted into a copy, so that a packet that is encoded again carries the same ciphertext
+        const uint8_t* data = encrypt ? Encryption::encryptRecords(bufferIndexSerialSend, batchLength)
+                                      : &buffer[bufferIndexSerialSend];
+        if (batchCount == 1)
+            encode(dataType, data + 1, batchLength - 1);
+        else
+            encode(dataType, data, batchLength);
+
+        EncodedPacket& packet = encodedPackets[slot];
+        packet.dataType = dataType;
+        packet.crc = uartTxBufferCrc;
+        packet.length = uartTxBufferLen;
+        packet.startIndex = bufferIndexSerialSend;
+        packet.lastIndex = lastIndexInBatch;
+        packet.indexAfter = indexAfterBatch;
+        packet.firstSeqNr = readUint16(buffer, bufferIndexSerialSend + BUFFER_SEQNR_OFFSET);
+        packet.batchLength = batchLength;
+        packet.batchCount = batchCount;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION inline uint8_t SerialSend::findEncodedPacket(uint8_t flags)
+    {
+        // Only a retransmission can start at the first record of a packet that is still in its slot. The records from there on
+        // weren't acknowledged yet, so they are still the same when the sequence number of the first one didn't change.
+        const uint16_t firstSeqNr = readUint16(buffer, bufferIndexSerialSend + BUFFER_SEQNR_OFFSET);
+        for (uint8_t slot = 0; slot < SERIAL_TX_SLOT_COUNT; ++slot)
+        {
+            const EncodedPacket& packet = encodedPackets[slot];
+            if ((packet.length != 0) && (packet.startIndex == bufferIndexSerialSend) && (packet.firstSeqNr == firstSeqNr)
+             && (packet.flags == flags) && ((selectiveRepeatRemaining == 0) || (packet.batchCount <= selectiveRepeatRemaining))
+             && !isSlotQueued(slot))
+            {
+                return slot;
+            }
+        }
+
+        return SERIAL_TX_SLOT_COUNT;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION inline uint8_t SerialSend::freeSlot()
+    {
+        // The packet that was queued the longest time ago is the least likely to be send again
+        uint8_t oldest = SERIAL_TX_SLOT_COUNT;
+        for (uint8_t slot = 0; slot < SERIAL_TX_SLOT_COUNT; ++slot)
+        {
+            if (isSlotQueued(slot))
+                continue;
+
+            if (encodedPackets[slot].length == 0)
+                return slot;
+
+            if ((oldest == SERIAL_TX_SLOT_COUNT) || (encodedPacketUses - encodedPackets[slot].lastUsed
+                                                     > encodedPacketUses - encodedPackets[oldest].lastUsed))
+                oldest = slot;
+        }
+
+        return oldest;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION inline bool SerialSend::isSlotQueued(uint8_t slot)
+    {
+        for (uint8_t i = 0; i < SERIAL_TX_BUFFER_COUNT; ++i)
+        {
+            if ((uartTxBufferLens[i] != 0) && (uartTxBufferSlots[i] == slot))
+                return true;
+        }
+
+        return false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void SerialSend::reset()
+    {
+        for (uint8_t i = 0; i < SERIAL_TX_SLOT_COUNT; ++i)
+            encodedPackets[i].length = 0;
+
+        batchingMode = BATCHING_LATENCY;
+        batchHolding = false;
+        batchReleased = false;
+        txLanes = 1;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool SerialSend::setLanes(uint8_t lanes)
+    {
+        if ((lanes == 0) || (lanes > SERIAL_TX_LANES))
+            return false;
+
+        // The lanes above the new count finish the packet that they are sending, they just don't get a new one.
+        // The adaptive window grows with the next measured round trip, as after a change of the baudrate.
+        txLanes = lanes;
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint8_t SerialSend::getLanes()
+    {
+        return txLanes;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool SerialSend::setBatching(const uint8_t* message)
+    {
+        const uint8_t mode = message[BATCHING_MODE_OFFSET];
+        const uint16_t threshold = (message[BATCHING_THRESHOLD_OFFSET] << 8) | message[BATCHING_THRESHOLD_OFFSET + 1];
+        const uint16_t holdTime = (message[BATCHING_HOLD_TIME_OFFSET] << 8) | message[BATCHING_HOLD_TIME_OFFSET + 1];
+        if ((mode != BATCHING_LATENCY) && (mode != BATCHING_THROUGHPUT))
+            return false;
+        if ((mode == BATCHING_THROUGHPUT) && ((threshold == 0) || (threshold > BATCHING_MAX_THRESHOLD)
+                                           || (holdTime == 0) || (holdTime > BATCHING_MAX_HOLD_TIME)))
+            return false;
+
+        // Records that are being held back are released by the next call to isBatchReady when switching to latency mode
+        batchingMode = mode;
+        batchThreshold = threshold;
+        batchHoldTime = static_cast<uint32_t>(holdTime) * 1000;
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION bool SerialSend::isBatchReady()
+    {
+        // Retransmissions were already held back once, the blocks of samples fill a packet on their own
+        if ((batchingMode == BATCHING_LATENCY) || batchReleased || Survey::isRunning()
+         || (bufferIndexSerialEncoded != bufferIndexSerialSend) || (selectiveRepeatRemaining > 0))
+        {
+            if (batchHolding)
+            {
+                batchHolding = false;
+                Statistics::batchHeld(Radio::getCurrentTime() - batchHoldStart);
+            }
+            return true;
+        }
+
+        const uint32_t now = Radio::getCurrentTime();
+        if (!batchHolding)
+        {
+            batchHolding = true;
+            batchHoldStart = now;
+        }
+
+        if ((bufferDistance(bufferIndexSerialSend, bufferIndexRadio) < batchThreshold) && (now - batchHoldStart < batchHoldTime))
+            return false;
+
+        batchHolding = false;
+        batchReleased = true;
+        Statistics::batchHeld(now - batchHoldStart);
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint32_t SerialSend::getTimeUntilBatchReady()
+    {
+        if (!batchHolding)
+            return TIMEOUT_NONE;
+
+        const uint32_t elapsed = Radio::getCurrentTime() - batchHoldStart;
+        if (elapsed >= batchHoldTime)
+            return 0;
+
+        return (batchHoldTime - elapsed + 999) / 1000;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool SerialSend::isTxBufferAvailable()
+    {
+        return (uartTxBufferLens[uartTxBufferFill] == 0);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void SerialSend::transmit()
+    {
+        // Free the lanes of which the uDMA has handed the whole packet to the transport
+        for (uint8_t lane = 0; lane < SERIAL_TX_LANES; ++lane)
+        {
+            const uint8_t txBuffer = uartTxLaneBuffers[lane];
+            if ((txBuffer == SERIAL_TX_BUFFER_COUNT) || Transport::isLaneTransmitting(lane))
+                continue;
+
+#if SERIAL_FAULT_INJECTION || SNIFFER_NATIVE
+            if (uartTxRepeat[lane])
+            {
+                uartTxRepeat[lane] = false;
+                Transport::transmit(lane, uartTxBuffers[uartTxBufferSlots[txBuffer]], uartTxBufferLens[txBuffer]);
+                continue;
+            }
+#endif
+
+            uartTxBufferStates[txBuffer] = TX_BUFFER_SENT;
+            uartTxLaneBuffers[lane] = SERIAL_TX_BUFFER_COUNT;
+            uartTxLanesBusy--;
+        }
+
+        // A buffer is only freed once the packets before it were send as well, so that a retransmission knows where to resume
+        while ((uartTxBufferLens[uartTxBufferSend] != 0) && (uartTxBufferStates[uartTxBufferSend] == TX_BUFFER_SENT))
+        {
+            uartTxBufferLens[uartTxBufferSend] = 0;
+            uartTxBufferSend = (uartTxBufferSend + 1) % SERIAL_TX_BUFFER_COUNT;
+        }
+
+        // Packets that were encoded before a retransmission was started must not be send anymore
+        if (bufferIndexSerialSend != bufferIndexSerialEncoded)
+        {
+            if (uartTxLanesBusy > 0)
+                return;
+
+            // When resending packets for a selective NACK, the dropped packets have to be send again afterwards
+            if ((selectiveRepeatRemaining > 0) && (bufferIndexSerialResume == bufferIndexSerialEncoded)
+             && (uartTxBufferLens[uartTxBufferSend] != 0))
+            {
+                bufferIndexSerialResume = uartTxBufferStartIndex[uartTxBufferSend];
+            }
+
+            for (uint8_t i = 0; i < SERIAL_TX_BUFFER_COUNT; ++i)
+                uartTxBufferLens[i] = 0;
+
+            uartTxBufferFill = uartTxBufferSend;
+            uartTxBufferStart = uartTxBufferSend;
+            bufferIndexSerialEncoded = bufferIndexSerialSend;
+            FlowControl::cancelMeasurement();
+            return;
+        }
+
+        // Start sending the next packets on the lanes that are free
+        for (uint8_t lane = 0; lane < txLanes; ++lane)
+        {
+            if (uartTxLaneBuffers[lane] != SERIAL_TX_BUFFER_COUNT)
+                continue;
+
+            const uint8_t txBuffer = uartTxBufferStart;
+            if ((uartTxBufferLens[txBuffer] == 0) || (uartTxBufferStates[txBuffer] != TX_BUFFER_QUEUED))
+                break;
+
+            uartTxBufferStart = (uartTxBufferStart + 1) % SERIAL_TX_BUFFER_COUNT;
+
+            // The parity of a complete group goes in front of the next packet, a packet that gets lost is still part of it
+            if (Fec::isGroupComplete())
+                Fec::sendParity();
+
+            const EncodedPacket& packet = encodedPackets[uartTxBufferSlots[txBuffer]];
+            if (packet.batchCount == 1)
+                Fec::packetSent(packet.dataType, packet.startIndex + 1, packet.batchLength - 1, packet.crc);
+            else
+                Fec::packetSent(packet.dataType, packet.startIndex, packet.batchLength, packet.crc);
+
+#if SERIAL_FAULT_INJECTION || SNIFFER_NATIVE
+            if (injectFault(txBuffer, lane))
+            {
+                // Nothing wakes up the serial task for the next buffer, so it is started right away
+                uartTxBufferStates[txBuffer] = TX_BUFFER_SENT;
+                transmit();
+                return;
+            }
+#endif
+            uartTxBufferStates[txBuffer] = TX_BUFFER_SENDING;
+            uartTxLaneBuffers[lane] = txBuffer;
+            uartTxLanesBusy++;
+            Transport::transmit(lane, uartTxBuffers[uartTxBufferSlots[txBuffer]], uartTxBufferLens[txBuffer]);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#if SERIAL_FAULT_INJECTION || SNIFFER_NATIVE
+    bool SerialSend::injectFault(uint8_t txBuffer, uint8_t lane)
+    {
+        serialFaultRandom ^= serialFaultRandom << 13;
+        serialFaultRandom ^= serialFaultRandom >> 17;
+        serialFaultRandom ^= serialFaultRandom << 5;
+        if (serialFaultRandom % 10000 >= serialFaultRate)
+            return false;
+
+        // The flags at both ends are left intact, the host has to notice the damage from the CRC or the sequence numbers
+        const uint32_t choice = serialFaultRandom / 10000;
+        if (choice % 3 == 0)
+        {
+            const uint32_t span = uartTxBufferLens[txBuffer] - 2;
+            uartTxBuffers[uartTxBufferSlots[txBuffer]][1 + (choice / 3) % span] ^= 1 << ((choice / 3 / span) % 8);
+            encodedPackets[uartTxBufferSlots[txBuffer]].length = 0; // The damage must not be send again
+            serialFaults.corrupted++;
+        }
+        else if (choice % 3 == 1)
+        {
+            serialFaults.dropped++;
+            return true;
+        }
+        else
+        {
+            uartTxRepeat[lane] = true;
+            serialFaults.duplicated++;
+        }
+
+        return false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+#endif
+
     void SerialSend::sendReadyPacket()
     {
-        uint16_t crc = CRC_INIT;
-        crc = crcCalculationStep(SerialDataType::Ready, crc);
-        crc = crcCalculationStep(2, crc); // length = 2 (our crc bytes)
+        uint32_t capabilities = CAPABILITY_HOPPING | CAPABILITY_SURVEY
+                              | CAPABILITY_STATS | CAPABILITY_FLASH_LOG | CAPABILITY_DECRYPTION | CAPABILITY_INTEGRITY
+                              | CAPABILITY_SYNC
+                              | CAPABILITY_RESUME | CAPABILITY_SET_CHANNEL | CAPABILITY_COBS
+                              | CAPABILITY_EPOCH | CAPABILITY_RECORD_INDEX
+                              | CAPABILITY_RECOVERY
+                              | CAPABILITY_INJECT
+                              | CAPABILITY_TELEMETRY
+                              | CAPABILITY_CUMULATIVE_ACK;
+        if (CAPTURE_FILTER)
+            capabilities |= CAPABILITY_FILTER | CAPABILITY_SNAP_LENGTH | CAPABILITY_OVERFLOW_POLICY | CAPABILITY_FCS_FILTER
+                          | CAPABILITY_ADAPTIVE_OVERFLOW;
+        if (CAPTURE_RECORD_CODING)
+            capabilities |= CAPABILITY_DUPLICATES | CAPABILITY_COMPRESSION | CAPABILITY_DESCRIPTOR;
+        if (CAPTURE_MODES)
+            capabilities |= CAPABILITY_SUMMARY | CAPABILITY_TRIGGER | CAPABILITY_TSCH;
+        if (Transport::getMaxBaudrate() > Transport::getDefaultBaudrate())
+            capabilities |= CAPABILITY_BAUDRATE;
+        if (SNIFFER_ETHERNET)
+            capabilities |= CAPABILITY_ZEP;
+        if (SERIAL_HARDWARE_CRC)
+            capabilities |= CAPABILITY_HARDWARE_CRC;
+        if (PROFILING)
+            capabilities |= CAPABILITY_PROFILING;
+        if (BUFFER_ALIGNED_RECORDS)
+            capabilities |= CAPABILITY_ALIGNED_RECORDS;
+
+        uint32_t moreCapabilities = CAPABILITY2_CONTROL | CAPABILITY2_ACK_REQUEST | CAPABILITY2_BATCHING
+                                  | CAPABILITY2_PAUSE | CAPABILITY2_AUTOSTART | CAPABILITY2_ADAPTIVE_HOP | CAPABILITY2_PPS
+                                  | CAPABILITY2_TIMEBASE | CAPABILITY2_FEC | CAPABILITY2_IDENTIFY
+                                  | CAPABILITY2_ENCRYPTION;
+        if (CAPTURE_FILTER)
+            moreCapabilities |= CAPABILITY2_FILTER_PROGRAM;
+        if (CAPTURE_MODES)
+            moreCapabilities |= CAPABILITY2_SUPERFRAME;
+        if (SERIAL_TX_LANES > 1)
+            moreCapabilities |= CAPABILITY2_LANES;
+        if (TRACE_RECORDER)
+            moreCapabilities |= CAPABILITY2_TRACE;
+
+        // Tell the host which window size and ACK interval are being used and what this firmware can do
+        uint8_t data[READY_MESSAGE_LENGTH - 2];
+        writeUint16(data, READY_WINDOW_OFFSET - 2, FlowControl::getRetransmitThreshold());
+        writeUint16(data, READY_ACK_INTERVAL_OFFSET - 2, FlowControl::getAckInterval());
+        data[READY_VERSION_OFFSET - 2] = READY_PROTOCOL_VERSION;
+        writeUint32(data, READY_CAPABILITIES_OFFSET - 2, capabilities);
+        writeUint16(data, READY_BUFFER_SIZE_OFFSET - 2, BUFFER_LEN);
+        writeUint32(data, READY_MAX_BAUDRATE_OFFSET - 2, Transport::getMaxBaudrate());
+        writeUint32(data, READY_TICK_RATE_OFFSET - 2, TIMESTAMP_TICK_RATE);
+        writeUint32(data, READY_EPOCH_OFFSET - 2, Epoch::getId());
+        writeUint32(data, READY_MORE_CAPABILITIES_OFFSET - 2, moreCapabilities);
+        sendMessage(SerialDataType::Ready, data, sizeof(data));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void SerialSend::sendResumePacket(bool resumed)
+    {
+        uint8_t data[RESUME_ANSWER_LENGTH - 2];
+        data[0] = resumed ? 1 : 0;
+        writeUint16(data, 1, FlowControl::getRetransmitThreshold());
+        writeUint16(data, 3, FlowControl::getAckInterval());
+        sendMessage(SerialDataType::Resume, data, sizeof(data));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void SerialSend::sendIdentifyPacket()
+    {
+        uint8_t data[IDENTIFY_ANSWER_LENGTH - 2];
+        board.getEUI48(data + IDENTIFY_EUI_OFFSET - 2);
+        sendMessage(SerialDataType::Identify, data, sizeof(data));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool SerialSend::setFraming(uint8_t framing)
+    {
+        if ((framing != FRAMING_HDLC) && (framing != FRAMING_COBS))
+            return false;
 
-        UARTCharPut(uart.getBase(), HDLC_FLAG);
-        UARTCharPut(uart.getBase(), SerialDataType::Ready);
-        UARTCharPut(uart.getBase(), 2); // length = 2 (our crc bytes)
-        UARTCharPut(uart.getBase(), (crc >> 8) & 0xFF);
-        UARTCharPut(uart.getBase(), (crc >> 0) & 0xFF);
-        UARTCharPut(uart.getBase(), HDLC_FLAG);
+        // Both framings start and end with the flag, so the first byte of the TX buffers stays the same
+        serialFraming = framing;
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void SerialSend::sendMessage(uint8_t dataType, const uint8_t* data, uint8_t dataLength)
+    {
+        // Don't interleave the bytes with a packet that is still being send by the uDMA
+        while (Transport::isTransmitting())
+            ;
+
+        const uint8_t header[2] = {dataType, static_cast<uint8_t>(dataLength + 2)}; // length includes our crc bytes
+        const uint16_t crc = crcCalculate(data, dataLength, crcCalculate(header, sizeof(header), CRC_INIT));
+
+        Transport::writeByte(HDLC_FLAG);
+        sendByteEscaped(dataType);
+        sendByteEscaped(dataLength + 2);
+        for (uint8_t i = 0; i < dataLength; ++i)
+            sendByteEscaped(data[i]);
+        sendByteEscaped((crc >> 8) & 0xFF);
+        sendByteEscaped((crc >> 0) & 0xFF);
+        Transport::writeByte(HDLC_FLAG);
+        Transport::flush();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void SerialSend::sendByteEscaped(uint8_t byte)
+    {
+        if (byte == HDLC_FLAG || byte == HDLC_ESCAPE)
+        {
+            Transport::writeByte(HDLC_ESCAPE);
+            Transport::writeByte(byte ^ HDLC_ESCAPE_MASK);
+        }
+        else
+            Transport::writeByte(byte);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION inline void SerialSend::encode(uint8_t dataType, const uint8_t* data, uint8_t dataLength)
+    {
+        if (serialFraming == FRAMING_COBS)
+            cobsEncode(dataType, data, dataLength);
+        else
+            hdlcEncode(dataType, data, dataLength);
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    inline void SerialSend::hdlcEncode()
+    SNIFFER_RAM_FUNCTION inline void SerialSend::hdlcEncode(uint8_t dataType, const uint8_t* data, uint8_t dataLength)
     {
-        uartTxBufferLen = 2; // The first two bytes are always the same (hdlc flag and type) and are already in the buffer
+        const uint32_t startCycles = Profiling::start();
 
-        // Add the lenght of the data (size of buffer block + 2 byte serial crc)
-        // The length byte from the buffer also contained itself but is not copied which is why we need to subtract 1 byte
-        uint8_t dataLength = buffer[bufferIndexSerialSend] - 1;
+        uartTxBufferLen = 2; // The first byte is always the hdlc flag and is already in the buffer
+        uartTxBuffer[1] = dataType;
+
+        // Add the lenght of the data (size of the data + 2 byte serial crc)
         addByteToHdlc(dataLength + 2);
 
-        // Escape the data and calculate the CRC (first byte from buffer is skipped as this contained the packet length)
-        uint16_t crc = CRC_INIT;
-        crc = crcCalculationStep(uartTxBuffer[1], crc);
-        crc = crcCalculationStep(dataLength + 2, crc);
+        const uint8_t header[2] = {dataType, static_cast<uint8_t>(dataLength + 2)};
+#if SERIAL_HARDWARE_CRC
+        // The CRC engine is fed one register write per byte, it is given the whole record in one go before escaping
+        uint16_t crc = crcCalculate(data, dataLength, crcCalculate(header, sizeof(header), CRC_INIT));
+#else
+        // The CRC is calculated while escaping, so every byte of the record is only read once
+        uint16_t crc = crcCalculate(header, sizeof(header), CRC_INIT);
+#endif
 
-        for (uint8_t i = 1; i <= dataLength; ++i)
+        // Escape the data. Most bytes don't need escaping, so 4 bytes are checked at once and copied as a whole when
+        // none of them is special. Only a word that contains a special byte is escaped byte by byte with the table.
+        uint8_t* out = &uartTxBuffer[uartTxBufferLen];
+        uint8_t i = 0;
+        for (; i + 4 <= dataLength; i += 4)
         {
-            uint8_t& byte = buffer[bufferIndexSerialSend + i];
+            const uint32_t word = *reinterpret_cast<const unaligned_uint32_t*>(&data[i]);
+#if !SERIAL_HARDWARE_CRC
+            crc = crcCalculationStep(data[i], crc);
+            crc = crcCalculationStep(data[i + 1], crc);
+            crc = crcCalculationStep(data[i + 2], crc);
+            crc = crcCalculationStep(data[i + 3], crc);
+#endif
+            if (hdlcWordNeedsEscaping(word))
+            {
+                out = hdlcEscapeByte(out, data[i]);
+                out = hdlcEscapeByte(out, data[i + 1]);
+                out = hdlcEscapeByte(out, data[i + 2]);
+                out = hdlcEscapeByte(out, data[i + 3]);
+            }
+            else
+            {
+                *reinterpret_cast<unaligned_uint32_t*>(out) = word;
+                out += 4;
+            }
+        }
 
-            addByteToHdlc(byte);
-            crc = crcCalculationStep(byte, crc);
+        for (; i < dataLength; ++i)
+        {
+#if !SERIAL_HARDWARE_CRC
+            crc = crcCalculationStep(data[i], crc);
+#endif
+            out = hdlcEscapeByte(out, data[i]);
         }
 
+        uartTxBufferLen = out - uartTxBuffer;
+
         // Escape the CRC bytes
+        uartTxBufferCrc = crc;
         addByteToHdlc((crc >> 8) & 0xFF);
         addByteToHdlc(crc & 0xFF);
 
         // Add the ending HDLC_FLAG byte
         uartTxBuffer[uartTxBufferLen++] = HDLC_FLAG;
+
+        Profiling::stop(ProfilingSection::HdlcEncode, startCycles);
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    inline void SerialSend::addByteToHdlc(uint8_t byte)
+    SNIFFER_RAM_FUNCTION inline void SerialSend::addByteToHdlc(uint8_t byte)
     {
-        if (byte == HDLC_FLAG || byte == HDLC_ESCAPE)
+        // The byte behind the escaped one may be overwritten, which is always followed by another byte or the end flag
+        uartTxBufferLen = hdlcEscapeByte(&uartTxBuffer[uartTxBufferLen], byte) - uartTxBuffer;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION inline void SerialSend::cobsEncode(uint8_t dataType, const uint8_t* data, uint8_t dataLength)
+    {
+        const uint32_t startCycles = Profiling::start();
+
+        // The byte after the flag is the code of the first block, it is filled in when the block ends
+        uartTxBufferLen = 2;
+        cobsCodeIndex = 1;
+        addByteToCobs(dataType);
+        addByteToCobs(dataLength + 2);
+
+        const uint8_t header[2] = {dataType, static_cast<uint8_t>(dataLength + 2)};
+        const uint16_t crc = crcCalculate(data, dataLength, crcCalculate(header, sizeof(header), CRC_INIT));
+
+        // As with HDLC, words without a zero are copied as a whole as long as they don't fill the block
+        uint8_t i = 0;
+        for (; i + 4 <= dataLength; i += 4)
         {
-            uartTxBuffer[uartTxBufferLen++] = HDLC_ESCAPE;
-            uartTxBuffer[uartTxBufferLen++] = byte ^ HDLC_ESCAPE_MASK;
+            const uint32_t word = *reinterpret_cast<const unaligned_uint32_t*>(&data[i]);
+            if (cobsWordContainsZero(word) || (uartTxBufferLen - cobsCodeIndex + 4 >= COBS_MAX_BLOCK_LEN))
+            {
+                for (uint8_t j = 0; j < 4; ++j)
+                    addByteToCobs(data[i + j]);
+            }
+            else
+            {
+                *reinterpret_cast<unaligned_uint32_t*>(&uartTxBuffer[uartTxBufferLen]) = word ^ (COBS_XOR_MASK * 0x01010101);
+                uartTxBufferLen += 4;
+            }
+        }
+
+        for (; i < dataLength; ++i)
+            addByteToCobs(data[i]);
+
+        uartTxBufferCrc = crc;
+        addByteToCobs((crc >> 8) & 0xFF);
+        addByteToCobs(crc & 0xFF);
+
+        // Close the last block and add the ending flag
+        uartTxBuffer[cobsCodeIndex] = (uartTxBufferLen - cobsCodeIndex) ^ COBS_XOR_MASK;
+        uartTxBuffer[uartTxBufferLen++] = HDLC_FLAG;
+
+        Profiling::stop(ProfilingSection::HdlcEncode, startCycles);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION inline void SerialSend::addByteToCobs(uint8_t byte)
+    {
+        // A zero ends the block, the code byte tells how far away it was. A block without zero ends after 254 bytes.
+        if (byte == 0)
+        {
+            uartTxBuffer[cobsCodeIndex] = (uartTxBufferLen - cobsCodeIndex) ^ COBS_XOR_MASK;
+            cobsCodeIndex = uartTxBufferLen++;
         }
         else
-            uartTxBuffer[uartTxBufferLen++] = byte;
+        {
+            uartTxBuffer[uartTxBufferLen++] = byte ^ COBS_XOR_MASK;
+            if (uartTxBufferLen - cobsCodeIndex == COBS_MAX_BLOCK_LEN)
+            {
+                uartTxBuffer[cobsCodeIndex] = COBS_MAX_BLOCK_LEN ^ COBS_XOR_MASK;
+                cobsCodeIndex = uartTxBufferLen++;
+            }
+        }
     }
 }
@@ -12,27 +12,110 @@
 
 namespace Sniffer
 {
+#if SERIAL_FAULT_INJECTION || SNIFFER_NATIVE
+    // Packets that transmit damaged on purpose, the native build always has the option and starts with the rate at 0
+    struct SerialFaultCounters
+    {
+        uint32_t corrupted;  // A bit was flipped in one of the encoded bytes
+        uint32_t dropped;    // The packet was never send
+        uint32_t duplicated; // The packet was send twice
+    };
+
+    extern uint16_t serialFaultRate; // Packets out of every 10000 that are affected, SERIAL_FAULT_RATE by default
+    extern SerialFaultCounters serialFaults;
+#endif
+
     class SerialSend
     {
+        friend class Benchmark; // Measures the private functions in benchmark/main.cpp
+
     public:
-        // Set the first two bytes of the TX buffer which are always the same
+        // Set the first byte of the TX buffers which is always the same and send the READY message
         static void initialize();
 
-        // Send one packet to the host
+        // Encode one packet, or a batch of small packets, in a free TX buffer. A retransmission queues the packet that was
+        // encoded the previous time when its slot wasn't needed for another one yet.
         static void send();
 
+        // Forget the encoded packets and go back to latency mode, the records in the buffer start over after a reset
+        static void reset();
+
+        // Spread the records over this many lanes of the transport with the LANES message, returns false for invalid values
+        static bool setLanes(uint8_t lanes);
+
+        // Amount of lanes over which the records are send at the same time
+        static uint8_t getLanes();
+
+        // Choose between latency and throughput mode with the BATCHING message, returns false for invalid values
+        static bool setBatching(const uint8_t* message);
+
+        // Check whether the records that are waiting may be send now, or whether throughput mode still holds them back
+        static bool isBatchReady();
+
+        // Milliseconds until isBatchReady releases the records that it holds back, or TIMEOUT_NONE when it isn't holding any.
+        // Only valid right after isBatchReady returned false.
+        static uint32_t getTimeUntilBatchReady();
+
+        // Check whether there is a free TX buffer in which a packet can be encoded
+        static bool isTxBufferAvailable();
+
+        // Free the TX buffers of the packets that the transport finished and give the next encoded packets to the free lanes
+        static void transmit();
+
         // Signal to the host that a reset has happened (either the host requested this or the program was just started)
         static void sendReadyPacket();
 
+        // Answer a RESUME message from the host, telling whether the records after the one that it requested are being send
+        static void sendResumePacket(bool resumed);
+
+        // Answer an IDENTIFY message from the host with the EUI-48 of the board
+        static void sendIdentifyPacket();
+
+        // Choose between HDLC and COBS framing for the records (FRAMING_HDLC or FRAMING_COBS), returns false for other values
+        static bool setFraming(uint8_t framing);
+
+        // Send a message directly over the transport, waiting until it has finished with the current packet.
+        // These messages are always HDLC framed, so that the host can find a READY message in any framing.
+        static void sendMessage(uint8_t dataType, const uint8_t* data, uint8_t dataLength);
+
     private:
-        // Put the packet in an HDLC frame
-        static void hdlcEncode();
+        // Encode the records from bufferIndexSerialSend on in the slot and remember which records the packet contains
+        static void encodePacket(uint8_t slot, bool survey, bool decrypt, bool hash, bool encrypt, bool ackRequested);
+
+        // Find the slot with the encoded packet that starts at bufferIndexSerialSend, returns SERIAL_TX_SLOT_COUNT when there is none
+        static uint8_t findEncodedPacket(uint8_t flags);
+
+        // Find a slot that isn't queued for the transport, preferably one without a packet, otherwise the least recently used one
+        static uint8_t freeSlot();
+
+        // Check whether one of the TX buffers is waiting to send the packet of the slot or is sending it
+        static bool isSlotQueued(uint8_t slot);
+
+        // Put the records (from the buffer, or their encrypted copy) in a frame of the framing that the host asked for
+        static void encode(uint8_t dataType, const uint8_t* data, uint8_t dataLength);
+
+        // Put the data in an HDLC frame
+        static void hdlcEncode(uint8_t dataType, const uint8_t* data, uint8_t dataLength);
 
         // Escape the byte when needed (if it equals the start/end delimiter or the escape octet)
         static void addByteToHdlc(uint8_t byte);
 
+        // Put the data in a COBS frame, between the same flags as HDLC
+        static void cobsEncode(uint8_t dataType, const uint8_t* data, uint8_t dataLength);
+
+        // Add the byte to the current COBS block, ending the block when the byte is zero or the block is full
+        static void addByteToCobs(uint8_t byte);
+
+        // Give the byte to the transport, escaping it when needed
+        static void sendByteEscaped(uint8_t byte);
+
         // Calculate the serial CRC of the data
         static uint16_t calculateCRC(uint8_t* beginAddress, uint8_t length);
+
+#if SERIAL_FAULT_INJECTION || SNIFFER_NATIVE
+        // Decide whether the packet in the buffer gets damaged before it is send, returns true when it is dropped
+        static bool injectFault(uint8_t txBuffer, uint8_t lane);
+#endif
     };
 }
 
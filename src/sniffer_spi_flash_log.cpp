@@ -0,0 +1,348 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_spi_flash_log.hpp"
+
+#if SNIFFER_SPI_FLASH_LOG
+
+#include "sniffer_serial_send.hpp"
+
+#include "openmote-cc2538.h"
+#include "SpiFlash.h"
+
+namespace Sniffer
+{
+    SpiFlash spiFlash(spi);
+
+    uint32_t spiFlashLogSectors = 0; // Stays 0 when no SPI flash was found
+    uint32_t spiFlashLogSector = 0; // Sector that is being written
+    uint32_t spiFlashLogCounter = SPI_FLASH_LOG_NO_COUNTER; // Counter of the sector that is being written, the next one gets 0 when the log is empty
+    uint32_t spiFlashLogWriteAddress = 0; // A sector boundary when the next sector has to be started first
+    bool     spiFlashLogEraseAhead = false; // Set when the sector after the one that is being written still has to be erased
+    bool     spiFlashLogAckPending = false; // Set while the records up to the ack index are being programmed
+    uint16_t spiFlashLogAckIndex = 0;
+
+    // The records are gathered in a page before it is programmed, while dumping one page is read while the other is send
+    uint8_t spiFlashLogPage[2][SPI_FLASH_PAGE_SIZE];
+    uint8_t spiFlashLogHeader[SPI_FLASH_LOG_HEADER_LEN];
+    uint8_t spiFlashLogChunk[FLASH_LOG_DUMP_CHUNK_LEN];
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline uint32_t spiFlashLogSectorAddress(uint32_t sector)
+    {
+        return sector * SPI_FLASH_SECTOR_SIZE;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Anything else at the position of a record is what was being programmed when the OpenMote was reset
+    inline bool spiFlashLogValidRecord(const uint8_t* page, uint16_t pos, uint16_t end)
+    {
+        const uint8_t length = page[pos];
+        return (length >= BUFFER_EXTRA_BYTES) && (length <= SERIAL_BATCH_MAX_DATA_LEN) && (pos + length <= end);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Erasing the whole flash takes far longer than the watchdog allows
+    void spiFlashLogWait()
+    {
+        while (!spiFlash.isReady())
+            watchdog.walk();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void spiFlashLogRead(uint32_t address, uint8_t* data, uint32_t length)
+    {
+        spiFlashLogWait();
+        spiFlash.read(address, data, length);
+        spiFlashLogWait();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Only the sectors that were written since the ring last came by them belong to the log
+    bool spiFlashLogValidSector(uint32_t counter)
+    {
+        return (spiFlashLogCounter != SPI_FLASH_LOG_NO_COUNTER) && (counter <= spiFlashLogCounter)
+            && (spiFlashLogCounter - counter < spiFlashLogSectors);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool SpiFlashLog::initialize()
+    {
+        // The pages move over the SPI bus with the uDMA, the radio already enabled it with the control table
+        spi.enable(SPI_MODE, SPI_PROTOCOL, SPI_DATAWIDTH, SPI_BAUDRATE);
+        spi.enableDma();
+        spi.enableInterrupts();
+
+        if (!spiFlash.init() || (spiFlash.getSize() / SPI_FLASH_SECTOR_SIZE < SPI_FLASH_LOG_MIN_SECTORS))
+            return false;
+
+        spiFlashLogSectors = spiFlash.getSize() / SPI_FLASH_SECTOR_SIZE;
+
+        // The newest sector has the highest counter, erased sectors have none
+        spiFlashLogSector = spiFlashLogSectors - 1;
+        spiFlashLogCounter = SPI_FLASH_LOG_NO_COUNTER;
+        for (uint32_t sector = 0; sector < spiFlashLogSectors; ++sector)
+        {
+            spiFlashLogRead(spiFlashLogSectorAddress(sector), spiFlashLogHeader, SPI_FLASH_LOG_HEADER_LEN);
+
+            const uint32_t counter = readUint32(spiFlashLogHeader, 0);
+            if ((counter != SPI_FLASH_LOG_NO_COUNTER)
+             && ((spiFlashLogCounter == SPI_FLASH_LOG_NO_COUNTER) || (counter > spiFlashLogCounter)))
+            {
+                spiFlashLogSector = sector;
+                spiFlashLogCounter = counter;
+            }
+        }
+
+        if (spiFlashLogCounter == SPI_FLASH_LOG_NO_COUNTER)
+        {
+            // The log is empty, it starts in the first sector after erasing it
+            spiFlashLogWriteAddress = spiFlash.getSize();
+            spiFlashLogEraseAhead = true;
+        }
+        else
+        {
+            findEnd();
+
+            // The OpenMote might have been reset before the next sector was erased
+            spiFlashLogRead(spiFlashLogSectorAddress((spiFlashLogSector + 1) % spiFlashLogSectors),
+                            spiFlashLogHeader, SPI_FLASH_LOG_HEADER_LEN);
+            spiFlashLogEraseAhead = (readUint32(spiFlashLogHeader, 0) != SPI_FLASH_LOG_NO_COUNTER);
+        }
+
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool SpiFlashLog::isAvailable()
+    {
+        return spiFlashLogSectors > 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool SpiFlashLog::spill()
+    {
+        if (!spiFlash.isReady())
+            return false;
+
+        // The records of the page that was programmed last are safe now, so they are treated as if the host acknowledged them
+        if (spiFlashLogAckPending)
+        {
+            bufferIndexAcked = spiFlashLogAckIndex;
+            spiFlashLogAckPending = false;
+        }
+
+        if (spiFlashLogEraseAhead)
+        {
+            spiFlash.eraseSector(spiFlashLogSectorAddress((spiFlashLogSector + 1) % spiFlashLogSectors));
+            spiFlashLogEraseAhead = false;
+            return true;
+        }
+
+        if (spiFlashLogWriteAddress % SPI_FLASH_SECTOR_SIZE == 0)
+        {
+            startSector();
+            return true;
+        }
+
+        // Take as many records as fit in the rest of the page
+        const uint16_t space = SPI_FLASH_PAGE_SIZE - (spiFlashLogWriteAddress % SPI_FLASH_PAGE_SIZE);
+        uint8_t* page = spiFlashLogPage[0];
+        uint16_t length = 0;
+        while (bufferIndexSerialSend != bufferIndexRadio)
+        {
+            // Start at the beginning of the buffer when we have reached the end
+            const uint16_t nextIndex = bufferSkipUnusedEnd(bufferIndexSerialSend, bufferIndexRadio);
+            if (nextIndex != bufferIndexSerialSend)
+            {
+                bufferIndexSerialSend = nextIndex;
+                continue;
+            }
+
+            const uint8_t recordLength = buffer[bufferIndexSerialSend];
+            if (length + recordLength > space)
+                break;
+
+            for (uint8_t i = 0; i < recordLength; ++i)
+                page[length + i] = buffer[bufferIndexSerialSend + i];
+
+            length += recordLength;
+            spiFlashLogAckIndex = bufferIndexSerialSend;
+            bufferIndexSerialSend += recordLength;
+        }
+
+        if (length == 0)
+        {
+            if (bufferIndexSerialSend == bufferIndexRadio)
+                return false;
+
+            // The next record doesn't fit in this page anymore, the rest of it stays erased
+            spiFlashLogWriteAddress += space;
+            return true;
+        }
+
+        spiFlash.program(spiFlashLogWriteAddress, page, length);
+        spiFlashLogWriteAddress += length;
+        spiFlashLogAckPending = true;
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool SpiFlashLog::isBusy()
+    {
+        return spiFlashLogAckPending || spiFlashLogEraseAhead || !spiFlash.isReady();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void SpiFlashLog::finish()
+    {
+        if (!spiFlashLogAckPending)
+            return;
+
+        spiFlashLogWait();
+        bufferIndexAcked = spiFlashLogAckIndex;
+        spiFlashLogAckPending = false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void SpiFlashLog::dump()
+    {
+        finish();
+
+        // The oldest sector comes after the one that is being written, which is skipped when it was erased ahead.
+        // Multiple records are send per message, but a record is never split so that a corrupted message only loses whole records.
+        uint8_t chunkLength = 0;
+        for (uint32_t i = 1; i <= spiFlashLogSectors; ++i)
+        {
+            const uint32_t sector = (spiFlashLogSector + i) % spiFlashLogSectors;
+            const uint32_t sectorStart = spiFlashLogSectorAddress(sector);
+            const uint32_t sectorEnd = (sector == spiFlashLogSector) ? spiFlashLogWriteAddress : sectorStart + SPI_FLASH_SECTOR_SIZE;
+
+            uint8_t current = 0;
+            spiFlashLogRead(sectorStart, spiFlashLogPage[current], SPI_FLASH_PAGE_SIZE);
+            if (!spiFlashLogValidSector(readUint32(spiFlashLogPage[current], 0)))
+                continue;
+
+            for (uint32_t pageAddress = sectorStart; pageAddress < sectorEnd; pageAddress += SPI_FLASH_PAGE_SIZE)
+            {
+                // The next page is already read while the records of this one are being send
+                spiFlashLogWait();
+                if (pageAddress + SPI_FLASH_PAGE_SIZE < sectorEnd)
+                    spiFlash.read(pageAddress + SPI_FLASH_PAGE_SIZE, spiFlashLogPage[current ^ 1], SPI_FLASH_PAGE_SIZE);
+
+                const uint8_t* page = spiFlashLogPage[current];
+                const uint16_t end = (sectorEnd - pageAddress < SPI_FLASH_PAGE_SIZE) ? sectorEnd - pageAddress : SPI_FLASH_PAGE_SIZE;
+                uint16_t pos = (pageAddress == sectorStart) ? SPI_FLASH_LOG_HEADER_LEN : 0;
+                while ((pos < end) && (page[pos] != END_OF_BUFFER_BYTE) && spiFlashLogValidRecord(page, pos, end))
+                {
+                    const uint8_t length = page[pos];
+                    if (chunkLength + length > FLASH_LOG_DUMP_CHUNK_LEN)
+                    {
+                        SerialSend::sendMessage(SerialDataType::FlashLog, spiFlashLogChunk, chunkLength);
+                        chunkLength = 0;
+                    }
+
+                    for (uint8_t j = 0; j < length; ++j)
+                        spiFlashLogChunk[chunkLength++] = page[pos + j];
+
+                    // Sending the whole log takes minutes for the largest flash
+                    watchdog.walk();
+
+                    pos += length;
+                }
+
+                current ^= 1;
+            }
+        }
+
+        if (chunkLength > 0)
+            SerialSend::sendMessage(SerialDataType::FlashLog, spiFlashLogChunk, chunkLength);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void SpiFlashLog::erase()
+    {
+        if (!isAvailable())
+            return;
+
+        // Nothing is captured while erasing, like with the internal flash
+        finish();
+        spiFlashLogWait();
+        spiFlash.eraseChip();
+        spiFlashLogWait();
+
+        // The first sector is already erased, so it can be started right away
+        spiFlashLogSector = spiFlashLogSectors - 1;
+        spiFlashLogCounter = SPI_FLASH_LOG_NO_COUNTER;
+        spiFlashLogWriteAddress = spiFlash.getSize();
+        spiFlashLogEraseAhead = false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void SpiFlashLog::startSector()
+    {
+        spiFlashLogSector = (spiFlashLogSector + 1) % spiFlashLogSectors;
+        spiFlashLogCounter++;
+
+        const uint32_t address = spiFlashLogSectorAddress(spiFlashLogSector);
+        writeUint32(spiFlashLogHeader, 0, spiFlashLogCounter);
+        spiFlash.program(address, spiFlashLogHeader, SPI_FLASH_LOG_HEADER_LEN);
+
+        // The sector after it holds the oldest records, which have to make room
+        spiFlashLogWriteAddress = address + SPI_FLASH_LOG_HEADER_LEN;
+        spiFlashLogEraseAhead = true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void SpiFlashLog::findEnd()
+    {
+        const uint32_t sectorStart = spiFlashLogSectorAddress(spiFlashLogSector);
+        const uint32_t sectorEnd = sectorStart + SPI_FLASH_SECTOR_SIZE;
+        uint8_t* page = spiFlashLogPage[0];
+
+        spiFlashLogWriteAddress = sectorStart + SPI_FLASH_LOG_HEADER_LEN;
+        for (uint32_t pageAddress = sectorStart; pageAddress < sectorEnd; pageAddress += SPI_FLASH_PAGE_SIZE)
+        {
+            spiFlashLogRead(pageAddress, page, SPI_FLASH_PAGE_SIZE);
+
+            // An empty page ends the log, the new records continue behind the last one in the page before it
+            uint16_t pos = (pageAddress == sectorStart) ? SPI_FLASH_LOG_HEADER_LEN : 0;
+            if (page[pos] == END_OF_BUFFER_BYTE)
+                return;
+
+            while ((pos < SPI_FLASH_PAGE_SIZE) && (page[pos] != END_OF_BUFFER_BYTE))
+            {
+                // The rest of the sector isn't used after a page that was being programmed during a reset
+                if (!spiFlashLogValidRecord(page, pos, SPI_FLASH_PAGE_SIZE))
+                {
+                    spiFlashLogWriteAddress = sectorEnd;
+                    return;
+                }
+
+                pos += page[pos];
+            }
+
+            spiFlashLogWriteAddress = pageAddress + pos;
+        }
+    }
+}
+
+#endif // SNIFFER_SPI_FLASH_LOG
@@ -0,0 +1,59 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_SPI_FLASH_LOG_HPP
+#define SNIFFER_SPI_FLASH_LOG_HPP
+
+#include "sniffer_global.hpp"
+
+// Every sector starts with a counter that is one higher than in the sector before it, the records follow it.
+// A record never crosses a page, the rest of a page where the next record didn't fit stays erased.
+#define SPI_FLASH_LOG_HEADER_LEN        4
+#define SPI_FLASH_LOG_MIN_SECTORS       3   // The sector that is written, the one that is erased ahead of it and one to keep
+#define SPI_FLASH_LOG_NO_COUNTER        0xFFFFFFFF
+
+namespace Sniffer
+{
+    // Flash log in a SPI NOR flash on the SPI bus, used instead of the internal flash when SNIFFER_SPI_FLASH_LOG is set.
+    // The sectors are used as a ring, the sector after the one that is being written is erased ahead of time, so the
+    // oldest records are overwritten when the flash is full and every sector is erased equally often.
+    // The page programs run in the background, the records are only acknowledged once they are in the flash.
+    class SpiFlashLog
+    {
+    public:
+        // Find the newest sector and the end of the log in it, returns false when no SPI flash answered
+        static bool initialize();
+
+        // Check whether a SPI flash was found
+        static bool isAvailable();
+
+        // Continue with the page program or the erase that is in progress, or start programming the oldest unsend
+        // records from the buffer, returns false when there was nothing to do or the flash is still busy
+        static bool spill();
+
+        // Check whether the flash is still busy with records that were spilled, which is polled every millisecond
+        static bool isBusy();
+
+        // Wait until the records that are being programmed are in the flash and acknowledge them
+        static void finish();
+
+        // Send all records from the oldest to the newest sector
+        static void dump();
+
+        // Erase the whole flash, which takes from a few seconds up to minutes on the largest parts
+        static void erase();
+
+    private:
+        // Start using the next sector of the ring by writing its counter, the sector after it is erased next
+        static void startSector();
+
+        // Find the end of the records in the sector that was written last
+        static void findEnd();
+    };
+}
+
+#endif // SNIFFER_SPI_FLASH_LOG_HPP
@@ -0,0 +1,278 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_spi_slave.hpp"
+#include "sniffer_serial.hpp"
+#include "sniffer_statistics.hpp"
+
+#include "libcc2538_sys_ctrl.h"
+#include "openmote-cc2538.h"
+
+#define SPI_SLAVE_RX_DMA_CONTROL    (UDMA_SIZE_8 | UDMA_SRC_INC_NONE | UDMA_DST_INC_8 | UDMA_ARB_4)
+#define SPI_SLAVE_TX_DMA_CONTROL    (UDMA_SIZE_8 | UDMA_SRC_INC_8 | UDMA_DST_INC_NONE | UDMA_ARB_4)
+#define SPI_SLAVE_IDLE_DMA_CONTROL  (UDMA_SIZE_8 | UDMA_SRC_INC_NONE | UDMA_DST_INC_NONE | UDMA_ARB_4)
+
+namespace Sniffer
+{
+    // The uDMA sends one TX burst while the other one is being filled, without records it repeats the idle flag instead.
+    // A packet that doesn't fit in the burst continues at the start of the next one, the padding only comes behind the
+    // last packet, so the bytes of both bursts together are the same as on a UART.
+    uint8_t           spiTxBursts[2][SPI_SLAVE_BURST_LEN];
+    uint8_t           spiTxFill = 0;        // TX burst that is being filled
+    uint16_t          spiTxFillLen = 0;
+    const uint8_t     spiTxIdleByte = HDLC_FLAG;
+    const uint8_t*    spiTxPendingData = nullptr;  // Rest of the last packet, which waits for the next burst
+    volatile uint16_t spiTxPendingLen = 0;
+
+    // The uDMA stores one burst of the host while poll copies the other one
+    uint8_t       spiRxBursts[2][SPI_SLAVE_BURST_LEN];
+    uint8_t       spiRxCurrent = 0;         // RX burst in which the uDMA is storing the bytes
+    volatile bool spiRxReady = false;       // The other RX burst wasn't copied yet
+    int16_t       spiRxFrameLen = -1;       // Bytes of the message that is being copied, 0 after an opening flag and -1 between messages
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Copy what fits in the burst that is being filled, returns the amount of bytes that were copied
+    inline uint16_t spiFillBurst(const uint8_t* data, uint16_t length)
+    {
+        const uint16_t copied = (length < SPI_SLAVE_BURST_LEN - spiTxFillLen) ? length : SPI_SLAVE_BURST_LEN - spiTxFillLen;
+        for (uint16_t i = 0; i < copied; ++i)
+            spiTxBursts[spiTxFill][spiTxFillLen + i] = data[i];
+
+        spiTxFillLen += copied;
+        if (spiTxFillLen > 0)
+            GPIOPinWrite(GPIO_DEBUG_AD0_PORT, GPIO_DEBUG_AD0_PIN, GPIO_DEBUG_AD0_PIN);
+
+        return copied;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void SpiSlaveTransport::initialize()
+    {
+        SysCtrlPeripheralEnable(SYS_CTRL_PERIPH_SSI0);
+        SysCtrlPeripheralSleepEnable(SYS_CTRL_PERIPH_SSI0);
+        SSIDisable(SSI0_BASE);
+        SSIClockSourceSet(SSI0_BASE, SSI_CLOCK_SYSTEM);
+
+        // The host drives the clock, the chip select and MOSI, the OpenMote only drives MISO
+        IOCPinConfigPeriphInput(SPI_CLK_BASE, SPI_CLK_PIN, IOC_CLK_SSIIN_SSI0);
+        IOCPinConfigPeriphInput(SPI_nCS_BASE, SPI_nCS_PIN, IOC_SSIFSSIN_SSI0);
+        IOCPinConfigPeriphInput(SPI_MOSI_BASE, SPI_MOSI_PIN, IOC_SSIRXD_SSI0);
+        IOCPinConfigPeriphOutput(SPI_MISO_BASE, SPI_MISO_PIN, IOC_MUX_OUT_SEL_SSI0_TXD);
+        GPIOPinTypeSSI(SPI_CLK_BASE, SPI_CLK_PIN);
+        GPIOPinTypeSSI(SPI_nCS_BASE, SPI_nCS_PIN);
+        GPIOPinTypeSSI(SPI_MOSI_BASE, SPI_MOSI_PIN);
+        GPIOPinTypeSSI(SPI_MISO_BASE, SPI_MISO_PIN);
+
+        SSIConfigSetExpClk(SSI0_BASE, SysCtrlClockGet(), SPI_SLAVE_PROTOCOL, SSI_MODE_SLAVE, SPI_SLAVE_MAX_CLOCK, 8);
+        SSIEnable(SSI0_BASE);
+
+        // The data ready line stays low until there are records
+        GPIOPinTypeGPIOOutput(GPIO_DEBUG_AD0_PORT, GPIO_DEBUG_AD0_PIN);
+        GPIOPinWrite(GPIO_DEBUG_AD0_PORT, GPIO_DEBUG_AD0_PIN, 0);
+
+        // The RX FIFO is only 8 bytes deep, so its channel goes before the others
+        uDMAChannelAssign(UDMA_CH10_SSI0RX);
+        uDMAChannelAssign(UDMA_CH11_SSI0TX);
+        uDMAChannelAttributeDisable(UDMA_SSI_RX_CHANNEL, UDMA_ATTR_ALL);
+        uDMAChannelAttributeDisable(UDMA_SSI_TX_CHANNEL, UDMA_ATTR_ALL);
+        uDMAChannelAttributeEnable(UDMA_SSI_RX_CHANNEL, UDMA_ATTR_HIGH_PRIORITY);
+        uDMAChannelControlSet(UDMA_SSI_RX_CHANNEL | UDMA_PRI_SELECT, SPI_SLAVE_RX_DMA_CONTROL);
+
+        startBurst();
+        SSIDMAEnable(SSI0_BASE, SSI_DMA_TX | SSI_DMA_RX);
+
+        // Besides the end of a burst, only a lost byte needs the processor
+        IntRegister(INT_SSI0, SpiSlaveTransport::interruptHandler);
+        SSIIntEnable(SSI0_BASE, SSI_RXOR);
+        IntPrioritySet(INT_SSI0, INTERRUPT_PRIORITY_TRANSPORT);
+        IntEnable(INT_SSI0);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void SpiSlaveTransport::interruptHandler()
+    {
+        const uint32_t status = SSIIntStatus(SSI0_BASE, true);
+        SSIIntClear(SSI0_BASE, status);
+
+        // The RX FIFO was full when the host clocked another byte. The counter is shared with the UART, there is only one transport.
+        if (status & SSI_RXOR)
+            statistics.uartOverruns++;
+
+        // The TX channel already finishes when the last bytes are in the FIFO, the burst only ends once the RX channel has them all
+        const uint32_t dmaStatus = HWREG(UDMA_CHIS);
+        HWREG(UDMA_CHIS) = dmaStatus & ((1 << UDMA_SSI_TX_CHANNEL) | (1 << UDMA_SSI_RX_CHANNEL));
+        if (!(dmaStatus & (1 << UDMA_SSI_RX_CHANNEL)))
+            return;
+
+        // The host sends more bursts than usual when it has many ACKs, which poll can't keep up with when the serial task is busy
+        if (spiRxReady)
+            statistics.uartOverruns++;
+
+        spiRxCurrent ^= 1;
+        spiRxReady = true;
+        startBurst();
+
+        if (spiTxPendingLen > 0)
+        {
+            const uint16_t copied = spiFillBurst(spiTxPendingData, spiTxPendingLen);
+            spiTxPendingData += copied;
+            spiTxPendingLen -= copied;
+        }
+
+        Serial::notifyFromInterrupt();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void SpiSlaveTransport::poll()
+    {
+        if (!spiRxReady)
+            return;
+
+        // The host fills its bursts with flags as well, which are removed here as the receiver takes two flags in a row for a
+        // message that got lost. A whole burst passes before the uDMA writes to this one again, so it isn't protected.
+        const uint8_t* burst = spiRxBursts[spiRxCurrent ^ 1];
+        for (uint16_t i = 0; i < SPI_SLAVE_BURST_LEN; ++i)
+        {
+            const uint8_t byte = burst[i];
+            if (byte == HDLC_FLAG)
+            {
+                if (spiRxFrameLen > 0)
+                {
+                    rxBuffer[rxBufferIndexWrite] = HDLC_FLAG;
+                    rxBufferIndexWrite = rxBufferIndexWrite + 1;
+                    spiRxFrameLen = -1;
+                }
+                else
+                    spiRxFrameLen = 0;
+
+                continue;
+            }
+
+            // The opening flag is only passed on in front of the first byte of the message
+            if (spiRxFrameLen == 0)
+            {
+                rxBuffer[rxBufferIndexWrite] = HDLC_FLAG;
+                rxBufferIndexWrite = rxBufferIndexWrite + 1;
+            }
+            if (spiRxFrameLen >= 0)
+                spiRxFrameLen++;
+
+            rxBuffer[rxBufferIndexWrite] = byte;
+            rxBufferIndexWrite = rxBufferIndexWrite + 1;
+        }
+
+        spiRxReady = false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool SpiSlaveTransport::isTransmitting()
+    {
+        return spiTxPendingLen > 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool SpiSlaveTransport::isLaneTransmitting(uint8_t)
+    {
+        return isTransmitting();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void SpiSlaveTransport::transmit(uint8_t, const uint8_t* data, uint16_t length)
+    {
+        // The interrupt continues with the rest of the packet once the host clocked the burst that is being send
+        IntDisable(INT_SSI0);
+        const uint16_t copied = spiFillBurst(data, length);
+        spiTxPendingData = data + copied;
+        spiTxPendingLen = length - copied;
+        IntEnable(INT_SSI0);
+
+        // The TX buffer of the packet is already free when the whole packet fit, the serial task has to pass on to the next one
+        if (copied == length)
+            Serial::notifyFromInterrupt();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void SpiSlaveTransport::writeByte(uint8_t byte)
+    {
+        // Without a host that clocks the bursts, the message is lost just like it would be on an unconnected UART
+        IntDisable(INT_SSI0);
+        spiFillBurst(&byte, 1);
+        IntEnable(INT_SSI0);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void SpiSlaveTransport::flush()
+    {
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint32_t SpiSlaveTransport::getDefaultBaudrate()
+    {
+        return SPI_SLAVE_EQUIVALENT_BAUDRATE;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool SpiSlaveTransport::isBaudrateSupported(uint32_t)
+    {
+        return false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint32_t SpiSlaveTransport::getMaxBaudrate()
+    {
+        return getDefaultBaudrate();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void SpiSlaveTransport::setBaudrate(uint32_t)
+    {
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Called when the host finished a burst (or before the first one), the next one is armed before the host clocks it
+    inline void SpiSlaveTransport::startBurst()
+    {
+        uDMAChannelTransferSet(UDMA_SSI_RX_CHANNEL | UDMA_PRI_SELECT, UDMA_MODE_BASIC, (void*)(SSI0_BASE + SSI_O_DR),
+                               (void*)spiRxBursts[spiRxCurrent], SPI_SLAVE_BURST_LEN);
+        uDMAChannelEnable(UDMA_SSI_RX_CHANNEL);
+
+        if (spiTxFillLen > 0)
+        {
+            for (uint16_t i = spiTxFillLen; i < SPI_SLAVE_BURST_LEN; ++i)
+                spiTxBursts[spiTxFill][i] = HDLC_FLAG;
+
+            uDMAChannelControlSet(UDMA_SSI_TX_CHANNEL | UDMA_PRI_SELECT, SPI_SLAVE_TX_DMA_CONTROL);
+            uDMAChannelTransferSet(UDMA_SSI_TX_CHANNEL | UDMA_PRI_SELECT, UDMA_MODE_BASIC, (void*)spiTxBursts[spiTxFill],
+                                   (void*)(SSI0_BASE + SSI_O_DR), SPI_SLAVE_BURST_LEN);
+            spiTxFill ^= 1;
+            spiTxFillLen = 0;
+        }
+        else
+        {
+            uDMAChannelControlSet(UDMA_SSI_TX_CHANNEL | UDMA_PRI_SELECT, SPI_SLAVE_IDLE_DMA_CONTROL);
+            uDMAChannelTransferSet(UDMA_SSI_TX_CHANNEL | UDMA_PRI_SELECT, UDMA_MODE_BASIC, (void*)&spiTxIdleByte,
+                                   (void*)(SSI0_BASE + SSI_O_DR), SPI_SLAVE_BURST_LEN);
+            GPIOPinWrite(GPIO_DEBUG_AD0_PORT, GPIO_DEBUG_AD0_PIN, 0);
+        }
+
+        uDMAChannelEnable(UDMA_SSI_TX_CHANNEL);
+    }
+}
@@ -0,0 +1,67 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_SPI_SLAVE_HPP
+#define SNIFFER_SPI_SLAVE_HPP
+
+#include "sniffer_global.hpp"
+
+// The host is the SPI master and always clocks bursts of SPI_SLAVE_BURST_LEN bytes, in both directions at once. Both sides
+// send their encoded messages back to back and fill the burst behind the last one with HDLC flags, which the receiving side
+// drops again. The data ready pin (debug pin AD0, PD3) is high while there are records for the host, a host that has
+// something to send clocks a burst without waiting for it. SPI mode 1 is used, as the SSI only keeps the chip select low
+// between the bytes in that mode. The host leaves a few microseconds between the bursts, in which the next one is armed.
+#define SPI_SLAVE_BURST_LEN             512     // Bytes in every transfer of the host, a packet can continue in the next burst
+#define SPI_SLAVE_PROTOCOL              SSI_FRF_MOTO_MODE_1
+#define SPI_SLAVE_MAX_CLOCK             2000000 // Clock of the host, as a slave the SSI follows at most a twelfth of the 32 MHz system clock
+#define SPI_SLAVE_EQUIVALENT_BAUDRATE   (SPI_SLAVE_MAX_CLOCK / 8 * 10)  // Same bytes per second with 10 bits per byte, used for the adaptive window
+
+namespace Sniffer
+{
+    // Transport as a SPI slave on SSI0 towards a single-board computer, the uDMA moves the bursts in both directions
+    class SpiSlaveTransport
+    {
+    public:
+        // Enable SSI0 as a slave and arm the first burst, which only contains flags
+        static void initialize();
+
+        // Interrupt handler for SSI0, which is triggered when the uDMA finished a burst
+        static void interruptHandler();
+
+        // Copy the bytes that the host sent in the last burst to the RX buffer
+        static void poll();
+
+        // Check whether a packet is waiting for the next burst, because the burst that is being filled had no room for it
+        static bool isTransmitting();
+
+        // Same as isTransmitting, as there is only the first lane
+        static bool isLaneTransmitting(uint8_t lane);
+
+        // Add an encoded packet to the burst that is being filled, or let it wait for the next one.
+        // There is only one lane, so the lane is ignored.
+        static void transmit(uint8_t lane, const uint8_t* data, uint16_t length);
+
+        // Add a single byte to the burst that is being filled, it is dropped when the burst is full
+        static void writeByte(uint8_t byte);
+
+        // Nothing to do, the data ready pin already asks the host for the burst that is being filled
+        static void flush();
+
+        // Rate at which the host clocks the bytes, used for the adaptive window
+        static uint32_t getDefaultBaudrate();
+
+        // The host decides on the clock, there is no baudrate to change
+        static bool isBaudrateSupported(uint32_t rate);
+        static uint32_t getMaxBaudrate();
+        static void setBaudrate(uint32_t rate);
+
+    private:
+        static void startBurst();
+    };
+}
+
+#endif // SNIFFER_SPI_SLAVE_HPP
@@ -0,0 +1,161 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_statistics.hpp"
+#include "sniffer_serial_send.hpp"
+#include "sniffer_radio.hpp"
+#include "sniffer_profiling.hpp"
+
+namespace Sniffer
+{
+    StatisticsCounters statistics;
+
+    uint32_t statisticsInterval = 0; // In microseconds, 0 when the host doesn't want statistics
+    uint32_t statisticsLastSendTime = 0;
+    uint16_t statisticsHighestSeqNr = 0; // Highest sequence number that was send, only valid when statisticsSeqNrValid is set
+    bool     statisticsSeqNrValid = false;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Statistics::clear()
+    {
+        // The counters are also updated from the radio interrupt
+        const uint32_t interruptMask = enterCriticalSection();
+
+        statistics.framesReceived = 0;
+        statistics.framesDropped = 0;
+        statistics.radioFlushes = 0;
+        statistics.invalidLengths = 0;
+        statistics.nacksReceived = 0;
+        statistics.retransmittedBytes = 0;
+        statistics.bufferPeak = 0;
+        statistics.framesTruncated = 0;
+        for (uint8_t i = 0; i < OVERFLOW_FRAME_TYPE_COUNT; ++i)
+            statistics.framesDroppedPerType[i] = 0;
+        statistics.duplicatesReplaced = 0;
+        statistics.compressedBytes = 0;
+        statistics.uartOverruns = 0;
+        statistics.badFcsDropped = 0;
+        statistics.bufferWrapBytes = 0;
+        statistics.batchesHeld = 0;
+        statistics.batchHoldTime = 0;
+        statistics.batchHoldPeak = 0;
+
+        leaveCriticalSection(interruptMask);
+
+        statisticsInterval = 0;
+        Profiling::clear();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Statistics::setInterval(uint16_t interval)
+    {
+        statisticsInterval = static_cast<uint32_t>(interval) * 1000;
+        statisticsLastSendTime = Radio::getCurrentTime();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Statistics::updateBufferPeak()
+    {
+        const uint16_t occupancy = bufferDistance(bufferIndexAcked, bufferIndexRadio);
+        if (occupancy > statistics.bufferPeak)
+            statistics.bufferPeak = occupancy;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Statistics::frameDropped(uint8_t frameType)
+    {
+        statistics.framesDropped++;
+        statistics.framesDroppedPerType[(frameType < OVERFLOW_FRAME_TYPE_COUNT - 1) ? frameType : OVERFLOW_FRAME_TYPE_COUNT - 1]++;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Statistics::packetSent(uint16_t lastSeqNr, uint8_t length)
+    {
+        // Sequence numbers wrap around, so a packet is older when the difference is negative
+        if (statisticsSeqNrValid && (static_cast<int16_t>(lastSeqNr - statisticsHighestSeqNr) <= 0))
+            statistics.retransmittedBytes += length;
+        else
+        {
+            statisticsHighestSeqNr = lastSeqNr;
+            statisticsSeqNrValid = true;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Statistics::batchHeld(uint32_t holdTime)
+    {
+        statistics.batchesHeld++;
+        statistics.batchHoldTime += holdTime;
+        if (holdTime > statistics.batchHoldPeak)
+            statistics.batchHoldPeak = holdTime;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Statistics::restartSequenceNumbers()
+    {
+        statisticsSeqNrValid = false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Statistics::sendPeriodically()
+    {
+        if (statisticsInterval == 0)
+            return;
+
+        const uint32_t now = Radio::getCurrentTime();
+        if (now - statisticsLastSendTime < statisticsInterval)
+            return;
+
+        statisticsLastSendTime = now;
+
+        // The counters are copied while they can't change, so that they are consistent with each other.
+        // When PROFILING is set, the cycle measurements of the hot paths follow the counters.
+        uint8_t data[sizeof(StatisticsCounters) + ProfilingSection::Count * PROFILING_REPORT_SECTION_LEN];
+        const uint32_t interruptMask = enterCriticalSection();
+        statistics.bufferOccupancy = bufferDistance(bufferIndexAcked, bufferIndexRadio);
+        const uint32_t* counters = reinterpret_cast<const uint32_t*>(&statistics);
+        for (uint8_t i = 0; i < sizeof(StatisticsCounters) / 4; ++i)
+            writeUint32(data, 4 * i, counters[i]);
+
+        const uint8_t dataLength = sizeof(StatisticsCounters) + Profiling::writeReport(&data[sizeof(StatisticsCounters)]);
+
+        leaveCriticalSection(interruptMask);
+
+        SerialSend::sendMessage(SerialDataType::Stats, data, dataLength);
+
+#if PROFILING
+        uint8_t latency[LATENCY_LENGTH_CLASSES * LATENCY_REPORT_CLASS_LEN];
+        const uint32_t latencyInterruptMask = enterCriticalSection();
+        const uint8_t latencyLength = Profiling::writeLatencyReport(latency);
+        leaveCriticalSection(latencyInterruptMask);
+
+        SerialSend::sendMessage(SerialDataType::Latency, latency, latencyLength);
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint32_t Statistics::getTimeUntilNextSend()
+    {
+        if (statisticsInterval == 0)
+            return TIMEOUT_NONE;
+
+        const uint32_t elapsed = Radio::getCurrentTime() - statisticsLastSendTime;
+        if (elapsed >= statisticsInterval)
+            return 0;
+
+        return (statisticsInterval - elapsed + 999) / 1000;
+    }
+}
@@ -0,0 +1,72 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_STATISTICS_HPP
+#define SNIFFER_STATISTICS_HPP
+
+#include "sniffer_global.hpp"
+
+namespace Sniffer
+{
+    // Counters that are send to the host in the STATS message, in this order
+    struct StatisticsCounters
+    {
+        uint32_t framesReceived;     // Frames that were copied into the buffer
+        uint32_t framesDropped;      // Frames (or blocks of samples) that were discarded because the buffer was full
+        uint32_t radioFlushes;       // Amount of times that the RX FIFO had to be flushed
+        uint32_t invalidLengths;     // Frames with a length byte that didn't match with what was received
+        uint32_t nacksReceived;      // Normal and selective NACKs received from the host, and cumulative ACKs with missing records
+        uint32_t retransmittedBytes; // Bytes from the buffer that were send more than once
+        uint32_t bufferPeak;         // Highest amount of unacknowledged bytes in the buffer
+        uint32_t framesTruncated;    // Frames of which only the MAC header was kept because of the overflow policy
+        uint32_t framesDroppedPerType[OVERFLOW_FRAME_TYPE_COUNT]; // Part of framesDropped: beacon, data, ACK, command and other frames
+        uint32_t duplicatesReplaced; // Retries that were send as a reference to the earlier frame
+        uint32_t compressedBytes;    // Bytes that were removed from the records by compressing their MAC header
+        uint32_t uartOverruns;       // Times that bytes from the host were lost because the UART RX FIFO overflowed
+        uint32_t badFcsDropped;      // Frames with a bad FCS that weren't send because the host asked for the FCS filter
+        uint32_t bufferWrapBytes;    // Bytes at the end of the buffer that stayed unused because the next record didn't fit behind the last one
+        uint32_t bufferOccupancy;    // Unacknowledged bytes in the buffer when the counters were send
+        uint32_t batchesHeld;        // Times that throughput mode held the records back before sending them
+        uint32_t batchHoldTime;      // Microseconds that the records were held back in total, the latency that throughput mode added
+        uint32_t batchHoldPeak;      // Longest time in microseconds that records were held back
+    };
+
+    extern StatisticsCounters statistics;
+
+    class Statistics
+    {
+    public:
+        // Set all counters back to 0 and stop sending them
+        static void clear();
+
+        // Send the counters every interval milliseconds, or never when the interval is 0
+        static void setInterval(uint16_t interval);
+
+        // Keep track of the highest buffer occupancy, called when the radio index moved forward
+        static void updateBufferPeak();
+
+        // Count a frame that was discarded, the frame type is the lowest 3 bits of the frame control field
+        static void frameDropped(uint8_t frameType);
+
+        // Count the bytes that are send again, needs to be called for every encoded packet (or batch)
+        static void packetSent(uint16_t lastSeqNr, uint8_t length);
+
+        // Count the microseconds that throughput mode held the records back before sending them
+        static void batchHeld(uint32_t holdTime);
+
+        // The sequence numbers restart from 0 when the buffer is cleared
+        static void restartSequenceNumbers();
+
+        // Send the counters to the host when the interval has passed, called from the serial task
+        static void sendPeriodically();
+
+        // Milliseconds until sendPeriodically has to send the counters, or TIMEOUT_NONE when there is no interval
+        static uint32_t getTimeUntilNextSend();
+    };
+}
+
+#endif // SNIFFER_STATISTICS_HPP
@@ -0,0 +1,82 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_status_leds.hpp"
+#include "sniffer_statistics.hpp"
+#include "sniffer_radio.hpp"
+
+namespace Sniffer
+{
+    uint32_t statusLedsFrames = 0;  // Frames received and flushed at the previous update
+    uint32_t statusLedsDropped = 0; // Frames dropped at the previous update
+    uint32_t statusLedsActivityTime = 0; // Time of the last update that saw new frames
+    bool     statusLedsActive = false;   // Whether the yellow led is on
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void StatusLeds::reset()
+    {
+        led_yellow.off();
+        led_red.off();
+        statusLedsActive = false;
+
+        statusLedsFrames = statistics.framesReceived + statistics.radioFlushes;
+        statusLedsDropped = statistics.framesDropped;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void StatusLeds::update()
+    {
+        // The counters can only go down when the host cleared them, which isn't a reason to light a led
+        const uint32_t frames = statistics.framesReceived + statistics.radioFlushes;
+        const uint32_t dropped = statistics.framesDropped;
+        const uint32_t now = Radio::getCurrentTime();
+        if (frames != statusLedsFrames)
+        {
+            if (frames > statusLedsFrames)
+            {
+                statusLedsActivityTime = now;
+                if (!statusLedsActive)
+                {
+                    led_yellow.on();
+                    statusLedsActive = true;
+                }
+            }
+
+            statusLedsFrames = frames;
+        }
+        else if (statusLedsActive && (now - statusLedsActivityTime >= STATUS_LED_ACTIVITY_TIME))
+        {
+            led_yellow.off();
+            statusLedsActive = false;
+        }
+
+        // Indicate that we are no longer lossless, until the next reset
+        if (dropped != statusLedsDropped)
+        {
+            if (dropped > statusLedsDropped)
+                led_red.on();
+
+            statusLedsDropped = dropped;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint32_t StatusLeds::getTimeUntilNextUpdate()
+    {
+        if (!statusLedsActive)
+            return TIMEOUT_NONE;
+
+        const uint32_t elapsed = Radio::getCurrentTime() - statusLedsActivityTime;
+        if (elapsed >= STATUS_LED_ACTIVITY_TIME)
+            return 0;
+
+        return (STATUS_LED_ACTIVITY_TIME - elapsed + 999) / 1000;
+    }
+}
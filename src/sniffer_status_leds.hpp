@@ -0,0 +1,32 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_STATUS_LEDS_HPP
+#define SNIFFER_STATUS_LEDS_HPP
+
+#include "sniffer_global.hpp"
+
+namespace Sniffer
+{
+    // Shows the radio activity on the yellow led and lost frames on the red led. The radio interrupt only updates its
+    // counters, the serial task compares them with what it saw the previous time and sets the leds from them.
+    class StatusLeds
+    {
+    public:
+        // Turn off the yellow and red leds and start comparing with the current counters, called by reset()
+        static void reset();
+
+        // Light the yellow led when frames arrived since the previous call and the red led when frames were dropped,
+        // called from the serial task
+        static void update();
+
+        // Milliseconds until update has to turn off the yellow led, or TIMEOUT_NONE when it is already off
+        static uint32_t getTimeUntilNextUpdate();
+    };
+}
+
+#endif // SNIFFER_STATUS_LEDS_HPP
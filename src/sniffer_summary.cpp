@@ -0,0 +1,409 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_summary.hpp"
+#include "sniffer_serial_send.hpp"
+#include "sniffer_radio.hpp"
+
+// The first byte of the key contains the frame type, the destination address mode (bits 4-5) and the source address mode (bits 6-7)
+#define SUMMARY_KEY_PAN_OFFSET  1
+#define SUMMARY_KEY_DST_OFFSET  3
+#define SUMMARY_KEY_SRC_OFFSET  11
+
+namespace Sniffer
+{
+    struct SummaryLink
+    {
+        uint8_t  key[SUMMARY_KEY_LENGTH];
+        uint8_t  unused;
+        uint16_t frames;    // 0 when the entry is free, the other fields are only valid when it isn't
+        uint16_t fcsErrors;
+        uint32_t bytes;     // Length of the frames including their FCS
+        int32_t  rssiSum;
+        uint32_t lqiSum;
+    };
+
+    struct SummaryTalker
+    {
+        uint8_t  key[TOP_TALKERS_KEY_LENGTH];
+        uint8_t  unused;
+        uint16_t frames;    // Estimate from the sketch, 0 when the entry is free
+    };
+
+    // Every frame increments one counter per row, the lowest of those counters is an estimate that can only be too high.
+    // The memory doesn't grow with the amount of sources, so the top talkers are found among any amount of nodes.
+    struct SummarySketch
+    {
+        uint16_t      counters[SUMMARY_SKETCH_DEPTH][SUMMARY_SKETCH_WIDTH];
+        SummaryTalker talkers[SUMMARY_TOP_TALKERS];
+    };
+
+    // The radio only ever copies a frame to the start of the buffer in this mode, the rest of it holds two tables and two
+    // sketches behind them. The radio interrupt counts in one of each while the serial task sends and clears the others.
+    static_assert(SUMMARY_TABLE_OFFSET >= BUFFER_EXTRA_BYTES + 127, "The tables would overlap with the frame in the buffer");
+
+    uint32_t summaryInterval = 0; // In microseconds
+    uint32_t summaryLastSendTime = 0;
+    uint32_t summaryUntracked = 0; // Frames in the current interval that didn't fit in the table
+    uint16_t summarySeqNr = 0; // Number of the interval, lets the host notice lost SUMMARY messages
+    uint8_t  summaryActiveTable = 0;
+    bool     summaryRunning = false;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION inline SummaryLink* summaryTable(uint8_t index)
+    {
+        return reinterpret_cast<SummaryLink*>(&buffer[SUMMARY_TABLE_OFFSET]) + index * SUMMARY_TABLE_SIZE;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION inline SummarySketch* summarySketch(uint8_t index)
+    {
+        return reinterpret_cast<SummarySketch*>(summaryTable(2)) + index;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION inline bool summaryKeysEqual(const uint8_t* key1, const uint8_t* key2, uint8_t length)
+    {
+        for (uint8_t i = 0; i < length; ++i)
+        {
+            if (key1[i] != key2[i])
+                return false;
+        }
+
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // FNV-1a hash of a key
+    SNIFFER_RAM_FUNCTION inline uint32_t summaryHash(const uint8_t* key, uint8_t length)
+    {
+        uint32_t hash = 2166136261u;
+        for (uint8_t i = 0; i < length; ++i)
+            hash = (hash ^ key[i]) * 16777619u;
+
+        return hash;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void summaryClearSketch(SummarySketch& sketch)
+    {
+        for (uint8_t row = 0; row < SUMMARY_SKETCH_DEPTH; ++row)
+        {
+            for (uint16_t i = 0; i < SUMMARY_SKETCH_WIDTH; ++i)
+                sketch.counters[row][i] = 0;
+        }
+
+        for (uint8_t i = 0; i < SUMMARY_TOP_TALKERS; ++i)
+            sketch.talkers[i].frames = 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Summary::start(uint16_t interval)
+    {
+        if ((interval == 0) || (interval > SUMMARY_MAX_INTERVAL)
+         || (SUMMARY_TABLE_OFFSET + 2 * (SUMMARY_TABLE_SIZE * sizeof(SummaryLink) + sizeof(SummarySketch)) > BUFFER_LEN))
+            return false;
+
+        SummaryLink* tables = summaryTable(0);
+        for (uint16_t i = 0; i < 2 * SUMMARY_TABLE_SIZE; ++i)
+            tables[i].frames = 0;
+
+        summaryClearSketch(*summarySketch(0));
+        summaryClearSketch(*summarySketch(1));
+
+        summaryInterval = static_cast<uint32_t>(interval) * 1000;
+        summaryLastSendTime = Radio::getCurrentTime();
+        summaryUntracked = 0;
+        summarySeqNr = 0;
+        summaryActiveTable = 0;
+        summaryRunning = true;
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Summary::stop()
+    {
+        summaryRunning = false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Summary::isRunning()
+    {
+        return summaryRunning;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION void Summary::addFrame(const uint8_t* frame, uint8_t length)
+    {
+        uint8_t key[SUMMARY_KEY_LENGTH];
+        buildKey(frame, length, key);
+        addTalker(key);
+
+        // The next entries are tried when the one that the hash points to belongs to another link
+        const uint32_t hash = summaryHash(key, SUMMARY_KEY_LENGTH);
+        SummaryLink* table = summaryTable(summaryActiveTable);
+        for (uint8_t probe = 0; probe < SUMMARY_MAX_PROBES; ++probe)
+        {
+            SummaryLink& link = table[(hash + probe) & (SUMMARY_TABLE_SIZE - 1)];
+            if (link.frames == 0)
+            {
+                for (uint8_t i = 0; i < SUMMARY_KEY_LENGTH; ++i)
+                    link.key[i] = key[i];
+
+                link.fcsErrors = 0;
+                link.bytes = 0;
+                link.rssiSum = 0;
+                link.lqiSum = 0;
+            }
+            else if (!summaryKeysEqual(link.key, key, SUMMARY_KEY_LENGTH))
+                continue;
+
+            // The RSSI was already corrected, the highest bit of the last byte is set when the FCS was correct
+            link.frames++;
+            link.bytes += length;
+            link.rssiSum += static_cast<int8_t>(frame[length - 2]);
+            link.lqiSum += frame[length - 1] & 0x7F;
+            if (!(frame[length - 1] & 0x80))
+                link.fcsErrors++;
+            return;
+        }
+
+        summaryUntracked++;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Summary::sendPeriodically()
+    {
+        if (!summaryRunning)
+            return;
+
+        const uint32_t now = Radio::getCurrentTime();
+        if (now - summaryLastSendTime < summaryInterval)
+            return;
+
+        summaryLastSendTime = now;
+
+        // The radio interrupt continues in the other table and sketch, which were cleared when they were send the previous time
+        const uint32_t interruptMask = enterCriticalSection();
+        const uint8_t sentTable = summaryActiveTable;
+        SummaryLink* table = summaryTable(sentTable);
+        summaryActiveTable ^= 1;
+        const uint32_t untracked = summaryUntracked;
+        summaryUntracked = 0;
+        leaveCriticalSection(interruptMask);
+
+        uint8_t linkCount = 0;
+        for (uint8_t i = 0; i < SUMMARY_TABLE_SIZE; ++i)
+            linkCount += (table[i].frames != 0);
+
+        // An interval without frames is still send, so that the host can tell that it was quiet
+        const uint16_t interval = summarySeqNr++;
+        uint8_t data[SUMMARY_HEADER_LENGTH + SUMMARY_LINKS_PER_MESSAGE * SUMMARY_LINK_LENGTH];
+        writeUint16(data, 0, interval);
+        data[3] = (linkCount == 0) ? 1 : (linkCount + SUMMARY_LINKS_PER_MESSAGE - 1) / SUMMARY_LINKS_PER_MESSAGE;
+        writeUint16(data, 4, (untracked > 0xFFFF) ? 0xFFFF : untracked);
+
+        uint8_t part = 0;
+        uint8_t dataLength = SUMMARY_HEADER_LENGTH;
+        for (uint8_t i = 0; i < SUMMARY_TABLE_SIZE; ++i)
+        {
+            SummaryLink& link = table[i];
+            if (link.frames == 0)
+                continue;
+
+            uint8_t* entry = &data[dataLength];
+            for (uint8_t j = 0; j < SUMMARY_KEY_LENGTH; ++j)
+                entry[j] = link.key[j];
+
+            writeUint16(entry, SUMMARY_KEY_LENGTH, link.frames);
+            writeUint32(entry, SUMMARY_KEY_LENGTH + 2, link.bytes);
+            writeUint16(entry, SUMMARY_KEY_LENGTH + 6, link.fcsErrors);
+            entry[SUMMARY_KEY_LENGTH + 8] = static_cast<uint8_t>(static_cast<int8_t>(link.rssiSum / link.frames));
+            entry[SUMMARY_KEY_LENGTH + 9] = static_cast<uint8_t>(link.lqiSum / link.frames);
+            link.frames = 0;
+
+            dataLength += SUMMARY_LINK_LENGTH;
+            if (dataLength == sizeof(data))
+            {
+                data[2] = part++;
+                SerialSend::sendMessage(SerialDataType::Summary, data, dataLength);
+                dataLength = SUMMARY_HEADER_LENGTH;
+            }
+        }
+
+        if ((dataLength > SUMMARY_HEADER_LENGTH) || (part == 0))
+        {
+            data[2] = part;
+            SerialSend::sendMessage(SerialDataType::Summary, data, dataLength);
+        }
+
+        sendTopTalkers(sentTable, interval);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint32_t Summary::getTimeUntilNextSend()
+    {
+        if (!summaryRunning)
+            return TIMEOUT_NONE;
+
+        const uint32_t elapsed = Radio::getCurrentTime() - summaryLastSendTime;
+        if (elapsed >= summaryInterval)
+            return 0;
+
+        return (summaryInterval - elapsed + 999) / 1000;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION inline void Summary::addTalker(const uint8_t* linkKey)
+    {
+        // Frames without a source address (e.g. ACKs) can't be blamed on a node
+        const uint8_t key[TOP_TALKERS_KEY_LENGTH] = {
+            static_cast<uint8_t>(linkKey[0] >> 6), linkKey[SUMMARY_KEY_PAN_OFFSET], linkKey[SUMMARY_KEY_PAN_OFFSET + 1],
+            linkKey[SUMMARY_KEY_SRC_OFFSET + 0], linkKey[SUMMARY_KEY_SRC_OFFSET + 1], linkKey[SUMMARY_KEY_SRC_OFFSET + 2],
+            linkKey[SUMMARY_KEY_SRC_OFFSET + 3], linkKey[SUMMARY_KEY_SRC_OFFSET + 4], linkKey[SUMMARY_KEY_SRC_OFFSET + 5],
+            linkKey[SUMMARY_KEY_SRC_OFFSET + 6], linkKey[SUMMARY_KEY_SRC_OFFSET + 7]
+        };
+        if (key[0] < 2)
+            return;
+
+        // The counter of each row is picked by combining the two halves of one hash
+        SummarySketch& sketch = *summarySketch(summaryActiveTable);
+        const uint32_t hash = summaryHash(key, TOP_TALKERS_KEY_LENGTH);
+        const uint16_t hash1 = hash & 0xFFFF;
+        const uint16_t hash2 = (hash >> 16) | 1;
+        uint16_t estimate = 0xFFFF;
+        for (uint8_t row = 0; row < SUMMARY_SKETCH_DEPTH; ++row)
+        {
+            uint16_t& counter = sketch.counters[row][(hash1 + row * hash2) & (SUMMARY_SKETCH_WIDTH - 1)];
+            if (counter < 0xFFFF)
+                counter++;
+            if (counter < estimate)
+                estimate = counter;
+        }
+
+        // With this few entries a linear search is cheaper than keeping a heap, the source with the lowest estimate is
+        // replaced once another source has more frames
+        uint8_t lowest = 0;
+        for (uint8_t i = 0; i < SUMMARY_TOP_TALKERS; ++i)
+        {
+            SummaryTalker& talker = sketch.talkers[i];
+            if ((talker.frames != 0) && summaryKeysEqual(talker.key, key, TOP_TALKERS_KEY_LENGTH))
+            {
+                talker.frames = estimate;
+                return;
+            }
+
+            if (talker.frames < sketch.talkers[lowest].frames)
+                lowest = i;
+        }
+
+        SummaryTalker& talker = sketch.talkers[lowest];
+        if (estimate > talker.frames)
+        {
+            for (uint8_t i = 0; i < TOP_TALKERS_KEY_LENGTH; ++i)
+                talker.key[i] = key[i];
+
+            talker.frames = estimate;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Summary::sendTopTalkers(uint8_t sketchIndex, uint16_t interval)
+    {
+        SummarySketch& sketch = *summarySketch(sketchIndex);
+
+        uint8_t data[2 + SUMMARY_TOP_TALKERS * TOP_TALKERS_ENTRY_LENGTH];
+        uint8_t dataLength = 2;
+        writeUint16(data, 0, interval);
+        for (uint8_t i = 0; i < SUMMARY_TOP_TALKERS; ++i)
+        {
+            const SummaryTalker& talker = sketch.talkers[i];
+            if (talker.frames == 0)
+                continue;
+
+            for (uint8_t j = 0; j < TOP_TALKERS_KEY_LENGTH; ++j)
+                data[dataLength + j] = talker.key[j];
+
+            writeUint16(data, dataLength + TOP_TALKERS_KEY_LENGTH, talker.frames);
+            dataLength += TOP_TALKERS_ENTRY_LENGTH;
+        }
+
+        SerialSend::sendMessage(SerialDataType::TopTalkers, data, dataLength);
+        summaryClearSketch(sketch);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION inline void Summary::buildKey(const uint8_t* frame, uint8_t length, uint8_t* key)
+    {
+        for (uint8_t i = 0; i < SUMMARY_KEY_LENGTH; ++i)
+            key[i] = 0;
+
+        // The last two bytes are the RSSI and CRC/LQI, frames without a sequence number all end up on the same link
+        if (length < 5)
+            return;
+
+        const uint8_t headerLength = length - 2;
+        const uint16_t frameControl = frame[0] | (frame[1] << 8);
+        const bool panIdCompression = (frameControl >> 6) & 0x01;
+        const uint8_t dstAddrMode = (frameControl >> 10) & 0x03;
+        const uint8_t srcAddrMode = (frameControl >> 14) & 0x03;
+        key[0] = (frameControl & 0x07) | (dstAddrMode << 4) | (srcAddrMode << 6);
+
+        uint8_t pos = 3; // Frame control field and sequence number
+        if (dstAddrMode >= 2)
+        {
+            const uint8_t addrLen = (dstAddrMode == 2) ? 2 : 8;
+            if (pos + 2 + addrLen > headerLength)
+                return;
+
+            key[SUMMARY_KEY_PAN_OFFSET] = frame[pos];
+            key[SUMMARY_KEY_PAN_OFFSET + 1] = frame[pos + 1];
+            for (uint8_t i = 0; i < addrLen; ++i)
+                key[SUMMARY_KEY_DST_OFFSET + i] = frame[pos + 2 + i];
+
+            pos += 2 + addrLen;
+        }
+
+        if (srcAddrMode >= 2)
+        {
+            // The PAN of the key is the source PAN when there is no destination
+            const uint8_t addrLen = (srcAddrMode == 2) ? 2 : 8;
+            if (!panIdCompression)
+            {
+                if (pos + 2 > headerLength)
+                    return;
+
+                if (dstAddrMode < 2)
+                {
+                    key[SUMMARY_KEY_PAN_OFFSET] = frame[pos];
+                    key[SUMMARY_KEY_PAN_OFFSET + 1] = frame[pos + 1];
+                }
+                pos += 2;
+            }
+
+            if (pos + addrLen > headerLength)
+                return;
+
+            for (uint8_t i = 0; i < addrLen; ++i)
+                key[SUMMARY_KEY_SRC_OFFSET + i] = frame[pos + i];
+        }
+    }
+}
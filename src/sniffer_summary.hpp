@@ -0,0 +1,50 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_SUMMARY_HPP
+#define SNIFFER_SUMMARY_HPP
+
+#include "sniffer_global.hpp"
+
+namespace Sniffer
+{
+    class Summary
+    {
+    public:
+        // Start counting the frames per link and send the table every interval milliseconds.
+        // Returns false when the interval isn't supported or when the buffer is too small to hold the tables.
+        static bool start(uint16_t interval);
+
+        // Stop counting, the frames of the current interval are discarded
+        static void stop();
+
+        // Check whether the frames are counted instead of being stored in the buffer
+        static bool isRunning();
+
+        // Add a frame that was accepted by the filter to the table, called from the radio interrupt.
+        // The length includes the RSSI and CRC/LQI bytes that replaced the FCS.
+        static void addFrame(const uint8_t* frame, uint8_t length);
+
+        // Send the table of the interval that passed, called from the serial task
+        static void sendPeriodically();
+
+        // Milliseconds until sendPeriodically has to send the table, or TIMEOUT_NONE when not running
+        static uint32_t getTimeUntilNextSend();
+
+    private:
+        // Build the key of the link on which the frame was send, frames with an incomplete header get a shorter address
+        static void buildKey(const uint8_t* frame, uint8_t length, uint8_t* key);
+
+        // Count the frame for its source in the sketch and keep the source when it is one of the top talkers
+        static void addTalker(const uint8_t* linkKey);
+
+        // Send the top talkers of the interval that passed and clear the sketch
+        static void sendTopTalkers(uint8_t sketchIndex, uint16_t interval);
+    };
+}
+
+#endif // SNIFFER_SUMMARY_HPP
@@ -0,0 +1,334 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_superframe.hpp"
+#include "sniffer_channel_hopping.hpp"
+#include "sniffer_inject.hpp"
+#include "sniffer_filter.hpp"
+#include "sniffer_radio.hpp"
+#include "sniffer_serial_send.hpp"
+#include "sniffer_survey.hpp"
+
+namespace Sniffer
+{
+    namespace SuperframeState
+    {
+        enum SuperframeState
+        {
+            Idle      = 0, // Not following a network
+            Searching = 1, // Waiting on the current channel for a beacon
+            Active    = 2, // The radio is on for the active portion of the superframe
+            Inactive  = 3  // The radio is off until the guard time before the next beacon
+        };
+    }
+
+    // The radio interrupt and the timer interrupt have the same priority, the serial task only changes the state when idle
+    volatile uint8_t superframeState = SuperframeState::Idle;
+
+    // What the host asked for
+    uint16_t superframeRequestedPan;
+    uint16_t superframeGuardTime;
+
+    // The coordinator of which the superframes are followed
+    uint16_t superframePanId;
+    uint8_t  superframeCoordinatorMode;
+    uint8_t  superframeCoordinator[8];
+    uint8_t  superframeBeaconOrder;
+    uint8_t  superframeOrder;
+    uint32_t superframeStart;    // Time at which the current superframe started, or is expected to have started
+    uint32_t superframeInterval;
+    uint32_t superframeDuration; // Length of the active portion
+    uint32_t superframeEvent;    // Time at which the radio is turned off or on next
+    uint8_t  superframeMissedBeacons;
+    bool     superframeBeaconSeen; // Set when the beacon of the current superframe arrived
+
+    // Filled in by parseBeacon
+    uint16_t superframeBeaconPan;
+    uint8_t  superframeBeaconSourceMode;
+    uint8_t  superframeBeaconSource[8];
+    uint16_t superframeBeaconSpec;
+
+    uint8_t superframeReport[SUPERFRAME_REPORT_LENGTH];
+    bool    superframeReportPending = false;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Superframe::start(const uint8_t* message)
+    {
+        // The survey changes the channel itself and also uses the timer interrupt, just like injecting frames
+        if (Survey::isRunning() || Inject::isActive())
+            return false;
+
+        // Any hopping schedule and a TSCH network that was followed before are forgotten
+        ChannelHopping::stop();
+
+        superframeRequestedPan = readUint16((uint8_t*)message, SUPERFRAME_PAN_OFFSET);
+        superframeGuardTime = readUint16((uint8_t*)message, SUPERFRAME_GUARD_TIME_OFFSET);
+
+        superframePanId = superframeRequestedPan;
+        superframeState = SuperframeState::Searching;
+        Filter::updateRadioFilter();
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Superframe::stop()
+    {
+        if (superframeState >= SuperframeState::Active)
+            Radio::disableTimerInterrupt();
+        if (superframeState == SuperframeState::Inactive)
+            CC2538_RF_CSP_ISRXON();
+
+        superframeState = SuperframeState::Idle;
+        superframeReportPending = false;
+        Filter::updateRadioFilter();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Superframe::isRunning()
+    {
+        return (superframeState != SuperframeState::Idle);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION void Superframe::processFrame(const uint8_t* frame, uint8_t length, uint32_t timestamp)
+    {
+        // Only frames with a correct FCS tell anything about the network
+        if ((superframeState == SuperframeState::Idle) || !(frame[length - 1] & 0x80))
+            return;
+
+        if (parseBeacon(frame, length))
+            synchronize(timestamp);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Superframe::sendPeriodically()
+    {
+        if (!superframeReportPending)
+            return;
+
+        superframeReportPending = false;
+        SerialSend::sendMessage(SerialDataType::Superframe, superframeReport, sizeof(superframeReport));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Superframe::timerInterruptHandler()
+    {
+        // Events further away than the overflow counter reaches are approached in several steps
+        const uint32_t now = Radio::getCurrentTime();
+        if (static_cast<int32_t>(superframeEvent - now) >= 1024)
+        {
+            scheduleEvent(now, superframeState == SuperframeState::Inactive);
+            return;
+        }
+
+        if (superframeState == SuperframeState::Active)
+        {
+            // Never turn off the radio in the middle of a packet, try again a bit later instead
+            if (Radio::isReceiving())
+            {
+                Radio::scheduleTimerInterrupt(MAC_TIMER_MIN_COMPARE_DELAY);
+                return;
+            }
+
+            // Without beacons the superframes drift away from those of the coordinator
+            if (!superframeBeaconSeen && (++superframeMissedBeacons >= SUPERFRAME_MAX_MISSED_BEACONS))
+            {
+                unlock();
+                return;
+            }
+
+            CC2538_RF_CSP_ISRFOFF();
+            superframeState = SuperframeState::Inactive;
+            superframeEvent = superframeStart + superframeInterval - superframeGuardTime;
+            scheduleEvent(now, true);
+        }
+        else
+        {
+            // The next superframe is expected one beacon interval after the previous one, its beacon aligns it again
+            CC2538_RF_CSP_ISRXON();
+            superframeState = SuperframeState::Active;
+            superframeStart += superframeInterval;
+            superframeBeaconSeen = false;
+            superframeEvent = superframeStart + superframeDuration + superframeGuardTime;
+            scheduleEvent(now, false);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Superframe::parseBeacon(const uint8_t* frame, uint8_t length)
+    {
+        // Only the beacons of frame version 0 and 1 have a superframe specification, enhanced beacons have IEs instead
+        const uint16_t frameControl = frame[0] | (frame[1] << 8);
+        const uint8_t frameVersion = (frameControl >> 12) & 0x03;
+        if (((frameControl & 0x07) != 0) || (frameVersion >= 2))
+            return false;
+
+        const uint8_t dstAddrMode = (frameControl >> 10) & 0x03;
+        const uint8_t srcAddrMode = (frameControl >> 14) & 0x03;
+        if ((dstAddrMode == 1) || (srcAddrMode < 2))
+            return false;
+
+        // The last two bytes are the RSSI and CRC/LQI, the superframe specification follows the addressing fields
+        const uint8_t addrLengths[4] = { 0, 0, 2, 8 };
+        const uint8_t end = length - 2;
+        const bool srcPanPresent = (dstAddrMode == 0) || !((frameControl >> 6) & 0x01);
+        uint8_t pos = 3;
+        if (end < pos + ((dstAddrMode != 0) ? 2 + addrLengths[dstAddrMode] : 0) + (srcPanPresent ? 2 : 0) + addrLengths[srcAddrMode] + 2)
+            return false;
+
+        if (dstAddrMode != 0)
+        {
+            superframeBeaconPan = frame[pos] | (frame[pos + 1] << 8);
+            pos += 2 + addrLengths[dstAddrMode];
+        }
+
+        if (srcPanPresent)
+        {
+            superframeBeaconPan = frame[pos] | (frame[pos + 1] << 8);
+            pos += 2;
+        }
+
+        superframeBeaconSourceMode = srcAddrMode;
+        for (uint8_t i = 0; i < 8; ++i)
+            superframeBeaconSource[i] = (i < addrLengths[srcAddrMode]) ? frame[pos + i] : 0;
+
+        pos += addrLengths[srcAddrMode];
+        if ((superframePanId != SUPERFRAME_ANY_PAN) && (superframeBeaconPan != superframePanId))
+            return false;
+
+        // The superframe specification of a secured beacon isn't encrypted, only the auxiliary security header of
+        // IEEE 802.15.4-2006 is skipped though
+        if ((frameControl >> 3) & 0x01)
+        {
+            const uint8_t securityControl = frame[pos];
+            const uint8_t keyIdLengths[4] = { 0, 1, 5, 9 };
+            if (frameVersion == 0)
+                return false;
+
+            pos += 5 + keyIdLengths[(securityControl >> 3) & 0x03];
+            if (end < pos + 2)
+                return false;
+        }
+
+        superframeBeaconSpec = frame[pos] | (frame[pos + 1] << 8);
+
+        // Once locked, only the beacons of the same coordinator are used, other coordinators have their own superframes
+        if (superframeState >= SuperframeState::Active)
+        {
+            if (superframeBeaconSourceMode != superframeCoordinatorMode)
+                return false;
+
+            for (uint8_t i = 0; i < 8; ++i)
+            {
+                if (superframeBeaconSource[i] != superframeCoordinator[i])
+                    return false;
+            }
+        }
+
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Superframe::synchronize(uint32_t timestamp)
+    {
+        const uint8_t beaconOrder = superframeBeaconSpec & 0x0f;
+        const uint8_t order = (superframeBeaconSpec >> 4) & 0x0f;
+        const uint32_t interval = static_cast<uint32_t>(SUPERFRAME_BASE_DURATION) << beaconOrder;
+        const uint32_t duration = static_cast<uint32_t>(SUPERFRAME_BASE_DURATION) << order;
+
+        // A network without beacons or without an inactive period that is long enough is captured with the radio on
+        if ((beaconOrder >= 15) || (order >= beaconOrder)
+         || (interval - duration < 2 * static_cast<uint32_t>(superframeGuardTime) + SUPERFRAME_MIN_INACTIVE))
+        {
+            if (superframeState != SuperframeState::Searching)
+                unlock();
+
+            return;
+        }
+
+        const bool changed = (superframeState == SuperframeState::Searching)
+                          || (beaconOrder != superframeBeaconOrder) || (order != superframeOrder);
+
+        // The beacon starts the superframe, its SFD was received after the preamble
+        superframeStart = timestamp - SUPERFRAME_SFD_OFFSET;
+        superframeInterval = interval;
+        superframeDuration = duration;
+        superframeBeaconOrder = beaconOrder;
+        superframeOrder = order;
+        superframeBeaconSeen = true;
+        superframeMissedBeacons = 0;
+
+        if (superframeState == SuperframeState::Searching)
+        {
+            superframePanId = superframeBeaconPan;
+            superframeCoordinatorMode = superframeBeaconSourceMode;
+            for (uint8_t i = 0; i < 8; ++i)
+                superframeCoordinator[i] = superframeBeaconSource[i];
+
+            superframeState = SuperframeState::Active;
+            Radio::enableTimerInterrupt(Superframe::timerInterruptHandler);
+        }
+
+        if (changed)
+            queueReport();
+
+        superframeEvent = superframeStart + superframeDuration + superframeGuardTime;
+        scheduleEvent(Radio::getCurrentTime(), false);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Superframe::unlock()
+    {
+        Radio::disableTimerInterrupt();
+        IntPendClear(INT_MACTIMR);
+        HWREG(RFCORE_SFR_MTIRQF) = 0;
+
+        if (superframeState == SuperframeState::Inactive)
+            CC2538_RF_CSP_ISRXON();
+
+        superframePanId = superframeRequestedPan;
+        superframeState = SuperframeState::Searching;
+        queueReport();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Superframe::scheduleEvent(uint32_t now, bool early)
+    {
+        // The overflow counter counts in steps of 1024 microseconds. The radio is turned on in the step before the event and
+        // turned off in the step after it, so the guard time only has to cover the clock drift and the jitter of the beacon.
+        uint32_t overflows = 0;
+        if (static_cast<int32_t>(superframeEvent - now) > 0)
+        {
+            const uint32_t delay = superframeEvent - (now & ~static_cast<uint32_t>(1023));
+            overflows = early ? (delay >> 10) : ((delay + 1023) >> 10);
+        }
+
+        Radio::scheduleTimerInterrupt((overflows > 0xFFFF) ? 0xFFFF : overflows);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Superframe::queueReport()
+    {
+        superframeReport[0] = (superframeState >= SuperframeState::Active) ? 1 : 0;
+        superframeReport[1] = superframeBeaconOrder;
+        superframeReport[2] = superframeOrder;
+        writeUint16(superframeReport, 3, superframePanId);
+        writeUint32(superframeReport, 5, superframeStart);
+        superframeReportPending = true;
+    }
+}
@@ -0,0 +1,58 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_SUPERFRAME_HPP
+#define SNIFFER_SUPERFRAME_HPP
+
+#include "sniffer_global.hpp"
+
+namespace Sniffer
+{
+    // Follows the superframes of a beacon-enabled PAN. The radio waits on its channel for a beacon with an inactive period,
+    // and from then on it is only turned on for the active portion of every superframe. While it is off, nothing can be sent
+    // on the channel, so the processor sleeps until the next beacon is due.
+    class Superframe
+    {
+    public:
+        // Start looking for a beacon with the PAN and guard time of the SUPERFRAME message, returns false when this isn't possible
+        static bool start(const uint8_t* message);
+
+        // Stop following the superframes, the radio is turned on again when it was off
+        static void stop();
+
+        // Check whether a network is being searched for or followed
+        static bool isRunning();
+
+        // Called from the radio interrupt for every frame, before the filter. The length includes the RSSI and CRC/LQI bytes.
+        // Beacons of the coordinator give the start and the length of the superframes.
+        static void processFrame(const uint8_t* frame, uint8_t length, uint32_t timestamp);
+
+        // Tell the host when the OpenMote locked onto the superframes or lost them, called from the serial task
+        static void sendPeriodically();
+
+        // Function called when the MAC timer overflow counter reaches the compare value
+        static void timerInterruptHandler();
+
+    private:
+        // Read the PAN, source address and superframe specification from a beacon, returns false when it isn't one of the coordinator
+        static bool parseBeacon(const uint8_t* frame, uint8_t length);
+
+        // Take the timing of the beacon that was just parsed, of which the SFD was received at the given time
+        static void synchronize(uint32_t timestamp);
+
+        // Keep the radio on until the next beacon, the timer interrupt is no longer needed
+        static void unlock();
+
+        // Let the timer interrupt occur at the next event, or as close to it as the overflow counter reaches
+        static void scheduleEvent(uint32_t now, bool early);
+
+        // Fill in the SUPERFRAME message that tells the host whether the OpenMote is locked and how long the superframes are
+        static void queueReport();
+    };
+}
+
+#endif // SNIFFER_SUPERFRAME_HPP
@@ -0,0 +1,98 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_survey.hpp"
+#include "sniffer_radio.hpp"
+
+namespace Sniffer
+{
+    int8_t   surveySamples[SURVEY_BLOCK_SAMPLES]; // RSSI in dBm, one sample per channel starting at surveyFirstChannel
+    uint8_t  surveySampleCount = 0;
+    uint8_t  surveyFirstChannel = 11;
+    uint8_t  surveyChannel = 11;
+    uint16_t surveySampleInterval = 0;
+    uint32_t surveyTimestamp = 0; // Time at which the first sample of the block was taken
+    bool     surveyRunning = false;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Survey::start(uint16_t sampleInterval)
+    {
+        Radio::disableTimerInterrupt();
+
+        surveySampleInterval = sampleInterval;
+        surveySampleCount = 0;
+        surveyChannel = 11;
+        surveyRunning = true;
+
+        tuneToCurrentChannel();
+        Radio::enableTimerInterrupt(Survey::timerInterruptHandler);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Survey::stop()
+    {
+        Radio::disableTimerInterrupt();
+
+        surveySampleCount = 0;
+        surveyRunning = false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Survey::isRunning()
+    {
+        return surveyRunning;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Survey::timerInterruptHandler()
+    {
+        // The RSSI only becomes valid a few symbol periods after the radio was turned on
+        if (!(HWREG(RFCORE_XREG_RSSISTAT) & RFCORE_XREG_RSSISTAT_RSSI_VALID))
+        {
+            Radio::scheduleTimerInterrupt(MAC_TIMER_MIN_COMPARE_DELAY);
+            return;
+        }
+
+        if (surveySampleCount == 0)
+        {
+            surveyTimestamp = Radio::getCurrentTime();
+            surveyFirstChannel = surveyChannel;
+        }
+
+        surveySamples[surveySampleCount++] = ((int8_t)HWREG(RFCORE_XREG_RSSI)) - CC2538_RF_RSSI_OFFSET;
+
+        // Store the samples in the buffer once the block is full, they are send to the host like packets
+        if (surveySampleCount == SURVEY_BLOCK_SAMPLES)
+        {
+            Radio::storeSamples(surveySamples, surveySampleCount, surveyFirstChannel, surveyTimestamp);
+            surveySampleCount = 0;
+        }
+
+        surveyChannel++;
+        if (surveyChannel > 26)
+            surveyChannel = 11;
+
+        tuneToCurrentChannel();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void Survey::tuneToCurrentChannel()
+    {
+        // The new frequency only takes effect after the radio recalibrates when it is turned on again
+        Radio::setChannel(surveyChannel);
+        CC2538_RF_CSP_ISRFOFF();
+        CC2538_RF_CSP_ISFLUSHRX();
+        CC2538_RF_CSP_ISRXON();
+
+        Radio::scheduleTimerInterrupt(surveySampleInterval);
+    }
+}
@@ -0,0 +1,36 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_SURVEY_HPP
+#define SNIFFER_SURVEY_HPP
+
+#include "sniffer_global.hpp"
+
+namespace Sniffer
+{
+    class Survey
+    {
+    public:
+        // Start sweeping over all channels, staying the given amount of MAC timer overflows on each channel
+        static void start(uint16_t sampleInterval);
+
+        // Stop taking samples, the samples of an incomplete block are discarded
+        static void stop();
+
+        // Check whether the buffer is being filled with RSSI samples instead of packets
+        static bool isRunning();
+
+        // Function called when the MAC timer overflow counter reaches the compare value
+        static void timerInterruptHandler();
+
+    private:
+        // Tune the radio to the channel that has to be sampled next
+        static void tuneToCurrentChannel();
+    };
+}
+
+#endif // SNIFFER_SURVEY_HPP
@@ -0,0 +1,124 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_sync.hpp"
+#include "sniffer_radio.hpp"
+#include "sniffer_serial_send.hpp"
+
+#define SYNC_NO_COUNTER     0xFFFFFFFF  // Send as previous counter when nothing was send on the channel yet
+
+namespace Sniffer
+{
+    uint16_t syncChannels = 0; // Bit 0 is channel 11, bit 15 is channel 26
+    uint16_t syncInterval = 0;
+    uint8_t  syncChannel = 11;
+    uint32_t syncCounter = 0;
+    bool     syncTransmitted = false; // Whether the SFD of the last frame still has to be stored
+    bool     syncRunning = false;
+
+    // Counter and SFD time of the last frame on every channel, which are only send in the next frame on that channel
+    uint32_t syncPreviousCounters[16];
+    uint32_t syncPreviousTimes[16];
+
+    uint8_t syncFrame[SYNC_FRAME_LENGTH - 2] = {
+        0x41, 0x08, // Data frame, PAN ID compression, short destination address and no source address
+        0x00,       // Sequence number
+        0xff, 0xff, // Broadcast PAN
+        0xff, 0xff, // Broadcast address
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool SyncBeacon::start(const uint8_t* data)
+    {
+        const uint16_t interval = readUint16((uint8_t*)data, SYNC_INTERVAL_OFFSET);
+        const uint16_t channels = readUint16((uint8_t*)data, SYNC_CHANNELS_OFFSET);
+        if ((interval < SYNC_MIN_INTERVAL) || (channels == 0))
+            return false;
+
+        reset();
+
+        syncInterval = interval;
+        syncChannels = channels;
+        syncChannel = 26;
+        syncCounter = 0;
+        syncTransmitted = false;
+        syncRunning = true;
+        for (uint8_t i = 0; i < 16; ++i)
+            syncPreviousCounters[i] = SYNC_NO_COUNTER;
+
+        // The host uses our current time to know which time of the pc the times in the frames correspond to
+        uint8_t answer[4];
+        writeUint32(answer, 0, Radio::getCurrentTime());
+        SerialSend::sendMessage(SerialDataType::Sync, answer, sizeof(answer));
+        led_green.on();
+
+        Radio::enableTimerInterrupt(SyncBeacon::timerInterruptHandler);
+        Radio::scheduleTimerInterrupt(syncInterval);
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void SyncBeacon::stop()
+    {
+        if (!syncRunning)
+            return;
+
+        Radio::disableTimerInterrupt();
+        CC2538_RF_CSP_ISRFOFF();
+        CC2538_RF_CSP_ISFLUSHTX();
+        syncRunning = false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void SyncBeacon::timerInterruptHandler()
+    {
+        // The previous frame was send long ago and the radio didn't receive anything, so the captured SFD belongs to it
+        if (syncTransmitted)
+        {
+            syncPreviousCounters[syncChannel - 11] = syncCounter - 1;
+            syncPreviousTimes[syncChannel - 11] = Radio::getSfdTime();
+        }
+
+        do
+        {
+            syncChannel++;
+            if (syncChannel > 26)
+                syncChannel = 11;
+        }
+        while (!(syncChannels & (1 << (syncChannel - 11))));
+
+        transmitFrame();
+        Radio::scheduleTimerInterrupt(syncInterval);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void SyncBeacon::transmitFrame()
+    {
+        syncFrame[2] = syncCounter & 0xff;
+        writeUint32(syncFrame, SYNC_FRAME_MAGIC_OFFSET, SYNC_FRAME_MAGIC);
+        writeUint32(syncFrame, SYNC_FRAME_COUNTER_OFFSET, syncCounter);
+        writeUint32(syncFrame, SYNC_FRAME_PREVIOUS_COUNTER_OFFSET, syncPreviousCounters[syncChannel - 11]);
+        writeUint32(syncFrame, SYNC_FRAME_PREVIOUS_TIME_OFFSET, syncPreviousTimes[syncChannel - 11]);
+
+        // The radio calibrates for the new channel when the transmission starts, the FCS is added by the radio
+        CC2538_RF_CSP_ISRFOFF();
+        CC2538_RF_CSP_ISFLUSHTX();
+        Radio::setChannel(syncChannel);
+        HWREG(RFCORE_SFR_RFDATA) = SYNC_FRAME_LENGTH;
+        for (uint8_t i = 0; i < sizeof(syncFrame); ++i)
+            HWREG(RFCORE_SFR_RFDATA) = syncFrame[i];
+
+        CC2538_RF_CSP_ISTXON();
+        syncCounter++;
+        syncTransmitted = true;
+        led_yellow.toggle();
+    }
+}
@@ -0,0 +1,35 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_SYNC_HPP
+#define SNIFFER_SYNC_HPP
+
+#include "sniffer_global.hpp"
+
+namespace Sniffer
+{
+    // Transmits the sync frames with which the host aligns the clocks of several sniffers to the clock of this OpenMote.
+    // The OpenMote doesn't capture anything while doing this, the radio is only turned on to transmit.
+    class SyncBeacon
+    {
+    public:
+        // Start transmitting with the interval and channels from the SYNC message, returns false when they are invalid
+        static bool start(const uint8_t* data);
+
+        // Stop transmitting sync frames
+        static void stop();
+
+        // Function called when the MAC timer overflow counter reaches the compare value
+        static void timerInterruptHandler();
+
+    private:
+        // Load the sync frame for the current channel into the TX FIFO and start transmitting it
+        static void transmitFrame();
+    };
+}
+
+#endif // SNIFFER_SYNC_HPP
@@ -0,0 +1,244 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_telemetry.hpp"
+#include "sniffer_radio.hpp"
+#include "sniffer_serial.hpp"
+
+#include "openmote-cc2538.h"
+
+namespace Sniffer
+{
+    // The interval is counted with the 32-bit microsecond timestamps, which wrap around after a bit more than an hour
+    const uint16_t TELEMETRY_MAX_INTERVAL = 3600;
+
+    bool     telemetryRunning = false;
+    bool     telemetrySensorsDetected = false;
+    uint8_t  telemetrySensors = 0;            // TELEMETRY_SENSOR_* bits of the sensors that answered when they were detected
+    uint32_t telemetryInterval;               // Microseconds between the start of two samples
+    uint32_t telemetryLastSampleTime;         // Time at which the last sample was started, which is also its timestamp
+
+    // Written by the I2C callbacks while a sample is being read, the serial task only looks at it when nothing is pending
+    uint8_t telemetrySample[TELEMETRY_RECORD_LENGTH];
+    volatile uint8_t telemetryPending = 0;    // Sensors of which the transactions didn't finish yet
+    bool telemetrySampleStarted = false;
+    bool telemetrySampleDeferred = false;     // The finished sample couldn't be stored yet and is tried again by the task
+
+    PlainCallback telemetryTemperatureCallback(&Telemetry::temperatureDone);
+    PlainCallback telemetryHumidityCallback(&Telemetry::humidityDone);
+    PlainCallback telemetryLightCallback(&Telemetry::lightDone);
+    PlainCallback telemetryAccelerationCallback(&Telemetry::accelerationDone);
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Telemetry::setInterval(const uint8_t* message)
+    {
+        const uint16_t interval = (message[TELEMETRY_INTERVAL_OFFSET] << 8) | message[TELEMETRY_INTERVAL_OFFSET + 1];
+        if (interval > TELEMETRY_MAX_INTERVAL)
+            return false;
+
+        if (interval == 0)
+        {
+            stop();
+            return true;
+        }
+
+        if (!telemetrySensorsDetected)
+        {
+            detectSensors();
+            telemetrySensorsDetected = true;
+        }
+
+        // The first sample is taken right away
+        telemetryInterval = interval * 1000000;
+        telemetryLastSampleTime = Radio::getCurrentTime() - telemetryInterval;
+        telemetryRunning = true;
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Telemetry::stop()
+    {
+        // Transactions that are still queued finish on their own, the next sample only starts when they are done
+        telemetryRunning = false;
+        telemetrySampleStarted = false;
+        telemetrySampleDeferred = false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Telemetry::sendPeriodically()
+    {
+        if (!telemetryRunning || (telemetryPending != 0))
+            return;
+
+        // All sensors answered, the sample is stored with the time at which it was started. When it can't be stored yet it is
+        // kept for the next time that the task runs, and no new sample is started until then.
+        if (telemetrySampleStarted)
+        {
+            telemetrySampleDeferred = !Radio::storeTelemetry(telemetrySample, telemetryLastSampleTime);
+            if (telemetrySampleDeferred)
+                return;
+
+            telemetrySampleStarted = false;
+        }
+
+        if (Radio::getCurrentTime() - telemetryLastSampleTime >= telemetryInterval)
+        {
+            telemetryLastSampleTime += telemetryInterval;
+
+            // Samples that were missed while the task was busy are skipped instead of being taken back to back
+            if (Radio::getCurrentTime() - telemetryLastSampleTime >= telemetryInterval)
+                telemetryLastSampleTime = Radio::getCurrentTime();
+
+            startSample();
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint32_t Telemetry::getTimeUntilNextSample()
+    {
+        // While a sample is being read the last callback wakes up the serial task
+        if (!telemetryRunning || (telemetryPending != 0))
+            return TIMEOUT_NONE;
+
+        // A deferred sample is tried again whenever the task wakes up, e.g. when the frame that was being received is finished
+        if (telemetrySampleDeferred)
+            return TIMEOUT_NONE;
+
+        if (telemetrySampleStarted)
+            return 0;
+
+        const uint32_t elapsed = Radio::getCurrentTime() - telemetryLastSampleTime;
+        if (elapsed >= telemetryInterval)
+            return 0;
+
+        return (telemetryInterval - elapsed + 999) / 1000;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Telemetry::detectSensors()
+    {
+#if !SNIFFER_NATIVE // The native build has no sensors, its samples only consist of the byte with the sensor bits
+        // The sensors are detected with the blocking functions, which can't be used anymore once the interrupt is enabled
+        i2c.enable();
+
+        if (sht21.isPresent() && sht21.enable())
+            telemetrySensors |= TELEMETRY_SENSOR_SHT21;
+        if (max44009.isPresent() && max44009.enable())
+            telemetrySensors |= TELEMETRY_SENSOR_MAX44009;
+        if (adxl346.isPresent() && adxl346.enable())
+            telemetrySensors |= TELEMETRY_SENSOR_ADXL346;
+
+        i2c.enableInterrupts();
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Telemetry::startSample()
+    {
+        for (uint8_t i = 0; i < TELEMETRY_RECORD_LENGTH; ++i)
+            telemetrySample[i] = 0;
+
+        telemetrySampleStarted = true;
+
+#if !SNIFFER_NATIVE
+        // No transaction can finish before the counter is set, the interrupt only runs once they are all queued.
+        // The SHT21 only measures one value at a time, the humidity is requested when the temperature is done.
+        const uint32_t interruptMask = enterCriticalSection();
+
+        uint8_t pending = 0;
+        if ((telemetrySensors & TELEMETRY_SENSOR_SHT21) && sht21.requestTemperature(&telemetryTemperatureCallback))
+            pending++;
+        if ((telemetrySensors & TELEMETRY_SENSOR_MAX44009) && max44009.requestLux(&telemetryLightCallback))
+            pending++;
+        if ((telemetrySensors & TELEMETRY_SENSOR_ADXL346) && adxl346.requestSample(&telemetryAccelerationCallback))
+            pending++;
+        telemetryPending = pending;
+
+        leaveCriticalSection(interruptMask);
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Telemetry::temperatureDone()
+    {
+#if !SNIFFER_NATIVE
+        if (!sht21.isRequestSucceeded())
+        {
+            sensorDone();
+            return;
+        }
+
+        writeUint16(telemetrySample, TELEMETRY_TEMPERATURE_OFFSET, sht21.getTemperatureRaw());
+        if (!sht21.requestHumidity(&telemetryHumidityCallback))
+            sensorDone();
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Telemetry::humidityDone()
+    {
+#if !SNIFFER_NATIVE
+        // The sensor bit is only set when both values were read
+        if (sht21.isRequestSucceeded())
+        {
+            writeUint16(telemetrySample, TELEMETRY_HUMIDITY_OFFSET, sht21.getHumidityRaw());
+            telemetrySample[TELEMETRY_SENSORS_OFFSET] |= TELEMETRY_SENSOR_SHT21;
+        }
+        sensorDone();
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Telemetry::lightDone()
+    {
+#if !SNIFFER_NATIVE
+        if (max44009.isRequestSucceeded())
+        {
+            writeUint16(telemetrySample, TELEMETRY_LIGHT_OFFSET, max44009.getLuxRaw());
+            telemetrySample[TELEMETRY_SENSORS_OFFSET] |= TELEMETRY_SENSOR_MAX44009;
+        }
+        sensorDone();
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Telemetry::accelerationDone()
+    {
+#if !SNIFFER_NATIVE
+        if (adxl346.isRequestSucceeded())
+        {
+            uint16_t x, y, z;
+            adxl346.getSample(&x, &y, &z);
+            writeUint16(telemetrySample, TELEMETRY_ACCELERATION_OFFSET, x);
+            writeUint16(telemetrySample, TELEMETRY_ACCELERATION_OFFSET + 2, y);
+            writeUint16(telemetrySample, TELEMETRY_ACCELERATION_OFFSET + 4, z);
+            telemetrySample[TELEMETRY_SENSORS_OFFSET] |= TELEMETRY_SENSOR_ADXL346;
+        }
+        sensorDone();
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Telemetry::sensorDone()
+    {
+        // Called from the I2C interrupt, the serial task only changes the counter while the interrupts are disabled
+        telemetryPending = telemetryPending - 1;
+        if (telemetryPending == 0)
+            Serial::notifyFromInterrupt();
+    }
+}
@@ -0,0 +1,52 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_TELEMETRY_HPP
+#define SNIFFER_TELEMETRY_HPP
+
+#include "sniffer_global.hpp"
+
+namespace Sniffer
+{
+    // Reads the sensors of the board at a fixed interval and stores the readings as records between the frames.
+    // The I2C transactions run from the I2C interrupt, so the serial task only starts a sample and stores it when it is done.
+    class Telemetry
+    {
+    public:
+        // Start sampling with the interval of the TELEMETRY message, or stop when it is 0.
+        // Returns false when the interval is too long.
+        static bool setInterval(const uint8_t* message);
+
+        // Stop sampling, a sample that is still being read is discarded
+        static void stop();
+
+        // Start a sample when the interval passed and store it once all sensors answered, called from the serial task.
+        // A sample that can't be stored yet is kept and stored the next time.
+        static void sendPeriodically();
+
+        // Milliseconds until sendPeriodically has to start the next sample, or TIMEOUT_NONE when not sampling
+        static uint32_t getTimeUntilNextSample();
+
+        // Functions called from the I2C interrupt when the transactions of a sensor are done
+        static void temperatureDone();
+        static void humidityDone();
+        static void lightDone();
+        static void accelerationDone();
+
+    private:
+        // Find out which sensors are on the board and switch them on, the first time that sampling starts
+        static void detectSensors();
+
+        // Queue the I2C transactions of all sensors that were found
+        static void startSample();
+
+        // Count a sensor as done and wake up the serial task when it was the last one
+        static void sensorDone();
+    };
+}
+
+#endif // SNIFFER_TELEMETRY_HPP
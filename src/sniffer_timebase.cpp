@@ -0,0 +1,84 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_timebase.hpp"
+#include "sniffer_radio.hpp"
+
+namespace Sniffer
+{
+    // The serial task runs at least every WATCHDOG_KICK_INTERVAL, far more often than the timestamps wrap (every 71 minutes)
+    uint32_t timebaseWraps = 0;
+    uint32_t timebaseLastTime = 0;
+    uint32_t timebaseLastSyncTime = 0;  // Time at which the last record was stored
+    bool     timebaseEnabled = false;
+    bool     timebaseSyncPending = false;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Timebase::enable(bool enabled)
+    {
+        timebaseEnabled = enabled;
+        timebaseSyncPending = enabled;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Timebase::sendPeriodically()
+    {
+        const uint64_t now = getCurrentTime();
+        if (!timebaseEnabled)
+            return;
+
+        if (static_cast<uint32_t>(now) - timebaseLastSyncTime >= TIMEBASE_SYNC_INTERVAL)
+            timebaseSyncPending = true;
+
+        if (!timebaseSyncPending)
+            return;
+
+        // A record that doesn't fit, or that storeRecord refuses while a frame is being copied into the buffer, stays pending
+        // and is tried again the next time that the task runs. It is built again then, so its time matches its timestamp, and
+        // the next period only starts once it is stored.
+        uint8_t data[TIMEBASE_RECORD_LENGTH];
+        writeUint32(data, TIMEBASE_TIME_OFFSET, static_cast<uint32_t>(now >> 32));
+        writeUint32(data, TIMEBASE_TIME_OFFSET + 4, static_cast<uint32_t>(now));
+        if (Radio::storeRecord(RECORD_TYPE_TIMEBASE, data, TIMEBASE_RECORD_LENGTH, static_cast<uint32_t>(now)))
+        {
+            timebaseLastSyncTime = static_cast<uint32_t>(now);
+            timebaseSyncPending = false;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint32_t Timebase::getTimeUntilNextSync()
+    {
+        if (!timebaseEnabled)
+            return TIMEOUT_NONE;
+
+        // A record that didn't fit is tried again whenever the task wakes up
+        if (timebaseSyncPending)
+            return TIMEOUT_NONE;
+
+        const uint32_t elapsed = Radio::getCurrentTime() - timebaseLastSyncTime;
+        if (elapsed >= TIMEBASE_SYNC_INTERVAL)
+            return 0;
+
+        return (TIMEBASE_SYNC_INTERVAL - elapsed + 999) / 1000;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint64_t Timebase::getCurrentTime()
+    {
+        const uint32_t time = Radio::getCurrentTime();
+        if (time < timebaseLastTime)
+            timebaseWraps++;
+
+        timebaseLastTime = time;
+        return (static_cast<uint64_t>(timebaseWraps) << 32) | time;
+    }
+}
@@ -0,0 +1,34 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_TIMEBASE_HPP
+#define SNIFFER_TIMEBASE_HPP
+
+#include "sniffer_global.hpp"
+
+namespace Sniffer
+{
+    // Counts how often the 32-bit timestamps wrapped around and stores the full 64-bit time as a record between the frames
+    // every TIMEBASE_SYNC_INTERVAL, so that the host never has to guess the wraps during a long time without records.
+    class Timebase
+    {
+    public:
+        // Start or stop storing the time records of the TIMEBASE message, the first one is stored right away
+        static void enable(bool enabled);
+
+        // Count the wraps and store a record when the interval passed, called from the serial task
+        static void sendPeriodically();
+
+        // Milliseconds until sendPeriodically has to store the next record, or TIMEOUT_NONE when not enabled
+        static uint32_t getTimeUntilNextSync();
+
+        // The time of Radio::getCurrentTime with the wraps in front of it, called from the serial task
+        static uint64_t getCurrentTime();
+    };
+}
+
+#endif // SNIFFER_TIMEBASE_HPP
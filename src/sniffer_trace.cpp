@@ -0,0 +1,155 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_trace.hpp"
+#include "sniffer_serial_send.hpp"
+#include "sniffer_profiling.hpp"
+
+namespace Sniffer
+{
+#if TRACE_RECORDER
+    struct TraceEntry
+    {
+        uint32_t cycles;
+        uint8_t  event;
+        uint8_t  arg;
+    };
+
+    TraceEntry traceRing[TRACE_RING_EVENTS];
+    uint16_t traceWriteIndex = 0; // Events that were ever added, modulo the size of the ring
+    uint16_t traceReadIndex = 0;
+    uint16_t traceLost = 0;       // Events that didn't fit since the last TRACE message
+    void*    traceSerialTask = 0;
+    volatile bool traceEnabled = false;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline uint16_t tracePending()
+    {
+        return (traceWriteIndex + TRACE_RING_EVENTS - traceReadIndex) % TRACE_RING_EVENTS;
+    }
+#endif
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Trace::setSerialTask(void* task)
+    {
+#if TRACE_RECORDER
+        traceSerialTask = task;
+#else
+        (void)task;
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Trace::enable(bool enabled)
+    {
+#if TRACE_RECORDER
+        const uint32_t interruptMask = enterCriticalSection();
+        traceEnabled = enabled;
+        traceReadIndex = traceWriteIndex;
+        traceLost = 0;
+        leaveCriticalSection(interruptMask);
+#else
+        (void)enabled;
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Trace::sendPeriodically()
+    {
+#if TRACE_RECORDER
+        // The events only use the link when the records don't need it, unless the ring would otherwise overflow
+        const uint16_t pending = tracePending();
+        if (!traceEnabled || (pending == 0))
+            return;
+        if ((pending < TRACE_REPORT_MAX_EVENTS) && (bufferIndexSerialSend != bufferIndexRadio))
+            return;
+
+        uint8_t data[2 + TRACE_REPORT_MAX_EVENTS * TRACE_EVENT_LENGTH];
+        const uint8_t count = (pending < TRACE_REPORT_MAX_EVENTS) ? pending : TRACE_REPORT_MAX_EVENTS;
+        const uint32_t interruptMask = enterCriticalSection();
+        writeUint16(data, 0, traceLost);
+        for (uint8_t i = 0; i < count; ++i)
+        {
+            const TraceEntry& entry = traceRing[(traceReadIndex + i) % TRACE_RING_EVENTS];
+            writeUint32(data, 2 + i * TRACE_EVENT_LENGTH, entry.cycles);
+            data[2 + i * TRACE_EVENT_LENGTH + 4] = entry.event;
+            data[2 + i * TRACE_EVENT_LENGTH + 5] = entry.arg;
+        }
+
+        traceReadIndex = (traceReadIndex + count) % TRACE_RING_EVENTS;
+        traceLost = 0;
+        leaveCriticalSection(interruptMask);
+
+        SerialSend::sendMessage(SerialDataType::Trace, data, 2 + count * TRACE_EVENT_LENGTH);
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#if TRACE_RECORDER
+    void Trace::taskSwitchedIn(void* task)
+    {
+        record(TraceEvent::TaskSwitchedIn, (task == traceSerialTask) ? 1 : 0);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION void Trace::addEvent(uint8_t event, uint8_t arg)
+    {
+        if (!traceEnabled)
+            return;
+
+        // The interrupts have different priorities, an event may not be added halfway through another one.
+        // One entry of the ring stays unused to tell a full ring from an empty one.
+        const uint32_t interruptMask = enterCriticalSection();
+        const uint16_t nextIndex = (traceWriteIndex + 1) % TRACE_RING_EVENTS;
+        if (nextIndex == traceReadIndex)
+        {
+            if (traceLost < 0xffff)
+                traceLost++;
+        }
+        else
+        {
+            TraceEntry& entry = traceRing[traceWriteIndex];
+            entry.cycles = HWREG(DWT_CYCCNT);
+            entry.event = event;
+            entry.arg = arg;
+            traceWriteIndex = nextIndex;
+        }
+        leaveCriticalSection(interruptMask);
+    }
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#if TRACE_RECORDER
+// Hooks of the kernel, see the trace macros in FreeRTOSConfig.h
+extern "C" void snifferTraceTaskSwitchedIn(void* task)
+{
+    Sniffer::Trace::taskSwitchedIn(task);
+}
+
+extern "C" void snifferTraceTaskBlocked()
+{
+    Sniffer::Trace::record(Sniffer::TraceEvent::TaskBlocked);
+}
+
+extern "C" void snifferTraceTick()
+{
+    Sniffer::Trace::record(Sniffer::TraceEvent::Tick);
+}
+
+extern "C" void snifferTraceGivenFromIsr()
+{
+    Sniffer::Trace::record(Sniffer::TraceEvent::GivenFromIsr);
+}
+#endif
@@ -0,0 +1,64 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_TRACE_HPP
+#define SNIFFER_TRACE_HPP
+
+#include "sniffer_global.hpp"
+
+namespace Sniffer
+{
+    namespace TraceEvent
+    {
+        enum TraceEvent
+        {
+            TaskSwitchedIn  = 0, // The argument is the task that runs from now on: 0 for the idle task, 1 for the serial task
+            TaskBlocked     = 1, // The running task waits for a semaphore or mutex
+            Tick            = 2, // The tick interrupt of FreeRTOS
+            GivenFromIsr    = 3, // An interrupt gave a semaphore, which wakes up the serial task
+            RadioIsrEnter   = 4,
+            RadioIsrExit    = 5,
+            UartIsrEnter    = 6,
+            UartIsrExit     = 7,
+            Retransmit      = 8  // The records are send again from the oldest unacknowledged one: 0 after the retransmit threshold, 1 after a NACK
+        };
+    }
+
+    // Keeps a ring of scheduling and interrupt events, which is only filled while the host asked for it. It only exists in
+    // a build with TRACE_RECORDER, otherwise record does nothing.
+    class Trace
+    {
+    public:
+        // Remember the handle of the serial task to tell it apart from the idle task, called before the scheduler starts
+        static void setSerialTask(void* task);
+
+        // Start or stop recording, the events that weren't send yet are discarded
+        static void enable(bool enabled);
+
+        // Send the events when the records are all send or a message is full, called from the serial task
+        static void sendPeriodically();
+
+        // Add an event to the ring, from any task or interrupt
+        static inline void record(uint8_t event, uint8_t arg = 0)
+        {
+#if TRACE_RECORDER
+            addEvent(event, arg);
+#else
+            (void)event;
+            (void)arg;
+#endif
+        }
+
+        // Called from the hook of FreeRTOS when a task was switched in
+        static void taskSwitchedIn(void* task);
+
+    private:
+        static void addEvent(uint8_t event, uint8_t arg);
+    };
+}
+
+#endif // SNIFFER_TRACE_HPP
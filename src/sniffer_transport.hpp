@@ -0,0 +1,57 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_TRANSPORT_HPP
+#define SNIFFER_TRANSPORT_HPP
+
+// The serial protocol (HDLC framing, ACK/NACK and the sequence numbers) doesn't depend on how the bytes reach the host.
+// A transport is a class with the static functions below. Which one is used is decided at compile time, so that all
+// calls are direct calls (which link-time optimization can inline) instead of going through virtual functions.
+//
+//   initialize()                   Set up the hardware, received bytes are stored in rxBuffer and rxBufferIndexWrite is moved
+//   poll()                         Store the received bytes in rxBuffer when this can't happen from an interrupt
+//   isTransmitting()               Check whether the data given to transmit is still being handed to the hardware, on any lane
+//   isLaneTransmitting(lane)       Check whether the packet that was given to the lane is still being handed to the hardware
+//   transmit(lane, data, length)   Start sending an encoded packet, Serial::notifyFromInterrupt is called when it is done.
+//                                  Each of the SERIAL_TX_LANES lanes sends its own packet at the same time as the others.
+//   writeByte(byte)                Send a byte directly, waiting when needed (only used while not transmitting)
+//   flush()                        Send the bytes that the transport might still be holding on to, called before the serial task sleeps
+//   getDefaultBaudrate()           Speed of the link (in bits per second, with 10 bits per byte) until another baudrate is set
+//   isBaudrateSupported(rate)      Check whether the host may switch to the requested baudrate
+//   getMaxBaudrate()               Highest baudrate that might be supported, the default one when it can't be changed
+//   setBaudrate(rate)              Switch to a baudrate that is supported
+
+// SNIFFER_NATIVE is only set by the Makefile in native/, which builds the sniffer for the pc against emulated hardware.
+
+#if SNIFFER_NATIVE
+    #include "sniffer_native.hpp"
+#elif SNIFFER_USB
+    #include "sniffer_usb.hpp"
+#elif SNIFFER_ETHERNET
+    #include "sniffer_ethernet.hpp"
+#elif SNIFFER_SPI_SLAVE
+    #include "sniffer_spi_slave.hpp"
+#else
+    #include "sniffer_uart.hpp"
+#endif
+
+namespace Sniffer
+{
+#if SNIFFER_NATIVE
+    typedef NativeTransport Transport;
+#elif SNIFFER_USB
+    typedef UsbTransport Transport;
+#elif SNIFFER_ETHERNET
+    typedef EthernetTransport Transport;
+#elif SNIFFER_SPI_SLAVE
+    typedef SpiSlaveTransport Transport;
+#else
+    typedef UartTransport Transport;
+#endif
+}
+
+#endif // SNIFFER_TRANSPORT_HPP
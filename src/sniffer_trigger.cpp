@@ -0,0 +1,296 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_trigger.hpp"
+#include "sniffer_serial_send.hpp"
+#include "sniffer_survey.hpp"
+#include "sniffer_summary.hpp"
+#include "sniffer_zep.hpp"
+
+namespace Sniffer
+{
+    namespace TriggerState
+    {
+        enum TriggerState
+        {
+            Idle     = 0, // No trigger, the records are send as soon as they are stored
+            Armed    = 1, // Waiting for a frame that matches, the records are held back
+            Fired    = 2, // A frame matched, the frames behind it are still being stored
+            Complete = 3  // All post-trigger frames were stored, further frames are ignored
+        };
+    }
+
+    // The radio interrupt moves the state forward, the serial task only sets it while the radio interrupt leaves it alone
+    volatile uint8_t triggerState = TriggerState::Idle;
+
+    uint8_t  triggerFields;
+    uint8_t  triggerFrameType;
+    uint8_t  triggerAddrMode;
+    uint8_t  triggerAddr[8];
+    uint8_t  triggerPatternOffset;
+    uint8_t  triggerPatternLength;
+    uint8_t  triggerPattern[TRIGGER_MAX_PATTERN_LEN];
+    uint16_t triggerPreFrames;
+    uint16_t triggerPostFrames;
+
+    // Written by the radio interrupt when the trigger matches
+    volatile uint16_t triggerIndex; // Index of the record of the frame that matched
+    volatile uint16_t triggerSeqNr;
+    uint16_t triggerPostRemaining;
+
+    // Only used by the serial task, the window starts at the oldest record that is kept
+    uint16_t triggerIndexWindow;
+    uint16_t triggerIndexCounted; // Records before this index are counted in triggerWindowFrames
+    uint16_t triggerWindowFrames;
+    uint32_t triggerDiscardedRecords;
+    bool     triggerReported = false;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Trigger::arm(const uint8_t* message)
+    {
+        // ZEP packets aren't held back, and in survey and summary mode there are no frames in the buffer.
+        // A trigger can only be armed once per session, the radio interrupt may use the fields as soon as it is armed.
+        if (!hostSessionActive || Zep::isEnabled() || Survey::isRunning() || Summary::isRunning()
+         || (triggerState != TriggerState::Idle))
+            return false;
+
+        const uint8_t fields = message[TRIGGER_FIELDS_OFFSET];
+        const uint8_t addrMode = message[TRIGGER_ADDR_MODE_OFFSET];
+        const uint8_t patternOffset = message[TRIGGER_PATTERN_OFFSET_OFFSET];
+        const uint8_t patternLength = message[TRIGGER_PATTERN_LENGTH_OFFSET];
+        if ((fields == 0)
+         || ((fields & (TRIGGER_MATCH_DST_ADDR | TRIGGER_MATCH_SRC_ADDR)) && (addrMode != 2) && (addrMode != 3))
+         || ((fields & TRIGGER_MATCH_PATTERN) && ((patternLength == 0) || (patternLength > TRIGGER_MAX_PATTERN_LEN)
+                                                  || (patternOffset + patternLength > CC2538_RF_MAX_PACKET_LEN - 2))))
+            return false;
+
+        triggerFields = fields;
+        triggerFrameType = message[TRIGGER_FRAME_TYPE_OFFSET];
+        triggerAddrMode = addrMode;
+        for (uint8_t i = 0; i < 8; ++i)
+            triggerAddr[i] = message[TRIGGER_ADDR_OFFSET + i];
+
+        triggerPatternOffset = patternOffset;
+        triggerPatternLength = patternLength;
+        for (uint8_t i = 0; i < TRIGGER_MAX_PATTERN_LEN; ++i)
+            triggerPattern[i] = message[TRIGGER_PATTERN_OFFSET + i];
+
+        triggerPreFrames = readUint16((uint8_t*)message, TRIGGER_PRE_FRAMES_OFFSET);
+        triggerPostFrames = readUint16((uint8_t*)message, TRIGGER_POST_FRAMES_OFFSET);
+
+        // The records that weren't send yet are the first ones in the window
+        triggerIndexWindow = bufferIndexSerialSend;
+        triggerIndexCounted = bufferIndexSerialSend;
+        triggerWindowFrames = 0;
+        triggerDiscardedRecords = 0;
+        triggerReported = false;
+        triggerState = TriggerState::Armed;
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Trigger::disarm()
+    {
+        triggerState = TriggerState::Idle;
+        triggerReported = false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Trigger::isArmed()
+    {
+        return (triggerState != TriggerState::Idle);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Trigger::isHoldingRecords()
+    {
+        return (triggerState != TriggerState::Idle) && !triggerReported;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Trigger::process()
+    {
+        // The radio index is read before the state. When the trigger still didn't match afterwards, then all records
+        // in front of that index were stored before the frame that will match, so they all belong to the window.
+        const uint16_t cachedBufferIndexRadio = bufferIndexRadio;
+        if (triggerState == TriggerState::Armed)
+        {
+            countFrames(cachedBufferIndexRadio);
+            trimWindow(cachedBufferIndexRadio);
+            return false;
+        }
+
+        // The window ends right before the frame that matched
+        countFrames(triggerIndex);
+        trimWindow(triggerIndex);
+
+        uint8_t data[TRIGGER_REPORT_LENGTH];
+        writeUint16(data, 0, bufferIndexAcked);
+        writeUint16(data, 2, readUint16(buffer, bufferIndexAcked + BUFFER_SEQNR_OFFSET));
+        writeUint16(data, 4, triggerSeqNr);
+        writeUint16(data, 6, triggerWindowFrames);
+        writeUint32(data, 8, triggerDiscardedRecords);
+        SerialSend::sendMessage(SerialDataType::Trigger, data, sizeof(data));
+
+        // Without discarded records the host simply continues with the next sequence number
+        if (triggerDiscardedRecords > 0)
+        {
+            bufferIndexSerialSend = triggerIndexWindow;
+            selectiveRepeatRemaining = 0;
+        }
+
+        triggerReported = true;
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION bool Trigger::accept(const uint8_t* frame, uint8_t length)
+    {
+        if (triggerState == TriggerState::Idle)
+            return true;
+
+        if (triggerState == TriggerState::Armed)
+        {
+            if (!matchFrame(frame, length))
+                return true;
+
+            // The record of this frame is at the radio index and already got its sequence number
+            triggerIndex = bufferIndexRadio;
+            triggerSeqNr = seqNr - 1;
+            triggerPostRemaining = triggerPostFrames;
+            triggerState = (triggerPostFrames == 0) ? TriggerState::Complete : TriggerState::Fired;
+            return true;
+        }
+
+        if (triggerState == TriggerState::Fired)
+        {
+            if (--triggerPostRemaining == 0)
+                triggerState = TriggerState::Complete;
+
+            return true;
+        }
+
+        return false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION inline bool Trigger::matchFrame(const uint8_t* frame, uint8_t length)
+    {
+        // The last two bytes are the RSSI and CRC/LQI
+        const uint8_t headerLength = length - 2;
+        if (headerLength < 3)
+            return false;
+
+        const uint16_t frameControl = frame[0] | (frame[1] << 8);
+        if ((triggerFields & TRIGGER_MATCH_FRAME_TYPE) && ((frameControl & 0x07) != triggerFrameType))
+            return false;
+
+        if (triggerFields & TRIGGER_MATCH_PATTERN)
+        {
+            if (triggerPatternOffset + triggerPatternLength > headerLength)
+                return false;
+
+            for (uint8_t i = 0; i < triggerPatternLength; ++i)
+            {
+                if (frame[triggerPatternOffset + i] != triggerPattern[i])
+                    return false;
+            }
+        }
+
+        if (!(triggerFields & (TRIGGER_MATCH_DST_ADDR | TRIGGER_MATCH_SRC_ADDR)))
+            return true;
+
+        // Find the address in the addressing fields
+        const uint8_t dstAddrMode = (frameControl >> 10) & 0x03;
+        const uint8_t srcAddrMode = (frameControl >> 14) & 0x03;
+        uint8_t pos = 3; // Frame control field and sequence number
+        if (dstAddrMode >= 2)
+        {
+            if (triggerFields & TRIGGER_MATCH_DST_ADDR)
+            {
+                return (dstAddrMode == triggerAddrMode) && (pos + 2 + ((dstAddrMode == 2) ? 2 : 8) <= headerLength)
+                    && matchAddress(&frame[pos + 2]);
+            }
+
+            pos += 2 + ((dstAddrMode == 2) ? 2 : 8);
+        }
+        else if (triggerFields & TRIGGER_MATCH_DST_ADDR)
+            return false;
+
+        if (!((frameControl >> 6) & 0x01)) // PAN ID compression
+            pos += 2;
+
+        return (srcAddrMode == triggerAddrMode) && (pos + ((srcAddrMode == 2) ? 2 : 8) <= headerLength)
+            && matchAddress(&frame[pos]);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION inline bool Trigger::matchAddress(const uint8_t* addr)
+    {
+        const uint8_t addrLen = (triggerAddrMode == 2) ? 2 : 8;
+        for (uint8_t i = 0; i < addrLen; ++i)
+        {
+            if (addr[addrLen - 1 - i] != triggerAddr[i])
+                return false;
+        }
+
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Trigger::countFrames(uint16_t endIndex)
+    {
+        // Channel markers are kept in the window as well, but only the frames are counted
+        while (triggerIndexCounted != endIndex)
+        {
+            const uint16_t nextIndex = bufferSkipUnusedEnd(triggerIndexCounted, endIndex);
+            if (nextIndex != triggerIndexCounted)
+            {
+                triggerIndexCounted = nextIndex;
+                continue;
+            }
+
+            if (buffer[triggerIndexCounted + BUFFER_ORIGINAL_LENGTH_OFFSET] != 0)
+                triggerWindowFrames++;
+
+            triggerIndexCounted += buffer[triggerIndexCounted];
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Trigger::trimWindow(uint16_t endIndex)
+    {
+        // A discarded record is treated as if the host acknowledged it, so that the radio can reuse its space
+        while ((triggerIndexWindow != triggerIndexCounted)
+            && ((triggerWindowFrames > triggerPreFrames) || (bufferDistance(triggerIndexWindow, endIndex) > TRIGGER_MAX_WINDOW_LEN)))
+        {
+            const uint16_t nextIndex = bufferSkipUnusedEnd(triggerIndexWindow, triggerIndexCounted);
+            if (nextIndex != triggerIndexWindow)
+            {
+                triggerIndexWindow = nextIndex;
+                continue;
+            }
+
+            if (buffer[triggerIndexWindow + BUFFER_ORIGINAL_LENGTH_OFFSET] != 0)
+                triggerWindowFrames--;
+
+            bufferIndexAcked = triggerIndexWindow;
+            triggerIndexWindow += buffer[triggerIndexWindow];
+            triggerDiscardedRecords++;
+        }
+    }
+}
@@ -0,0 +1,55 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_TRIGGER_HPP
+#define SNIFFER_TRIGGER_HPP
+
+#include "sniffer_global.hpp"
+
+namespace Sniffer
+{
+    // Keeps the records in the buffer without sending them until a frame matches the trigger, only a window of the last
+    // frames before it is kept. The window, the frame that matched and the frames behind it are send as usual afterwards.
+    class Trigger
+    {
+    public:
+        // Start waiting for a frame that matches the trigger of the TRIGGER message, returns false when it can't be used
+        static bool arm(const uint8_t* message);
+
+        // Forget about the trigger, called when the buffer is reset
+        static void disarm();
+
+        // Check whether a trigger was armed since the last reset
+        static bool isArmed();
+
+        // Check whether the records in the buffer may not be send yet
+        static bool isHoldingRecords();
+
+        // Called from the serial task while the records are held back. Discards the records that fell out of the window,
+        // or tells the host where the records start once the trigger matched. Returns true when records can be send again.
+        static bool process();
+
+        // Called from the radio interrupt for every frame that passed the filter, the length includes the RSSI and
+        // CRC/LQI bytes. Returns false when the frame comes after the capture and may not be stored.
+        static bool accept(const uint8_t* frame, uint8_t length);
+
+    private:
+        // Check whether the frame matches on all fields of the trigger
+        static bool matchFrame(const uint8_t* frame, uint8_t length);
+
+        // Compare an address from the frame (little endian) with the address from the trigger (big endian)
+        static bool matchAddress(const uint8_t* addr);
+
+        // Count the frames in the records that were stored before the given index and weren't counted yet
+        static void countFrames(uint16_t endIndex);
+
+        // Discard the oldest records until the window is small enough, it ends at the given index
+        static void trimWindow(uint16_t endIndex);
+    };
+}
+
+#endif // SNIFFER_TRIGGER_HPP
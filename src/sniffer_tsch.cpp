@@ -0,0 +1,478 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_tsch.hpp"
+#include "sniffer_channel_hopping.hpp"
+#include "sniffer_inject.hpp"
+#include "sniffer_filter.hpp"
+#include "sniffer_radio.hpp"
+#include "sniffer_serial_send.hpp"
+#include "sniffer_survey.hpp"
+
+namespace Sniffer
+{
+    namespace TschState
+    {
+        enum TschState
+        {
+            Idle      = 0, // Not following a network
+            Searching = 1, // Waiting on the current channel for an enhanced beacon
+            Locked    = 2  // The radio is tuned to the channel of every timeslot
+        };
+    }
+
+    // The default hopping sequence of IEEE 802.15.4 for the 16 channels in the 2.4 GHz band, used by beacons that only give its ID
+    const uint8_t tschDefaultSequence[TSCH_MAX_SEQUENCE_LEN] = { 16, 17, 23, 18, 26, 15, 25, 22, 19, 11, 12, 13, 24, 14, 20, 21 };
+
+    // The radio interrupt and the timer interrupt have the same priority, the serial task only changes the state when idle
+    volatile uint8_t tschState = TschState::Idle;
+
+    // What the host asked for
+    uint8_t  tschRequestedOffset;
+    uint16_t tschRequestedPan;
+    uint8_t  tschHostSequence[TSCH_MAX_SEQUENCE_LEN];
+    uint8_t  tschHostSequenceLength;
+
+    // The network that is being followed
+    uint16_t tschPanId;
+    uint8_t  tschSequence[TSCH_MAX_SEQUENCE_LEN];
+    uint8_t  tschSequenceLength;
+    uint8_t  tschChannelOffset;
+    uint8_t  tschHopIndex; // Entry of the hopping sequence for the current timeslot
+    uint64_t tschAsn;
+    uint32_t tschSlotStart;
+    uint16_t tschTimeslotLength;
+    uint16_t tschTxOffset;
+    uint16_t tschRxWait;
+    uint32_t tschLastSync; // Time of the last frame that the timeslots were aligned with
+
+    // Filled in by parseBeacon
+    uint64_t tschBeaconAsn;
+    uint16_t tschBeaconPan;
+    uint16_t tschBeaconTimeslotLength;
+    uint16_t tschBeaconTxOffset;
+    uint16_t tschBeaconRxWait;
+    uint8_t  tschBeaconSequence[TSCH_MAX_SEQUENCE_LEN];
+    uint8_t  tschBeaconSequenceLength;
+
+    uint8_t tschReport[TSCH_REPORT_LENGTH];
+    bool    tschReportPending = false;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Tsch::start(const uint8_t* message)
+    {
+        // The survey changes the channel itself and also uses the timer interrupt, just like injecting frames
+        const uint8_t channelOffset = message[TSCH_CHANNEL_OFFSET_OFFSET];
+        const uint8_t sequenceLength = message[TSCH_SEQUENCE_LENGTH_OFFSET];
+        if ((sequenceLength > TSCH_MAX_SEQUENCE_LEN) || Survey::isRunning() || Inject::isActive()
+         || ((channelOffset >= TSCH_MAX_SEQUENCE_LEN) && (channelOffset != TSCH_CHANNEL_OFFSET_FROM_BEACON)))
+            return false;
+
+        for (uint8_t i = 0; i < sequenceLength; ++i)
+        {
+            const uint8_t channel = message[TSCH_SEQUENCE_OFFSET + i];
+            if ((channel < 11) || (channel > 26))
+                return false;
+        }
+
+        // Any hopping schedule and a network that was followed before are forgotten
+        ChannelHopping::stop();
+
+        tschRequestedOffset = channelOffset;
+        tschRequestedPan = readUint16((uint8_t*)message, TSCH_PAN_OFFSET);
+        tschHostSequenceLength = sequenceLength;
+        for (uint8_t i = 0; i < sequenceLength; ++i)
+            tschHostSequence[i] = message[TSCH_SEQUENCE_OFFSET + i];
+
+        tschPanId = tschRequestedPan;
+        tschState = TschState::Searching;
+        Filter::updateRadioFilter();
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Tsch::stop()
+    {
+        if (tschState == TschState::Locked)
+            Radio::disableTimerInterrupt();
+
+        tschState = TschState::Idle;
+        tschReportPending = false;
+        Filter::updateRadioFilter();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Tsch::isRunning()
+    {
+        return (tschState != TschState::Idle);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SNIFFER_RAM_FUNCTION void Tsch::processFrame(const uint8_t* frame, uint8_t length, uint32_t timestamp)
+    {
+        // Only frames with a correct FCS tell anything about the network
+        if ((tschState == TschState::Idle) || !(frame[length - 1] & 0x80))
+            return;
+
+        if (parseBeacon(frame, length))
+            synchronize(timestamp);
+        else if (tschState == TschState::Locked)
+            adjustTimeslots(timestamp);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Tsch::sendPeriodically()
+    {
+        if (!tschReportPending)
+            return;
+
+        tschReportPending = false;
+        SerialSend::sendMessage(SerialDataType::Tsch, tschReport, sizeof(tschReport));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Tsch::timerInterruptHandler()
+    {
+        // Never switch channel in the middle of a packet, try again a bit later instead
+        if (Radio::isReceiving())
+        {
+            Radio::scheduleTimerInterrupt(MAC_TIMER_MIN_COMPARE_DELAY);
+            return;
+        }
+
+        // Without frames the timeslots drift away from those of the network, it is searched for again on the last channel
+        const uint32_t now = Radio::getCurrentTime();
+        if (now - tschLastSync > TSCH_SYNC_TIMEOUT)
+        {
+            Radio::disableTimerInterrupt();
+            IntPendClear(INT_MACTIMR);
+            HWREG(RFCORE_SFR_MTIRQF) = 0;
+
+            tschPanId = tschRequestedPan;
+            tschState = TschState::Searching;
+            queueReport();
+            return;
+        }
+
+        followCurrentTimeslot(now);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Tsch::queueReport()
+    {
+        tschReport[0] = (tschState == TschState::Locked) ? 1 : 0;
+        tschReport[1] = static_cast<uint8_t>(tschAsn >> 32);
+        writeUint32(tschReport, 2, static_cast<uint32_t>(tschAsn));
+        writeUint32(tschReport, 6, tschSlotStart);
+        tschReport[10] = tschChannelOffset;
+        tschReport[11] = tschSequenceLength;
+        writeUint16(tschReport, 12, tschTimeslotLength);
+        tschReportPending = true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Tsch::parseBeacon(const uint8_t* frame, uint8_t length)
+    {
+        // An enhanced beacon is a beacon of frame version 2 with information elements
+        const uint16_t frameControl = frame[0] | (frame[1] << 8);
+        if (((frameControl & 0x07) != 0) || (((frameControl >> 12) & 0x03) != 2) || !((frameControl >> 9) & 0x01))
+            return false;
+
+        const uint8_t dstAddrMode = (frameControl >> 10) & 0x03;
+        const uint8_t srcAddrMode = (frameControl >> 14) & 0x03;
+        const bool panIdCompression = (frameControl >> 6) & 0x01;
+        if ((dstAddrMode == 1) || (srcAddrMode == 1))
+            return false;
+
+        // Which PAN IDs are present depends on the addressing modes in frame version 2
+        bool dstPanPresent;
+        bool srcPanPresent = false;
+        if ((dstAddrMode == 0) && (srcAddrMode == 0))
+            dstPanPresent = panIdCompression;
+        else if (srcAddrMode == 0)
+            dstPanPresent = !panIdCompression;
+        else if (dstAddrMode == 0)
+        {
+            dstPanPresent = false;
+            srcPanPresent = !panIdCompression;
+        }
+        else if ((dstAddrMode == 3) && (srcAddrMode == 3))
+            dstPanPresent = !panIdCompression;
+        else
+        {
+            dstPanPresent = true;
+            srcPanPresent = !panIdCompression;
+        }
+
+        // The last two bytes are the RSSI and CRC/LQI, the addressing fields are followed by at least one more byte
+        const uint8_t addrLengths[4] = { 0, 0, 2, 8 };
+        uint8_t end = length - 2;
+        uint8_t pos = ((frameControl >> 8) & 0x01) ? 2 : 3; // Sequence number suppression
+        if (end <= pos + (dstPanPresent ? 2 : 0) + addrLengths[dstAddrMode] + (srcPanPresent ? 2 : 0) + addrLengths[srcAddrMode])
+            return false;
+
+        tschBeaconPan = TSCH_ANY_PAN;
+        if (dstPanPresent)
+        {
+            tschBeaconPan = frame[pos] | (frame[pos + 1] << 8);
+            pos += 2;
+        }
+
+        pos += addrLengths[dstAddrMode];
+        if (srcPanPresent)
+        {
+            tschBeaconPan = frame[pos] | (frame[pos + 1] << 8);
+            pos += 2;
+        }
+
+        pos += addrLengths[srcAddrMode];
+        if ((tschPanId != TSCH_ANY_PAN) && (tschBeaconPan != TSCH_ANY_PAN) && (tschBeaconPan != tschPanId))
+            return false;
+
+        // The IEs of an authenticated beacon can still be read, but not those of an encrypted one. The MIC is at the end.
+        if ((frameControl >> 3) & 0x01)
+        {
+            const uint8_t securityControl = frame[pos];
+            const uint8_t keyIdLengths[4] = { 0, 1, 5, 9 };
+            if (securityControl & 0x04)
+                return false;
+
+            pos += 1 + (((securityControl >> 5) & 0x01) ? 0 : 4) + keyIdLengths[(securityControl >> 3) & 0x03];
+
+            const uint8_t micLength = (securityControl & 0x03) ? (2 << (securityControl & 0x03)) : 0;
+            if (end < pos + micLength)
+                return false;
+
+            end -= micLength;
+        }
+
+        // Skip the header IEs until the termination IE in front of the payload IEs
+        bool payloadIEs = false;
+        while (pos + 2 <= end)
+        {
+            const uint16_t descriptor = frame[pos] | (frame[pos + 1] << 8);
+            const uint8_t elementId = (descriptor >> 7) & 0xff;
+            pos += 2;
+            if ((descriptor & 0x8000) || (elementId == 0x7f))
+                return false;
+            if (elementId == 0x7e)
+            {
+                payloadIEs = true;
+                break;
+            }
+
+            pos += descriptor & 0x7f;
+        }
+
+        if (!payloadIEs)
+            return false;
+
+        // The TSCH IEs are nested in the MLME payload IE
+        bool synchronizationFound = false;
+        tschBeaconTimeslotLength = TSCH_DEFAULT_TIMESLOT_LENGTH;
+        tschBeaconTxOffset = TSCH_DEFAULT_TX_OFFSET;
+        tschBeaconRxWait = TSCH_DEFAULT_RX_WAIT;
+        tschBeaconSequenceLength = 0;
+        while (pos + 2 <= end)
+        {
+            const uint16_t descriptor = frame[pos] | (frame[pos + 1] << 8);
+            const uint16_t ieLength = descriptor & 0x7ff;
+            const uint8_t groupId = (descriptor >> 11) & 0x0f;
+            pos += 2;
+            if (!(descriptor & 0x8000) || (pos + ieLength > end))
+                return false;
+            if (groupId == 0x0f)
+                break;
+            if (groupId != 1)
+            {
+                pos += ieLength;
+                continue;
+            }
+
+            const uint8_t groupEnd = pos + ieLength;
+            while (pos + 2 <= groupEnd)
+            {
+                const uint16_t subDescriptor = frame[pos] | (frame[pos + 1] << 8);
+                const bool longIE = subDescriptor & 0x8000;
+                const uint16_t subLength = longIE ? (subDescriptor & 0x7ff) : (subDescriptor & 0xff);
+                const uint8_t subId = longIE ? ((subDescriptor >> 11) & 0x0f) : ((subDescriptor >> 8) & 0x7f);
+                pos += 2;
+                if (pos + subLength > groupEnd)
+                    return false;
+
+                const uint8_t* content = &frame[pos];
+                if (!longIE && (subId == 0x1a) && (subLength >= 6)) // TSCH synchronization IE
+                {
+                    tschBeaconAsn = 0;
+                    for (uint8_t i = 0; i < 5; ++i)
+                        tschBeaconAsn |= static_cast<uint64_t>(content[i]) << (8 * i);
+
+                    synchronizationFound = true;
+                }
+                else if (!longIE && (subId == 0x1c) && (subLength >= 25)) // TSCH timeslot IE with the full template
+                {
+                    tschBeaconTxOffset = content[5] | (content[6] << 8);
+                    tschBeaconRxWait = content[13] | (content[14] << 8);
+                    tschBeaconTimeslotLength = (subLength >= 27) ? (content[24] | (content[25] << 8)) : (content[23] | (content[24] << 8));
+                }
+                else if (longIE && (subId == 0x09) && (subLength >= 10)) // Channel hopping IE with the full sequence
+                {
+                    const uint16_t sequenceLength = content[8] | (content[9] << 8);
+                    if ((sequenceLength == 0) || (sequenceLength > TSCH_MAX_SEQUENCE_LEN) || (subLength < 10 + 2 * sequenceLength))
+                        return false;
+
+                    for (uint8_t i = 0; i < sequenceLength; ++i)
+                    {
+                        const uint16_t channel = content[10 + 2 * i] | (content[11 + 2 * i] << 8);
+                        if ((channel < 11) || (channel > 26))
+                            return false;
+
+                        tschBeaconSequence[i] = channel;
+                    }
+
+                    tschBeaconSequenceLength = sequenceLength;
+                }
+
+                pos += subLength;
+            }
+
+            pos = groupEnd;
+        }
+
+        // The slot has to be long enough to tune the radio before the frames start
+        return synchronizationFound && (tschBeaconTxOffset < tschBeaconTimeslotLength)
+            && (tschBeaconTimeslotLength >= TSCH_MIN_TIMESLOT_LENGTH);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Tsch::synchronize(uint32_t timestamp)
+    {
+        // A sequence from the host replaces the one of the network, a beacon without a full sequence uses the default one
+        if (tschHostSequenceLength > 0)
+        {
+            tschSequenceLength = tschHostSequenceLength;
+            for (uint8_t i = 0; i < tschSequenceLength; ++i)
+                tschSequence[i] = tschHostSequence[i];
+        }
+        else if (tschBeaconSequenceLength > 0)
+        {
+            tschSequenceLength = tschBeaconSequenceLength;
+            for (uint8_t i = 0; i < tschSequenceLength; ++i)
+                tschSequence[i] = tschBeaconSequence[i];
+        }
+        else
+        {
+            tschSequenceLength = TSCH_MAX_SEQUENCE_LEN;
+            for (uint8_t i = 0; i < tschSequenceLength; ++i)
+                tschSequence[i] = tschDefaultSequence[i];
+        }
+
+        // The beacon was send on the channel of its own channel offset, which is followed unless the host asked for another one
+        const uint8_t asnEntry = static_cast<uint8_t>(tschBeaconAsn % tschSequenceLength);
+        if (tschState != TschState::Locked)
+        {
+            tschChannelOffset = 0;
+            if (tschRequestedOffset != TSCH_CHANNEL_OFFSET_FROM_BEACON)
+                tschChannelOffset = tschRequestedOffset % tschSequenceLength;
+            else
+            {
+                for (uint8_t i = 0; i < tschSequenceLength; ++i)
+                {
+                    if (tschSequence[i] == Radio::getChannel())
+                    {
+                        tschChannelOffset = (i + tschSequenceLength - asnEntry) % tschSequenceLength;
+                        break;
+                    }
+                }
+            }
+
+            // Once locked, only the beacons of this network are used
+            if (tschBeaconPan != TSCH_ANY_PAN)
+                tschPanId = tschBeaconPan;
+        }
+        else
+            tschChannelOffset %= tschSequenceLength;
+
+        // The frame was transmitted at the TX offset of the timeslot with the ASN from the beacon
+        tschAsn = tschBeaconAsn;
+        tschSlotStart = timestamp - tschBeaconTxOffset;
+        tschTimeslotLength = tschBeaconTimeslotLength;
+        tschTxOffset = tschBeaconTxOffset;
+        tschRxWait = tschBeaconRxWait;
+        tschHopIndex = (asnEntry + tschChannelOffset) % tschSequenceLength;
+        tschLastSync = timestamp;
+
+        if (tschState != TschState::Locked)
+        {
+            tschState = TschState::Locked;
+            queueReport();
+            Radio::enableTimerInterrupt(Tsch::timerInterruptHandler);
+        }
+
+        followCurrentTimeslot(Radio::getCurrentTime());
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Tsch::adjustTimeslots(uint32_t timestamp)
+    {
+        // Frames start at the TX offset of their timeslot, give or take half the RX wait time. Acknowledgements come later.
+        int32_t offset = static_cast<int32_t>(timestamp - tschSlotStart) % tschTimeslotLength;
+        if (offset < 0)
+            offset += tschTimeslotLength;
+
+        const int32_t deviation = offset - tschTxOffset;
+        if ((deviation > tschRxWait / 2) || (deviation < -(tschRxWait / 2)))
+            return;
+
+        // Not every node is equally well synchronized with the network, so the timeslots only move part of the way
+        tschSlotStart += deviation / TSCH_ADJUST_DIVISOR;
+        tschLastSync = timestamp;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Tsch::followCurrentTimeslot(uint32_t now)
+    {
+        // Catch up with the timeslots that started since the last interrupt
+        while (static_cast<int32_t>(now - tschSlotStart) >= tschTimeslotLength)
+        {
+            tschSlotStart += tschTimeslotLength;
+            tschAsn++;
+            if (++tschHopIndex >= tschSequenceLength)
+                tschHopIndex = 0;
+        }
+
+        if (tschSequence[tschHopIndex] != Radio::getChannel())
+            tune(tschSequence[tschHopIndex]);
+
+        // The overflow counter counts milliseconds, so the interrupt occurs up to 1024 microseconds after the next timeslot
+        // started. That is still well before the TX offset, and after the acknowledgement at the end of the previous timeslot.
+        const uint32_t nextSlotStart = tschSlotStart + tschTimeslotLength;
+        Radio::scheduleTimerInterrupt((nextSlotStart - (now & ~static_cast<uint32_t>(1023)) + 1023) >> 10);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void Tsch::tune(uint8_t channel)
+    {
+        // The new frequency only takes effect after the radio recalibrates when it is turned on again
+        Radio::setChannel(channel);
+        CC2538_RF_CSP_ISRFOFF();
+        CC2538_RF_CSP_ISFLUSHRX();
+        CC2538_RF_CSP_ISRXON();
+    }
+}
@@ -0,0 +1,61 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_TSCH_HPP
+#define SNIFFER_TSCH_HPP
+
+#include "sniffer_global.hpp"
+
+namespace Sniffer
+{
+    // Follows the channel hopping of a TSCH network. The radio waits on its channel for an enhanced beacon, which gives the
+    // ASN and the hopping sequence, and from then on it is tuned to the channel of every timeslot for a single channel offset.
+    class Tsch
+    {
+    public:
+        // Start looking for an enhanced beacon with the channel offset and hopping sequence of the TSCH message,
+        // returns false when they are invalid
+        static bool start(const uint8_t* message);
+
+        // Stop following the network, the radio stays on the current channel
+        static void stop();
+
+        // Check whether a network is being searched for or followed
+        static bool isRunning();
+
+        // Called from the radio interrupt for every frame, before the filter. The length includes the RSSI and CRC/LQI bytes.
+        // Enhanced beacons of the network give the ASN, other frames are used to keep the timeslots aligned with the network.
+        static void processFrame(const uint8_t* frame, uint8_t length, uint32_t timestamp);
+
+        // Tell the host when the OpenMote locked onto the network or lost it, called from the serial task
+        static void sendPeriodically();
+
+        // Function called when the MAC timer overflow counter reaches the compare value
+        static void timerInterruptHandler();
+
+    private:
+        // Read the ASN, timeslot template and hopping sequence from an enhanced beacon, returns false when it isn't one
+        static bool parseBeacon(const uint8_t* frame, uint8_t length);
+
+        // Take the ASN and timing of the beacon that was just parsed, which started transmitting at the given time
+        static void synchronize(uint32_t timestamp);
+
+        // Move the timeslots by the difference between the expected and the actual start of a frame, when it is close enough
+        static void adjustTimeslots(uint32_t timestamp);
+
+        // Tune the radio to the channel of the current timeslot and set the interrupt at the start of the next one
+        static void followCurrentTimeslot(uint32_t now);
+
+        // Fill in the TSCH message that tells the host whether the OpenMote is locked and where the timeslots are
+        static void queueReport();
+
+        // Recalibrate the radio on a new channel, the RX FIFO is flushed
+        static void tune(uint8_t channel);
+    };
+}
+
+#endif // SNIFFER_TSCH_HPP
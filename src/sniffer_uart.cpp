@@ -0,0 +1,279 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_uart.hpp"
+#include "sniffer_serial.hpp"
+#include "sniffer_statistics.hpp"
+#include "sniffer_trace.hpp"
+
+#include "libcc2538_sys_ctrl.h"
+
+#if SNIFFER_UART_BONDING
+    #include "openmote-cc2538.h"
+#endif
+
+// There is no hardware flow control, only UART1 has CTS and RTS and the OpenBase uses those lines of the USB-serial
+// bridge for the boot loader and reset. Bytes that the host loses are recovered by the retransmissions instead.
+#define UART_CONFIG     (UART_CONFIG_WLEN_8 | UART_CONFIG_STOP_ONE | UART_CONFIG_PAR_NONE)
+
+namespace Sniffer
+{
+    // Number of bytes that the uDMA can still write before reaching the end of the RX buffer
+    inline uint16_t uartRxTransferRemaining(uint32_t control)
+    {
+        if ((control & UDMACHCTL_CHCTL_XFERMODE_M) == UDMA_MODE_STOP)
+            return 0;
+
+        return ((control & UDMACHCTL_CHCTL_XFERSIZE_M) >> UDMACHCTL_CHCTL_XFERSIZE_S) + 1;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void UartTransport::initialize()
+    {
+        uart.enable(BAUDRATE, UART_CONFIG, UART_TXINT_MODE_EOT);
+
+        // The FIFO lets the uDMA move the received bytes in bursts instead of one at a time
+        UARTFIFOEnable(uart.getBase());
+        UARTFIFOLevelSet(uart.getBase(), UART_FIFO_TX4_8, UART_FIFO_RX4_8);
+
+        // Let the uDMA write the encoded packets to the UART
+        uDMAChannelAssign(UDMA_CH9_UART0TX);
+        uDMAChannelAttributeDisable(UDMA_UART_TX_CHANNEL, UDMA_ATTR_ALL);
+        uDMAChannelControlSet(UDMA_UART_TX_CHANNEL | UDMA_PRI_SELECT, UDMA_SIZE_8 | UDMA_SRC_INC_8 | UDMA_DST_INC_NONE | UDMA_ARB_1);
+        UARTDMAEnable(uart.getBase(), UART_DMA_TX);
+
+        // The uDMA only reacts when the FIFO is half full, the last bytes of a message are
+        // left in the FIFO until the receive timeout tells us that the line has become idle.
+        uDMAChannelAssign(UDMA_CH8_UART0RX);
+        uDMAChannelAttributeDisable(UDMA_UART_RX_CHANNEL, UDMA_ATTR_ALL);
+        uDMAChannelAttributeEnable(UDMA_UART_RX_CHANNEL, UDMA_ATTR_USEBURST);
+        uDMAChannelControlSet(UDMA_UART_RX_CHANNEL | UDMA_PRI_SELECT, UDMA_SIZE_8 | UDMA_SRC_INC_NONE | UDMA_DST_INC_8 | UDMA_ARB_8);
+
+        startReceiveTransfer();
+        uDMAChannelEnable(UDMA_UART_RX_CHANNEL);
+        UARTDMAEnable(uart.getBase(), UART_DMA_RX);
+
+        // Only the end of a transmission, an idle line after receiving something and a lost byte need the processor
+        IntRegister(INT_UART0, UartTransport::interruptHandler);
+        UARTIntEnable(uart.getBase(), UART_INT_TX | UART_INT_RT | UART_INT_OE);
+        IntPrioritySet(INT_UART0, INTERRUPT_PRIORITY_TRANSPORT);
+        IntEnable(INT_UART0);
+
+#if SNIFFER_UART_BONDING
+        // UART1 only sends, on the debug pin AD1 of the OpenMote that goes to the RX line of the second USB-serial bridge
+        SysCtrlPeripheralEnable(SYS_CTRL_PERIPH_UART1);
+        SysCtrlPeripheralSleepEnable(SYS_CTRL_PERIPH_UART1);
+        UARTDisable(UART1_BASE);
+        UARTClockSourceSet(UART1_BASE, UART_CLOCK);
+        IOCPinConfigPeriphOutput(GPIO_DEBUG_AD1_PORT, GPIO_DEBUG_AD1_PIN, IOC_MUX_OUT_SEL_UART1_TXD);
+        GPIOPinTypeUARTOutput(GPIO_DEBUG_AD1_PORT, GPIO_DEBUG_AD1_PIN);
+        UARTConfigSetExpClk(UART1_BASE, SysCtrlIOClockGet(), BAUDRATE, UART_CONFIG);
+        UARTFIFOEnable(UART1_BASE);
+        UARTFIFOLevelSet(UART1_BASE, UART_FIFO_TX4_8, UART_FIFO_RX4_8);
+        UARTTxIntModeSet(UART1_BASE, UART_TXINT_MODE_EOT);
+        UARTEnable(UART1_BASE);
+
+        uDMAChannelAssign(UDMA_CH23_UART1TX);
+        uDMAChannelAttributeDisable(UDMA_UART1_TX_CHANNEL, UDMA_ATTR_ALL);
+        uDMAChannelControlSet(UDMA_UART1_TX_CHANNEL | UDMA_PRI_SELECT, UDMA_SIZE_8 | UDMA_SRC_INC_8 | UDMA_DST_INC_NONE | UDMA_ARB_1);
+        UARTDMAEnable(UART1_BASE, UART_DMA_TX);
+
+        IntRegister(INT_UART1, UartTransport::secondInterruptHandler);
+        UARTIntEnable(UART1_BASE, UART_INT_TX);
+        IntPrioritySet(INT_UART1, INTERRUPT_PRIORITY_TRANSPORT);
+        IntEnable(INT_UART1);
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void UartTransport::interruptHandler()
+    {
+        Trace::record(TraceEvent::UartIsrEnter);
+        const uint32_t status = UARTIntStatus(uart.getBase(), true);
+        UARTIntClear(uart.getBase(), status);
+
+        // A finished uDMA channel keeps triggering the interrupt until its completion status is cleared
+        const uint32_t dmaStatus = HWREG(UDMA_CHIS);
+        if ((status & UART_INT_TX) || (dmaStatus & (1 << UDMA_UART_TX_CHANNEL)))
+        {
+            // The transmit buffer can now be reused
+            HWREG(UDMA_CHIS) = (1 << UDMA_UART_TX_CHANNEL);
+            Serial::notifyFromInterrupt();
+        }
+
+        if ((status & UART_INT_RT) || (dmaStatus & (1 << UDMA_UART_RX_CHANNEL)))
+            dataReceived();
+
+        // The FIFO was full when another byte arrived, so it wasn't emptied in time and part of a message is lost.
+        // The serial task reads the counter without masking this interrupt, which is fine for a single word.
+        if (UARTRxErrorGet(uart.getBase()) & UART_RXERROR_OVERRUN)
+        {
+            statistics.uartOverruns++;
+            UARTRxErrorClear(uart.getBase());
+        }
+
+        Trace::record(TraceEvent::UartIsrExit);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#if SNIFFER_UART_BONDING
+    void UartTransport::secondInterruptHandler()
+    {
+        const uint32_t status = UARTIntStatus(UART1_BASE, true);
+        UARTIntClear(UART1_BASE, status);
+
+        if ((status & UART_INT_TX) || (HWREG(UDMA_CHIS) & (1 << UDMA_UART1_TX_CHANNEL)))
+        {
+            HWREG(UDMA_CHIS) = (1 << UDMA_UART1_TX_CHANNEL);
+            Serial::notifyFromInterrupt();
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+#endif
+
+    void UartTransport::poll()
+    {
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool UartTransport::isTransmitting()
+    {
+        for (uint8_t lane = 0; lane < SERIAL_TX_LANES; ++lane)
+        {
+            if (isLaneTransmitting(lane))
+                return true;
+        }
+
+        return false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool UartTransport::isLaneTransmitting(uint8_t lane)
+    {
+        const uint32_t channel = (lane == 0) ? UDMA_UART_TX_CHANNEL : UDMA_UART1_TX_CHANNEL;
+        return (HWREG(UDMA_ENASET) & (1 << channel)) != 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void UartTransport::transmit(uint8_t lane, const uint8_t* data, uint16_t length)
+    {
+        const uint32_t channel = (lane == 0) ? UDMA_UART_TX_CHANNEL : UDMA_UART1_TX_CHANNEL;
+        const uint32_t base = (lane == 0) ? uart.getBase() : UART1_BASE;
+        uDMAChannelTransferSet(channel | UDMA_PRI_SELECT, UDMA_MODE_BASIC, (void*)data, (void*)(base + UART_O_DR), length);
+        uDMAChannelEnable(channel);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void UartTransport::writeByte(uint8_t byte)
+    {
+        UARTCharPut(uart.getBase(), byte);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void UartTransport::flush()
+    {
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint32_t UartTransport::getDefaultBaudrate()
+    {
+        return BAUDRATE;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool UartTransport::isBaudrateSupported(uint32_t rate)
+    {
+        const uint32_t clock = SysCtrlIOClockGet();
+        if ((rate < BAUDRATE) || (rate > clock / 8))
+            return false;
+
+        // Same calculation as UARTConfigSetExpClk, which halves the rate in high speed mode
+        const bool highSpeed = (rate * 16 > clock);
+        const uint32_t divisor = ((clock * 8) / (highSpeed ? rate / 2 : rate) + 1) / 2;
+        const uint32_t actualRate = ((clock * 4) / divisor) * (highSpeed ? 2 : 1);
+        const uint32_t deviation = (actualRate > rate) ? actualRate - rate : rate - actualRate;
+        return deviation <= (rate / 1000) * BAUDRATE_MAX_ERROR;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint32_t UartTransport::getMaxBaudrate()
+    {
+        return SysCtrlIOClockGet() / 8;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void UartTransport::setBaudrate(uint32_t rate)
+    {
+        // Bytes that are still being send would get corrupted, UARTConfigSetExpClk waits for the UART itself to become idle
+        while (isTransmitting())
+            ;
+
+        UARTConfigSetExpClk(uart.getBase(), SysCtrlIOClockGet(), rate, UART_CONFIG);
+        UARTEnable(uart.getBase());
+
+#if SNIFFER_UART_BONDING
+        // Both bridges follow the BAUDRATE message, the host switches its two ports together
+        UARTConfigSetExpClk(UART1_BASE, SysCtrlIOClockGet(), rate, UART_CONFIG);
+        UARTEnable(UART1_BASE);
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void UartTransport::startReceiveTransfer()
+    {
+        uDMAChannelTransferSet(UDMA_UART_RX_CHANNEL | UDMA_PRI_SELECT, UDMA_MODE_BASIC,
+                               (void*)(uart.getBase() + UART_O_DR), (void*)rxBuffer, SERIAL_RX_BUFFER_LEN);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Called when the line became idle or when the uDMA reached the end of the RX buffer
+    inline void UartTransport::dataReceived()
+    {
+        // The channel is disabled while we copy the bytes by hand, so that the uDMA can't write at the same time
+        uDMAChannelDisable(UDMA_UART_RX_CHANNEL);
+        HWREG(UDMA_CHIS) = (1 << UDMA_UART_RX_CHANNEL);
+
+        volatile uint32_t& control = uDMAChannelControlTable[UDMA_UART_RX_CHANNEL].ui32Control;
+        while (UARTCharsAvail(uart.getBase()))
+        {
+            if (uartRxTransferRemaining(control) == 0)
+                startReceiveTransfer();
+
+            // Each byte is stored where the uDMA would have put it, and then removed from the remaining transfer size
+            const uint16_t remaining = uartRxTransferRemaining(control);
+            rxBuffer[SERIAL_RX_BUFFER_LEN - remaining] = UARTCharGetNonBlocking(uart.getBase());
+            if (remaining == 1)
+                control &= ~(UDMACHCTL_CHCTL_XFERMODE_M | UDMACHCTL_CHCTL_XFERSIZE_M);
+            else
+                control -= (1 << UDMACHCTL_CHCTL_XFERSIZE_S);
+        }
+
+        if (uartRxTransferRemaining(control) == 0)
+            startReceiveTransfer();
+
+        // The write index only moves here, so the serial task always sees whole bursts
+        rxBufferIndexWrite = SERIAL_RX_BUFFER_LEN - uartRxTransferRemaining(control);
+        uDMAChannelEnable(UDMA_UART_RX_CHANNEL);
+
+        Serial::notifyFromInterrupt();
+    }
+}
@@ -0,0 +1,67 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_UART_HPP
+#define SNIFFER_UART_HPP
+
+#include "sniffer_global.hpp"
+
+namespace Sniffer
+{
+    // Transport over UART0 and the USB-serial bridge of the OpenBase, the uDMA moves the bytes in both directions.
+    // With SNIFFER_UART_BONDING the records are also send over UART1 as the second lane, to another USB-serial bridge.
+    class UartTransport
+    {
+    public:
+        // Enable the UART with its FIFO and let the uDMA store the received bytes in the RX buffer
+        static void initialize();
+
+        // Interrupt handler for UART, which is also triggered when a uDMA transfer from or to the UART ends
+        static void interruptHandler();
+
+#if SNIFFER_UART_BONDING
+        // Interrupt handler for UART1, which only tells that the uDMA finished the packet of the second lane
+        static void secondInterruptHandler();
+#endif
+
+        // Nothing to do, the uDMA and the UART interrupt already store the received bytes in the RX buffer
+        static void poll();
+
+        // Check whether the uDMA hasn't handed the whole packet to the UART yet, on any of the lanes
+        static bool isTransmitting();
+
+        // Check whether the uDMA is still sending the packet of the lane (0 for UART0, 1 for UART1)
+        static bool isLaneTransmitting(uint8_t lane);
+
+        // Let the uDMA send an encoded packet over the UART of the lane
+        static void transmit(uint8_t lane, const uint8_t* data, uint16_t length);
+
+        // Put a byte on the UART directly, waiting when the FIFO is full
+        static void writeByte(uint8_t byte);
+
+        // Nothing to do, every byte was already given to the UART
+        static void flush();
+
+        // The baudrate at which the host and the OpenMote start
+        static uint32_t getDefaultBaudrate();
+
+        // Check whether the UART divisor can get close enough to the requested baudrate
+        static bool isBaudrateSupported(uint32_t rate);
+
+        // The UART can't go faster than an eighth of its clock
+        static uint32_t getMaxBaudrate();
+
+        // Change the baudrate once everything that was being send has left the UART
+        static void setBaudrate(uint32_t rate);
+
+    private:
+        static void startReceiveTransfer();
+        static void dataReceived();
+    };
+}
+
+#endif // SNIFFER_UART_HPP
@@ -0,0 +1,511 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_usb.hpp"
+#include "sniffer_serial.hpp"
+
+#include "hw_memmap.h"
+#include "hw_usb.h"
+#include "libcc2538_gpio.h"
+
+// Bits of USB_CS0_CSIL, which hw_usb.h doesn't name as their meaning depends on USB_INDEX
+#define USB_CS0_OUTPKT_RDY          0x01
+#define USB_CS0_INPKT_RDY           0x02
+#define USB_CS0_SENT_STALL          0x04
+#define USB_CS0_DATA_END            0x08
+#define USB_CS0_SETUP_END           0x10
+#define USB_CS0_SEND_STALL          0x20
+#define USB_CS0_CLR_OUTPKT_RDY      0x40
+#define USB_CS0_CLR_SETUP_END       0x80
+
+#define USB_CSIL_INPKT_RDY          0x01
+#define USB_CSIL_FLUSH_PACKET       0x08
+#define USB_CSIL_CLR_DATA_TOG       0x40
+
+#define USB_REQUEST_GET_STATUS              0x00
+#define USB_REQUEST_SET_ADDRESS             0x05
+#define USB_REQUEST_GET_DESCRIPTOR          0x06
+#define USB_REQUEST_GET_CONFIGURATION       0x08
+#define USB_REQUEST_SET_CONFIGURATION       0x09
+#define USB_REQUEST_GET_INTERFACE           0x0A
+#define USB_REQUEST_SET_LINE_CODING         0x20
+#define USB_REQUEST_GET_LINE_CODING         0x21
+#define USB_REQUEST_SET_CONTROL_LINE_STATE  0x22
+
+#define USB_REQUEST_TYPE_MASK       0x60
+#define USB_REQUEST_TYPE_STANDARD   0x00
+#define USB_REQUEST_TYPE_CLASS      0x20
+
+#define USB_DESCRIPTOR_DEVICE       1
+#define USB_DESCRIPTOR_CONFIG       2
+#define USB_DESCRIPTOR_STRING       3
+
+#define USB_LINE_CODING_LENGTH      7
+
+namespace Sniffer
+{
+    namespace UsbControlState
+    {
+        enum UsbControlState
+        {
+            Idle,
+            SendingData,  // Data stage of a request that returns something
+            ReceivingData // Data stage of SET_LINE_CODING
+        };
+    }
+
+    const uint8_t usbDeviceDescriptor[] = {
+        18, USB_DESCRIPTOR_DEVICE, 0x00, 0x02, // USB 2.0
+        0x02, 0x00, 0x00, // Communications device class
+        USB_EP0_PACKET_SIZE,
+        USB_VENDOR_ID & 0xff, USB_VENDOR_ID >> 8, USB_PRODUCT_ID & 0xff, USB_PRODUCT_ID >> 8,
+        0x00, 0x01, // Device release 1.0
+        1, 2, 0, // Manufacturer and product strings, no serial number
+        1 // One configuration
+    };
+
+    const uint8_t usbConfigDescriptor[] = {
+        9, USB_DESCRIPTOR_CONFIG, 67, 0, 2, 1, 0, 0x80, 50, // Two interfaces, bus powered with 100mA
+
+        // Communication interface with the CDC functional descriptors
+        9, 4, 0, 0, 1, 0x02, 0x02, 0x00, 0,
+        5, 0x24, 0x00, 0x10, 0x01,  // Header, CDC 1.10
+        5, 0x24, 0x01, 0x00, 1,     // Call management, done through data interface 1
+        4, 0x24, 0x02, 0x02,        // Abstract control management, supports the line coding and control line state requests
+        5, 0x24, 0x06, 0, 1,        // Union of interface 0 and 1
+        7, 5, 0x80 | USB_NOTIFY_ENDPOINT, 0x03, USB_NOTIFY_PACKET_SIZE, 0, 255,
+
+        // Data interface with a bulk IN and OUT endpoint
+        9, 4, 1, 0, 2, 0x0A, 0x00, 0x00, 0,
+        7, 5, 0x80 | USB_DATA_ENDPOINT, 0x02, USB_DATA_PACKET_SIZE, 0, 0,
+        7, 5, USB_DATA_ENDPOINT, 0x02, USB_DATA_PACKET_SIZE, 0, 0
+    };
+
+    const uint8_t usbLanguageString[] = {4, USB_DESCRIPTOR_STRING, 0x09, 0x04}; // English (United States)
+    const uint8_t usbManufacturerString[] = {
+        18, USB_DESCRIPTOR_STRING, 'O',0, 'p',0, 'e',0, 'n',0, 'M',0, 'o',0, 't',0, 'e',0
+    };
+    const uint8_t usbProductString[] = {
+        34, USB_DESCRIPTOR_STRING, 'O',0, 'p',0, 'e',0, 'n',0, 'M',0, 'o',0, 't',0, 'e',0,
+        ' ',0, 'S',0, 'n',0, 'i',0, 'f',0, 'f',0, 'e',0, 'r',0
+    };
+
+    // The line coding is only stored to return it to the host, there is no UART behind the endpoint
+    uint8_t usbLineCoding[USB_LINE_CODING_LENGTH] = {BAUDRATE & 0xff, (BAUDRATE >> 8) & 0xff, (BAUDRATE >> 16) & 0xff, 0, 0, 0, 8};
+    uint8_t usbConfiguration = 0;
+    volatile bool usbHostConnected = false; // Configured and the host has set DTR, which happens when the serial port is opened
+
+    uint8_t        usbControlState = UsbControlState::Idle;
+    const uint8_t* usbControlData = nullptr;
+    uint16_t       usbControlRemaining = 0;
+    uint8_t        usbControlReply[2];
+
+    const uint8_t*    usbTxData = nullptr;
+    volatile uint16_t usbTxRemaining = 0;
+    uint8_t           usbTxPacketLength = 0; // Bytes that writeByte put in the FIFO without sending them yet
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void UsbTransport::initialize()
+    {
+        // The USB controller needs the 48 MHz clock from its PLL
+        HWREG(USB_CTRL) = USB_CTRL_USBEN | USB_CTRL_PLLEN;
+        while (!(HWREG(USB_CTRL) & USB_CTRL_PLLLOCKED))
+            ;
+
+        HWREG(USB_IIE) = USB_IIE_EP0IE | USB_IIE_INEP4IE;
+        HWREG(USB_OIE) = USB_OIE_OUTEP4IE;
+        HWREG(USB_CIE) = USB_CIE_RSTIE;
+
+        IntRegister(INT_USB2538, UsbTransport::interruptHandler);
+        IntPrioritySet(INT_USB2538, INTERRUPT_PRIORITY_TRANSPORT); // Same priority as the UART interrupt, which it replaces
+        IntEnable(INT_USB2538);
+
+        // The host notices the device when D+ is pulled up
+        if (USB_PULLUP_PIN != 0)
+        {
+            GPIOPinTypeGPIOOutput(USB_PULLUP_PORT, USB_PULLUP_PIN);
+            GPIOPinWrite(USB_PULLUP_PORT, USB_PULLUP_PIN, USB_PULLUP_PIN);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void UsbTransport::interruptHandler()
+    {
+        // The registers of an endpoint are selected with USB_INDEX, which we might have interrupted writeByte in the middle of
+        const uint32_t index = HWREG(USB_INDEX);
+
+        // All flags are cleared by reading them
+        const uint32_t commonFlags = HWREG(USB_CIF);
+        const uint32_t inFlags = HWREG(USB_IIF);
+        const uint32_t outFlags = HWREG(USB_OIF);
+
+        if (commonFlags & USB_CIF_RSTIF)
+            resetReceived();
+        if (inFlags & USB_IIF_EP0IF)
+            handleControlEndpoint();
+        if (inFlags & USB_IIF_INEP4IF)
+            fillDataEndpoint();
+        if (outFlags & USB_OIF_OUTEP4IF)
+            dataReceived();
+
+        HWREG(USB_INDEX) = index;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void UsbTransport::poll()
+    {
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool UsbTransport::isHostConnected()
+    {
+        return usbHostConnected;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void UsbTransport::transmit(uint8_t, const uint8_t* data, uint16_t length)
+    {
+        // Without anyone reading the port, the packet is lost just like it would be on an unconnected UART
+        if (!usbHostConnected)
+            return;
+
+        // The interrupt continues filling the FIFO when the first packets have been send
+        IntDisable(INT_USB2538);
+        usbTxData = data;
+        usbTxRemaining = length;
+        fillDataEndpoint();
+        IntEnable(INT_USB2538);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool UsbTransport::isTransmitting()
+    {
+        return usbTxRemaining > 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool UsbTransport::isLaneTransmitting(uint8_t)
+    {
+        return isTransmitting();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void UsbTransport::writeByte(uint8_t byte)
+    {
+        if (!usbHostConnected)
+            return;
+
+        HWREG(USB_INDEX) = USB_DATA_ENDPOINT;
+        if (usbTxPacketLength == 0)
+        {
+            while (usbHostConnected && (HWREG(USB_CS0_CSIL) & USB_CSIL_INPKT_RDY))
+                HWREG(USB_INDEX) = USB_DATA_ENDPOINT;
+        }
+
+        HWREG(USB_F4) = byte;
+        if (++usbTxPacketLength == USB_DATA_PACKET_SIZE)
+            flush();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void UsbTransport::flush()
+    {
+        if (usbTxPacketLength == 0)
+            return;
+
+        HWREG(USB_INDEX) = USB_DATA_ENDPOINT;
+        HWREG(USB_CS0_CSIL) = USB_CSIL_INPKT_RDY;
+        usbTxPacketLength = 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint32_t UsbTransport::getDefaultBaudrate()
+    {
+        return USB_EQUIVALENT_BAUDRATE;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool UsbTransport::isBaudrateSupported(uint32_t)
+    {
+        return false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint32_t UsbTransport::getMaxBaudrate()
+    {
+        return getDefaultBaudrate();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void UsbTransport::setBaudrate(uint32_t)
+    {
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void UsbTransport::resetReceived()
+    {
+        // The host starts over with the enumeration, the controller already returned to address 0 and disabled the endpoints
+        usbConfiguration = 0;
+        usbHostConnected = false;
+        usbControlState = UsbControlState::Idle;
+        usbTxPacketLength = 0;
+        if (usbTxRemaining > 0)
+        {
+            usbTxRemaining = 0;
+            Serial::notifyFromInterrupt();
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void UsbTransport::handleControlEndpoint()
+    {
+        HWREG(USB_INDEX) = 0;
+        const uint32_t status = HWREG(USB_CS0_CSIL);
+
+        // A stalled or aborted request ends the control transfer, a new setup packet might already be waiting
+        if (status & USB_CS0_SENT_STALL)
+        {
+            HWREG(USB_CS0_CSIL) = 0;
+            usbControlState = UsbControlState::Idle;
+        }
+        if (status & USB_CS0_SETUP_END)
+        {
+            HWREG(USB_CS0_CSIL) = USB_CS0_CLR_SETUP_END;
+            usbControlState = UsbControlState::Idle;
+        }
+
+        if (status & USB_CS0_OUTPKT_RDY)
+        {
+            const uint8_t length = HWREG(USB_CNT0_CNTL);
+            if (usbControlState == UsbControlState::ReceivingData)
+            {
+                for (uint8_t i = 0; i < length; ++i)
+                {
+                    const uint8_t byte = HWREG(USB_F0);
+                    if (i < USB_LINE_CODING_LENGTH)
+                        usbLineCoding[i] = byte;
+                }
+
+                HWREG(USB_CS0_CSIL) = USB_CS0_CLR_OUTPKT_RDY | USB_CS0_DATA_END;
+                usbControlState = UsbControlState::Idle;
+            }
+            else if (length == 8)
+            {
+                uint8_t setup[8];
+                for (uint8_t i = 0; i < 8; ++i)
+                    setup[i] = HWREG(USB_F0);
+
+                handleSetupPacket(setup);
+            }
+            else
+                HWREG(USB_CS0_CSIL) = USB_CS0_CLR_OUTPKT_RDY | USB_CS0_SEND_STALL;
+        }
+        else if ((usbControlState == UsbControlState::SendingData) && !(status & USB_CS0_INPKT_RDY))
+            sendNextControlPacket();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void UsbTransport::handleSetupPacket(const uint8_t setup[])
+    {
+        const uint8_t  requestType = setup[0];
+        const uint8_t  request = setup[1];
+        const uint16_t value = setup[2] | (setup[3] << 8);
+        const uint16_t length = setup[6] | (setup[7] << 8);
+
+        if ((requestType & USB_REQUEST_TYPE_MASK) == USB_REQUEST_TYPE_STANDARD)
+        {
+            if (request == USB_REQUEST_GET_DESCRIPTOR)
+            {
+                const uint8_t type = value >> 8;
+                const uint8_t index = value & 0xff;
+                if (type == USB_DESCRIPTOR_DEVICE)
+                    return sendControlData(usbDeviceDescriptor, sizeof(usbDeviceDescriptor), length);
+                else if (type == USB_DESCRIPTOR_CONFIG)
+                    return sendControlData(usbConfigDescriptor, sizeof(usbConfigDescriptor), length);
+                else if ((type == USB_DESCRIPTOR_STRING) && (index == 0))
+                    return sendControlData(usbLanguageString, sizeof(usbLanguageString), length);
+                else if ((type == USB_DESCRIPTOR_STRING) && (index == 1))
+                    return sendControlData(usbManufacturerString, sizeof(usbManufacturerString), length);
+                else if ((type == USB_DESCRIPTOR_STRING) && (index == 2))
+                    return sendControlData(usbProductString, sizeof(usbProductString), length);
+            }
+            else if (request == USB_REQUEST_SET_ADDRESS)
+            {
+                // The controller only starts using the address after the status stage
+                HWREG(USB_ADDR) = value & USB_ADDR_USBADDR_M;
+                HWREG(USB_CS0_CSIL) = USB_CS0_CLR_OUTPKT_RDY | USB_CS0_DATA_END;
+                return;
+            }
+            else if (request == USB_REQUEST_SET_CONFIGURATION)
+            {
+                usbConfiguration = value & 0xff;
+                if (usbConfiguration != 0)
+                    configureEndpoints();
+                else
+                    usbHostConnected = false;
+
+                HWREG(USB_INDEX) = 0;
+                HWREG(USB_CS0_CSIL) = USB_CS0_CLR_OUTPKT_RDY | USB_CS0_DATA_END;
+                return;
+            }
+            else if (request == USB_REQUEST_GET_CONFIGURATION)
+            {
+                usbControlReply[0] = usbConfiguration;
+                return sendControlData(usbControlReply, 1, length);
+            }
+            else if ((request == USB_REQUEST_GET_STATUS) || (request == USB_REQUEST_GET_INTERFACE))
+            {
+                // Not self-powered, no remote wakeup, no halted endpoints and only alternate setting 0
+                usbControlReply[0] = 0;
+                usbControlReply[1] = 0;
+                return sendControlData(usbControlReply, (request == USB_REQUEST_GET_STATUS) ? 2 : 1, length);
+            }
+        }
+        else if ((requestType & USB_REQUEST_TYPE_MASK) == USB_REQUEST_TYPE_CLASS)
+        {
+            if (request == USB_REQUEST_SET_LINE_CODING)
+            {
+                HWREG(USB_CS0_CSIL) = USB_CS0_CLR_OUTPKT_RDY;
+                usbControlState = UsbControlState::ReceivingData;
+                return;
+            }
+            else if (request == USB_REQUEST_GET_LINE_CODING)
+                return sendControlData(usbLineCoding, sizeof(usbLineCoding), length);
+            else if (request == USB_REQUEST_SET_CONTROL_LINE_STATE)
+            {
+                // DTR tells whether the serial port is open. Data that was still waiting for a closed port is thrown away.
+                usbHostConnected = (usbConfiguration != 0) && (value & 0x01);
+                if (!usbHostConnected)
+                {
+                    HWREG(USB_INDEX) = USB_DATA_ENDPOINT;
+                    HWREG(USB_CS0_CSIL) = USB_CSIL_FLUSH_PACKET;
+                    HWREG(USB_CS0_CSIL) = USB_CSIL_FLUSH_PACKET; // Flush again for the second packet of the double buffer
+                    usbTxPacketLength = 0;
+                    usbTxRemaining = 0;
+                    Serial::notifyFromInterrupt();
+                }
+
+                HWREG(USB_INDEX) = 0;
+                HWREG(USB_CS0_CSIL) = USB_CS0_CLR_OUTPKT_RDY | USB_CS0_DATA_END;
+                return;
+            }
+        }
+
+        // Everything else (e.g. SET_FEATURE or a device qualifier descriptor) isn't supported
+        HWREG(USB_CS0_CSIL) = USB_CS0_CLR_OUTPKT_RDY | USB_CS0_SEND_STALL;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void UsbTransport::sendControlData(const uint8_t* data, uint16_t length, uint16_t requestedLength)
+    {
+        // None of the replies is a multiple of USB_EP0_PACKET_SIZE, so a zero length packet is never needed at the end
+        usbControlData = data;
+        usbControlRemaining = (length < requestedLength) ? length : requestedLength;
+        usbControlState = UsbControlState::SendingData;
+
+        HWREG(USB_CS0_CSIL) = USB_CS0_CLR_OUTPKT_RDY;
+        sendNextControlPacket();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void UsbTransport::sendNextControlPacket()
+    {
+        const uint8_t length = (usbControlRemaining < USB_EP0_PACKET_SIZE) ? usbControlRemaining : USB_EP0_PACKET_SIZE;
+        for (uint8_t i = 0; i < length; ++i)
+            HWREG(USB_F0) = usbControlData[i];
+
+        usbControlData += length;
+        usbControlRemaining -= length;
+
+        if (usbControlRemaining == 0)
+        {
+            HWREG(USB_CS0_CSIL) = USB_CS0_INPKT_RDY | USB_CS0_DATA_END;
+            usbControlState = UsbControlState::Idle;
+        }
+        else
+            HWREG(USB_CS0_CSIL) = USB_CS0_INPKT_RDY;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void UsbTransport::configureEndpoints()
+    {
+        HWREG(USB_INDEX) = USB_NOTIFY_ENDPOINT;
+        HWREG(USB_MAXI) = USB_NOTIFY_PACKET_SIZE / 8;
+        HWREG(USB_CS0_CSIL) = USB_CSIL_CLR_DATA_TOG;
+
+        // The IN direction is double buffered, so that the next packet can be copied while the previous one is underway
+        HWREG(USB_INDEX) = USB_DATA_ENDPOINT;
+        HWREG(USB_MAXI) = USB_DATA_PACKET_SIZE / 8;
+        HWREG(USB_CSIH) = USB_CSIH_INDBLBUF;
+        HWREG(USB_CS0_CSIL) = USB_CSIL_CLR_DATA_TOG | USB_CSIL_FLUSH_PACKET;
+        HWREG(USB_MAXO) = USB_DATA_PACKET_SIZE / 8;
+        HWREG(USB_CSOH) = 0;
+        HWREG(USB_CSOL) = USB_CSOL_CLRDATATOG | USB_CSOL_FLUSHPACKET;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void UsbTransport::fillDataEndpoint()
+    {
+        if (usbTxRemaining == 0)
+            return;
+
+        HWREG(USB_INDEX) = USB_DATA_ENDPOINT;
+        while ((usbTxRemaining > 0) && !(HWREG(USB_CS0_CSIL) & USB_CSIL_INPKT_RDY))
+        {
+            const uint8_t length = (usbTxRemaining < USB_DATA_PACKET_SIZE) ? usbTxRemaining : USB_DATA_PACKET_SIZE;
+            for (uint8_t i = 0; i < length; ++i)
+                HWREG(USB_F4) = usbTxData[i];
+
+            HWREG(USB_CS0_CSIL) = USB_CSIL_INPKT_RDY;
+            usbTxData += length;
+            usbTxRemaining -= length;
+        }
+
+        // The whole packet is in the FIFO, so the TX buffer can be reused
+        if (usbTxRemaining == 0)
+            Serial::notifyFromInterrupt();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void UsbTransport::dataReceived()
+    {
+        HWREG(USB_INDEX) = USB_DATA_ENDPOINT;
+        if (!(HWREG(USB_CSOL) & USB_CSOL_OUTPKTRDY))
+            return;
+
+        const uint16_t length = HWREG(USB_CNT0_CNTL) | (HWREG(USB_CNTH) << 8);
+        for (uint16_t i = 0; i < length; ++i)
+        {
+            rxBuffer[rxBufferIndexWrite] = HWREG(USB_F4);
+            rxBufferIndexWrite = rxBufferIndexWrite + 1;
+        }
+
+        HWREG(USB_CSOL) &= ~USB_CSOL_OUTPKTRDY;
+        Serial::notifyFromInterrupt();
+    }
+}
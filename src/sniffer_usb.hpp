@@ -0,0 +1,82 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_USB_HPP
+#define SNIFFER_USB_HPP
+
+#include "sniffer_global.hpp"
+
+// The OpenMote shows up as a CDC-ACM serial port, so the host talks to it in the same way as to the USB-serial bridge.
+// Endpoint 2 is the (unused) notification endpoint, endpoint 4 carries the data in both directions.
+#define USB_VENDOR_ID               0x0451  // Texas Instruments
+#define USB_PRODUCT_ID              0x16C8  // CC2538 USB CDC
+#define USB_EP0_PACKET_SIZE         32
+#define USB_NOTIFY_ENDPOINT         2
+#define USB_NOTIFY_PACKET_SIZE      8
+#define USB_DATA_ENDPOINT           4
+#define USB_DATA_PACKET_SIZE        64
+#define USB_EQUIVALENT_BAUDRATE     10000000    // Rate at which the bulk endpoint moves the bytes (with 10 bits per byte), used for the adaptive window
+
+// GPIO that enables the D+ pull-up resistor, a pin of 0 means that the board has a fixed pull-up
+#define USB_PULLUP_PORT             GPIO_C_BASE
+#define USB_PULLUP_PIN              0
+
+namespace Sniffer
+{
+    // Transport over the USB controller of the CC2538, which the host sees as a CDC-ACM serial port
+    class UsbTransport
+    {
+    public:
+        // Start the USB PLL and connect the pull-up, the host will enumerate the device afterwards
+        static void initialize();
+
+        // Interrupt handler for USB, handles the control requests and moves the data through endpoint 4
+        static void interruptHandler();
+
+        // Nothing to do, the USB interrupt already stores the received bytes in the RX buffer
+        static void poll();
+
+        // Check whether a serial port was opened on the host, data is thrown away while this isn't the case
+        static bool isHostConnected();
+
+        // Start sending an encoded packet, the data is copied to the endpoint FIFO one USB packet at a time.
+        // There is only one lane, so the lane is ignored.
+        static void transmit(uint8_t lane, const uint8_t* data, uint16_t length);
+
+        // Check whether the data passed to transmit hasn't been completely copied to the FIFO yet
+        static bool isTransmitting();
+
+        // Same as isTransmitting, as there is only the first lane
+        static bool isLaneTransmitting(uint8_t lane);
+
+        // Add a byte to the endpoint FIFO directly, waiting for space when needed (only when not transmitting)
+        static void writeByte(uint8_t byte);
+
+        // Send the bytes that were given to writeByte and that didn't fill a whole USB packet yet
+        static void flush();
+
+        // Rate at which the bulk endpoint moves the bytes, used for the adaptive window
+        static uint32_t getDefaultBaudrate();
+
+        // The USB link has no baudrate to change
+        static bool isBaudrateSupported(uint32_t rate);
+        static uint32_t getMaxBaudrate();
+        static void setBaudrate(uint32_t rate);
+
+    private:
+        static void resetReceived();
+        static void handleControlEndpoint();
+        static void handleSetupPacket(const uint8_t setup[]);
+        static void sendControlData(const uint8_t* data, uint16_t length, uint16_t requestedLength);
+        static void sendNextControlPacket();
+        static void configureEndpoints();
+        static void fillDataEndpoint();
+        static void dataReceived();
+    };
+}
+
+#endif // SNIFFER_USB_HPP
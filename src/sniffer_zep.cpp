@@ -0,0 +1,155 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sniffer_zep.hpp"
+#include "sniffer_serial_send.hpp"
+#include "sniffer_survey.hpp"
+#include "sniffer_duplicates.hpp"
+#include "sniffer_compression.hpp"
+#include "sniffer_descriptor.hpp"
+#include "sniffer_trigger.hpp"
+
+#include "openmote-cc2538.h"
+
+#define ZEP_IP_OFFSET           14
+#define ZEP_UDP_OFFSET          34
+#define ZEP_ZEP_OFFSET          42
+#define ZEP_ETHERTYPE_IPV4      0x0800
+#define ZEP_CHANNEL_OFFSET      (ZEP_ZEP_OFFSET + 4)
+#define ZEP_DEVICE_ID_OFFSET    (ZEP_ZEP_OFFSET + 5)
+#define ZEP_LQI_OFFSET          (ZEP_ZEP_OFFSET + 8)
+#define ZEP_TIMESTAMP_OFFSET    (ZEP_ZEP_OFFSET + 9)
+#define ZEP_SEQNR_OFFSET        (ZEP_ZEP_OFFSET + 17)
+#define ZEP_LENGTH_OFFSET       (ZEP_ZEP_OFFSET + 31)
+
+namespace Sniffer
+{
+    bool     zepEnabled = false;
+    uint16_t zepIpIdentification = 0;
+    uint8_t  zepFrame[ZEP_FRAME_HEADER_LEN + CC2538_RF_MAX_PACKET_LEN];
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline uint16_t zepIpChecksum()
+    {
+        uint32_t sum = 0;
+        for (uint8_t i = 0; i < 20; i += 2)
+            sum += readUint16(zepFrame, ZEP_IP_OFFSET + i);
+
+        while (sum >> 16)
+            sum = (sum & 0xffff) + (sum >> 16);
+
+        return ~sum;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Zep::enable(uint8_t message[])
+    {
+        // Only the Ethernet transport can reach other machines, survey samples aren't frames that could be send
+        // and records that refer to earlier records or have a descriptor can't be send as frames either.
+        // ZEP packets are never held back for a trigger.
+        if (!SNIFFER_ETHERNET || Survey::isRunning() || Duplicates::isEnabled() || Compression::isEnabled() || Descriptor::isEnabled()
+         || Trigger::isArmed())
+            return false;
+
+        for (uint8_t i = 0; i < ZEP_FRAME_HEADER_LEN; ++i)
+            zepFrame[i] = 0;
+
+        // Ethernet header, the host looked up the MAC address that belongs to the destination IP
+        for (uint8_t i = 0; i < 6; ++i)
+            zepFrame[i] = message[ZEP_MAC_OFFSET + i];
+        board.getEUI48(zepFrame + 6);
+        writeUint16(zepFrame, 12, ZEP_ETHERTYPE_IPV4);
+
+        // IPv4 header without options, the total length, identification and checksum change with every packet
+        zepFrame[ZEP_IP_OFFSET] = 0x45;
+        writeUint16(zepFrame, ZEP_IP_OFFSET + 6, 0x4000); // Don't fragment
+        zepFrame[ZEP_IP_OFFSET + 8] = 64; // Time to live
+        zepFrame[ZEP_IP_OFFSET + 9] = 17; // UDP
+        for (uint8_t i = 0; i < 8; ++i)
+            zepFrame[ZEP_IP_OFFSET + 12 + i] = message[ZEP_SOURCE_IP_OFFSET + i];
+
+        // UDP header, a checksum of 0 means that there is none
+        writeUint16(zepFrame, ZEP_UDP_OFFSET, ZEP_PORT);
+        writeUint16(zepFrame, ZEP_UDP_OFFSET + 2, readUint16(message, ZEP_PORT_OFFSET));
+
+        // ZEP v2 data header. The mode byte stays 0 (LQI mode), in which the last two bytes of the frame
+        // are the RSSI and CRC flag in the CC24xx format, just like the CC2538 stores them instead of the FCS.
+        zepFrame[ZEP_ZEP_OFFSET] = 'E';
+        zepFrame[ZEP_ZEP_OFFSET + 1] = 'X';
+        zepFrame[ZEP_ZEP_OFFSET + 2] = 2;
+        zepFrame[ZEP_ZEP_OFFSET + 3] = 1;
+        zepFrame[ZEP_DEVICE_ID_OFFSET] = zepFrame[10];
+        zepFrame[ZEP_DEVICE_ID_OFFSET + 1] = zepFrame[11];
+
+        zepEnabled = true;
+
+        // Confirm to the host that the frames will no longer go to it
+        SerialSend::sendMessage(SerialDataType::Zep, message + 2, ZEP_MESSAGE_LENGTH - 2);
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Zep::disable()
+    {
+        zepEnabled = false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Zep::isEnabled()
+    {
+        return zepEnabled;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool Zep::send()
+    {
+        if (bufferIndexSerialSend == bufferIndexRadio)
+            return false;
+
+        // Start at the beginning of the buffer when we have reached the end
+        bufferIndexSerialSend = bufferSkipUnusedEnd(bufferIndexSerialSend, bufferIndexRadio);
+        if (bufferIndexSerialSend == bufferIndexRadio)
+            return false;
+
+        const uint16_t index = bufferIndexSerialSend;
+        const uint8_t length = buffer[index];
+        const uint8_t dataLength = bufferRecordDataLength(index);
+
+        // The timestamp is the time since the OpenMote started, as NTP seconds and fraction
+        const uint32_t timestamp = readUint32(buffer, index + BUFFER_TIMESTAMP_OFFSET);
+        writeUint32(zepFrame, ZEP_TIMESTAMP_OFFSET, timestamp / 1000000);
+        writeUint32(zepFrame, ZEP_TIMESTAMP_OFFSET + 4, static_cast<uint32_t>((static_cast<uint64_t>(timestamp % 1000000) << 32) / 1000000));
+
+        zepFrame[ZEP_CHANNEL_OFFSET] = buffer[index + BUFFER_CHANNEL_OFFSET];
+        zepFrame[ZEP_LQI_OFFSET] = buffer[index + BUFFER_EXTRA_BYTES + dataLength - 1] & 0x7f; // Correlation value behind the CRC_OK bit
+        writeUint32(zepFrame, ZEP_SEQNR_OFFSET, readUint16(buffer, index + BUFFER_SEQNR_OFFSET));
+        zepFrame[ZEP_LENGTH_OFFSET] = dataLength;
+
+        for (uint8_t i = 0; i < dataLength; ++i)
+            zepFrame[ZEP_FRAME_HEADER_LEN + i] = buffer[index + BUFFER_EXTRA_BYTES + i];
+
+        writeUint16(zepFrame, ZEP_IP_OFFSET + 2, 20 + 8 + ZEP_HEADER_LEN + dataLength);
+        writeUint16(zepFrame, ZEP_IP_OFFSET + 4, zepIpIdentification++);
+        writeUint16(zepFrame, ZEP_IP_OFFSET + 10, 0);
+        writeUint16(zepFrame, ZEP_IP_OFFSET + 10, zepIpChecksum());
+        writeUint16(zepFrame, ZEP_UDP_OFFSET + 4, 8 + ZEP_HEADER_LEN + dataLength);
+
+#if !SNIFFER_NATIVE // The native build has no Ethernet controller
+        enc28j60.transmitFrame(zepFrame, ZEP_FRAME_HEADER_LEN + dataLength);
+#endif
+
+        // Nothing is retransmitted, so the record can be overwritten as soon as it was send
+        bufferIndexAcked = index;
+        bufferIndexSerialSend = index + length;
+        return true;
+    }
+}
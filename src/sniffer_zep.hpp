@@ -0,0 +1,37 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @author     Bruno Van de Velde (bruno@texus.me)
+/// @copyright  This file is licensed under the GNU General Public License v2.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNIFFER_ZEP_HPP
+#define SNIFFER_ZEP_HPP
+
+#include "sniffer_global.hpp"
+
+// Every captured frame is send in its own UDP packet: Ethernet header, IPv4 header, UDP header and the ZEP v2 header
+#define ZEP_HEADER_LEN          32
+#define ZEP_FRAME_HEADER_LEN    (14 + 20 + 8 + ZEP_HEADER_LEN)
+#define ZEP_PORT                17754   // Source port, the host chooses the destination port (which Wireshark expects to be 17754 too)
+
+namespace Sniffer
+{
+    class Zep
+    {
+    public:
+        // Start sending the captured frames to the address in the ZEP message, returns false when this isn't possible
+        static bool enable(uint8_t message[]);
+
+        // Go back to sending the frames to the host, called when the buffer is reset
+        static void disable();
+
+        // Check whether the frames are being send as ZEP packets
+        static bool isEnabled();
+
+        // Send the oldest record in the buffer as ZEP packet, returns false when there was nothing to send
+        static bool send();
+    };
+}
+
+#endif // SNIFFER_ZEP_HPP